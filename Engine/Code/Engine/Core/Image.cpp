@@ -37,6 +37,7 @@ Image::Image(const std::string& imageFilePath, const ImageLoadMode loadMode)
 Image::Image(uint width, uint height, unsigned char* raw_image_data)
 	:m_width(width)
 	,m_height(height)
+	,m_bytesPerTexel(4)
 {
 	m_imageTexelBytes = (unsigned char*)malloc(m_width * m_height * 4);
 	memcpy(m_imageTexelBytes, raw_image_data, m_width * m_height * 4);
@@ -46,6 +47,16 @@ Image::~Image(){
     free(m_imageTexelBytes);
 }
 
+void Image::allocate(uint width, uint height)
+{
+	free(m_imageTexelBytes);
+
+	m_width = width;
+	m_height = height;
+	m_bytesPerTexel = 4;
+	m_imageTexelBytes = (unsigned char*)calloc((size_t)width * height, 4);
+}
+
 Rgba Image::GetTexelColorAtIndex(unsigned int texelIndex){
 	int byteOffset = texelIndex * m_bytesPerTexel;
 
@@ -25,6 +25,10 @@ public:
 	int GetBytesPerTexel()						const		{ return m_bytesPerTexel; }
 	const unsigned char* GetImageTexelBytes()	const		{ return m_imageTexelBytes; }
     bool IsValid()                              const       { return nullptr != m_imageTexelBytes; }
+	unsigned char* get_texel_bytes()						{ return m_imageTexelBytes; }
+
+	// throws away what's there for zeroed RGBA8 texels
+	void allocate(uint width, uint height);
 
 	Rgba GetTexelColorAtIndex(unsigned int texelIndex);
 	Rgba GetTexelColorAtPosition(unsigned int xIndex, unsigned int yIndex);
@@ -1,16 +1,49 @@
 #include "Engine/Core/bit_packer.h"
 #include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
 #include "Engine/Math/MathUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static inline u64 get_low_bits_mask(uint bit_count)
+{
+    return (bit_count >= 64) ? ~(u64)0 : (((u64)1 << bit_count) - 1);
+}
+
+// little endian whatever the host is
+static inline void store_word(byte* dest, u32 word)
+{
+    dest[0] = (byte)word;
+    dest[1] = (byte)(word >> 8);
+    dest[2] = (byte)(word >> 16);
+    dest[3] = (byte)(word >> 24);
+}
+
+static inline u32 load_word(const byte* src)
+{
+    return (u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24);
+}
+
+static size_t get_padded_size(size_t buffer_size)
+{
+    return ((buffer_size + BIT_PACKER_WORD_BYTES - 1) / BIT_PACKER_WORD_BYTES) * BIT_PACKER_WORD_BYTES;
+}
+
 BitPacker::BitPacker(const size_t buffer_size)
     :BinaryStream(LITTLE_ENDIAN)
     ,m_buffer_size(buffer_size)
     ,m_bits_written(0)
     ,m_bits_read(0)
 {
-    m_buffer = malloc(m_buffer_size);
-    memset(m_buffer, 0, m_buffer_size);
+    size_t padded_size = get_padded_size(m_buffer_size);
+    m_buffer = malloc(padded_size);
+    memset(m_buffer, 0, padded_size);
+    reset();
 }
 
 BitPacker::~BitPacker()
@@ -21,138 +54,320 @@ BitPacker::~BitPacker()
 u32 BitPacker::write_bytes(void* bytes, size_t count)
 {
     ASSERT_OR_DIE(nullptr != bytes, "bytes is null");
-    ASSERT_OR_DIE(count <= m_buffer_size - get_num_bytes_written(), "Not enough space left to write");
     return write_bits(bytes, count * BITS_PER_BYTE);
 }
 
 u32 BitPacker::read_bytes(void* out_bytes, size_t count)
 {
     ASSERT_OR_DIE(nullptr != out_bytes, "out_bytes is null");
-    ASSERT_OR_DIE(count <= m_buffer_size - get_num_bytes_written(), "Not enough space left to read");
     return read_bits(out_bytes, count, count * BITS_PER_BYTE);
 }
 
-u32 BitPacker::write_bits(void* bytes, size_t bit_count)
+void BitPacker::write_bits(u64 value, uint bit_count)
 {
-    ASSERT_OR_DIE(nullptr != bytes, "bytes is null");
+    ASSERT_OR_DIE(bit_count <= 64, "Can't write more than 64 bits at once");
+    ASSERT_OR_DIE((u64)m_bits_written + bit_count <= (u64)m_buffer_size * BITS_PER_BYTE, "Not enough space left to write");
+
+    // the scratch word never holds more than a word's worth between writes, so
+    // a half fits on top of it
+    if(bit_count > BIT_PACKER_WORD_BITS){
+        write_bits(value, BIT_PACKER_WORD_BITS);
+        value >>= BIT_PACKER_WORD_BITS;
+        bit_count -= BIT_PACKER_WORD_BITS;
+    }
 
-    size_t num_bytes = bit_count / BITS_PER_BYTE;
-    ASSERT_OR_DIE(num_bytes <= m_buffer_size - get_num_bytes_written(), "Not enough space left to write");
-    size_t num_remaining_bits = bit_count % BITS_PER_BYTE;
-    size_t start_bits_written = m_bits_written;
+    m_write_scratch |= (value & get_low_bits_mask(bit_count)) << m_write_scratch_bits;
+    m_write_scratch_bits += bit_count;
+    m_bits_written += bit_count;
 
-    byte* buffer = (byte*)bytes;
+    if(m_write_scratch_bits >= BIT_PACKER_WORD_BITS){
+        store_write_scratch();
+    }
+}
 
-    // write out whole bytes
-    for(size_t byte_idx = 0; byte_idx < num_bytes; ++byte_idx){
-        write_byte(buffer[byte_idx], BITS_PER_BYTE);
+u64 BitPacker::read_bits(uint bit_count)
+{
+    ASSERT_OR_DIE(bit_count <= 64, "Can't read more than 64 bits at once");
+    ASSERT_OR_DIE((u64)m_bits_read + bit_count <= (u64)m_buffer_size * BITS_PER_BYTE, "Not enough space left to read");
+
+    if(bit_count > BIT_PACKER_WORD_BITS){
+        u64 low = read_bits(BIT_PACKER_WORD_BITS);
+        return low | (read_bits(bit_count - BIT_PACKER_WORD_BITS) << BIT_PACKER_WORD_BITS);
     }
 
-    // write out the remaining bits
-    if(num_remaining_bits > 0){
-        write_byte(buffer[num_bytes], num_remaining_bits);
+    if(m_read_scratch_bits < bit_count){
+        load_read_scratch();
     }
 
-    return (u32)(m_bits_written - start_bits_written);
+    u64 value = m_read_scratch & get_low_bits_mask(bit_count);
+    m_read_scratch >>= bit_count;
+    m_read_scratch_bits -= bit_count;
+    m_bits_read += bit_count;
+    return value;
 }
 
-void BitPacker::write_byte(byte b, size_t bit_count)
+void BitPacker::store_write_scratch()
 {
-    for(size_t bit_idx = 0; bit_idx < bit_count; ++bit_idx){
-        bool is_bit_set = IS_BIT_SET(b, BIT(bit_idx));
-        write_bit(is_bit_set);
-    }
+    ASSERT_OR_DIE(m_write_byte_offset + BIT_PACKER_WORD_BYTES <= get_padded_size(m_buffer_size), "Not enough space left to write");
+    store_word((byte*)m_buffer + m_write_byte_offset, (u32)m_write_scratch);
+    m_write_byte_offset += BIT_PACKER_WORD_BYTES;
+    m_write_scratch >>= BIT_PACKER_WORD_BITS;
+    m_write_scratch_bits -= BIT_PACKER_WORD_BITS;
 }
 
-void BitPacker::write_bit(bool bit_is_set)
+void BitPacker::load_read_scratch()
 {
-    byte* current_byte = get_current_write_byte();
-    size_t bit_offset = m_bits_written % BITS_PER_BYTE;
-
-    byte mask = BIT(bit_offset);
-    byte offmask = ~mask;
+    ASSERT_OR_DIE(m_read_byte_offset + BIT_PACKER_WORD_BYTES <= get_padded_size(m_buffer_size), "Not enough space left to read");
+    m_read_scratch |= (u64)load_word((const byte*)m_buffer + m_read_byte_offset) << m_read_scratch_bits;
+    m_read_byte_offset += BIT_PACKER_WORD_BYTES;
+    m_read_scratch_bits += BIT_PACKER_WORD_BITS;
+}
 
-    // turn the bit off
-    (*current_byte) = (*current_byte) & offmask;
+u32 BitPacker::write_bits(void* bytes, size_t bit_count)
+{
+    ASSERT_OR_DIE(nullptr != bytes, "bytes is null");
+    ASSERT_OR_DIE((u64)m_bits_written + bit_count <= (u64)m_buffer_size * BITS_PER_BYTE, "Not enough space left to write");
+
+    const byte* buffer = (const byte*)bytes;
+    size_t bits_left = bit_count;
+    while(bits_left >= BIT_PACKER_WORD_BITS){
+        write_bits((u64)load_word(buffer), BIT_PACKER_WORD_BITS);
+        buffer += BIT_PACKER_WORD_BYTES;
+        bits_left -= BIT_PACKER_WORD_BITS;
+    }
 
-    // turn it back on if needed
-    if(bit_is_set){
-        (*current_byte) |= mask;
+    // the last few bytes, only as many as the bits left touch
+    if(bits_left > 0){
+        u64 value = 0;
+        for(size_t byte_idx = 0; (byte_idx * BITS_PER_BYTE) < bits_left; ++byte_idx){
+            value |= (u64)buffer[byte_idx] << (byte_idx * BITS_PER_BYTE);
+        }
+        write_bits(value, (uint)bits_left);
     }
-     
-    ++m_bits_written;
+
+    return (u32)bit_count;
+}
+
+void BitPacker::write_byte(byte b, size_t bit_count)
+{
+    write_bits((u64)b, (uint)bit_count);
 }
 
 u32 BitPacker::read_bits(void* out_bytes, size_t out_bytes_size, size_t bit_count)
 {
     ASSERT_OR_DIE(nullptr != out_bytes, "out_bytes is null");
+    ASSERT_OR_DIE((bit_count + BITS_PER_BYTE - 1) / BITS_PER_BYTE <= out_bytes_size, "Reading more bits than out_bytes can hold");
+    ASSERT_OR_DIE((u64)m_bits_read + bit_count <= (u64)m_buffer_size * BITS_PER_BYTE, "Not enough space left to read");
 
     memset(out_bytes, 0, out_bytes_size);
 
-    size_t num_bytes = bit_count / BITS_PER_BYTE;
-    ASSERT_OR_DIE(num_bytes <= m_buffer_size - get_num_bytes_read(), "Not enough space left to read");
-    size_t num_remaining_bits = bit_count % BITS_PER_BYTE; 
-    size_t start_bits_read = m_bits_read;
-
     byte* buffer = (byte*)out_bytes;
-
-    for(size_t byte_idx = 0; byte_idx < num_bytes; ++byte_idx){
-        byte b = read_byte(8);
-        buffer[byte_idx] = b;
+    size_t bits_left = bit_count;
+    while(bits_left >= BIT_PACKER_WORD_BITS){
+        store_word(buffer, (u32)read_bits(BIT_PACKER_WORD_BITS));
+        buffer += BIT_PACKER_WORD_BYTES;
+        bits_left -= BIT_PACKER_WORD_BITS;
     }
 
-    if(num_remaining_bits > 0){
-        byte b = read_byte(num_remaining_bits);
-        buffer[num_bytes] = b;
+    if(bits_left > 0){
+        u64 value = read_bits((uint)bits_left);
+        for(size_t byte_idx = 0; (byte_idx * BITS_PER_BYTE) < bits_left; ++byte_idx){
+            buffer[byte_idx] = (byte)(value >> (byte_idx * BITS_PER_BYTE));
+        }
     }
 
-    return (u32)(m_bits_read - start_bits_read);
+    return (u32)bit_count;
 }
 
 byte BitPacker::read_byte(size_t bit_count)
 {
-    byte b = 0;
-    for(size_t bit_idx = 0; bit_idx < bit_count; ++bit_idx){
-        bool is_bit_set = read_bit();
-        if(is_bit_set){
-            byte mask = BIT(bit_idx);
-            b |= mask;
+    return (byte)read_bits((uint)bit_count);
+}
+
+void BitPacker::write_varint(u64 value, uint group_bits)
+{
+    ASSERT_OR_DIE((group_bits > 0) && (group_bits < 64), "Varint groups have to be 1 to 63 bits");
+
+    write_bit(0 != value);
+    if(0 == value){
+        return;
+    }
+
+    // each group goes out with the bit saying whether another one follows it
+    value -= 1;
+    do{
+        u64 group = value & get_low_bits_mask(group_bits);
+        value >>= group_bits;
+        write_bits(group | ((u64)(0 != value) << group_bits), group_bits + 1);
+    }while(0 != value);
+}
+
+void BitPacker::write_signed_varint(i64 value, uint group_bits)
+{
+    write_varint(zigzag_encode(value), group_bits);
+}
+
+bool BitPacker::read_varint(u64* out_value, uint group_bits, uint bit_count)
+{
+    ASSERT_OR_DIE((group_bits > 0) && (group_bits < 64), "Varint groups have to be 1 to 63 bits");
+
+    if(m_bits_read + 1 > bit_count){
+        return false;
+    }
+    if(!read_bit()){
+        *out_value = 0;
+        return true;
+    }
+
+    u64 value = 0;
+    uint shift = 0;
+    bool has_more = true;
+    while(has_more){
+        if((shift >= 64) || (m_bits_read + group_bits + 1 > bit_count)){
+            return false;
+        }
+
+        u64 bits = read_bits(group_bits + 1);
+        u64 group = bits & get_low_bits_mask(group_bits);
+        if(((shift + group_bits) > 64) && (0 != (group >> (64 - shift)))){
+            return false;
         }
+
+        value |= group << shift;
+        shift += group_bits;
+        has_more = (0 != (bits >> group_bits));
+    }
+
+    // one more than the largest u64 was written
+    if(~(u64)0 == value){
+        return false;
     }
-    return b;
+    *out_value = value + 1;
+    return true;
 }
 
-bool BitPacker::read_bit()
+bool BitPacker::read_signed_varint(i64* out_value, uint group_bits, uint bit_count)
 {
-    byte* b = get_current_read_byte(); 
+    u64 value;
+    if(!read_varint(&value, group_bits, bit_count)){
+        return false;
+    }
+    *out_value = zigzag_decode(value);
+    return true;
+}
+
+uint BitPacker::get_varint_bit_count(u64 value, uint group_bits)
+{
+    uint bit_count = 1;
+    if(0 == value){
+        return bit_count;
+    }
+
+    value -= 1;
+    do{
+        bit_count += group_bits + 1;
+        value >>= group_bits;
+    }while(0 != value);
+    return bit_count;
+}
+
+// how many to quantize before packing them, the loops over a batch don't depend
+// on the packer so the compiler can vectorize them
+#define QUANTIZED_FLOAT_BATCH_SIZE 64
+
+void BitPacker::write_quantized_floats(const f32* values, uint count, f32 min, f32 max, uint bit_count)
+{
+    ASSERT_OR_DIE((bit_count > 0) && (bit_count <= 32), "Quantized floats are 1 to 32 bits");
+
+    const f32 steps = (f32)get_low_bits_mask(bit_count);
+    const f32 scale = (max > min) ? (steps / (max - min)) : 0.0f;
 
-    size_t bit_offset = m_bits_read % BITS_PER_BYTE;
-    byte mask = BIT(bit_offset);
-    bool is_bit_set = ((*b) & mask) != 0;
+    u32 codes[QUANTIZED_FLOAT_BATCH_SIZE];
+    for(uint batch_start = 0; batch_start < count; batch_start += QUANTIZED_FLOAT_BATCH_SIZE){
+        uint batch_count = Min(count - batch_start, (uint)QUANTIZED_FLOAT_BATCH_SIZE);
+        const f32* batch = values + batch_start;
 
-    ++m_bits_read;
+        for(uint value_idx = 0; value_idx < batch_count; ++value_idx){
+            f32 step = (batch[value_idx] - min) * scale;
+            step = (step < 0.0f) ? 0.0f : step;
+            step = (step > steps) ? steps : step;
+            codes[value_idx] = (u32)(step + 0.5f);
+        }
+
+        // two to a write when they fit in a word
+        uint value_idx = 0;
+        if((bit_count * 2) <= BIT_PACKER_WORD_BITS){
+            for(; (value_idx + 1) < batch_count; value_idx += 2){
+                write_bits((u64)codes[value_idx] | ((u64)codes[value_idx + 1] << bit_count), bit_count * 2);
+            }
+        }
+        for(; value_idx < batch_count; ++value_idx){
+            write_bits((u64)codes[value_idx], bit_count);
+        }
+    }
+}
 
-    return is_bit_set;
+void BitPacker::read_quantized_floats(f32* out_values, uint count, f32 min, f32 max, uint bit_count)
+{
+    ASSERT_OR_DIE((bit_count > 0) && (bit_count <= 32), "Quantized floats are 1 to 32 bits");
+
+    const f32 steps = (f32)get_low_bits_mask(bit_count);
+    const f32 step_size = (max - min) / steps;
+    const u64 code_mask = get_low_bits_mask(bit_count);
+
+    u32 codes[QUANTIZED_FLOAT_BATCH_SIZE];
+    for(uint batch_start = 0; batch_start < count; batch_start += QUANTIZED_FLOAT_BATCH_SIZE){
+        uint batch_count = Min(count - batch_start, (uint)QUANTIZED_FLOAT_BATCH_SIZE);
+
+        uint value_idx = 0;
+        if((bit_count * 2) <= BIT_PACKER_WORD_BITS){
+            for(; (value_idx + 1) < batch_count; value_idx += 2){
+                u64 pair = read_bits(bit_count * 2);
+                codes[value_idx] = (u32)(pair & code_mask);
+                codes[value_idx + 1] = (u32)(pair >> bit_count);
+            }
+        }
+        for(; value_idx < batch_count; ++value_idx){
+            codes[value_idx] = (u32)read_bits(bit_count);
+        }
+
+        f32* batch = out_values + batch_start;
+        for(value_idx = 0; value_idx < batch_count; ++value_idx){
+            batch[value_idx] = min + ((f32)codes[value_idx] * step_size);
+        }
+    }
 }
 
+// truncates and doesn't clamp, unlike write_quantized_floats. Left that way so
+// anything already written with it reads back the same
 void BitPacker::write_compressed_float(f32 value, f32 min, f32 max, size_t bit_count)
 {
     float normalized = MapFloatToRange(value, min, max, 0.0f, 1.0f);
     u32 max_fidelity = MASK(bit_count);
     u32 compressed_value = (u32)((f32)max_fidelity * normalized);
-    write_bits(&compressed_value, bit_count);
+    write_bits((u64)compressed_value, (uint)bit_count);
 }
 
 f32 BitPacker::read_compressed_float(f32 min, f32 max, size_t bit_count)
 {
     f32 max_fidelity = (f32)MASK(bit_count);
-    u32 compressed_value;
-    read_bits(&compressed_value, sizeof(u32), bit_count);
+    u32 compressed_value = (u32)read_bits((uint)bit_count);
     return MapFloatToRange((f32)compressed_value, 0.0f, max_fidelity, min, max);
 }
 
+void BitPacker::flush()
+{
+    // Partial bytes go out as they are, the word write that completes them later
+    // rewrites them whole.
+    byte* dest = (byte*)m_buffer + m_write_byte_offset;
+    for(u32 bit_idx = 0; bit_idx < m_write_scratch_bits; bit_idx += BITS_PER_BYTE){
+        *dest++ = (byte)(m_write_scratch >> bit_idx);
+    }
+}
+
 byte* BitPacker::get_current_write_byte()
 {
+    flush();
     size_t current_byte = m_bits_written / BITS_PER_BYTE;
     return (byte*)m_buffer + current_byte;
 }
@@ -165,10 +380,542 @@ byte* BitPacker::get_current_read_byte()
 
 u32 BitPacker::get_num_bytes_written()
 {
+    flush();
     return ((m_bits_written + 7) / BITS_PER_BYTE);
 }
 
 u32 BitPacker::get_num_bytes_read()
 {
     return ((m_bits_read + 7) / BITS_PER_BYTE);
-}
\ No newline at end of file
+}
+
+void BitPacker::reset()
+{
+    m_bits_written = 0;
+    m_bits_read = 0;
+
+    m_write_scratch = 0;
+    m_write_scratch_bits = 0;
+    m_write_byte_offset = 0;
+
+    m_read_scratch = 0;
+    m_read_scratch_bits = 0;
+    m_read_byte_offset = 0;
+}
+
+//------------------------------------------------------------------------
+// bit_packer_benchmark / bit_packer_fuzz
+//------------------------------------------------------------------------
+
+// A bit at a time with masks, the way the packer used to work. The benchmark's
+// baseline and what the fuzz test checks the packer's bytes against.
+static void bit_reference_write(byte* buffer, uint* bit_pos, u64 value, uint bit_count)
+{
+    for(uint bit_idx = 0; bit_idx < bit_count; ++bit_idx){
+        byte* current_byte = buffer + (*bit_pos / BITS_PER_BYTE);
+        byte mask = (byte)BIT(*bit_pos % BITS_PER_BYTE);
+        if(0 != ((value >> bit_idx) & 1)){
+            *current_byte |= mask;
+        }else{
+            *current_byte &= (byte)~mask;
+        }
+        ++(*bit_pos);
+    }
+}
+
+static u64 bit_reference_read(const byte* buffer, uint* bit_pos, uint bit_count)
+{
+    u64 value = 0;
+    for(uint bit_idx = 0; bit_idx < bit_count; ++bit_idx){
+        byte mask = (byte)BIT(*bit_pos % BITS_PER_BYTE);
+        if(0 != (buffer[*bit_pos / BITS_PER_BYTE] & mask)){
+            value |= (u64)1 << bit_idx;
+        }
+        ++(*bit_pos);
+    }
+    return value;
+}
+
+// the same numbers every run
+static u32 bit_packer_test_random(u32* state)
+{
+    *state = (*state * 1664525U) + 1013904223U;
+    return *state;
+}
+
+static u64 bit_packer_test_random64(u32* state)
+{
+    u64 high = bit_packer_test_random(state);
+    return (high << 32) | bit_packer_test_random(state);
+}
+
+// megabytes of packed bits a second
+static double get_bit_packer_rate(uint bit_count, double seconds)
+{
+    return (seconds > 0.0) ? ((double)bit_count / BITS_PER_BYTE / (1024.0 * 1024.0) / seconds) : 0.0;
+}
+
+COMMAND(bit_packer_benchmark, "[uint:values] Times packing and unpacking integers, bools and quantized floats, in MB of packed bits a second")
+{
+    uint value_count = args.is_at_end() ? (1024 * 1024) : args.next_uint_arg();
+    value_count = Clamp(value_count, 1024U, 16U * 1024U * 1024U);
+
+    std::vector<u64> values(value_count);
+    std::vector<uint> widths(value_count);
+    std::vector<f32> floats(value_count);
+    std::vector<f32> read_floats(value_count);
+    u32 state = 0x12345678U;
+    uint int_bit_count = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        widths[value_idx] = 1 + (bit_packer_test_random(&state) % 32);
+        values[value_idx] = bit_packer_test_random64(&state) & get_low_bits_mask(widths[value_idx]);
+        floats[value_idx] = ((f32)(bit_packer_test_random(&state) >> 8) / (f32)(1 << 24)) * 2000.0f - 1000.0f;
+        int_bit_count += widths[value_idx];
+    }
+
+    const uint float_bits = 16;
+    const f32 float_steps = (f32)get_low_bits_mask(float_bits);
+    BitPacker packer((value_count * sizeof(u32)) + sizeof(u64));
+    std::vector<byte> reference(packer.m_buffer_size);
+    u64 checksum = 0;
+
+    console_info("----Bit packer, %u values, MB/s----", value_count);
+    console_info("%-24s %10s %10s %10s %10s", "", "bits write", "bits read", "word write", "word read");
+
+    // integers 1 to 32 bits
+    double start = get_current_time_seconds();
+    uint bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        bit_reference_write(reference.data(), &bit_pos, values[value_idx], widths[value_idx]);
+    }
+    double reference_write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        checksum += bit_reference_read(reference.data(), &bit_pos, widths[value_idx]);
+    }
+    double reference_read_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    packer.reset();
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        packer.write_bits(values[value_idx], widths[value_idx]);
+    }
+    packer.flush();
+    double write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        checksum -= packer.read_bits(widths[value_idx]);
+    }
+    double read_seconds = get_current_time_seconds() - start;
+
+    bool ints_match = (0 == memcmp(reference.data(), packer.m_buffer, packer.get_num_bytes_written()));
+    console_info("%-24s %10.1f %10.1f %10.1f %10.1f", "ints, 1 to 32 bits",
+        get_bit_packer_rate(int_bit_count, reference_write_seconds),
+        get_bit_packer_rate(int_bit_count, reference_read_seconds),
+        get_bit_packer_rate(int_bit_count, write_seconds),
+        get_bit_packer_rate(int_bit_count, read_seconds));
+
+    // bools
+    std::fill(reference.begin(), reference.end(), (byte)0);
+    start = get_current_time_seconds();
+    bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        bit_reference_write(reference.data(), &bit_pos, values[value_idx] & 1, 1);
+    }
+    reference_write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        checksum += bit_reference_read(reference.data(), &bit_pos, 1);
+    }
+    reference_read_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    packer.reset();
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        packer.write_bit(0 != (values[value_idx] & 1));
+    }
+    packer.flush();
+    write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        checksum -= packer.read_bit() ? 1 : 0;
+    }
+    read_seconds = get_current_time_seconds() - start;
+
+    bool bools_match = (0 == memcmp(reference.data(), packer.m_buffer, packer.get_num_bytes_written()));
+    console_info("%-24s %10.1f %10.1f %10.1f %10.1f", "bools",
+        get_bit_packer_rate(value_count, reference_write_seconds),
+        get_bit_packer_rate(value_count, reference_read_seconds),
+        get_bit_packer_rate(value_count, write_seconds),
+        get_bit_packer_rate(value_count, read_seconds));
+
+    // quantized floats, one at a time a bit at a time against the bulk path
+    start = get_current_time_seconds();
+    bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        f32 normalized = MapClampedFloatToRange(floats[value_idx], -1000.0f, 1000.0f, 0.0f, 1.0f);
+        bit_reference_write(reference.data(), &bit_pos, (u64)(normalized * float_steps + 0.5f), float_bits);
+    }
+    reference_write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    bit_pos = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        f32 code = (f32)bit_reference_read(reference.data(), &bit_pos, float_bits);
+        read_floats[value_idx] = MapFloatToRange(code, 0.0f, float_steps, -1000.0f, 1000.0f);
+    }
+    reference_read_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    packer.reset();
+    packer.write_quantized_floats(floats.data(), value_count, -1000.0f, 1000.0f, float_bits);
+    packer.flush();
+    write_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    packer.read_quantized_floats(read_floats.data(), value_count, -1000.0f, 1000.0f, float_bits);
+    read_seconds = get_current_time_seconds() - start;
+
+    f32 max_float_error = 0.0f;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        max_float_error = Max(max_float_error, fabsf(read_floats[value_idx] - floats[value_idx]));
+    }
+    console_info("%-24s %10.1f %10.1f %10.1f %10.1f", "floats, 16 bits",
+        get_bit_packer_rate(value_count * float_bits, reference_write_seconds),
+        get_bit_packer_rate(value_count * float_bits, reference_read_seconds),
+        get_bit_packer_rate(value_count * float_bits, write_seconds),
+        get_bit_packer_rate(value_count * float_bits, read_seconds));
+
+    // varints, no bit at a time version to compare with
+    start = get_current_time_seconds();
+    packer.reset();
+    uint varint_count = 0;
+    for(uint value_idx = 0; value_idx < value_count; ++value_idx){
+        u64 value = values[value_idx] >> (value_idx % 24);
+        if((packer.m_bits_written + BitPacker::get_varint_bit_count(value, 4)) > (packer.m_buffer_size * BITS_PER_BYTE)){
+            break;
+        }
+        packer.write_varint(value, 4);
+        ++varint_count;
+    }
+    packer.flush();
+    write_seconds = get_current_time_seconds() - start;
+
+    uint varint_bit_count = packer.m_bits_written;
+    start = get_current_time_seconds();
+    for(uint value_idx = 0; value_idx < varint_count; ++value_idx){
+        u64 value;
+        packer.read_varint(&value, 4, varint_bit_count);
+        checksum += value;
+    }
+    read_seconds = get_current_time_seconds() - start;
+
+    console_info("%-24s %10s %10s %10.1f %10.1f", "varints, 4 bit groups", "-", "-",
+        get_bit_packer_rate(varint_bit_count, write_seconds),
+        get_bit_packer_rate(varint_bit_count, read_seconds));
+    console_info("floats come back within %.4f, checksum %llu", max_float_error, (unsigned long long)checksum);
+
+    if(!ints_match || !bools_match){
+        console_error("Packed bytes differ from a bit at a time");
+    }
+}
+
+enum BitPackerFuzzOp
+{
+    BIT_PACKER_FUZZ_BITS,
+    BIT_PACKER_FUZZ_SIGNED,
+    BIT_PACKER_FUZZ_BIT,
+    BIT_PACKER_FUZZ_BYTES,
+    BIT_PACKER_FUZZ_VARINT,
+    BIT_PACKER_FUZZ_SIGNED_VARINT,
+    BIT_PACKER_FUZZ_FLOATS,
+    NUM_BIT_PACKER_FUZZ_OPS
+};
+
+struct bit_packer_fuzz_op_t
+{
+    BitPackerFuzzOp op;
+    u64 value;
+    uint bit_count;
+    uint group_bits;
+    uint start_bit;
+
+    // floats and bytes
+    uint first_item;
+    uint item_count;
+    f32 min;
+    f32 max;
+};
+
+#define BIT_PACKER_FUZZ_BUFFER_SIZE 4096
+
+// Writes a random run of everything the packer can write, reads it back and checks
+// each value and that the bytes match writing the same bits one at a time.
+// Returns the op that failed, or the op count when none did.
+static uint run_bit_packer_fuzz(u32* state, BitPacker* packer, std::vector<bit_packer_fuzz_op_t>* ops, std::vector<f32>* floats, std::vector<byte>* bytes, const char** out_failure)
+{
+    ops->clear();
+    floats->clear();
+    bytes->clear();
+    packer->reset();
+
+    std::vector<byte> reference(BIT_PACKER_FUZZ_BUFFER_SIZE, 0);
+    uint reference_pos = 0;
+    const uint capacity_bits = BIT_PACKER_FUZZ_BUFFER_SIZE * BITS_PER_BYTE;
+
+    for(;;){
+        bit_packer_fuzz_op_t op;
+        memset(&op, 0, sizeof(op));
+        op.op = (BitPackerFuzzOp)(bit_packer_test_random(state) % NUM_BIT_PACKER_FUZZ_OPS);
+        op.bit_count = bit_packer_test_random(state) % 65;
+
+        // mostly small, sometimes anything
+        op.value = bit_packer_test_random64(state);
+        if(0 == (bit_packer_test_random(state) % 2)){
+            op.value &= get_low_bits_mask(bit_packer_test_random(state) % 20);
+        }
+        op.group_bits = 1 + (bit_packer_test_random(state) % 12);
+        op.start_bit = packer->m_bits_written;
+
+        uint op_bits;
+        switch(op.op){
+            case BIT_PACKER_FUZZ_BIT:
+                op.bit_count = 1;
+                op_bits = 1;
+                break;
+            case BIT_PACKER_FUZZ_BYTES:
+                op.item_count = bit_packer_test_random(state) % 200;
+                op_bits = op.item_count;
+                break;
+            case BIT_PACKER_FUZZ_VARINT:
+                op_bits = BitPacker::get_varint_bit_count(op.value, op.group_bits);
+                break;
+            case BIT_PACKER_FUZZ_SIGNED_VARINT:
+                op_bits = BitPacker::get_varint_bit_count(zigzag_encode((i64)op.value), op.group_bits);
+                break;
+            case BIT_PACKER_FUZZ_FLOATS:
+                op.item_count = bit_packer_test_random(state) % 20;
+                op.bit_count = 1 + (bit_packer_test_random(state) % 24);
+                op_bits = op.item_count * op.bit_count;
+                break;
+            default:
+                op_bits = op.bit_count;
+                break;
+        }
+        if((packer->m_bits_written + op_bits) > capacity_bits){
+            break;
+        }
+
+        switch(op.op){
+            case BIT_PACKER_FUZZ_BITS:
+            case BIT_PACKER_FUZZ_SIGNED:
+            case BIT_PACKER_FUZZ_BIT:
+                packer->write_bits(op.value, op.bit_count);
+                break;
+
+            case BIT_PACKER_FUZZ_BYTES: {
+                // item_count is bits here
+                op.first_item = (uint)bytes->size();
+                for(uint byte_idx = 0; (byte_idx * BITS_PER_BYTE) < op.item_count; ++byte_idx){
+                    bytes->push_back((byte)bit_packer_test_random(state));
+                }
+                if(op.item_count > 0){
+                    packer->write_bits((void*)(bytes->data() + op.first_item), op.item_count);
+                }
+                break;
+            }
+
+            case BIT_PACKER_FUZZ_VARINT:
+                packer->write_varint(op.value, op.group_bits);
+                break;
+
+            case BIT_PACKER_FUZZ_SIGNED_VARINT:
+                packer->write_signed_varint((i64)op.value, op.group_bits);
+                break;
+
+            case BIT_PACKER_FUZZ_FLOATS: {
+                op.first_item = (uint)floats->size();
+                op.min = -((f32)(bit_packer_test_random(state) % 1000));
+                op.max = op.min + 1.0f + (f32)(bit_packer_test_random(state) % 1000);
+                for(uint float_idx = 0; float_idx < op.item_count; ++float_idx){
+                    // a little outside the range now and then, it's clamped
+                    f32 t = ((f32)(bit_packer_test_random(state) >> 8) / (f32)(1 << 24)) * 1.2f - 0.1f;
+                    floats->push_back(op.min + ((op.max - op.min) * t));
+                }
+                packer->write_quantized_floats(floats->data() + op.first_item, op.item_count, op.min, op.max, op.bit_count);
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if(packer->m_bits_written != (op.start_bit + op_bits)){
+            *out_failure = "wrote the wrong number of bits";
+            ops->push_back(op);
+            return (uint)ops->size() - 1;
+        }
+
+        // the same bits one at a time, varints and floats copied from what the
+        // packer wrote since they're checked by value on the way back
+        if((BIT_PACKER_FUZZ_BITS == op.op) || (BIT_PACKER_FUZZ_SIGNED == op.op) || (BIT_PACKER_FUZZ_BIT == op.op)){
+            bit_reference_write(reference.data(), &reference_pos, op.value, op.bit_count);
+        }else if(BIT_PACKER_FUZZ_BYTES == op.op){
+            for(uint bit_idx = 0; bit_idx < op.item_count; ++bit_idx){
+                byte b = (*bytes)[op.first_item + (bit_idx / BITS_PER_BYTE)];
+                bit_reference_write(reference.data(), &reference_pos, (b >> (bit_idx % BITS_PER_BYTE)) & 1, 1);
+            }
+        }else{
+            packer->flush();
+            uint packer_pos = op.start_bit;
+            for(uint bit_idx = 0; bit_idx < op_bits; ++bit_idx){
+                bit_reference_write(reference.data(), &reference_pos, bit_reference_read((const byte*)packer->m_buffer, &packer_pos, 1), 1);
+            }
+        }
+
+        ops->push_back(op);
+
+        // flushing part way must not change anything
+        if(0 == (bit_packer_test_random(state) % 8)){
+            packer->flush();
+        }
+    }
+
+    uint byte_count = packer->get_num_bytes_written();
+    if(0 != memcmp(reference.data(), packer->m_buffer, byte_count)){
+        *out_failure = "bytes differ from writing a bit at a time";
+        return 0;
+    }
+
+    for(uint op_idx = 0; op_idx < ops->size(); ++op_idx){
+        const bit_packer_fuzz_op_t& op = (*ops)[op_idx];
+        if(packer->m_bits_read != op.start_bit){
+            *out_failure = "read the wrong number of bits";
+            return op_idx;
+        }
+
+        bool matches = true;
+        switch(op.op){
+            case BIT_PACKER_FUZZ_BITS:
+            case BIT_PACKER_FUZZ_BIT:
+                matches = (packer->read_bits(op.bit_count) == (op.value & get_low_bits_mask(op.bit_count)));
+                break;
+
+            case BIT_PACKER_FUZZ_SIGNED: {
+                // sign extended from the top bit written
+                i64 expected = 0;
+                if(op.bit_count > 0){
+                    uint unused_bits = 64 - op.bit_count;
+                    expected = (i64)(op.value << unused_bits) >> unused_bits;
+                }
+                matches = (packer->read<i64>(op.bit_count) == expected);
+                break;
+            }
+
+            case BIT_PACKER_FUZZ_BYTES: {
+                byte read_bytes[32];
+                if(op.item_count > 0){
+                    uint byte_count_read = (op.item_count + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+                    packer->read_bits(read_bytes, sizeof(read_bytes), op.item_count);
+                    for(uint byte_idx = 0; byte_idx < byte_count_read; ++byte_idx){
+                        uint bits_in_byte = Min(op.item_count - (byte_idx * BITS_PER_BYTE), (uint)BITS_PER_BYTE);
+                        byte mask = (byte)get_low_bits_mask(bits_in_byte);
+                        matches = matches && (read_bytes[byte_idx] == ((*bytes)[op.first_item + byte_idx] & mask));
+                    }
+                }
+                break;
+            }
+
+            case BIT_PACKER_FUZZ_VARINT: {
+                u64 value;
+                matches = packer->read_varint(&value, op.group_bits, packer->m_bits_written) && (value == op.value);
+                break;
+            }
+
+            case BIT_PACKER_FUZZ_SIGNED_VARINT: {
+                i64 value;
+                matches = packer->read_signed_varint(&value, op.group_bits, packer->m_bits_written) && (value == (i64)op.value);
+                break;
+            }
+
+            case BIT_PACKER_FUZZ_FLOATS: {
+                f32 read_floats[32];
+                packer->read_quantized_floats(read_floats, op.item_count, op.min, op.max, op.bit_count);
+
+                // within half a step, plus some for float rounding
+                f32 tolerance = ((op.max - op.min) / (f32)get_low_bits_mask(op.bit_count)) * 0.5f + ((op.max - op.min) * 1e-5f);
+                for(uint float_idx = 0; float_idx < op.item_count; ++float_idx){
+                    f32 expected = Clamp((*floats)[op.first_item + float_idx], op.min, op.max);
+                    matches = matches && (fabsf(read_floats[float_idx] - expected) <= tolerance);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if(!matches){
+            *out_failure = "read back a different value";
+            return op_idx;
+        }
+    }
+
+    // a varint cut short has to say so rather than read past the end
+    if(!ops->empty()){
+        packer->reset();
+        u64 value;
+        uint limit = bit_packer_test_random(state) % 8;
+        for(uint try_idx = 0; try_idx < 64; ++try_idx){
+            if(!packer->read_varint(&value, 1 + (try_idx % 12), limit)){
+                break;
+            }
+        }
+        if(packer->m_bits_read > limit){
+            *out_failure = "a varint read past its limit";
+            return 0;
+        }
+    }
+
+    return (uint)ops->size();
+}
+
+COMMAND(bit_packer_fuzz, "[uint:runs] [uint:seed] Writes random runs of bits, varints, bytes and floats and checks they read back")
+{
+    uint run_count = args.is_at_end() ? 1000 : args.next_uint_arg();
+    u32 state = args.is_at_end() ? 0x2545F491U : args.next_uint_arg();
+
+    BitPacker packer(BIT_PACKER_FUZZ_BUFFER_SIZE);
+    std::vector<bit_packer_fuzz_op_t> ops;
+    std::vector<f32> floats;
+    std::vector<byte> bytes;
+
+    uint op_count = 0;
+    for(uint run_idx = 0; run_idx < run_count; ++run_idx){
+        u32 run_seed = state;
+        const char* failure = nullptr;
+        uint failed_op = run_bit_packer_fuzz(&state, &packer, &ops, &floats, &bytes, &failure);
+        if(nullptr != failure){
+            const bit_packer_fuzz_op_t* op = (failed_op < ops.size()) ? &ops[failed_op] : nullptr;
+            console_error("Run %u (seed %u) %s at op %u of %u (type %d, %u bits, group %u)",
+                run_idx,
+                run_seed,
+                failure,
+                failed_op,
+                (uint)ops.size(),
+                (nullptr != op) ? (int)op->op : -1,
+                (nullptr != op) ? op->bit_count : 0,
+                (nullptr != op) ? op->group_bits : 0);
+            return;
+        }
+        op_count += (uint)ops.size();
+    }
+
+    console_success("%u runs, %u ops, everything read back", run_count, op_count);
+}
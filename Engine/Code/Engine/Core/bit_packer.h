@@ -2,7 +2,32 @@
 
 #include "Engine/Core/BinaryStream.hpp"
 #include "Engine/Core/bit.h"
+#include "Engine/Core/Common.hpp"
 
+#include <type_traits>
+
+// scratch words go to and from the buffer this many bytes at a time, the buffer
+// is padded out to a whole number of them
+#define BIT_PACKER_WORD_BYTES 4
+#define BIT_PACKER_WORD_BITS (BIT_PACKER_WORD_BYTES * BITS_PER_BYTE)
+
+// signed values as unsigned ones that stay small when they're close to zero,
+// 0, -1, 1, -2... become 0, 1, 2, 3...
+inline u64 zigzag_encode(i64 value)
+{
+    return ((u64)value << 1) ^ (u64)(value >> 63);
+}
+
+inline i64 zigzag_decode(u64 value)
+{
+    return (i64)(value >> 1) ^ -(i64)(value & 1);
+}
+
+// Bits go in low bit first, the first bit written is the lowest bit of the first
+// byte. Writes collect in a 64 bit scratch word and go to m_buffer 32 bits at a
+// time, so anything reading m_buffer directly needs flush() (or
+// get_num_bytes_written) first. Reads load the buffer into a scratch word the
+// same way.
 class BitPacker : public BinaryStream
 {
     public:
@@ -12,6 +37,20 @@ class BitPacker : public BinaryStream
         u32 m_bits_written;
         u32 m_bits_read;
 
+    private:
+        u64 m_write_scratch;
+        u32 m_write_scratch_bits;
+        u32 m_write_byte_offset;
+
+        u64 m_read_scratch;
+        u32 m_read_scratch_bits;
+        u32 m_read_byte_offset;
+
+        // a word out of the write scratch into m_buffer, and the next one from
+        // m_buffer on top of the read scratch
+        void store_write_scratch();
+        void load_read_scratch();
+
     public:
         BitPacker(size_t buffer_size);
         virtual ~BitPacker();
@@ -20,79 +59,93 @@ class BitPacker : public BinaryStream
         virtual u32 read_bytes(void* out_bytes, size_t byte_count) override;
 
     public:
+        // the low bit_count bits of value, up to 64
+        void write_bits(u64 value, uint bit_count);
+        u64 read_bits(uint bit_count);
+
+        // bit_count bits from a buffer, whole bytes first
         u32 write_bits(void* bytes, size_t bit_count);
         void write_byte(byte b, size_t bit_count);
-        void write_bit(bool bit_is_set);
 
         u32 read_bits(void* out_bytes, size_t out_bytes_size, size_t bit_count);
         byte read_byte(size_t bit_count);
-        bool read_bit();
+
+        // 0 is a single bit. Anything else is a set bit, then one less than it in
+        // groups of group_bits lowest first, each followed by a bit saying whether
+        // there's another.
+        void write_varint(u64 value, uint group_bits);
+        void write_signed_varint(i64 value, uint group_bits);
+
+        // false if it would read past bit_count bits into the buffer or doesn't
+        // fit in 64 bits, what's been read is left read
+        bool read_varint(u64* out_value, uint group_bits, uint bit_count);
+        bool read_signed_varint(i64* out_value, uint group_bits, uint bit_count);
+
+        static uint get_varint_bit_count(u64 value, uint group_bits);
+
+        // Each value clamped to [min, max] and rounded to the nearest of the
+        // 2^bit_count steps across it.
+        void write_quantized_floats(const f32* values, uint count, f32 min, f32 max, uint bit_count);
+        void read_quantized_floats(f32* out_values, uint count, f32 min, f32 max, uint bit_count);
 
         void write_compressed_float(f32 value, f32 min, f32 max, size_t bit_count);
         f32 read_compressed_float(f32 min, f32 max, size_t bit_count);
 
+        // m_buffer has everything written once this returns, writing can go on after
+        void flush();
+
+        // flushes, so the bytes before it are all there
         byte* get_current_write_byte();
         byte* get_current_read_byte();
 
         u32 get_num_bytes_written();
         u32 get_num_bytes_read();
 
+        // back to the start for both reading and writing, the buffer is left as is
+        void reset();
+
     public:
-        template<typename T>
-        void write(const T& value, size_t bit_count)
+        // Most of what's written is flags, so single bits go straight to the
+        // scratch word here instead of through write_bits.
+        void write_bit(bool bit_is_set)
         {
-            byte* buffer = (byte*)&value;
+            m_write_scratch |= (u64)(bit_is_set ? 1 : 0) << m_write_scratch_bits;
+            ++m_bits_written;
+            if(++m_write_scratch_bits == BIT_PACKER_WORD_BITS){
+                store_write_scratch();
+            }
+        }
 
-            // if should flip, then flip the bytes around
-            if(should_flip()){
-                byte* flipped_buffer = (byte*)_alloca(sizeof(T));
-                ares::flip_bytes_to_buffer(buffer, flipped_buffer, sizeof(T));
-                buffer = flipped_buffer;
+        bool read_bit()
+        {
+            if(0 == m_read_scratch_bits){
+                load_read_scratch();
             }
 
-            write_bits((void*)buffer, bit_count);
+            bool is_bit_set = (0 != (m_read_scratch & 1));
+            m_read_scratch >>= 1;
+            --m_read_scratch_bits;
+            ++m_bits_read;
+            return is_bit_set;
         }
 
         template<typename T>
-        T read(size_t bit_count)
+        void write(const T& value, size_t bit_count)
         {
-            T val = 0;
-            byte* buffer = (byte*)&val;
-
-            // read in up to bit_count
-            read_bits(buffer, sizeof(T), bit_count);
-
-            // if signed and value is negative then pad out 1's for two's complement
-            if(std::is_signed<T>()){
-                u32 num_bytes = (u32)bit_count / BITS_PER_BYTE;
-                u32 num_remaining_bits = (u32)bit_count % BITS_PER_BYTE;
-
-                // get most significant byte
-                size_t msb_idx = (num_bytes - 1) + (num_remaining_bits > 0 ? 1 : 0);
-                byte* msb = buffer + msb_idx;
-
-                // check sign bit 
-                byte msb_mask = BIT(num_remaining_bits - 1);
-                bool is_sign_bit_set = ((*msb & msb_mask) != 0);
-
-                // if sign bit is set then pad out 1's for rest of value
-                if(is_sign_bit_set){
-                    // pad remaining bits
-                    byte pad_mask = ~MASK(num_remaining_bits);
-                    *msb |= pad_mask; 
-
-                    // pad remaining bytes
-                    for(size_t byte_idx = msb_idx + 1; byte_idx < sizeof(T); ++byte_idx){
-                        buffer[byte_idx] = 0xFF;
-                    }
-                }
-            }
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "BitPacker::write takes integers, use write_bits for anything else");
+            write_bits((u64)value, (uint)bit_count);
+        }
 
-            // flips bytes if host order is big endian 
-            if(should_flip()){
-                ares::flip_bytes_in_place(buffer, sizeof(T));
+        // signed types are sign extended from the top bit read
+        template<typename T>
+        T read(size_t bit_count)
+        {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "BitPacker::read takes integers, use read_bits for anything else");
+            u64 bits = read_bits((uint)bit_count);
+            if(std::is_signed<T>::value && (bit_count > 0) && (bit_count < 64)){
+                u64 sign_bit = (u64)1 << (bit_count - 1);
+                bits = (bits ^ sign_bit) - sign_bit;
             }
-
-            return val;
+            return (T)bits;
         }
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Engine/Core/StringUtils.hpp"
 #include <vector>
 #include <string>
+#include <string.h>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -27,4 +28,61 @@ bool create_directory(const char* directory_path)
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+std::vector<std::string> find_files_in_directory(const char* directory_path, const char* pattern)
+{
+	std::vector<std::string> filenames;
+	std::string search_path = std::string(directory_path) + "/" + pattern;
+
+	WIN32_FIND_DATAA find_data;
+	HANDLE find_handle = FindFirstFileA(search_path.c_str(), &find_data);
+	if(find_handle == INVALID_HANDLE_VALUE){
+		return filenames;
+	}
+
+	do{
+		if((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0){
+			filenames.push_back(find_data.cFileName);
+		}
+	}while(FindNextFileA(find_handle, &find_data));
+
+	FindClose(find_handle);
+	return filenames;
+}
+
+std::vector<std::string> find_directories_in_directory(const char* directory_path)
+{
+	std::vector<std::string> directory_names;
+	std::string search_path = std::string(directory_path) + "/*";
+
+	WIN32_FIND_DATAA find_data;
+	HANDLE find_handle = FindFirstFileA(search_path.c_str(), &find_data);
+	if(find_handle == INVALID_HANDLE_VALUE){
+		return directory_names;
+	}
+
+	do{
+		bool is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		bool is_dot = (strcmp(find_data.cFileName, ".") == 0) || (strcmp(find_data.cFileName, "..") == 0);
+		if(is_directory && !is_dot){
+			directory_names.push_back(find_data.cFileName);
+		}
+	}while(FindNextFileA(find_handle, &find_data));
+
+	FindClose(find_handle);
+	return directory_names;
+}
+
+unsigned long long get_file_write_time(const char* filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes)){
+		return 0;
+	}
+
+	ULARGE_INTEGER write_time;
+	write_time.LowPart = attributes.ftLastWriteTime.dwLowDateTime;
+	write_time.HighPart = attributes.ftLastWriteTime.dwHighDateTime;
+	return write_time.QuadPart;
+}
@@ -1,3 +1,15 @@
 #pragma once
 
-bool create_directory(const char* directory_path);
\ No newline at end of file
+#include <string>
+#include <vector>
+
+bool create_directory(const char* directory_path);
+
+// file names (not paths) in directory_path matching a wildcard pattern like "*.mesh"
+std::vector<std::string> find_files_in_directory(const char* directory_path, const char* pattern);
+
+// names of the directories directly in directory_path, without . and ..
+std::vector<std::string> find_directories_in_directory(const char* directory_path);
+
+// last write time as a FILETIME count, 0 when the file can't be found
+unsigned long long get_file_write_time(const char* filename);
@@ -0,0 +1,126 @@
+#include "Engine/Core/half_float.h"
+
+#include <string.h>
+
+u16 float_to_half(float value)
+{
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	u32 sign = bits & 0x80000000U;
+	bits ^= sign;
+
+	u32 half;
+	if(bits >= (143U << 23)){
+		// too big for a half, or already inf / nan
+		half = (bits > (255U << 23)) ? 0x7e00 : 0x7c00;
+	}else if(bits < (113U << 23)){
+		// subnormal, let the fpu do the rounding
+		const u32 denorm_magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float denorm_magic;
+		memcpy(&denorm_magic, &denorm_magic_bits, sizeof(denorm_magic));
+
+		float abs_value;
+		memcpy(&abs_value, &bits, sizeof(abs_value));
+		abs_value += denorm_magic;
+		memcpy(&bits, &abs_value, sizeof(bits));
+		half = bits - denorm_magic_bits;
+	}else{
+		u32 mantissa_odd = (bits >> 13) & 1;
+		bits += ((u32)(15 - 127) << 23) + 0xfff;
+		bits += mantissa_odd;
+		half = bits >> 13;
+	}
+
+	return (u16)(half | (sign >> 16));
+}
+
+float half_to_float(u16 half)
+{
+	const u32 shifted_exponent = 0x7c00 << 13;
+
+	u32 bits = (half & 0x7fff) << 13;
+	u32 exponent = shifted_exponent & bits;
+	bits += (127 - 15) << 23;
+
+	if(exponent == shifted_exponent){
+		// inf / nan
+		bits += (128 - 16) << 23;
+	}else if(exponent == 0){
+		// zero / subnormal, renormalize
+		bits += 1 << 23;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+
+		const u32 magic_bits = 113 << 23;
+		float magic;
+		memcpy(&magic, &magic_bits, sizeof(magic));
+		value -= magic;
+		memcpy(&bits, &value, sizeof(bits));
+	}
+
+	bits |= (u32)(half & 0x8000) << 16;
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// four floats to four halves in the low 16 bits of each lane
+__m128i float_to_half_sse(__m128 values)
+{
+	const __m128i f16_max = _mm_set1_epi32(143 << 23);
+	const __m128i min_normal = _mm_set1_epi32(113 << 23);
+	const __m128i denorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+	const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+	const __m128i inf_half = _mm_set1_epi32(0x7c00);
+	const __m128i nan_bit = _mm_set1_epi32(0x200);
+
+	__m128 sign = _mm_and_ps(values, _mm_set1_ps(-0.0f));
+	__m128 abs_values = _mm_xor_ps(values, sign);
+	__m128i abs_bits = _mm_castps_si128(abs_values);
+
+	__m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(abs_values, abs_values));
+	__m128i is_regular = _mm_cmpgt_epi32(f16_max, abs_bits);
+	__m128i is_subnormal = _mm_cmpgt_epi32(min_normal, abs_bits);
+	__m128i special = _mm_or_si128(inf_half, _mm_and_si128(is_nan, nan_bit));
+
+	__m128 subnormal_sum = _mm_add_ps(abs_values, _mm_castsi128_ps(denorm_magic));
+	__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(subnormal_sum), denorm_magic);
+
+	__m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs_bits, 31 - 13), 31);
+	__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_bits, normal_bias), mantissa_odd), 13);
+
+	__m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+	__m128i result = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, special));
+	return _mm_or_si128(result, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+
+// packs_epi32 saturates signed, so sign extend the 16 bit patterns first
+__m128i pack_u16_lanes(__m128i low, __m128i high)
+{
+	low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+	high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+	return _mm_packs_epi32(low, high);
+}
+
+void floats_to_halves(const float* values, size_t count, u16* out_halves)
+{
+	size_t idx = 0;
+	for(; idx + 8 <= count; idx += 8){
+		__m128i low = float_to_half_sse(_mm_loadu_ps(values + idx));
+		__m128i high = float_to_half_sse(_mm_loadu_ps(values + idx + 4));
+		_mm_storeu_si128((__m128i*)(out_halves + idx), pack_u16_lanes(low, high));
+	}
+
+	for(; idx < count; ++idx){
+		out_halves[idx] = float_to_half(values[idx]);
+	}
+}
+
+void halves_to_floats(const u16* halves, size_t count, float* out_values)
+{
+	for(size_t idx = 0; idx < count; ++idx){
+		out_values[idx] = half_to_float(halves[idx]);
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+
+#include <emmintrin.h>
+
+// IEEE half floats, round to nearest even. The scalar and SSE paths give the
+// same bits for every input, inf and nan included
+u16 float_to_half(float value);
+float half_to_float(u16 half);
+
+// four floats to four halves in the low 16 bits of each lane
+__m128i float_to_half_sse(__m128 values);
+
+// the low 16 bits of each lane of two vectors, packed into eight u16s
+__m128i pack_u16_lanes(__m128i low, __m128i high);
+
+// whole arrays, eight at a time through SSE
+void floats_to_halves(const float* values, size_t count, u16* out_halves);
+void halves_to_floats(const u16* halves, size_t count, float* out_values);
@@ -0,0 +1,441 @@
+#include "Engine/Core/hdr_image.h"
+#include "Engine/Core/half_float.h"
+#include "Engine/Core/mapped_file.h"
+#include "Engine/Core/Image.hpp"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include "ThirdParty/stb/stb_image.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+// 20000630, the first four bytes of every exr
+#define EXR_MAGIC (0x01312f76)
+
+#define EXR_VERSION_FLAG_TILED		(0x200)
+#define EXR_VERSION_FLAG_NON_IMAGE	(0x800)
+#define EXR_VERSION_FLAG_MULTIPART	(0x1000)
+
+// bigger than any hdri anyone ships, keeps a corrupt header from allocating the world
+#define MAX_EXR_SIZE (32768)
+
+enum ExrCompression
+{
+	EXR_COMPRESSION_NONE,
+	EXR_COMPRESSION_RLE,
+	EXR_COMPRESSION_ZIPS,
+	EXR_COMPRESSION_ZIP,
+	EXR_COMPRESSION_PIZ,
+	EXR_COMPRESSION_PXR24,
+	EXR_COMPRESSION_B44,
+	EXR_COMPRESSION_B44A,
+	EXR_COMPRESSION_DWAA,
+	EXR_COMPRESSION_DWAB,
+};
+
+enum ExrPixelType
+{
+	EXR_PIXEL_TYPE_UINT,
+	EXR_PIXEL_TYPE_HALF,
+	EXR_PIXEL_TYPE_FLOAT,
+};
+
+// a Y channel fills r, g and b
+#define EXR_CHANNEL_GREY (4)
+#define EXR_CHANNEL_IGNORED (-1)
+
+struct exr_channel_t
+{
+	u32 pixel_type;
+	int target;
+};
+
+// bounds checked reads through the mapped file
+struct exr_reader_t
+{
+	const byte* data;
+	size_t size;
+	size_t pos;
+
+	bool read(void* out, size_t count)
+	{
+		if((pos + count) > size){
+			return false;
+		}
+		memcpy(out, data + pos, count);
+		pos += count;
+		return true;
+	}
+
+	bool read_string(std::string* out)
+	{
+		const byte* start = data + pos;
+		const byte* end = (const byte*)memchr(start, 0, size - pos);
+		if(end == nullptr){
+			return false;
+		}
+		out->assign((const char*)start, end - start);
+		pos += (end - start) + 1;
+		return true;
+	}
+};
+
+static std::string get_lower_extension(const std::string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	if(dot == std::string::npos){
+		return "";
+	}
+
+	std::string extension = filename.substr(dot);
+	for(char& c : extension){
+		c = (char)tolower((unsigned char)c);
+	}
+	return extension;
+}
+
+bool is_hdr_image_file(const std::string& filename)
+{
+	std::string extension = get_lower_extension(filename);
+	return (extension == ".hdr") || (extension == ".exr");
+}
+
+//-----------------------------------------------------
+// OpenEXR
+static uint get_exr_pixel_size(u32 pixel_type)
+{
+	return (pixel_type == EXR_PIXEL_TYPE_HALF) ? 2 : 4;
+}
+
+static uint get_exr_lines_per_block(u8 compression)
+{
+	switch(compression){
+		case EXR_COMPRESSION_NONE:	return 1;
+		case EXR_COMPRESSION_RLE:	return 1;
+		case EXR_COMPRESSION_ZIPS:	return 1;
+		case EXR_COMPRESSION_ZIP:	return 16;
+		default:					return 0;
+	}
+}
+
+static int get_exr_channel_target(const std::string& name)
+{
+	if(name == "R")	return 0;
+	if(name == "G")	return 1;
+	if(name == "B")	return 2;
+	if(name == "A")	return 3;
+	if(name == "Y")	return EXR_CHANNEL_GREY;
+	return EXR_CHANNEL_IGNORED;
+}
+
+static bool parse_exr_channels(const byte* value, size_t size, std::vector<exr_channel_t>* out_channels)
+{
+	exr_reader_t reader = { value, size, 0 };
+	for(;;){
+		std::string name;
+		if(!reader.read_string(&name)){
+			return false;
+		}
+		if(name.empty()){
+			return true;
+		}
+
+		exr_channel_t channel;
+		u8 linear_and_reserved[4];
+		i32 sampling[2];
+		if(!reader.read(&channel.pixel_type, sizeof(channel.pixel_type))
+			|| !reader.read(linear_and_reserved, sizeof(linear_and_reserved))
+			|| !reader.read(sampling, sizeof(sampling))){
+			return false;
+		}
+
+		// subsampled chroma channels would need their own row strides
+		if((channel.pixel_type > EXR_PIXEL_TYPE_FLOAT) || (sampling[0] != 1) || (sampling[1] != 1)){
+			return false;
+		}
+
+		channel.target = get_exr_channel_target(name);
+		out_channels->push_back(channel);
+	}
+}
+
+// zip and rle both store the bytes split into two halves and delta coded
+static void exr_undo_predictor_and_interleave(byte* bytes, size_t size, byte* out)
+{
+	for(size_t idx = 1; idx < size; ++idx){
+		bytes[idx] = (byte)((int)bytes[idx - 1] + (int)bytes[idx] - 128);
+	}
+
+	const byte* first_half = bytes;
+	const byte* second_half = bytes + ((size + 1) / 2);
+	for(size_t idx = 0; idx < size; ++idx){
+		out[idx] = ((idx & 1) == 0) ? *first_half++ : *second_half++;
+	}
+}
+
+static bool exr_rle_decode(const byte* packed, size_t packed_size, byte* out, size_t out_size)
+{
+	const byte* packed_end = packed + packed_size;
+	size_t out_pos = 0;
+	while(packed < packed_end){
+		int count = (int)(i8)*packed++;
+		if(count < 0){
+			// a run of -count literal bytes
+			size_t literal_count = (size_t)-count;
+			if(((packed + literal_count) > packed_end) || ((out_pos + literal_count) > out_size)){
+				return false;
+			}
+			memcpy(out + out_pos, packed, literal_count);
+			packed += literal_count;
+			out_pos += literal_count;
+		}else{
+			// count + 1 copies of the next byte
+			size_t repeat_count = (size_t)count + 1;
+			if((packed >= packed_end) || ((out_pos + repeat_count) > out_size)){
+				return false;
+			}
+			memset(out + out_pos, *packed++, repeat_count);
+			out_pos += repeat_count;
+		}
+	}
+	return out_pos == out_size;
+}
+
+static bool exr_decode_block(u8 compression, const byte* packed, size_t packed_size, std::vector<byte>* scratch, byte* out, size_t out_size)
+{
+	scratch->resize(out_size);
+	char* scratch_data = (char*)scratch->data();
+
+	if(compression == EXR_COMPRESSION_RLE){
+		if(!exr_rle_decode(packed, packed_size, scratch->data(), out_size)){
+			return false;
+		}
+	}else{
+		int decoded_size = stbi_zlib_decode_buffer(scratch_data, (int)out_size, (const char*)packed, (int)packed_size);
+		if(decoded_size != (int)out_size){
+			return false;
+		}
+	}
+
+	exr_undo_predictor_and_interleave(scratch->data(), out_size, out);
+	return true;
+}
+
+static float read_exr_sample(const byte* sample, u32 pixel_type)
+{
+	switch(pixel_type){
+		case EXR_PIXEL_TYPE_HALF:{
+			u16 half;
+			memcpy(&half, sample, sizeof(half));
+			return half_to_float(half);
+		}
+		case EXR_PIXEL_TYPE_FLOAT:{
+			float value;
+			memcpy(&value, sample, sizeof(value));
+			return value;
+		}
+		default:{
+			u32 value;
+			memcpy(&value, sample, sizeof(value));
+			return (float)value;
+		}
+	}
+}
+
+bool load_exr_image(const char* filename, float_image_t* out_image)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	MappedFile file;
+	if(!file.open_for_read(filename)){
+		log_warningf("Failed to open [%s]\n", filename);
+		return false;
+	}
+
+	exr_reader_t reader = { file.get_data(), file.get_size(), 0 };
+	u32 magic = 0;
+	u32 version = 0;
+	if(!reader.read(&magic, sizeof(magic)) || !reader.read(&version, sizeof(version)) || (magic != EXR_MAGIC)){
+		log_warningf("[%s] isn't an exr\n", filename);
+		return false;
+	}
+
+	if((version & (EXR_VERSION_FLAG_TILED | EXR_VERSION_FLAG_NON_IMAGE | EXR_VERSION_FLAG_MULTIPART)) != 0){
+		log_warningf("[%s] is a tiled, deep or multipart exr, only single part scanline files load\n", filename);
+		return false;
+	}
+
+	std::vector<exr_channel_t> channels;
+	u8 compression = EXR_COMPRESSION_NONE;
+	i32 data_window[4] = { 0, 0, -1, -1 };
+	for(;;){
+		std::string name;
+		std::string type;
+		i32 attribute_size = 0;
+		if(!reader.read_string(&name)){
+			log_warningf("[%s] has a truncated header\n", filename);
+			return false;
+		}
+		if(name.empty()){
+			break;
+		}
+		if(!reader.read_string(&type) || !reader.read(&attribute_size, sizeof(attribute_size))
+			|| (attribute_size < 0) || ((reader.pos + (size_t)attribute_size) > reader.size)){
+			log_warningf("[%s] has a truncated header\n", filename);
+			return false;
+		}
+
+		const byte* value = reader.data + reader.pos;
+		if((name == "channels") && !parse_exr_channels(value, (size_t)attribute_size, &channels)){
+			log_warningf("[%s] has channels that can't be loaded\n", filename);
+			return false;
+		}else if((name == "compression") && (attribute_size >= 1)){
+			compression = value[0];
+		}else if((name == "dataWindow") && (attribute_size >= (i32)sizeof(data_window))){
+			memcpy(data_window, value, sizeof(data_window));
+		}
+		reader.pos += (size_t)attribute_size;
+	}
+
+	uint lines_per_block = get_exr_lines_per_block(compression);
+	if(lines_per_block == 0){
+		log_warningf("[%s] uses exr compression %u, save it as zip, zips, rle or uncompressed\n", filename, compression);
+		return false;
+	}
+
+	i64 width = (i64)data_window[2] - data_window[0] + 1;
+	i64 height = (i64)data_window[3] - data_window[1] + 1;
+	if((width <= 0) || (height <= 0) || (width > MAX_EXR_SIZE) || (height > MAX_EXR_SIZE) || channels.empty()){
+		log_warningf("[%s] has a bad data window or no channels\n", filename);
+		return false;
+	}
+
+	size_t line_size = 0;
+	for(const exr_channel_t& channel : channels){
+		line_size += (size_t)width * get_exr_pixel_size(channel.pixel_type);
+	}
+
+	out_image->allocate((uint)width, (uint)height);
+	for(size_t texel_idx = 0; texel_idx < (size_t)width * height; ++texel_idx){
+		out_image->texels[texel_idx * 4 + 3] = 1.0f;
+	}
+
+	uint block_count = ((uint)height + lines_per_block - 1) / lines_per_block;
+	size_t offsets_pos = reader.pos;
+	if((offsets_pos + block_count * sizeof(u64)) > reader.size){
+		log_warningf("[%s] is truncated\n", filename);
+		return false;
+	}
+
+	std::vector<byte> scratch;
+	std::vector<byte> block;
+	for(uint block_idx = 0; block_idx < block_count; ++block_idx){
+		u64 offset;
+		memcpy(&offset, reader.data + offsets_pos + block_idx * sizeof(u64), sizeof(offset));
+
+		i32 block_y = 0;
+		i32 packed_size = 0;
+		reader.pos = (size_t)offset;
+		if((offset >= reader.size) || !reader.read(&block_y, sizeof(block_y)) || !reader.read(&packed_size, sizeof(packed_size))
+			|| (packed_size < 0) || ((reader.pos + (size_t)packed_size) > reader.size)){
+			log_warningf("[%s] has a bad block %u\n", filename, block_idx);
+			return false;
+		}
+
+		i64 first_line = (i64)block_y - data_window[1];
+		if((first_line < 0) || (first_line >= height) || ((first_line % lines_per_block) != 0)){
+			log_warningf("[%s] has a block at line %i outside the image\n", filename, block_y);
+			return false;
+		}
+
+		uint line_count = Min(lines_per_block, (uint)(height - first_line));
+		size_t block_size = line_count * line_size;
+		const byte* packed = reader.data + reader.pos;
+
+		// a block that wouldn't get smaller is stored as is whatever the compression
+		const byte* lines = packed;
+		if((size_t)packed_size != block_size){
+			block.resize(block_size);
+			if((compression == EXR_COMPRESSION_NONE) || !exr_decode_block(compression, packed, (size_t)packed_size, &scratch, block.data(), block_size)){
+				log_warningf("[%s] failed to decode block %u\n", filename, block_idx);
+				return false;
+			}
+			lines = block.data();
+		}
+
+		// each line holds all of its first channel, then all of the next, channels sorted by name
+		for(uint line = 0; line < line_count; ++line){
+			float* texels = &out_image->texels[((size_t)first_line + line) * width * 4];
+			const byte* sample = lines + line * line_size;
+			for(const exr_channel_t& channel : channels){
+				uint pixel_size = get_exr_pixel_size(channel.pixel_type);
+				if(channel.target == EXR_CHANNEL_IGNORED){
+					sample += (size_t)width * pixel_size;
+					continue;
+				}
+
+				for(i64 x = 0; x < width; ++x, sample += pixel_size){
+					float value = read_exr_sample(sample, channel.pixel_type);
+					if(channel.target == EXR_CHANNEL_GREY){
+						texels[x * 4 + 0] = value;
+						texels[x * 4 + 1] = value;
+						texels[x * 4 + 2] = value;
+					}else{
+						texels[x * 4 + channel.target] = value;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------
+// Any image
+static bool load_radiance_image(const char* filename, float_image_t* out_image)
+{
+	int width = 0;
+	int height = 0;
+	int channel_count = 0;
+	float* texels = stbi_loadf(filename, &width, &height, &channel_count, 4);
+	if(texels == nullptr){
+		log_warningf("Failed to load [%s]: %s\n", filename, stbi_failure_reason());
+		return false;
+	}
+
+	out_image->allocate((uint)width, (uint)height);
+	memcpy(out_image->texels.data(), texels, (size_t)width * height * 4 * sizeof(float));
+	stbi_image_free(texels);
+	return true;
+}
+
+bool load_float_image(const char* filename, float_image_t* out_image)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	std::string extension = get_lower_extension(filename);
+	if(extension == ".exr"){
+		return load_exr_image(filename, out_image);
+	}
+	if(extension == ".hdr"){
+		return load_radiance_image(filename, out_image);
+	}
+
+	// through stbi rather than Image, which dies on a file it can't load
+	int width = 0;
+	int height = 0;
+	int channel_count = 0;
+	byte* rgba = stbi_load(filename, &width, &height, &channel_count, 4);
+	if(rgba == nullptr){
+		log_warningf("Failed to load [%s]: %s\n", filename, stbi_failure_reason());
+		return false;
+	}
+
+	Image image((uint)width, (uint)height, rgba);
+	stbi_image_free(rgba);
+	return image_to_float(image, true, out_image);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Core/image_ops.h"
+
+#include <string>
+
+// .hdr and .exr hold linear light with no upper limit
+bool is_hdr_image_file(const std::string& filename);
+
+// Radiance .hdr and OpenEXR load as the linear values they store, anything
+// else goes through the 8 bit loader and is decoded from sRGB. Alpha is 1
+// when the file has none
+bool load_float_image(const char* filename, float_image_t* out_image);
+
+// Single part scanline OpenEXR, what every hdri site and exporter writes.
+// Uncompressed, RLE, ZIPS and ZIP blocks of half, float or uint channels named
+// R, G, B, A (or Y for grey). Tiled, deep and the lossy compressions are refused
+bool load_exr_image(const char* filename, float_image_t* out_image);
@@ -0,0 +1,1026 @@
+#include "Engine/Core/image_ops.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Image.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(IMAGE_OPS_SSE2)
+	#include <emmintrin.h>
+#endif
+
+// linear values quantized to this many steps on the way back to sRGB
+#define SRGB_ENCODE_TABLE_SIZE (16384)
+
+static bool s_is_simd_enabled = true;
+
+float_image_t::float_image_t()
+	:width(0)
+	,height(0)
+{
+}
+
+void float_image_t::allocate(uint new_width, uint new_height)
+{
+	width = new_width;
+	height = new_height;
+	texels.assign((size_t)new_width * new_height * 4, 0.0f);
+}
+
+void set_image_ops_simd_enabled(bool is_enabled)
+{
+	s_is_simd_enabled = is_enabled;
+}
+
+bool is_image_ops_simd_enabled()
+{
+#if defined(IMAGE_OPS_SSE2)
+	return s_is_simd_enabled;
+#else
+	return false;
+#endif
+}
+
+const char* get_image_resize_filter_name(ImageResizeFilter filter)
+{
+	switch(filter){
+		case IMAGE_RESIZE_FILTER_BOX:		return "box";
+		case IMAGE_RESIZE_FILTER_TRIANGLE:	return "triangle";
+		case IMAGE_RESIZE_FILTER_MITCHELL:	return "mitchell";
+		default:							return "unknown";
+	}
+}
+
+// every row op goes through here, small images aren't worth a job
+template <typename OP>
+static void run_image_rows(void(*rows_cb)(const OP*, uint, uint), const OP* op, uint row_count, uint rows_per_job)
+{
+	if((rows_per_job == 0) || (row_count <= rows_per_job)){
+		rows_cb(op, 0, row_count);
+		return;
+	}
+
+	std::vector<Job*> jobs;
+	jobs.reserve((row_count + rows_per_job - 1) / rows_per_job);
+	for(uint first_row = 0; first_row < row_count; first_row += rows_per_job){
+		uint end_row = Min(first_row + rows_per_job, row_count);
+		Job* job = job_create(JOB_TYPE_GENERIC, rows_cb, op, first_row, end_row);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+// NaN goes to 0 like the SSE max/min do
+static float saturate(float value)
+{
+	value = (value > 0.0f) ? value : 0.0f;
+	return (value < 1.0f) ? value : 1.0f;
+}
+
+static byte unorm_to_byte(float value)
+{
+	return (byte)(uint)((saturate(value) * 255.0f) + 0.5f);
+}
+
+//-----------------------------------------------------
+// sRGB
+struct srgb_tables_t
+{
+	float to_linear[256];
+	byte to_srgb[SRGB_ENCODE_TABLE_SIZE];
+
+	srgb_tables_t()
+	{
+		for(uint value = 0; value < 256; ++value){
+			float srgb = (float)value / 255.0f;
+			to_linear[value] = (srgb <= 0.04045f) ? (srgb / 12.92f) : powf((srgb + 0.055f) / 1.055f, 2.4f);
+		}
+		for(uint step = 0; step < SRGB_ENCODE_TABLE_SIZE; ++step){
+			float linear = (float)step / (float)(SRGB_ENCODE_TABLE_SIZE - 1);
+			float srgb = (linear <= 0.0031308f) ? (linear * 12.92f) : ((1.055f * powf(linear, 1.0f / 2.4f)) - 0.055f);
+			to_srgb[step] = (byte)((srgb * 255.0f) + 0.5f);
+		}
+	}
+};
+
+// built on first use, function statics are thread safe
+static const srgb_tables_t& get_srgb_tables()
+{
+	static srgb_tables_t tables;
+	return tables;
+}
+
+float decode_srgb_byte(byte value)
+{
+	return get_srgb_tables().to_linear[value];
+}
+
+byte encode_srgb_byte(float value)
+{
+	uint step = (uint)((saturate(value) * (float)(SRGB_ENCODE_TABLE_SIZE - 1)) + 0.5f);
+	return get_srgb_tables().to_srgb[step];
+}
+
+// stb_image's layouts for images loaded without forcing 4 channels
+static void expand_texel(const byte* texel, int bytes_per_texel, byte* out_texel)
+{
+	switch(bytes_per_texel){
+		case 1:	out_texel[0] = texel[0]; out_texel[1] = texel[0]; out_texel[2] = texel[0]; out_texel[3] = 255; break;
+		case 2:	out_texel[0] = texel[0]; out_texel[1] = texel[0]; out_texel[2] = texel[0]; out_texel[3] = texel[1]; break;
+		case 3:	out_texel[0] = texel[0]; out_texel[1] = texel[1]; out_texel[2] = texel[2]; out_texel[3] = 255; break;
+		default: memcpy(out_texel, texel, 4); break;
+	}
+}
+
+//-----------------------------------------------------
+// To and from float
+struct image_to_float_t
+{
+	const byte* src;
+	int bytes_per_texel;
+	uint width;
+	bool is_srgb;
+	bool is_simd;
+	float* dst;
+};
+
+static void image_to_float_rows(const image_to_float_t* op, uint first_row, uint end_row)
+{
+	const srgb_tables_t& tables = get_srgb_tables();
+	const float to_unorm = 1.0f / 255.0f;
+
+	for(uint y = first_row; y < end_row; ++y){
+		const byte* src_row = op->src + ((size_t)y * op->width * op->bytes_per_texel);
+		float* dst_row = op->dst + ((size_t)y * op->width * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		// four texels a load, bytes widened to 16 then 32 bits
+		if(op->is_simd && !op->is_srgb && (op->bytes_per_texel == 4)){
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(to_unorm);
+			for(; (x + 4) <= op->width; x += 4){
+				__m128i texels = _mm_loadu_si128((const __m128i*)(src_row + (x * 4)));
+				__m128i low = _mm_unpacklo_epi8(texels, zero);
+				__m128i high = _mm_unpackhi_epi8(texels, zero);
+
+				float* dst = dst_row + (x * 4);
+				_mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+				_mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+				_mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+				_mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+			}
+		}
+#endif
+
+		// sRGB is a table lookup per channel either way, there's nothing for SIMD to do
+		for(; x < op->width; ++x){
+			byte texel[4];
+			expand_texel(src_row + ((size_t)x * op->bytes_per_texel), op->bytes_per_texel, texel);
+
+			float* dst = dst_row + (x * 4);
+			for(uint channel = 0; channel < 3; ++channel){
+				dst[channel] = op->is_srgb ? tables.to_linear[texel[channel]] : ((float)texel[channel] * to_unorm);
+			}
+			dst[3] = (float)texel[3] * to_unorm;
+		}
+	}
+}
+
+bool image_to_float(const Image& src, bool is_srgb, float_image_t* out_image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(!src.IsValid()){
+		return false;
+	}
+
+	out_image->allocate((uint)src.GetWidth(), (uint)src.GetHeight());
+
+	image_to_float_t op;
+	op.src = src.GetImageTexelBytes();
+	op.bytes_per_texel = src.GetBytesPerTexel();
+	op.width = out_image->width;
+	op.is_srgb = is_srgb;
+	op.is_simd = is_image_ops_simd_enabled();
+	op.dst = out_image->texels.data();
+	run_image_rows(image_to_float_rows, (const image_to_float_t*)&op, out_image->height, rows_per_job);
+	return true;
+}
+
+struct image_from_float_t
+{
+	const float* src;
+	uint width;
+	bool is_srgb;
+	bool is_simd;
+	byte* dst;
+};
+
+static void image_from_float_rows(const image_from_float_t* op, uint first_row, uint end_row)
+{
+	for(uint y = first_row; y < end_row; ++y){
+		const float* src_row = op->src + ((size_t)y * op->width * 4);
+		byte* dst_row = op->dst + ((size_t)y * op->width * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		if(op->is_simd){
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 half = _mm_set1_ps(0.5f);
+
+			if(op->is_srgb){
+				// rgb lanes become table steps and alpha's lane its byte, then rgb is looked up
+				const srgb_tables_t& tables = get_srgb_tables();
+				const __m128 scale = _mm_setr_ps((float)(SRGB_ENCODE_TABLE_SIZE - 1), (float)(SRGB_ENCODE_TABLE_SIZE - 1), (float)(SRGB_ENCODE_TABLE_SIZE - 1), 255.0f);
+				for(; x < op->width; ++x){
+					__m128 texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src_row + (x * 4)), zero), one);
+					__m128i steps = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(texel, scale), half));
+
+					int texel_steps[4];
+					_mm_storeu_si128((__m128i*)texel_steps, steps);
+
+					byte* dst = dst_row + (x * 4);
+					dst[0] = tables.to_srgb[texel_steps[0]];
+					dst[1] = tables.to_srgb[texel_steps[1]];
+					dst[2] = tables.to_srgb[texel_steps[2]];
+					dst[3] = (byte)texel_steps[3];
+				}
+			}else{
+				// four texels to 16 bytes with two saturating packs
+				const __m128 scale = _mm_set1_ps(255.0f);
+				for(; (x + 4) <= op->width; x += 4){
+					const float* src = src_row + (x * 4);
+					__m128i texels[4];
+					for(uint texel_idx = 0; texel_idx < 4; ++texel_idx){
+						__m128 texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + (texel_idx * 4)), zero), one);
+						texels[texel_idx] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(texel, scale), half));
+					}
+
+					__m128i low = _mm_packs_epi32(texels[0], texels[1]);
+					__m128i high = _mm_packs_epi32(texels[2], texels[3]);
+					_mm_storeu_si128((__m128i*)(dst_row + (x * 4)), _mm_packus_epi16(low, high));
+				}
+			}
+		}
+#endif
+
+		for(; x < op->width; ++x){
+			const float* src = src_row + (x * 4);
+			byte* dst = dst_row + (x * 4);
+			for(uint channel = 0; channel < 3; ++channel){
+				dst[channel] = op->is_srgb ? encode_srgb_byte(src[channel]) : unorm_to_byte(src[channel]);
+			}
+			dst[3] = unorm_to_byte(src[3]);
+		}
+	}
+}
+
+bool image_from_float(const float_image_t& src, bool is_srgb, Image* out_image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if((src.width == 0) || (src.height == 0)){
+		return false;
+	}
+
+	out_image->allocate(src.width, src.height);
+
+	image_from_float_t op;
+	op.src = src.texels.data();
+	op.width = src.width;
+	op.is_srgb = is_srgb;
+	op.is_simd = is_image_ops_simd_enabled();
+	op.dst = out_image->get_texel_bytes();
+	run_image_rows(image_from_float_rows, (const image_from_float_t*)&op, src.height, rows_per_job);
+	return true;
+}
+
+//-----------------------------------------------------
+// Resize
+static float calc_resize_filter_radius(ImageResizeFilter filter)
+{
+	switch(filter){
+		case IMAGE_RESIZE_FILTER_BOX:		return 0.5f;
+		case IMAGE_RESIZE_FILTER_TRIANGLE:	return 1.0f;
+		default:							return 2.0f;
+	}
+}
+
+static double calc_resize_filter_weight(ImageResizeFilter filter, double t)
+{
+	t = fabs(t);
+	switch(filter){
+		case IMAGE_RESIZE_FILTER_BOX:
+			return (t < 0.5) ? 1.0 : 0.0;
+
+		case IMAGE_RESIZE_FILTER_TRIANGLE:
+			return (t < 1.0) ? (1.0 - t) : 0.0;
+
+		default:{
+			const double b = 1.0 / 3.0;
+			const double c = 1.0 / 3.0;
+			if(t < 1.0){
+				return ((((12.0 - (9.0 * b) - (6.0 * c)) * t * t * t) + ((-18.0 + (12.0 * b) + (6.0 * c)) * t * t) + (6.0 - (2.0 * b))) / 6.0);
+			}
+			if(t < 2.0){
+				return ((((-b - (6.0 * c)) * t * t * t) + (((6.0 * b) + (30.0 * c)) * t * t) + (((-12.0 * b) - (48.0 * c)) * t) + ((8.0 * b) + (24.0 * c))) / 6.0);
+			}
+			return 0.0;
+		}
+	}
+}
+
+// The source texels each output texel reads and how much of each. Taps past
+// an edge are folded onto the edge texel so every output's taps are contiguous
+struct resize_taps_t
+{
+	uint max_tap_count;
+	std::vector<uint> first;
+	std::vector<uint> count;
+	std::vector<float> weights;
+};
+
+static void build_resize_taps(uint src_size, uint dst_size, ImageResizeFilter filter, resize_taps_t* out_taps)
+{
+	double scale = (double)src_size / (double)dst_size;
+	double filter_scale = Max(scale, 1.0);
+	double support = (double)calc_resize_filter_radius(filter) * filter_scale;
+
+	out_taps->max_tap_count = (uint)ceil(support * 2.0) + 2;
+	out_taps->first.assign(dst_size, 0);
+	out_taps->count.assign(dst_size, 0);
+	out_taps->weights.assign((size_t)dst_size * out_taps->max_tap_count, 0.0f);
+
+	std::vector<double> weights(out_taps->max_tap_count);
+	for(uint dst_idx = 0; dst_idx < dst_size; ++dst_idx){
+		double center = ((double)dst_idx + 0.5) * scale;
+		int low = (int)floor(center - support);
+		int high = (int)ceil(center + support);
+		int first = Clamp(low, 0, (int)src_size - 1);
+		int last = Clamp(high, 0, (int)src_size - 1);
+
+		// only the window a filter can reach, low to high is never more than max_tap_count
+		weights.assign(out_taps->max_tap_count, 0.0);
+		double total = 0.0;
+		for(int src_idx = low; src_idx <= high; ++src_idx){
+			double weight = calc_resize_filter_weight(filter, (((double)src_idx + 0.5) - center) / filter_scale);
+			weights[Clamp(src_idx, first, last) - first] += weight;
+			total += weight;
+		}
+
+		// can't happen with these filters, but nearest is a better answer than black
+		if(fabs(total) < 1e-12){
+			weights.assign(out_taps->max_tap_count, 0.0);
+			first = Clamp((int)center, 0, (int)src_size - 1);
+			last = first;
+			weights[0] = 1.0;
+			total = 1.0;
+		}
+
+		out_taps->first[dst_idx] = (uint)first;
+		out_taps->count[dst_idx] = (uint)(last - first + 1);
+		float* dst_weights = out_taps->weights.data() + ((size_t)dst_idx * out_taps->max_tap_count);
+		for(int tap = 0; tap <= (last - first); ++tap){
+			dst_weights[tap] = (float)(weights[tap] / total);
+		}
+	}
+}
+
+struct resize_pass_t
+{
+	const float* src;
+	uint src_width;
+	float* dst;
+	uint dst_width;
+	const resize_taps_t* taps;
+	bool is_simd;
+};
+
+static void resize_horizontal_rows(const resize_pass_t* pass, uint first_row, uint end_row)
+{
+	const resize_taps_t& taps = *pass->taps;
+	for(uint y = first_row; y < end_row; ++y){
+		const float* src_row = pass->src + ((size_t)y * pass->src_width * 4);
+		float* dst_row = pass->dst + ((size_t)y * pass->dst_width * 4);
+
+		for(uint x = 0; x < pass->dst_width; ++x){
+			const float* src = src_row + ((size_t)taps.first[x] * 4);
+			const float* weights = taps.weights.data() + ((size_t)x * taps.max_tap_count);
+			uint tap_count = taps.count[x];
+			float* dst = dst_row + (x * 4);
+
+#if defined(IMAGE_OPS_SSE2)
+			// a texel's four channels go through the lanes together
+			if(pass->is_simd){
+				__m128 sum = _mm_setzero_ps();
+				for(uint tap = 0; tap < tap_count; ++tap){
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + (tap * 4)), _mm_set1_ps(weights[tap])));
+				}
+				_mm_storeu_ps(dst, sum);
+				continue;
+			}
+#endif
+
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for(uint tap = 0; tap < tap_count; ++tap){
+				for(uint channel = 0; channel < 4; ++channel){
+					sum[channel] = sum[channel] + (src[(tap * 4) + channel] * weights[tap]);
+				}
+			}
+			memcpy(dst, sum, sizeof(sum));
+		}
+	}
+}
+
+// each source row is added across the whole output row, so reads stream along rows
+static void resize_vertical_rows(const resize_pass_t* pass, uint first_row, uint end_row)
+{
+	const resize_taps_t& taps = *pass->taps;
+	size_t row_floats = (size_t)pass->dst_width * 4;
+
+	for(uint y = first_row; y < end_row; ++y){
+		float* dst_row = pass->dst + ((size_t)y * row_floats);
+		const float* weights = taps.weights.data() + ((size_t)y * taps.max_tap_count);
+		memset(dst_row, 0, row_floats * sizeof(float));
+
+		for(uint tap = 0; tap < taps.count[y]; ++tap){
+			const float* src_row = pass->src + ((size_t)(taps.first[y] + tap) * row_floats);
+			float weight = weights[tap];
+			size_t idx = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+			if(pass->is_simd){
+				__m128 weight4 = _mm_set1_ps(weight);
+				for(; idx < row_floats; idx += 4){
+					__m128 sum = _mm_loadu_ps(dst_row + idx);
+					_mm_storeu_ps(dst_row + idx, _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src_row + idx), weight4)));
+				}
+			}
+#endif
+
+			for(; idx < row_floats; ++idx){
+				dst_row[idx] = dst_row[idx] + (src_row[idx] * weight);
+			}
+		}
+	}
+}
+
+bool image_resize(const float_image_t& src, uint width, uint height, ImageResizeFilter filter, float_image_t* out_image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if((src.width == 0) || (src.height == 0) || (width == 0) || (height == 0) || (&src == out_image)){
+		return false;
+	}
+
+	bool is_simd = is_image_ops_simd_enabled();
+
+	// a side that doesn't change isn't filtered
+	float_image_t horizontal;
+	const float_image_t* vertical_src = &src;
+	if(width != src.width){
+		resize_taps_t taps;
+		build_resize_taps(src.width, width, filter, &taps);
+
+		float_image_t* dst = (height != src.height) ? &horizontal : out_image;
+		dst->allocate(width, src.height);
+
+		resize_pass_t pass;
+		pass.src = src.texels.data();
+		pass.src_width = src.width;
+		pass.dst = dst->texels.data();
+		pass.dst_width = width;
+		pass.taps = &taps;
+		pass.is_simd = is_simd;
+		run_image_rows(resize_horizontal_rows, (const resize_pass_t*)&pass, src.height, rows_per_job);
+
+		vertical_src = dst;
+	}
+
+	if(height != src.height){
+		resize_taps_t taps;
+		build_resize_taps(src.height, height, filter, &taps);
+
+		out_image->allocate(width, height);
+
+		resize_pass_t pass;
+		pass.src = vertical_src->texels.data();
+		pass.src_width = width;
+		pass.dst = out_image->texels.data();
+		pass.dst_width = width;
+		pass.taps = &taps;
+		pass.is_simd = is_simd;
+		run_image_rows(resize_vertical_rows, (const resize_pass_t*)&pass, height, rows_per_job);
+	}else if(vertical_src == &src){
+		*out_image = src;
+	}
+
+	return true;
+}
+
+bool image_resize(const Image& src, uint width, uint height, ImageResizeFilter filter, bool is_srgb, Image* out_image, uint rows_per_job)
+{
+	float_image_t src_float;
+	float_image_t dst_float;
+	return image_to_float(src, is_srgb, &src_float, rows_per_job)
+		&& image_resize(src_float, width, height, filter, &dst_float, rows_per_job)
+		&& image_from_float(dst_float, is_srgb, out_image, rows_per_job);
+}
+
+//-----------------------------------------------------
+// Channel packing
+struct image_pack_t
+{
+	const byte* src[NUM_IMAGE_CHANNELS];
+	int bytes_per_texel[NUM_IMAGE_CHANNELS];
+	uint channel[NUM_IMAGE_CHANNELS];
+	byte fill_value[NUM_IMAGE_CHANNELS];
+	uint width;
+	bool is_simd;
+	byte* dst;
+};
+
+static byte get_packed_channel(const image_pack_t* op, uint dst_channel, size_t texel_idx)
+{
+	if(op->src[dst_channel] == nullptr){
+		return op->fill_value[dst_channel];
+	}
+
+	byte texel[4];
+	int bytes_per_texel = op->bytes_per_texel[dst_channel];
+	expand_texel(op->src[dst_channel] + (texel_idx * bytes_per_texel), bytes_per_texel, texel);
+	return texel[op->channel[dst_channel]];
+}
+
+static void image_pack_rows(const image_pack_t* op, uint first_row, uint end_row)
+{
+	for(uint y = first_row; y < end_row; ++y){
+		size_t row_start = (size_t)y * op->width;
+		byte* dst_row = op->dst + (row_start * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		// each channel shifted down out of its source texels and up into place, four texels at a time
+		if(op->is_simd){
+			const __m128i byte_mask = _mm_set1_epi32(0xFF);
+			for(; (x + 4) <= op->width; x += 4){
+				__m128i packed = _mm_setzero_si128();
+				for(uint dst_channel = 0; dst_channel < NUM_IMAGE_CHANNELS; ++dst_channel){
+					__m128i values;
+					if(op->src[dst_channel] == nullptr){
+						values = _mm_set1_epi32(op->fill_value[dst_channel]);
+					}else if(op->bytes_per_texel[dst_channel] == 4){
+						__m128i texels = _mm_loadu_si128((const __m128i*)(op->src[dst_channel] + ((row_start + x) * 4)));
+						values = _mm_and_si128(_mm_srl_epi32(texels, _mm_cvtsi32_si128(op->channel[dst_channel] * 8)), byte_mask);
+					}else{
+						values = _mm_setr_epi32(get_packed_channel(op, dst_channel, row_start + x),
+							get_packed_channel(op, dst_channel, row_start + x + 1),
+							get_packed_channel(op, dst_channel, row_start + x + 2),
+							get_packed_channel(op, dst_channel, row_start + x + 3));
+					}
+					packed = _mm_or_si128(packed, _mm_sll_epi32(values, _mm_cvtsi32_si128(dst_channel * 8)));
+				}
+				_mm_storeu_si128((__m128i*)(dst_row + (x * 4)), packed);
+			}
+		}
+#endif
+
+		for(; x < op->width; ++x){
+			for(uint dst_channel = 0; dst_channel < NUM_IMAGE_CHANNELS; ++dst_channel){
+				dst_row[(x * 4) + dst_channel] = get_packed_channel(op, dst_channel, row_start + x);
+			}
+		}
+	}
+}
+
+bool image_pack_channels(const image_channel_source_t* sources, Image* out_image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	int width = -1;
+	int height = -1;
+	for(uint channel = 0; channel < NUM_IMAGE_CHANNELS; ++channel){
+		const Image* image = sources[channel].image;
+		if(image == nullptr){
+			continue;
+		}
+
+		if(!image->IsValid() || (sources[channel].channel >= NUM_IMAGE_CHANNELS) || (image == out_image)){
+			return false;
+		}
+		if(width < 0){
+			width = image->GetWidth();
+			height = image->GetHeight();
+		}else if((image->GetWidth() != width) || (image->GetHeight() != height)){
+			log_warningf("Can't pack channels of a %ix%i image with a %ix%i one\n", width, height, image->GetWidth(), image->GetHeight());
+			return false;
+		}
+	}
+
+	// every channel a fill value has nothing to take the size from
+	if(width < 0){
+		return false;
+	}
+
+	out_image->allocate((uint)width, (uint)height);
+
+	image_pack_t op;
+	for(uint channel = 0; channel < NUM_IMAGE_CHANNELS; ++channel){
+		const Image* image = sources[channel].image;
+		op.src[channel] = (image != nullptr) ? image->GetImageTexelBytes() : nullptr;
+		op.bytes_per_texel[channel] = (image != nullptr) ? image->GetBytesPerTexel() : 0;
+		op.channel[channel] = sources[channel].channel;
+		op.fill_value[channel] = sources[channel].fill_value;
+	}
+	op.width = (uint)width;
+	op.is_simd = is_image_ops_simd_enabled();
+	op.dst = out_image->get_texel_bytes();
+	run_image_rows(image_pack_rows, (const image_pack_t*)&op, (uint)height, rows_per_job);
+	return true;
+}
+
+//-----------------------------------------------------
+// In place 8 bit ops
+struct image_rows_t
+{
+	byte* texels;
+	uint width;
+	bool is_simd;
+};
+
+static void renormalize_normal_rows(const image_rows_t* op, uint first_row, uint end_row)
+{
+	const float to_snorm = 2.0f / 255.0f;
+	const float min_length = 1e-6f;
+
+	for(uint y = first_row; y < end_row; ++y){
+		byte* row = op->texels + ((size_t)y * op->width * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		// four texels in SoA, one lane each. sqrt and divide are exact so this matches the scalar loop
+		if(op->is_simd){
+			const __m128i byte_mask = _mm_set1_epi32(0xFF);
+			const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+			const __m128 scale = _mm_set1_ps(to_snorm);
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 to_byte = _mm_set1_ps(255.0f);
+			for(; (x + 4) <= op->width; x += 4){
+				__m128i texels = _mm_loadu_si128((const __m128i*)(row + (x * 4)));
+				__m128 nx = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, byte_mask)), scale), one);
+				__m128 ny = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), byte_mask)), scale), one);
+				__m128 nz = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), byte_mask)), scale), one);
+
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+				__m128 is_valid = _mm_cmpgt_ps(length, _mm_set1_ps(min_length));
+				nx = _mm_and_ps(is_valid, _mm_div_ps(nx, length));
+				ny = _mm_and_ps(is_valid, _mm_div_ps(ny, length));
+				nz = _mm_or_ps(_mm_and_ps(is_valid, _mm_div_ps(nz, length)), _mm_andnot_ps(is_valid, one));
+
+				__m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(nx, half), half), to_byte), half));
+				__m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ny, half), half), to_byte), half));
+				__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(nz, half), half), to_byte), half));
+
+				__m128i packed = _mm_or_si128(_mm_and_si128(texels, alpha_mask), r);
+				packed = _mm_or_si128(packed, _mm_slli_epi32(g, 8));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(b, 16));
+				_mm_storeu_si128((__m128i*)(row + (x * 4)), packed);
+			}
+		}
+#endif
+
+		for(; x < op->width; ++x){
+			byte* texel = row + (x * 4);
+			float normal[3];
+			for(uint channel = 0; channel < 3; ++channel){
+				normal[channel] = ((float)texel[channel] * to_snorm) - 1.0f;
+			}
+
+			float length = sqrtf(((normal[0] * normal[0]) + (normal[1] * normal[1])) + (normal[2] * normal[2]));
+			if(length > min_length){
+				normal[0] = normal[0] / length;
+				normal[1] = normal[1] / length;
+				normal[2] = normal[2] / length;
+			}else{
+				normal[0] = 0.0f;
+				normal[1] = 0.0f;
+				normal[2] = 1.0f;
+			}
+
+			for(uint channel = 0; channel < 3; ++channel){
+				texel[channel] = (byte)(uint)((((normal[channel] * 0.5f) + 0.5f) * 255.0f) + 0.5f);
+			}
+		}
+	}
+}
+
+bool image_renormalize_normals(Image* normal_map, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(!normal_map->IsValid() || (normal_map->GetBytesPerTexel() != 4)){
+		return false;
+	}
+
+	image_rows_t op;
+	op.texels = normal_map->get_texel_bytes();
+	op.width = (uint)normal_map->GetWidth();
+	op.is_simd = is_image_ops_simd_enabled();
+	run_image_rows(renormalize_normal_rows, (const image_rows_t*)&op, (uint)normal_map->GetHeight(), rows_per_job);
+	return true;
+}
+
+// c * a / 255 rounded to nearest, exact for every pair: t = c * a + 128, (t + (t >> 8)) >> 8
+static void premultiply_alpha_rows(const image_rows_t* op, uint first_row, uint end_row)
+{
+	for(uint y = first_row; y < end_row; ++y){
+		byte* row = op->texels + ((size_t)y * op->width * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		// two texels per register as 16 bit lanes, alpha's own lane multiplies by 255 to keep it
+		if(op->is_simd){
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rgb_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+			const __m128i alpha_keep = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+			const __m128i bias = _mm_set1_epi16(128);
+			for(; (x + 4) <= op->width; x += 4){
+				__m128i texels = _mm_loadu_si128((const __m128i*)(row + (x * 4)));
+				__m128i halves[2] = { _mm_unpacklo_epi8(texels, zero), _mm_unpackhi_epi8(texels, zero) };
+				for(uint half_idx = 0; half_idx < 2; ++half_idx){
+					__m128i values = halves[half_idx];
+					__m128i alphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+					alphas = _mm_or_si128(_mm_and_si128(alphas, rgb_mask), alpha_keep);
+
+					__m128i products = _mm_add_epi16(_mm_mullo_epi16(values, alphas), bias);
+					halves[half_idx] = _mm_srli_epi16(_mm_add_epi16(products, _mm_srli_epi16(products, 8)), 8);
+				}
+				_mm_storeu_si128((__m128i*)(row + (x * 4)), _mm_packus_epi16(halves[0], halves[1]));
+			}
+		}
+#endif
+
+		for(; x < op->width; ++x){
+			byte* texel = row + (x * 4);
+			uint alpha = texel[3];
+			for(uint channel = 0; channel < 3; ++channel){
+				uint product = ((uint)texel[channel] * alpha) + 128;
+				texel[channel] = (byte)((product + (product >> 8)) >> 8);
+			}
+		}
+	}
+}
+
+bool image_premultiply_alpha(Image* image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(!image->IsValid() || (image->GetBytesPerTexel() != 4)){
+		return false;
+	}
+
+	image_rows_t op;
+	op.texels = image->get_texel_bytes();
+	op.width = (uint)image->GetWidth();
+	op.is_simd = is_image_ops_simd_enabled();
+	run_image_rows(premultiply_alpha_rows, (const image_rows_t*)&op, (uint)image->GetHeight(), rows_per_job);
+	return true;
+}
+
+struct float_image_rows_t
+{
+	float* texels;
+	uint width;
+	bool is_simd;
+};
+
+static void premultiply_alpha_float_rows(const float_image_rows_t* op, uint first_row, uint end_row)
+{
+	for(uint y = first_row; y < end_row; ++y){
+		float* row = op->texels + ((size_t)y * op->width * 4);
+		uint x = 0;
+
+#if defined(IMAGE_OPS_SSE2)
+		if(op->is_simd){
+			const __m128 rgb_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+			const __m128 alpha_keep = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+			for(; x < op->width; ++x){
+				__m128 texel = _mm_loadu_ps(row + (x * 4));
+				__m128 alphas = _mm_shuffle_ps(texel, texel, _MM_SHUFFLE(3, 3, 3, 3));
+				alphas = _mm_or_ps(_mm_and_ps(alphas, rgb_mask), alpha_keep);
+				_mm_storeu_ps(row + (x * 4), _mm_mul_ps(texel, alphas));
+			}
+		}
+#endif
+
+		for(; x < op->width; ++x){
+			float* texel = row + (x * 4);
+			texel[0] = texel[0] * texel[3];
+			texel[1] = texel[1] * texel[3];
+			texel[2] = texel[2] * texel[3];
+		}
+	}
+}
+
+void image_premultiply_alpha(float_image_t* image, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	float_image_rows_t op;
+	op.texels = image->texels.data();
+	op.width = image->width;
+	op.is_simd = is_image_ops_simd_enabled();
+	run_image_rows(premultiply_alpha_float_rows, (const float_image_rows_t*)&op, image->height, rows_per_job);
+}
+
+//-----------------------------------------------------
+// Commands
+enum ImageOpsBenchmark
+{
+	IMAGE_OPS_BENCHMARK_TO_FLOAT,
+	IMAGE_OPS_BENCHMARK_TO_FLOAT_SRGB,
+	IMAGE_OPS_BENCHMARK_FROM_FLOAT,
+	IMAGE_OPS_BENCHMARK_FROM_FLOAT_SRGB,
+	IMAGE_OPS_BENCHMARK_HALVE_BOX,
+	IMAGE_OPS_BENCHMARK_HALVE_TRIANGLE,
+	IMAGE_OPS_BENCHMARK_UPSCALE_MITCHELL,
+	IMAGE_OPS_BENCHMARK_PACK_CHANNELS,
+	IMAGE_OPS_BENCHMARK_RENORMALIZE,
+	IMAGE_OPS_BENCHMARK_PREMULTIPLY,
+	IMAGE_OPS_BENCHMARK_PREMULTIPLY_FLOAT,
+	NUM_IMAGE_OPS_BENCHMARKS
+};
+
+static const char* get_image_ops_benchmark_name(ImageOpsBenchmark benchmark)
+{
+	switch(benchmark){
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT:			return "to float";
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT_SRGB:		return "to float (srgb)";
+		case IMAGE_OPS_BENCHMARK_FROM_FLOAT:		return "from float";
+		case IMAGE_OPS_BENCHMARK_FROM_FLOAT_SRGB:	return "from float (srgb)";
+		case IMAGE_OPS_BENCHMARK_HALVE_BOX:			return "halve (box)";
+		case IMAGE_OPS_BENCHMARK_HALVE_TRIANGLE:	return "halve (triangle)";
+		case IMAGE_OPS_BENCHMARK_UPSCALE_MITCHELL:	return "1.5x (mitchell)";
+		case IMAGE_OPS_BENCHMARK_PACK_CHANNELS:		return "pack channels";
+		case IMAGE_OPS_BENCHMARK_RENORMALIZE:		return "renormalize";
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY:		return "premultiply";
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY_FLOAT:	return "premultiply (float)";
+		default:									return "unknown";
+	}
+}
+
+struct image_ops_benchmark_data_t
+{
+	Image source;
+	Image mask;
+	float_image_t source_float;
+
+	Image result;
+	float_image_t result_float;
+};
+
+// runs one op over the source and leaves its output in result or result_float,
+// returns the seconds the op took and the megapixels of the larger of its input and output
+static double run_image_ops_benchmark(ImageOpsBenchmark benchmark, image_ops_benchmark_data_t* data, uint rows_per_job, double* out_megapixels)
+{
+	uint width = (uint)data->source.GetWidth();
+	uint height = (uint)data->source.GetHeight();
+	*out_megapixels = ((double)width * (double)height) / 1000000.0;
+
+	// in place ops get a fresh copy outside the timing
+	switch(benchmark){
+		case IMAGE_OPS_BENCHMARK_RENORMALIZE:
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY:
+			data->result.allocate(width, height);
+			memcpy(data->result.get_texel_bytes(), data->source.GetImageTexelBytes(), (size_t)width * height * 4);
+			break;
+
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY_FLOAT:
+			data->result_float = data->source_float;
+			break;
+
+		default:
+			break;
+	}
+
+	double start = get_current_time_seconds();
+	switch(benchmark){
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT:			image_to_float(data->source, false, &data->result_float, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT_SRGB:		image_to_float(data->source, true, &data->result_float, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_FROM_FLOAT:		image_from_float(data->source_float, false, &data->result, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_FROM_FLOAT_SRGB:	image_from_float(data->source_float, true, &data->result, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_HALVE_BOX:			image_resize(data->source_float, width / 2, height / 2, IMAGE_RESIZE_FILTER_BOX, &data->result_float, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_HALVE_TRIANGLE:	image_resize(data->source_float, width / 2, height / 2, IMAGE_RESIZE_FILTER_TRIANGLE, &data->result_float, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_UPSCALE_MITCHELL:	image_resize(data->source_float, (width * 3) / 2, (height * 3) / 2, IMAGE_RESIZE_FILTER_MITCHELL, &data->result_float, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_RENORMALIZE:		image_renormalize_normals(&data->result, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY:		image_premultiply_alpha(&data->result, rows_per_job); break;
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY_FLOAT:	image_premultiply_alpha(&data->result_float, rows_per_job); break;
+
+		case IMAGE_OPS_BENCHMARK_PACK_CHANNELS:{
+			// the usual occlusion/roughness/metalness layout out of two images
+			image_channel_source_t sources[NUM_IMAGE_CHANNELS] = {
+				{ &data->mask, IMAGE_CHANNEL_RED, 0 },
+				{ &data->source, IMAGE_CHANNEL_GREEN, 0 },
+				{ &data->source, IMAGE_CHANNEL_BLUE, 0 },
+				{ nullptr, IMAGE_CHANNEL_ALPHA, 255 },
+			};
+			image_pack_channels(sources, &data->result, rows_per_job);
+		} break;
+
+		default:
+			break;
+	}
+	double seconds = get_current_time_seconds() - start;
+
+	if(benchmark == IMAGE_OPS_BENCHMARK_UPSCALE_MITCHELL){
+		*out_megapixels = ((double)data->result_float.width * (double)data->result_float.height) / 1000000.0;
+	}
+	return seconds;
+}
+
+static bool is_float_image_benchmark(ImageOpsBenchmark benchmark)
+{
+	switch(benchmark){
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT:
+		case IMAGE_OPS_BENCHMARK_TO_FLOAT_SRGB:
+		case IMAGE_OPS_BENCHMARK_HALVE_BOX:
+		case IMAGE_OPS_BENCHMARK_HALVE_TRIANGLE:
+		case IMAGE_OPS_BENCHMARK_UPSCALE_MITCHELL:
+		case IMAGE_OPS_BENCHMARK_PREMULTIPLY_FLOAT:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+COMMAND(image_ops_benchmark, "[uint:size] Times every image op scalar, SSE2 on one job and SSE2 on the job system, in megapixels a second")
+{
+	uint size = args.is_at_end() ? 2048 : args.next_uint_arg();
+	size = Clamp(size, 4U, 8192U);
+
+	// random texels, but the same ones every run
+	image_ops_benchmark_data_t data;
+	data.source.allocate(size, size);
+	byte* texels = data.source.get_texel_bytes();
+	u32 state = 0x12345678U;
+	for(size_t byte_idx = 0; byte_idx < (size_t)size * size * 4; ++byte_idx){
+		state = (state * 1664525U) + 1013904223U;
+		texels[byte_idx] = (byte)(state >> 24);
+	}
+
+	// a grey mask made from the source's alpha
+	data.mask.allocate(size, size);
+	byte* mask_texels = data.mask.get_texel_bytes();
+	for(size_t texel_idx = 0; texel_idx < (size_t)size * size; ++texel_idx){
+		memset(mask_texels + (texel_idx * 4), texels[(texel_idx * 4) + 3], 4);
+	}
+	image_to_float(data.source, false, &data.source_float);
+
+	bool was_simd_enabled = is_image_ops_simd_enabled();
+	console_info("----Image ops %ux%u, MP/s----", size, size);
+	console_info("%-22s %10s %10s %10s", "", "scalar", "sse2", "sse2 jobs");
+
+	std::vector<byte> scalar_result;
+	for(uint benchmark_idx = 0; benchmark_idx < NUM_IMAGE_OPS_BENCHMARKS; ++benchmark_idx){
+		ImageOpsBenchmark benchmark = (ImageOpsBenchmark)benchmark_idx;
+		bool is_float_result = is_float_image_benchmark(benchmark);
+		double megapixels = 0.0;
+
+		set_image_ops_simd_enabled(false);
+		double scalar_seconds = run_image_ops_benchmark(benchmark, &data, 0xFFFFFFFF, &megapixels);
+		if(is_float_result){
+			const byte* result = (const byte*)data.result_float.texels.data();
+			scalar_result.assign(result, result + (data.result_float.texels.size() * sizeof(float)));
+		}else{
+			const byte* result = data.result.GetImageTexelBytes();
+			scalar_result.assign(result, result + ((size_t)data.result.GetWidth() * data.result.GetHeight() * 4));
+		}
+
+		set_image_ops_simd_enabled(true);
+		double simd_seconds = run_image_ops_benchmark(benchmark, &data, 0xFFFFFFFF, &megapixels);
+		double jobs_seconds = run_image_ops_benchmark(benchmark, &data, DEFAULT_IMAGE_OPS_ROWS_PER_JOB, &megapixels);
+
+		const void* simd_result = is_float_result ? (const void*)data.result_float.texels.data() : (const void*)data.result.GetImageTexelBytes();
+		bool matches = (memcmp(simd_result, scalar_result.data(), scalar_result.size()) == 0);
+
+		console_info("%-22s %10.1f %10.1f %10.1f%s",
+			get_image_ops_benchmark_name(benchmark),
+			megapixels / scalar_seconds, megapixels / simd_seconds, megapixels / jobs_seconds,
+			matches ? "" : "  SIMD OUTPUT DIFFERS");
+	}
+
+	set_image_ops_simd_enabled(was_simd_enabled);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+
+#include <vector>
+
+class Image;
+
+// texel rows one job works on
+#define DEFAULT_IMAGE_OPS_ROWS_PER_JOB (32)
+
+// SSE2 is there on every x64 target, anything else gets the scalar loops
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+	#define IMAGE_OPS_SSE2
+#endif
+
+enum ImageResizeFilter
+{
+	// average of the texels each output texel covers, the mip filter
+	IMAGE_RESIZE_FILTER_BOX,
+
+	// tent over two output texels, soft
+	IMAGE_RESIZE_FILTER_TRIANGLE,
+
+	// Mitchell-Netravali (B = C = 1/3), sharper with a little ringing
+	IMAGE_RESIZE_FILTER_MITCHELL,
+	NUM_IMAGE_RESIZE_FILTERS
+};
+
+enum ImageChannel
+{
+	IMAGE_CHANNEL_RED,
+	IMAGE_CHANNEL_GREEN,
+	IMAGE_CHANNEL_BLUE,
+	IMAGE_CHANNEL_ALPHA,
+	NUM_IMAGE_CHANNELS
+};
+
+// RGBA float texels, rows tightly packed
+struct float_image_t
+{
+	uint width;
+	uint height;
+	std::vector<float> texels;
+
+	float_image_t();
+	void allocate(uint width, uint height);
+};
+
+// where one channel of a packed image comes from, a null image fills it with fill_value
+struct image_channel_source_t
+{
+	const Image* image;
+	ImageChannel channel;
+	byte fill_value;
+};
+
+// Every op picks SSE2 or scalar loops the same way, and both give bit identical
+// results. Turning SIMD off is for comparing and debugging, it doesn't fix anything
+void set_image_ops_simd_enabled(bool is_enabled);
+bool is_image_ops_simd_enabled();
+const char* get_image_resize_filter_name(ImageResizeFilter filter);
+
+// sRGB byte to linear, a table of the exact curve
+float decode_srgb_byte(byte value);
+
+// linear back through a 16384 step table, fine enough that every byte survives the round trip.
+// Out of range values (and NaN) saturate
+byte encode_srgb_byte(float value);
+
+// 8 bit RGBA to float and back. is_srgb decodes/encodes rgb with the sRGB curve,
+// alpha is always linear. Images that aren't 4 bytes a texel are expanded going in
+bool image_to_float(const Image& src, bool is_srgb, float_image_t* out_image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+bool image_from_float(const float_image_t& src, bool is_srgb, Image* out_image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+
+// separable, edges clamp. The 8 bit version filters sRGB images in linear light
+bool image_resize(const float_image_t& src, uint width, uint height, ImageResizeFilter filter, float_image_t* out_image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+bool image_resize(const Image& src, uint width, uint height, ImageResizeFilter filter, bool is_srgb, Image* out_image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+
+// one RGBA8 image from a channel of up to four others, metal/rough/ao into one texture.
+// Every source image has to be the same size
+bool image_pack_channels(const image_channel_source_t* sources, Image* out_image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+
+// rgb back to unit length after filtering or painting, a zero vector becomes straight up
+bool image_renormalize_normals(Image* normal_map, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+
+// rgb *= alpha. The 8 bit version multiplies the stored values and rounds exactly,
+// premultiply a float image if it needs doing in linear light
+bool image_premultiply_alpha(Image* image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
+void image_premultiply_alpha(float_image_t* image, uint rows_per_job = DEFAULT_IMAGE_OPS_ROWS_PER_JOB);
@@ -0,0 +1,87 @@
+#include "Engine/Core/mapped_file.h"
+#include "Engine/Core/log.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+MappedFile::MappedFile()
+	:m_file(INVALID_HANDLE_VALUE)
+	,m_mapping(nullptr)
+	,m_data(nullptr)
+	,m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open_for_read(const char* filename)
+{
+	close();
+
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(m_file == INVALID_HANDLE_VALUE){
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(m_file, &file_size) || file_size.QuadPart == 0){
+		// can't map an empty file
+		close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_mapping == nullptr){
+		log_warningf("Failed to create file mapping for [%s]\n", filename);
+		close();
+		return false;
+	}
+
+	m_data = (const byte*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if(m_data == nullptr){
+		log_warningf("Failed to map view of [%s]\n", filename);
+		close();
+		return false;
+	}
+
+	m_size = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(m_data != nullptr){
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if(m_mapping != nullptr){
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if(m_file != INVALID_HANDLE_VALUE){
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+
+	m_size = 0;
+}
+
+bool MappedFile::is_open() const
+{
+	return m_data != nullptr;
+}
+
+const byte* MappedFile::get_data() const
+{
+	return m_data;
+}
+
+size_t MappedFile::get_size() const
+{
+	return m_size;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+
+// Read only view of a whole file through the os's memory mapping, pages are
+// faulted in on first touch so nothing is read until it's used and nothing
+// is copied out of the page cache.
+class MappedFile
+{
+public:
+	void* m_file;
+	void* m_mapping;
+	const byte* m_data;
+	size_t m_size;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open_for_read(const char* filename);
+	void close();
+	bool is_open() const;
+
+	const byte* get_data() const;
+	size_t get_size() const;
+};
@@ -1,5 +1,7 @@
 #include "Engine/Math/AABB3.hpp"
 #include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/Matrix4.hpp"
+#include <math.h>
 
 AABB3::AABB3()
 {
@@ -61,6 +63,11 @@ void AABB3::StretchToIncludePoint(const Vector3& point){
 	}
 }
 
+void AABB3::StretchToIncludeAABB3(const AABB3& other){
+	StretchToIncludePoint(other.mins);
+	StretchToIncludePoint(other.maxs);
+}
+
 void AABB3::AddPaddingToSides(float xPadRadius, float yPadRadius, float zPadRadius){
 	mins.x -= xPadRadius;
 	maxs.x += xPadRadius;
@@ -107,6 +114,29 @@ Vector3 AABB3::CalcCenter() const{
 	return maxs - halfSize;
 }
 
+Vector3 AABB3::CalcHalfExtents() const{
+	return CalcSize() * .5f;
+}
+
+// Arvo's method, the box stays axis aligned and grows to hold the rotated corners
+AABB3 AABB3::GetTransformed(const Matrix4& transform) const{
+	Vector3 center = CalcCenter();
+	Vector3 extents = CalcHalfExtents();
+	const float* m = transform.data;
+
+	Vector3 new_center;
+	new_center.x = (m[0] * center.x) + (m[1] * center.y) + (m[2] * center.z) + m[3];
+	new_center.y = (m[4] * center.x) + (m[5] * center.y) + (m[6] * center.z) + m[7];
+	new_center.z = (m[8] * center.x) + (m[9] * center.y) + (m[10] * center.z) + m[11];
+
+	Vector3 new_extents;
+	new_extents.x = (fabsf(m[0]) * extents.x) + (fabsf(m[1]) * extents.y) + (fabsf(m[2]) * extents.z);
+	new_extents.y = (fabsf(m[4]) * extents.x) + (fabsf(m[5]) * extents.y) + (fabsf(m[6]) * extents.z);
+	new_extents.z = (fabsf(m[8]) * extents.x) + (fabsf(m[9]) * extents.y) + (fabsf(m[10]) * extents.z);
+
+	return AABB3(new_center - new_extents, new_center + new_extents);
+}
+
 Vector3 AABB3::CalcClosestPoint(const Vector3& point) const{
 	Vector3 closestPoint;
 	closestPoint.x = Clamp(point.x, mins.x, maxs.x);
@@ -2,6 +2,8 @@
 
 #include "Engine/Math/Vector3.hpp"
 
+class Matrix4;
+
 class AABB3{
 public:
 	Vector3 mins;
@@ -17,10 +19,13 @@ public:
 	void			StretchToIncludePoint(const Vector3& point);
 	void			AddPaddingToSides(float xPadRadius, float yPadRadius, float zPadRadius);
 	void			Translate(const Vector3& translation);
+	void			StretchToIncludeAABB3(const AABB3& other);
 
 	bool			IsPointInside(const Vector3& point)											const;
 	Vector3			CalcSize()																	const;
 	Vector3			CalcCenter()																const;
+	Vector3			CalcHalfExtents()															const;
+	AABB3			GetTransformed(const Matrix4& transform)									const;
 
 	Vector3			CalcClosestPoint(const Vector3& point)										const;
 	Vector3			CalcBoundedPointByPercent(float xPercent, float yPercent, float zPercent)	const;
@@ -0,0 +1,916 @@
+#include "Engine/Math/BVH.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#define BVH_RAY_EPSILON (1e-20f)
+#define BVH_RAY_INFINITY (1e30f)
+
+struct bvh_traversal_entry_t
+{
+	uint node;
+	uint plane_mask;
+};
+
+struct bvh_sah_bin_t
+{
+	AABB3 bounds;
+	uint count;
+};
+
+static float calc_surface_area(const AABB3& bounds)
+{
+	Vector3 size = bounds.CalcSize();
+	return 2.0f * ((size.x * size.y) + (size.y * size.z) + (size.z * size.x));
+}
+
+static bool are_aabb3s_equal(const AABB3& a, const AABB3& b)
+{
+	return memcmp(&a, &b, sizeof(AABB3)) == 0;
+}
+
+static Vector3 calc_safe_inverse_direction(const Vector3& direction)
+{
+	Vector3 inv_dir;
+	const float* dir = direction.GetAsFloatArray();
+	float* inv = inv_dir.GetAsFloatArray();
+	for(uint axis = 0; axis < 3; ++axis){
+		if(fabsf(dir[axis]) < BVH_RAY_EPSILON){
+			inv[axis] = (dir[axis] < 0.0f) ? -BVH_RAY_INFINITY : BVH_RAY_INFINITY;
+		}else{
+			inv[axis] = 1.0f / dir[axis];
+		}
+	}
+	return inv_dir;
+}
+
+// slab test, out_entry is 0 when the ray starts inside the box
+static bool does_ray_hit_aabb3(const AABB3& bounds, const Vector3& start, const Vector3& inv_dir, float max_distance, float* out_entry)
+{
+	float t_min = 0.0f;
+	float t_max = max_distance;
+
+	const float* mins = bounds.mins.GetAsFloatArray();
+	const float* maxs = bounds.maxs.GetAsFloatArray();
+	const float* origin = start.GetAsFloatArray();
+	const float* inv = inv_dir.GetAsFloatArray();
+
+	for(uint axis = 0; axis < 3; ++axis){
+		float t0 = (mins[axis] - origin[axis]) * inv[axis];
+		float t1 = (maxs[axis] - origin[axis]) * inv[axis];
+		if(t0 > t1){
+			float temp = t0;
+			t0 = t1;
+			t1 = temp;
+		}
+
+		t_min = Max(t_min, t0);
+		t_max = Min(t_max, t1);
+		if(t_min > t_max){
+			return false;
+		}
+	}
+
+	*out_entry = t_min;
+	return true;
+}
+
+static bool does_sphere_touch_aabb3(const AABB3& bounds, const Vector3& center, float radius_squared)
+{
+	Vector3 closest = bounds.CalcClosestPoint(center);
+	return (closest - center).CalcLengthSquared() <= radius_squared;
+}
+
+// clears the bit of every plane the box is fully in front of, returns false if it's fully behind any of them
+static bool classify_aabb3_against_frustum(const AABB3& bounds, const Frustum& frustum, uint* in_out_plane_mask)
+{
+	Vector3 center = bounds.CalcCenter();
+	Vector3 extents = bounds.CalcHalfExtents();
+
+	uint mask = *in_out_plane_mask;
+	for(uint plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+		uint plane_bit = 1 << plane_idx;
+		if((mask & plane_bit) == 0){
+			continue;
+		}
+
+		const Plane3& plane = frustum.m_planes[plane_idx];
+		float dist = plane.CalcSignedDistanceToPoint(center);
+		float radius = (fabsf(plane.m_normal.x) * extents.x) + (fabsf(plane.m_normal.y) * extents.y) + (fabsf(plane.m_normal.z) * extents.z);
+
+		if(dist + radius < 0.0f){
+			return false;
+		}
+
+		if(dist - radius >= 0.0f){
+			mask &= ~plane_bit;
+		}
+	}
+
+	*in_out_plane_mask = mask;
+	return true;
+}
+
+static void bvh_build_subtree_job(BVH* bvh, std::vector<bvh_node_t>* nodes, uint first, uint count)
+{
+	bvh->build_subtree(nodes, first, count);
+}
+
+BVH::BVH(uint max_leaf_size)
+	:m_max_leaf_size(Max(1U, max_leaf_size))
+	,m_build_cost(0.0f)
+{
+}
+
+void BVH::clear()
+{
+	m_nodes.clear();
+	m_item_indices.clear();
+	m_item_bounds.clear();
+	m_item_leaves.clear();
+	m_build_centers.clear();
+	m_build_cost = 0.0f;
+}
+
+void BVH::build(const AABB3* item_bounds, uint item_count)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	begin_build(item_bounds, item_count);
+	if(item_count > 0){
+		build_subtree(&m_nodes, 0, item_count);
+	}
+	finish_build();
+}
+
+void BVH::build_parallel(const AABB3* item_bounds, uint item_count, uint items_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	items_per_job = Max(m_max_leaf_size, items_per_job);
+
+	// not worth the job overhead for a single subtree
+	if(item_count <= items_per_job){
+		build(item_bounds, item_count);
+		return;
+	}
+
+	begin_build(item_bounds, item_count);
+
+	bvh_node_t root;
+	root.first = 0;
+	root.count = item_count;
+	root.parent = INVALID_BVH_INDEX;
+	m_nodes.push_back(root);
+
+	// split serially until every open node is small enough to hand to a job
+	std::vector<uint> job_roots;
+	std::vector<uint> stack;
+	stack.push_back(0);
+	while(!stack.empty()){
+		uint node_idx = stack.back();
+		stack.pop_back();
+
+		if(m_nodes[node_idx].count <= items_per_job){
+			job_roots.push_back(node_idx);
+			continue;
+		}
+
+		if(split_node(&m_nodes, node_idx)){
+			stack.push_back(m_nodes[node_idx].first + 1);
+			stack.push_back(m_nodes[node_idx].first);
+		}
+	}
+
+	// subtrees own disjoint ranges of m_item_indices so they can partition them in place side by side
+	std::vector<std::vector<bvh_node_t>> subtrees(job_roots.size());
+	std::vector<Job*> jobs;
+	jobs.reserve(job_roots.size());
+
+	for(size_t root_idx = 0; root_idx < job_roots.size(); ++root_idx){
+		const bvh_node_t& job_root = m_nodes[job_roots[root_idx]];
+		Job* job = job_create(JOB_TYPE_GENERIC, bvh_build_subtree_job, this, &subtrees[root_idx], job_root.first, job_root.count);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+
+	for(size_t root_idx = 0; root_idx < job_roots.size(); ++root_idx){
+		append_subtree(job_roots[root_idx], subtrees[root_idx]);
+	}
+
+	finish_build();
+}
+
+void BVH::build_subtree(std::vector<bvh_node_t>* nodes, uint first, uint count)
+{
+	nodes->clear();
+	nodes->reserve((2 * count) / m_max_leaf_size + 1);
+
+	bvh_node_t root;
+	root.first = first;
+	root.count = count;
+	root.parent = INVALID_BVH_INDEX;
+	nodes->push_back(root);
+
+	std::vector<uint> stack;
+	stack.push_back(0);
+	while(!stack.empty()){
+		uint node_idx = stack.back();
+		stack.pop_back();
+
+		if(split_node(nodes, node_idx)){
+			stack.push_back((*nodes)[node_idx].first + 1);
+			stack.push_back((*nodes)[node_idx].first);
+		}
+	}
+}
+
+void BVH::begin_build(const AABB3* item_bounds, uint item_count)
+{
+	clear();
+
+	m_item_bounds.assign(item_bounds, item_bounds + item_count);
+	m_item_indices.resize(item_count);
+	m_item_leaves.resize(item_count, INVALID_BVH_INDEX);
+	m_build_centers.resize(item_count);
+
+	for(uint item = 0; item < item_count; ++item){
+		m_item_indices[item] = item;
+		m_build_centers[item] = m_item_bounds[item].CalcCenter();
+	}
+
+	m_nodes.reserve((2 * item_count) / m_max_leaf_size + 1);
+}
+
+void BVH::finish_build()
+{
+	for(uint node_idx = 0; node_idx < (uint)m_nodes.size(); ++node_idx){
+		const bvh_node_t& node = m_nodes[node_idx];
+		for(uint idx = node.first; idx < node.first + node.count; ++idx){
+			m_item_leaves[m_item_indices[idx]] = node_idx;
+		}
+	}
+
+	m_build_centers.clear();
+	m_build_centers.shrink_to_fit();
+	m_build_cost = calc_cost();
+}
+
+// Computes the node's bounds, then either leaves it as a leaf (returns false) or
+// partitions its items with a binned SAH and appends its two children.
+bool BVH::split_node(std::vector<bvh_node_t>* nodes, uint node_idx)
+{
+	uint first = (*nodes)[node_idx].first;
+	uint count = (*nodes)[node_idx].count;
+
+	AABB3 bounds = m_item_bounds[m_item_indices[first]];
+	AABB3 center_bounds(m_build_centers[m_item_indices[first]], m_build_centers[m_item_indices[first]]);
+	for(uint idx = first + 1; idx < first + count; ++idx){
+		uint item = m_item_indices[idx];
+		bounds.StretchToIncludeAABB3(m_item_bounds[item]);
+		center_bounds.StretchToIncludePoint(m_build_centers[item]);
+	}
+	(*nodes)[node_idx].bounds = bounds;
+
+	if(count <= m_max_leaf_size){
+		return false;
+	}
+
+	const float* center_mins = center_bounds.mins.GetAsFloatArray();
+	Vector3 center_size = center_bounds.CalcSize();
+	const float* center_extent = center_size.GetAsFloatArray();
+
+	uint best_axis = INVALID_BVH_INDEX;
+	uint best_split = 0;
+	float best_cost = 0.0f;
+
+	for(uint axis = 0; axis < 3; ++axis){
+		if(center_extent[axis] <= 0.0f){
+			continue;
+		}
+
+		bvh_sah_bin_t bins[BVH_SAH_BIN_COUNT];
+		for(uint bin_idx = 0; bin_idx < BVH_SAH_BIN_COUNT; ++bin_idx){
+			bins[bin_idx].count = 0;
+		}
+
+		float bin_scale = (float)BVH_SAH_BIN_COUNT / center_extent[axis];
+		for(uint idx = first; idx < first + count; ++idx){
+			uint item = m_item_indices[idx];
+			uint bin_idx = Min((uint)((m_build_centers[item].GetAsFloatArray()[axis] - center_mins[axis]) * bin_scale), (uint)(BVH_SAH_BIN_COUNT - 1));
+
+			if(bins[bin_idx].count == 0){
+				bins[bin_idx].bounds = m_item_bounds[item];
+			}else{
+				bins[bin_idx].bounds.StretchToIncludeAABB3(m_item_bounds[item]);
+			}
+			bins[bin_idx].count++;
+		}
+
+		// sweep from the right so every split plane can be priced in one pass from the left
+		float right_area[BVH_SAH_BIN_COUNT];
+		uint right_count[BVH_SAH_BIN_COUNT];
+		AABB3 accumulated;
+		uint accumulated_count = 0;
+		for(uint bin_idx = BVH_SAH_BIN_COUNT - 1; bin_idx > 0; --bin_idx){
+			if(bins[bin_idx].count > 0){
+				if(accumulated_count == 0){
+					accumulated = bins[bin_idx].bounds;
+				}else{
+					accumulated.StretchToIncludeAABB3(bins[bin_idx].bounds);
+				}
+				accumulated_count += bins[bin_idx].count;
+			}
+			right_area[bin_idx] = (accumulated_count > 0) ? calc_surface_area(accumulated) : 0.0f;
+			right_count[bin_idx] = accumulated_count;
+		}
+
+		accumulated_count = 0;
+		for(uint split = 1; split < BVH_SAH_BIN_COUNT; ++split){
+			const bvh_sah_bin_t& bin = bins[split - 1];
+			if(bin.count > 0){
+				if(accumulated_count == 0){
+					accumulated = bin.bounds;
+				}else{
+					accumulated.StretchToIncludeAABB3(bin.bounds);
+				}
+				accumulated_count += bin.count;
+			}
+
+			if(accumulated_count == 0 || right_count[split] == 0){
+				continue;
+			}
+
+			float cost = (calc_surface_area(accumulated) * (float)accumulated_count) + (right_area[split] * (float)right_count[split]);
+			if(best_axis == INVALID_BVH_INDEX || cost < best_cost){
+				best_axis = axis;
+				best_split = split;
+				best_cost = cost;
+			}
+		}
+	}
+
+	uint left_count = 0;
+	if(best_axis != INVALID_BVH_INDEX){
+		float bin_scale = (float)BVH_SAH_BIN_COUNT / center_extent[best_axis];
+		uint* begin = m_item_indices.data() + first;
+		uint* end = begin + count;
+		uint* middle = std::partition(begin, end, [&](uint item){
+			uint bin_idx = Min((uint)((m_build_centers[item].GetAsFloatArray()[best_axis] - center_mins[best_axis]) * bin_scale), (uint)(BVH_SAH_BIN_COUNT - 1));
+			return bin_idx < best_split;
+		});
+		left_count = (uint)(middle - begin);
+	}
+
+	// every center lands in the same spot, any split is as good as another
+	if(left_count == 0 || left_count == count){
+		left_count = count / 2;
+	}
+
+	bvh_node_t left;
+	left.first = first;
+	left.count = left_count;
+	left.parent = node_idx;
+
+	bvh_node_t right;
+	right.first = first + left_count;
+	right.count = count - left_count;
+	right.parent = node_idx;
+
+	uint left_idx = (uint)nodes->size();
+	nodes->push_back(left);
+	nodes->push_back(right);
+
+	(*nodes)[node_idx].first = left_idx;
+	(*nodes)[node_idx].count = 0;
+	return true;
+}
+
+// Copies a job built subtree into m_nodes.  Its root replaces the placeholder
+// leaf at root_idx, the rest are appended and have their child / parent indices rebased.
+void BVH::append_subtree(uint root_idx, const std::vector<bvh_node_t>& subtree)
+{
+	uint base = (uint)m_nodes.size() - 1;
+
+	bvh_node_t root = subtree[0];
+	root.parent = m_nodes[root_idx].parent;
+	if(root.count == 0){
+		root.first += base;
+	}
+	m_nodes[root_idx] = root;
+
+	for(size_t local_idx = 1; local_idx < subtree.size(); ++local_idx){
+		bvh_node_t node = subtree[local_idx];
+		if(node.count == 0){
+			node.first += base;
+		}
+		node.parent = (node.parent == 0) ? root_idx : node.parent + base;
+		m_nodes.push_back(node);
+	}
+}
+
+AABB3 BVH::calc_node_bounds(uint node_idx) const
+{
+	const bvh_node_t& node = m_nodes[node_idx];
+	if(node.count == 0){
+		AABB3 bounds = m_nodes[node.first].bounds;
+		bounds.StretchToIncludeAABB3(m_nodes[node.first + 1].bounds);
+		return bounds;
+	}
+
+	AABB3 bounds = m_item_bounds[m_item_indices[node.first]];
+	for(uint idx = node.first + 1; idx < node.first + node.count; ++idx){
+		bounds.StretchToIncludeAABB3(m_item_bounds[m_item_indices[idx]]);
+	}
+	return bounds;
+}
+
+void BVH::refit_item(uint item, const AABB3& bounds)
+{
+	m_item_bounds[item] = bounds;
+
+	uint node_idx = m_item_leaves[item];
+	while(node_idx != INVALID_BVH_INDEX){
+		AABB3 node_bounds = calc_node_bounds(node_idx);
+		if(are_aabb3s_equal(node_bounds, m_nodes[node_idx].bounds)){
+			break;
+		}
+
+		m_nodes[node_idx].bounds = node_bounds;
+		node_idx = m_nodes[node_idx].parent;
+	}
+}
+
+void BVH::set_item_bounds(uint item, const AABB3& bounds)
+{
+	m_item_bounds[item] = bounds;
+}
+
+void BVH::refit()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	for(size_t node_idx = m_nodes.size(); node_idx-- > 0;){
+		m_nodes[node_idx].bounds = calc_node_bounds((uint)node_idx);
+	}
+}
+
+// expected cost of a random query, traversal and item tests weighted equally
+float BVH::calc_cost() const
+{
+	if(m_nodes.empty()){
+		return 0.0f;
+	}
+
+	float root_area = calc_surface_area(m_nodes[0].bounds);
+	if(root_area <= 0.0f){
+		return 0.0f;
+	}
+
+	float cost = 0.0f;
+	for(const bvh_node_t& node : m_nodes){
+		float weight = (node.count == 0) ? 1.0f : (float)node.count;
+		cost += calc_surface_area(node.bounds) * weight;
+	}
+
+	return cost / root_area;
+}
+
+bool BVH::needs_rebuild(float max_cost_ratio) const
+{
+	if(m_build_cost <= 0.0f){
+		return false;
+	}
+
+	return calc_cost() > (m_build_cost * max_cost_ratio);
+}
+
+void BVH::query_frustum(const Frustum& frustum, std::vector<uint>* out_items) const
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_items->clear();
+	if(m_nodes.empty()){
+		return;
+	}
+
+	// once a node is fully in front of a plane, nothing under it needs testing against that plane again
+	std::vector<bvh_traversal_entry_t> stack;
+	stack.reserve(64);
+
+	bvh_traversal_entry_t root;
+	root.node = 0;
+	root.plane_mask = (1 << NUM_FRUSTUM_PLANES) - 1;
+	stack.push_back(root);
+
+	while(!stack.empty()){
+		bvh_traversal_entry_t entry = stack.back();
+		stack.pop_back();
+
+		const bvh_node_t& node = m_nodes[entry.node];
+		if(entry.plane_mask != 0 && !classify_aabb3_against_frustum(node.bounds, frustum, &entry.plane_mask)){
+			continue;
+		}
+
+		if(node.count == 0){
+			bvh_traversal_entry_t child;
+			child.plane_mask = entry.plane_mask;
+			child.node = node.first + 1;
+			stack.push_back(child);
+			child.node = node.first;
+			stack.push_back(child);
+			continue;
+		}
+
+		for(uint idx = node.first; idx < node.first + node.count; ++idx){
+			uint item = m_item_indices[idx];
+			uint item_mask = entry.plane_mask;
+			if(item_mask == 0 || classify_aabb3_against_frustum(m_item_bounds[item], frustum, &item_mask)){
+				out_items->push_back(item);
+			}
+		}
+	}
+}
+
+void BVH::query_sphere(const Vector3& center, float radius, std::vector<uint>* out_items) const
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_items->clear();
+	if(m_nodes.empty()){
+		return;
+	}
+
+	float radius_squared = radius * radius;
+
+	std::vector<uint> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while(!stack.empty()){
+		const bvh_node_t& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if(!does_sphere_touch_aabb3(node.bounds, center, radius_squared)){
+			continue;
+		}
+
+		if(node.count == 0){
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+
+		for(uint idx = node.first; idx < node.first + node.count; ++idx){
+			uint item = m_item_indices[idx];
+			if(does_sphere_touch_aabb3(m_item_bounds[item], center, radius_squared)){
+				out_items->push_back(item);
+			}
+		}
+	}
+}
+
+void BVH::query_ray(const Vector3& start, const Vector3& direction, float max_distance, std::vector<uint>* out_items) const
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_items->clear();
+	if(m_nodes.empty()){
+		return;
+	}
+
+	Vector3 dir = direction.Normalized();
+	Vector3 inv_dir = calc_safe_inverse_direction(dir);
+
+	std::vector<uint> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while(!stack.empty()){
+		const bvh_node_t& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		float entry;
+		if(!does_ray_hit_aabb3(node.bounds, start, inv_dir, max_distance, &entry)){
+			continue;
+		}
+
+		if(node.count == 0){
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+
+		for(uint idx = node.first; idx < node.first + node.count; ++idx){
+			uint item = m_item_indices[idx];
+			if(does_ray_hit_aabb3(m_item_bounds[item], start, inv_dir, max_distance, &entry)){
+				out_items->push_back(item);
+			}
+		}
+	}
+}
+
+bool BVH::raycast(const Vector3& start, const Vector3& direction, float max_distance, bvh_ray_hit_t* out_hit) const
+{
+	if(m_nodes.empty()){
+		return false;
+	}
+
+	Vector3 dir = direction.Normalized();
+	Vector3 inv_dir = calc_safe_inverse_direction(dir);
+
+	uint best_item = INVALID_BVH_INDEX;
+	float best_distance = max_distance;
+
+	std::vector<uint> stack;
+	stack.reserve(64);
+
+	float root_entry;
+	if(does_ray_hit_aabb3(m_nodes[0].bounds, start, inv_dir, best_distance, &root_entry)){
+		stack.push_back(0);
+	}
+
+	while(!stack.empty()){
+		const bvh_node_t& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if(node.count > 0){
+			for(uint idx = node.first; idx < node.first + node.count; ++idx){
+				uint item = m_item_indices[idx];
+				float entry;
+				if(does_ray_hit_aabb3(m_item_bounds[item], start, inv_dir, best_distance, &entry) && (entry < best_distance || best_item == INVALID_BVH_INDEX)){
+					best_item = item;
+					best_distance = entry;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first so the far one is usually rejected by the shrinking best distance
+		uint near_idx = node.first;
+		uint far_idx = node.first + 1;
+		float near_entry;
+		float far_entry;
+		bool near_hit = does_ray_hit_aabb3(m_nodes[near_idx].bounds, start, inv_dir, best_distance, &near_entry);
+		bool far_hit = does_ray_hit_aabb3(m_nodes[far_idx].bounds, start, inv_dir, best_distance, &far_entry);
+
+		if(near_hit && far_hit && far_entry < near_entry){
+			uint temp = near_idx;
+			near_idx = far_idx;
+			far_idx = temp;
+		}
+
+		if(far_hit){
+			stack.push_back(far_idx);
+		}
+		if(near_hit){
+			stack.push_back(near_idx);
+		}
+	}
+
+	if(best_item == INVALID_BVH_INDEX){
+		return false;
+	}
+
+	if(nullptr != out_hit){
+		out_hit->item = best_item;
+		out_hit->distance = best_distance;
+		out_hit->position = start + (dir * best_distance);
+	}
+	return true;
+}
+
+uint BVH::get_item_count() const
+{
+	return (uint)m_item_bounds.size();
+}
+
+uint BVH::get_node_count() const
+{
+	return (uint)m_nodes.size();
+}
+
+uint BVH::calc_depth() const
+{
+	if(m_nodes.empty()){
+		return 0;
+	}
+
+	// parents always come before children, so depth can be filled in order
+	std::vector<uint> depths(m_nodes.size(), 1);
+	uint max_depth = 1;
+	for(size_t node_idx = 1; node_idx < m_nodes.size(); ++node_idx){
+		depths[node_idx] = depths[m_nodes[node_idx].parent] + 1;
+		max_depth = Max(max_depth, depths[node_idx]);
+	}
+	return max_depth;
+}
+
+//------------------------------------------------------------------------
+// benchmark / brute force comparison on a synthetic scene
+
+static Frustum make_test_frustum(const Vector3& eye, const Vector3& forward, float half_angle_radians, float near_dist, float far_dist)
+{
+	Vector3 up_hint = (fabsf(forward.y) < 0.99f) ? Vector3::Y_AXIS : Vector3::X_AXIS;
+	Vector3 right = CrossProduct(up_hint, forward).Normalized();
+	Vector3 up = CrossProduct(forward, right);
+
+	float cos_angle = cosf(half_angle_radians);
+	float sin_angle = sinf(half_angle_radians);
+
+	Vector3 normals[NUM_FRUSTUM_PLANES];
+	normals[FRUSTUM_PLANE_LEFT] = (right * cos_angle) + (forward * sin_angle);
+	normals[FRUSTUM_PLANE_RIGHT] = (right * -cos_angle) + (forward * sin_angle);
+	normals[FRUSTUM_PLANE_BOTTOM] = (up * cos_angle) + (forward * sin_angle);
+	normals[FRUSTUM_PLANE_TOP] = (up * -cos_angle) + (forward * sin_angle);
+	normals[FRUSTUM_PLANE_NEAR] = forward;
+	normals[FRUSTUM_PLANE_FAR] = -forward;
+
+	Frustum frustum;
+	for(uint plane_idx = 0; plane_idx < FRUSTUM_PLANE_NEAR; ++plane_idx){
+		frustum.m_planes[plane_idx] = Plane3(normals[plane_idx], DotProduct(normals[plane_idx], eye));
+	}
+	frustum.m_planes[FRUSTUM_PLANE_NEAR] = Plane3(forward, DotProduct(forward, eye) + near_dist);
+	frustum.m_planes[FRUSTUM_PLANE_FAR] = Plane3(-forward, -(DotProduct(forward, eye) + far_dist));
+	return frustum;
+}
+
+static Vector3 make_random_unit_vector()
+{
+	Vector3 dir(GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f));
+	if(dir.CalcLengthSquared() < 0.0001f){
+		return Vector3::Z_AXIS;
+	}
+	return dir.Normalized();
+}
+
+static Vector3 make_random_point(float half_extent)
+{
+	return Vector3(GetRandomFloatInRange(-half_extent, half_extent), GetRandomFloatInRange(-half_extent, half_extent), GetRandomFloatInRange(-half_extent, half_extent));
+}
+
+static AABB3 make_random_item_bounds(float world_half_extent)
+{
+	Vector3 center = make_random_point(world_half_extent);
+	return AABB3(center, GetRandomFloatInRange(0.25f, 2.5f), GetRandomFloatInRange(0.25f, 2.5f), GetRandomFloatInRange(0.25f, 2.5f));
+}
+
+static bool are_item_sets_equal(std::vector<uint>* a, std::vector<uint>* b)
+{
+	std::sort(a->begin(), a->end());
+	std::sort(b->begin(), b->end());
+	return *a == *b;
+}
+
+COMMAND(bvh_benchmark, "[uint:object_count] Builds, refits and queries a BVH over random boxes and checks it against brute force")
+{
+	uint item_count = 100000;
+	if(!args.is_at_end()){
+		item_count = Max(1U, args.next_uint_arg());
+	}
+
+	const uint num_queries = 200;
+	const float world_half_extent = 500.0f;
+
+	std::vector<AABB3> item_bounds(item_count);
+	for(uint item = 0; item < item_count; ++item){
+		item_bounds[item] = make_random_item_bounds(world_half_extent);
+	}
+
+	BVH serial_bvh;
+	double start = get_current_time_seconds();
+	serial_bvh.build(item_bounds.data(), item_count);
+	double serial_build_seconds = get_current_time_seconds() - start;
+
+	BVH bvh;
+	start = get_current_time_seconds();
+	bvh.build_parallel(item_bounds.data(), item_count);
+	double parallel_build_seconds = get_current_time_seconds() - start;
+
+	// move 10% of the items a little and refit them one at a time
+	uint num_moved = Max(1U, item_count / 10);
+	std::vector<uint> moved_items(num_moved);
+	for(uint moved_idx = 0; moved_idx < num_moved; ++moved_idx){
+		uint item = (uint)(GetRandomFloatZeroToOne() * (float)(item_count - 1));
+		moved_items[moved_idx] = item;
+		item_bounds[item] += make_random_point(2.0f);
+	}
+
+	start = get_current_time_seconds();
+	for(uint item : moved_items){
+		bvh.refit_item(item, item_bounds[item]);
+	}
+	double incremental_refit_seconds = get_current_time_seconds() - start;
+
+	// then move everything and refit the whole tree
+	for(uint item = 0; item < item_count; ++item){
+		item_bounds[item] += make_random_point(2.0f);
+		bvh.set_item_bounds(item, item_bounds[item]);
+	}
+
+	start = get_current_time_seconds();
+	bvh.refit();
+	double full_refit_seconds = get_current_time_seconds() - start;
+
+	uint frustum_mismatches = 0;
+	uint sphere_mismatches = 0;
+	uint ray_mismatches = 0;
+	double frustum_seconds = 0.0;
+	double sphere_seconds = 0.0;
+	double ray_seconds = 0.0;
+	u64 frustum_hits = 0;
+	u64 sphere_hits = 0;
+
+	std::vector<uint> bvh_items;
+	std::vector<uint> brute_items;
+
+	for(uint query_idx = 0; query_idx < num_queries; ++query_idx){
+		Frustum frustum = make_test_frustum(make_random_point(world_half_extent), make_random_unit_vector(), 0.5f, 0.1f, 300.0f);
+
+		start = get_current_time_seconds();
+		bvh.query_frustum(frustum, &bvh_items);
+		frustum_seconds += get_current_time_seconds() - start;
+		frustum_hits += bvh_items.size();
+
+		brute_items.clear();
+		for(uint item = 0; item < item_count; ++item){
+			if(frustum.is_aabb3_visible(item_bounds[item])){
+				brute_items.push_back(item);
+			}
+		}
+		if(!are_item_sets_equal(&bvh_items, &brute_items)){
+			frustum_mismatches++;
+		}
+
+		Vector3 center = make_random_point(world_half_extent);
+		float radius = GetRandomFloatInRange(5.0f, 50.0f);
+
+		start = get_current_time_seconds();
+		bvh.query_sphere(center, radius, &bvh_items);
+		sphere_seconds += get_current_time_seconds() - start;
+		sphere_hits += bvh_items.size();
+
+		brute_items.clear();
+		for(uint item = 0; item < item_count; ++item){
+			if(does_sphere_touch_aabb3(item_bounds[item], center, radius * radius)){
+				brute_items.push_back(item);
+			}
+		}
+		if(!are_item_sets_equal(&bvh_items, &brute_items)){
+			sphere_mismatches++;
+		}
+
+		Vector3 ray_start = make_random_point(world_half_extent);
+		Vector3 ray_dir = make_random_unit_vector();
+		float max_distance = 2.0f * world_half_extent;
+
+		bvh_ray_hit_t hit;
+		start = get_current_time_seconds();
+		bool did_hit = bvh.raycast(ray_start, ray_dir, max_distance, &hit);
+		ray_seconds += get_current_time_seconds() - start;
+
+		Vector3 inv_dir = calc_safe_inverse_direction(ray_dir);
+		bool brute_hit = false;
+		float brute_distance = max_distance;
+		for(uint item = 0; item < item_count; ++item){
+			float entry;
+			if(does_ray_hit_aabb3(item_bounds[item], ray_start, inv_dir, brute_distance, &entry)){
+				brute_hit = true;
+				brute_distance = entry;
+			}
+		}
+		if(did_hit != brute_hit || (did_hit && fabsf(hit.distance - brute_distance) > 0.001f)){
+			ray_mismatches++;
+		}
+	}
+
+	console_info("----BVH (%u objects)----", item_count);
+	console_info("nodes: %u, depth: %u, sah cost: %.2f", bvh.get_node_count(), bvh.calc_depth(), bvh.m_build_cost);
+	console_info("build serial:      %.2f ms", serial_build_seconds * 1000.0);
+	console_info("build parallel:    %.2f ms", parallel_build_seconds * 1000.0);
+	console_info("refit %u items:    %.2f ms", num_moved, incremental_refit_seconds * 1000.0);
+	console_info("refit all:         %.2f ms (cost now %.2fx build)", full_refit_seconds * 1000.0, bvh.calc_cost() / Max(bvh.m_build_cost, 0.0001f));
+	console_info("frustum query:     %.3f ms avg, %.0f objects avg", (frustum_seconds * 1000.0) / num_queries, (double)frustum_hits / num_queries);
+	console_info("sphere query:      %.3f ms avg, %.0f objects avg", (sphere_seconds * 1000.0) / num_queries, (double)sphere_hits / num_queries);
+	console_info("raycast:           %.3f ms avg", (ray_seconds * 1000.0) / num_queries);
+
+	if(serial_bvh.get_node_count() != bvh.get_node_count()){
+		console_warning("serial and parallel builds differ in node count (%u vs %u)", serial_bvh.get_node_count(), bvh.get_node_count());
+	}
+
+	if(frustum_mismatches > 0 || sphere_mismatches > 0 || ray_mismatches > 0){
+		console_error("BVH does not match brute force: frustum %u, sphere %u, ray %u of %u queries", frustum_mismatches, sphere_mismatches, ray_mismatches, num_queries);
+	}else{
+		console_info("All %u queries of each type match brute force", num_queries);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Math/AABB3.hpp"
+#include "Engine/Math/Frustum.hpp"
+
+#include <vector>
+
+#define INVALID_BVH_INDEX ((uint)-1)
+#define DEFAULT_BVH_MAX_LEAF_SIZE (4)
+#define DEFAULT_BVH_ITEMS_PER_BUILD_JOB (8192)
+#define BVH_SAH_BIN_COUNT (12)
+
+// internal nodes have count == 0 and their children at first and first + 1
+// leaves have count > 0 and own m_item_indices[first, first + count)
+struct bvh_node_t
+{
+	AABB3 bounds;
+	uint first;
+	uint count;
+	uint parent;
+};
+
+struct bvh_ray_hit_t
+{
+	uint item;
+	float distance;
+	Vector3 position;
+};
+
+// Binary bounding volume hierarchy over a set of item boxes.  Items are
+// identified by their index in the bounds array handed to build().
+//
+// Built top down with a binned surface area heuristic.  Moving items only
+// need a refit (boxes grow or shrink, topology stays the same), and
+// needs_rebuild() says when the refit tree has degraded enough that a fresh
+// build is worth it.  Children are always stored after their parent, so a
+// full refit is a single reverse sweep over m_nodes.
+class BVH
+{
+public:
+	std::vector<bvh_node_t> m_nodes;
+	std::vector<uint> m_item_indices;
+	std::vector<AABB3> m_item_bounds;
+	std::vector<uint> m_item_leaves;
+
+	uint m_max_leaf_size;
+	float m_build_cost;
+
+public:
+	BVH(uint max_leaf_size = DEFAULT_BVH_MAX_LEAF_SIZE);
+
+	void clear();
+
+	// single threaded build
+	void build(const AABB3* item_bounds, uint item_count);
+
+	// builds the top of the tree serially, then hands every subtree of at most
+	// items_per_job items to the generic job threads. blocks until done
+	void build_parallel(const AABB3* item_bounds, uint item_count, uint items_per_job = DEFAULT_BVH_ITEMS_PER_BUILD_JOB);
+
+	// incremental, walks from the item's leaf to the root and stops as soon as a node stops changing
+	void refit_item(uint item, const AABB3& bounds);
+
+	// full refit after many items have been changed with set_item_bounds
+	void set_item_bounds(uint item, const AABB3& bounds);
+	void refit();
+
+	// SAH cost of the current tree relative to the cost right after the last build
+	float calc_cost() const;
+	bool needs_rebuild(float max_cost_ratio = 2.0f) const;
+
+	// items whose box is at least partially inside the frustum
+	void query_frustum(const Frustum& frustum, std::vector<uint>* out_items) const;
+
+	// items whose box touches the sphere
+	void query_sphere(const Vector3& center, float radius, std::vector<uint>* out_items) const;
+
+	// items whose box the ray passes through, in no particular order
+	void query_ray(const Vector3& start, const Vector3& direction, float max_distance, std::vector<uint>* out_items) const;
+
+	// nearest item box along the ray, direction does not need to be normalized
+	bool raycast(const Vector3& start, const Vector3& direction, float max_distance, bvh_ray_hit_t* out_hit) const;
+
+	uint get_item_count() const;
+	uint get_node_count() const;
+	uint calc_depth() const;
+
+public:
+	// used by the build jobs, builds the subtree rooted at local node 0 over m_item_indices[first, first + count)
+	void build_subtree(std::vector<bvh_node_t>* nodes, uint first, uint count);
+
+private:
+	void begin_build(const AABB3* item_bounds, uint item_count);
+	void finish_build();
+	bool split_node(std::vector<bvh_node_t>* nodes, uint node_idx);
+	AABB3 calc_node_bounds(uint node_idx) const;
+	void append_subtree(uint root_idx, const std::vector<bvh_node_t>& subtree);
+
+	std::vector<Vector3> m_build_centers;
+};
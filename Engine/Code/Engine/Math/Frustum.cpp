@@ -0,0 +1,68 @@
+#include "Engine/Math/Frustum.hpp"
+#include "Engine/Math/Matrix4.hpp"
+#include <math.h>
+
+Frustum::Frustum()
+{
+}
+
+Frustum::Frustum(const Matrix4& view_projection)
+{
+	set_from_view_projection(view_projection);
+}
+
+// Gribb/Hartmann plane extraction.  clip = M * p, so each clip component is
+// a dot product with one row of M and the planes are sums of those rows.
+void Frustum::set_from_view_projection(const Matrix4& view_projection)
+{
+	const Vector4& x = view_projection.first_row;
+	const Vector4& y = view_projection.second_row;
+	const Vector4& z = view_projection.third_row;
+	const Vector4& w = view_projection.fourth_row;
+
+	m_planes[FRUSTUM_PLANE_LEFT]	= Plane3::make_from_coefficients(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);
+	m_planes[FRUSTUM_PLANE_RIGHT]	= Plane3::make_from_coefficients(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);
+	m_planes[FRUSTUM_PLANE_BOTTOM]	= Plane3::make_from_coefficients(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);
+	m_planes[FRUSTUM_PLANE_TOP]		= Plane3::make_from_coefficients(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);
+	m_planes[FRUSTUM_PLANE_NEAR]	= Plane3::make_from_coefficients(z.x, z.y, z.z, z.w);
+	m_planes[FRUSTUM_PLANE_FAR]		= Plane3::make_from_coefficients(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);
+}
+
+bool Frustum::is_point_inside(const Vector3& point) const
+{
+	for(int plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+		if(m_planes[plane_idx].CalcSignedDistanceToPoint(point) < 0.0f){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Frustum::is_sphere_visible(const Vector3& center, float radius) const
+{
+	for(int plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+		if(m_planes[plane_idx].CalcSignedDistanceToPoint(center) < -radius){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// conservative, only rejects boxes that are fully behind one plane
+bool Frustum::is_aabb3_visible(const AABB3& bounds) const
+{
+	Vector3 center = bounds.CalcCenter();
+	Vector3 extents = bounds.CalcHalfExtents();
+
+	for(int plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+		const Plane3& plane = m_planes[plane_idx];
+		float projected_radius = (fabsf(plane.m_normal.x) * extents.x) + (fabsf(plane.m_normal.y) * extents.y) + (fabsf(plane.m_normal.z) * extents.z);
+		if(plane.CalcSignedDistanceToPoint(center) < -projected_radius){
+			return false;
+		}
+	}
+
+	return true;
+}
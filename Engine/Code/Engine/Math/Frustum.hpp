@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Engine/Math/Plane3.hpp"
+#include "Engine/Math/AABB3.hpp"
+
+class Matrix4;
+
+enum FrustumPlane
+{
+	FRUSTUM_PLANE_LEFT,
+	FRUSTUM_PLANE_RIGHT,
+	FRUSTUM_PLANE_BOTTOM,
+	FRUSTUM_PLANE_TOP,
+	FRUSTUM_PLANE_NEAR,
+	FRUSTUM_PLANE_FAR,
+	NUM_FRUSTUM_PLANES
+};
+
+// Six planes facing inwards, anything in front of all of them is inside.
+// Built straight from a view * projection matrix so it works the same for the
+// scene camera, cube map faces and the light projections (d3d style 0 to 1 depth).
+class Frustum{
+public:
+	Plane3 m_planes[NUM_FRUSTUM_PLANES];
+
+public:
+	Frustum();
+	explicit Frustum(const Matrix4& view_projection);
+
+	void set_from_view_projection(const Matrix4& view_projection);
+
+	bool is_point_inside(const Vector3& point) const;
+	bool is_sphere_visible(const Vector3& center, float radius) const;
+	bool is_aabb3_visible(const AABB3& bounds) const;
+};
@@ -17,4 +17,20 @@ bool Plane3::AreAllPointsInFront(Vector3* points, int numPoints) const{
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+float Plane3::CalcSignedDistanceToPoint(const Vector3& point) const{
+	return DotProduct(point, m_normal) - m_offset;
+}
+
+Plane3 Plane3::make_from_coefficients(float a, float b, float c, float d)
+{
+	Vector3 normal(a, b, c);
+	float length = normal.CalcLength();
+	if(length <= 0.0f){
+		return Plane3(Vector3::ZERO, 0.0f);
+	}
+
+	float inv_length = 1.0f / length;
+	return Plane3(normal * inv_length, -d * inv_length);
+}
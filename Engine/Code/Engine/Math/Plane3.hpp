@@ -12,4 +12,8 @@ public:
 	Plane3(const Vector3& normal, float offset);
 
 	bool AreAllPointsInFront(Vector3* points, int numPoints) const;
-};
\ No newline at end of file
+	float CalcSignedDistanceToPoint(const Vector3& point) const;
+
+	// builds the plane a*x + b*y + c*z + d = 0, with the positive side in front
+	static Plane3 make_from_coefficients(float a, float b, float c, float d);
+};
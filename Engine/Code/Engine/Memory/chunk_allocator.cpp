@@ -0,0 +1,75 @@
+#include "Engine/Memory/chunk_allocator.h"
+
+// blocks start on this, enough for anything a snapshot holds
+#define CHUNK_BLOCK_ALIGNMENT 8
+
+ChunkAllocator::ChunkAllocator(size_t bs, unsigned int bpc)
+    :blocks_per_chunk(bpc)
+    ,free_list(nullptr)
+    ,chunks(nullptr)
+    ,chunk_count(0)
+    ,live_count(0)
+{
+    // must be at least the block pointer size
+    block_size = Max(bs, sizeof(block_t));
+    block_size = (block_size + CHUNK_BLOCK_ALIGNMENT - 1) & ~(size_t)(CHUNK_BLOCK_ALIGNMENT - 1);
+    blocks_per_chunk = Max(blocks_per_chunk, 1U);
+}
+
+ChunkAllocator::~ChunkAllocator()
+{
+    while(nullptr != chunks) {
+        chunk_t *next = chunks->next;
+        ::free(chunks);
+        chunks = next;
+    }
+}
+
+void ChunkAllocator::add_chunk()
+{
+    // the chunk header is padded out to a block so every block stays aligned
+    size_t header_size = Max(sizeof(chunk_t), (size_t)CHUNK_BLOCK_ALIGNMENT);
+    unsigned char *buffer = (unsigned char*)::malloc(header_size + (block_size * blocks_per_chunk));
+
+    chunk_t *chunk = (chunk_t*)buffer;
+    chunk->next = chunks;
+    chunks = chunk;
+    ++chunk_count;
+
+    // pushed last to first so they're handed out in address order
+    unsigned char *blocks = buffer + header_size;
+    for(unsigned int i = blocks_per_chunk; i > 0; --i) {
+        block_t *block = (block_t*)(blocks + (block_size * (i - 1)));
+        block->next = free_list;
+        free_list = block;
+    }
+}
+
+void* ChunkAllocator::alloc(size_t size)
+{
+    if(size > block_size) {
+        return nullptr;
+    }
+
+    if(nullptr == free_list) {
+        add_chunk();
+    }
+
+    void *ptr = free_list;
+    free_list = free_list->next;
+    ++live_count;
+
+    return ptr;
+}
+
+void ChunkAllocator::free(void *ptr)
+{
+    if(nullptr == ptr) {
+        return;
+    }
+
+    block_t *block = (block_t*)ptr;
+    block->next = free_list;
+    free_list = block;
+    --live_count;
+}
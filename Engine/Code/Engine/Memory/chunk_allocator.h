@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Engine/Memory/base_allocator.h"
+#include "Engine/Math/MathUtils.hpp"
+#include <cstdlib>
+
+// Fixed size blocks carved out of chunks of blocks_per_chunk, so things allocated
+// together sit next to each other. Chunks are only given back when the allocator
+// is destroyed.
+class ChunkAllocator : public BaseAllocator
+{
+    struct block_t
+    {
+        block_t *next;
+    };
+
+    struct chunk_t
+    {
+        chunk_t *next;
+    };
+
+public:
+    ChunkAllocator(size_t bs, unsigned int blocks_per_chunk);
+    ~ChunkAllocator();
+
+    void* alloc(size_t size);
+    void free(void *ptr);
+
+private:
+    ChunkAllocator(const ChunkAllocator&) = delete;
+    ChunkAllocator& operator=(const ChunkAllocator&) = delete;
+
+    void add_chunk();
+
+public:
+    size_t block_size;
+    unsigned int blocks_per_chunk;
+    block_t *free_list;
+    chunk_t *chunks;
+
+    unsigned int chunk_count;
+    unsigned int live_count;
+};
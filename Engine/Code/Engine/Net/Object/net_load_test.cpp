@@ -0,0 +1,417 @@
+#include "Engine/Net/Object/net_object_system_internal.hpp"
+#include "Engine/Net/Object/net_object_type_definition.hpp"
+#include "Engine/Net/Object/net_object_registry.hpp"
+#include "Engine/Net/Object/net_object.hpp"
+#include "Engine/Net/session.hpp"
+#include "Engine/Net/connection.hpp"
+#include "Engine/Net/net_link_sim.hpp"
+#include "Engine/Net/UDP/udp_session.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <vector>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define LOAD_TEST_TICK_SECONDS (1.0 / 60.0)
+#define LOAD_TEST_JOIN_SECONDS (10.0)
+
+// objects stop moving for this long at the end, everyone should catch up
+#define LOAD_TEST_SETTLE_SECONDS (2.0)
+
+#define LOAD_TEST_WORLD_SIZE (1000.0f)
+#define LOAD_TEST_MAX_SPEED (8.0f)
+
+// IP and UDP headers on top of every packet
+#define LOAD_TEST_PACKET_OVERHEAD 28
+
+// what each object replicates, where it is and which way it's going
+struct load_test_snapshot_t
+{
+    f32 x;
+    f32 z;
+    f32 yaw;
+    bool is_firing;
+};
+
+static void* load_test_create_snapshot()
+{
+    void* snapshot = malloc(sizeof(load_test_snapshot_t));
+    memset(snapshot, 0, sizeof(load_test_snapshot_t));
+    return snapshot;
+}
+
+static void load_test_refresh_snapshot(void* snapshot, void* local_object)
+{
+    memcpy(snapshot, local_object, sizeof(load_test_snapshot_t));
+}
+
+// One end of the load test. The host replicates its objects to every connection,
+// a bot has copies of them under the same ids and acks what it gets, the way the
+// net object system would on each end if there could be more than one of it in a
+// process. Objects exist on both ends from the start, nothing is created over
+// the wire.
+class NetLoadTestPeer
+{
+    public:
+        UDPLoopBackSession m_session;
+        NetObjectRegistry m_registry;
+        std::vector<NetObject*> m_objects;
+
+        // host
+        net_object_connection_t* m_connections[MAX_NET_OBJECT_CONNECTIONS];
+
+        // bot
+        net_object_update_acks_t m_acks;
+
+    public:
+        NetLoadTestPeer(unsigned int max_num_connections)
+            :m_session(max_num_connections)
+        {
+            memset(m_connections, 0, sizeof(m_connections));
+            memset(&m_acks, 0, sizeof(m_acks));
+
+            m_session.register_message(NETOBJECT_UPDATE, this, &NetLoadTestPeer::on_update);
+            m_session.register_message(NETOBJECT_ACK, this, &NetLoadTestPeer::on_ack);
+
+            uint8_t msg_ids[] = { NETOBJECT_UPDATE, NETOBJECT_ACK };
+            for(uint8_t msg_id : msg_ids){
+                m_session.get_message_definition(msg_id)->set_is_reliable(false);
+                m_session.get_message_definition(msg_id)->set_is_in_order(false);
+            }
+        }
+
+        ~NetLoadTestPeer()
+        {
+            m_session.leave();
+            m_registry.clear();
+            for(NetObject* nop : m_objects){
+                delete nop;
+            }
+            for(uint conn_index = 0; conn_index < MAX_NET_OBJECT_CONNECTIONS; ++conn_index){
+                SAFE_DELETE(m_connections[conn_index]);
+            }
+        }
+
+        void on_update(NetMessage* msg)
+        {
+            double host_time;
+            net_object_process_update(msg, m_registry, &m_acks, &host_time);
+        }
+
+        void on_ack(NetMessage* msg)
+        {
+            if(nullptr == msg->m_sender){
+                return;
+            }
+
+            uint8_t conn_index = msg->m_sender->m_connection_index;
+            if(nullptr != m_connections[conn_index]){
+                net_object_process_update_ack(msg, m_connections[conn_index], conn_index, m_registry);
+            }
+        }
+
+        void send_ack()
+        {
+            NetMessage ack(NETOBJECT_ACK);
+            if(net_object_write_update_ack(&ack, &m_acks)){
+                m_session.send_message_to_host(ack);
+            }
+        }
+
+        uint get_bytes_sent()
+        {
+            uint bytes_sent = 0;
+            for(NetConnection* conn : m_session.m_connections){
+                if((nullptr != conn) && (conn != m_session.m_my_connection)){
+                    bytes_sent += conn->m_send_stats.bytes_sent + (conn->m_send_stats.packets_sent * LOAD_TEST_PACKET_OVERHEAD);
+                }
+            }
+            return bytes_sent;
+        }
+};
+
+struct load_test_object_t
+{
+    load_test_snapshot_t state;
+    f32 velocity_x;
+    f32 velocity_z;
+};
+
+struct load_test_error_t
+{
+    double total_error;
+    f32 max_error;
+    uint samples;
+    uint missing_samples;
+};
+
+static void load_test_move_objects(std::vector<load_test_object_t>& objects, f32 seconds)
+{
+    const f32 half_world = LOAD_TEST_WORLD_SIZE * 0.5f;
+    for(load_test_object_t& obj : objects){
+        // turns now and then, bounces off the edges
+        if(GetRandomFloatZeroToOne() < 0.05f){
+            obj.velocity_x = GetRandomFloatInRange(-LOAD_TEST_MAX_SPEED, LOAD_TEST_MAX_SPEED);
+            obj.velocity_z = GetRandomFloatInRange(-LOAD_TEST_MAX_SPEED, LOAD_TEST_MAX_SPEED);
+        }
+
+        obj.state.x += obj.velocity_x * seconds;
+        obj.state.z += obj.velocity_z * seconds;
+        if((obj.state.x < -half_world) || (obj.state.x > half_world)){
+            obj.velocity_x = -obj.velocity_x;
+            obj.state.x = Min(Max(obj.state.x, -half_world), half_world);
+        }
+        if((obj.state.z < -half_world) || (obj.state.z > half_world)){
+            obj.velocity_z = -obj.velocity_z;
+            obj.state.z = Min(Max(obj.state.z, -half_world), half_world);
+        }
+
+        obj.state.yaw = atan2f(obj.velocity_z, obj.velocity_x) * (180.0f / 3.14159265f) + 180.0f;
+        if(GetRandomFloatZeroToOne() < 0.01f){
+            obj.state.is_firing = !obj.state.is_firing;
+        }
+    }
+}
+
+// how far each bot's copy is from where the object really is right now
+static void load_test_measure_error(std::vector<load_test_object_t>& objects, std::vector<NetLoadTestPeer*>& bots, load_test_error_t* error)
+{
+    for(NetLoadTestPeer* bot : bots){
+        for(uint i = 0; i < objects.size(); ++i){
+            NetObject* nop = bot->m_objects[i];
+            if(!nop->m_snapshot_is_valid){
+                error->missing_samples++;
+                continue;
+            }
+
+            const load_test_snapshot_t* received = (const load_test_snapshot_t*)nop->m_last_received_snapshot;
+            f32 dx = received->x - objects[i].state.x;
+            f32 dz = received->z - objects[i].state.z;
+            f32 distance = sqrtf((dx * dx) + (dz * dz));
+
+            error->total_error += distance;
+            error->max_error = Max(error->max_error, distance);
+            error->samples++;
+        }
+    }
+}
+
+static void load_test_tick(NetLoadTestPeer* host, std::vector<NetLoadTestPeer*>& bots, double now, double* host_seconds, double* bot_seconds)
+{
+    double start = get_current_time_seconds();
+    for(NetLoadTestPeer* bot : bots){
+        bot->m_session.tick(now);
+        bot->send_ack();
+    }
+    double bots_done = get_current_time_seconds();
+    host->m_session.tick(now);
+    double host_done = get_current_time_seconds();
+
+    *bot_seconds += bots_done - start;
+    *host_seconds += host_done - bots_done;
+}
+
+// A host and a crowd of bots in this process over loopback sockets, every packet
+// both ways going over a simulated link. Replicates moving objects to all of them
+// at the update rate and reports what it cost and how far behind the bots were.
+COMMAND(net_load_test, "[uint:bots] [uint:objects] [float:seconds] [float:latency_ms] [float:jitter_ms] [float:loss] [float:duplicate] [float:reorder] [uint:bytes_per_second] Replicates objects from a host to bots over a simulated link")
+{
+    uint bot_count = args.is_at_end() ? 16 : args.next_uint_arg();
+    uint object_count = args.is_at_end() ? 512 : args.next_uint_arg();
+    float seconds = args.is_at_end() ? 10.0f : args.next_float_arg();
+
+    net_link_conditions_t conditions;
+    memset(&conditions, 0, sizeof(conditions));
+    conditions.latency_ms = args.is_at_end() ? 50.0f : args.next_float_arg();
+    conditions.jitter_ms = args.is_at_end() ? 10.0f : args.next_float_arg();
+    conditions.loss = args.is_at_end() ? 0.02f : args.next_float_arg();
+    conditions.duplicate = args.is_at_end() ? 0.01f : args.next_float_arg();
+    conditions.reorder = args.is_at_end() ? 0.01f : args.next_float_arg();
+    conditions.bytes_per_second = args.is_at_end() ? 0 : args.next_uint_arg();
+    conditions.max_queued_bytes = NET_LINK_DEFAULT_QUEUE_BYTES;
+
+    bot_count = Max(Min(bot_count, (uint)INVALID_CONNECTION_INDEX - 1), 1U);
+    object_count = Max(Min(object_count, (uint)MAX_NET_OBJECT_SLOTS - MIN_FREE_NET_OBJECT_SLOTS), 1U);
+
+    const uint ticks_per_update = Max((uint)(1.0 / (DEFAULT_UPDATE_HZ * LOAD_TEST_TICK_SECONDS) + 0.5), 1U);
+    const double update_seconds = ticks_per_update * LOAD_TEST_TICK_SECONDS;
+
+    NetObjectTypeDefinition defn;
+    defn.m_snapshot_size = sizeof(load_test_snapshot_t);
+    defn.create_snapshot = load_test_create_snapshot;
+    defn.refresh_current_snapshot = load_test_refresh_snapshot;
+    defn.add_quantized_float_field(offsetof(load_test_snapshot_t, x), -LOAD_TEST_WORLD_SIZE * 0.5f, LOAD_TEST_WORLD_SIZE * 0.5f, 18, 8);
+    defn.add_quantized_float_field(offsetof(load_test_snapshot_t, z), -LOAD_TEST_WORLD_SIZE * 0.5f, LOAD_TEST_WORLD_SIZE * 0.5f, 18, 8);
+    defn.add_quantized_float_field(offsetof(load_test_snapshot_t, yaw), 0.0f, 360.0f, 9, 4);
+    defn.add_bool_field(offsetof(load_test_snapshot_t, is_firing));
+
+    std::vector<load_test_object_t> objects(object_count);
+    NetLoadTestPeer* host = new NetLoadTestPeer(bot_count + 1);
+    host->m_session.m_link.m_conditions = conditions;
+    for(uint i = 0; i < object_count; ++i){
+        load_test_object_t& obj = objects[i];
+        memset(&obj, 0, sizeof(obj));
+        obj.state.x = GetRandomFloatInRange(-0.5f, 0.5f) * LOAD_TEST_WORLD_SIZE;
+        obj.state.z = GetRandomFloatInRange(-0.5f, 0.5f) * LOAD_TEST_WORLD_SIZE;
+
+        NetObject* nop = new NetObject(&defn);
+        nop->m_local_object = &obj.state;
+        host->m_registry.add(nop);
+        host->m_objects.push_back(nop);
+    }
+
+    std::vector<NetLoadTestPeer*> bots;
+    bool started = host->m_session.host(NET_DEFAULT_PORT) && host->m_session.start_listening();
+    for(uint bot_idx = 0; started && (bot_idx < bot_count); ++bot_idx){
+        NetLoadTestPeer* bot = new NetLoadTestPeer(8);
+        bot->m_session.m_link.m_conditions = conditions;
+        for(NetObject* host_nop : host->m_objects){
+            NetObject* nop = new NetObject(&defn);
+            bot->m_registry.add_with_id(nop, host_nop->m_net_id);
+            bot->m_objects.push_back(nop);
+        }
+        bots.push_back(bot);
+
+        started = bot->m_session.join(host->m_session.m_my_connection->m_address);
+    }
+
+    if(!started){
+        console_error("Failed to start the load test sessions");
+    }
+
+    // everybody joins before anything is measured
+    double now = get_current_time_seconds();
+    double join_start_time = now;
+    uint ready_count = 0;
+    double host_seconds = 0.0;
+    double bot_seconds = 0.0;
+    while(started && (ready_count < bot_count) && ((now - join_start_time) < LOAD_TEST_JOIN_SECONDS)){
+        now += LOAD_TEST_TICK_SECONDS;
+        load_test_tick(host, bots, now, &host_seconds, &bot_seconds);
+
+        ready_count = 0;
+        for(NetLoadTestPeer* bot : bots){
+            ready_count += bot->m_session.is_ready() ? 1 : 0;
+        }
+    }
+    double join_seconds = now - join_start_time;
+
+    for(uint conn_index = 1; conn_index < host->m_session.m_connections.size(); ++conn_index){
+        if(nullptr != host->m_session.m_connections[conn_index]){
+            host->m_connections[conn_index] = new net_object_connection_t();
+            host->m_connections[conn_index]->next_update_id = 0;
+            net_object_reset_connection(host->m_connections[conn_index], DEFAULT_NET_OBJECT_BYTES_PER_SECOND);
+            host->m_registry.reset_connection((uint8_t)conn_index);
+        }
+    }
+
+    uint host_bytes_at_start = host->get_bytes_sent();
+    uint bot_bytes_at_start = 0;
+    for(NetLoadTestPeer* bot : bots){
+        bot_bytes_at_start += bot->get_bytes_sent();
+    }
+
+    host_seconds = 0.0;
+    bot_seconds = 0.0;
+    double update_send_seconds = 0.0;
+    load_test_error_t error;
+    memset(&error, 0, sizeof(error));
+
+    uint run_ticks = started ? (uint)(seconds / LOAD_TEST_TICK_SECONDS) : 0;
+    uint settle_ticks = started ? (uint)(LOAD_TEST_SETTLE_SECONDS / LOAD_TEST_TICK_SECONDS) : 0;
+    double host_time = 0.0;
+    for(uint tick = 0; tick < run_ticks + settle_ticks; ++tick){
+        now += LOAD_TEST_TICK_SECONDS;
+        bool is_settling = (tick >= run_ticks);
+
+        if(0 == (tick % ticks_per_update)){
+            if(!is_settling){
+                load_test_measure_error(objects, bots, &error);
+                load_test_move_objects(objects, (f32)update_seconds);
+            }
+
+            double start = get_current_time_seconds();
+            host_time += update_seconds;
+            net_object_refresh_snapshots(host->m_registry);
+            for(uint conn_index = 1; conn_index < host->m_session.m_connections.size(); ++conn_index){
+                NetConnection* conn = host->m_session.m_connections[conn_index];
+                if((nullptr != conn) && (nullptr != host->m_connections[conn_index])){
+                    net_object_send_updates_to(conn, host->m_registry, host->m_connections[conn_index], host_time, update_seconds);
+                }
+            }
+            update_send_seconds += get_current_time_seconds() - start;
+        }
+
+        load_test_tick(host, bots, now, &host_seconds, &bot_seconds);
+    }
+
+    uint host_bytes = host->get_bytes_sent() - host_bytes_at_start;
+    uint bot_bytes = 0;
+    for(NetLoadTestPeer* bot : bots){
+        bot_bytes += bot->get_bytes_sent();
+    }
+    bot_bytes -= bot_bytes_at_start;
+
+    // what everyone ended up with once things stopped changing
+    uint converged = 0;
+    for(NetLoadTestPeer* bot : bots){
+        for(uint i = 0; i < object_count; ++i){
+            NetObject* host_nop = host->m_objects[i];
+            NetObject* nop = bot->m_objects[i];
+            if(nop->m_snapshot_is_valid && (0 == defn.get_changed_fields_mask(host_nop->m_current_snapshot, nop->m_last_received_snapshot))){
+                converged++;
+            }
+        }
+    }
+
+    net_link_stats_t link_stats = host->m_session.m_link.m_stats;
+
+    for(NetLoadTestPeer* bot : bots){
+        delete bot;
+    }
+    bots.clear();
+    delete host;
+
+    uint total_ticks = Max(run_ticks + settle_ticks, 1U);
+    double measured_seconds = Max(total_ticks * LOAD_TEST_TICK_SECONDS, LOAD_TEST_TICK_SECONDS);
+    uint expected = bot_count * object_count;
+
+    console_info("----Net load test, %u bots, %u objects at %u Hz, %.1f s (then %.1f s still)----", bot_count, object_count, DEFAULT_UPDATE_HZ, seconds, LOAD_TEST_SETTLE_SECONDS);
+    console_info("link:      %.0f +-%.0f ms, %.1f%% lost, %.1f%% duplicated, %.1f%% reordered, %u bytes per second",
+        conditions.latency_ms,
+        conditions.jitter_ms,
+        conditions.loss * 100.0f,
+        conditions.duplicate * 100.0f,
+        conditions.reorder * 100.0f,
+        conditions.bytes_per_second);
+    console_info("joined:    %u/%u in %.2f s", ready_count, bot_count, join_seconds);
+    console_info("host:      %.3f ms a tick, %.3f ms of it writing updates, sent %.1f KB/s (%.1f KB/s a bot)",
+        (host_seconds + update_send_seconds) * 1000.0 / total_ticks,
+        update_send_seconds * 1000.0 / total_ticks,
+        host_bytes / (measured_seconds * 1024.0),
+        host_bytes / (measured_seconds * 1024.0 * bot_count));
+    console_info("bots:      %.3f ms a tick each, sent %.2f KB/s each",
+        bot_seconds * 1000.0 / ((double)total_ticks * bot_count),
+        bot_bytes / (measured_seconds * 1024.0 * bot_count));
+    console_info("host link: %u packets, %u lost, %u dropped, %u duplicated, %u reordered",
+        link_stats.packets_sent,
+        link_stats.packets_lost,
+        link_stats.packets_dropped,
+        link_stats.packets_duplicated,
+        link_stats.packets_reordered);
+    console_info("error:     %.2f units behind on average, %.2f at most, %.1f%% of samples had nothing yet",
+        (error.samples > 0) ? (error.total_error / error.samples) : 0.0,
+        error.max_error,
+        100.0 * error.missing_samples / Max(error.samples + error.missing_samples, 1U));
+
+    if(converged == expected){
+        console_success("All %u copies caught up with the host", expected);
+    }else{
+        console_error("%u/%u copies caught up with the host", converged, expected);
+    }
+}
@@ -1,34 +1,41 @@
 #include "Engine/Net/Object/net_object.hpp"
 #include "Engine/Net/Object/net_object_type_definition.hpp"
 #include "Engine/Core/Common.hpp"
-#include "Engine/Core/Time.hpp"
+#include "Engine/Net/message.hpp"
+#include "Engine/Math/MathUtils.hpp"
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 NetObject::NetObject(NetObjectTypeDefinition *defn)
     :m_type_id(0)
+    ,m_net_id(INVALID_NET_OBJECT_ID)
     ,m_defn(defn)
     ,m_last_received_snapshot(nullptr)
-    ,m_last_received_snapshot_client_timestamp(0.0f)
+    ,m_interpolated_snapshot(nullptr)
     ,m_current_snapshot(nullptr)
+    ,m_has_received_update(false)
+    ,m_last_received_update_id(0)
+    ,m_received_snapshot_count(0)
+    ,m_next_received_snapshot(0)
     ,m_is_local_dirty(false)
     ,m_snapshot_is_valid(false)
 {
-    m_current_snapshot = m_defn->create_snapshot();
-    m_last_received_snapshot = m_defn->create_snapshot();
+    m_current_snapshot = m_defn->alloc_snapshot();
+    m_last_received_snapshot = m_defn->alloc_snapshot();
+    memset(m_received_snapshots, 0, sizeof(m_received_snapshots));
 }
 
+// connection states are the registry's, they're released when the object is
+// removed from it
 NetObject::~NetObject()
 {
-    free(m_current_snapshot);
-    free(m_last_received_snapshot);
-
-    std::map<uint8_t, net_connection_state_t*>::iterator it; 
-    for(it = m_conn_states.begin(); it != m_conn_states.end(); it++){
-        net_connection_state_t* conn = it->second;
-        free(conn->m_last_sent_snapshot);
-        SAFE_DELETE(conn);
+    m_defn->free_snapshot(m_current_snapshot);
+    m_defn->free_snapshot(m_last_received_snapshot);
+    m_defn->free_snapshot(m_interpolated_snapshot);
+    for(uint received_idx = 0; received_idx < MAX_RECEIVED_SNAPSHOTS; ++received_idx){
+        m_defn->free_snapshot(m_received_snapshots[received_idx].snapshot);
     }
-    m_conn_states.clear();
 }
 
 void NetObject::refresh_current_snapshot()
@@ -48,42 +55,207 @@ void NetObject::process_snapshot(NetMessage* msg)
     m_snapshot_is_valid = true;
 }
 
-void NetObject::apply_latest_snapshot()
+void NetObject::apply_snapshot_at(double render_time, double newest_update_time, double max_extrapolation_seconds)
 {
     if(!m_snapshot_is_valid){
         return;
     }
 
-    double dt = get_current_time_seconds() - m_last_received_snapshot_client_timestamp;
-    if(dt <= 0.0f){
+    double seconds_past;
+    const void* snapshot = sample_received_snapshots(render_time, newest_update_time, max_extrapolation_seconds, &seconds_past);
+    m_defn->apply_snapshot((void*)snapshot, m_local_object, seconds_past);
+    m_is_local_dirty = false;
+}
+
+const void* NetObject::sample_received_snapshots(double render_time, double newest_update_time, double max_extrapolation_seconds, double* out_seconds_past)
+{
+    *out_seconds_past = 0.0;
+    if((0 == m_received_snapshot_count) || (0 == m_defn->m_snapshot_size)){
+        return m_last_received_snapshot;
+    }
+
+    // the newest at or before render_time and the oldest after it, plus the two
+    // newest for extrapolating
+    const net_received_snapshot_t* before = nullptr;
+    const net_received_snapshot_t* after = nullptr;
+    const net_received_snapshot_t* newest = nullptr;
+    const net_received_snapshot_t* second_newest = nullptr;
+    for(uint received_idx = 0; received_idx < m_received_snapshot_count; ++received_idx){
+        const net_received_snapshot_t* received = &m_received_snapshots[received_idx];
+        if(received->host_time <= render_time){
+            if((nullptr == before) || (received->host_time > before->host_time)){
+                before = received;
+            }
+        }else if((nullptr == after) || (received->host_time < after->host_time)){
+            after = received;
+        }
+
+        if((nullptr == newest) || (received->host_time > newest->host_time)){
+            second_newest = newest;
+            newest = received;
+        }else if((nullptr == second_newest) || (received->host_time > second_newest->host_time)){
+            second_newest = received;
+        }
+    }
+
+    // drawing further back than we remember
+    if(nullptr == before){
+        return after->snapshot;
+    }
+
+    if(nullptr == m_interpolated_snapshot){
+        m_interpolated_snapshot = m_defn->alloc_snapshot();
+    }
+
+    if(nullptr != after){
+        f32 t = (f32)((render_time - before->host_time) / (after->host_time - before->host_time));
+        m_defn->interpolate(m_interpolated_snapshot, before->snapshot, after->snapshot, t);
+        return m_interpolated_snapshot;
+    }
+
+    // Nothing newer for this object. If updates since came without it, it
+    // hasn't changed. Otherwise they're late, keep it going the way it was if the
+    // last two are close enough together to say which way that is.
+    double seconds_past = render_time - newest->host_time;
+    bool is_late = (render_time > newest_update_time) && (newest->host_time >= newest_update_time);
+    if(!is_late || (nullptr == second_newest) || ((newest->host_time - second_newest->host_time) > max_extrapolation_seconds)){
+        *out_seconds_past = seconds_past;
+        return newest->snapshot;
+    }
+
+    double extrapolated_time = newest->host_time + Min(seconds_past, max_extrapolation_seconds);
+    f32 t = (f32)((extrapolated_time - second_newest->host_time) / (newest->host_time - second_newest->host_time));
+    m_defn->interpolate(m_interpolated_snapshot, second_newest->snapshot, newest->snapshot, t);
+    *out_seconds_past = seconds_past - (extrapolated_time - newest->host_time);
+    return m_interpolated_snapshot;
+}
+
+u32 NetObject::get_fields_to_send(const net_connection_state_t* conn_state) const
+{
+    if(!conn_state->m_has_acked_snapshot){
+        return m_defn->get_all_fields_mask();
+    }
+
+    u32 mask = m_defn->get_changed_fields_mask(m_current_snapshot, conn_state->m_acked_snapshot);
+
+    // a field that went out and changed back still has to be sent, the connection
+    // may have the in between value
+    for(uint pending_idx = 0; pending_idx < conn_state->m_pending_count; ++pending_idx){
+        mask |= conn_state->m_pending[pending_idx].field_mask;
+    }
+
+    return mask;
+}
+
+const void* NetObject::get_acked_snapshot(const net_connection_state_t* conn_state, u16* out_update_id) const
+{
+    if(!conn_state->m_has_acked_snapshot){
+        return nullptr;
+    }
+
+    *out_update_id = conn_state->m_acked_update_id;
+    return conn_state->m_acked_snapshot;
+}
+
+void NetObject::on_snapshot_sent(net_connection_state_t* conn_state, u16 update_id, u32 field_mask)
+{
+    // acks have stopped coming, forget what the connection has and start over
+    if(conn_state->m_pending_count == MAX_PENDING_SNAPSHOTS){
+        conn_state->m_has_acked_snapshot = false;
+        conn_state->m_pending_count = 0;
+    }
+
+    net_pending_snapshot_t& pending = conn_state->m_pending[conn_state->m_pending_count];
+    if(nullptr == pending.snapshot){
+        pending.snapshot = m_defn->alloc_snapshot();
+    }
+
+    pending.update_id = update_id;
+    pending.field_mask = field_mask;
+    memcpy(pending.snapshot, m_current_snapshot, m_defn->m_snapshot_size);
+
+    ++conn_state->m_pending_count;
+}
+
+void NetObject::on_snapshot_acked(net_connection_state_t* conn_state, u16 update_id)
+{
+    uint acked_idx;
+    for(acked_idx = 0; acked_idx < conn_state->m_pending_count; ++acked_idx){
+        if(conn_state->m_pending[acked_idx].update_id == update_id){
+            break;
+        }
+    }
+    if(acked_idx == conn_state->m_pending_count){
         return;
     }
-    m_defn->apply_snapshot(m_last_received_snapshot, m_local_object, dt);
-    m_is_local_dirty = false;
+
+    // pending is oldest first, swap the acked snapshot in as the new baseline
+    net_pending_snapshot_t& acked = conn_state->m_pending[acked_idx];
+    void* old_baseline = conn_state->m_acked_snapshot;
+    conn_state->m_acked_snapshot = acked.snapshot;
+    conn_state->m_acked_update_id = update_id;
+    conn_state->m_has_acked_snapshot = true;
+    acked.snapshot = old_baseline;
+
+    // it and everything sent before it are done with, their buffers go right
+    // after what's still pending so the next sends reuse them
+    uint removed_count = acked_idx + 1;
+    net_pending_snapshot_t* pending = conn_state->m_pending;
+    std::rotate(pending, pending + removed_count, pending + conn_state->m_pending_count);
+    conn_state->m_pending_count -= removed_count;
+}
+
+void NetObject::init_conn_state(net_connection_state_t* conn_state)
+{
+    memset(conn_state, 0, sizeof(net_connection_state_t));
+    conn_state->m_net_id = m_net_id;
+    conn_state->m_acked_snapshot = m_defn->alloc_snapshot();
+}
+
+void NetObject::release_conn_state(net_connection_state_t* conn_state)
+{
+    m_defn->free_snapshot(conn_state->m_acked_snapshot);
+    for(uint pending_idx = 0; pending_idx < MAX_PENDING_SNAPSHOTS; ++pending_idx){
+        m_defn->free_snapshot(conn_state->m_pending[pending_idx].snapshot);
+    }
+    memset(conn_state, 0, sizeof(net_connection_state_t));
 }
 
-void NetObject::save_last_sent_snapshot(uint8_t conn_index, void* snapshot)
+bool NetObject::accept_update(u16 update_id)
 {
-    net_connection_state_t* conn_state = get_or_create_conn_state(conn_index);
-    memcpy(conn_state->m_last_sent_snapshot, snapshot, m_defn->m_snapshot_size);
+    if(m_has_received_update && !cycle_greater_than(update_id, m_last_received_update_id)){
+        return false;
+    }
+
+    m_has_received_update = true;
+    m_last_received_update_id = update_id;
+    return true;
 }
 
-bool NetObject::is_synced(uint8_t conn_index)
+void NetObject::save_received_snapshot(u16 update_id, double host_time)
 {
-    net_connection_state_t* conn_state = get_or_create_conn_state(conn_index);
-    return (memcmp(conn_state->m_last_sent_snapshot, m_current_snapshot, m_defn->m_snapshot_size) == 0);
+    net_received_snapshot_t& received = m_received_snapshots[m_next_received_snapshot];
+    if(nullptr == received.snapshot){
+        received.snapshot = m_defn->alloc_snapshot();
+    }
+
+    received.update_id = update_id;
+    received.host_time = host_time;
+    memcpy(received.snapshot, m_last_received_snapshot, m_defn->m_snapshot_size);
+
+    m_next_received_snapshot = (m_next_received_snapshot + 1) % MAX_RECEIVED_SNAPSHOTS;
+    if(m_received_snapshot_count < MAX_RECEIVED_SNAPSHOTS){
+        ++m_received_snapshot_count;
+    }
 }
 
-net_connection_state_t* NetObject::get_or_create_conn_state(uint8_t conn_index)
+const void* NetObject::find_received_snapshot(u16 update_id) const
 {
-    std::map<uint8_t, net_connection_state_t*>::iterator it = m_conn_states.find(conn_index); 
-    if(it == m_conn_states.end()){
-        net_connection_state_t* new_conn_state = new net_connection_state_t();
-        new_conn_state->m_last_sent_snapshot = malloc(m_defn->m_snapshot_size);
-        memset(new_conn_state->m_last_sent_snapshot, 0, m_defn->m_snapshot_size);
-        m_conn_states[conn_index] = new_conn_state;
-        return new_conn_state;
-    }else{
-        return m_conn_states[conn_index];
+    for(uint received_idx = 0; received_idx < m_received_snapshot_count; ++received_idx){
+        const net_received_snapshot_t& received = m_received_snapshots[received_idx];
+        if(received.update_id == update_id){
+            return received.snapshot;
+        }
     }
+    return nullptr;
 }
\ No newline at end of file
@@ -1,16 +1,76 @@
 #pragma once
 
+#include "Engine/Core/types.h"
 #include <inttypes.h>
-#include <map>
 
-typedef uint16_t net_object_id_t;
+// [16 bit generation][16 bit slot index]. The slot is what goes in updates,
+// the generation tells an object apart from whatever had its slot before. It
+// starts at 1 so an id of 0 is never a live object.
+typedef uint32_t net_object_id_t;
+
+#define INVALID_NET_OBJECT_ID 0
+#define MAX_NET_OBJECT_SLOTS 0xFFFF
+
+inline u16 get_net_object_index(net_object_id_t net_id)
+{
+    return (u16)(net_id & 0xFFFF);
+}
+
+inline u16 get_net_object_generation(net_object_id_t net_id)
+{
+    return (u16)(net_id >> 16);
+}
+
+inline net_object_id_t make_net_object_id(u16 index, u16 generation)
+{
+    return ((net_object_id_t)generation << 16) | index;
+}
 
 class NetMessage;
 class NetObjectTypeDefinition;
 
+// unacked sends remembered per connection, past this we go back to sending everything
+#define MAX_PENDING_SNAPSHOTS 8
+
+// a snapshot sent in an update the connection hasn't acked yet
+struct net_pending_snapshot_t
+{
+    u16 update_id;
+    u32 field_mask;
+    void* snapshot;
+};
+
+// What one connection has of one object. They live in flat arrays per connection
+// indexed by slot (see NetObjectRegistry), all zero is a state nothing uses.
 struct net_connection_state_t
 {
-    void* m_last_sent_snapshot;
+    net_object_id_t m_net_id;
+
+    // the newest snapshot the connection is known to have, deltas are against this
+    bool m_has_acked_snapshot;
+    u16 m_acked_update_id;
+    void* m_acked_snapshot;
+
+    // oldest first, each keeps its snapshot buffer when removed so it can be reused
+    net_pending_snapshot_t m_pending[MAX_PENDING_SNAPSHOTS];
+    uint m_pending_count;
+
+    // grows every tick the object has something for the connection and isn't sent
+    f32 m_priority;
+    bool m_is_waiting;
+    double m_waiting_since;
+};
+
+// updates applied on the client, enough to cover any baseline the host could
+// still be sending deltas against. They're also what's interpolated between, so
+// this many updates is as far back as the client can be drawing
+#define MAX_RECEIVED_SNAPSHOTS (MAX_PENDING_SNAPSHOTS + 1)
+
+struct net_received_snapshot_t
+{
+    u16 update_id;
+    double host_time;
+    void* snapshot;
 };
 
 // Net Object System
@@ -25,13 +85,21 @@ class NetObject
         void* m_current_snapshot;
 
         void* m_last_received_snapshot;
-        double m_last_received_snapshot_client_timestamp;
+
+        // what was last handed to apply_snapshot, made when first needed
+        void* m_interpolated_snapshot;
+
+        // older updates arriving late are ignored
+        bool m_has_received_update;
+        u16 m_last_received_update_id;
+
+        net_received_snapshot_t m_received_snapshots[MAX_RECEIVED_SNAPSHOTS];
+        uint m_received_snapshot_count;
+        uint m_next_received_snapshot;
 
         bool m_is_local_dirty;
         bool m_snapshot_is_valid;
 
-        std::map<uint8_t, net_connection_state_t*> m_conn_states;
-
     public:
         NetObject(NetObjectTypeDefinition *defn);
         ~NetObject();
@@ -39,9 +107,37 @@ class NetObject
         void refresh_current_snapshot();
         void append_snapshot(NetMessage* msg);
         void process_snapshot(NetMessage* msg);
-        void apply_latest_snapshot();
 
-        void save_last_sent_snapshot(uint8_t conn_index, void* snapshot);
-        bool is_synced(uint8_t conn_index);
-        net_connection_state_t* get_or_create_conn_state(uint8_t conn_index);
-};
\ No newline at end of file
+        // Applies what the object looked like at render_time (host time). That's
+        // between two received snapshots most of the time. Past the newest it's
+        // held if newer updates came without the object (it didn't change), or
+        // carried on for up to max_extrapolation_seconds if they're late.
+        void apply_snapshot_at(double render_time, double newest_update_time, double max_extrapolation_seconds);
+
+        // what apply_snapshot_at would apply, and how far render_time is past
+        // it when it was held
+        const void* sample_received_snapshots(double render_time, double newest_update_time, double max_extrapolation_seconds, double* out_seconds_past);
+
+        // Fields that differ from what the connection acked, plus any sent since
+        // that could still be on their way. Zero when there's nothing to send.
+        u32 get_fields_to_send(const net_connection_state_t* conn_state) const;
+
+        // null until the connection has acked something
+        const void* get_acked_snapshot(const net_connection_state_t* conn_state, u16* out_update_id) const;
+
+        void on_snapshot_sent(net_connection_state_t* conn_state, u16 update_id, u32 field_mask);
+        void on_snapshot_acked(net_connection_state_t* conn_state, u16 update_id);
+
+        // takes an unused state for this object / gives its snapshots back, after
+        // which it's all zero again
+        void init_conn_state(net_connection_state_t* conn_state);
+        void release_conn_state(net_connection_state_t* conn_state);
+
+        // false if an update at least as new was already processed
+        bool accept_update(u16 update_id);
+
+        // what m_last_received_snapshot was after an update, for reading deltas
+        // against later
+        void save_received_snapshot(u16 update_id, double host_time);
+        const void* find_received_snapshot(u16 update_id) const;
+};
@@ -0,0 +1,204 @@
+#include "Engine/Net/Object/net_object_registry.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+#include <string.h>
+
+NetObjectRegistry::NetObjectRegistry()
+    :m_object_count(0)
+    ,m_free_head(INVALID_NET_OBJECT_SLOT)
+    ,m_free_tail(INVALID_NET_OBJECT_SLOT)
+    ,m_free_count(0)
+{
+}
+
+NetObjectRegistry::~NetObjectRegistry()
+{
+    clear();
+}
+
+u16 NetObjectRegistry::alloc_slot()
+{
+    // the head may have been taken by add_with_id since it was freed
+    while((m_free_count > MIN_FREE_NET_OBJECT_SLOTS) || ((m_slots.size() >= MAX_NET_OBJECT_SLOTS) && (m_free_count > 0))){
+        u16 index = m_free_head;
+        net_object_slot_t& slot = m_slots[index];
+        m_free_head = slot.next_free;
+        if(INVALID_NET_OBJECT_SLOT == m_free_head){
+            m_free_tail = INVALID_NET_OBJECT_SLOT;
+        }
+        slot.is_free_listed = false;
+        --m_free_count;
+
+        if(nullptr == slot.nop){
+            return index;
+        }
+    }
+
+    if(m_slots.size() >= MAX_NET_OBJECT_SLOTS){
+        return INVALID_NET_OBJECT_SLOT;
+    }
+
+    net_object_slot_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.generation = 1;
+    slot.next_free = INVALID_NET_OBJECT_SLOT;
+    m_slots.push_back(slot);
+    return (u16)(m_slots.size() - 1);
+}
+
+void NetObjectRegistry::free_slot(u16 index)
+{
+    net_object_slot_t& slot = m_slots[index];
+    slot.nop = nullptr;
+
+    // 0 is never a generation, see net_object_id_t
+    slot.generation = (u16)(slot.generation + 1);
+    if(0 == slot.generation){
+        slot.generation = 1;
+    }
+
+    if(slot.is_free_listed){
+        return;
+    }
+
+    slot.is_free_listed = true;
+    slot.next_free = INVALID_NET_OBJECT_SLOT;
+    if(INVALID_NET_OBJECT_SLOT == m_free_tail){
+        m_free_head = index;
+    }else{
+        m_slots[m_free_tail].next_free = index;
+    }
+    m_free_tail = index;
+    ++m_free_count;
+}
+
+void NetObjectRegistry::occupy_slot(u16 index, NetObject* nop, u16 generation)
+{
+    net_object_slot_t& slot = m_slots[index];
+    slot.nop = nop;
+    slot.generation = generation;
+    nop->m_net_id = make_net_object_id(index, generation);
+    ++m_object_count;
+}
+
+bool NetObjectRegistry::add(NetObject* nop)
+{
+    u16 index = alloc_slot();
+    if(INVALID_NET_OBJECT_SLOT == index){
+        return false;
+    }
+
+    occupy_slot(index, nop, m_slots[index].generation);
+    return true;
+}
+
+bool NetObjectRegistry::add_with_id(NetObject* nop, net_object_id_t net_id)
+{
+    u16 index = get_net_object_index(net_id);
+    u16 generation = get_net_object_generation(net_id);
+    if((index >= MAX_NET_OBJECT_SLOTS) || (0 == generation)){
+        return false;
+    }
+
+    if(index >= m_slots.size()){
+        net_object_slot_t slot;
+        memset(&slot, 0, sizeof(slot));
+        slot.next_free = INVALID_NET_OBJECT_SLOT;
+        m_slots.resize(index + 1, slot);
+    }
+
+    if(nullptr != m_slots[index].nop){
+        return false;
+    }
+
+    occupy_slot(index, nop, generation);
+    return true;
+}
+
+void NetObjectRegistry::remove(NetObject* nop)
+{
+    if(nop != find(nop->m_net_id)){
+        return;
+    }
+
+    u16 index = get_net_object_index(nop->m_net_id);
+    for(uint conn_index = 0; conn_index < MAX_NET_OBJECT_CONNECTIONS; ++conn_index){
+        std::vector<net_connection_state_t>& states = m_conn_states[conn_index];
+        if((index < states.size()) && (states[index].m_net_id == nop->m_net_id)){
+            nop->release_conn_state(&states[index]);
+        }
+    }
+
+    free_slot(index);
+    --m_object_count;
+}
+
+void NetObjectRegistry::clear()
+{
+    for(uint conn_index = 0; conn_index < MAX_NET_OBJECT_CONNECTIONS; ++conn_index){
+        reset_connection((uint8_t)conn_index);
+        m_conn_states[conn_index].clear();
+    }
+
+    m_slots.clear();
+    m_object_count = 0;
+    m_free_head = INVALID_NET_OBJECT_SLOT;
+    m_free_tail = INVALID_NET_OBJECT_SLOT;
+    m_free_count = 0;
+}
+
+NetObject* NetObjectRegistry::find(net_object_id_t net_id) const
+{
+    u16 index = get_net_object_index(net_id);
+    if(index >= m_slots.size()){
+        return nullptr;
+    }
+
+    const net_object_slot_t& slot = m_slots[index];
+    if(slot.generation != get_net_object_generation(net_id)){
+        return nullptr;
+    }
+    return slot.nop;
+}
+
+net_connection_state_t* NetObjectRegistry::get_conn_state(uint8_t conn_index, NetObject* nop)
+{
+    std::vector<net_connection_state_t>& states = m_conn_states[conn_index];
+    u16 index = get_net_object_index(nop->m_net_id);
+
+    // Grown to every slot on the first call after slots were added, rather than
+    // when an index falls off the end, so states handed out since stay put as
+    // long as nothing is added.
+    if(states.size() < m_slots.size()){
+        net_connection_state_t unused;
+        memset(&unused, 0, sizeof(unused));
+        states.resize(m_slots.size(), unused);
+    }
+
+    net_connection_state_t* conn_state = &states[index];
+    if(conn_state->m_net_id != nop->m_net_id){
+        ASSERT_OR_DIE(INVALID_NET_OBJECT_ID == conn_state->m_net_id, "Net object connection state wasn't released");
+        nop->init_conn_state(conn_state);
+    }
+    return conn_state;
+}
+
+void NetObjectRegistry::reset_connection(uint8_t conn_index)
+{
+    if(conn_index >= MAX_NET_OBJECT_CONNECTIONS){
+        return;
+    }
+
+    std::vector<net_connection_state_t>& states = m_conn_states[conn_index];
+    for(uint index = 0; index < states.size(); ++index){
+        net_connection_state_t& conn_state = states[index];
+        if(INVALID_NET_OBJECT_ID == conn_state.m_net_id){
+            continue;
+        }
+
+        NetObject* nop = find(conn_state.m_net_id);
+        if(nullptr != nop){
+            nop->release_conn_state(&conn_state);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Engine/Net/Object/net_object.hpp"
+#include "Engine/Core/types.h"
+#include <vector>
+
+// a freed slot is only handed out again once this many are waiting, so its next
+// object isn't sent updates that were meant for the last one
+#define MIN_FREE_NET_OBJECT_SLOTS 1024
+
+#define INVALID_NET_OBJECT_SLOT 0xFFFF
+
+// connection indices are a byte and 0xFF is invalid
+#define MAX_NET_OBJECT_CONNECTIONS 0xFF
+
+struct net_object_slot_t
+{
+    NetObject* nop;
+    u16 generation;
+
+    // free list, oldest freed first
+    u16 next_free;
+    bool is_free_listed;
+};
+
+// Net objects by id in a slot map. Finding one is an index and a generation
+// check, and walking the slots goes through them in id order, which is the
+// order updates are written in.
+//
+// Each connection's state for every object sits in a flat array per connection
+// indexed by slot, made when the connection first needs it.
+class NetObjectRegistry
+{
+    public:
+        std::vector<net_object_slot_t> m_slots;
+        uint m_object_count;
+
+        u16 m_free_head;
+        u16 m_free_tail;
+        uint m_free_count;
+
+        std::vector<net_connection_state_t> m_conn_states[MAX_NET_OBJECT_CONNECTIONS];
+
+    public:
+        NetObjectRegistry();
+        ~NetObjectRegistry();
+
+        // picks an id for it, false when every slot is taken
+        bool add(NetObject* nop);
+
+        // with the id someone else picked, false if its slot is taken
+        bool add_with_id(NetObject* nop, net_object_id_t net_id);
+
+        // gives back its connection states, doesn't delete it
+        void remove(NetObject* nop);
+
+        // forgets everything without deleting anything, delete the objects after
+        void clear();
+
+    public:
+        // null if the object with this id is gone, even if its slot is in use
+        NetObject* find(net_object_id_t net_id) const;
+
+        // whatever is in the slot now
+        inline NetObject* find_by_index(uint index) const { return (index < m_slots.size()) ? m_slots[index].nop : nullptr; }
+        inline uint get_slot_count() const { return (uint)m_slots.size(); }
+        inline uint get_object_count() const { return m_object_count; }
+
+        // made on first use, stays where it is until an object is added
+        net_connection_state_t* get_conn_state(uint8_t conn_index, NetObject* nop);
+
+        // releases every state the connection has, for when its index is reused
+        void reset_connection(uint8_t conn_index);
+
+    private:
+        u16 alloc_slot();
+        void free_slot(u16 index);
+        void occupy_slot(u16 index, NetObject* nop, u16 generation);
+};
@@ -1,33 +1,109 @@
 #include "Engine/Net/Object/net_object_system.hpp"
+#include "Engine/Net/Object/net_object_system_internal.hpp"
 #include "Engine/Net/Object/net_object_type_definition.hpp"
+#include "Engine/Net/Object/net_object_registry.hpp"
 #include "Engine/Net/session.hpp"
 #include "Engine/Net/connection.hpp"
+#include "Engine/Net/net_link_sim.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/interval.h"
 #include "Engine/Core/Console.hpp"
+#include "Engine/Core/log.h"
+#include "Engine/Core/bit_packer.h"
+#include "Engine/Math/MathUtils.hpp"
 
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
 
-#define DEFAULT_UPDATE_HZ 20
+// unused budget carries over, but no more than this many ticks of it
+#define NET_OBJECT_MAX_BUDGET_TICKS 2
+
+// an object waiting longer than this to be sent counts as starved
+#define NET_OBJECT_STARVATION_SECONDS (1.0)
+
+// the client pings the host this often to keep its idea of the host's clock
+// right, and goes by the best of the last few
+#define NET_CLOCK_PING_SECONDS (0.5)
+#define NET_CLOCK_SAMPLE_COUNT 8
+
+// further off than this and the clock jumps, otherwise it's slewed towards the
+// new offset at no more than NET_CLOCK_MAX_SLEW seconds a second
+#define NET_CLOCK_SNAP_SECONDS (0.25)
+#define NET_CLOCK_MAX_SLEW (0.05)
+
+// how quickly the arrival estimates follow what updates are doing
+#define NET_ARRIVAL_SMOOTHING (0.1f)
+
+// an object whose updates are late keeps going for up to this many update periods
+#define NET_OBJECT_MAX_EXTRAPOLATION_PERIODS (1.0f)
+
+// an object with something to send to the connection being scheduled
+struct net_object_send_candidate_t
+{
+    NetObject* nop;
+    net_connection_state_t* conn_state;
+    u32 field_mask;
+};
+
+struct net_clock_sample_t
+{
+    double offset;
+    double rtt;
+};
+
+// client side, the host's clock as an offset from ours. Each pong gives an
+// offset assuming the ping took as long there as back, the one with the
+// shortest round trip is the one that waited in the fewest queues.
+struct net_object_clock_t
+{
+    bool has_offset;
+    double offset;
+    double target_offset;
+    double last_update_time;
+
+    net_clock_sample_t samples[NET_CLOCK_SAMPLE_COUNT];
+    uint sample_count;
+    uint next_sample;
+
+    double next_ping_time;
+    double rtt;
+};
+
+// client side, how updates have been arriving in host time. Lateness is how far
+// behind the host's clock one gets here, and jitter how much that varies.
+struct net_object_arrival_t
+{
+    bool has_update;
+    double newest_host_time;
+    f32 period;
+    f32 lateness;
+    f32 jitter;
+};
 
-static double g_host_clocktime = 0.0f;
-static double g_client_clocktime = 0.0f;
 static bool g_client_ready = false;
+static net_object_clock_t g_clock;
+static net_object_arrival_t g_arrival;
 
-static net_object_id_t g_next_id;
 static NetSession* g_session;
 static Interval g_update_interval;
 static std::map<uint8_t, NetObjectTypeDefinition*> g_registered_defns;
-static std::map<net_object_id_t, NetObject*> g_registered_objects;
+static NetObjectRegistry g_registry;
+
+// by connection index, made when the connection joins
+static net_object_connection_t* g_connections[MAX_NET_OBJECT_CONNECTIONS];
+static net_object_update_acks_t g_update_acks;
+static uint g_bytes_per_second = DEFAULT_NET_OBJECT_BYTES_PER_SECOND;
 
 static void on_receive_net_object_create(NetMessage* msg)
 {
     uint8_t type_id;
     msg->read(type_id);
 
-    uint16_t net_id;
+    net_object_id_t net_id;
     msg->read(net_id);
 
     NetObjectTypeDefinition *defn = net_object_find_definition(type_id);
@@ -37,16 +113,22 @@ static void on_receive_net_object_create(NetMessage* msg)
     nop->m_net_id = net_id;
     nop->m_type_id = type_id;
 
+    // register object with system
+    if(!net_object_register(nop)){
+        log_warningf("Net object %08x was created where there already is one", net_id);
+        delete nop;
+        return;
+    }
+
     void* local_object = defn->process_create_info(msg, nop);
     ASSERT_OR_DIE(local_object != nullptr, "Failed to construct local object from net object");
 
     nop->m_local_object = local_object;
-    net_object_register(nop); // register object with system
 }
 
 static void on_receive_net_object_destroy(NetMessage* msg)
 {
-    uint16_t net_id;
+    net_object_id_t net_id;
     msg->read(net_id);
 
     NetObject *nop = net_object_find(net_id);
@@ -63,108 +145,750 @@ static void on_receive_net_object_destroy(NetMessage* msg)
     delete nop;
 }
 
-static void net_object_send_updates_to(NetConnection* conn)
+// [u16 update_id][double host_time][u16 entry_count], the entries after it are
+// bit packed
+#define NET_OBJECT_UPDATE_HEADER_SIZE (sizeof(u16) + sizeof(double) + sizeof(u16))
+#define MAX_NET_OBJECT_UPDATE_BODY_BITS ((MAX_PAYLOAD_SIZE - NET_OBJECT_UPDATE_HEADER_SIZE) * BITS_PER_BYTE)
+
+// small numbers are written a group of bits at a time, each followed by a bit
+// saying if there's more
+#define NET_OBJECT_SMALL_UINT_GROUP_BITS 4
+
+// the update being written or read, and one object's snapshot on its way into it.
+// A legacy snapshot can be a whole payload plus its 16 bit size, anything that
+// big is turned away with a warning once it's been measured
+static BitPacker g_update_packer(MAX_PAYLOAD_SIZE);
+static BitPacker g_snapshot_packer(MAX_PAYLOAD_SIZE + sizeof(u16));
+
+// where snapshots that arrived too late are read into and thrown away
+static std::vector<byte_t> g_stale_snapshot;
+
+static std::vector<net_object_send_candidate_t> g_send_candidates;
+static std::vector<net_object_send_candidate_t> g_selected_candidates;
+
+struct net_object_update_writer_t
+{
+    NetConnection* conn;
+    net_object_connection_t* conn_updates;
+    double host_time;
+
+    bool is_open;
+    u16 update_id;
+    u16 entry_count;
+    u16 next_index;
+
+    uint bytes_written;
+};
+
+void net_object_reset_connection(net_object_connection_t* conn_updates, uint bytes_per_second)
+{
+    for(uint update_idx = 0; update_idx < MAX_TRACKED_UPDATES; ++update_idx){
+        conn_updates->updates[update_idx].is_valid = false;
+    }
+    conn_updates->bytes_per_second = bytes_per_second;
+    conn_updates->budget_bytes = 0.0f;
+}
+
+static net_object_connection_t* net_object_get_connection(uint8_t conn_index)
+{
+    if(conn_index >= MAX_NET_OBJECT_CONNECTIONS){
+        return nullptr;
+    }
+
+    net_object_connection_t* conn_updates = g_connections[conn_index];
+    if(nullptr == conn_updates){
+        conn_updates = new net_object_connection_t();
+        conn_updates->next_update_id = 0;
+        net_object_reset_connection(conn_updates, g_bytes_per_second);
+        g_connections[conn_index] = conn_updates;
+    }
+    return conn_updates;
+}
+
+// Varints a few bits a group. Used for the gaps between ids, entries are in id
+// order so runs of neighbours cost a bit each, and for how far back a baseline is.
+static uint net_object_get_small_uint_bit_count(uint value)
+{
+    return BitPacker::get_varint_bit_count(value, NET_OBJECT_SMALL_UINT_GROUP_BITS);
+}
+
+static void net_object_write_small_uint(BitPacker* packer, uint value)
+{
+    packer->write_varint(value, NET_OBJECT_SMALL_UINT_GROUP_BITS);
+}
+
+// anything that doesn't fit a u16 is as good as corrupt
+static bool net_object_read_small_uint(BitPacker* packer, uint bit_count, uint* out_value)
+{
+    u64 value;
+    if(!packer->read_varint(&value, NET_OBJECT_SMALL_UINT_GROUP_BITS, bit_count) || (value > 0xFFFF)){
+        return false;
+    }
+
+    *out_value = (uint)value;
+    return true;
+}
+
+static void net_object_open_update(net_object_update_writer_t* writer)
+{
+    net_object_connection_t* conn_updates = writer->conn_updates;
+    u16 update_id = conn_updates->next_update_id++;
+
+    net_object_update_record_t& record = conn_updates->updates[update_id % MAX_TRACKED_UPDATES];
+    record.is_valid = true;
+    record.update_id = update_id;
+    record.net_ids.clear();
+
+    writer->is_open = true;
+    writer->update_id = update_id;
+    writer->entry_count = 0;
+    writer->next_index = 0;
+    g_update_packer.reset();
+}
+
+static void net_object_close_update(net_object_update_writer_t* writer)
+{
+    if(!writer->is_open){
+        return;
+    }
+
+    // sized for exactly this, the pool hands out the smallest buffer that fits
+    uint body_bytes = g_update_packer.get_num_bytes_written();
+    NetMessage* msg = new NetMessage(NETOBJECT_UPDATE);
+    msg->reserve(sizeof(writer->update_id) + sizeof(writer->host_time) + sizeof(writer->entry_count) + body_bytes);
+    msg->write(writer->update_id);
+    msg->write(writer->host_time);
+    msg->write(writer->entry_count);
+    msg->write_bytes(g_update_packer.m_buffer, body_bytes);
+    writer->bytes_written += msg->get_full_size();
+    writer->conn->send(msg);
+
+    writer->is_open = false;
+}
+
+// [slot index gap] then for types with fields [has baseline][how many updates back
+// it is] ahead of the fields. An acked baseline is always older than the update
+// being written, so the age goes out less one.
+static uint net_object_get_entry_prefix_bit_count(NetObject* nop, net_object_update_writer_t* writer, const void* baseline, u16 baseline_update_id)
+{
+    uint bit_count = net_object_get_small_uint_bit_count((u16)(get_net_object_index(nop->m_net_id) - writer->next_index));
+    if(nop->m_defn->has_fields()){
+        bit_count += 1;
+        if(nullptr != baseline){
+            bit_count += net_object_get_small_uint_bit_count((u16)(writer->update_id - baseline_update_id - 1));
+        }
+    }
+    return bit_count;
+}
+
+// Types with fields send the fields that changed since the connection's last ack,
+// as deltas from it where they can. The rest send their whole snapshot after a
+// 16 bit size.
+static void net_object_write_update_entry(net_object_update_writer_t* writer, NetObject* nop, net_connection_state_t* conn_state, u32 field_mask, double host_time)
+{
+    NetObjectTypeDefinition* defn = nop->m_defn;
+    u16 baseline_update_id = 0;
+    const void* baseline = nullptr;
+
+    g_snapshot_packer.reset();
+    if(defn->has_fields()){
+        baseline = nop->get_acked_snapshot(conn_state, &baseline_update_id);
+        defn->write_fields(&g_snapshot_packer, nop->m_current_snapshot, baseline, field_mask);
+    }else{
+        // written straight into scratch space, it's only here long enough to copy
+        byte_t legacy_buffer[MAX_PAYLOAD_SIZE];
+        NetMessage legacy_snapshot(NETOBJECT_UPDATE, legacy_buffer, sizeof(legacy_buffer));
+        nop->append_snapshot(&legacy_snapshot);
+        g_snapshot_packer.write<u16>((u16)legacy_snapshot.m_payload_bytes_used, 16);
+        g_snapshot_packer.write_bytes(legacy_snapshot.m_payload, legacy_snapshot.m_payload_bytes_used);
+    }
+    uint snapshot_bits = g_snapshot_packer.m_bits_written;
+
+    // try it in what's open, then in a fresh one
+    uint entry_bits = 0;
+    for(uint attempt = 0; attempt < 2; ++attempt){
+        if(!writer->is_open){
+            net_object_open_update(writer);
+        }
+
+        entry_bits = net_object_get_entry_prefix_bit_count(nop, writer, baseline, baseline_update_id) + snapshot_bits;
+        if((g_update_packer.m_bits_written + entry_bits <= MAX_NET_OBJECT_UPDATE_BODY_BITS) && (writer->entry_count < 0xFFFF)){
+            break;
+        }
+
+        entry_bits = 0;
+        if(0 == writer->entry_count){
+            break;
+        }
+        net_object_close_update(writer);
+    }
+
+    if(0 == entry_bits){
+        log_warningf("Snapshot for net object %u is too big to send (%u bits)", nop->m_net_id, snapshot_bits);
+        return;
+    }
+
+    u16 index = get_net_object_index(nop->m_net_id);
+    net_object_write_small_uint(&g_update_packer, (u16)(index - writer->next_index));
+    if(defn->has_fields()){
+        g_update_packer.write_bit(nullptr != baseline);
+        if(nullptr != baseline){
+            net_object_write_small_uint(&g_update_packer, (u16)(writer->update_id - baseline_update_id - 1));
+        }
+    }
+    g_snapshot_packer.flush();
+    g_update_packer.write_bits(g_snapshot_packer.m_buffer, snapshot_bits);
+    writer->next_index = (u16)(index + 1);
+    writer->entry_count++;
+
+    double latency = host_time - conn_state->m_waiting_since;
+    conn_state->m_priority = 0.0f;
+    conn_state->m_is_waiting = false;
+
+    nop->on_snapshot_sent(conn_state, writer->update_id, field_mask);
+    writer->conn_updates->updates[writer->update_id % MAX_TRACKED_UPDATES].net_ids.push_back(nop->m_net_id);
+
+    net_object_type_stats_t& stats = defn->m_stats;
+    stats.updates_sent++;
+    stats.bits_sent += entry_bits;
+    stats.full_snapshot_bits += (uint)((sizeof(u16) + defn->m_snapshot_size) * BITS_PER_BYTE);
+    stats.total_send_latency += latency;
+    stats.max_send_latency = Max(stats.max_send_latency, latency);
+    if(latency > NET_OBJECT_STARVATION_SECONDS){
+        stats.starved_count++;
+    }
+}
+
+// what an entry will take, near enough to spend a budget with
+static uint net_object_estimate_entry_bits(NetObject* nop, const net_connection_state_t* conn_state, u32 field_mask)
+{
+    // an id gap of up to 16 and a recent baseline
+    const uint prefix_bits = 8;
+
+    NetObjectTypeDefinition* defn = nop->m_defn;
+    if(!defn->has_fields()){
+        return prefix_bits + 16 + (uint)(defn->m_snapshot_size * BITS_PER_BYTE);
+    }
+
+    u16 baseline_update_id;
+    const void* baseline = nop->get_acked_snapshot(conn_state, &baseline_update_id);
+    return prefix_bits + defn->get_written_bit_count(nop->m_current_snapshot, baseline, field_mask);
+}
+
+static bool net_object_compare_priority(const net_object_send_candidate_t& a, const net_object_send_candidate_t& b)
+{
+    return a.conn_state->m_priority > b.conn_state->m_priority;
+}
+
+static bool net_object_compare_index(const net_object_send_candidate_t& a, const net_object_send_candidate_t& b)
+{
+    return get_net_object_index(a.nop->m_net_id) < get_net_object_index(b.nop->m_net_id);
+}
+
+// Every object with something for the connection gains priority (its type's
+// weight times how relevant it is to the connection) until it's sent. Each tick
+// the connection's budget is spent on the highest first, anything that doesn't
+// fit keeps its priority for next time. What's picked is written in id order, as
+// few updates as will hold them.
+void net_object_send_updates_to(NetConnection* conn, NetObjectRegistry& registry, net_object_connection_t* conn_updates, double host_time, double tick_seconds)
 {
     if(nullptr == conn){
         return;
     }
 
-    for(unsigned int i = 0; i < g_registered_objects.size(); i++){
-        NetObject* nop = g_registered_objects[(uint16_t)i];
+    uint8_t conn_index = conn->m_connection_index;
+
+    bool is_budgeted = (conn_updates->bytes_per_second > 0);
+    if(is_budgeted){
+        f32 tick_bytes = (f32)(conn_updates->bytes_per_second * tick_seconds);
+        conn_updates->budget_bytes = Min(conn_updates->budget_bytes + tick_bytes, tick_bytes * NET_OBJECT_MAX_BUDGET_TICKS);
+    }
+
+    g_send_candidates.clear();
+    uint slot_count = registry.get_slot_count();
+    for(uint index = 0; index < slot_count; ++index){
+        NetObject* nop = registry.find_by_index(index);
         if(nullptr == nop){
             continue;
         }
 
-        if(nop->is_synced(conn->m_connection_index)){
+        net_connection_state_t* conn_state = registry.get_conn_state(conn_index, nop);
+        u32 field_mask = nop->get_fields_to_send(conn_state);
+        f32 relevance = (0 != field_mask) ? nop->m_defn->get_relevance(nop->m_local_object, conn) : 0.0f;
+        if(relevance <= 0.0f){
+            conn_state->m_priority = 0.0f;
+            conn_state->m_is_waiting = false;
             continue;
         }
 
-        NetMessage* msg = new NetMessage(NETOBJECT_UPDATE);
+        if(!conn_state->m_is_waiting){
+            conn_state->m_is_waiting = true;
+            conn_state->m_waiting_since = host_time;
+        }
+        conn_state->m_priority += nop->m_defn->m_priority * relevance;
 
-        msg->write(nop->m_net_id);
-        msg->write(get_current_time_seconds());
-        nop->append_snapshot(msg);
+        net_object_send_candidate_t candidate;
+        candidate.nop = nop;
+        candidate.conn_state = conn_state;
+        candidate.field_mask = field_mask;
+        g_send_candidates.push_back(candidate);
+    }
 
-        conn->send(msg);
+    g_selected_candidates.clear();
+    if(is_budgeted){
+        std::sort(g_send_candidates.begin(), g_send_candidates.end(), net_object_compare_priority);
+
+        f32 budget_bits = conn_updates->budget_bytes * BITS_PER_BYTE;
+        for(unsigned int i = 0; i < g_send_candidates.size(); ++i){
+            const net_object_send_candidate_t& candidate = g_send_candidates[i];
+            uint entry_bits = net_object_estimate_entry_bits(candidate.nop, candidate.conn_state, candidate.field_mask);
+            if((f32)entry_bits <= budget_bits){
+                budget_bits -= (f32)entry_bits;
+                g_selected_candidates.push_back(candidate);
+            }else{
+                candidate.nop->m_defn->m_stats.deferred_count++;
+            }
+        }
+
+        std::sort(g_selected_candidates.begin(), g_selected_candidates.end(), net_object_compare_index);
+    }else{
+        // already in id order
+        g_selected_candidates.swap(g_send_candidates);
+    }
+
+    net_object_update_writer_t writer;
+    writer.conn = conn;
+    writer.conn_updates = conn_updates;
+    writer.host_time = host_time;
+    writer.is_open = false;
+    writer.bytes_written = 0;
 
-        nop->save_last_sent_snapshot(conn->m_connection_index, nop->m_current_snapshot);
+    for(unsigned int i = 0; i < g_selected_candidates.size(); ++i){
+        const net_object_send_candidate_t& candidate = g_selected_candidates[i];
+        net_object_write_update_entry(&writer, candidate.nop, candidate.conn_state, candidate.field_mask, host_time);
+    }
+    net_object_close_update(&writer);
+
+    if(is_budgeted){
+        conn_updates->budget_bytes -= (f32)writer.bytes_written;
     }
 }
 
-static void net_object_send_updates()
+void net_object_refresh_snapshots(NetObjectRegistry& registry)
 {
-    for(unsigned int i = 0; i < g_registered_objects.size(); ++i){
-        NetObject* nop = g_registered_objects[(uint16_t)i];
+    uint slot_count = registry.get_slot_count();
+    for(uint index = 0; index < slot_count; ++index){
+        NetObject* nop = registry.find_by_index(index);
         if(nullptr != nop){
             nop->refresh_current_snapshot();
         }
     }
+}
+
+static void net_object_send_updates()
+{
+    net_object_refresh_snapshots(g_registry);
+
+    double host_time = get_current_time_seconds();
+    double tick_seconds = g_update_interval.m_interval_time;
 
     // start at 1, 0 is host
     for(unsigned int i = 1; i < g_session->m_connections.size(); i++){
         NetConnection* conn = g_session->m_connections[i];
         if(nullptr != conn){
-            net_object_send_updates_to(conn);
+            net_object_send_updates_to(conn, g_registry, net_object_get_connection(conn->m_connection_index), host_time, tick_seconds);
         }
     }
 }
 
-static void on_receive_net_object_update(NetMessage* msg)
+static void net_object_mark_update_received(net_object_update_acks_t* acks, u16 update_id)
 {
-    uint16_t net_id;
-    msg->read(net_id);
+    if(!acks->has_received){
+        acks->has_received = true;
+        acks->newest_update_id = update_id;
+        acks->previous_bitfield = 0;
+    }else if(cycle_greater_than(update_id, acks->newest_update_id)){
+        u16 shift = (u16)(update_id - acks->newest_update_id);
+        if(shift > 32){
+            acks->previous_bitfield = 0;
+        }else{
+            // the old newest becomes bit shift - 1
+            u32 shifted = (shift == 32) ? 0 : (acks->previous_bitfield << shift);
+            acks->previous_bitfield = shifted | (1U << (shift - 1));
+        }
+        acks->newest_update_id = update_id;
+    }else{
+        u16 age = (u16)(acks->newest_update_id - update_id);
+        if((age > 0) && (age <= 32)){
+            acks->previous_bitfield |= (1U << (age - 1));
+        }
+    }
+
+    acks->needs_ack = true;
+}
+
+// One entry from g_update_packer. It's read into the object unless the object
+// has already seen something newer or doesn't have the baseline it was written
+// against, either way the bits are read past.
+static bool net_object_read_update_entry(NetObject* nop, u16 update_id, double host_time, uint body_bits, bool* out_was_applied)
+{
+    NetObjectTypeDefinition* defn = nop->m_defn;
+    g_stale_snapshot.resize(defn->m_snapshot_size);
 
+    if(!defn->has_fields()){
+        if(g_update_packer.m_bits_read + 16 > body_bits){
+            return false;
+        }
+        u16 snapshot_size = g_update_packer.read<u16>(16);
+        if((snapshot_size > MAX_PAYLOAD_SIZE) || (g_update_packer.m_bits_read + (snapshot_size * BITS_PER_BYTE) > body_bits)){
+            return false;
+        }
+
+        NetMessage legacy_snapshot;
+        if(snapshot_size > 0){
+            legacy_snapshot.reserve(snapshot_size);
+            g_update_packer.read_bits(legacy_snapshot.m_payload, legacy_snapshot.m_payload_capacity, snapshot_size * BITS_PER_BYTE);
+            legacy_snapshot.m_payload_bytes_used = snapshot_size;
+        }
+
+        *out_was_applied = nop->accept_update(update_id);
+        if(*out_was_applied){
+            nop->process_snapshot(&legacy_snapshot);
+            nop->save_received_snapshot(update_id, host_time);
+        }
+        return true;
+    }
+
+    if(g_update_packer.m_bits_read + 1 > body_bits){
+        return false;
+    }
+    bool is_delta = g_update_packer.read_bit();
+
+    const void* baseline = nullptr;
+    if(is_delta){
+        uint baseline_age;
+        if(!net_object_read_small_uint(&g_update_packer, body_bits, &baseline_age)){
+            return false;
+        }
+        baseline = nop->find_received_snapshot((u16)(update_id - baseline_age - 1));
+    }
+
+    *out_was_applied = (!is_delta || (nullptr != baseline)) && nop->accept_update(update_id);
+
+    void* snapshot = *out_was_applied ? nop->m_last_received_snapshot : g_stale_snapshot.data();
+    if(!defn->read_fields(&g_update_packer, snapshot, *out_was_applied ? baseline : nullptr, is_delta, body_bits)){
+        return false;
+    }
+
+    if(*out_was_applied){
+        nop->save_received_snapshot(update_id, host_time);
+        nop->m_is_local_dirty = true;
+        nop->m_snapshot_is_valid = true;
+    }
+    return true;
+}
+
+// The update's host time goes in out_host_time, false if it couldn't be read.
+bool net_object_process_update(NetMessage* msg, NetObjectRegistry& registry, net_object_update_acks_t* acks, double* out_host_time)
+{
+    u16 update_id;
     double host_time;
-    msg->read(host_time);
+    u16 entry_count;
+    if(!msg->read(update_id) || !msg->read(host_time) || !msg->read(entry_count)){
+        return false;
+    }
+    *out_host_time = host_time;
+
+    size_t body_size = msg->m_payload_bytes_used - msg->m_payload_bytes_read;
+    memcpy(g_update_packer.m_buffer, msg->m_payload + msg->m_payload_bytes_read, body_size);
+    g_update_packer.reset();
+    uint body_bits = (uint)(body_size * BITS_PER_BYTE);
+
+    // Only acked if every object in it was applied, otherwise the host would take
+    // it as a baseline we don't have. One we don't know about yet can't even be
+    // read past since its type says how long it is.
+    bool applied_all = true;
+
+    // entries only carry the slot, the host holds a freed one back long enough
+    // that whatever is in it is who the update was for
+    u16 next_index = 0;
+    for(uint entry_idx = 0; entry_idx < entry_count; ++entry_idx){
+        uint gap;
+        if(!net_object_read_small_uint(&g_update_packer, body_bits, &gap)){
+            return true;
+        }
+
+        u16 index = (u16)(next_index + gap);
+        next_index = (u16)(index + 1);
 
-    NetObject* nop = net_object_find(net_id);
-    if(nullptr == nop){
+        NetObject* nop = registry.find_by_index(index);
+        if(nullptr == nop){
+            applied_all = false;
+            break;
+        }
+
+        bool was_applied;
+        if(!net_object_read_update_entry(nop, update_id, host_time, body_bits, &was_applied)){
+            return true;
+        }
+        applied_all = applied_all && was_applied;
+    }
+
+    if(applied_all){
+        net_object_mark_update_received(acks, update_id);
+    }
+    return true;
+}
+
+static void net_object_clock_reset(net_object_clock_t* clock, double host_time, double now)
+{
+    memset(clock, 0, sizeof(*clock));
+    clock->has_offset = true;
+    clock->offset = host_time - now;
+    clock->target_offset = clock->offset;
+    clock->last_update_time = now;
+    clock->next_ping_time = now;
+}
+
+static void net_object_clock_add_sample(net_object_clock_t* clock, double send_time, double host_time, double now)
+{
+    double rtt = now - send_time;
+    if(rtt < 0.0){
         return;
     }
 
-    double client_timestamp = (host_time - g_host_clocktime) + g_client_clocktime;
+    net_clock_sample_t& sample = clock->samples[clock->next_sample];
+    sample.rtt = rtt;
+    sample.offset = (host_time + (rtt * 0.5)) - now;
+    clock->next_sample = (clock->next_sample + 1) % NET_CLOCK_SAMPLE_COUNT;
+    clock->sample_count = Min(clock->sample_count + 1, (uint)NET_CLOCK_SAMPLE_COUNT);
 
-    nop->m_last_received_snapshot_client_timestamp = client_timestamp;
-    nop->process_snapshot(msg);
+    const net_clock_sample_t* best = &clock->samples[0];
+    for(uint sample_idx = 1; sample_idx < clock->sample_count; ++sample_idx){
+        if(clock->samples[sample_idx].rtt < best->rtt){
+            best = &clock->samples[sample_idx];
+        }
+    }
+    clock->target_offset = best->offset;
+    clock->rtt = best->rtt;
+
+    if(!clock->has_offset || (fabs(clock->target_offset - clock->offset) > NET_CLOCK_SNAP_SECONDS)){
+        clock->offset = clock->target_offset;
+        clock->has_offset = true;
+    }
+}
+
+// slews towards the best sample so the host time we draw at never jumps or
+// goes backwards
+static void net_object_clock_update(net_object_clock_t* clock, double now)
+{
+    double max_step = Max(now - clock->last_update_time, 0.0) * NET_CLOCK_MAX_SLEW;
+    clock->offset += Clamp(clock->target_offset - clock->offset, -max_step, max_step);
+    clock->last_update_time = now;
+}
+
+static double net_object_clock_get_host_time(const net_object_clock_t* clock, double now)
+{
+    return now + clock->offset;
+}
+
+static void net_object_arrival_reset(net_object_arrival_t* arrival)
+{
+    memset(arrival, 0, sizeof(*arrival));
+    arrival->period = 1.0f / DEFAULT_UPDATE_HZ;
+}
+
+static void net_object_arrival_add_update(net_object_arrival_t* arrival, double update_host_time, double host_now)
+{
+    f32 lateness = (f32)(host_now - update_host_time);
+    if(!arrival->has_update){
+        arrival->has_update = true;
+        arrival->newest_host_time = update_host_time;
+        arrival->lateness = lateness;
+        arrival->jitter = 0.0f;
+        return;
+    }
+
+    arrival->jitter += (fabsf(lateness - arrival->lateness) - arrival->jitter) * NET_ARRIVAL_SMOOTHING;
+    arrival->lateness += (lateness - arrival->lateness) * NET_ARRIVAL_SMOOTHING;
+
+    // a reordered one says nothing about the period
+    if(update_host_time > arrival->newest_host_time){
+        f32 period = (f32)(update_host_time - arrival->newest_host_time);
+        arrival->period += (period - arrival->period) * NET_ARRIVAL_SMOOTHING;
+        arrival->newest_host_time = update_host_time;
+    }
+}
+
+// Far enough behind the host that the next update has usually arrived by the
+// time it's needed, but no further back than the snapshots each object keeps.
+static f32 net_object_arrival_get_render_delay(const net_object_arrival_t* arrival)
+{
+    f32 buffered = arrival->period + (2.0f * arrival->jitter);
+    buffered = Min(buffered, (MAX_RECEIVED_SNAPSHOTS - 2) * arrival->period);
+    return arrival->lateness + buffered;
+}
+
+static void on_receive_net_object_update(NetMessage* msg)
+{
+    double host_time;
+    if(net_object_process_update(msg, g_registry, &g_update_acks, &host_time) && g_clock.has_offset){
+        double host_now = net_object_clock_get_host_time(&g_clock, get_current_time_seconds());
+        net_object_arrival_add_update(&g_arrival, host_time, host_now);
+    }
+}
+
+bool net_object_write_update_ack(NetMessage* msg, net_object_update_acks_t* acks)
+{
+    if(!acks->needs_ack){
+        return false;
+    }
+
+    msg->write(acks->newest_update_id);
+    msg->write(acks->previous_bitfield);
+    acks->needs_ack = false;
+    return true;
+}
+
+static void net_object_ack_update(net_object_connection_t* conn_updates, uint8_t conn_index, NetObjectRegistry& registry, u16 update_id)
+{
+    net_object_update_record_t& record = conn_updates->updates[update_id % MAX_TRACKED_UPDATES];
+    if(!record.is_valid || (record.update_id != update_id)){
+        return;
+    }
+
+    // objects destroyed since, and anything that took their slot, are skipped
+    for(unsigned int i = 0; i < record.net_ids.size(); ++i){
+        NetObject* nop = registry.find(record.net_ids[i]);
+        if(nullptr != nop){
+            nop->on_snapshot_acked(registry.get_conn_state(conn_index, nop), update_id);
+        }
+    }
+
+    record.is_valid = false;
+}
+
+void net_object_process_update_ack(NetMessage* msg, net_object_connection_t* conn_updates, uint8_t conn_index, NetObjectRegistry& registry)
+{
+    u16 newest_update_id;
+    u32 previous_bitfield;
+    if(!msg->read(newest_update_id) || !msg->read(previous_bitfield)){
+        return;
+    }
+
+    // oldest first so each object's baseline only moves forward
+    for(int age = 32; age > 0; --age){
+        if(previous_bitfield & (1U << (age - 1))){
+            net_object_ack_update(conn_updates, conn_index, registry, (u16)(newest_update_id - age));
+        }
+    }
+    net_object_ack_update(conn_updates, conn_index, registry, newest_update_id);
+}
+
+static void on_receive_net_object_ack(NetMessage* msg)
+{
+    if(nullptr == msg->m_sender){
+        return;
+    }
+
+    uint8_t conn_index = msg->m_sender->m_connection_index;
+    net_object_connection_t* conn_updates = net_object_get_connection(conn_index);
+    if(nullptr != conn_updates){
+        net_object_process_update_ack(msg, conn_updates, conn_index, g_registry);
+    }
 }
 
 static void net_object_system_connection_joined(void* user_arg, NetConnection* new_conn)
 {
+    // the index may have been someone else's, nothing they acked counts
+    uint8_t conn_index = new_conn->m_connection_index;
+    net_object_connection_t* conn_updates = net_object_get_connection(conn_index);
+    if(nullptr != conn_updates){
+        net_object_reset_connection(conn_updates, g_bytes_per_second);
+    }
+    g_registry.reset_connection(conn_index);
+
     NetMessage* msg = new NetMessage(NETOBJECT_SET_CLOCK);
     msg->write(get_current_time_seconds());
     new_conn->send(msg);
 }
 
+// Good to within the trip it took to get here. The pings that follow make up
+// for that.
 static void on_receive_net_object_set_clock(NetMessage* msg)
 {
-    msg->read(g_host_clocktime);
-    g_client_clocktime = get_current_time_seconds();
+    double host_time;
+    if(!msg->read(host_time)){
+        return;
+    }
+
+    net_object_clock_reset(&g_clock, host_time, get_current_time_seconds());
+    net_object_arrival_reset(&g_arrival);
     g_client_ready = true;
+
+    memset(&g_update_acks, 0, sizeof(g_update_acks));
+}
+
+// answered right away with when it was sent and the host's time now
+static void on_receive_net_object_ping(NetMessage* msg)
+{
+    double send_time;
+    if((nullptr == msg->m_sender) || !msg->read(send_time)){
+        return;
+    }
+
+    NetMessage* pong = new NetMessage(NETMSG_PONG);
+    pong->write(send_time);
+    pong->write(get_current_time_seconds());
+    msg->m_sender->send(pong);
+}
+
+static void on_receive_net_object_pong(NetMessage* msg)
+{
+    double send_time;
+    double host_time;
+    if(!g_client_ready || !msg->read(send_time) || !msg->read(host_time)){
+        return;
+    }
+
+    net_object_clock_add_sample(&g_clock, send_time, host_time, get_current_time_seconds());
 }
 
 void net_object_system_init()
 {
-    g_next_id = 0;
     g_session = nullptr;
+    memset(&g_update_acks, 0, sizeof(g_update_acks));
+    memset(&g_clock, 0, sizeof(g_clock));
+    net_object_arrival_reset(&g_arrival);
     g_update_interval.set_frequency(DEFAULT_UPDATE_HZ);
 }
 
 void net_object_system_shutdown()
 {
+    // objects before their definitions, their snapshots are the definitions'
+    std::vector<NetObject*> objects;
+    for(uint index = 0; index < g_registry.get_slot_count(); ++index){
+        NetObject* nop = g_registry.find_by_index(index);
+        if(nullptr != nop){
+            objects.push_back(nop);
+        }
+    }
+    g_registry.clear();
+    for(unsigned int i = 0; i < objects.size(); ++i){
+        SAFE_DELETE(objects[i]);
+    }
+
     std::map<uint8_t, NetObjectTypeDefinition*>::iterator defn_it = g_registered_defns.begin();
     while(defn_it != g_registered_defns.end()){
         SAFE_DELETE(defn_it->second);
         defn_it++;
     }
 
-    std::map<net_object_id_t, NetObject*>::iterator obj_it = g_registered_objects.begin();
-    while(obj_it != g_registered_objects.end()){
-        SAFE_DELETE(obj_it->second);
-        obj_it++;
+    for(uint conn_index = 0; conn_index < MAX_NET_OBJECT_CONNECTIONS; ++conn_index){
+        SAFE_DELETE(g_connections[conn_index]);
     }
 
     g_registered_defns.clear();
-    g_registered_objects.clear();
 }
 
 void net_object_system_tick()
@@ -181,12 +905,29 @@ void net_object_system_tick()
     }
 
     if(g_session->is_client() && g_client_ready){
-        for(unsigned int i = 0; i < g_registered_objects.size(); ++i){
-            NetObject* nop = g_registered_objects[(uint16_t)i];
-            if(nullptr != nop /* && nop->m_is_local_dirty */){
-                nop->apply_latest_snapshot();
+        double now = get_current_time_seconds();
+        net_object_clock_update(&g_clock, now);
+        if(now >= g_clock.next_ping_time){
+            NetMessage ping(NETMSG_PING);
+            ping.write(now);
+            g_session->send_message_to_host(ping);
+            g_clock.next_ping_time = now + NET_CLOCK_PING_SECONDS;
+        }
+
+        double render_time = net_object_system_get_render_time();
+        double max_extrapolation = g_arrival.period * NET_OBJECT_MAX_EXTRAPOLATION_PERIODS;
+        for(uint index = 0; index < g_registry.get_slot_count(); ++index){
+            NetObject* nop = g_registry.find_by_index(index);
+            if(nullptr != nop){
+                nop->apply_snapshot_at(render_time, g_arrival.newest_host_time, max_extrapolation);
             }
-        } 
+        }
+
+        // one ack a tick covers every update since the last
+        NetMessage ack(NETOBJECT_ACK);
+        if(net_object_write_update_ack(&ack, &g_update_acks)){
+            g_session->send_message_to_host(ack);
+        }
     }
 }
 
@@ -203,6 +944,26 @@ void net_object_system_register_session(NetSession* session)
     g_session->register_message(NETOBJECT_DESTROY, on_receive_net_object_destroy);
     g_session->register_message(NETOBJECT_UPDATE, on_receive_net_object_update);
     g_session->register_message(NETOBJECT_SET_CLOCK, on_receive_net_object_set_clock);
+    g_session->register_message(NETOBJECT_ACK, on_receive_net_object_ack);
+    g_session->register_message(NETMSG_PING, on_receive_net_object_ping);
+    g_session->register_message(NETMSG_PONG, on_receive_net_object_pong);
+
+    // lost updates are made up for by the next one, it's sent against whatever
+    // was acked
+    NetMessageDefinition* update_defn = g_session->get_message_definition(NETOBJECT_UPDATE);
+    update_defn->set_is_reliable(false);
+    update_defn->set_is_in_order(false);
+
+    NetMessageDefinition* ack_defn = g_session->get_message_definition(NETOBJECT_ACK);
+    ack_defn->set_is_reliable(false);
+    ack_defn->set_is_in_order(false);
+
+    // a resent ping would only measure the resend
+    uint8_t clock_msg_ids[] = { NETMSG_PING, NETMSG_PONG };
+    for(uint8_t msg_id : clock_msg_ids){
+        g_session->get_message_definition(msg_id)->set_is_reliable(false);
+        g_session->get_message_definition(msg_id)->set_is_in_order(false);
+    }
 
     g_session->m_connection_joined_event->subscribe(nullptr, net_object_system_connection_joined);
 }
@@ -227,34 +988,22 @@ NetObjectTypeDefinition* net_object_find_definition(uint8_t object_type)
     return found->second;
 }
 
-void net_object_register(NetObject* nop)
+bool net_object_register(NetObject* nop)
 {
-    g_registered_objects[nop->m_net_id] = nop;
+    if(INVALID_NET_OBJECT_ID == nop->m_net_id){
+        return g_registry.add(nop);
+    }
+    return g_registry.add_with_id(nop, nop->m_net_id);
 }
 
 void net_object_unregister(NetObject* nop)
 {
-    std::map<uint16_t, NetObject*>::iterator it = g_registered_objects.find(nop->m_net_id);
-    g_registered_objects.erase(it);
+    g_registry.remove(nop);
 }
 
 NetObject* net_object_find(net_object_id_t net_id)
 {
-    std::map<net_object_id_t, NetObject*>::iterator found = g_registered_objects.find(net_id);
-    if(g_registered_objects.end() == found){
-        return nullptr;
-    }
-
-    return found->second;
-}
-
-net_object_id_t net_object_get_unused_id()
-{
-    while(nullptr != net_object_find(g_next_id)){
-        g_next_id++;
-    }
-
-    return g_next_id;
+    return g_registry.find(net_id);
 }
 
 NetObject* net_object_replicate(void* object_ptr, uint8_t type_id)
@@ -267,10 +1016,13 @@ NetObject* net_object_replicate(void* object_ptr, uint8_t type_id)
     NetObject* nop = new NetObject(defn);
 
     nop->m_local_object = object_ptr;
-    nop->m_net_id = net_object_get_unused_id();
     nop->m_type_id = type_id;
 
-    net_object_register(nop);
+    if(!net_object_register(nop)){
+        log_warningf("Out of net object ids, type %u isn't replicated", type_id);
+        delete nop;
+        return nullptr;
+    }
 
     NetMessage create(NETOBJECT_CREATE);
     create.write(nop->m_type_id);
@@ -307,8 +1059,8 @@ void net_object_stop_replication(net_object_id_t net_id)
 
 void net_object_system_init_connection(uint8_t new_connection)
 {
-    for(unsigned int i = 0; i < g_registered_objects.size(); i++){
-        NetObject* nop = g_registered_objects[(uint16_t)i];
+    for(uint index = 0; index < g_registry.get_slot_count(); ++index){
+        NetObject* nop = g_registry.find_by_index(index);
         if(nullptr == nop){
             continue;
         }
@@ -331,14 +1083,17 @@ double net_object_system_get_tick_freq()
 
 unsigned int net_object_system_get_num_objects()
 {
-    unsigned int count = 0;
-    std::map<net_object_id_t, NetObject*>::iterator it;
-    for(it = g_registered_objects.begin(); it != g_registered_objects.end(); it++){
-        if(nullptr != it->second){
-            count++;
-        }
-    }
-    return count;
+    return g_registry.get_object_count();
+}
+
+double net_object_system_get_host_time()
+{
+    return net_object_clock_get_host_time(&g_clock, get_current_time_seconds());
+}
+
+double net_object_system_get_render_time()
+{
+    return net_object_system_get_host_time() - net_object_arrival_get_render_delay(&g_arrival);
 }
 
 COMMAND(net_set_hz, "[int:hz] Sets the update hz of the network tick")
@@ -348,4 +1103,961 @@ COMMAND(net_set_hz, "[int:hz] Sets the update hz of the network tick")
     if(-1 != hz){
         net_object_system_set_update_hz((float)hz);
     }
-}
\ No newline at end of file
+}
+
+COMMAND(net_send_stats, "Prints how well outgoing messages are being batched per connection")
+{
+    NetSession* session = net_object_get_session();
+    if(nullptr == session){
+        console_error("No session");
+        return;
+    }
+
+    for(unsigned int i = 0; i < session->m_connections.size(); ++i){
+        NetConnection* conn = session->m_connections[i];
+        if(nullptr == conn){
+            continue;
+        }
+
+        const net_connection_stats_t& stats = conn->m_send_stats;
+        console_info("[%u] %u messages, %u packets, %u bytes, %u sends, %.1f messages per packet",
+            i,
+            stats.messages_sent,
+            stats.packets_sent,
+            stats.bytes_sent,
+            stats.syscalls,
+            conn->get_messages_per_packet());
+    }
+}
+
+COMMAND(net_object_stats, "Prints replication bandwidth for each net object type")
+{
+    if(g_registered_defns.empty()){
+        console_info("No net object types registered");
+        return;
+    }
+
+    std::map<uint8_t, NetObjectTypeDefinition*>::iterator it;
+    for(it = g_registered_defns.begin(); it != g_registered_defns.end(); ++it){
+        const net_object_type_stats_t& stats = it->second->m_stats;
+        float bytes_sent = (float)stats.bits_sent / (float)BITS_PER_BYTE;
+        float bytes_per_update = (stats.updates_sent > 0) ? (bytes_sent / (float)stats.updates_sent) : 0.0f;
+        float saved = (stats.full_snapshot_bits > 0) ? (1.0f - ((float)stats.bits_sent / (float)stats.full_snapshot_bits)) : 0.0f;
+
+        double average_latency = (stats.updates_sent > 0) ? (stats.total_send_latency / (double)stats.updates_sent) : 0.0;
+
+        console_info("type %u: %u updates, %.0f bytes, %.1f bytes per update, %.0f%% less than whole snapshots",
+            it->first,
+            stats.updates_sent,
+            bytes_sent,
+            bytes_per_update,
+            saved * 100.0f);
+        console_info("    waited %.1f ms on average, %.1f ms at most, deferred %u times, %u starved",
+            average_latency * 1000.0,
+            stats.max_send_latency * 1000.0,
+            stats.deferred_count,
+            stats.starved_count);
+    }
+}
+
+COMMAND(net_object_set_rate, "[uint:bytes_per_second] Limits net object updates to each connection, 0 for no limit")
+{
+    if(args.is_at_end()){
+        console_info("Net object updates are limited to %u bytes per second per connection", g_bytes_per_second);
+        return;
+    }
+
+    g_bytes_per_second = args.next_uint_arg();
+
+    for(uint conn_index = 0; conn_index < MAX_NET_OBJECT_CONNECTIONS; ++conn_index){
+        if(nullptr != g_connections[conn_index]){
+            g_connections[conn_index]->bytes_per_second = g_bytes_per_second;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// net_object_delta_test
+//------------------------------------------------------------------------
+struct delta_test_snapshot_t
+{
+    f32 x;
+    f32 y;
+    f32 z;
+    f32 yaw;
+    u16 health;
+    u8 ammo;
+    bool is_firing;
+};
+
+static void* delta_test_create_snapshot()
+{
+    void* snapshot = malloc(sizeof(delta_test_snapshot_t));
+    memset(snapshot, 0, sizeof(delta_test_snapshot_t));
+    return snapshot;
+}
+
+static void delta_test_refresh_snapshot(void* snapshot, void* local_object)
+{
+    memcpy(snapshot, local_object, sizeof(delta_test_snapshot_t));
+}
+
+static void delta_test_append_snapshot(NetMessage* msg, void* snapshot)
+{
+    delta_test_snapshot_t* snap = (delta_test_snapshot_t*)snapshot;
+    msg->write(snap->x);
+    msg->write(snap->y);
+    msg->write(snap->z);
+    msg->write(snap->yaw);
+    msg->write(snap->health);
+    msg->write(snap->ammo);
+    msg->write(snap->is_firing);
+}
+
+static void delta_test_process_snapshot(NetMessage* msg, void* snapshot)
+{
+    delta_test_snapshot_t* snap = (delta_test_snapshot_t*)snapshot;
+    msg->read(snap->x);
+    msg->read(snap->y);
+    msg->read(snap->z);
+    msg->read(snap->yaw);
+    msg->read(snap->health);
+    msg->read(snap->ammo);
+    msg->read(snap->is_firing);
+}
+
+// keeps what's sent to it for the test to deliver
+class DeltaTestConnection : public NetConnection
+{
+    public:
+        std::vector<NetMessage*> m_sent;
+
+    public:
+        virtual void send(NetMessage* msg) override { m_sent.push_back(msg); }
+        virtual bool receive(NetMessage**) override { return false; }
+        virtual bool is_disconnected() const override { return false; }
+};
+
+// A host's objects and a client's copies of them, registered under the same ids.
+// Deleting it deletes the objects.
+class NetObjectTestWorld
+{
+    public:
+        NetObjectRegistry m_host;
+        NetObjectRegistry m_client;
+        std::vector<NetObject*> m_host_objects;
+        std::vector<NetObject*> m_client_objects;
+
+    public:
+        ~NetObjectTestWorld()
+        {
+            m_host.clear();
+            m_client.clear();
+            for(unsigned int i = 0; i < m_host_objects.size(); ++i){
+                delete m_host_objects[i];
+                delete m_client_objects[i];
+            }
+        }
+
+        void add(NetObjectTypeDefinition* defn, void* local_object)
+        {
+            NetObject* host_nop = new NetObject(defn);
+            host_nop->m_local_object = local_object;
+            m_host.add(host_nop);
+            m_host_objects.push_back(host_nop);
+
+            NetObject* client_nop = new NetObject(defn);
+            m_client.add_with_id(client_nop, host_nop->m_net_id);
+            m_client_objects.push_back(client_nop);
+        }
+};
+
+struct delta_test_result_t
+{
+    uint bytes_sent;
+    uint messages_sent;
+    uint mismatched_objects;
+};
+
+// Replicates slowly changing objects to one client over a lossy link, acks come
+// back a tick later. Ends with a few quiet, lossless ticks and checks the client
+// caught up.
+static delta_test_result_t run_delta_test(NetObjectTypeDefinition* defn, uint object_count, uint tick_count, float loss)
+{
+    const uint settle_ticks = 8;
+
+    std::vector<delta_test_snapshot_t> state(object_count);
+    NetObjectTestWorld* world = new NetObjectTestWorld();
+
+    for(uint i = 0; i < object_count; ++i){
+        delta_test_snapshot_t& obj = state[i];
+        obj.x = (GetRandomFloatZeroToOne() - 0.5f) * 1000.0f;
+        obj.y = 0.0f;
+        obj.z = (GetRandomFloatZeroToOne() - 0.5f) * 1000.0f;
+        obj.yaw = GetRandomFloatZeroToOne() * 360.0f;
+        obj.health = 100;
+        obj.ammo = 30;
+        obj.is_firing = false;
+
+        world->add(defn, &obj);
+    }
+
+    DeltaTestConnection conn;
+    conn.m_connection_index = 1;
+
+    // no budget, this is only about what each object costs
+    net_object_connection_t* conn_updates = new net_object_connection_t();
+    conn_updates->next_update_id = 0;
+    net_object_reset_connection(conn_updates, 0);
+
+    net_object_update_acks_t acks;
+    memset(&acks, 0, sizeof(acks));
+
+    delta_test_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    NetMessage ack(NETOBJECT_ACK);
+    bool has_ack = false;
+
+    for(uint tick = 0; tick < tick_count + settle_ticks; ++tick){
+        bool is_settling = (tick >= tick_count);
+        float tick_loss = is_settling ? 0.0f : loss;
+
+        // last tick's ack arrives
+        if(has_ack && (GetRandomFloatZeroToOne() >= tick_loss)){
+            ack.m_payload_bytes_read = 0;
+            net_object_process_update_ack(&ack, conn_updates, conn.m_connection_index, world->m_host);
+        }
+
+        if(!is_settling){
+            for(uint i = 0; i < object_count; ++i){
+                delta_test_snapshot_t& obj = state[i];
+
+                // most things stand still most of the time
+                if(GetRandomFloatZeroToOne() < 0.1f){
+                    obj.x += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+                    obj.z += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+                    obj.yaw += (GetRandomFloatZeroToOne() - 0.5f) * 10.0f;
+                    if(obj.yaw < 0.0f){
+                        obj.yaw += 360.0f;
+                    }else if(obj.yaw >= 360.0f){
+                        obj.yaw -= 360.0f;
+                    }
+                }
+                if(GetRandomFloatZeroToOne() < 0.01f){
+                    obj.health = (obj.health > 10) ? (u16)(obj.health - 10) : 100;
+                }
+                if(GetRandomFloatZeroToOne() < 0.02f){
+                    obj.is_firing = !obj.is_firing;
+                    obj.ammo = (obj.ammo > 0) ? (u8)(obj.ammo - 1) : 30;
+                }
+            }
+        }
+
+        net_object_refresh_snapshots(world->m_host);
+        net_object_send_updates_to(&conn, world->m_host, conn_updates, 0.0, 1.0 / DEFAULT_UPDATE_HZ);
+
+        for(unsigned int i = 0; i < conn.m_sent.size(); ++i){
+            NetMessage* msg = conn.m_sent[i];
+            result.bytes_sent += msg->get_full_size();
+            result.messages_sent++;
+
+            if(GetRandomFloatZeroToOne() >= tick_loss){
+                msg->m_payload_bytes_read = 0;
+                double host_time;
+                net_object_process_update(msg, world->m_client, &acks, &host_time);
+            }
+            delete msg;
+        }
+        conn.m_sent.clear();
+
+        ack.reset();
+        ack.m_message_type_id = NETOBJECT_ACK;
+        has_ack = net_object_write_update_ack(&ack, &acks);
+    }
+
+    for(uint i = 0; i < object_count; ++i){
+        NetObject* host_nop = world->m_host_objects[i];
+        NetObject* client_nop = world->m_client_objects[i];
+        bool matches = client_nop->m_snapshot_is_valid
+            && (0 == defn->get_changed_fields_mask(host_nop->m_current_snapshot, client_nop->m_last_received_snapshot));
+        if(!matches){
+            result.mismatched_objects++;
+        }
+    }
+    delete world;
+    delete conn_updates;
+
+    return result;
+}
+
+COMMAND(net_object_delta_test, "[uint:objects] [uint:ticks] [float:loss] Compares whole and delta snapshot bandwidth")
+{
+    uint object_count = 256;
+    uint tick_count = 200;
+    float loss = 0.1f;
+    if(!args.is_at_end()){
+        object_count = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        tick_count = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        loss = args.next_float_arg();
+    }
+    object_count = Min(object_count, (uint)MAX_NET_OBJECT_SLOTS);
+
+    NetObjectTypeDefinition whole;
+    whole.m_snapshot_size = sizeof(delta_test_snapshot_t);
+    whole.create_snapshot = delta_test_create_snapshot;
+    whole.refresh_current_snapshot = delta_test_refresh_snapshot;
+    whole.append_snapshot = delta_test_append_snapshot;
+    whole.process_snapshot = delta_test_process_snapshot;
+
+    NetObjectTypeDefinition delta = whole;
+    delta.add_quantized_float_field(offsetof(delta_test_snapshot_t, x), -1024.0f, 1024.0f, 18, 8);
+    delta.add_quantized_float_field(offsetof(delta_test_snapshot_t, y), -64.0f, 64.0f, 12, 4);
+    delta.add_quantized_float_field(offsetof(delta_test_snapshot_t, z), -1024.0f, 1024.0f, 18, 8);
+    delta.add_quantized_float_field(offsetof(delta_test_snapshot_t, yaw), 0.0f, 360.0f, 9, 4);
+    delta.add_uint_field(offsetof(delta_test_snapshot_t, health), sizeof(u16), 7);
+    delta.add_uint_field(offsetof(delta_test_snapshot_t, ammo), sizeof(u8), 6);
+    delta.add_bool_field(offsetof(delta_test_snapshot_t, is_firing));
+
+    delta_test_result_t whole_result = run_delta_test(&whole, object_count, tick_count, loss);
+    delta_test_result_t delta_result = run_delta_test(&delta, object_count, tick_count, loss);
+
+    console_info("%u objects, %u ticks, %.0f%% loss", object_count, tick_count, loss * 100.0f);
+    console_info("whole snapshots: %u bytes in %u messages, %u objects sent averaging %.1f bytes",
+        whole_result.bytes_sent,
+        whole_result.messages_sent,
+        whole.m_stats.updates_sent,
+        (float)whole.m_stats.bits_sent / (float)(BITS_PER_BYTE * Max(whole.m_stats.updates_sent, 1U)));
+    console_info("delta snapshots: %u bytes in %u messages, %u objects sent averaging %.1f bytes",
+        delta_result.bytes_sent,
+        delta_result.messages_sent,
+        delta.m_stats.updates_sent,
+        (float)delta.m_stats.bits_sent / (float)(BITS_PER_BYTE * Max(delta.m_stats.updates_sent, 1U)));
+    if(delta_result.bytes_sent > 0){
+        console_info("%.1fx smaller", (float)whole_result.bytes_sent / (float)delta_result.bytes_sent);
+    }
+
+    if((whole_result.mismatched_objects > 0) || (delta_result.mismatched_objects > 0)){
+        console_error("Client out of sync: %u whole, %u delta objects differ", whole_result.mismatched_objects, delta_result.mismatched_objects);
+    }else{
+        console_success("Client in sync after settling");
+    }
+}
+
+//------------------------------------------------------------------------
+// net_object_scheduler_test
+//------------------------------------------------------------------------
+#define SCHEDULER_TEST_WORLD_SIZE (1000.0f)
+
+// the one connection's player stands at the origin
+static f32 scheduler_test_get_relevance(void* local_object, NetConnection* conn)
+{
+    UNUSED(conn);
+    delta_test_snapshot_t* obj = (delta_test_snapshot_t*)local_object;
+    f32 distance = sqrtf((obj->x * obj->x) + (obj->z * obj->z));
+    return MapClampedFloatToRange(distance, 0.0f, SCHEDULER_TEST_WORLD_SIZE * 0.5f, 1.0f, 0.1f);
+}
+
+static void print_scheduler_test_stats(const char* name, const net_object_type_stats_t& stats)
+{
+    double average_latency = (stats.updates_sent > 0) ? (stats.total_send_latency / (double)stats.updates_sent) : 0.0;
+    console_info("%s: %u sent, waited %.0f ms on average and %.0f ms at most, deferred %u times, %u starved",
+        name,
+        stats.updates_sent,
+        average_latency * 1000.0,
+        stats.max_send_latency * 1000.0,
+        stats.deferred_count,
+        stats.starved_count);
+}
+
+// A crowd that's always changing, a few players and a lot of props, sent to one
+// client over a budget that can't keep up with all of it. Shows what goes out
+// each tick against the budget and how long each kind of object waits for it.
+COMMAND(net_object_scheduler_test, "[uint:objects] [uint:bytes_per_second] [uint:ticks] Runs the replication scheduler over a short budget")
+{
+    uint object_count = 2000;
+    uint bytes_per_second = 16 * 1024;
+    uint tick_count = 200;
+    if(!args.is_at_end()){
+        object_count = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        bytes_per_second = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        tick_count = args.next_uint_arg();
+    }
+    object_count = Min(object_count, (uint)MAX_NET_OBJECT_SLOTS);
+
+    const double tick_seconds = 1.0 / DEFAULT_UPDATE_HZ;
+    const uint player_every = 16;
+
+    NetObjectTypeDefinition prop;
+    prop.m_snapshot_size = sizeof(delta_test_snapshot_t);
+    prop.create_snapshot = delta_test_create_snapshot;
+    prop.refresh_current_snapshot = delta_test_refresh_snapshot;
+    prop.get_relevance = scheduler_test_get_relevance;
+    prop.add_quantized_float_field(offsetof(delta_test_snapshot_t, x), -1024.0f, 1024.0f, 18, 8);
+    prop.add_quantized_float_field(offsetof(delta_test_snapshot_t, z), -1024.0f, 1024.0f, 18, 8);
+    prop.add_quantized_float_field(offsetof(delta_test_snapshot_t, yaw), 0.0f, 360.0f, 9, 4);
+
+    NetObjectTypeDefinition player = prop;
+    player.m_priority = 4.0f;
+    player.add_uint_field(offsetof(delta_test_snapshot_t, health), sizeof(u16), 7);
+    player.add_bool_field(offsetof(delta_test_snapshot_t, is_firing));
+
+    std::vector<delta_test_snapshot_t> state(object_count);
+    NetObjectTestWorld* world = new NetObjectTestWorld();
+    for(uint i = 0; i < object_count; ++i){
+        delta_test_snapshot_t& obj = state[i];
+        memset(&obj, 0, sizeof(obj));
+        obj.x = (GetRandomFloatZeroToOne() - 0.5f) * SCHEDULER_TEST_WORLD_SIZE;
+        obj.z = (GetRandomFloatZeroToOne() - 0.5f) * SCHEDULER_TEST_WORLD_SIZE;
+        obj.health = 100;
+
+        world->add((0 == (i % player_every)) ? &player : &prop, &obj);
+    }
+
+    DeltaTestConnection conn;
+    conn.m_connection_index = 1;
+
+    net_object_connection_t* conn_updates = new net_object_connection_t();
+    conn_updates->next_update_id = 0;
+    net_object_reset_connection(conn_updates, bytes_per_second);
+
+    net_object_update_acks_t acks;
+    memset(&acks, 0, sizeof(acks));
+
+    NetMessage ack(NETOBJECT_ACK);
+    bool has_ack = false;
+
+    uint total_bytes = 0;
+    uint max_tick_bytes = 0;
+    uint ticks_over_budget = 0;
+    uint tick_budget = (uint)(bytes_per_second * tick_seconds);
+
+    for(uint tick = 0; tick < tick_count; ++tick){
+        double host_time = tick * tick_seconds;
+
+        if(has_ack){
+            ack.m_payload_bytes_read = 0;
+            net_object_process_update_ack(&ack, conn_updates, conn.m_connection_index, world->m_host);
+        }
+
+        // everything drifts, so everything always has something to send
+        for(uint i = 0; i < object_count; ++i){
+            delta_test_snapshot_t& obj = state[i];
+            obj.x += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+            obj.z += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+            obj.yaw = fmodf(obj.yaw + (GetRandomFloatZeroToOne() * 5.0f), 360.0f);
+            if(GetRandomFloatZeroToOne() < 0.05f){
+                obj.is_firing = !obj.is_firing;
+            }
+        }
+
+        net_object_refresh_snapshots(world->m_host);
+        net_object_send_updates_to(&conn, world->m_host, conn_updates, host_time, tick_seconds);
+
+        uint tick_bytes = 0;
+        for(unsigned int i = 0; i < conn.m_sent.size(); ++i){
+            NetMessage* msg = conn.m_sent[i];
+            tick_bytes += msg->get_full_size();
+            msg->m_payload_bytes_read = 0;
+            double update_host_time;
+            net_object_process_update(msg, world->m_client, &acks, &update_host_time);
+            delete msg;
+        }
+        conn.m_sent.clear();
+
+        total_bytes += tick_bytes;
+        max_tick_bytes = Max(max_tick_bytes, tick_bytes);
+        if(tick_bytes > tick_budget){
+            ticks_over_budget++;
+        }
+
+        ack.reset();
+        ack.m_message_type_id = NETOBJECT_ACK;
+        has_ack = net_object_write_update_ack(&ack, &acks);
+    }
+
+    uint never_sent = 0;
+    for(uint i = 0; i < object_count; ++i){
+        if(!world->m_client_objects[i]->m_snapshot_is_valid){
+            never_sent++;
+        }
+    }
+    delete world;
+    delete conn_updates;
+
+    console_info("%u objects, %u ticks at %u bytes per second (%u a tick)", object_count, tick_count, bytes_per_second, tick_budget);
+    console_info("sent %.0f bytes a tick on average, %u at most, %u ticks over budget",
+        (float)total_bytes / (float)Max(tick_count, 1U),
+        max_tick_bytes,
+        ticks_over_budget);
+    print_scheduler_test_stats("players", player.m_stats);
+    print_scheduler_test_stats("props", prop.m_stats);
+
+    if(never_sent > 0){
+        console_error("%u objects never reached the client", never_sent);
+    }else{
+        console_success("Every object reached the client");
+    }
+}
+
+
+//------------------------------------------------------------------------
+// net_object_registry_bench
+//------------------------------------------------------------------------
+// what one simulated client has received and owes the host an ack for
+struct registry_bench_connection_t
+{
+    DeltaTestConnection conn;
+    net_object_connection_t* conn_updates;
+    net_object_update_acks_t acks;
+};
+
+// Replicates a crowd to many connections the way the host tick does: refresh
+// every snapshot, schedule and write each connection's updates, then take acks
+// for all of them a tick later. A few objects are destroyed and replaced every
+// tick so slots get reused. Lookups by id are timed against a std::map of the
+// same objects for reference.
+COMMAND(net_object_registry_bench, "[uint:objects] [uint:connections] [uint:ticks] Times replicating a crowd to many connections")
+{
+    uint object_count = 10000;
+    uint connection_count = 32;
+    uint tick_count = 60;
+    if(!args.is_at_end()){
+        object_count = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        connection_count = args.next_uint_arg();
+    }
+    if(!args.is_at_end()){
+        tick_count = args.next_uint_arg();
+    }
+    object_count = Max(Min(object_count, (uint)MAX_NET_OBJECT_SLOTS - MIN_FREE_NET_OBJECT_SLOTS), 1U);
+    connection_count = Max(Min(connection_count, (uint)MAX_NET_OBJECT_CONNECTIONS - 1), 1U);
+
+    const uint churn_per_tick = Max(object_count / 500, 1U);
+    const double tick_seconds = 1.0 / DEFAULT_UPDATE_HZ;
+
+    NetObjectTypeDefinition defn;
+    defn.m_snapshot_size = sizeof(delta_test_snapshot_t);
+    defn.create_snapshot = delta_test_create_snapshot;
+    defn.refresh_current_snapshot = delta_test_refresh_snapshot;
+    defn.add_quantized_float_field(offsetof(delta_test_snapshot_t, x), -1024.0f, 1024.0f, 18, 8);
+    defn.add_quantized_float_field(offsetof(delta_test_snapshot_t, z), -1024.0f, 1024.0f, 18, 8);
+    defn.add_quantized_float_field(offsetof(delta_test_snapshot_t, yaw), 0.0f, 360.0f, 9, 4);
+    defn.add_uint_field(offsetof(delta_test_snapshot_t, health), sizeof(u16), 7);
+
+    // local objects, a replaced net object takes over its predecessor's
+    std::vector<delta_test_snapshot_t> state(object_count);
+    std::vector<NetObject*> objects(object_count);
+    NetObjectRegistry* registry = new NetObjectRegistry();
+    for(uint i = 0; i < object_count; ++i){
+        delta_test_snapshot_t& obj = state[i];
+        memset(&obj, 0, sizeof(obj));
+        obj.x = (GetRandomFloatZeroToOne() - 0.5f) * 1000.0f;
+        obj.z = (GetRandomFloatZeroToOne() - 0.5f) * 1000.0f;
+        obj.health = 100;
+
+        objects[i] = new NetObject(&defn);
+        objects[i]->m_local_object = &obj;
+        registry->add(objects[i]);
+    }
+
+    std::vector<registry_bench_connection_t*> connections(connection_count);
+    for(uint i = 0; i < connection_count; ++i){
+        registry_bench_connection_t* bench_conn = new registry_bench_connection_t();
+        bench_conn->conn.m_connection_index = (uint8_t)(i + 1);
+        bench_conn->conn_updates = new net_object_connection_t();
+        bench_conn->conn_updates->next_update_id = 0;
+        net_object_reset_connection(bench_conn->conn_updates, 0);
+        memset(&bench_conn->acks, 0, sizeof(bench_conn->acks));
+        connections[i] = bench_conn;
+    }
+
+    double refresh_seconds = 0.0;
+    double send_seconds = 0.0;
+    double ack_seconds = 0.0;
+    uint bytes_sent = 0;
+
+    NetMessage ack(NETOBJECT_ACK);
+    for(uint tick = 0; tick < tick_count; ++tick){
+        double host_time = tick * tick_seconds;
+
+        for(uint churn = 0; churn < churn_per_tick; ++churn){
+            uint i = (uint)GetRandomIntInRange(0, (int)object_count - 1);
+            registry->remove(objects[i]);
+            delete objects[i];
+
+            objects[i] = new NetObject(&defn);
+            objects[i]->m_local_object = &state[i];
+            registry->add(objects[i]);
+        }
+
+        for(uint i = 0; i < object_count; ++i){
+            delta_test_snapshot_t& obj = state[i];
+            if(GetRandomFloatZeroToOne() < 0.25f){
+                obj.x += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+                obj.z += (GetRandomFloatZeroToOne() - 0.5f) * 2.0f;
+                obj.yaw = fmodf(obj.yaw + (GetRandomFloatZeroToOne() * 5.0f), 360.0f);
+            }
+        }
+
+        double start = get_current_time_seconds();
+        net_object_refresh_snapshots(*registry);
+        double refreshed = get_current_time_seconds();
+
+        for(uint i = 0; i < connection_count; ++i){
+            registry_bench_connection_t* bench_conn = connections[i];
+            u16 first_update_id = bench_conn->conn_updates->next_update_id;
+            net_object_send_updates_to(&bench_conn->conn, *registry, bench_conn->conn_updates, host_time, tick_seconds);
+
+            // every update gets through, the client's side isn't what's timed
+            for(u16 update_id = first_update_id; update_id != bench_conn->conn_updates->next_update_id; ++update_id){
+                net_object_mark_update_received(&bench_conn->acks, update_id);
+            }
+            for(unsigned int msg_idx = 0; msg_idx < bench_conn->conn.m_sent.size(); ++msg_idx){
+                bytes_sent += bench_conn->conn.m_sent[msg_idx]->get_full_size();
+                delete bench_conn->conn.m_sent[msg_idx];
+            }
+            bench_conn->conn.m_sent.clear();
+        }
+        double sent = get_current_time_seconds();
+
+        for(uint i = 0; i < connection_count; ++i){
+            registry_bench_connection_t* bench_conn = connections[i];
+            ack.reset();
+            ack.m_message_type_id = NETOBJECT_ACK;
+            if(net_object_write_update_ack(&ack, &bench_conn->acks)){
+                net_object_process_update_ack(&ack, bench_conn->conn_updates, bench_conn->conn.m_connection_index, *registry);
+            }
+        }
+        double acked = get_current_time_seconds();
+
+        refresh_seconds += refreshed - start;
+        send_seconds += sent - refreshed;
+        ack_seconds += acked - sent;
+    }
+    // lookups by id, the registry against what it replaced
+    std::map<net_object_id_t, NetObject*> object_map;
+    std::vector<net_object_id_t> lookup_ids(object_count);
+    for(uint i = 0; i < object_count; ++i){
+        object_map[objects[i]->m_net_id] = objects[i];
+        lookup_ids[i] = objects[i]->m_net_id;
+    }
+    for(uint i = object_count - 1; i > 0; --i){
+        std::swap(lookup_ids[i], lookup_ids[GetRandomIntInRange(0, (int)i)]);
+    }
+
+    const uint lookup_passes = 20;
+    uint found_count = 0;
+    double start = get_current_time_seconds();
+    for(uint pass = 0; pass < lookup_passes; ++pass){
+        for(uint i = 0; i < object_count; ++i){
+            found_count += (nullptr != registry->find(lookup_ids[i])) ? 1 : 0;
+        }
+    }
+    double registry_lookup_seconds = get_current_time_seconds() - start;
+
+    start = get_current_time_seconds();
+    for(uint pass = 0; pass < lookup_passes; ++pass){
+        for(uint i = 0; i < object_count; ++i){
+            found_count += (object_map.end() != object_map.find(lookup_ids[i])) ? 1 : 0;
+        }
+    }
+    double map_lookup_seconds = get_current_time_seconds() - start;
+
+    uint snapshot_chunks = defn.m_snapshots.get_chunk_count();
+    uint live_snapshots = defn.m_snapshots.get_live_count();
+    uint slot_count = registry->get_slot_count();
+
+    registry->clear();
+    for(uint i = 0; i < object_count; ++i){
+        delete objects[i];
+    }
+    delete registry;
+    for(uint i = 0; i < connection_count; ++i){
+        delete connections[i]->conn_updates;
+        delete connections[i];
+    }
+
+    double object_ticks = (double)object_count * (double)tick_count;
+    double lookups = (double)object_count * (double)lookup_passes;
+    console_info("%u objects to %u connections for %u ticks, %u replaced a tick", object_count, connection_count, tick_count, churn_per_tick);
+    console_info("refresh %.3f ms, send %.3f ms, acks %.3f ms a tick",
+        refresh_seconds * 1000.0 / tick_count,
+        send_seconds * 1000.0 / tick_count,
+        ack_seconds * 1000.0 / tick_count);
+    console_info("%.1f ns per object per connection, %u entries in %u bytes",
+        (send_seconds + ack_seconds) * 1e9 / (object_ticks * connection_count),
+        defn.m_stats.updates_sent,
+        bytes_sent);
+    console_info("%u slots, %u snapshots in %u chunks of %u", slot_count, live_snapshots, snapshot_chunks, NET_SNAPSHOTS_PER_CHUNK);
+    console_info("lookup by id: registry %.1f ns, std::map %.1f ns (%u found)",
+        registry_lookup_seconds * 1e9 / lookups,
+        map_lookup_seconds * 1e9 / lookups,
+        found_count);
+}
+
+
+//------------------------------------------------------------------------
+// net_object_interp_test
+//------------------------------------------------------------------------
+#define INTERP_TEST_FRAME_SECONDS (1.0 / 240.0)
+#define INTERP_TEST_SECONDS (20.0)
+
+// the client's clock is this far off the host's to begin with
+#define INTERP_TEST_CLOCK_SKEW (1234.5)
+
+#define INTERP_TEST_RADIUS (50.0f)
+#define INTERP_TEST_SPEED (10.0f)
+
+// where the object is at a host time, going round a circle
+static void interp_test_get_position(double host_time, f32* out_x, f32* out_z)
+{
+    f32 angle = (f32)fmod(host_time * (INTERP_TEST_SPEED / INTERP_TEST_RADIUS), 2.0 * 3.14159265);
+    *out_x = INTERP_TEST_RADIUS * cosf(angle);
+    *out_z = INTERP_TEST_RADIUS * sinf(angle);
+}
+
+static void interp_test_send(NetLinkSim* link, NetMessage* msg, double now)
+{
+    byte buffer[PACKET_MTU];
+    msg->write_to(buffer);
+    link->send(net_address_t(), buffer, msg->get_full_size(), now);
+}
+
+// the datagram's message read in place, it holds one and nothing else
+static void interp_test_read(net_link_datagram_t* datagram, NetMessage* msg)
+{
+    msg->m_message_type_id = datagram->data[sizeof(u16)];
+    msg->set_view(datagram->data + sizeof(u16) + sizeof(u8), datagram->size - sizeof(u16) - sizeof(u8));
+}
+
+struct interp_test_motion_t
+{
+    bool has_previous;
+    f32 x;
+    f32 z;
+    f32 step_x;
+    f32 step_z;
+
+    // how much the step from one frame to the next changes, ideally hardly at all
+    double total_jerk;
+    uint frames;
+};
+
+static void interp_test_track(interp_test_motion_t* motion, f32 x, f32 z)
+{
+    if(motion->has_previous){
+        f32 step_x = x - motion->x;
+        f32 step_z = z - motion->z;
+        f32 dx = step_x - motion->step_x;
+        f32 dz = step_z - motion->step_z;
+        motion->total_jerk += sqrtf((dx * dx) + (dz * dz));
+        motion->frames++;
+        motion->step_x = step_x;
+        motion->step_z = step_z;
+    }
+    motion->has_previous = true;
+    motion->x = x;
+    motion->z = z;
+}
+
+// One object going round a circle, replicated over a simulated link to a client
+// whose clock is well off the host's. Draws it every frame the way the client
+// would now (interpolated at the render time) and the way it used to (the
+// newest snapshot), and reports how far off and how jerky each is.
+COMMAND(net_object_interp_test, "[float:update_hz] [float:latency_ms] [float:jitter_ms] [float:loss] Compares interpolated and latest snapshot replication")
+{
+    float update_hz = args.is_at_end() ? (float)DEFAULT_UPDATE_HZ : args.next_float_arg();
+    net_link_conditions_t conditions;
+    memset(&conditions, 0, sizeof(conditions));
+    conditions.latency_ms = args.is_at_end() ? 50.0f : args.next_float_arg();
+    conditions.jitter_ms = args.is_at_end() ? 10.0f : args.next_float_arg();
+    conditions.loss = args.is_at_end() ? 0.02f : args.next_float_arg();
+    conditions.max_queued_bytes = NET_LINK_DEFAULT_QUEUE_BYTES;
+
+    update_hz = Clamp(update_hz, 1.0f, 120.0f);
+    const double update_seconds = 1.0 / update_hz;
+
+    NetObjectTypeDefinition defn;
+    defn.m_snapshot_size = sizeof(delta_test_snapshot_t);
+    defn.create_snapshot = delta_test_create_snapshot;
+    defn.refresh_current_snapshot = delta_test_refresh_snapshot;
+    defn.add_quantized_float_field(offsetof(delta_test_snapshot_t, x), -64.0f, 64.0f, 20, 8);
+    defn.add_quantized_float_field(offsetof(delta_test_snapshot_t, z), -64.0f, 64.0f, 20, 8);
+
+    delta_test_snapshot_t state;
+    memset(&state, 0, sizeof(state));
+    NetObjectTestWorld* world = new NetObjectTestWorld();
+    world->add(&defn, &state);
+    NetObject* client_nop = world->m_client_objects[0];
+
+    DeltaTestConnection conn;
+    conn.m_connection_index = 1;
+    net_object_connection_t* conn_updates = new net_object_connection_t();
+    conn_updates->next_update_id = 0;
+    net_object_reset_connection(conn_updates, 0);
+
+    NetLinkSim to_client;
+    NetLinkSim to_host;
+    to_client.m_conditions = conditions;
+    to_host.m_conditions = conditions;
+
+    net_object_update_acks_t acks;
+    memset(&acks, 0, sizeof(acks));
+    net_object_clock_t clock;
+    net_object_arrival_t arrival;
+    net_object_arrival_reset(&arrival);
+
+    // as if the set clock message took the one way latency to get there
+    net_object_clock_reset(&clock, 0.0, INTERP_TEST_CLOCK_SKEW + (conditions.latency_ms / 1000.0));
+
+    interp_test_motion_t interpolated_motion;
+    interp_test_motion_t latest_motion;
+    memset(&interpolated_motion, 0, sizeof(interpolated_motion));
+    memset(&latest_motion, 0, sizeof(latest_motion));
+    double interpolated_error = 0.0;
+    f32 max_interpolated_error = 0.0f;
+    double latest_error = 0.0;
+    double clock_error = 0.0;
+    double total_delay = 0.0;
+    uint measured_frames = 0;
+    uint starved_frames = 0;
+
+    double next_update_time = 0.0;
+    const uint frame_count = (uint)(INTERP_TEST_SECONDS / INTERP_TEST_FRAME_SECONDS);
+    for(uint frame = 0; frame < frame_count; ++frame){
+        // the host's clock is the real one
+        double now = frame * INTERP_TEST_FRAME_SECONDS;
+        double client_now = now + INTERP_TEST_CLOCK_SKEW;
+
+        net_link_datagram_t* datagram;
+        while(nullptr != (datagram = to_host.receive(now))){
+            NetMessage msg;
+            interp_test_read(datagram, &msg);
+            if(NETMSG_PING == msg.m_message_type_id){
+                double send_time;
+                msg.read(send_time);
+                NetMessage pong(NETMSG_PONG);
+                pong.write(send_time);
+                pong.write(now);
+                interp_test_send(&to_client, &pong, now);
+            }else if(NETOBJECT_ACK == msg.m_message_type_id){
+                net_object_process_update_ack(&msg, conn_updates, conn.m_connection_index, world->m_host);
+            }
+            to_host.release(datagram);
+        }
+
+        if(now >= next_update_time){
+            next_update_time += update_seconds;
+            interp_test_get_position(now, &state.x, &state.z);
+            net_object_refresh_snapshots(world->m_host);
+            net_object_send_updates_to(&conn, world->m_host, conn_updates, now, update_seconds);
+            for(NetMessage* msg : conn.m_sent){
+                interp_test_send(&to_client, msg, now);
+                delete msg;
+            }
+            conn.m_sent.clear();
+        }
+
+        while(nullptr != (datagram = to_client.receive(now))){
+            NetMessage msg;
+            interp_test_read(datagram, &msg);
+            if(NETMSG_PONG == msg.m_message_type_id){
+                double send_time;
+                double host_time;
+                msg.read(send_time);
+                msg.read(host_time);
+                net_object_clock_add_sample(&clock, send_time, host_time, client_now);
+            }else if(NETOBJECT_UPDATE == msg.m_message_type_id){
+                double host_time;
+                if(net_object_process_update(&msg, world->m_client, &acks, &host_time)){
+                    net_object_arrival_add_update(&arrival, host_time, net_object_clock_get_host_time(&clock, client_now));
+                }
+            }
+            to_client.release(datagram);
+        }
+
+        net_object_clock_update(&clock, client_now);
+        if(client_now >= clock.next_ping_time){
+            NetMessage ping(NETMSG_PING);
+            ping.write(client_now);
+            interp_test_send(&to_host, &ping, now);
+            clock.next_ping_time = client_now + NET_CLOCK_PING_SECONDS;
+        }
+
+        NetMessage ack(NETOBJECT_ACK);
+        if(net_object_write_update_ack(&ack, &acks)){
+            interp_test_send(&to_host, &ack, now);
+        }
+
+        // the first couple of seconds are the clock settling
+        if(!client_nop->m_snapshot_is_valid || (now < 2.0)){
+            continue;
+        }
+
+        f32 delay = net_object_arrival_get_render_delay(&arrival);
+        double render_time = net_object_clock_get_host_time(&clock, client_now) - delay;
+        double seconds_past;
+        const delta_test_snapshot_t* interpolated = (const delta_test_snapshot_t*)client_nop->sample_received_snapshots(
+            render_time, arrival.newest_host_time, update_seconds * NET_OBJECT_MAX_EXTRAPOLATION_PERIODS, &seconds_past);
+        const delta_test_snapshot_t* latest = (const delta_test_snapshot_t*)client_nop->m_last_received_snapshot;
+
+        // each is judged against where the object was at the time it's showing,
+        // the newest snapshot is showing now
+        f32 x;
+        f32 z;
+        interp_test_get_position(render_time, &x, &z);
+        f32 error = sqrtf(((interpolated->x - x) * (interpolated->x - x)) + ((interpolated->z - z) * (interpolated->z - z)));
+        interpolated_error += error;
+        max_interpolated_error = Max(max_interpolated_error, error);
+
+        interp_test_get_position(now, &x, &z);
+        latest_error += sqrtf(((latest->x - x) * (latest->x - x)) + ((latest->z - z) * (latest->z - z)));
+
+        interp_test_track(&interpolated_motion, interpolated->x, interpolated->z);
+        interp_test_track(&latest_motion, latest->x, latest->z);
+
+        clock_error += fabs((client_now + clock.offset) - now);
+        total_delay += delay;
+        measured_frames++;
+        if(render_time > arrival.newest_host_time){
+            starved_frames++;
+        }
+    }
+
+    delete world;
+    delete conn_updates;
+
+    if(0 == measured_frames){
+        console_error("Nothing arrived to draw");
+        return;
+    }
+
+    console_info("%.0f hz updates, %.0f ms latency, %.0f ms jitter, %.0f%% loss",
+        update_hz,
+        conditions.latency_ms,
+        conditions.jitter_ms,
+        conditions.loss * 100.0f);
+    console_info("clock: off by %.2f ms on average, best round trip %.1f ms",
+        clock_error * 1000.0 / measured_frames,
+        clock.rtt * 1000.0);
+    console_info("render delay %.1f ms, ran past the newest update %.1f%% of frames",
+        total_delay * 1000.0 / measured_frames,
+        100.0f * (float)starved_frames / (float)measured_frames);
+    console_info("interpolated: off by %.3f on average, %.3f at most, %.4f jerk per frame",
+        interpolated_error / measured_frames,
+        max_interpolated_error,
+        interpolated_motion.total_jerk / Max(interpolated_motion.frames, 1U));
+    console_info("latest snapshot: off by %.3f on average, %.4f jerk per frame",
+        latest_error / measured_frames,
+        latest_motion.total_jerk / Max(latest_motion.frames, 1U));
+}
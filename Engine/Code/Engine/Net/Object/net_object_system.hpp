@@ -20,15 +20,21 @@ NetSession* net_object_get_session();
 void net_object_system_register_type(uint8_t object_type, NetObjectTypeDefinition* defn);
 NetObjectTypeDefinition* net_object_find_definition(uint8_t object_type);
 
-void net_object_register(NetObject* nop);
+// Picks an id unless the object already has one (one the host picked). False
+// when out of ids, or that id is taken.
+bool net_object_register(NetObject* nop);
 void net_object_unregister(NetObject* nop);
 NetObject* net_object_find(net_object_id_t net_id);
 
-net_object_id_t net_object_get_unused_id();
 NetObject* net_object_replicate(void* object_ptr, uint8_t type_id);
 void net_object_stop_replication(net_object_id_t net_id);
 
 void net_object_system_init_connection(uint8_t new_connection);
 
 double net_object_system_get_tick_freq();
-unsigned int net_object_system_get_num_objects();
\ No newline at end of file
+unsigned int net_object_system_get_num_objects();
+
+// Client side. The host's clock as best we know it, and the host time objects
+// are being drawn at, far enough back to have updates either side of it.
+double net_object_system_get_host_time();
+double net_object_system_get_render_time();
\ No newline at end of file
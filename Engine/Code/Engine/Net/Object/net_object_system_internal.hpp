@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Engine/Net/Object/net_object.hpp"
+#include "Engine/Core/types.h"
+#include <vector>
+
+class NetConnection;
+class NetMessage;
+class NetObjectRegistry;
+
+// The host and client halves of net object replication without the system's
+// globals, so tests can run both ends, or many of them, in one process.
+
+// clients draw between updates, so this can be low
+#define DEFAULT_UPDATE_HZ 10
+
+// updates a connection can have out before the oldest is forgotten about
+#define MAX_TRACKED_UPDATES 64
+
+// what each connection gets for net object updates, 0 for no limit
+#define DEFAULT_NET_OBJECT_BYTES_PER_SECOND (32 * 1024)
+
+// which objects went out in an update, so its ack can find them
+struct net_object_update_record_t
+{
+    bool is_valid;
+    u16 update_id;
+    std::vector<net_object_id_t> net_ids;
+};
+
+// host side, one per connection
+struct net_object_connection_t
+{
+    u16 next_update_id;
+    net_object_update_record_t updates[MAX_TRACKED_UPDATES];
+
+    // refilled every tick, goes negative when a tick overshoots and the next
+    // one makes up for it
+    uint bytes_per_second;
+    f32 budget_bytes;
+};
+
+// client side, updates are acked like packets: the newest one and a bit for each
+// of the 32 before it
+struct net_object_update_acks_t
+{
+    bool has_received;
+    bool needs_ack;
+    u16 newest_update_id;
+    u32 previous_bitfield;
+};
+
+// host
+void net_object_reset_connection(net_object_connection_t* conn_updates, uint bytes_per_second);
+void net_object_refresh_snapshots(NetObjectRegistry& registry);
+void net_object_send_updates_to(NetConnection* conn, NetObjectRegistry& registry, net_object_connection_t* conn_updates, double host_time, double tick_seconds);
+void net_object_process_update_ack(NetMessage* msg, net_object_connection_t* conn_updates, uint8_t conn_index, NetObjectRegistry& registry);
+
+// client
+bool net_object_process_update(NetMessage* msg, NetObjectRegistry& registry, net_object_update_acks_t* acks, double* out_host_time);
+bool net_object_write_update_ack(NetMessage* msg, net_object_update_acks_t* acks);
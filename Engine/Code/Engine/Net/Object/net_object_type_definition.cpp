@@ -1,6 +1,13 @@
 #include "Engine/Net/Object/net_object_type_definition.hpp"
 #include "Engine/Net/Object/net_object.hpp"
 #include "Engine/Net/message.hpp"
+#include "Engine/Core/bit_packer.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Memory/chunk_allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 void noop_append_create_info(NetMessage* m, void* o)
 {
@@ -57,9 +64,92 @@ void noop_apply_snapshot(void* s, void* l, double ds)
     UNUSED(ds);
 }
 
+f32 noop_get_relevance(void* l, NetConnection* c)
+{
+    UNUSED(l);
+    UNUSED(c);
+    return 1.0f;
+}
+
+NetSnapshotStorage::NetSnapshotStorage()
+    :m_allocator(nullptr)
+    ,m_default_snapshot(nullptr)
+    ,m_snapshot_size(0)
+{
+}
+
+NetSnapshotStorage::NetSnapshotStorage(const NetSnapshotStorage& other)
+    :m_allocator(nullptr)
+    ,m_default_snapshot(nullptr)
+    ,m_snapshot_size(0)
+{
+    UNUSED(other);
+}
+
+NetSnapshotStorage& NetSnapshotStorage::operator=(const NetSnapshotStorage& other)
+{
+    UNUSED(other);
+    return *this;
+}
+
+NetSnapshotStorage::~NetSnapshotStorage()
+{
+    release();
+}
+
+void NetSnapshotStorage::release()
+{
+    ASSERT_OR_DIE((nullptr == m_allocator) || (0 == m_allocator->live_count), "Net object snapshots outlived their type");
+
+    SAFE_DELETE(m_allocator);
+    ::free(m_default_snapshot);
+    m_default_snapshot = nullptr;
+    m_snapshot_size = 0;
+}
+
+void* NetSnapshotStorage::alloc(size_t snapshot_size, create_snapshot_cb create_snapshot)
+{
+    if(nullptr == m_allocator){
+        m_snapshot_size = snapshot_size;
+        m_allocator = new ChunkAllocator(Max(snapshot_size, (size_t)1), NET_SNAPSHOTS_PER_CHUNK);
+        m_default_snapshot = create_snapshot();
+    }
+    ASSERT_OR_DIE(snapshot_size == m_snapshot_size, "Net object snapshot size changed after snapshots were made");
+
+    void* snapshot = m_allocator->alloc(snapshot_size);
+    if(nullptr != m_default_snapshot){
+        memcpy(snapshot, m_default_snapshot, snapshot_size);
+    }else{
+        memset(snapshot, 0, snapshot_size);
+    }
+    return snapshot;
+}
+
+void NetSnapshotStorage::free(void* snapshot)
+{
+    if(nullptr != snapshot){
+        m_allocator->free(snapshot);
+    }
+}
+
+uint NetSnapshotStorage::get_live_count() const
+{
+    return (nullptr != m_allocator) ? m_allocator->live_count : 0;
+}
+
+uint NetSnapshotStorage::get_chunk_count() const
+{
+    return (nullptr != m_allocator) ? m_allocator->chunk_count : 0;
+}
+
 NetObjectTypeDefinition::NetObjectTypeDefinition()
     :m_snapshot_size(0)
+    ,m_priority(1.0f)
+    ,m_field_count(0)
 {
+    memset(m_fields, 0, sizeof(m_fields));
+    memset(&m_stats, 0, sizeof(m_stats));
+
     append_create_info = noop_append_create_info;
     process_create_info = noop_process_create_info;
 
@@ -71,4 +161,349 @@ NetObjectTypeDefinition::NetObjectTypeDefinition()
     append_snapshot = noop_append_snapshot;
     process_snapshot = noop_process_snapshot;
     apply_snapshot = noop_apply_snapshot;
+    interpolate_snapshot = nullptr;
+    get_relevance = noop_get_relevance;
+}
+
+void* NetObjectTypeDefinition::alloc_snapshot()
+{
+    return m_snapshots.alloc(m_snapshot_size, create_snapshot);
+}
+
+void NetObjectTypeDefinition::free_snapshot(void* snapshot)
+{
+    m_snapshots.free(snapshot);
+}
+
+static u32 get_low_bits_mask(uint bit_count)
+{
+    return (bit_count >= 32) ? 0xFFFFFFFF : ((1U << bit_count) - 1);
+}
+
+static i64 load_int(const byte* src, size_t size)
+{
+    switch(size){
+        case 1: { i8 v; memcpy(&v, src, sizeof(v)); return v; }
+        case 2: { i16 v; memcpy(&v, src, sizeof(v)); return v; }
+        case 4: { i32 v; memcpy(&v, src, sizeof(v)); return v; }
+        default: { i64 v; memcpy(&v, src, sizeof(v)); return v; }
+    }
+}
+
+static void store_int(byte* dest, size_t size, i64 value)
+{
+    switch(size){
+        case 1: { i8 v = (i8)value; memcpy(dest, &v, sizeof(v)); break; }
+        case 2: { i16 v = (i16)value; memcpy(dest, &v, sizeof(v)); break; }
+        case 4: { i32 v = (i32)value; memcpy(dest, &v, sizeof(v)); break; }
+        default: { memcpy(dest, &value, sizeof(value)); break; }
+    }
+}
+
+// the bits that go on the wire for everything but byte fields
+static u32 encode_field(const net_field_t& field, const void* snapshot)
+{
+    const byte* src = (const byte*)snapshot + field.offset;
+
+    switch(field.type){
+        case NET_FIELD_BOOL:
+            return (*src != 0) ? 1 : 0;
+
+        case NET_FIELD_INT:
+        case NET_FIELD_UINT:
+            return (u32)load_int(src, field.size) & get_low_bits_mask(field.bit_count);
+
+        case NET_FIELD_FLOAT: {
+            u32 bits;
+            memcpy(&bits, src, sizeof(bits));
+            return bits;
+        }
+
+        case NET_FIELD_QUANTIZED_FLOAT: {
+            f32 value;
+            memcpy(&value, src, sizeof(value));
+            f32 normalized = MapClampedFloatToRange(value, field.min, field.max, 0.0f, 1.0f);
+            return (u32)(normalized * (f32)get_low_bits_mask(field.bit_count) + 0.5f);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void decode_field(const net_field_t& field, u32 code, void* out_snapshot)
+{
+    byte* dest = (byte*)out_snapshot + field.offset;
+
+    switch(field.type){
+        case NET_FIELD_BOOL:
+            *dest = (code != 0) ? 1 : 0;
+            break;
+
+        case NET_FIELD_INT: {
+            // sign extend from the top bit that was sent
+            i64 value = code;
+            if((field.bit_count < 32) && ((code >> (field.bit_count - 1)) & 1)){
+                value -= ((i64)1 << field.bit_count);
+            }else if(field.bit_count >= 32){
+                value = (i32)code;
+            }
+            store_int(dest, field.size, value);
+            break;
+        }
+
+        case NET_FIELD_UINT:
+            store_int(dest, field.size, (i64)code);
+            break;
+
+        case NET_FIELD_FLOAT:
+            memcpy(dest, &code, sizeof(code));
+            break;
+
+        case NET_FIELD_QUANTIZED_FLOAT: {
+            f32 value = MapFloatToRange((f32)code, 0.0f, (f32)get_low_bits_mask(field.bit_count), field.min, field.max);
+            memcpy(dest, &value, sizeof(value));
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static bool is_delta_field(const net_field_t& field)
+{
+    return (field.delta_bit_count > 0) && (NET_FIELD_BYTES != field.type) && (NET_FIELD_FLOAT != field.type);
+}
+
+// signed distance from baseline_code to code, wrapping in bit_count bits, zigzagged
+// so small steps either way are small numbers
+static u32 encode_delta(u32 code, u32 baseline_code, uint bit_count)
+{
+    u32 mask = get_low_bits_mask(bit_count);
+    i64 diff = (i64)((code - baseline_code) & mask);
+    if(diff & ((i64)1 << (bit_count - 1))){
+        diff -= ((i64)1 << bit_count);
+    }
+
+    i64 zigzag = (i64)((u64)diff << 1) ^ (diff >> 63);
+    return (zigzag > (i64)0xFFFFFFFF) ? 0xFFFFFFFF : (u32)zigzag;
+}
+
+static u32 decode_delta(u32 delta, u32 baseline_code, uint bit_count)
+{
+    i64 diff = (i64)(delta >> 1) ^ -(i64)(delta & 1);
+    return (u32)(baseline_code + diff) & get_low_bits_mask(bit_count);
+}
+
+void NetObjectTypeDefinition::add_bool_field(size_t offset)
+{
+    add_field(NET_FIELD_BOOL, offset, sizeof(bool), 1, 0, 0.0f, 0.0f);
+}
+
+void NetObjectTypeDefinition::add_int_field(size_t offset, size_t size, uint bit_count, uint delta_bit_count)
+{
+    add_field(NET_FIELD_INT, offset, size, bit_count, delta_bit_count, 0.0f, 0.0f);
+}
+
+void NetObjectTypeDefinition::add_uint_field(size_t offset, size_t size, uint bit_count, uint delta_bit_count)
+{
+    add_field(NET_FIELD_UINT, offset, size, bit_count, delta_bit_count, 0.0f, 0.0f);
+}
+
+void NetObjectTypeDefinition::add_float_field(size_t offset)
+{
+    add_field(NET_FIELD_FLOAT, offset, sizeof(f32), 32, 0, 0.0f, 0.0f);
+}
+
+void NetObjectTypeDefinition::add_quantized_float_field(size_t offset, f32 min, f32 max, uint bit_count, uint delta_bit_count)
+{
+    ASSERT_OR_DIE(max > min, "Quantized float field needs max > min");
+    add_field(NET_FIELD_QUANTIZED_FLOAT, offset, sizeof(f32), bit_count, delta_bit_count, min, max);
+}
+
+void NetObjectTypeDefinition::add_bytes_field(size_t offset, size_t size)
+{
+    add_field(NET_FIELD_BYTES, offset, size, (uint)(size * BITS_PER_BYTE), 0, 0.0f, 0.0f);
+}
+
+void NetObjectTypeDefinition::add_field(NetFieldType type, size_t offset, size_t size, uint bit_count, uint delta_bit_count, f32 min, f32 max)
+{
+    ASSERT_OR_DIE(m_field_count < MAX_NET_OBJECT_FIELDS, "Too many fields on net object type");
+    ASSERT_OR_DIE(offset + size <= m_snapshot_size, "Field is outside of the snapshot, set m_snapshot_size first");
+    ASSERT_OR_DIE((bit_count > 0) && ((NET_FIELD_BYTES == type) || (bit_count <= 32)), "Bad bit count for field");
+    ASSERT_OR_DIE((NET_FIELD_BYTES == type) || (size <= sizeof(i64)), "Bad size for field");
+    ASSERT_OR_DIE(delta_bit_count < bit_count, "A delta has to be smaller than the field");
+
+    net_field_t& field = m_fields[m_field_count];
+    field.type = type;
+    field.offset = offset;
+    field.size = size;
+    field.bit_count = bit_count;
+    field.delta_bit_count = delta_bit_count;
+    field.min = min;
+    field.max = max;
+
+    ++m_field_count;
+}
+
+bool NetObjectTypeDefinition::has_fields() const
+{
+    return m_field_count > 0;
+}
+
+u32 NetObjectTypeDefinition::get_all_fields_mask() const
+{
+    return get_low_bits_mask(has_fields() ? m_field_count : 1);
+}
+
+u32 NetObjectTypeDefinition::get_changed_fields_mask(const void* snapshot, const void* baseline) const
+{
+    // without fields it's all or nothing
+    if(!has_fields()){
+        return (memcmp(snapshot, baseline, m_snapshot_size) != 0) ? 1 : 0;
+    }
+
+    u32 mask = 0;
+    for(uint field_idx = 0; field_idx < m_field_count; ++field_idx){
+        const net_field_t& field = m_fields[field_idx];
+
+        bool changed;
+        if(NET_FIELD_BYTES == field.type){
+            changed = (memcmp((const byte*)snapshot + field.offset, (const byte*)baseline + field.offset, field.size) != 0);
+        }else{
+            changed = (encode_field(field, snapshot) != encode_field(field, baseline));
+        }
+
+        if(changed){
+            mask |= (1U << field_idx);
+        }
+    }
+    return mask;
+}
+
+void NetObjectTypeDefinition::write_fields(BitPacker* packer, const void* snapshot, const void* baseline, u32 field_mask) const
+{
+    packer->write<u32>(field_mask, m_field_count);
+
+    for(uint field_idx = 0; field_idx < m_field_count; ++field_idx){
+        if(0 == (field_mask & (1U << field_idx))){
+            continue;
+        }
+
+        const net_field_t& field = m_fields[field_idx];
+        if(NET_FIELD_BYTES == field.type){
+            packer->write_bits((byte*)snapshot + field.offset, field.bit_count);
+            continue;
+        }
+
+        u32 code = encode_field(field, snapshot);
+        if((nullptr != baseline) && is_delta_field(field)){
+            u32 delta = encode_delta(code, encode_field(field, baseline), field.bit_count);
+            bool fits = (delta <= get_low_bits_mask(field.delta_bit_count));
+            packer->write_bit(fits);
+            if(fits){
+                packer->write<u32>(delta, field.delta_bit_count);
+                continue;
+            }
+        }
+        packer->write<u32>(code, field.bit_count);
+    }
+}
+
+uint NetObjectTypeDefinition::get_written_bit_count(const void* snapshot, const void* baseline, u32 field_mask) const
+{
+    uint bit_count = m_field_count;
+
+    for(uint field_idx = 0; field_idx < m_field_count; ++field_idx){
+        if(0 == (field_mask & (1U << field_idx))){
+            continue;
+        }
+
+        const net_field_t& field = m_fields[field_idx];
+        if((nullptr != baseline) && is_delta_field(field)){
+            u32 delta = encode_delta(encode_field(field, snapshot), encode_field(field, baseline), field.bit_count);
+            bool fits = (delta <= get_low_bits_mask(field.delta_bit_count));
+            bit_count += 1 + (fits ? field.delta_bit_count : field.bit_count);
+        }else{
+            bit_count += field.bit_count;
+        }
+    }
+
+    return bit_count;
+}
+
+bool NetObjectTypeDefinition::read_fields(BitPacker* packer, void* out_snapshot, const void* baseline, bool is_delta, uint bit_count) const
+{
+    if(packer->m_bits_read + m_field_count > bit_count){
+        return false;
+    }
+    u32 field_mask = packer->read<u32>(m_field_count);
+
+    for(uint field_idx = 0; field_idx < m_field_count; ++field_idx){
+        if(0 == (field_mask & (1U << field_idx))){
+            continue;
+        }
+
+        const net_field_t& field = m_fields[field_idx];
+        if(NET_FIELD_BYTES == field.type){
+            if(packer->m_bits_read + field.bit_count > bit_count){
+                return false;
+            }
+            packer->read_bits((byte*)out_snapshot + field.offset, field.size, field.bit_count);
+            continue;
+        }
+
+        bool is_small_delta = false;
+        if(is_delta && is_delta_field(field)){
+            if(packer->m_bits_read + 1 > bit_count){
+                return false;
+            }
+            is_small_delta = packer->read_bit();
+        }
+
+        uint field_bits = is_small_delta ? field.delta_bit_count : field.bit_count;
+        if(packer->m_bits_read + field_bits > bit_count){
+            return false;
+        }
+
+        u32 code = packer->read<u32>(field_bits);
+        if(is_small_delta){
+            if(nullptr == baseline){
+                continue;
+            }
+            code = decode_delta(code, encode_field(field, baseline), field.bit_count);
+        }
+        decode_field(field, code, out_snapshot);
+    }
+
+    return true;
+}
+
+void NetObjectTypeDefinition::interpolate(void* out_snapshot, const void* from, const void* to, f32 t) const
+{
+    if(nullptr != interpolate_snapshot){
+        interpolate_snapshot(out_snapshot, from, to, t);
+        return;
+    }
+
+    memcpy(out_snapshot, (t < 1.0f) ? from : to, m_snapshot_size);
+
+    for(uint field_idx = 0; field_idx < m_field_count; ++field_idx){
+        const net_field_t& field = m_fields[field_idx];
+        if((NET_FIELD_FLOAT != field.type) && (NET_FIELD_QUANTIZED_FLOAT != field.type)){
+            continue;
+        }
+
+        f32 from_value;
+        f32 to_value;
+        memcpy(&from_value, (const byte*)from + field.offset, sizeof(from_value));
+        memcpy(&to_value, (const byte*)to + field.offset, sizeof(to_value));
+
+        f32 value = from_value + ((to_value - from_value) * t);
+        if(NET_FIELD_QUANTIZED_FLOAT == field.type){
+            value = Clamp(value, field.min, field.max);
+        }
+        memcpy((byte*)out_snapshot + field.offset, &value, sizeof(value));
+    }
 }
\ No newline at end of file
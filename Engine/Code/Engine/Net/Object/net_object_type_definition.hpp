@@ -1,7 +1,13 @@
 #pragma once
 
+#include "Engine/Core/types.h"
+#include <stddef.h>
+
 class NetMessage;
 class NetObject;
+class NetConnection;
+class BitPacker;
+class ChunkAllocator;
 
 typedef void  (*append_create_info_cb)(NetMessage*, void* local_object);
 typedef void* (*process_create_info_cb)(NetMessage*, NetObject* nop);
@@ -11,8 +17,98 @@ typedef void* (*create_snapshot_cb)();
 typedef void  (*refresh_current_snapshot_cb)(void* snapshot, void* local_object);
 typedef void  (*append_snapshot_cb)(NetMessage*, void* snapshot);
 typedef void  (*process_snapshot_cb)(NetMessage*, void* snapshot);
+
+// delta_seconds is how long ago the snapshot was true, 0 unless the client ran
+// out of snapshots to interpolate towards and is holding the last one
 typedef void  (*apply_snapshot_cb)(void* snapshot, void* local_object, double delta_seconds);
 
+// Somewhere between from (t = 0) and to (t = 1), past to when extrapolating. Only
+// needed for something a straight line doesn't do, like an angle that wraps.
+typedef void  (*interpolate_snapshot_cb)(void* out_snapshot, const void* from, const void* to, f32 t);
+
+// How much a connection cares about an object right now (distance to its player,
+// whether it can be seen...). Scales the object's priority, 0 or less isn't sent.
+typedef f32   (*get_relevance_cb)(void* local_object, NetConnection* conn);
+
+// one bit per field in a change mask
+#define MAX_NET_OBJECT_FIELDS 32
+
+enum NetFieldType : u8
+{
+    NET_FIELD_BOOL,
+    NET_FIELD_INT,
+    NET_FIELD_UINT,
+    NET_FIELD_FLOAT,
+    NET_FIELD_QUANTIZED_FLOAT,
+    NET_FIELD_BYTES,
+    NUM_NET_FIELD_TYPES
+};
+
+// Where a field lives in the snapshot and how many bits it takes on the wire.
+// Ints keep their low bit_count bits (signed ones are sign extended on read),
+// quantized floats are clamped to [min, max] and spread over bit_count bits.
+//
+// With a delta_bit_count, when the connection has acked a baseline the field is
+// sent as the difference from it if that fits, which is most of the time for
+// something that moves a little each update.
+struct net_field_t
+{
+    NetFieldType type;
+    size_t offset;
+    size_t size;
+    uint bit_count;
+    uint delta_bit_count;
+    f32 min;
+    f32 max;
+};
+
+struct net_object_type_stats_t
+{
+    uint updates_sent;
+    uint bits_sent;
+
+    // what the same updates would have cost as whole snapshots and net ids
+    uint full_snapshot_bits;
+
+    // From an object having something to send to a connection until it's sent.
+    // Deferred counts the times it was passed over for lack of budget, starved
+    // the sends that came after more than NET_OBJECT_STARVATION_SECONDS.
+    f64 total_send_latency;
+    f64 max_send_latency;
+    uint deferred_count;
+    uint starved_count;
+};
+
+// snapshots are handed out this many to a chunk
+#define NET_SNAPSHOTS_PER_CHUNK 256
+
+// Every snapshot of a type (current, received, acked, pending...) comes from here
+// so a type's snapshots are packed together instead of spread over the heap.
+// Each starts as a copy of what create_snapshot made. Copying a definition
+// doesn't share any of this, the copy makes its own when it needs it.
+class NetSnapshotStorage
+{
+    public:
+        NetSnapshotStorage();
+        NetSnapshotStorage(const NetSnapshotStorage& other);
+        NetSnapshotStorage& operator=(const NetSnapshotStorage& other);
+        ~NetSnapshotStorage();
+
+        void* alloc(size_t snapshot_size, create_snapshot_cb create_snapshot);
+        void free(void* snapshot);
+
+        uint get_live_count() const;
+        uint get_chunk_count() const;
+
+    private:
+        void release();
+
+    private:
+        ChunkAllocator* m_allocator;
+        void* m_default_snapshot;
+        size_t m_snapshot_size;
+};
+
 class NetObjectTypeDefinition
 {
     public:
@@ -27,9 +123,59 @@ class NetObjectTypeDefinition
         append_snapshot_cb append_snapshot;
         process_snapshot_cb process_snapshot;
         apply_snapshot_cb apply_snapshot;
+        interpolate_snapshot_cb interpolate_snapshot;
+        get_relevance_cb get_relevance;
 
         size_t m_snapshot_size;
 
+        // added to each waiting object's priority every tick (times relevance),
+        // the highest are sent first when a connection's budget is short
+        f32 m_priority;
+
+        // When fields are declared only the ones that changed are sent, bit packed.
+        // Without any the whole snapshot goes through append/process_snapshot.
+        net_field_t m_fields[MAX_NET_OBJECT_FIELDS];
+        uint m_field_count;
+
+        net_object_type_stats_t m_stats;
+
+        NetSnapshotStorage m_snapshots;
+
     public:
         NetObjectTypeDefinition();
-};
\ No newline at end of file
+
+        void* alloc_snapshot();
+        void free_snapshot(void* snapshot);
+
+        void add_bool_field(size_t offset);
+        void add_int_field(size_t offset, size_t size, uint bit_count, uint delta_bit_count = 0);
+        void add_uint_field(size_t offset, size_t size, uint bit_count, uint delta_bit_count = 0);
+        void add_float_field(size_t offset);
+        void add_quantized_float_field(size_t offset, f32 min, f32 max, uint bit_count, uint delta_bit_count = 0);
+        void add_bytes_field(size_t offset, size_t size);
+
+    public:
+        bool has_fields() const;
+        u32 get_all_fields_mask() const;
+
+        // fields whose encoded values differ, so changes smaller than a quantized
+        // step don't count
+        u32 get_changed_fields_mask(const void* snapshot, const void* baseline) const;
+
+        // [field_count bits of mask][each field in the mask], fields that take
+        // deltas are written against baseline when there is one
+        void write_fields(BitPacker* packer, const void* snapshot, const void* baseline, u32 field_mask) const;
+        uint get_written_bit_count(const void* snapshot, const void* baseline, u32 field_mask) const;
+
+        // Overwrites the fields that were sent. is_delta says whether they were
+        // written against a baseline; if so and baseline is null they're read past
+        // without being applied. False if it would read past bit_count.
+        bool read_fields(BitPacker* packer, void* out_snapshot, const void* baseline, bool is_delta, uint bit_count) const;
+
+        // Uses interpolate_snapshot if there is one. Otherwise float fields move in
+        // a straight line and everything else stays as from until t reaches 1.
+        void interpolate(void* out_snapshot, const void* from, const void* to, f32 t) const;
+
+    private:
+        void add_field(NetFieldType type, size_t offset, size_t size, uint bit_count, uint delta_bit_count, f32 min, f32 max);
+};
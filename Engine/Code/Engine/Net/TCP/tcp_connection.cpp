@@ -2,6 +2,7 @@
 #include "Engine/Net/TCP/tcp_socket.hpp"
 #include "Engine/Net/message.hpp"
 #include "Engine/Core/Common.hpp"
+#include "Engine/Core/log.h"
 
 TCPConnection::TCPConnection()
     :NetConnection()
@@ -19,19 +20,38 @@ TCPConnection::~TCPConnection()
 
 void TCPConnection::send(NetMessage *msg)
 {
-    // calculate the message size
-    uint16_t message_size = (uint16_t)(msg->m_payload_bytes_used + 1); // data + message_id
+    // [u16 size][u8 id][data] is appended here and goes out with the rest on the
+    // next flush
+    size_t offset = m_send_buffer.size();
+    m_send_buffer.resize(offset + msg->get_full_size());
+    msg->write_to(m_send_buffer.data() + offset);
 
-    // send the message size and message id
-    m_socket->send(&message_size, sizeof(message_size));
-    m_socket->send(&msg->m_message_type_id, sizeof(msg->m_message_type_id));
+    m_send_stats.messages_sent++;
 
-    // send the actual message data
-    if(0 < msg->m_payload_bytes_used){
-        m_socket->send(msg->m_payload, (unsigned int)msg->m_payload_bytes_used);
+    delete msg;
+}
+
+void TCPConnection::flush()
+{
+    if(m_send_buffer.empty() || (nullptr == m_socket) || !m_socket->is_valid()){
+        return;
     }
 
-    delete msg;
+    unsigned int bytes_sent = m_socket->send(m_send_buffer.data(), (unsigned int)m_send_buffer.size());
+    m_send_stats.syscalls++;
+
+    // whatever the socket didn't take waits at the front for the next flush
+    if(bytes_sent > 0){
+        m_send_buffer.erase(m_send_buffer.begin(), m_send_buffer.begin() + bytes_sent);
+        m_send_stats.packets_sent++;
+        m_send_stats.bytes_sent += bytes_sent;
+    }
+
+    if(m_send_buffer.size() > MAX_TCP_SEND_BUFFER_SIZE){
+        log_printf("%s stopped reading, dropping the connection", net_address_to_string(m_address).c_str());
+        m_socket->close();
+        m_send_buffer.clear();
+    }
 }
 
 bool TCPConnection::receive(NetMessage **msg)
@@ -53,6 +73,7 @@ bool TCPConnection::receive(NetMessage **msg)
 
     *msg = new NetMessage();
     apply_buffer_to_msg(*msg);
+    (*msg)->m_sender = this;
     return true;
 }
 
@@ -100,9 +121,9 @@ void TCPConnection::apply_buffer_to_msg(NetMessage* msg)
     // set message type id
     msg->m_message_type_id = m_msg_type_buffer;
 
-    // memcpy payload
-    memcpy(msg->m_payload, m_msg_payload_buffer, m_msg_payload_bytes_received);
-    msg->m_payload_bytes_used = m_msg_payload_bytes_received;
+    // read where it is, nothing is received into the buffer again until the
+    // next call to receive
+    msg->set_view(m_msg_payload_buffer, m_msg_payload_bytes_received);
 
     // set sender
     msg->m_sender = this;
@@ -117,6 +138,9 @@ bool TCPConnection::connect()
 {
     m_socket->join(m_address);
     m_socket->set_blocking(false);
+
+    // messages are already gathered into one send per update, don't wait to gather more
+    m_socket->set_no_delay(true);
     return m_socket->is_valid();
 }
 
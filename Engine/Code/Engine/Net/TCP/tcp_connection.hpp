@@ -4,6 +4,11 @@
 #include "Engine/Net/message.hpp"
 #include "Engine/Core/Common.hpp"
 
+#include <vector>
+
+// a peer this far behind on reading isn't coming back, it's dropped
+#define MAX_TCP_SEND_BUFFER_SIZE (1024 * 1024)
+
 class TCPSocket;
 class NetMessage;
 
@@ -21,13 +26,19 @@ class TCPConnection : public NetConnection
         byte_t m_msg_payload_buffer[MAX_PAYLOAD_SIZE];
         size_t m_msg_payload_bytes_received;
 
+        // every message sent since the last flush, framed the way receive reads them
+        std::vector<byte_t> m_send_buffer;
+
     public:
         TCPConnection();
         virtual ~TCPConnection();
 
         virtual void send(NetMessage *msg) override;
+        // the message reads the connection's buffer, it's only good until the
+        // next receive
         virtual bool receive(NetMessage **out_msg) override;
         virtual bool is_disconnected() const override;
+        virtual void flush() override;
 
         bool connect();
 
@@ -72,6 +72,9 @@ void TCPSession::leave()
         log_printf("Leaving session at address %s", net_address_to_string(m_host_connection->m_address).c_str());
     }
 
+    // anything still queued gets one try
+    flush_connections();
+
     destroy_connection(m_my_connection);
     destroy_connection(m_host_connection);
 
@@ -86,10 +89,12 @@ void TCPSession::leave()
 
 void TCPSession::update()
 {
-    // accept new connections if listening
-    if (is_listening()){
-		TCPSocket *socket = m_listen_socket->accept();
-		if(nullptr != socket){
+    poll_sockets();
+
+    // accept every waiting connection if listening
+    if (is_listening() && m_listen_socket->m_is_readable){
+		TCPSocket *socket;
+		while(is_listening() && (nullptr != (socket = m_listen_socket->accept()))){
 			TCPConnection* new_guy = new TCPConnection();
 			new_guy->m_socket = socket; 
             new_guy->m_address = socket->m_address;
@@ -100,6 +105,7 @@ void TCPSession::update()
 			} else {
 				join_connection(conn_idx, new_guy);
                 new_guy->m_socket->set_blocking(false);
+                new_guy->m_socket->set_no_delay(true);
 
                 log_printf("New connection [%i] from [%s]", conn_idx, net_address_to_string(new_guy->m_address).c_str());
 
@@ -117,6 +123,14 @@ void TCPSession::update()
             continue;
         }
 
+        // nothing arrived on its socket since the last update
+        if(conn != m_my_connection){
+            TCPSocket* socket = ((TCPConnection*)conn)->m_socket;
+            if((nullptr != socket) && !socket->m_is_readable){
+                continue;
+            }
+        }
+
         NetMessage* msg;
         while(conn->receive(&msg)){
             process_message(msg);
@@ -141,7 +155,10 @@ void TCPSession::update()
 	if(is_running() && nullptr == m_host_connection) {
 		leave(); 
         m_host_left_event->trigger();
+        return;
 	}
+
+    flush_connections();
 }
 
 void TCPSession::process_message(NetMessage* msg)
@@ -208,6 +225,31 @@ bool TCPSession::is_listening()
     return (nullptr != m_listen_socket);
 }
 
+void TCPSession::poll_sockets()
+{
+    m_polled_sockets.clear();
+
+    if(is_listening()){
+        m_polled_sockets.push_back(m_listen_socket);
+    }
+
+    for(unsigned int i = 0; i < m_connections.size(); ++i){
+        NetConnection* conn = m_connections[i];
+        if((nullptr == conn) || (conn == m_my_connection)){
+            continue;
+        }
+
+        TCPSocket* socket = ((TCPConnection*)conn)->m_socket;
+        if(nullptr != socket){
+            m_polled_sockets.push_back(socket);
+        }
+    }
+
+    if(!m_polled_sockets.empty()){
+        TCPSocket::poll_readable(m_polled_sockets.data(), (unsigned int)m_polled_sockets.size());
+    }
+}
+
 unsigned int TCPSession::get_number_of_live_clients() const
 {
     unsigned int number_live = 0;
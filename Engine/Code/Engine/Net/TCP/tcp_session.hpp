@@ -3,6 +3,8 @@
 #include "Engine/Net/session.hpp"
 #include "Engine/Net/TCP/tcp_connection.hpp"
 
+#include <vector>
+
 class TCPSocket;
 
 class TCPSession : public NetSession
@@ -10,6 +12,9 @@ class TCPSession : public NetSession
     public:
         TCPSocket* m_listen_socket;
 
+        // everything polled at the start of an update, kept to save allocating
+        std::vector<TCPSocket*> m_polled_sockets;
+
     public:
         TCPSession();
         virtual ~TCPSession();
@@ -30,4 +35,8 @@ class TCPSession : public NetSession
         void on_join_response(NetMessage* msg);
 
         unsigned int get_number_of_live_clients() const;
+
+    private:
+        // only sockets with something waiting are read or accepted from
+        void poll_sockets();
 };
\ No newline at end of file
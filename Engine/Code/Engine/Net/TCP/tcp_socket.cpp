@@ -8,6 +8,7 @@
 TCPSocket::TCPSocket()
     :m_socket(INVALID_SOCKET)
     ,m_is_listen_socket(false)
+    ,m_is_readable(true)
 {
 }
 
@@ -170,13 +171,17 @@ unsigned int TCPSocket::send(const void* payload, unsigned int payload_size_byte
     int bytes_sent = ::send(m_socket, (const char*)payload, (int)payload_size_bytes, 0);
     if(bytes_sent <= 0){
         int error = ::WSAGetLastError();
+
+        // the send buffer is full, try again later
+        if(WSAEWOULDBLOCK == error){
+            return 0;
+        }
+
         log_printf("TCPSocket send error: %i", error);        
         close(); // something went wrong
         return 0;
     }
 
-    ASSERT_OR_DIE((unsigned int)bytes_sent == payload_size_bytes, "TCPSocket send error: Numbers of bytes sent does not equal payload size");
-
     return bytes_sent;
 }
 
@@ -209,6 +214,58 @@ unsigned int TCPSocket::receive(void* payload, unsigned int max_payload_size_byt
     return (unsigned int)bytes_read;
 }
 
+unsigned int TCPSocket::poll_readable(TCPSocket** sockets, unsigned int socket_count)
+{
+    // sessions are only updated from the main thread, so this is kept between polls
+    static std::vector<WSAPOLLFD> s_poll_fds;
+    s_poll_fds.clear();
+
+    for(unsigned int socket_idx = 0; socket_idx < socket_count; ++socket_idx){
+        TCPSocket* socket = sockets[socket_idx];
+        socket->m_is_readable = false;
+        if(!socket->is_valid()){
+            continue;
+        }
+
+        WSAPOLLFD fd;
+        fd.fd = socket->m_socket;
+        fd.events = POLLRDNORM;
+        fd.revents = 0;
+        s_poll_fds.push_back(fd);
+    }
+
+    if(s_poll_fds.empty()){
+        return 0;
+    }
+
+    int ready_count = ::WSAPoll(s_poll_fds.data(), (ULONG)s_poll_fds.size(), 0);
+    if(SOCKET_ERROR == ready_count){
+        for(unsigned int socket_idx = 0; socket_idx < socket_count; ++socket_idx){
+            sockets[socket_idx]->m_is_readable = sockets[socket_idx]->is_valid();
+        }
+        return socket_count;
+    }
+
+    // invalid sockets were skipped, so the fds are in the same order minus those
+    unsigned int readable_count = 0;
+    unsigned int fd_idx = 0;
+    for(unsigned int socket_idx = 0; socket_idx < socket_count; ++socket_idx){
+        TCPSocket* socket = sockets[socket_idx];
+        if(!socket->is_valid()){
+            continue;
+        }
+
+        // hangups and errors count too, the next recv is what notices them
+        if(0 != s_poll_fds[fd_idx].revents){
+            socket->m_is_readable = true;
+            readable_count++;
+        }
+        fd_idx++;
+    }
+
+    return readable_count;
+}
+
 void TCPSocket::check_for_disconnect()
 {
     if(!is_valid()){
@@ -228,6 +285,16 @@ void TCPSocket::check_for_disconnect()
     }
 }
 
+void TCPSocket::set_no_delay(bool is_no_delay)
+{
+    if(!is_valid()){
+        return;
+    }
+
+    BOOL no_delay = is_no_delay ? TRUE : FALSE;
+    ::setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+}
+
 void TCPSocket::set_blocking(bool is_blocking)
 {
     if(!is_valid()){
@@ -4,6 +4,7 @@
 #include "Engine/Net/net_address.hpp"
 #include "Engine/Core/Common.hpp"
 #include <inttypes.h>
+#include <vector>
 
 class NetMessage;
 
@@ -14,6 +15,9 @@ class TCPSocket
         net_address_t m_address;
         bool m_is_listen_socket;
 
+        // set by poll_readable, a socket that was never polled is always read
+        bool m_is_readable;
+
     public:
         TCPSocket();
         ~TCPSocket();
@@ -30,10 +34,17 @@ class TCPSocket
         TCPSocket* accept();
 
         // both
+        // on a non blocking socket less than everything may go, 0 when nothing could
         unsigned int send(const void* payload, unsigned int payload_size_bytes);
         unsigned int receive(void* payload, unsigned int max_payload_size_bytes);
 
         void set_blocking(bool is_blocking);
+        void set_no_delay(bool is_no_delay);
         void check_for_disconnect();
         bool is_valid() const;
+
+        // One poll over all of them instead of a recv or accept on each. Marks the
+        // ones with something to take, or that closed since, and returns how many
+        // there are. Everything counts as readable if the poll fails.
+        static unsigned int poll_readable(TCPSocket** sockets, unsigned int socket_count);
 };
\ No newline at end of file
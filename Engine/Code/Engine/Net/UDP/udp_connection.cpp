@@ -0,0 +1,483 @@
+#include "Engine/Net/UDP/udp_connection.hpp"
+#include "Engine/Net/UDP/udp_session.hpp"
+#include "Engine/Net/session.hpp"
+#include "Engine/Net/message.hpp"
+#include "Engine/Net/message_definition.hpp"
+
+#include <string.h>
+
+UDPConnection::UDPConnection()
+    :NetConnection()
+    ,m_next_sent_ack(0)
+    ,m_next_sent_reliable_id(0)
+    ,m_next_sent_sequence_id(0)
+    ,m_oldest_unconfirmed_reliable_id(0)
+    ,m_last_received_ack(INVALID_PACKET_ACK)
+    ,m_previous_received_ack_bitfield(0)
+    ,m_has_received_reliable(false)
+    ,m_highest_received_reliable_id(0)
+    ,m_next_expected_sequence_id(0)
+    ,m_rtt(DEFAULT_RTT_SECONDS)
+    ,m_last_sent_time(0.0)
+    ,m_last_received_time(0.0)
+    ,m_needs_ack(false)
+    ,m_is_disconnected(false)
+{
+    memset(m_packet_trackers, 0, sizeof(m_packet_trackers));
+    memset(m_received_reliable_ids, 0, sizeof(m_received_reliable_ids));
+    memset(m_received_reliable_valid, 0, sizeof(m_received_reliable_valid));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+UDPConnection::~UDPConnection()
+{
+    std::deque<NetMessage*>* unsent_queues[] = { &m_unsent_in_order, &m_unsent_reliables, &m_unsent_unreliables };
+    for(std::deque<NetMessage*>* queue : unsent_queues){
+        for(NetMessage* msg : *queue){
+            delete msg;
+        }
+        queue->clear();
+    }
+
+    std::vector<NetMessage*>* held_lists[] = { &m_sent_in_order, &m_sent_reliables, &m_out_of_order };
+    for(std::vector<NetMessage*>* list : held_lists){
+        for(NetMessage* msg : *list){
+            delete msg;
+        }
+        list->clear();
+    }
+
+    while(!m_ready_messages.empty()){
+        delete m_ready_messages.front();
+        m_ready_messages.pop();
+    }
+}
+
+void UDPConnection::send(NetMessage *msg)
+{
+    // messages this end never registered go the way a definition does by default
+    NetMessageDefinition* def = (nullptr != m_owner) ? m_owner->get_message_definition(msg->m_message_type_id) : nullptr;
+    bool is_reliable = (nullptr == def) || def->is_reliable();
+    bool is_in_order = is_reliable && ((nullptr == def) || def->is_in_order());
+
+    if(!is_reliable){
+        m_unsent_unreliables.push_back(msg);
+    }else if(is_in_order){
+        // ordered by when they're sent, reliable ids are only handed out once they go on the wire
+        msg->m_sequence_id = m_next_sent_sequence_id++;
+        m_unsent_in_order.push_back(msg);
+    }else{
+        m_unsent_reliables.push_back(msg);
+    }
+}
+
+bool UDPConnection::receive(NetMessage **msg)
+{
+    if(m_ready_messages.empty()){
+        *msg = nullptr;
+        return false;
+    }
+
+    *msg = m_ready_messages.front();
+    m_ready_messages.pop();
+    return true;
+}
+
+bool UDPConnection::is_disconnected() const
+{
+    return m_is_disconnected;
+}
+
+void UDPConnection::flush()
+{
+    UDPSession* session = (UDPSession*)m_owner;
+    if((nullptr == session) || (nullptr == session->m_socket)){
+        return;
+    }
+
+    uint8_t from_conn_idx = session->get_my_connection_index();
+    for(unsigned int packet_count = 0; packet_count < MAX_PACKETS_PER_FLUSH; ++packet_count){
+        NetPacket packet;
+        if(!write_next_packet(&packet, from_conn_idx, session->m_time)){
+            break;
+        }
+
+        if(session->send_packet(m_address, &packet)){
+            m_send_stats.syscalls++;
+        }
+    }
+
+    drop_unsent_unreliables();
+}
+
+bool UDPConnection::process_packet_header(packet_header_t* header, double now)
+{
+    m_last_received_time = now;
+    m_stats.packets_received++;
+
+    // what they've received of ours
+    if(INVALID_PACKET_ACK != header->last_received_ack){
+        confirm_packet(header->last_received_ack, now);
+
+        u32 bitfield = header->previous_received_ack_bitfield;
+        for(u16 bit_idx = 0; bit_idx < 32; ++bit_idx){
+            if(0 != (bitfield & (1U << bit_idx))){
+                confirm_packet((u16)(header->last_received_ack - bit_idx - 1), now);
+            }
+        }
+
+        // too far behind to ever show up in an ack now
+        for(uint tracker_idx = 0; tracker_idx < MAX_TRACKED_PACKETS; ++tracker_idx){
+            udp_packet_tracker_t& tracker = m_packet_trackers[tracker_idx];
+            if(tracker.is_valid && ((u16)(header->last_received_ack - tracker.packet_ack) > 32) && !cycle_greater_than(tracker.packet_ack, header->last_received_ack)){
+                tracker.is_valid = false;
+                m_stats.packets_lost++;
+            }
+        }
+    }
+
+    // and what we've received of theirs
+    if(INVALID_PACKET_ACK == header->packet_ack){
+        return false;
+    }
+
+    bool is_duplicate = false;
+    bool is_too_old = false;
+    update_received_acks(header->packet_ack, &is_duplicate, &is_too_old);
+    if(is_duplicate){
+        m_stats.duplicate_packets++;
+        return false;
+    }
+    if(is_too_old){
+        return false;
+    }
+
+    // packets with only acks in them aren't acked back, or two idle ends would never stop
+    uint msg_count = (uint)header->in_order_bundle_count + header->reliable_bundle_count + header->unreliable_bundle_count;
+    if(msg_count > 0){
+        m_needs_ack = true;
+    }
+
+    return true;
+}
+
+void UDPConnection::process_message(NetMessage* msg, PacketBundle bundle)
+{
+    msg->m_sender = this;
+
+    if(PACKET_BUNDLE_UNRELIABLE == bundle){
+        m_ready_messages.push(msg);
+        return;
+    }
+
+    // a resend of something that already made it
+    if(is_reliable_received(msg->m_reliable_id)){
+        delete msg;
+        return;
+    }
+    mark_reliable_received(msg->m_reliable_id);
+
+    if(PACKET_BUNDLE_IN_ORDER == bundle){
+        process_in_order(msg);
+    }else{
+        m_ready_messages.push(msg);
+    }
+}
+
+bool UDPConnection::write_next_packet(NetPacket* out_packet, uint8_t from_conn_idx, double now)
+{
+    packet_header_t* header = out_packet->get_packet_header();
+    header->from_conn_idx = from_conn_idx;
+    header->packet_ack = m_next_sent_ack;
+    header->last_received_ack = m_last_received_ack;
+    header->previous_received_ack_bitfield = m_previous_received_ack_bitfield;
+
+    udp_packet_tracker_t tracker;
+    tracker.packet_ack = m_next_sent_ack;
+    tracker.is_valid = true;
+    tracker.send_time = now;
+    tracker.reliable_count = 0;
+
+    // in order first, the bundles can't be mixed
+    write_reliables(out_packet, &tracker, true, now);
+    write_reliables(out_packet, &tracker, false, now);
+
+    while(!m_unsent_unreliables.empty()){
+        NetMessage* msg = m_unsent_unreliables.front();
+        if(!out_packet->write(msg)){
+            break;
+        }
+
+        m_unsent_unreliables.pop_front();
+        delete msg;
+    }
+
+    bool has_messages = (out_packet->get_messages_count() > 0);
+    bool is_heartbeat_due = ((now - m_last_sent_time) >= DEFAULT_HEARTBEAT_SECONDS);
+    if(!has_messages && !m_needs_ack && !is_heartbeat_due){
+        return false;
+    }
+
+    // only packets the other end will ack are tracked
+    if(has_messages){
+        udp_packet_tracker_t& slot = m_packet_trackers[m_next_sent_ack % MAX_TRACKED_PACKETS];
+        if(slot.is_valid){
+            m_stats.packets_lost++;
+        }
+        slot = tracker;
+    }
+
+    m_next_sent_ack++;
+    if(INVALID_PACKET_ACK == m_next_sent_ack){
+        m_next_sent_ack++;
+    }
+
+    m_last_sent_time = now;
+    m_needs_ack = false;
+
+    m_send_stats.packets_sent++;
+    m_send_stats.bytes_sent += out_packet->m_payload_bytes_used;
+    m_send_stats.messages_sent += out_packet->get_messages_count();
+
+    return true;
+}
+
+void UDPConnection::drop_unsent_unreliables()
+{
+    for(NetMessage* msg : m_unsent_unreliables){
+        delete msg;
+    }
+    m_unsent_unreliables.clear();
+}
+
+bool UDPConnection::is_timed_out(double now) const
+{
+    return ((now - m_last_received_time) >= DEFAULT_CONNECTION_TIMEOUT_SECONDS);
+}
+
+void UDPConnection::disconnect()
+{
+    m_is_disconnected = true;
+}
+
+double UDPConnection::get_resend_time() const
+{
+    double resend_time = m_rtt * 1.5;
+    if(resend_time < MIN_RESEND_SECONDS){
+        return MIN_RESEND_SECONDS;
+    }
+    if(resend_time > MAX_RESEND_SECONDS){
+        return MAX_RESEND_SECONDS;
+    }
+    return resend_time;
+}
+
+uint UDPConnection::get_unconfirmed_reliable_count() const
+{
+    return (uint)(m_unsent_in_order.size() + m_unsent_reliables.size() + m_sent_in_order.size() + m_sent_reliables.size());
+}
+
+void UDPConnection::update_received_acks(u16 packet_ack, bool* out_is_duplicate, bool* out_is_too_old)
+{
+    *out_is_duplicate = false;
+    *out_is_too_old = false;
+
+    if(INVALID_PACKET_ACK == m_last_received_ack){
+        m_last_received_ack = packet_ack;
+        m_previous_received_ack_bitfield = 0;
+        return;
+    }
+
+    // newer, shift the history along and the old newest becomes one of the bits
+    if(cycle_greater_than(packet_ack, m_last_received_ack)){
+        u16 shift = (u16)(packet_ack - m_last_received_ack);
+        if(shift < 32){
+            m_previous_received_ack_bitfield = (m_previous_received_ack_bitfield << shift) | (1U << (shift - 1));
+        }else if(shift == 32){
+            m_previous_received_ack_bitfield = (1U << 31);
+        }else{
+            m_previous_received_ack_bitfield = 0;
+        }
+
+        m_last_received_ack = packet_ack;
+        return;
+    }
+
+    u16 age = (u16)(m_last_received_ack - packet_ack);
+    if(0 == age){
+        *out_is_duplicate = true;
+        return;
+    }
+
+    // can't be acked any more, anything reliable in it will be resent
+    if(age > 32){
+        *out_is_too_old = true;
+        return;
+    }
+
+    u32 bit = (1U << (age - 1));
+    if(0 != (m_previous_received_ack_bitfield & bit)){
+        *out_is_duplicate = true;
+        return;
+    }
+    m_previous_received_ack_bitfield |= bit;
+}
+
+void UDPConnection::confirm_packet(u16 packet_ack, double now)
+{
+    udp_packet_tracker_t& tracker = m_packet_trackers[packet_ack % MAX_TRACKED_PACKETS];
+    if(!tracker.is_valid || (tracker.packet_ack != packet_ack)){
+        return;
+    }
+
+    double rtt_sample = now - tracker.send_time;
+    m_rtt += (rtt_sample - m_rtt) * RTT_BLEND;
+
+    for(uint reliable_idx = 0; reliable_idx < tracker.reliable_count; ++reliable_idx){
+        confirm_reliable(tracker.reliable_ids[reliable_idx]);
+    }
+
+    tracker.is_valid = false;
+    m_stats.packets_acked++;
+}
+
+void UDPConnection::confirm_reliable(u16 reliable_id)
+{
+    std::vector<NetMessage*>* sent_lists[] = { &m_sent_in_order, &m_sent_reliables };
+    for(std::vector<NetMessage*>* list : sent_lists){
+        for(unsigned int msg_idx = 0; msg_idx < list->size(); ++msg_idx){
+            NetMessage* msg = (*list)[msg_idx];
+            if(msg->m_reliable_id == reliable_id){
+                // erased rather than swapped, each list stays oldest first
+                list->erase(list->begin() + msg_idx);
+                delete msg;
+                update_oldest_unconfirmed_reliable_id();
+                return;
+            }
+        }
+    }
+}
+
+void UDPConnection::update_oldest_unconfirmed_reliable_id()
+{
+    u16 oldest = m_next_sent_reliable_id;
+    if(!m_sent_in_order.empty() && cycle_greater_than(oldest, m_sent_in_order.front()->m_reliable_id)){
+        oldest = m_sent_in_order.front()->m_reliable_id;
+    }
+    if(!m_sent_reliables.empty() && cycle_greater_than(oldest, m_sent_reliables.front()->m_reliable_id)){
+        oldest = m_sent_reliables.front()->m_reliable_id;
+    }
+
+    m_oldest_unconfirmed_reliable_id = oldest;
+}
+
+bool UDPConnection::is_reliable_received(u16 reliable_id) const
+{
+    if(!m_has_received_reliable || cycle_greater_than(reliable_id, m_highest_received_reliable_id)){
+        return false;
+    }
+
+    // the sender never gets a window ahead of what it hasn't had confirmed, so
+    // anything further back than that must have arrived already
+    u16 age = (u16)(m_highest_received_reliable_id - reliable_id);
+    if(age >= RELIABLE_WINDOW){
+        return true;
+    }
+
+    uint slot = reliable_id % RELIABLE_WINDOW;
+    return m_received_reliable_valid[slot] && (m_received_reliable_ids[slot] == reliable_id);
+}
+
+void UDPConnection::mark_reliable_received(u16 reliable_id)
+{
+    uint slot = reliable_id % RELIABLE_WINDOW;
+    m_received_reliable_ids[slot] = reliable_id;
+    m_received_reliable_valid[slot] = true;
+
+    if(!m_has_received_reliable || cycle_greater_than(reliable_id, m_highest_received_reliable_id)){
+        m_highest_received_reliable_id = reliable_id;
+        m_has_received_reliable = true;
+    }
+}
+
+void UDPConnection::process_in_order(NetMessage* msg)
+{
+    // ahead of what's expected, held until the gap fills. That can be ticks away,
+    // so it can't keep reading the packet it came in
+    if(msg->m_sequence_id != m_next_expected_sequence_id){
+        msg->own_payload();
+        m_out_of_order.push_back(msg);
+        return;
+    }
+
+    m_ready_messages.push(msg);
+    m_next_expected_sequence_id++;
+
+    bool found_next = true;
+    while(found_next){
+        found_next = false;
+        for(unsigned int msg_idx = 0; msg_idx < m_out_of_order.size(); ++msg_idx){
+            NetMessage* held = m_out_of_order[msg_idx];
+            if(held->m_sequence_id == m_next_expected_sequence_id){
+                m_out_of_order[msg_idx] = m_out_of_order.back();
+                m_out_of_order.pop_back();
+
+                m_ready_messages.push(held);
+                m_next_expected_sequence_id++;
+                found_next = true;
+                break;
+            }
+        }
+    }
+}
+
+bool UDPConnection::can_send_new_reliable() const
+{
+    u16 in_flight = (u16)(m_next_sent_reliable_id - m_oldest_unconfirmed_reliable_id);
+    return (in_flight < RELIABLE_WINDOW);
+}
+
+bool UDPConnection::write_reliables(NetPacket* packet, udp_packet_tracker_t* tracker, bool in_order, double now)
+{
+    std::vector<NetMessage*>& sent = in_order ? m_sent_in_order : m_sent_reliables;
+    std::deque<NetMessage*>& unsent = in_order ? m_unsent_in_order : m_unsent_reliables;
+
+    // resends go first, they're what everything after them is waiting on
+    double resend_time = get_resend_time();
+    for(NetMessage* msg : sent){
+        if((now - msg->m_last_sent_time) < resend_time){
+            continue;
+        }
+
+        if(!write_reliable(packet, tracker, msg, in_order, now)){
+            return false;
+        }
+        m_stats.reliables_resent++;
+    }
+
+    while(!unsent.empty() && can_send_new_reliable()){
+        NetMessage* msg = unsent.front();
+        msg->m_reliable_id = m_next_sent_reliable_id;
+        if(!write_reliable(packet, tracker, msg, in_order, now)){
+            return false;
+        }
+
+        m_next_sent_reliable_id++;
+        unsent.pop_front();
+        sent.push_back(msg);
+        m_stats.reliables_sent++;
+    }
+
+    return true;
+}
+
+bool UDPConnection::write_reliable(NetPacket* packet, udp_packet_tracker_t* tracker, NetMessage* msg, bool in_order, double now)
+{
+    if(!packet->write_reliable(msg, in_order)){
+        return false;
+    }
+
+    tracker->reliable_ids[tracker->reliable_count++] = msg->m_reliable_id;
+    msg->m_last_sent_time = now;
+    return true;
+}
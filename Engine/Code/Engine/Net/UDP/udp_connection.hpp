@@ -1,14 +1,149 @@
 #pragma once
 
 #include "Engine/Net/connection.hpp"
+#include "Engine/Net/net_packet.hpp"
+#include "Engine/Net/message.hpp"
+#include "Engine/Core/types.h"
 
+#include <deque>
+#include <queue>
+#include <vector>
+
+// sent packets remembered until acked, one older than this is given up on
+#define MAX_TRACKED_PACKETS 128
+
+// how far ahead of the oldest unconfirmed reliable a new one may be sent, and how
+// far back the receiver remembers which ids it's seen
+#define RELIABLE_WINDOW 1024
+
+#define DEFAULT_RTT_SECONDS (0.1)
+#define MIN_RESEND_SECONDS (0.05)
+#define MAX_RESEND_SECONDS (1.0)
+
+// how much of each new round trip sample goes into the estimate
+#define RTT_BLEND 0.1
+
+#define DEFAULT_HEARTBEAT_SECONDS (0.5)
+#define DEFAULT_CONNECTION_TIMEOUT_SECONDS (10.0)
+
+// flushing stops after this many, unreliable messages that didn't make it are dropped
+#define MAX_PACKETS_PER_FLUSH 16
+
+struct udp_packet_tracker_t
+{
+    u16 packet_ack;
+    bool is_valid;
+    double send_time;
+
+    u16 reliable_ids[MAX_RELIABLES_PER_PACKET];
+    uint reliable_count;
+};
+
+struct udp_connection_stats_t
+{
+    uint packets_received;
+    uint packets_acked;
+    uint packets_lost;
+    uint duplicate_packets;
+    uint reliables_sent;
+    uint reliables_resent;
+    uint bytes_received;
+};
+
+// One remote end of a UDPSession. Messages are sent through one of three
+// channels picked by their definition: unreliable ones go out once, reliable ones
+// are resent until the packet carrying them is acked, and in order ones are also
+// held back on arrival until everything sent before them has been handled.
+//
+// Every packet has its own sequence number (packet_ack) and acks the newest
+// packet received from the other side along with the 32 before it, so one packet
+// getting through is enough to confirm a burst of them.
 class UDPConnection : public NetConnection
 {
+    public:
+        // sending
+        u16 m_next_sent_ack;
+        u16 m_next_sent_reliable_id;
+        u16 m_next_sent_sequence_id;
+        u16 m_oldest_unconfirmed_reliable_id;
+
+        std::deque<NetMessage*> m_unsent_in_order;
+        std::deque<NetMessage*> m_unsent_reliables;
+        std::deque<NetMessage*> m_unsent_unreliables;
+
+        // sent and waiting to be confirmed, oldest reliable id first
+        std::vector<NetMessage*> m_sent_in_order;
+        std::vector<NetMessage*> m_sent_reliables;
+
+        udp_packet_tracker_t m_packet_trackers[MAX_TRACKED_PACKETS];
+
+        // receiving
+        u16 m_last_received_ack;
+        u32 m_previous_received_ack_bitfield;
+
+        bool m_has_received_reliable;
+        u16 m_highest_received_reliable_id;
+        u16 m_received_reliable_ids[RELIABLE_WINDOW];
+        bool m_received_reliable_valid[RELIABLE_WINDOW];
+
+        u16 m_next_expected_sequence_id;
+        std::vector<NetMessage*> m_out_of_order;
+
+        // handled in the order they were received (or put back in order). Most
+        // still read the packet they came in, they're all handled the same tick
+        std::queue<NetMessage*> m_ready_messages;
+
+        // timing
+        double m_rtt;
+        double m_last_sent_time;
+        double m_last_received_time;
+        bool m_needs_ack;
+        bool m_is_disconnected;
+
+        udp_connection_stats_t m_stats;
+
     public:
         UDPConnection();
         virtual ~UDPConnection();
 
+        // queues a message, the connection owns it from here on
         virtual void send(NetMessage *msg) override;
         virtual bool receive(NetMessage **msg) override;
         virtual bool is_disconnected() const override;
-};
\ No newline at end of file
+
+        // as many MTU sized packets as it takes, up to MAX_PACKETS_PER_FLUSH
+        virtual void flush() override;
+
+    public:
+        // false for a duplicate or one too old to ack, its messages shouldn't be handled
+        bool process_packet_header(packet_header_t* header, double now);
+        void process_message(NetMessage* msg, PacketBundle bundle);
+
+        // true when out_packet has something worth sending: messages, acks the other
+        // side is waiting on, or a heartbeat
+        bool write_next_packet(NetPacket* out_packet, uint8_t from_conn_idx, double now);
+
+        // what couldn't be sent this flush is stale by the next
+        void drop_unsent_unreliables();
+
+        bool is_timed_out(double now) const;
+        void disconnect();
+
+        double get_resend_time() const;
+        uint get_unconfirmed_reliable_count() const;
+
+    private:
+        void update_received_acks(u16 packet_ack, bool* out_is_duplicate, bool* out_is_too_old);
+        void confirm_packet(u16 packet_ack, double now);
+        void confirm_reliable(u16 reliable_id);
+        void update_oldest_unconfirmed_reliable_id();
+
+        bool is_reliable_received(u16 reliable_id) const;
+        void mark_reliable_received(u16 reliable_id);
+
+        void process_in_order(NetMessage* msg);
+
+        bool can_send_new_reliable() const;
+        bool write_reliables(NetPacket* packet, udp_packet_tracker_t* tracker, bool in_order, double now);
+        bool write_reliable(NetPacket* packet, udp_packet_tracker_t* tracker, NetMessage* msg, bool in_order, double now);
+};
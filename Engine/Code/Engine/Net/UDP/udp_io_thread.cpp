@@ -0,0 +1,336 @@
+#include "Engine/Net/UDP/udp_io_thread.hpp"
+#include "Engine/Net/UDP/udp_socket.hpp"
+#include "Engine/Net/UDP/udp_loopback_socket.hpp"
+#include "Engine/Net/net_address.hpp"
+#include "Engine/Thread/atomic.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <string.h>
+
+UDPIOThread::UDPIOThread(UDPSocket* socket)
+    :m_socket(socket)
+    ,m_thread(nullptr)
+    ,m_is_running(0)
+    ,m_pool(nullptr)
+    ,m_batch_count(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    // the whole pool starts out given back, the io thread picks them up as it goes
+    m_pool = new NetPacket[UDP_IO_PACKET_POOL_SIZE];
+    for(uint packet_idx = 0; packet_idx < UDP_IO_PACKET_POOL_SIZE; ++packet_idx){
+        m_released.push(&m_pool[packet_idx]);
+    }
+}
+
+UDPIOThread::~UDPIOThread()
+{
+    stop();
+    delete[] m_pool;
+    m_pool = nullptr;
+}
+
+void UDPIOThread::start()
+{
+    if(nullptr != m_thread){
+        return;
+    }
+
+    atomic_store_release(&m_is_running, 1);
+    m_thread = thread_create(io_thread_main, this);
+}
+
+void UDPIOThread::stop()
+{
+    if(nullptr == m_thread){
+        return;
+    }
+
+    // seen the next time the wait on the socket times out
+    atomic_store_release(&m_is_running, 0);
+    thread_join(m_thread);
+    m_thread = nullptr;
+}
+
+bool UDPIOThread::is_running() const
+{
+    return (nullptr != m_thread);
+}
+
+bool UDPIOThread::receive(NetPacket** out_packet)
+{
+    return m_received.pop(out_packet);
+}
+
+void UDPIOThread::release(NetPacket* packet)
+{
+    // can't be full, there are only as many packets as it has room for
+    bool pushed = m_released.push(packet);
+    ASSERT_OR_DIE(pushed, "Released a packet that didn't come from this thread");
+}
+
+udp_io_stats_t UDPIOThread::get_stats() const
+{
+    udp_io_stats_t stats;
+    stats.wakeups = atomic_load_acquire(&m_stats.wakeups);
+    stats.batches = atomic_load_acquire(&m_stats.batches);
+    stats.packets_received = atomic_load_acquire(&m_stats.packets_received);
+    stats.pool_exhausted = atomic_load_acquire(&m_stats.pool_exhausted);
+    return stats;
+}
+
+void UDPIOThread::io_thread_main(UDPIOThread* io_thread)
+{
+    thread_set_name("Net IO");
+    io_thread->run();
+}
+
+void UDPIOThread::run()
+{
+    while(0 != atomic_load_acquire(&m_is_running)){
+        take_released_packets();
+        if(0 == m_batch_count){
+            // everything is handed out, give whoever has them a chance to catch up
+            atomic_add(&m_stats.pool_exhausted, 1);
+            thread_sleep(1);
+            continue;
+        }
+
+        if(m_socket->wait_for_readable(UDP_IO_WAIT_MS)){
+            atomic_add(&m_stats.wakeups, 1);
+            read_socket();
+        }
+    }
+}
+
+void UDPIOThread::read_socket()
+{
+    while(m_batch_count > 0){
+        uint wanted = m_batch_count;
+        uint received = m_socket->receive_batch(m_batch, wanted);
+        if(0 == received){
+            return;
+        }
+
+        atomic_add(&m_stats.batches, 1);
+        atomic_add(&m_stats.packets_received, received);
+
+        for(uint packet_idx = 0; packet_idx < received; ++packet_idx){
+            m_received.push(m_batch[packet_idx]);
+        }
+
+        // what wasn't filled moves up for the next read
+        m_batch_count -= received;
+        memmove(m_batch, m_batch + received, m_batch_count * sizeof(NetPacket*));
+
+        // it stopped short, the socket is empty
+        if(received < wanted){
+            return;
+        }
+
+        take_released_packets();
+        if(0 == m_batch_count){
+            atomic_add(&m_stats.pool_exhausted, 1);
+        }
+    }
+}
+
+void UDPIOThread::take_released_packets()
+{
+    while(m_batch_count < UDP_IO_BATCH_SIZE){
+        NetPacket* packet;
+        if(!m_released.pop(&packet)){
+            break;
+        }
+
+        m_batch[m_batch_count] = packet;
+        m_batch_count++;
+    }
+}
+
+//------------------------------------------------------------------------
+// Packets per second over localhost, the io thread against reading the socket
+// on the thread that sends
+//------------------------------------------------------------------------
+#define UDP_IO_BENCH_PORT (NET_DEFAULT_PORT + 100)
+#define UDP_IO_BENCH_MAX_PORT_ATTEMPTS 16
+
+// sends between each time the receiving end is emptied
+#define UDP_IO_BENCH_BURST 32
+
+// the sender waits with this many unreceived, so it's the receiving that's
+// measured and not how fast the os buffer overflows
+#define UDP_IO_BENCH_WINDOW 256
+
+// after the last send, how long to wait for stragglers
+#define UDP_IO_BENCH_DRAIN_SECONDS (0.25)
+
+struct udp_io_bench_result_t
+{
+    uint sent;
+    uint received;
+    double seconds;
+
+    bool used_io_thread;
+    udp_io_stats_t io_stats;
+};
+
+static bool bind_bench_socket(UDPSocket* socket, uint16_t* port)
+{
+    for(uint attempt = 0; attempt < UDP_IO_BENCH_MAX_PORT_ATTEMPTS; ++attempt){
+        if(socket->bind(*port)){
+            return true;
+        }
+        (*port)++;
+    }
+
+    return false;
+}
+
+static uint drain_bench_receiver(UDPSocket* receiver, UDPIOThread* io_thread, NetPacket* direct_packet)
+{
+    uint received = 0;
+
+    if(nullptr != io_thread){
+        NetPacket* packet;
+        while(io_thread->receive(&packet)){
+            io_thread->release(packet);
+            received++;
+        }
+    }else{
+        while(receiver->receive(direct_packet)){
+            received++;
+        }
+    }
+
+    return received;
+}
+
+static bool run_udp_io_bench(uint packet_count, uint payload_size, bool use_io_thread, udp_io_bench_result_t* out_result)
+{
+    memset(out_result, 0, sizeof(*out_result));
+
+    UDPSocket receiver;
+    UDPSocket sender;
+    uint16_t port = UDP_IO_BENCH_PORT;
+    if(!bind_bench_socket(&receiver, &port)){
+        return false;
+    }
+    port++;
+    if(!bind_bench_socket(&sender, &port)){
+        return false;
+    }
+
+    net_address_t dest;
+    dest.address = LOOPBACK_ADDRESS;
+    dest.port = receiver.m_address.port;
+
+    UDPIOThread* io_thread = nullptr;
+    if(use_io_thread){
+        io_thread = new UDPIOThread(&receiver);
+        io_thread->start();
+    }
+
+    // big enough for anything, only the first payload_size bytes are sent
+    NetPacket* payload = new NetPacket();
+    memset(payload->m_payload, 0xA5, PACKET_MTU);
+    NetPacket* direct_packet = new NetPacket();
+
+    double start_time = get_current_time_seconds();
+    double last_arrival_time = start_time;
+    bool is_stalled = false;
+    for(uint send_idx = 0; (send_idx < packet_count) && !is_stalled; ++send_idx){
+        if(payload_size == sender.send(dest, payload->m_payload, payload_size)){
+            out_result->sent++;
+        }
+
+        if(0 != ((send_idx + 1) % UDP_IO_BENCH_BURST)){
+            continue;
+        }
+
+        // packets that were lost never come in, so give up on them after a while
+        do{
+            uint received = drain_bench_receiver(&receiver, io_thread, direct_packet);
+            double now = get_current_time_seconds();
+            if(received > 0){
+                out_result->received += received;
+                last_arrival_time = now;
+            }else if((now - last_arrival_time) > UDP_IO_BENCH_DRAIN_SECONDS){
+                is_stalled = true;
+            }else{
+                thread_yield();
+            }
+        }while(!is_stalled && ((out_result->sent - out_result->received) >= UDP_IO_BENCH_WINDOW));
+    }
+
+    while(out_result->received < out_result->sent){
+        uint received = drain_bench_receiver(&receiver, io_thread, direct_packet);
+        double now = get_current_time_seconds();
+        if(received > 0){
+            out_result->received += received;
+            last_arrival_time = now;
+        }else if((now - last_arrival_time) > UDP_IO_BENCH_DRAIN_SECONDS){
+            break;
+        }else{
+            thread_yield();
+        }
+    }
+    out_result->seconds = last_arrival_time - start_time;
+
+    if(nullptr != io_thread){
+        out_result->used_io_thread = true;
+        out_result->io_stats = io_thread->get_stats();
+    }
+
+    SAFE_DELETE(io_thread);
+    SAFE_DELETE(payload);
+    SAFE_DELETE(direct_packet);
+    return true;
+}
+
+static void print_udp_io_bench_result(const char* name, const udp_io_bench_result_t& result, uint payload_size)
+{
+    double seconds = Max(result.seconds, 0.000001);
+    double packets_per_second = (double)result.received / seconds;
+    double lost_percent = (result.sent > 0) ? (100.0 * (double)(result.sent - result.received) / (double)result.sent) : 0.0;
+
+    console_info("%-10s  %u/%u received (%.1f%% lost) in %.3f s, %.0f packets/s, %.1f MB/s",
+        name,
+        result.received,
+        result.sent,
+        lost_percent,
+        result.seconds,
+        packets_per_second,
+        (packets_per_second * payload_size) / (1024.0 * 1024.0));
+
+    if(result.used_io_thread){
+        const udp_io_stats_t& stats = result.io_stats;
+        console_info("            %u wakeups, %.1f packets per read, pool ran dry %u times",
+            stats.wakeups,
+            (stats.batches > 0) ? ((double)stats.packets_received / (double)stats.batches) : 0.0,
+            stats.pool_exhausted);
+    }
+}
+
+COMMAND(net_udp_io_bench, "[uint:packets] [uint:payload_bytes] Sends packets to ourselves over localhost, read by the io thread and then straight off the socket")
+{
+    uint packet_count = args.is_at_end() ? 100000 : args.next_uint_arg();
+    uint payload_size = args.is_at_end() ? 64 : args.next_uint_arg();
+    payload_size = Min(Max(payload_size, 1U), (uint)PACKET_MTU);
+
+    console_info("----UDP receive, %u packets of %u bytes over localhost----", packet_count, payload_size);
+
+    udp_io_bench_result_t threaded;
+    udp_io_bench_result_t direct;
+    if(!run_udp_io_bench(packet_count, payload_size, true, &threaded) || !run_udp_io_bench(packet_count, payload_size, false, &direct)){
+        console_error("Couldn't bind the benchmark sockets near port %u", UDP_IO_BENCH_PORT);
+        return;
+    }
+
+    print_udp_io_bench_result("io thread", threaded, payload_size);
+    print_udp_io_bench_result("direct", direct, payload_size);
+}
\ No newline at end of file
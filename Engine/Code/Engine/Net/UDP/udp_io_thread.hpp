@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Engine/Net/net_packet.hpp"
+#include "Engine/Thread/thread.h"
+#include "Engine/Thread/spsc_queue.h"
+#include "Engine/Core/types.h"
+
+class UDPSocket;
+
+// every packet the thread can have received and not had back yet, a power of two
+#define UDP_IO_PACKET_POOL_SIZE 1024
+
+// most packets read in one go before looking for ones that were given back
+#define UDP_IO_BATCH_SIZE 64
+
+// how long the thread waits on the socket before checking if it should stop
+#define UDP_IO_WAIT_MS 5
+
+struct udp_io_stats_t
+{
+    uint wakeups;
+    uint batches;
+    uint packets_received;
+
+    // times the pool ran dry with the socket still being read, packets pile
+    // up in the os buffer (and get dropped by it) until some are given back
+    uint pool_exhausted;
+};
+
+// Reads a socket on its own thread, so packets are taken off the os buffer as they
+// arrive instead of once a frame. They come out of a fixed pool and are handed over
+// through a lock free queue. One other thread receives them and has to release
+// each one once it's done with it.
+//
+// Nothing else may read the socket while this runs, sending from elsewhere is fine.
+class UDPIOThread
+{
+    public:
+        UDPIOThread(UDPSocket* socket);
+        ~UDPIOThread();
+
+        void start();
+        void stop();
+        bool is_running() const;
+
+        // oldest first, false when nothing's waiting
+        bool receive(NetPacket** out_packet);
+        void release(NetPacket* packet);
+
+        // counted by the io thread as it goes, safe to read from anywhere
+        udp_io_stats_t get_stats() const;
+
+    private:
+        static void io_thread_main(UDPIOThread* io_thread);
+
+        void run();
+        void read_socket();
+        void take_released_packets();
+
+    private:
+        UDPSocket* m_socket;
+        thread_handle_t m_thread;
+        unsigned int volatile m_is_running;
+
+        NetPacket* m_pool;
+        SPSCQueue<NetPacket*, UDP_IO_PACKET_POOL_SIZE> m_received;
+        SPSCQueue<NetPacket*, UDP_IO_PACKET_POOL_SIZE> m_released;
+
+        // free packets the io thread is holding on to for the next read
+        NetPacket* m_batch[UDP_IO_BATCH_SIZE];
+        uint m_batch_count;
+
+        udp_io_stats_t m_stats;
+};
\ No newline at end of file
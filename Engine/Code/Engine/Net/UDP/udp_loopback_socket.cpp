@@ -0,0 +1,68 @@
+#include "Engine/Net/UDP/udp_loopback_socket.hpp"
+
+#include <map>
+#include <string.h>
+
+static std::map<uint16_t, UDPLoopBackSocket*> g_loopback_sockets;
+
+UDPLoopBackSocket::UDPLoopBackSocket()
+    :UDPSocket()
+{
+}
+
+UDPLoopBackSocket::~UDPLoopBackSocket()
+{
+    std::map<uint16_t, UDPLoopBackSocket*>::iterator found = g_loopback_sockets.find(m_address.port);
+    if((g_loopback_sockets.end() != found) && (this == found->second)){
+        g_loopback_sockets.erase(found);
+    }
+}
+
+bool UDPLoopBackSocket::bind(uint16_t port)
+{
+    if((0 == port) || (g_loopback_sockets.end() != g_loopback_sockets.find(port))){
+        return false;
+    }
+
+    m_address.address = LOOPBACK_ADDRESS;
+    m_address.port = port;
+    g_loopback_sockets[port] = this;
+    return true;
+}
+
+unsigned int UDPLoopBackSocket::send(const net_address_t& addr, const void* payload, unsigned int payload_size_bytes)
+{
+    std::map<uint16_t, UDPLoopBackSocket*>::iterator found = g_loopback_sockets.find(addr.port);
+    if(g_loopback_sockets.end() == found){
+        // nobody listening, the datagram is gone like it would be on a real network
+        return payload_size_bytes;
+    }
+
+    datagram_t datagram;
+    datagram.sender = m_address;
+    datagram.data.assign((const byte*)payload, (const byte*)payload + payload_size_bytes);
+    found->second->m_datagrams.push(datagram);
+
+    return payload_size_bytes;
+}
+
+unsigned int UDPLoopBackSocket::receive(net_address_t* out_send_addr, void* payload, unsigned int max_payload_size_bytes)
+{
+    if(m_datagrams.empty()){
+        return 0U;
+    }
+
+    datagram_t& datagram = m_datagrams.front();
+
+    // like recvfrom, what doesn't fit is cut off
+    unsigned int size = (unsigned int)datagram.data.size();
+    if(size > max_payload_size_bytes){
+        size = max_payload_size_bytes;
+    }
+
+    memcpy(payload, datagram.data.data(), size);
+    *out_send_addr = datagram.sender;
+    m_datagrams.pop();
+
+    return size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Engine/Net/UDP/udp_socket.hpp"
+#include "Engine/Core/types.h"
+
+#include <queue>
+#include <vector>
+
+// 127.0.0.1
+#define LOOPBACK_ADDRESS 0x7F000001
+
+// Stands in for a socket without touching the os, so sessions can talk to each
+// other inside one process. Sends are queued on the loopback socket bound to the
+// destination port (the address is ignored) and received in the order they were
+// sent. Main thread only.
+class UDPLoopBackSocket : public UDPSocket
+{
+    public:
+        struct datagram_t
+        {
+            net_address_t sender;
+            std::vector<byte> data;
+        };
+
+        std::queue<datagram_t> m_datagrams;
+
+    public:
+        UDPLoopBackSocket();
+        virtual ~UDPLoopBackSocket();
+
+        virtual bool bind(uint16_t port) override;
+
+        virtual unsigned int send(const net_address_t& addr, const void* payload, unsigned int payload_size_bytes) override;
+        virtual unsigned int receive(net_address_t* out_send_addr, void* payload, unsigned int max_payload_size_bytes) override;
+};
@@ -1,50 +1,197 @@
 #include "Engine/Net/UDP/udp_session.hpp"
 #include "Engine/Net/UDP/udp_socket.hpp"
+#include "Engine/Net/UDP/udp_io_thread.hpp"
+#include "Engine/Net/UDP/udp_loopback_socket.hpp"
+#include "Engine/Net/UDP/udp_connection.hpp"
+#include "Engine/Net/Object/net_object_system.hpp"
+#include "Engine/Net/loopback_connection.hpp"
 #include "Engine/Net/net_address.hpp"
 #include "Engine/Net/net_packet.hpp"
 #include "Engine/Net/message.hpp"
 #include "Engine/Net/message_definition.hpp"
+#include "Engine/Net/message_pool.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <float.h>
 
 #define MAX_ADDRESS_ATTEMPTS 8
 
-UDPSession::UDPSession()
-    :m_socket(nullptr)
+UDPSession::UDPSession(unsigned int max_num_connections)
+    :NetSession(max_num_connections)
+    ,m_socket(nullptr)
+    ,m_is_listening(false)
+    ,m_io_thread(nullptr)
+    ,m_use_io_thread(true)
+    ,m_address_attempts(MAX_ADDRESS_ATTEMPTS)
+    ,m_time(0.0)
+    ,m_join_start_time(0.0)
+    ,m_next_join_request_time(0.0)
 {
+    register_message(NETMSG_JOIN_REQUEST, this, &UDPSession::on_join_request);
+    register_message(NETMSG_JOIN_RESPONSE, this, &UDPSession::on_join_response);
+    register_message(NETMSG_JOIN_DENY, this, &UDPSession::on_join_deny);
+    register_message(NETMSG_LEAVE, this, &UDPSession::on_leave);
+
+    // these come from addresses that don't have a connection (yet, or any more)
+    uint8_t connectionless_msgs[] = { NETMSG_JOIN_REQUEST, NETMSG_JOIN_DENY, NETMSG_LEAVE };
+    for(uint8_t msg_id : connectionless_msgs){
+        NetMessageDefinition* def = get_message_definition(msg_id);
+        def->set_is_connectionless(true);
+        def->set_is_reliable(false);
+        def->set_is_in_order(false);
+    }
 }
 
 UDPSession::~UDPSession()
 {
+    leave();
+    release_held_packets();
+    SAFE_DELETE(m_io_thread);
     SAFE_DELETE(m_socket);
+
+    for(NetPacket* packet : m_free_packets){
+        delete packet;
+    }
+    m_free_packets.clear();
 }
 
 bool UDPSession::host(uint16_t port)
 {
-    UNUSED(port);
-    return false;
+    ASSERT_RECOVERABLE(!is_running(), "Session is already running");
+
+    if(!start(port)){
+        log_printf("Failed to host a session near port %u", port);
+        return false;
+    }
+
+    m_time = get_current_time_seconds();
+
+    m_my_connection = new LoopBackConnection();
+    m_my_connection->m_address = m_socket->m_address;
+    m_my_connection->m_owner = this;
+
+    // bound to every interface, report one somebody else could reach
+    if(0 == m_my_connection->m_address.address){
+        m_my_connection->m_address = get_my_address(m_socket->m_address.port);
+    }
+
+    join_connection(0, m_my_connection);
+    m_host_connection = m_my_connection;
+
+    set_state(SESSION_READY);
+
+    log_printf("Hosting session at address %s", net_address_to_string(m_host_connection->m_address).c_str());
+
+    return true;
 }
 
 bool UDPSession::join(const net_address_t& address)
 {
-    UNUSED(address);
-    return false;
+    ASSERT_RECOVERABLE(!is_running(), "Session is already running");
+
+    log_printf("Joining session at address %s", net_address_to_string(address).c_str());
+
+    if(!start(NET_DEFAULT_PORT)){
+        log_printf("Failed to join session at address %s, no port to send from", net_address_to_string(address).c_str());
+        return false;
+    }
+
+    m_time = get_current_time_seconds();
+
+    // the host is always 0, ours isn't known until it answers
+    UDPConnection* host = create_connection(address, m_time);
+    join_connection(0, host);
+    m_host_connection = host;
+
+    m_my_connection = new LoopBackConnection();
+    m_my_connection->m_address = m_socket->m_address;
+    m_my_connection->m_owner = this;
+    if(0 == m_my_connection->m_address.address){
+        m_my_connection->m_address = get_my_address(m_socket->m_address.port);
+    }
+
+    m_join_start_time = m_time;
+    m_next_join_request_time = m_time;
+
+    set_state(SESSION_JOINING);
+    return true;
 }
 
 void UDPSession::leave()
 {
+    if(m_host_connection != nullptr){
+        log_printf("Leaving session at address %s", net_address_to_string(m_host_connection->m_address).c_str());
+    }
+
+    // say goodbye so nobody waits out the timeout, it isn't resent
+    if(nullptr != m_socket){
+        NetMessage goodbye(NETMSG_LEAVE);
+        for(unsigned int i = 0; i < m_connections.size(); ++i){
+            NetConnection* conn = m_connections[i];
+            if((nullptr != conn) && (conn != m_my_connection)){
+                send_direct(conn->m_address, &goodbye);
+            }
+        }
+
+        // the socket is going, whatever is still on the link goes out now
+        send_link_packets(DBL_MAX);
+    }
+    m_link.clear();
+
+    destroy_connection(m_my_connection);
+    destroy_connection(m_host_connection);
+
+    for(unsigned int i = 0; i < m_connections.size(); ++i) {
+        destroy_connection(m_connections[i]);
+    }
+    m_connections.clear();
+
+    stop_listening();
+
+    // the port is given back, hosting or joining again binds a new one. The io
+    // thread has to stop reading it first, but stays around until the next start
+    // since this tick's messages can still be reading its packets
+    if(nullptr != m_io_thread){
+        m_io_thread->stop();
+    }
+    SAFE_DELETE(m_socket);
+
+    set_state(SESSION_DISCONNECTED);
 }
 
 void UDPSession::update()
 {
-    // handle incoming messages appropriately
-    NetPacket packet;
+    tick(get_current_time_seconds());
+}
 
-    while(m_socket->receive(&packet)){
-        NetMessage msg;
-        while(packet.read(&msg)){
-            process_message(&msg);
-        }
+void UDPSession::tick(double now)
+{
+    m_time = now;
+
+    if(nullptr == m_socket){
+        return;
     }
+
+    send_link_packets(now);
+
+    receive_packets(now);
+    process_ready_messages();
+    release_held_packets();
+
+    update_join(now);
+    handle_disconnections(now);
+
+    // leaving in there takes the socket with it
+    if(nullptr == m_socket){
+        return;
+    }
+
+    flush_connections();
+    send_link_packets(now);
 }
 
 void UDPSession::process_message(NetMessage* msg)
@@ -53,29 +200,34 @@ void UDPSession::process_message(NetMessage* msg)
         return;
     }
 
+    // anyone can send us anything, an id we don't know is dropped rather than trusted
     NetMessageDefinition* def = get_message_definition(msg->m_message_type_id);
-    ASSERT_OR_DIE(nullptr != def, Stringf("Could not find a definition for message id %i", msg->m_message_type_id));
+    if(nullptr == def){
+        log_warningf("Dropped message with unknown id %i from %s", msg->m_message_type_id, net_address_to_string(msg->m_udp_sender).c_str());
+        return;
+    }
 
     def->handle(msg);
 }
 
 bool UDPSession::start_listening()
 {
-    return false;
+    if(!is_host()){
+        return false;
+    }
+
+    m_is_listening = true;
+    return true;
 }
 
 void UDPSession::stop_listening()
 {
+    m_is_listening = false;
 }
 
 bool UDPSession::is_listening()
 {
-    return false;
-}
-
-void UDPSession::set_state(SessionState new_state)
-{
-    UNUSED(new_state);
+    return m_is_listening;
 }
 
 bool UDPSession::start(uint16_t port)
@@ -84,12 +236,21 @@ bool UDPSession::start(uint16_t port)
         return false;
     }
 
-    UDPSocket* socket = new UDPSocket();
+    UDPSocket* socket = create_socket();
 
-    unsigned int attempts_left = MAX_ADDRESS_ATTEMPTS;
+    unsigned int attempts_left = m_address_attempts;
     while(attempts_left > 0){
         if(socket->bind(port)){
             m_socket = socket;
+
+            // left stopped by the last leave
+            release_held_packets();
+            SAFE_DELETE(m_io_thread);
+
+            if(m_use_io_thread){
+                m_io_thread = new UDPIOThread(m_socket);
+                m_io_thread->start();
+            }
             return true;
         }else{
             attempts_left--;
@@ -105,6 +266,706 @@ void UDPSession::send_direct(const net_address_t& dest_addr, NetMessage* msg)
 {
     // build a netpacket and send directly to address using socket
     NetPacket packet;
+    packet.get_packet_header()->from_conn_idx = get_my_connection_index();
     packet.write(msg);
-    m_socket->send(dest_addr, packet.m_payload, packet.m_payload_bytes_used);
-}
\ No newline at end of file
+    send_packet(dest_addr, &packet);
+}
+
+bool UDPSession::send_packet(const net_address_t& dest_addr, NetPacket* packet)
+{
+    if(m_link.is_enabled()){
+        return m_link.send(dest_addr, packet->m_payload, packet->m_payload_bytes_used, m_time);
+    }
+
+    m_socket->send(dest_addr, packet->m_payload, packet->m_payload_bytes_used);
+    return true;
+}
+
+void UDPSession::send_link_packets(double now)
+{
+    net_link_datagram_t* datagram;
+    while(nullptr != (datagram = m_link.receive(now))){
+        m_socket->send(datagram->dest, datagram->data, datagram->size);
+        m_link.release(datagram);
+    }
+}
+
+UDPConnection* UDPSession::find_connection(const net_address_t& address, uint8_t conn_idx_hint)
+{
+    // the index a packet claims to be from is only a hint, the address has to match
+    if(conn_idx_hint < m_connections.size()){
+        NetConnection* conn = m_connections[conn_idx_hint];
+        if((nullptr != conn) && (conn != m_my_connection) && (conn->m_address == address)){
+            return (UDPConnection*)conn;
+        }
+    }
+
+    for(unsigned int i = 0; i < m_connections.size(); ++i){
+        NetConnection* conn = m_connections[i];
+        if((nullptr != conn) && (conn != m_my_connection) && (conn->m_address == address)){
+            return (UDPConnection*)conn;
+        }
+    }
+
+    return nullptr;
+}
+
+uint8_t UDPSession::get_my_connection_index() const
+{
+    return (nullptr != m_my_connection) ? m_my_connection->m_connection_index : (uint8_t)INVALID_CONNECTION_INDEX;
+}
+
+void UDPSession::on_join_request(NetMessage* msg)
+{
+    if(!is_host() || !is_listening()){
+        return;
+    }
+
+    // a resend, the first one was already answered reliably
+    net_address_t address = msg->m_udp_sender;
+    if(nullptr != find_connection(address)){
+        return;
+    }
+
+    uint8_t conn_idx = get_free_connection_index();
+    if(INVALID_CONNECTION_INDEX == conn_idx){
+        NetMessage deny(NETMSG_JOIN_DENY);
+        send_direct(address, &deny);
+        return;
+    }
+
+    UDPConnection* new_guy = create_connection(address, m_time);
+    join_connection(conn_idx, new_guy);
+
+    log_printf("New connection [%i] from [%s]", conn_idx, net_address_to_string(address).c_str());
+
+    NetMessage* response = new NetMessage(NETMSG_JOIN_RESPONSE);
+    response->write<uint8_t>(conn_idx);
+    new_guy->send(response);
+
+    m_connection_joined_event->trigger(new_guy);
+}
+
+void UDPSession::on_join_response(NetMessage* msg)
+{
+    if((SESSION_JOINING != m_state) || (msg->m_sender != m_host_connection)){
+        return;
+    }
+
+    uint8_t my_conn_index;
+    if(!msg->read(my_conn_index)){
+        return;
+    }
+
+    // the host is 0, and nothing else is known to us yet
+    if((0 == my_conn_index) || (INVALID_CONNECTION_INDEX == my_conn_index) || (nullptr != get_connection(my_conn_index))){
+        return;
+    }
+
+    join_connection(my_conn_index, m_my_connection);
+    set_state(SESSION_READY);
+
+    log_printf("Joined session at address %s as connection [%i]", net_address_to_string(m_host_connection->m_address).c_str(), my_conn_index);
+}
+
+void UDPSession::on_join_deny(NetMessage* msg)
+{
+    if((SESSION_JOINING != m_state) || (nullptr == m_host_connection) || (msg->m_udp_sender != m_host_connection->m_address)){
+        return;
+    }
+
+    log_printf("Join denied by %s, the session is full", net_address_to_string(msg->m_udp_sender).c_str());
+
+    // left when disconnections are handled, not from inside a handler
+    ((UDPConnection*)m_host_connection)->disconnect();
+}
+
+void UDPSession::on_leave(NetMessage* msg)
+{
+    UDPConnection* conn = find_connection(msg->m_udp_sender);
+    if(nullptr != conn){
+        conn->disconnect();
+    }
+}
+
+UDPSocket* UDPSession::create_socket()
+{
+    return new UDPSocket();
+}
+
+void UDPSession::receive_packets(double now)
+{
+    if(nullptr != m_io_thread){
+        NetPacket* packet;
+        while(m_io_thread->receive(&packet)){
+            process_packet(packet, now);
+            m_held_packets.push_back(packet);
+        }
+        return;
+    }
+
+    while(true){
+        NetPacket* packet;
+        if(m_free_packets.empty()){
+            packet = new NetPacket();
+        }else{
+            packet = m_free_packets.back();
+            m_free_packets.pop_back();
+        }
+
+        if(!m_socket->receive(packet)){
+            m_free_packets.push_back(packet);
+            break;
+        }
+
+        process_packet(packet, now);
+        m_held_packets.push_back(packet);
+    }
+}
+
+void UDPSession::process_packet(NetPacket* packet, double now)
+{
+    if(!packet->is_valid()){
+        return;
+    }
+
+    packet_header_t* header = packet->get_packet_header();
+    UDPConnection* conn = find_connection(packet->m_sender, header->from_conn_idx);
+
+    // sent direct, or from somebody without a connection. Only connectionless
+    // messages are handled, right away since there's nothing to order them against
+    if((nullptr == conn) || (INVALID_PACKET_ACK == header->packet_ack)){
+        NetMessage msg;
+        while(packet->read(&msg)){
+            NetMessageDefinition* def = get_message_definition(msg.m_message_type_id);
+            if((nullptr != def) && def->is_connectionless()){
+                msg.m_sender = conn;
+                process_message(&msg);
+            }
+        }
+        return;
+    }
+
+    conn->m_stats.bytes_received += packet->m_payload_bytes_used;
+    if(!conn->process_packet_header(header, now)){
+        return;
+    }
+
+    NetMessage* msg = new NetMessage();
+    PacketBundle bundle;
+    while(packet->read(msg, &bundle)){
+        conn->process_message(msg, bundle);
+        msg = new NetMessage();
+    }
+    delete msg;
+}
+
+void UDPSession::process_ready_messages()
+{
+    // handlers can add connections, so the size is checked every time around
+    for(unsigned int i = 0; i < m_connections.size(); ++i){
+        NetConnection* conn = m_connections[i];
+        if(nullptr == conn){
+            continue;
+        }
+
+        NetMessage* msg;
+        while(conn->receive(&msg)){
+            process_message(msg);
+            delete msg;
+        }
+    }
+}
+
+void UDPSession::release_held_packets()
+{
+    for(NetPacket* packet : m_held_packets){
+        if(nullptr != m_io_thread){
+            m_io_thread->release(packet);
+        }else{
+            m_free_packets.push_back(packet);
+        }
+    }
+    m_held_packets.clear();
+}
+
+void UDPSession::update_join(double now)
+{
+    if(SESSION_JOINING != m_state){
+        return;
+    }
+
+    UDPConnection* host = (UDPConnection*)m_host_connection;
+    if(nullptr == host){
+        return;
+    }
+
+    if((now - m_join_start_time) >= JOIN_TIMEOUT_SECONDS){
+        log_printf("Failed to join session at address %s, no answer", net_address_to_string(host->m_address).c_str());
+        host->disconnect();
+        return;
+    }
+
+    if(now >= m_next_join_request_time){
+        NetMessage request(NETMSG_JOIN_REQUEST);
+        send_direct(host->m_address, &request);
+        m_next_join_request_time = now + JOIN_REQUEST_RESEND_SECONDS;
+    }
+}
+
+void UDPSession::handle_disconnections(double now)
+{
+    for(unsigned int i = 0; i < m_connections.size(); ++i){
+        NetConnection* conn = m_connections[i];
+        if((nullptr == conn) || (conn == m_my_connection)){
+            continue;
+        }
+
+        UDPConnection* udp_connection = (UDPConnection*)conn;
+        if(udp_connection->is_timed_out(now)){
+            udp_connection->disconnect();
+        }
+
+        if(udp_connection->is_disconnected()){
+            log_printf("%s disconnected", net_address_to_string(udp_connection->m_address).c_str());
+            if(udp_connection != m_host_connection){
+                m_connection_left_event->trigger(udp_connection);
+            }
+            destroy_connection(udp_connection);
+        }
+    }
+
+    // leave if there is no longer a host
+    if(is_running() && (nullptr == m_host_connection)){
+        leave();
+        m_host_left_event->trigger();
+    }
+}
+
+UDPConnection* UDPSession::create_connection(const net_address_t& address, double now)
+{
+    UDPConnection* conn = new UDPConnection();
+    conn->m_address = address;
+    conn->m_owner = this;
+    conn->m_last_received_time = now;
+
+    // the first packet goes out right away rather than a heartbeat later
+    conn->m_last_sent_time = now - DEFAULT_HEARTBEAT_SECONDS;
+
+    return conn;
+}
+
+UDPLoopBackSession::UDPLoopBackSession(unsigned int max_num_connections)
+    :UDPSession(max_num_connections)
+{
+    m_use_io_thread = false;
+    m_address_attempts = LOOPBACK_SESSION_ADDRESS_ATTEMPTS;
+}
+
+UDPSocket* UDPLoopBackSession::create_socket()
+{
+    return new UDPLoopBackSocket();
+}
+
+//------------------------------------------------------------------------
+// Loopback test, two sessions in this process with packets dropped at random
+//------------------------------------------------------------------------
+#define LOOPBACK_TEST_TICK_SECONDS (1.0 / 60.0)
+#define LOOPBACK_TEST_MAX_SECONDS (120.0)
+#define LOOPBACK_TEST_MSGS_PER_TICK 8
+
+// IP and UDP headers, what every datagram costs on top of its payload
+#define UDP_IP_HEADER_SIZE 28
+
+enum LoopBackTestMessages : uint8_t
+{
+    NETMSG_TEST_IN_ORDER = NUM_CORE_NET_MESSAGES,
+    NETMSG_TEST_RELIABLE,
+    NETMSG_TEST_UNRELIABLE
+};
+
+struct udp_loopback_test_t
+{
+    u32 next_in_order;
+    uint in_order_received;
+    uint in_order_errors;
+
+    std::vector<uint> reliable_counts;
+    uint unreliable_received;
+};
+
+static udp_loopback_test_t g_loopback_test;
+
+static void on_test_in_order(NetMessage* msg)
+{
+    u32 index;
+    msg->read(index);
+
+    if(index != g_loopback_test.next_in_order){
+        g_loopback_test.in_order_errors++;
+    }
+    g_loopback_test.next_in_order = index + 1;
+    g_loopback_test.in_order_received++;
+}
+
+static void on_test_reliable(NetMessage* msg)
+{
+    u32 index;
+    msg->read(index);
+
+    if(index < g_loopback_test.reliable_counts.size()){
+        g_loopback_test.reliable_counts[index]++;
+    }
+}
+
+static void on_test_unreliable(NetMessage* msg)
+{
+    UNUSED(msg);
+    g_loopback_test.unreliable_received++;
+}
+
+static void register_loopback_test_messages(UDPSession* session, float loss)
+{
+    session->register_message(NETMSG_TEST_IN_ORDER, on_test_in_order);
+    session->register_message(NETMSG_TEST_RELIABLE, on_test_reliable);
+    session->register_message(NETMSG_TEST_UNRELIABLE, on_test_unreliable);
+
+    session->get_message_definition(NETMSG_TEST_RELIABLE)->set_is_in_order(false);
+    session->get_message_definition(NETMSG_TEST_UNRELIABLE)->set_is_reliable(false);
+    session->get_message_definition(NETMSG_TEST_UNRELIABLE)->set_is_in_order(false);
+
+    session->m_link.m_conditions.loss = loss;
+}
+
+COMMAND(net_udp_loopback_test, "[float:loss] [uint:messages] Sends messages on every channel between two UDP sessions in this process, dropping packets at random")
+{
+    float loss = args.is_at_end() ? 0.25f : args.next_float_arg();
+    uint message_count = args.is_at_end() ? 1000 : args.next_uint_arg();
+
+    g_loopback_test.next_in_order = 0;
+    g_loopback_test.in_order_received = 0;
+    g_loopback_test.in_order_errors = 0;
+    g_loopback_test.reliable_counts.assign(message_count, 0);
+    g_loopback_test.unreliable_received = 0;
+
+    UDPLoopBackSession host;
+    UDPLoopBackSession client;
+    register_loopback_test_messages(&host, loss);
+    register_loopback_test_messages(&client, loss);
+
+    if(!host.host(NET_DEFAULT_PORT) || !host.start_listening() || !client.join(host.m_my_connection->m_address)){
+        console_error("Failed to start the loopback sessions");
+        return;
+    }
+
+    double start_time = get_current_time_seconds();
+    double now = start_time;
+    uint sent = 0;
+    bool is_done = false;
+
+    while(!is_done && ((now - start_time) < LOOPBACK_TEST_MAX_SECONDS)){
+        now += LOOPBACK_TEST_TICK_SECONDS;
+
+        if(client.is_ready()){
+            for(uint msg_idx = 0; (msg_idx < LOOPBACK_TEST_MSGS_PER_TICK) && (sent < message_count); ++msg_idx){
+                uint8_t msg_ids[] = { NETMSG_TEST_IN_ORDER, NETMSG_TEST_RELIABLE, NETMSG_TEST_UNRELIABLE };
+                for(uint8_t msg_id : msg_ids){
+                    NetMessage msg(msg_id);
+                    msg.write<u32>(sent);
+                    client.send_message_to_host(msg);
+                }
+                sent++;
+            }
+        }
+
+        client.tick(now);
+        host.tick(now);
+
+        UDPConnection* to_host = (UDPConnection*)client.m_host_connection;
+        is_done = (sent == message_count) && (nullptr != to_host) && (0 == to_host->get_unconfirmed_reliable_count());
+
+        if(!client.is_running()){
+            break;
+        }
+    }
+
+    uint reliable_received = 0;
+    uint reliable_duplicates = 0;
+    for(uint count : g_loopback_test.reliable_counts){
+        reliable_received += (count > 0) ? 1 : 0;
+        reliable_duplicates += (count > 1) ? (count - 1) : 0;
+    }
+
+    console_info("----UDP loopback, %.0f%% loss----", loss * 100.0f);
+    console_info("in order:   %u/%u received, %u out of order", g_loopback_test.in_order_received, sent, g_loopback_test.in_order_errors);
+    console_info("reliable:   %u/%u received, %u duplicates", reliable_received, sent, reliable_duplicates);
+    console_info("unreliable: %u/%u received", g_loopback_test.unreliable_received, sent);
+
+    UDPConnection* to_host = (UDPConnection*)client.m_host_connection;
+    if(nullptr != to_host){
+        const udp_connection_stats_t& stats = to_host->m_stats;
+        const net_connection_stats_t& send_stats = to_host->m_send_stats;
+        uint msgs_sent = sent * 3;
+        double wire_bytes = (double)send_stats.bytes_sent + ((double)send_stats.packets_sent * UDP_IP_HEADER_SIZE);
+
+        console_info("packets:    %u sent, %u acked, %u lost, %u reliables resent", send_stats.packets_sent, stats.packets_acked, stats.packets_lost, stats.reliables_resent);
+        console_info("batching:   %.1f messages per packet, %u sendto calls", to_host->get_messages_per_packet(), send_stats.syscalls);
+        console_info("rtt:        %.1f ms", to_host->m_rtt * 1000.0);
+        console_info("wire bytes: %.1f per message, headers included", (msgs_sent > 0) ? (wire_bytes / (double)msgs_sent) : 0.0);
+    }
+    console_info("took %.2f s of simulated time", now - start_time);
+
+    bool passed = is_done
+        && (g_loopback_test.in_order_received == message_count)
+        && (0 == g_loopback_test.in_order_errors)
+        && (reliable_received == message_count)
+        && (0 == reliable_duplicates);
+
+    if(passed){
+        console_success("Every reliable message arrived once, in order ones in order");
+    }else{
+        console_error("Reliable delivery failed");
+    }
+}
+
+//------------------------------------------------------------------------
+// Message allocations under load, a host and a lot of loopback clients sending
+// what a game would
+//------------------------------------------------------------------------
+#define MESSAGE_LOAD_TEST_TICK_SECONDS (1.0 / 60.0)
+#define MESSAGE_LOAD_TEST_JOIN_SECONDS (5.0)
+
+// a snapshot per client per tick and an input back, reliable events now and then
+#define MESSAGE_LOAD_TEST_UPDATE_SIZE 300
+#define MESSAGE_LOAD_TEST_INPUT_SIZE 12
+#define MESSAGE_LOAD_TEST_EVENT_SIZE 48
+#define MESSAGE_LOAD_TEST_HOST_EVENT_TICKS 15
+#define MESSAGE_LOAD_TEST_CLIENT_EVENT_TICKS 60
+
+enum MessageLoadTestMessages : uint8_t
+{
+    NETMSG_LOAD_INPUT = NUM_CORE_NET_MESSAGES,
+    NETMSG_LOAD_UPDATE,
+    NETMSG_LOAD_EVENT
+};
+
+static uint g_message_load_test_received = 0;
+
+static void on_load_test_message(NetMessage* msg)
+{
+    // read it all like a handler would, views are read where they are
+    byte_t payload[MAX_PAYLOAD_SIZE];
+    msg->read_bytes(payload, msg->m_payload_bytes_used);
+    g_message_load_test_received++;
+}
+
+static void register_load_test_messages(UDPSession* session)
+{
+    session->register_message(NETMSG_LOAD_INPUT, on_load_test_message);
+    session->register_message(NETMSG_LOAD_UPDATE, on_load_test_message);
+    session->register_message(NETMSG_LOAD_EVENT, on_load_test_message);
+
+    uint8_t unreliable_msgs[] = { NETMSG_LOAD_INPUT, NETMSG_LOAD_UPDATE };
+    for(uint8_t msg_id : unreliable_msgs){
+        session->get_message_definition(msg_id)->set_is_reliable(false);
+        session->get_message_definition(msg_id)->set_is_in_order(false);
+    }
+}
+
+// written into a buffer on the stack, sending copies it into one sized to fit
+static void send_load_test_message(UDPSession* session, unsigned int conn_idx, uint8_t msg_id, uint size)
+{
+    byte_t buffer[MAX_PAYLOAD_SIZE];
+    NetMessage msg(msg_id, buffer, sizeof(buffer));
+    for(uint byte_idx = 0; byte_idx < size; ++byte_idx){
+        msg.write<uint8_t>((uint8_t)byte_idx);
+    }
+
+    if(conn_idx == INVALID_CONNECTION_INDEX){
+        session->send_message_to_host(msg);
+    }else{
+        session->send_message_to_index(conn_idx, msg);
+    }
+}
+
+static void tick_load_test(UDPSession* host, std::vector<UDPSession*>& clients, double now)
+{
+    for(UDPSession* client : clients){
+        client->tick(now);
+    }
+    host->tick(now);
+}
+
+COMMAND(net_message_pool_test, "[uint:clients] [float:seconds] Runs a host and loopback clients at 60 Hz and reports message and heap allocations per second")
+{
+    uint client_count = args.is_at_end() ? 64 : args.next_uint_arg();
+    float seconds = args.is_at_end() ? 5.0f : args.next_float_arg();
+    client_count = Min(Max(client_count, 1U), (uint)(INVALID_CONNECTION_INDEX - 1));
+
+    UDPLoopBackSession host(client_count + 1);
+    register_load_test_messages(&host);
+    if(!host.host(NET_DEFAULT_PORT) || !host.start_listening()){
+        console_error("Failed to host the load test session");
+        return;
+    }
+
+    std::vector<UDPSession*> clients;
+    for(uint client_idx = 0; client_idx < client_count; ++client_idx){
+        UDPLoopBackSession* client = new UDPLoopBackSession();
+        register_load_test_messages(client);
+        clients.push_back(client);
+
+        if(!client->join(host.m_my_connection->m_address)){
+            console_error("Failed to start load test client %u", client_idx);
+        }
+    }
+
+    // everybody joins first, which also warms up the pool
+    double now = get_current_time_seconds();
+    double join_end_time = now + MESSAGE_LOAD_TEST_JOIN_SECONDS;
+    uint ready_count = 0;
+    while((ready_count < client_count) && (now < join_end_time)){
+        now += MESSAGE_LOAD_TEST_TICK_SECONDS;
+        tick_load_test(&host, clients, now);
+
+        ready_count = 0;
+        for(UDPSession* client : clients){
+            ready_count += client->is_ready() ? 1 : 0;
+        }
+    }
+
+    g_message_load_test_received = 0;
+    net_message_pool_reset_stats();
+
+    uint tick_count = (uint)(seconds / MESSAGE_LOAD_TEST_TICK_SECONDS);
+    double start_time = get_current_time_seconds();
+    for(uint tick_idx = 0; tick_idx < tick_count; ++tick_idx){
+        now += MESSAGE_LOAD_TEST_TICK_SECONDS;
+
+        for(UDPSession* client : clients){
+            if(client->is_ready()){
+                send_load_test_message(client, INVALID_CONNECTION_INDEX, NETMSG_LOAD_INPUT, MESSAGE_LOAD_TEST_INPUT_SIZE);
+                if(0 == (tick_idx % MESSAGE_LOAD_TEST_CLIENT_EVENT_TICKS)){
+                    send_load_test_message(client, INVALID_CONNECTION_INDEX, NETMSG_LOAD_EVENT, MESSAGE_LOAD_TEST_EVENT_SIZE);
+                }
+            }
+        }
+
+        for(unsigned int conn_idx = 0; conn_idx < host.m_connections.size(); ++conn_idx){
+            NetConnection* conn = host.m_connections[conn_idx];
+            if((nullptr == conn) || (conn == host.m_my_connection)){
+                continue;
+            }
+
+            send_load_test_message(&host, conn_idx, NETMSG_LOAD_UPDATE, MESSAGE_LOAD_TEST_UPDATE_SIZE);
+            if(0 == (tick_idx % MESSAGE_LOAD_TEST_HOST_EVENT_TICKS)){
+                send_load_test_message(&host, conn_idx, NETMSG_LOAD_EVENT, MESSAGE_LOAD_TEST_EVENT_SIZE);
+            }
+        }
+
+        tick_load_test(&host, clients, now);
+    }
+    double wall_seconds = get_current_time_seconds() - start_time;
+
+    net_message_pool_stats_t stats = net_message_pool_get_stats();
+
+    for(UDPSession* client : clients){
+        delete client;
+    }
+    clients.clear();
+
+    double game_seconds = Max((double)tick_count * MESSAGE_LOAD_TEST_TICK_SECONDS, MESSAGE_LOAD_TEST_TICK_SECONDS);
+
+    console_info("----Message pool, %u/%u clients joined, %.1f s at 60 Hz (took %.2f s)----", ready_count, client_count, game_seconds, wall_seconds);
+    console_info("messages:  %.0f/s made, %.0f/s handled", stats.messages_allocated / game_seconds, g_message_load_test_received / game_seconds);
+    for(uint size_class = 0; size_class < NUM_NET_PAYLOAD_SIZE_CLASSES; ++size_class){
+        console_info("payloads:  %.0f/s of %u bytes", stats.payloads_allocated[size_class] / game_seconds, (uint)net_message_pool_get_payload_class_size(size_class));
+    }
+    console_info("views:     %.0f/s read in place instead of copied out of the packet", stats.views / game_seconds);
+
+    // before the pool every message was its own heap allocation, with room
+    // for MAX_PAYLOAD_SIZE whatever it held
+    double before_bytes = (double)stats.messages_allocated * (double)(sizeof(NetMessage) + MAX_PAYLOAD_SIZE);
+    console_info("before:    %.0f heap allocations/s, %.1f MB/s", stats.messages_allocated / game_seconds, before_bytes / (game_seconds * 1024.0 * 1024.0));
+    console_info("after:     %.0f heap allocations/s, %.1f MB/s of payload handed out", stats.heap_allocations / game_seconds, stats.payload_bytes_allocated / (game_seconds * 1024.0 * 1024.0));
+}
+
+COMMAND(net_sim_loss, "[float:loss] Drops this fraction of the packets the net object session sends, when it's a UDP session")
+{
+    UDPSession* session = dynamic_cast<UDPSession*>(net_object_get_session());
+    if(nullptr == session){
+        console_error("No UDP session registered");
+        return;
+    }
+
+    session->m_link.m_conditions.loss = args.next_float_arg();
+    console_info("Simulated loss %.0f%%", session->m_link.m_conditions.loss * 100.0f);
+}
+
+COMMAND(net_sim_link, "[float:latency_ms] [float:jitter_ms] [float:loss] [float:duplicate] [float:reorder] [uint:bytes_per_second] Sends the net object session's packets over a pretend network, no args to turn it off")
+{
+    UDPSession* session = dynamic_cast<UDPSession*>(net_object_get_session());
+    if(nullptr == session){
+        console_error("No UDP session registered");
+        return;
+    }
+
+    net_link_conditions_t& conditions = session->m_link.m_conditions;
+    conditions.latency_ms = args.is_at_end() ? 0.0f : args.next_float_arg();
+    conditions.jitter_ms = args.is_at_end() ? 0.0f : args.next_float_arg();
+    conditions.loss = args.is_at_end() ? 0.0f : args.next_float_arg();
+    conditions.duplicate = args.is_at_end() ? 0.0f : args.next_float_arg();
+    conditions.reorder = args.is_at_end() ? 0.0f : args.next_float_arg();
+    conditions.bytes_per_second = args.is_at_end() ? 0 : args.next_uint_arg();
+
+    console_info("Simulated link %.0f +-%.0f ms, %.1f%% lost, %.1f%% duplicated, %.1f%% reordered, %u bytes per second",
+        conditions.latency_ms,
+        conditions.jitter_ms,
+        conditions.loss * 100.0f,
+        conditions.duplicate * 100.0f,
+        conditions.reorder * 100.0f,
+        conditions.bytes_per_second);
+}
+
+COMMAND(net_udp_stats, "Prints round trip times, loss and traffic for each connection of the net object session")
+{
+    UNUSED(args);
+
+    UDPSession* session = dynamic_cast<UDPSession*>(net_object_get_session());
+    if(nullptr == session){
+        console_error("No UDP session registered");
+        return;
+    }
+
+    for(unsigned int i = 0; i < session->m_connections.size(); ++i){
+        NetConnection* conn = session->m_connections[i];
+        if((nullptr == conn) || (conn == session->m_my_connection)){
+            continue;
+        }
+
+        UDPConnection* udp_connection = (UDPConnection*)conn;
+        const udp_connection_stats_t& stats = udp_connection->m_stats;
+        console_info("[%u] %s rtt %.1f ms, %u/%u packets acked, %u lost, %u resent, %u unconfirmed, %u/%u bytes sent/received",
+            i,
+            net_address_to_string(conn->m_address).c_str(),
+            udp_connection->m_rtt * 1000.0,
+            stats.packets_acked,
+            udp_connection->m_send_stats.packets_sent,
+            stats.packets_lost,
+            stats.reliables_resent,
+            udp_connection->get_unconfirmed_reliable_count(),
+            udp_connection->m_send_stats.bytes_sent,
+            stats.bytes_received);
+    }
+
+    const net_link_stats_t& link_stats = session->m_link.m_stats;
+    if(link_stats.packets_sent > 0){
+        console_info("simulated link: %u sent, %u lost, %u dropped, %u duplicated, %u reordered, %u in flight",
+            link_stats.packets_sent,
+            link_stats.packets_lost,
+            link_stats.packets_dropped,
+            link_stats.packets_duplicated,
+            link_stats.packets_reordered,
+            session->m_link.get_in_flight_count());
+    }
+}
@@ -1,17 +1,53 @@
 #pragma once
 
 #include "Engine/Net/session.hpp"
+#include "Engine/Net/net_address.hpp"
+#include "Engine/Net/net_link_sim.hpp"
 
 class UDPSocket;
+class UDPIOThread;
+class UDPConnection;
 class NetMessage;
+class NetPacket;
 
+// how often a joining client asks again, and how long before it gives up
+#define JOIN_REQUEST_RESEND_SECONDS (0.25)
+#define JOIN_TIMEOUT_SECONDS (10.0)
+
+// Sessions over one unconnected socket. The host answers join requests from
+// unknown addresses by making a connection for them, everything else has to come
+// from an address that already has one. Reliability is per connection, see
+// UDPConnection.
 class UDPSession : public NetSession
 {
     public:
         UDPSocket* m_socket;
+        bool m_is_listening;
+
+        // reads the socket off the main thread while running, the packets are
+        // handled in tick as before. Set before hosting or joining
+        UDPIOThread* m_io_thread;
+        bool m_use_io_thread;
+
+        // Received messages read the packet they came in rather than copying it,
+        // so packets are held until the tick is done with them. Without an io
+        // thread they're kept for reuse once they're let go.
+        std::vector<NetPacket*> m_held_packets;
+        std::vector<NetPacket*> m_free_packets;
+
+        // what we send goes over this first, for seeing how the game copes with a
+        // bad network. Does nothing until it's given some conditions
+        NetLinkSim m_link;
+
+        // ports tried from the one asked for when binding
+        unsigned int m_address_attempts;
+
+        double m_time;
+        double m_join_start_time;
+        double m_next_join_request_time;
 
     public:
-        UDPSession();
+        UDPSession(unsigned int max_num_connections = 8);
         virtual ~UDPSession();
 
     public:
@@ -24,10 +60,54 @@ class UDPSession : public NetSession
         virtual void stop_listening() override;
         virtual bool is_listening() override;
 
-        virtual void set_state(SessionState new_state);
-
     public:
+        // update with the time handed in, lets a test run faster than the clock
+        void tick(double now);
+
         void process_message(NetMessage* msg);
         bool start(uint16_t port);
         void send_direct(const net_address_t& dest_addr, NetMessage* msg);
-};
\ No newline at end of file
+
+        // false when the packet was dropped on purpose
+        bool send_packet(const net_address_t& dest_addr, NetPacket* packet);
+
+        // puts whatever the link has due by now on the socket
+        void send_link_packets(double now);
+
+        UDPConnection* find_connection(const net_address_t& address, uint8_t conn_idx_hint = INVALID_CONNECTION_INDEX);
+        uint8_t get_my_connection_index() const;
+
+        void on_join_request(NetMessage* msg);
+        void on_join_response(NetMessage* msg);
+        void on_join_deny(NetMessage* msg);
+        void on_leave(NetMessage* msg);
+
+    protected:
+        virtual UDPSocket* create_socket();
+
+    private:
+        void receive_packets(double now);
+        void process_packet(NetPacket* packet, double now);
+        void process_ready_messages();
+        void release_held_packets();
+        void update_join(double now);
+        void handle_disconnections(double now);
+
+        UDPConnection* create_connection(const net_address_t& address, double now);
+};
+
+// loopback sockets have every port to themselves, so there's no reason to stop at
+// a few when lots of sessions are made
+#define LOOPBACK_SESSION_ADDRESS_ATTEMPTS 1024
+
+// A session that talks over UDPLoopBackSockets, for tests that run a host and its
+// clients in one process without touching the network. The loopback socket is
+// main thread only, so there's no io thread.
+class UDPLoopBackSession : public UDPSession
+{
+    public:
+        UDPLoopBackSession(unsigned int max_num_connections = 8);
+
+    protected:
+        virtual UDPSocket* create_socket() override;
+};
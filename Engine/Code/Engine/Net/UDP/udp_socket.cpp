@@ -2,6 +2,19 @@
 #include "Engine/Net/net_address.hpp"
 #include "Engine/Net/net_packet.hpp"
 
+UDPSocket::UDPSocket()
+    :m_socket(INVALID_SOCKET)
+{
+}
+
+UDPSocket::~UDPSocket()
+{
+    if(INVALID_SOCKET != m_socket){
+        ::closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
 bool UDPSocket::bind(uint16_t port)
 {
     std::vector<net_address_t> bind_addresses = get_addresses_from_hostname("", port, true, true);
@@ -12,7 +25,7 @@ bool UDPSocket::bind(uint16_t port)
     for(unsigned int addr_idx = 0; addr_idx < bind_addresses.size(); ++addr_idx){
         net_address_t bind_addr = bind_addresses[addr_idx];
         SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if(INVALID_SOCKET != m_socket){
+        if(INVALID_SOCKET != sock){
             sockaddr_storage internal_address;
             int addr_size = 0;
             socket_address_from_net_address((sockaddr*)&internal_address, &addr_size, bind_addr);
@@ -32,7 +45,7 @@ bool UDPSocket::bind(uint16_t port)
         }
     }
 
-    return true;
+    return (INVALID_SOCKET != m_socket);
 }
 
 unsigned int UDPSocket::send(const net_address_t& addr, const void* payload, unsigned int payload_size_bytes)
@@ -93,8 +106,35 @@ bool UDPSocket::receive(NetPacket* out_packet)
     int bytes_received = receive(&out_packet->m_sender, out_packet->m_payload, PACKET_MTU); 
     if(bytes_received > 0){
         out_packet->m_payload_bytes_used = bytes_received;
+        out_packet->reset_read();
         return true;
     }else{
         return false;
     }
+}
+
+bool UDPSocket::wait_for_readable(unsigned int timeout_ms)
+{
+    if(INVALID_SOCKET == m_socket){
+        return false;
+    }
+
+    WSAPOLLFD poll_fd;
+    poll_fd.fd = m_socket;
+    poll_fd.events = POLLRDNORM;
+    poll_fd.revents = 0;
+
+    int ready_count = ::WSAPoll(&poll_fd, 1, (INT)timeout_ms);
+    return (ready_count > 0);
+}
+
+unsigned int UDPSocket::receive_batch(NetPacket** out_packets, unsigned int max_packets)
+{
+    // winsock has no recvmmsg, but one wakeup still empties the socket
+    unsigned int received_count = 0;
+    while((received_count < max_packets) && receive(out_packets[received_count])){
+        received_count++;
+    }
+
+    return received_count;
 }
\ No newline at end of file
@@ -12,10 +12,20 @@ class UDPSocket
         net_address_t m_address;
 
     public:
-        bool bind(uint16_t port);
+        UDPSocket();
+        virtual ~UDPSocket();
 
-        unsigned int send(const net_address_t& addr, const void* payload, unsigned int payload_size_bytes);
-        unsigned int receive(net_address_t* out_send_addr, void* payload, unsigned int max_payload_size_bytes);
+        virtual bool bind(uint16_t port);
+
+        virtual unsigned int send(const net_address_t& addr, const void* payload, unsigned int payload_size_bytes);
+        virtual unsigned int receive(net_address_t* out_send_addr, void* payload, unsigned int max_payload_size_bytes);
 
         bool receive(NetPacket* out_packet);
+
+        // Blocks up to timeout_ms for something to arrive, false if nothing did.
+        virtual bool wait_for_readable(unsigned int timeout_ms);
+
+        // Fills packets in order until the socket is empty or they run out, returns
+        // how many were filled.
+        virtual unsigned int receive_batch(NetPacket** out_packets, unsigned int max_packets);
 };
\ No newline at end of file
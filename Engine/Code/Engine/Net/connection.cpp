@@ -1,10 +1,28 @@
 #include "Engine/Net/connection.hpp"
+#include "Engine/Net/session.hpp"
+
+#include <string.h>
 
 NetConnection::NetConnection()
     :m_owner(nullptr)
+    ,m_connection_index(INVALID_CONNECTION_INDEX)
 {
+    memset(&m_send_stats, 0, sizeof(m_send_stats));
 }
 
 NetConnection::~NetConnection()
 {
+}
+
+void NetConnection::flush()
+{
+}
+
+float NetConnection::get_messages_per_packet() const
+{
+    if(0 == m_send_stats.packets_sent){
+        return 0.0f;
+    }
+
+    return (float)m_send_stats.messages_sent / (float)m_send_stats.packets_sent;
 }
\ No newline at end of file
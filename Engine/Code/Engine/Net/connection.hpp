@@ -5,6 +5,16 @@
 class NetMessage;
 class NetSession;
 
+// what it took to get a connection's messages out, packets are datagrams on UDP
+// and flushed buffers on TCP
+struct net_connection_stats_t
+{
+    unsigned int messages_sent;
+    unsigned int packets_sent;
+    unsigned int bytes_sent;
+    unsigned int syscalls;
+};
+
 class NetConnection
 {
     public:
@@ -12,11 +22,20 @@ class NetConnection
         net_address_t m_address;
         uint8_t m_connection_index;
 
+        net_connection_stats_t m_send_stats;
+
     public:
         NetConnection();
         virtual ~NetConnection();
 
+        // queues the message, it's owned by the connection from here
         virtual void send(NetMessage *msg) = 0;
         virtual bool receive(NetMessage **msg) = 0;
         virtual bool is_disconnected() const = 0;
+
+        // puts everything queued since the last flush on the wire, the session does
+        // this once per update
+        virtual void flush();
+
+        float get_messages_per_packet() const;
 };
\ No newline at end of file
@@ -1,38 +1,120 @@
 #include "Engine/Net/message.hpp"
+#include "Engine/Net/message_pool.hpp"
 #include "Engine/Core/types.h"
+#include "Engine/Math/MathUtils.hpp"
 
 NetMessage::NetMessage()
     :m_sender(nullptr)
+    ,m_payload(nullptr)
+    ,m_payload_capacity(0)
     ,m_payload_bytes_used(0)
     ,m_payload_bytes_read(0)
+    ,m_payload_storage(NET_PAYLOAD_POOLED)
+    ,m_reliable_id(0)
+    ,m_sequence_id(0)
+    ,m_last_sent_time(0.0)
 {
     m_stream_order = LITTLE_ENDIAN;
-    memset(m_payload, 0, MAX_PAYLOAD_SIZE);
 }
 
 NetMessage::NetMessage(uint8_t msg_type_id)
     :m_message_type_id(msg_type_id)
     ,m_sender(nullptr)
+    ,m_payload(nullptr)
+    ,m_payload_capacity(0)
     ,m_payload_bytes_used(0)
     ,m_payload_bytes_read(0)
+    ,m_payload_storage(NET_PAYLOAD_POOLED)
+    ,m_reliable_id(0)
+    ,m_sequence_id(0)
+    ,m_last_sent_time(0.0)
+{
+    m_stream_order = LITTLE_ENDIAN;
+}
+
+NetMessage::NetMessage(uint8_t msg_type_id, byte_t* buffer, size_t buffer_size)
+    :m_message_type_id(msg_type_id)
+    ,m_sender(nullptr)
+    ,m_payload(buffer)
+    ,m_payload_capacity(Min(buffer_size, (size_t)MAX_PAYLOAD_SIZE))
+    ,m_payload_bytes_used(0)
+    ,m_payload_bytes_read(0)
+    ,m_payload_storage(NET_PAYLOAD_BORROWED)
+    ,m_reliable_id(0)
+    ,m_sequence_id(0)
+    ,m_last_sent_time(0.0)
 {
     m_stream_order = LITTLE_ENDIAN;
-    memset(m_payload, 0, MAX_PAYLOAD_SIZE);
 }
 
 NetMessage::NetMessage(const NetMessage& copy)
     :m_message_type_id(copy.m_message_type_id)
     ,m_sender(copy.m_sender)
-    ,m_payload_bytes_used(copy.m_payload_bytes_used)
+    ,m_payload(nullptr)
+    ,m_payload_capacity(0)
+    ,m_payload_bytes_used(0)
     ,m_payload_bytes_read(0)
+    ,m_payload_storage(NET_PAYLOAD_POOLED)
+    ,m_reliable_id(0)
+    ,m_sequence_id(0)
+    ,m_last_sent_time(0.0)
 {
     m_stream_order = LITTLE_ENDIAN;
-    memcpy(m_payload, copy.m_payload, m_payload_bytes_used);
+
+    // only as big as what was written, not what the original had room for
+    if(copy.m_payload_bytes_used > 0){
+        reserve(copy.m_payload_bytes_used);
+        memcpy(m_payload, copy.m_payload, copy.m_payload_bytes_used);
+        m_payload_bytes_used = copy.m_payload_bytes_used;
+    }
+}
+
+NetMessage& NetMessage::operator=(const NetMessage& copy)
+{
+    if(this == &copy){
+        return *this;
+    }
+
+    // a borrowed buffer stays borrowed, anything else ends up pooled
+    if(NET_PAYLOAD_VIEW == m_payload_storage){
+        release_payload();
+    }
+
+    m_message_type_id = copy.m_message_type_id;
+    m_sender = copy.m_sender;
+    m_payload_bytes_used = 0;
+    m_payload_bytes_read = 0;
+    m_reliable_id = 0;
+    m_sequence_id = 0;
+    m_last_sent_time = 0.0;
+
+    if(copy.m_payload_bytes_used > 0){
+        if(reserve(copy.m_payload_bytes_used)){
+            memcpy(m_payload, copy.m_payload, copy.m_payload_bytes_used);
+            m_payload_bytes_used = copy.m_payload_bytes_used;
+        }
+    }
+    return *this;
+}
+
+NetMessage::~NetMessage()
+{
+    release_payload();
+}
+
+void* NetMessage::operator new(size_t size)
+{
+    return net_message_pool_alloc_message(size);
+}
+
+void NetMessage::operator delete(void* ptr, size_t size)
+{
+    net_message_pool_free_message(ptr, size);
 }
 
 u32 NetMessage::write_bytes(void* bytes, size_t count)
 {
-    if(m_payload_bytes_used + count > MAX_PAYLOAD_SIZE){
+    if((0 == count) || !reserve(m_payload_bytes_used + count)){
         return 0;
     }
 
@@ -46,6 +128,11 @@ u32 NetMessage::write_bytes(void* bytes, size_t count)
 
 u32 NetMessage::read_bytes(void* out_bytes, size_t count)
 {
+    // payloads can come off the wire, never read past what was written
+    if((0 == count) || (m_payload_bytes_read + count > m_payload_bytes_used)){
+        return 0;
+    }
+
     memcpy(out_bytes, m_payload + m_payload_bytes_read, count);
     m_payload_bytes_read += count;
     return (u32)count;
@@ -69,7 +156,7 @@ void NetMessage::write_string(const char* string)
 bool NetMessage::read_string(char* out_string, unsigned int max_size)
 {
     if(has_read_all_data()){
-        return nullptr;
+        return false;
     }
 
     uint16_t string_length;
@@ -106,7 +193,9 @@ void NetMessage::write_to(u8* dest)
     memcpy(dest, &m_message_type_id, sizeof(m_message_type_id));
     dest += sizeof(m_message_type_id);
 
-    memcpy(dest, m_payload, m_payload_bytes_used);
+    if(m_payload_bytes_used > 0){
+        memcpy(dest, m_payload, m_payload_bytes_used);
+    }
 }
 
 u16 NetMessage::get_body_size()
@@ -122,8 +211,90 @@ u16 NetMessage::get_full_size()
 
 void NetMessage::reset()
 {
+    // a view has nothing to write into, the next write gets a buffer of its own
+    if(NET_PAYLOAD_VIEW == m_payload_storage){
+        release_payload();
+    }
+
     m_sender = nullptr;
     m_payload_bytes_used = 0;
     m_payload_bytes_read = 0;
-    memset(m_payload, 0, MAX_PAYLOAD_SIZE);
+}
+
+bool NetMessage::reserve(size_t size)
+{
+    if(size <= m_payload_capacity){
+        return (NET_PAYLOAD_VIEW != m_payload_storage);
+    }
+
+    if((size > MAX_PAYLOAD_SIZE) || (NET_PAYLOAD_POOLED != m_payload_storage)){
+        return false;
+    }
+
+    size_t capacity;
+    byte_t* payload = net_message_pool_alloc_payload(size, &capacity);
+    if(nullptr == payload){
+        return false;
+    }
+
+    if(m_payload_bytes_used > 0){
+        memcpy(payload, m_payload, m_payload_bytes_used);
+    }
+    net_message_pool_free_payload(m_payload, m_payload_capacity);
+
+    m_payload = payload;
+    m_payload_capacity = capacity;
+    return true;
+}
+
+void NetMessage::set_view(const byte_t* payload, size_t payload_size)
+{
+    release_payload();
+
+    m_payload = (byte_t*)payload;
+    m_payload_capacity = payload_size;
+    m_payload_bytes_used = payload_size;
+    m_payload_bytes_read = 0;
+    m_payload_storage = NET_PAYLOAD_VIEW;
+
+    net_message_pool_count_view();
+}
+
+bool NetMessage::is_view() const
+{
+    return (NET_PAYLOAD_VIEW == m_payload_storage);
+}
+
+void NetMessage::own_payload()
+{
+    if(NET_PAYLOAD_POOLED == m_payload_storage){
+        return;
+    }
+
+    byte_t* source = m_payload;
+    size_t size = m_payload_bytes_used;
+
+    m_payload = nullptr;
+    m_payload_capacity = 0;
+    m_payload_bytes_used = 0;
+    m_payload_storage = NET_PAYLOAD_POOLED;
+
+    if(size > 0){
+        reserve(size);
+        memcpy(m_payload, source, size);
+        m_payload_bytes_used = size;
+    }
+}
+
+void NetMessage::release_payload()
+{
+    if(NET_PAYLOAD_POOLED == m_payload_storage){
+        net_message_pool_free_payload(m_payload, m_payload_capacity);
+    }
+
+    m_payload = nullptr;
+    m_payload_capacity = 0;
+    m_payload_bytes_used = 0;
+    m_payload_bytes_read = 0;
+    m_payload_storage = NET_PAYLOAD_POOLED;
 }
\ No newline at end of file
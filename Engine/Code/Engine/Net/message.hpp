@@ -8,22 +8,47 @@ class NetConnection;
 
 #define MAX_PAYLOAD_SIZE 1024
 
+// Where a message's payload lives. Pooled ones are the message's own and grow as
+// they're written to, a view reads something else's bytes in place (a received
+// packet), borrowed is somebody else's buffer to write into that can't grow.
+enum NetPayloadStorage : uint8_t
+{
+    NET_PAYLOAD_POOLED,
+    NET_PAYLOAD_VIEW,
+    NET_PAYLOAD_BORROWED
+};
+
+// Messages and their payloads come from the message pool, see message_pool.hpp.
+// Nothing is allocated for the payload until something is written.
 class NetMessage : public BinaryStream
 {
     public:
         uint8_t m_message_type_id;
         NetConnection* m_sender;
-        byte_t m_payload[MAX_PAYLOAD_SIZE];
+        byte_t* m_payload;
+        size_t m_payload_capacity;
         size_t m_payload_bytes_used;
         size_t m_payload_bytes_read;
+        NetPayloadStorage m_payload_storage;
 
         //#TODO, get rid of this once we get more UDP infrastructure
         net_address_t m_udp_sender;
 
+        // reliable traffic over UDP, set by the connection sending or receiving it
+        u16 m_reliable_id;
+        u16 m_sequence_id;
+        double m_last_sent_time;
+
     public:
         NetMessage();
         NetMessage(uint8_t msg_type_id);
+        NetMessage(uint8_t msg_type_id, byte_t* buffer, size_t buffer_size);
         NetMessage(const NetMessage& copy);
+        NetMessage& operator=(const NetMessage& copy);
+        virtual ~NetMessage();
+
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
 
     	virtual u32 write_bytes(void* bytes, size_t count) override;
     	virtual u32 read_bytes(void* out_bytes, size_t count) override;
@@ -37,4 +62,27 @@ class NetMessage : public BinaryStream
         u16 get_full_size();
 
         void reset();
-};
\ No newline at end of file
+
+        // room for at least size bytes, false past MAX_PAYLOAD_SIZE or what a
+        // borrowed buffer has
+        bool reserve(size_t size);
+
+        // Reads payload_size bytes where they are, which have to outlive the
+        // message or at least its reading. Anything it had is let go.
+        void set_view(const byte_t* payload, size_t payload_size);
+        bool is_view() const;
+
+        // copies a view or borrowed payload into one of its own, for keeping the
+        // message past whatever it pointed into
+        void own_payload();
+
+    private:
+        void release_payload();
+};
+
+// true when a is newer than b, for sequence numbers that wrap
+inline bool cycle_greater_than(u16 a, u16 b)
+{
+    u16 diff = (u16)(a - b);
+    return (diff != 0) && (diff < 0x8000);
+}
@@ -0,0 +1,164 @@
+#include "Engine/Net/message_pool.hpp"
+#include "Engine/Net/message.hpp"
+#include "Engine/Memory/chunk_allocator.h"
+#include "Engine/Thread/critical_section.h"
+#include "Engine/Profile/mem_tracker.h"
+
+#include <new>
+#include <string.h>
+
+// most messages are a few ids and numbers, net object updates fill a packet
+static const size_t PAYLOAD_CLASS_SIZES[NUM_NET_PAYLOAD_SIZE_CLASSES] = { 32, 128, 512, MAX_PAYLOAD_SIZE };
+
+struct net_message_pool_t
+{
+    CriticalSection lock;
+
+    ChunkAllocator messages;
+    ChunkAllocator* payloads[NUM_NET_PAYLOAD_SIZE_CLASSES];
+
+    net_message_pool_stats_t stats;
+    uint chunk_count_at_reset;
+
+    net_message_pool_t()
+        :messages(sizeof(NetMessage), NET_MESSAGES_PER_CHUNK)
+        ,chunk_count_at_reset(0)
+    {
+        for(uint size_class = 0; size_class < NUM_NET_PAYLOAD_SIZE_CLASSES; ++size_class){
+            size_t class_size = PAYLOAD_CLASS_SIZES[size_class];
+            payloads[size_class] = mem_construct_untracked_object<ChunkAllocator>(class_size, (unsigned int)(NET_PAYLOAD_BYTES_PER_CHUNK / class_size));
+        }
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    uint get_chunk_count() const
+    {
+        uint chunk_count = messages.chunk_count;
+        for(uint size_class = 0; size_class < NUM_NET_PAYLOAD_SIZE_CLASSES; ++size_class){
+            chunk_count += payloads[size_class]->chunk_count;
+        }
+        return chunk_count;
+    }
+};
+
+// Messages can be deleted by anything torn down at exit, so the pool is never
+// destroyed. It's made on first use, outside the memory tracker like its lock.
+static net_message_pool_t* s_pool = nullptr;
+
+static net_message_pool_t* get_pool()
+{
+    if(nullptr == s_pool){
+        s_pool = mem_construct_untracked_object<net_message_pool_t>();
+    }
+    return s_pool;
+}
+
+void* net_message_pool_alloc_message(size_t size)
+{
+    net_message_pool_t* pool = get_pool();
+    SCOPE_LOCK(&pool->lock);
+
+    pool->stats.messages_allocated++;
+    pool->stats.live_messages++;
+
+    void* message = pool->messages.alloc(size);
+    if(nullptr == message){
+        pool->stats.heap_allocations++;
+        message = ::operator new(size);
+    }
+    return message;
+}
+
+void net_message_pool_free_message(void* message, size_t size)
+{
+    if(nullptr == message){
+        return;
+    }
+
+    net_message_pool_t* pool = get_pool();
+    SCOPE_LOCK(&pool->lock);
+
+    pool->stats.live_messages--;
+    if(size <= pool->messages.block_size){
+        pool->messages.free(message);
+    }else{
+        ::operator delete(message);
+    }
+}
+
+byte_t* net_message_pool_alloc_payload(size_t min_size, size_t* out_capacity)
+{
+    for(uint size_class = 0; size_class < NUM_NET_PAYLOAD_SIZE_CLASSES; ++size_class){
+        size_t class_size = PAYLOAD_CLASS_SIZES[size_class];
+        if(min_size > class_size){
+            continue;
+        }
+
+        net_message_pool_t* pool = get_pool();
+        SCOPE_LOCK(&pool->lock);
+
+        pool->stats.payloads_allocated[size_class]++;
+        pool->stats.payload_bytes_allocated += (uint)class_size;
+        pool->stats.live_payloads++;
+
+        *out_capacity = class_size;
+        return (byte_t*)pool->payloads[size_class]->alloc(class_size);
+    }
+
+    *out_capacity = 0;
+    return nullptr;
+}
+
+void net_message_pool_free_payload(byte_t* payload, size_t capacity)
+{
+    if(nullptr == payload){
+        return;
+    }
+
+    for(uint size_class = 0; size_class < NUM_NET_PAYLOAD_SIZE_CLASSES; ++size_class){
+        if(capacity == PAYLOAD_CLASS_SIZES[size_class]){
+            net_message_pool_t* pool = get_pool();
+            SCOPE_LOCK(&pool->lock);
+
+            pool->stats.live_payloads--;
+            pool->payloads[size_class]->free(payload);
+            return;
+        }
+    }
+}
+
+void net_message_pool_count_view()
+{
+    net_message_pool_t* pool = get_pool();
+    SCOPE_LOCK(&pool->lock);
+    pool->stats.views++;
+}
+
+size_t net_message_pool_get_payload_class_size(uint size_class)
+{
+    return (size_class < NUM_NET_PAYLOAD_SIZE_CLASSES) ? PAYLOAD_CLASS_SIZES[size_class] : 0;
+}
+
+net_message_pool_stats_t net_message_pool_get_stats()
+{
+    net_message_pool_t* pool = get_pool();
+    SCOPE_LOCK(&pool->lock);
+
+    net_message_pool_stats_t stats = pool->stats;
+    stats.heap_allocations += pool->get_chunk_count() - pool->chunk_count_at_reset;
+    return stats;
+}
+
+void net_message_pool_reset_stats()
+{
+    net_message_pool_t* pool = get_pool();
+    SCOPE_LOCK(&pool->lock);
+
+    uint live_messages = pool->stats.live_messages;
+    uint live_payloads = pool->stats.live_payloads;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->stats.live_messages = live_messages;
+    pool->stats.live_payloads = live_payloads;
+
+    pool->chunk_count_at_reset = pool->get_chunk_count();
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/types.h"
+#include <stddef.h>
+
+// Payload buffers come in a few sizes (see message_pool.cpp), the last being
+// MAX_PAYLOAD_SIZE. A message that outgrows its buffer moves up a size.
+#define NUM_NET_PAYLOAD_SIZE_CLASSES 4
+
+// how many of each are carved out of the heap at a time
+#define NET_MESSAGES_PER_CHUNK 256
+#define NET_PAYLOAD_BYTES_PER_CHUNK (16 * 1024)
+
+struct net_message_pool_stats_t
+{
+    // counted since the last reset
+    uint messages_allocated;
+    uint payloads_allocated[NUM_NET_PAYLOAD_SIZE_CLASSES];
+    uint payload_bytes_allocated;
+    uint views;
+
+    // chunks taken from the heap, and anything that didn't fit a block
+    uint heap_allocations;
+
+    uint live_messages;
+    uint live_payloads;
+};
+
+// Where NetMessages and their payloads come from, so making one per message
+// doesn't go to the heap once the pool has warmed up. Safe from any thread.
+void*   net_message_pool_alloc_message(size_t size);
+void    net_message_pool_free_message(void* message, size_t size);
+
+// at least min_size, the size actually handed out goes in out_capacity. Null
+// when asked for more than MAX_PAYLOAD_SIZE
+byte_t* net_message_pool_alloc_payload(size_t min_size, size_t* out_capacity);
+void    net_message_pool_free_payload(byte_t* payload, size_t capacity);
+
+// a message that read its payload where it was instead of copying it
+void    net_message_pool_count_view();
+
+size_t  net_message_pool_get_payload_class_size(uint size_class);
+net_message_pool_stats_t net_message_pool_get_stats();
+void    net_message_pool_reset_stats();
\ No newline at end of file
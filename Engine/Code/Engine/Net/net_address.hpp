@@ -1,6 +1,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <string>
 #include <vector>
 
 #define NET_DEFAULT_PORT 12345
@@ -13,6 +14,16 @@ struct net_address_t
     uint16_t        port = 0;
 };
 
+inline bool operator==(const net_address_t& a, const net_address_t& b)
+{
+    return (a.address == b.address) && (a.port == b.port);
+}
+
+inline bool operator!=(const net_address_t& a, const net_address_t& b)
+{
+    return !(a == b);
+}
+
 bool net_address_from_socket_address(net_address_t* out_net_address, sockaddr* socket_address);
 void socket_address_from_net_address(sockaddr* out_socket_address, int* out_address_size, const net_address_t& net_address);
 
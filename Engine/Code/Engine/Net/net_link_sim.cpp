@@ -0,0 +1,137 @@
+#include "Engine/Net/net_link_sim.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <string.h>
+
+NetLinkSim::NetLinkSim()
+    :m_next_order(0)
+    ,m_link_free_time(0.0)
+    ,m_last_deliver_time(0.0)
+{
+    memset(&m_conditions, 0, sizeof(m_conditions));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_conditions.max_queued_bytes = NET_LINK_DEFAULT_QUEUE_BYTES;
+}
+
+NetLinkSim::~NetLinkSim()
+{
+    clear();
+    for(net_link_datagram_t* datagram : m_free){
+        delete datagram;
+    }
+    m_free.clear();
+}
+
+bool NetLinkSim::is_enabled() const
+{
+    return (m_conditions.latency_ms > 0.0f)
+        || (m_conditions.jitter_ms > 0.0f)
+        || (m_conditions.loss > 0.0f)
+        || (m_conditions.duplicate > 0.0f)
+        || (m_conditions.reorder > 0.0f)
+        || (m_conditions.bytes_per_second > 0)
+        || !m_in_flight.empty();
+}
+
+bool NetLinkSim::send(const net_address_t& dest, const void* data, uint size, double now)
+{
+    m_stats.packets_sent++;
+    size = Min(size, (uint)PACKET_MTU);
+
+    if((m_conditions.loss > 0.0f) && (GetRandomFloatZeroToOne() < m_conditions.loss)){
+        m_stats.packets_lost++;
+        return false;
+    }
+
+    // a capped link sends one datagram after another, the queue is what's
+    // waiting its turn
+    double sent_time = now;
+    if(m_conditions.bytes_per_second > 0){
+        double queued_seconds = Max(m_link_free_time - now, 0.0);
+        double queued_bytes = queued_seconds * m_conditions.bytes_per_second;
+        if((queued_bytes + size) > m_conditions.max_queued_bytes){
+            m_stats.packets_dropped++;
+            return false;
+        }
+
+        m_link_free_time = Max(m_link_free_time, now) + ((double)size / (double)m_conditions.bytes_per_second);
+        sent_time = m_link_free_time;
+    }
+
+    double latency = m_conditions.latency_ms;
+    if(m_conditions.jitter_ms > 0.0f){
+        latency += GetRandomFloatInRange(-m_conditions.jitter_ms, m_conditions.jitter_ms);
+    }
+    double deliver_time = sent_time + (Max(latency, 0.0) / 1000.0);
+
+    if((m_conditions.reorder > 0.0f) && (GetRandomFloatZeroToOne() < m_conditions.reorder)){
+        // held back so the ones after it get there first
+        m_stats.packets_reordered++;
+        deliver_time += (NET_LINK_REORDER_DELAY_MS + m_conditions.jitter_ms) / 1000.0;
+    }else{
+        deliver_time = Max(deliver_time, m_last_deliver_time);
+        m_last_deliver_time = deliver_time;
+    }
+    schedule(dest, data, size, deliver_time);
+
+    if((m_conditions.duplicate > 0.0f) && (GetRandomFloatZeroToOne() < m_conditions.duplicate)){
+        m_stats.packets_duplicated++;
+        schedule(dest, data, size, deliver_time + (GetRandomFloatZeroToOne() * m_conditions.jitter_ms / 1000.0));
+    }
+
+    return true;
+}
+
+net_link_datagram_t* NetLinkSim::receive(double now)
+{
+    if(m_in_flight.empty() || (m_in_flight.top()->deliver_time > now)){
+        return nullptr;
+    }
+
+    net_link_datagram_t* datagram = m_in_flight.top();
+    m_in_flight.pop();
+
+    m_stats.packets_delivered++;
+    m_stats.bytes_delivered += datagram->size;
+    return datagram;
+}
+
+void NetLinkSim::release(net_link_datagram_t* datagram)
+{
+    m_free.push_back(datagram);
+}
+
+uint NetLinkSim::get_in_flight_count() const
+{
+    return (uint)m_in_flight.size();
+}
+
+void NetLinkSim::clear()
+{
+    while(!m_in_flight.empty()){
+        m_free.push_back(m_in_flight.top());
+        m_in_flight.pop();
+    }
+
+    m_link_free_time = 0.0;
+    m_last_deliver_time = 0.0;
+}
+
+void NetLinkSim::schedule(const net_address_t& dest, const void* data, uint size, double deliver_time)
+{
+    net_link_datagram_t* datagram;
+    if(m_free.empty()){
+        datagram = new net_link_datagram_t();
+    }else{
+        datagram = m_free.back();
+        m_free.pop_back();
+    }
+
+    datagram->dest = dest;
+    datagram->size = size;
+    memcpy(datagram->data, data, size);
+    datagram->deliver_time = deliver_time;
+    datagram->order = m_next_order++;
+
+    m_in_flight.push(datagram);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Engine/Net/net_address.hpp"
+#include "Engine/Net/net_packet.hpp"
+#include "Engine/Core/types.h"
+
+#include <queue>
+#include <vector>
+
+// how much later than the packets behind it a reordered one arrives, on top of
+// the jitter
+#define NET_LINK_REORDER_DELAY_MS 20.0f
+
+// bytes a capped link lets back up before it starts dropping, like a router's
+// buffer would
+#define NET_LINK_DEFAULT_QUEUE_BYTES (64 * 1024)
+
+struct net_link_conditions_t
+{
+    // one way, jitter is spread evenly either side of the latency
+    float latency_ms;
+    float jitter_ms;
+
+    // chances for each packet sent
+    float loss;
+    float duplicate;
+    float reorder;
+
+    // 0 for no cap
+    uint bytes_per_second;
+    uint max_queued_bytes;
+};
+
+struct net_link_stats_t
+{
+    uint packets_sent;
+    uint packets_lost;
+    uint packets_dropped;       // the capped link was backed up
+    uint packets_duplicated;
+    uint packets_reordered;
+    uint packets_delivered;
+    uint bytes_delivered;
+};
+
+struct net_link_datagram_t
+{
+    net_address_t dest;
+    uint size;
+    byte data[PACKET_MTU];
+
+    double deliver_time;
+    uint order;
+};
+
+// One direction of a pretend network. Datagrams go in as they're sent and come
+// out once they're due, late, lost, twice or out of order as the conditions say.
+// Time is whatever the caller says it is, so a test can run faster than the clock.
+class NetLinkSim
+{
+    public:
+        net_link_conditions_t m_conditions;
+        net_link_stats_t m_stats;
+
+    public:
+        NetLinkSim();
+        ~NetLinkSim();
+
+        // false when nothing is set, datagrams can skip the link altogether
+        bool is_enabled() const;
+
+        // false when it was lost or dropped
+        bool send(const net_address_t& dest, const void* data, uint size, double now);
+
+        // the next datagram due by now, returned with release once it's been used
+        net_link_datagram_t* receive(double now);
+        void release(net_link_datagram_t* datagram);
+
+        uint get_in_flight_count() const;
+        void clear();
+
+    private:
+        void schedule(const net_address_t& dest, const void* data, uint size, double deliver_time);
+
+        // soonest first, ties in the order they were sent
+        struct deliver_later_t
+        {
+            bool operator()(const net_link_datagram_t* a, const net_link_datagram_t* b) const
+            {
+                return (a->deliver_time != b->deliver_time) ? (a->deliver_time > b->deliver_time) : (a->order > b->order);
+            }
+        };
+
+        std::priority_queue<net_link_datagram_t*, std::vector<net_link_datagram_t*>, deliver_later_t> m_in_flight;
+        std::vector<net_link_datagram_t*> m_free;
+
+        uint m_next_order;
+
+        // when the capped link is done sending what it has, and when the last
+        // datagram that wasn't reordered arrives so jitter alone doesn't reorder
+        double m_link_free_time;
+        double m_last_deliver_time;
+};
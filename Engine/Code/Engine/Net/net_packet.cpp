@@ -5,12 +5,16 @@
 NetPacket::NetPacket()
     :m_payload_bytes_used(0)
     ,m_msg_cursor(nullptr)
+    ,m_messages_read(0)
 {
     memset(m_payload, 0, PACKET_MTU);
 
     packet_header_t* header = get_packet_header();
     header->from_conn_idx = 0xFF;
-    header->packet_ack = 0xFFFF;
+    header->packet_ack = INVALID_PACKET_ACK;
+    header->last_received_ack = INVALID_PACKET_ACK;
+    header->previous_received_ack_bitfield = 0;
+    header->in_order_bundle_count = 0;
     header->reliable_bundle_count = 0;
     header->unreliable_bundle_count = 0;
 
@@ -27,41 +31,124 @@ bool NetPacket::write(NetMessage* msg)
         return false;
     }
 
+    packet_header_t* header = get_packet_header();
+    if(header->unreliable_bundle_count == 0xFF){
+        return false;
+    }
+
     // increment payload size
     u8* dest = m_payload + m_payload_bytes_used;
     msg->write_to(dest);
 
     // track packet usage
     m_payload_bytes_used += msg_total_size;
-    increment_msg_count();
+    header->unreliable_bundle_count++;
 
     return true;
 }
 
-bool NetPacket::read(NetMessage* out_msg)
+bool NetPacket::write_reliable(NetMessage* msg, bool in_order)
+{
+    packet_header_t* header = get_packet_header();
+
+    // bundles can't be interleaved
+    if(header->unreliable_bundle_count > 0){
+        return false;
+    }
+    if(in_order && (header->reliable_bundle_count > 0)){
+        return false;
+    }
+
+    if(get_reliables_count() >= MAX_RELIABLES_PER_PACKET){
+        return false;
+    }
+
+    PacketBundle bundle = in_order ? PACKET_BUNDLE_IN_ORDER : PACKET_BUNDLE_RELIABLE;
+    uint msg_total_size = (uint)msg->m_payload_bytes_used + get_message_overhead(bundle);
+    if(msg_total_size > get_free_byte_count()){
+        return false;
+    }
+
+    u8* dest = m_payload + m_payload_bytes_used;
+
+    u16 body_size = msg->get_body_size();
+    memcpy(dest, &body_size, sizeof(body_size));
+    dest += sizeof(body_size);
+
+    memcpy(dest, &msg->m_message_type_id, sizeof(msg->m_message_type_id));
+    dest += sizeof(msg->m_message_type_id);
+
+    memcpy(dest, &msg->m_reliable_id, sizeof(msg->m_reliable_id));
+    dest += sizeof(msg->m_reliable_id);
+
+    if(in_order){
+        memcpy(dest, &msg->m_sequence_id, sizeof(msg->m_sequence_id));
+        dest += sizeof(msg->m_sequence_id);
+    }
+
+    memcpy(dest, msg->m_payload, msg->m_payload_bytes_used);
+
+    m_payload_bytes_used += msg_total_size;
+    if(in_order){
+        header->in_order_bundle_count++;
+    }else{
+        header->reliable_bundle_count++;
+    }
+
+    return true;
+}
+
+bool NetPacket::read(NetMessage* out_msg, PacketBundle* out_bundle)
 {
     // make sure we stil have messages to read
-    u8 msg_count = get_messages_count();
-    if(msg_count == 0){
+    if(m_messages_read >= get_messages_count()){
         return false;
     }
 
+    PacketBundle bundle = get_bundle_for_message(m_messages_read);
+    uint overhead = get_message_overhead(bundle);
+
     // track using a temporary internal cursor
     u8* internal_cursor = m_msg_cursor;
+    u8* end = m_payload + m_payload_bytes_used;
+    if((uint)(end - internal_cursor) < overhead){
+        return false;
+    }
 
     // get body size
-    u16 body_size = *internal_cursor;
+    u16 body_size;
+    memcpy(&body_size, internal_cursor, sizeof(body_size));
     internal_cursor += sizeof(body_size);
 
     // get msg id
     u8 msg_id = *(internal_cursor);
-    out_msg->m_message_type_id = msg_id;
     internal_cursor += sizeof(msg_id);
 
+    u16 reliable_id = 0;
+    u16 sequence_id = 0;
+    if(PACKET_BUNDLE_UNRELIABLE != bundle){
+        memcpy(&reliable_id, internal_cursor, sizeof(reliable_id));
+        internal_cursor += sizeof(reliable_id);
+    }
+    if(PACKET_BUNDLE_IN_ORDER == bundle){
+        memcpy(&sequence_id, internal_cursor, sizeof(sequence_id));
+        internal_cursor += sizeof(sequence_id);
+    }
+
     // get payload
+    if(body_size < sizeof(msg_id)){
+        return false;
+    }
     u16 payload_size = body_size - sizeof(msg_id);
-    memcpy(out_msg->m_payload, internal_cursor, payload_size);
-    out_msg->m_payload_bytes_used = payload_size;
+    if((payload_size > MAX_PAYLOAD_SIZE) || ((uint)(end - internal_cursor) < payload_size)){
+        return false;
+    }
+
+    // read in place, see the comment on read
+    out_msg->m_message_type_id = msg_id;
+    out_msg->set_view(internal_cursor, payload_size);
+    out_msg->m_reliable_id = reliable_id;
+    out_msg->m_sequence_id = sequence_id;
 
     // get sender
     out_msg->m_udp_sender = m_sender;
@@ -69,43 +156,99 @@ bool NetPacket::read(NetMessage* out_msg)
     // update actual cursor
     internal_cursor += payload_size;
     m_msg_cursor = internal_cursor;
+    m_messages_read++;
 
-    // update header for number of msg's left
-    decrement_msg_count();
+    if(nullptr != out_bundle){
+        *out_bundle = bundle;
+    }
 
     return true;
 }
 
+bool NetPacket::is_valid()
+{
+    if(m_payload_bytes_used < sizeof(packet_header_t)){
+        return false;
+    }
+
+    // walk every message without copying it, they all have to fit exactly
+    u8* cursor = m_payload + sizeof(packet_header_t);
+    u8* end = m_payload + m_payload_bytes_used;
+
+    uint msg_count = get_messages_count();
+    for(uint msg_idx = 0; msg_idx < msg_count; ++msg_idx){
+        uint overhead = get_message_overhead(get_bundle_for_message(msg_idx));
+        if((uint)(end - cursor) < overhead){
+            return false;
+        }
+
+        u16 body_size;
+        memcpy(&body_size, cursor, sizeof(body_size));
+        if((body_size < sizeof(u8)) || ((u16)(body_size - sizeof(u8)) > MAX_PAYLOAD_SIZE)){
+            return false;
+        }
+
+        uint payload_size = body_size - sizeof(u8);
+        if((uint)(end - cursor) < (overhead + payload_size)){
+            return false;
+        }
+        cursor += overhead + payload_size;
+    }
+
+    return (cursor == end);
+}
+
+void NetPacket::reset_read()
+{
+    m_msg_cursor = m_payload + sizeof(packet_header_t);
+    m_messages_read = 0;
+}
+
 packet_header_t* NetPacket::get_packet_header()
 {
     return (packet_header_t*)m_payload;
 }
 
-void NetPacket::set_messages_count(u8 msg_count)
+uint NetPacket::get_messages_count()
 {
     packet_header_t* packet_header = get_packet_header();
-    packet_header->unreliable_bundle_count = msg_count;
+    return (uint)packet_header->in_order_bundle_count + packet_header->reliable_bundle_count + packet_header->unreliable_bundle_count;
 }
 
-u8 NetPacket::get_messages_count()
+uint NetPacket::get_reliables_count()
 {
     packet_header_t* packet_header = get_packet_header();
-    return packet_header->unreliable_bundle_count;
+    return (uint)packet_header->in_order_bundle_count + packet_header->reliable_bundle_count;
 }
 
-void NetPacket::increment_msg_count()
+uint NetPacket::get_free_byte_count()
 {
-    u8 cur_msg_count = get_messages_count();
-    set_messages_count(cur_msg_count + 1);
+    return (uint)(PACKET_MTU - m_payload_bytes_used);
 }
 
-void NetPacket::decrement_msg_count()
+uint NetPacket::get_message_overhead(PacketBundle bundle)
 {
-    u8 cur_msg_count = get_messages_count();
-    set_messages_count(cur_msg_count - 1);
+    // body size and type
+    uint overhead = sizeof(u16) + sizeof(u8);
+
+    if(PACKET_BUNDLE_UNRELIABLE != bundle){
+        overhead += sizeof(u16);
+    }
+    if(PACKET_BUNDLE_IN_ORDER == bundle){
+        overhead += sizeof(u16);
+    }
+
+    return overhead;
 }
 
-uint NetPacket::get_free_byte_count()
+PacketBundle NetPacket::get_bundle_for_message(uint msg_idx)
 {
-    return (uint)(PACKET_MTU - m_payload_bytes_used);
-}
\ No newline at end of file
+    packet_header_t* packet_header = get_packet_header();
+    if(msg_idx < packet_header->in_order_bundle_count){
+        return PACKET_BUNDLE_IN_ORDER;
+    }else if(msg_idx < get_reliables_count()){
+        return PACKET_BUNDLE_RELIABLE;
+    }else{
+        return PACKET_BUNDLE_UNRELIABLE;
+    }
+}
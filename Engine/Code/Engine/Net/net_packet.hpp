@@ -7,13 +7,43 @@ class NetMessage;
 
 #define PACKET_MTU 1452
 
+// sequence numbers skip this, so it can mean nothing received yet
+#define INVALID_PACKET_ACK 0xFFFF
+
+// the most reliable messages one packet carries, bounded so a sent packet can
+// remember which it carried
+#define MAX_RELIABLES_PER_PACKET 32
+
+// Packets carry their messages in up to three bundles, in this order. Every
+// message is [u16 body size][u8 type], reliable ones follow that with their
+// u16 reliable id and in order ones with their u16 sequence id.
+enum PacketBundle : uint8_t
+{
+    PACKET_BUNDLE_IN_ORDER,
+    PACKET_BUNDLE_RELIABLE,
+    PACKET_BUNDLE_UNRELIABLE,
+    NUM_PACKET_BUNDLES
+};
+
+#pragma pack(push, 1)
 struct packet_header_t
 {
     u8 from_conn_idx;
+
+    // this packet's sequence number
     u16 packet_ack;
+
+    // newest packet the sender has received from us, and whether each of the 32
+    // before it arrived (bit 0 is last_received_ack - 1)
+    u16 last_received_ack;
+    u32 previous_received_ack_bitfield;
+
+    // in order messages are reliable, but counted on their own
+    u8 in_order_bundle_count;
     u8 reliable_bundle_count;
     u8 unreliable_bundle_count;
 };
+#pragma pack(pop)
 
 class NetPacket
 {
@@ -23,18 +53,37 @@ class NetPacket
         byte m_payload[PACKET_MTU];
         uint m_payload_bytes_used;
         byte* m_msg_cursor;
+        uint m_messages_read;
 
     public:
-        NetPacket(); 
+        NetPacket();
 
+        // unreliable
         bool write(NetMessage* msg);
-        bool read(NetMessage* out_msg);
+
+        // uses the message's reliable id, and its sequence id when in order. All in
+        // order messages have to be written before other reliables, and those
+        // before any unreliable ones
+        bool write_reliable(NetMessage* msg, bool in_order);
+
+        // False once every message was read, or when the rest of the packet is
+        // malformed. The message is a view of the packet's payload, anything that
+        // keeps it around longer than the packet has to call own_payload on it.
+        bool read(NetMessage* out_msg, PacketBundle* out_bundle = nullptr);
+
+        // the header fits and the bundles it claims fit in what was received
+        bool is_valid();
+
+        // back to the first message, for a packet that was received into again
+        void reset_read();
 
         packet_header_t* get_packet_header();
-        void set_messages_count(u8 msg_count);
-        u8 get_messages_count();
-        void increment_msg_count();
-        void decrement_msg_count();
+        uint get_messages_count();
+        uint get_reliables_count();
 
         uint get_free_byte_count();
-};
\ No newline at end of file
+        static uint get_message_overhead(PacketBundle bundle);
+
+    private:
+        PacketBundle get_bundle_for_message(uint msg_idx);
+};
@@ -206,4 +206,14 @@ void NetSession::send_message_to_host(NetMessage const &msg)
     if(nullptr != m_host_connection){
         m_host_connection->send(new NetMessage(msg));
     }
+}
+
+void NetSession::flush_connections()
+{
+    for(unsigned int index = 0; index < m_connections.size(); ++index){
+        NetConnection* conn = m_connections[index];
+        if(nullptr != conn){
+            conn->flush();
+        }
+    }
 }
\ No newline at end of file
@@ -21,6 +21,12 @@ enum CoreNetMessages : uint8_t
     NETOBJECT_DESTROY,
     NETOBJECT_UPDATE,
     NETOBJECT_SET_CLOCK,
+    NETOBJECT_ACK,
+
+    // new ids only ever go on the end, peers agree on them by value
+    NETMSG_JOIN_REQUEST,
+    NETMSG_JOIN_DENY,
+    NETMSG_LEAVE,
     NUM_CORE_NET_MESSAGES
 };
 
@@ -90,6 +96,10 @@ class NetSession
         void                    send_message_to_all(NetMessage const &msg);
         void                    send_message_to_all_clients_but_index(NetMessage const &msg, unsigned int excluded_index);
         void                    send_message_to_host(NetMessage const &msg);
+
+        // sends are queued per connection, this writes them out. Called at the end
+        // of update, call it again to get something out before the next one
+        void                    flush_connections();
 };
 
 template <typename T>
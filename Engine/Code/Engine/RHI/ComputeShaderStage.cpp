@@ -5,7 +5,7 @@ ComputeShaderStage::ComputeShaderStage(RHIDevice* rhi_device,
 				  const char* shader_raw_source, 
 				  const size_t shader_raw_source_size, 
 				  const char* entry_point)
-	:ShaderStage(shader_raw_source, shader_raw_source_size, entry_point, DX_COMPUTE_SHADER_TARGET)
+	:ShaderStage(rhi_device, shader_raw_source, shader_raw_source_size, entry_point, DX_COMPUTE_SHADER_TARGET)
 	,m_dx_compute_shader(nullptr)
 	,m_dx_input_layout(nullptr)
 {
@@ -122,6 +122,31 @@ DXGI_FORMAT DXGetImageFormat(ImageFormat format)
 			return DXGI_FORMAT_R16G16B16A16_FLOAT;
 		} break;
 
+		case IMAGE_FORMAT_BC1:
+		{
+			return DXGI_FORMAT_BC1_UNORM;
+		} break;
+
+		case IMAGE_FORMAT_BC3:
+		{
+			return DXGI_FORMAT_BC3_UNORM;
+		} break;
+
+		case IMAGE_FORMAT_BC4:
+		{
+			return DXGI_FORMAT_BC4_UNORM;
+		} break;
+
+		case IMAGE_FORMAT_BC5:
+		{
+			return DXGI_FORMAT_BC5_UNORM;
+		} break;
+
+		case IMAGE_FORMAT_BC7:
+		{
+			return DXGI_FORMAT_BC7_UNORM;
+		} break;
+
 		default: 
 		{
 			return DXGI_FORMAT_UNKNOWN;
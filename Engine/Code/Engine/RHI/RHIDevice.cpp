@@ -9,6 +9,8 @@
 #include "Engine/RHI/RHITexture2D.hpp"
 #include "Engine/RHI/RHITypes.hpp"
 #include "Engine/Renderer/Font.hpp"
+#include "Engine/RHI/texture_cache.h"
+#include "Engine/RHI/shader_cache.h"
 #include "Engine/Core/Common.hpp"
 #include "Engine/Core/FileUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
@@ -16,50 +18,19 @@
 #include "Engine/Core/job.h"
 #include "Engine/Core/log.h"
 
-struct load_texture_job_t
-{
-    std::string         filename;
-    Image*              image;
-    RHITexture2D*       texture;
-    texture_load_cb     loaded_cb;    
-};
-
-static void load_image_from_file_job(load_texture_job_t* job_data)
-{
-    job_data->image = new Image(job_data->filename, IMAGE_LOAD_MODE_FORCE_ALPHA);
-}
-
-static void load_texture_from_image_job(load_texture_job_t* job_data)
-{
-    if(job_data->image->IsValid()){
-        job_data->texture->LoadFromImage(*job_data->image);
-    }else{
-        // log an error
-        log_warningf("Image[%s] load failed!", job_data->filename.c_str());
-        job_data->texture->LoadFromColor(Rgba::PINK);
-    }
-}
-
-static void cleanup_resources_job(load_texture_job_t* job_data)
-{
-    SAFE_DELETE(job_data->image);
-    SAFE_DELETE(job_data);
-}
-
-static void call_texture_loaded_cb(texture_load_cb cb, load_texture_job_t* job_data)
-{
-    cb(job_data->texture);
-}
-
 RHIDevice::RHIDevice(ID3D11Device* dx11Device)
 	:m_dxDevice(dx11Device)
 	,m_immediateContext(nullptr)
 {
+	m_texture_cache = new TextureCache(this);
+	m_shader_cache = new ShaderCache();
 }
 
 RHIDevice::~RHIDevice()
 {
     //delete_textures_in_database();
+	SAFE_DELETE(m_texture_cache);
+	SAFE_DELETE(m_shader_cache);
 
 	// Output more detailed debug information for the device when it gets destroyed
 	// Only outputs in Debug/DebugInline builds
@@ -129,7 +100,7 @@ RHITexture2D* RHIDevice::CreateRHITexture2D(unsigned int width, unsigned int hei
 
 RHITexture2D* RHIDevice::FindOrCreateRHITexture2DFromFile(const char* filename)
 {
-    return find_or_create_texture2d_from_file(filename);
+    return m_texture_cache->load(filename);
 }
 
 RHITexture2D* RHIDevice::CreateRHITexture2DFromImage(const Image& image)
@@ -169,39 +140,23 @@ RHITexture2D* RHIDevice::CreateRHITexture2DFromPerlinNoise(const unsigned int wi
 
 RHITexture2D* RHIDevice::load_rhitexture2d_async(const std::string& filename, texture_load_cb cb)
 {
-    // If texture is already loaded, call the callback and return it
-	std::map<std::string, RHITexture2D*>::iterator found = m_texture_database.find(filename);
-	if(found != m_texture_database.end()){
-        if(nullptr != cb){
-            cb(found->second);
-        }
-		return found->second;
-	}
-    
-    // Didn't find it, so we're going to load it via the job system
-    load_texture_job_t* job_data = new load_texture_job_t();
-    job_data->filename = filename;
-    job_data->image = nullptr;
-    job_data->texture = new RHITexture2D(this);
-
-    Job* load_image_job = job_create(JOB_TYPE_GENERIC, load_image_from_file_job, job_data);
-    Job* image_to_texture_job = job_create(JOB_TYPE_RENDERING, load_texture_from_image_job, job_data);
-    Job* cleanup_job = job_create(JOB_TYPE_GENERIC, cleanup_resources_job, job_data);
-
-    if(nullptr != cb){
-        Job* cb_job = job_create(JOB_TYPE_MAIN, call_texture_loaded_cb, cb, job_data);
-        cb_job->depends_on(image_to_texture_job);
-        cleanup_job->depends_on(cb_job);
-        job_dispatch_and_release(cb_job);
-    }
+    // a load already in flight for this file picks up cb instead of starting another
+    return m_texture_cache->load_async(filename, cb);
+}
 
-    image_to_texture_job->depends_on(load_image_job);
-    cleanup_job->depends_on(image_to_texture_job);
+bool RHIDevice::release_rhitexture2d(RHITexture2D* texture)
+{
+    return m_texture_cache->release(texture);
+}
 
-    job_dispatch_and_release(load_image_job, image_to_texture_job, cleanup_job);
+bool RHIDevice::acquire_rhitexture2d(RHITexture2D* texture)
+{
+    return m_texture_cache->acquire(texture);
+}
 
-    m_texture_database[filename] = job_data->texture;
-    return job_data->texture;
+unsigned int RHIDevice::update_texture_loads()
+{
+    return m_texture_cache->update();
 }
 
 Sampler* RHIDevice::CreateSampler(const SamplerDescription& optionalDescription)
@@ -214,23 +169,7 @@ Font* RHIDevice::CreateFontFromFile(const char* filename)
 	return new Font(this, filename);
 }
 
-RHITexture2D* RHIDevice::find_or_create_texture2d_from_file(const char* filename)
-{
-	std::map<std::string, RHITexture2D*>::iterator found = m_texture_database.find(filename);
-	if(found != m_texture_database.end()){
-		return found->second;
-	}
-
-    RHITexture2D* texture = new RHITexture2D(this, filename);
-    m_texture_database[filename] = texture;
-    return texture;
-}
-
 void RHIDevice::delete_textures_in_database()
 {
-    std::map<std::string, RHITexture2D*>::iterator it; 
-    for(it = m_texture_database.begin(); it != m_texture_database.end(); it++){
-        SAFE_DELETE(it->second);
-    }
-    m_texture_database.clear();
+    m_texture_cache->clear();
 }
\ No newline at end of file
@@ -17,6 +17,9 @@ struct ID3D11Device;
 
 #include "Engine/RHI/RHITexture2D.hpp"
 
+class TextureCache;
+class ShaderCache;
+
 typedef void(*texture_load_cb)(RHITexture2D* loaded_tex);
 
 class RHIDevice
@@ -24,6 +27,8 @@ class RHIDevice
 public:
 	RHIDeviceContext*	m_immediateContext;
 	ID3D11Device*		m_dxDevice;
+	TextureCache*		m_texture_cache;
+	ShaderCache*		m_shader_cache;
 
 public:
 	RHIDevice(ID3D11Device* dx11Device);
@@ -59,12 +64,15 @@ public:
 
     RHITexture2D*               load_rhitexture2d_async(const std::string& filename, texture_load_cb cb = nullptr);
 
+    // textures from the two loads above are shared, each load takes a reference and release gives it back
+    bool                        acquire_rhitexture2d(RHITexture2D* texture);
+    bool                        release_rhitexture2d(RHITexture2D* texture);
+
+    // uploads finished async loads and calls their callbacks, on the thread that renders
+    unsigned int                update_texture_loads();
+
 	Sampler*					CreateSampler(const SamplerDescription& optionalDescription);
 
 	Font*						CreateFontFromFile(const char* filename);
     void						delete_textures_in_database();
-
-private:
-	std::map<std::string, RHITexture2D*> m_texture_database;
-	RHITexture2D* find_or_create_texture2d_from_file(const char* filename);
 };
\ No newline at end of file
@@ -7,7 +7,9 @@
 #include "Engine/Core/job.h"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/FileUtils.hpp"
+#include "Engine/Core/log.h"
 #include "Engine/Math/Noise.hpp"
+#include "Engine/Renderer/texture_file.h"
 
 RHITexture2D::RHITexture2D(RHIDevice* rhiDevice)
     :RHITextureBase(rhiDevice)
@@ -187,6 +189,12 @@ bool RHITexture2D::make_depth_stencil_for_output(RHIOutput* output)
 
 bool RHITexture2D::LoadFromFilename(const char* filename)
 {
+	// a cooked texture next to the image wins, it has mips and skips decoding
+	TextureFile texture_file;
+	if(texture_file.open(make_texture_file_name(filename).c_str())){
+		return load_from_texture_file(texture_file);
+	}
+
 	Image* image = new Image(filename, IMAGE_LOAD_MODE_FORCE_ALPHA);
 	if (!image){
 		return false;
@@ -400,6 +408,75 @@ bool RHITexture2D::load_from_binary_file(const char* filename, uint width, uint
 	}
 }
 
+bool RHITexture2D::load_from_texture_file(const char* filename)
+{
+	TextureFile texture_file;
+	if(!texture_file.open(filename)){
+		log_warningf("Failed to open texture file [%s]\n", filename);
+		return false;
+	}
+	return load_from_texture_file(texture_file);
+}
+
+ImageFormat get_texture_file_image_format(TextureFileFormat format)
+{
+	switch(format){
+		case TEXTURE_FILE_FORMAT_BC1:	return IMAGE_FORMAT_BC1;
+		case TEXTURE_FILE_FORMAT_BC3:	return IMAGE_FORMAT_BC3;
+		case TEXTURE_FILE_FORMAT_BC4:	return IMAGE_FORMAT_BC4;
+		case TEXTURE_FILE_FORMAT_BC5:	return IMAGE_FORMAT_BC5;
+		case TEXTURE_FILE_FORMAT_BC7:	return IMAGE_FORMAT_BC7;
+		case TEXTURE_FILE_FORMAT_RGBA16F:	return IMAGE_FORMAT_R16G16B16A16;
+		default:						return IMAGE_FORMAT_RGBA8;
+	}
+}
+
+bool RHITexture2D::load_from_texture_file(const TextureFile& texture_file)
+{
+	if(texture_file.is_cube_map()){
+		log_warningf("Texture file is a cube map, load it through CubeMap\n");
+		return false;
+	}
+
+	// unorm even for sRGB textures, the shaders sample colour textures as is and
+	// an _SRGB view would change what every material looks like
+	m_dxFormat = DXGetImageFormat(get_texture_file_image_format(texture_file.get_format()));
+	m_dxBindFlags = D3D11_BIND_SHADER_RESOURCE;
+	m_width = texture_file.get_width();
+	m_height = texture_file.get_height();
+
+	D3D11_TEXTURE2D_DESC textureDesc;
+	memset(&textureDesc, 0, sizeof(textureDesc));
+	textureDesc.Width = m_width;
+	textureDesc.Height = m_height;
+	textureDesc.MipLevels = texture_file.get_mip_count();
+	textureDesc.ArraySize = 1;
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.Format = m_dxFormat;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0U;
+	textureDesc.MiscFlags = 0;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+
+	// mips are stored at the pitch d3d wants, so the subresources point into the mapping
+	D3D11_SUBRESOURCE_DATA data[MAX_TEXTURE_FILE_MIPS];
+	memset(data, 0, sizeof(data));
+	for(uint mip_idx = 0; mip_idx < texture_file.get_mip_count(); ++mip_idx){
+		data[mip_idx].pSysMem = texture_file.get_mip_data(mip_idx);
+		data[mip_idx].SysMemPitch = texture_file.get_mip(mip_idx).row_pitch;
+		data[mip_idx].SysMemSlicePitch = (UINT)texture_file.get_mip(mip_idx).size;
+	}
+
+	HRESULT result = m_device->m_dxDevice->CreateTexture2D(&textureDesc, data, &m_dxTexture2D);
+	if(SUCCEEDED(result)){
+		CreateViews();
+		return true;
+	} else{
+		return false;
+	}
+}
+
 void RHITexture2D::CreateViews()
 {
 	if(m_dxBindFlags & D3D11_BIND_RENDER_TARGET){
@@ -470,6 +547,18 @@ uint RHITexture2D::get_stride() const
 			return m_width * 8;
 		}
 
+		// a row of 4x4 blocks
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC4_UNORM:{
+			return ((m_width + 3) / 4) * 8;
+		}
+
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC7_UNORM:{
+			return ((m_width + 3) / 4) * 16;
+		}
+
 		default:{
 			return m_width * 4;
 		}
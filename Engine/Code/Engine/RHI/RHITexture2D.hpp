@@ -7,6 +7,8 @@
 
 class RHIDevice;
 class RHIOutput;
+class TextureFile;
+enum TextureFileFormat : u32;
 struct ID3D11Texture2D;
 struct ID3D11RenderTargetView;
 struct ID3D11ShaderResourceView;
@@ -54,5 +56,12 @@ public:
 
 	bool load_from_binary_file(const char* filename, uint width, uint height, ImageFormat format);
 
+	// every mip of a cooked texture, uploaded straight from the file's mapping
+	bool load_from_texture_file(const char* filename);
+	bool load_from_texture_file(const TextureFile& texture_file);
+
 	void CreateViews();
-};
\ No newline at end of file
+};
+
+// what a cooked texture is created as, cube maps included
+ImageFormat get_texture_file_image_format(TextureFileFormat format);
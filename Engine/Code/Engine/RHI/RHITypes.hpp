@@ -83,5 +83,12 @@ enum ImageFormat
 	IMAGE_FORMAT_R32G32,
 	IMAGE_FORMAT_R32G32B32,
 	IMAGE_FORMAT_R16G16B16A16,
+
+	// block compressed, sampled as unorm
+	IMAGE_FORMAT_BC1,
+	IMAGE_FORMAT_BC3,
+	IMAGE_FORMAT_BC4,
+	IMAGE_FORMAT_BC5,
+	IMAGE_FORMAT_BC7,
 	NUM_IMAGE_FORMATS
 };
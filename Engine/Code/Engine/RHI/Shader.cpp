@@ -4,6 +4,9 @@
 #include "Engine/Core/xml.hpp"
 #include "Engine/Profile/auto_profile_log_scope.h"
 #include "Engine/RHI/ShaderProgram.hpp"
+#include "Engine/RHI/shader_cache.h"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/log.h"
 
 //------------------------------------------------------------------------------
 // Shader
@@ -33,6 +36,27 @@ void Shader::shutdown()
 	s_database.clear();
 }
 
+uint Shader::reload_changed(const std::vector<std::string>& changed_filenames)
+{
+	uint reload_count = 0;
+
+	std::map<std::string, Shader*>::iterator it;
+	for(it = s_database.begin(); it != s_database.end(); it++){
+		// compute shaders don't have a program
+		ShaderProgram* program = it->second->m_shader_program;
+		if((nullptr == program) || !program->depends_on_any(changed_filenames)){
+			continue;
+		}
+
+		if(program->reload()){
+			log_printf("Reloaded shader [%s]\n", it->first.c_str());
+			reload_count++;
+		}
+	}
+
+	return reload_count;
+}
+
 Shader::Shader(const char* shader_xml_file)
 	:m_raster_state(SimpleRenderer::DEFAULT_RASTER_STATE)
 	,m_depth_stencil_state(SimpleRenderer::DEFAULT_DEPTH_STENCIL_STATE)
@@ -197,4 +221,18 @@ BlendState* Shader::create_blend_state_from_xml(const XMLElement& blend_xml)
 int Shader::find_bind_index_for_name(const char* bind_name) const
 {
 	return m_shader_program->find_bind_index_for_name(bind_name);
-}
\ No newline at end of file
+}
+
+COMMAND(shader_reload, "Rebuilds every shader whose file or includes changed since it was loaded")
+{
+	UNUSED(args);
+
+	std::vector<std::string> changed_filenames;
+	g_theRenderer->m_device->m_shader_cache->find_changed_files(&changed_filenames);
+	for(const std::string& filename : changed_filenames){
+		console_info("changed: %s", filename.c_str());
+	}
+
+	uint reload_count = Shader::reload_changed(changed_filenames);
+	console_success("Reloaded %u shaders", reload_count);
+}
@@ -27,6 +27,9 @@ public:
 	static Shader* find_or_create(const char* shader_xml_file);
 	static void shutdown();
 
+	// rebuilds the program of every shader that uses one of the files, returns how many were
+	static uint reload_changed(const std::vector<std::string>& changed_filenames);
+
 public:
 	Shader(const char* shader_xml_file);
 	Shader(ShaderProgram* shader_program, 
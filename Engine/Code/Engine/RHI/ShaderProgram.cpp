@@ -2,6 +2,7 @@
 #include "Engine/RHI/RHIDevice.hpp"
 #include "Engine/RHI/VertexShaderStage.hpp"
 #include "Engine/RHI/FragmentShaderStage.hpp"
+#include "Engine/RHI/shader_cache.h"
 
 #include "Engine/Renderer/Vertex3.hpp"
 
@@ -9,6 +10,7 @@
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/StringUtils.hpp"
 #include "Engine/Core/Common.hpp"
+#include "Engine/Core/log.h"
 
 #include "Engine/Profile/auto_profile_log_scope.h"
 
@@ -20,6 +22,46 @@ void load_shader_from_file(char** out_shader_text, const char* shader_filename)
 	ASSERT_OR_DIE(LoadBinaryFileToBuffer(out_shader_text, shader_filename), error_message);
 }
 
+static void add_stage_source_from_file(std::vector<shader_stage_source_t>* sources, ShaderStageType type, const char* filename)
+{
+	if(nullptr == filename || 0 == strlen(filename)){
+		return;
+	}
+
+	shader_stage_source_t source;
+	source.type = type;
+	source.filename = filename;
+
+	std::string error_message = Stringf("Failed to load shader [file: %s]\n", filename);
+	ASSERT_OR_DIE(read_shader_file(source.filename, &source.text, nullptr), error_message);
+
+	sources->push_back(source);
+}
+
+const char* get_shader_stage_entry_point(ShaderStageType type)
+{
+	switch(type){
+		case SHADER_STAGE_VERTEX:	return DEFAULT_VERTEX_SHADER_ENTRY_POINT;
+		case SHADER_STAGE_HULL:		return DEFAULT_HULL_SHADER_ENTRY_POINT;
+		case SHADER_STAGE_DOMAIN:	return DEFAULT_DOMAIN_SHADER_ENTRY_POINT;
+		case SHADER_STAGE_GEOMETRY:	return DEFAULT_GEOMETRY_SHADER_ENTRY_POINT;
+		case SHADER_STAGE_FRAGMENT:	return DEFAULT_FRAGMENT_SHADER_ENTRY_POINT;
+		default:					return nullptr;
+	}
+}
+
+const char* get_shader_stage_target(ShaderStageType type)
+{
+	switch(type){
+		case SHADER_STAGE_VERTEX:	return DX_VERTEX_SHADER_TARGET;
+		case SHADER_STAGE_HULL:		return DX_HULL_SHADER_TARGET;
+		case SHADER_STAGE_DOMAIN:	return DX_DOMAIN_SHADER_TARGET;
+		case SHADER_STAGE_GEOMETRY:	return DX_GEOMETRY_SHADER_TARGET;
+		case SHADER_STAGE_FRAGMENT:	return DX_FRAGMENT_SHADER_TARGET;
+		default:					return nullptr;
+	}
+}
+
 ShaderProgram::ShaderProgram(RHIDevice* owner)
 	:m_owner(owner)
 	,m_vertex_stage(nullptr)
@@ -49,20 +91,12 @@ ShaderProgram::ShaderProgram(RHIDevice* owner, const char* vertex_filename, cons
     ,m_geometry_stage(nullptr)
 	,m_fragment_stage(nullptr)
 {
-	if(strcmp(vertex_filename, fragment_filename) == 0){
-        if(nullptr != geometry_filename) {
-            if(strcmp(vertex_filename, geometry_filename) == 0){
-        		load_all_from_single_file(vertex_filename);
-                return;
-            }
-        }else{
-    		load_all_from_single_file(vertex_filename);
-        }
-	}
-
-	load_vertex_stage_from_file(vertex_filename);
-	load_geometry_stage_from_file(geometry_filename);
-	load_fragment_stage_from_file(fragment_filename);
+	// a file shared by several stages is read once per stage, the compiles still run together
+	std::vector<shader_stage_source_t> sources;
+	add_stage_source_from_file(&sources, SHADER_STAGE_VERTEX, vertex_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_GEOMETRY, geometry_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_FRAGMENT, fragment_filename);
+	load_stages(sources);
 }
 
 ShaderProgram::ShaderProgram(RHIDevice* owner, const char* vertex_filename, const char* hull_filename, const char* domain_filename, const char* geometry_filename, const char* fragment_filename)
@@ -73,11 +107,13 @@ ShaderProgram::ShaderProgram(RHIDevice* owner, const char* vertex_filename, cons
     ,m_geometry_stage(nullptr)
 	,m_fragment_stage(nullptr)
 {
-	load_vertex_stage_from_file(vertex_filename);
-	load_hull_stage_from_file(hull_filename);
-	load_domain_stage_from_file(domain_filename);
-	load_geometry_stage_from_file(geometry_filename);
-	load_fragment_stage_from_file(fragment_filename);
+	std::vector<shader_stage_source_t> sources;
+	add_stage_source_from_file(&sources, SHADER_STAGE_VERTEX, vertex_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_HULL, hull_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_DOMAIN, domain_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_GEOMETRY, geometry_filename);
+	add_stage_source_from_file(&sources, SHADER_STAGE_FRAGMENT, fragment_filename);
+	load_stages(sources);
 }
 
 ShaderProgram::~ShaderProgram() 
@@ -91,14 +127,164 @@ ShaderProgram::~ShaderProgram()
 
 void ShaderProgram::load_all_from_single_file(const char* single_filename, bool load_geometry_stage)
 {
-	char* shader_source = nullptr;
-	load_shader_from_file(&shader_source, single_filename);
+	std::vector<shader_stage_source_t> sources;
+	add_stage_source_from_file(&sources, SHADER_STAGE_VERTEX, single_filename);
+	if(sources.empty()){
+		return;
+	}
 
-	load_vertex_stage_from_text(shader_source, single_filename);
+	shader_stage_source_t stage_source = sources[0];
     if(load_geometry_stage){
-        load_geometry_stage_from_text(shader_source, single_filename);
+		stage_source.type = SHADER_STAGE_GEOMETRY;
+		sources.push_back(stage_source);
     }
-	load_fragment_stage_from_text(shader_source, single_filename);
+	stage_source.type = SHADER_STAGE_FRAGMENT;
+	sources.push_back(stage_source);
+
+	load_stages(sources);
+}
+
+void ShaderProgram::load_stages(const std::vector<shader_stage_source_t>& sources)
+{
+	std::vector<shader_compile_request_t> requests(sources.size());
+	for(size_t source_idx = 0; source_idx < sources.size(); ++source_idx){
+		const shader_stage_source_t& source = sources[source_idx];
+		init_shader_compile_desc(&requests[source_idx].desc,
+								 source.text.c_str(),
+								 strlen(source.text.c_str()),
+								 get_shader_stage_entry_point(source.type),
+								 get_shader_stage_target(source.type),
+								 source.filename.c_str());
+	}
+
+	// a stage that failed compiles again below and dies with its errors, like it always has
+	m_owner->m_shader_cache->compile_batch(requests.data(), (uint)requests.size());
+	for(shader_compile_request_t& request : requests){
+		DX_SAFE_RELEASE(request.byte_code);
+	}
+
+	for(const shader_stage_source_t& source : sources){
+		create_stage(source);
+	}
+}
+
+void ShaderProgram::create_stage(const shader_stage_source_t& source)
+{
+	const char* text = source.text.c_str();
+	const char* filename = source.filename.c_str();
+
+	switch(source.type){
+		case SHADER_STAGE_VERTEX:
+			SAFE_DELETE(m_vertex_stage);
+			load_vertex_stage_from_text(text, filename);
+			break;
+		case SHADER_STAGE_HULL:
+			SAFE_DELETE(m_hull_stage);
+			load_hull_stage_from_text(text, filename);
+			break;
+		case SHADER_STAGE_DOMAIN:
+			SAFE_DELETE(m_domain_stage);
+			load_domain_stage_from_text(text, filename);
+			break;
+		case SHADER_STAGE_GEOMETRY:
+			SAFE_DELETE(m_geometry_stage);
+			load_geometry_stage_from_text(text, filename);
+			break;
+		case SHADER_STAGE_FRAGMENT:
+			SAFE_DELETE(m_fragment_stage);
+			load_fragment_stage_from_text(text, filename);
+			break;
+		default:
+			break;
+	}
+}
+
+ShaderStage* ShaderProgram::get_stage(ShaderStageType type) const
+{
+	switch(type){
+		case SHADER_STAGE_VERTEX:	return m_vertex_stage;
+		case SHADER_STAGE_HULL:		return m_hull_stage;
+		case SHADER_STAGE_DOMAIN:	return m_domain_stage;
+		case SHADER_STAGE_GEOMETRY:	return m_geometry_stage;
+		case SHADER_STAGE_FRAGMENT:	return m_fragment_stage;
+		default:					return nullptr;
+	}
+}
+
+bool ShaderProgram::depends_on_any(const std::vector<std::string>& filenames) const
+{
+	for(uint type = 0; type < NUM_SHADER_STAGE_TYPES; ++type){
+		ShaderStage* stage = get_stage((ShaderStageType)type);
+		if(nullptr == stage){
+			continue;
+		}
+
+		for(const std::string& filename : filenames){
+			if(stage->depends_on(filename)){
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool ShaderProgram::reload()
+{
+	std::vector<shader_stage_source_t> sources;
+	for(uint type = 0; type < NUM_SHADER_STAGE_TYPES; ++type){
+		ShaderStage* stage = get_stage((ShaderStageType)type);
+		if(nullptr == stage){
+			continue;
+		}
+
+		// made from text, there's nothing to reread
+		if(stage->m_filename.empty()){
+			return false;
+		}
+
+		shader_stage_source_t source;
+		source.type = (ShaderStageType)type;
+		source.filename = stage->m_filename;
+		if(!read_shader_file(source.filename, &source.text, nullptr)){
+			log_warningf("Can't reload shader [%s], failed to read it\n", source.filename.c_str());
+			return false;
+		}
+		sources.push_back(source);
+	}
+
+	if(sources.empty()){
+		return false;
+	}
+
+	std::vector<shader_compile_request_t> requests(sources.size());
+	for(size_t source_idx = 0; source_idx < sources.size(); ++source_idx){
+		const shader_stage_source_t& source = sources[source_idx];
+		init_shader_compile_desc(&requests[source_idx].desc,
+								 source.text.c_str(),
+								 strlen(source.text.c_str()),
+								 get_shader_stage_entry_point(source.type),
+								 get_shader_stage_target(source.type),
+								 source.filename.c_str());
+	}
+
+	bool compiled = m_owner->m_shader_cache->compile_batch(requests.data(), (uint)requests.size());
+	for(size_t request_idx = 0; request_idx < requests.size(); ++request_idx){
+		shader_compile_request_t& request = requests[request_idx];
+		if(nullptr == request.byte_code){
+			log_warningf("Shader [%s] failed to compile, keeping the last build\n%s\n", sources[request_idx].filename.c_str(), request.errors.c_str());
+		}
+		DX_SAFE_RELEASE(request.byte_code);
+	}
+
+	if(!compiled){
+		return false;
+	}
+
+	for(const shader_stage_source_t& source : sources){
+		create_stage(source);
+	}
+	return true;
 }
 
 void ShaderProgram::load_vertex_stage_from_file(const char* vertex_filename)
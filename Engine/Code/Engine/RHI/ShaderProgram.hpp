@@ -7,7 +7,31 @@
 #include "Engine/RHI/GeometryShaderStage.hpp"
 #include "Engine/RHI/FragmentShaderStage.hpp"
 
+#include <string>
+#include <vector>
+
 class RHIDevice;
+class ShaderStage;
+
+enum ShaderStageType : unsigned int
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_HULL,
+	SHADER_STAGE_DOMAIN,
+	SHADER_STAGE_GEOMETRY,
+	SHADER_STAGE_FRAGMENT,
+	NUM_SHADER_STAGE_TYPES
+};
+
+struct shader_stage_source_t
+{
+	ShaderStageType type;
+	std::string filename;
+	std::string text;
+};
+
+const char* get_shader_stage_entry_point(ShaderStageType type);
+const char* get_shader_stage_target(ShaderStageType type);
 
 class ShaderProgram
 {
@@ -45,4 +69,17 @@ public:
 	void load_fragment_stage_from_text(const char* fragment_text, const char* opt_filename = nullptr);
 
 	int find_bind_index_for_name(const char* bind_name) const;
+
+	ShaderStage* get_stage(ShaderStageType type) const;
+	bool depends_on_any(const std::vector<std::string>& filenames) const;
+
+	// Rebuilds every stage from its file. The stages are only replaced once all of
+	// them compile, a mistake mid edit logs the errors and keeps the last good build
+	bool reload();
+
+private:
+	// compiles every stage at once on the job system first, the stages made
+	// after find their byte code waiting in the shader cache
+	void load_stages(const std::vector<shader_stage_source_t>& sources);
+	void create_stage(const shader_stage_source_t& source);
 };
\ No newline at end of file
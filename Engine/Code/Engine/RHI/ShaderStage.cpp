@@ -1,5 +1,6 @@
 #include "Engine/RHI/ShaderStage.hpp"
 #include "Engine/RHI/RHIDevice.hpp"
+#include "Engine/RHI/shader_cache.h"
 #include "Engine/Renderer/Vertex3.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/Common.hpp"
@@ -63,10 +64,10 @@ const char* constant_buffer_typename(D3D_CBUFFER_TYPE cbuffer_type)
 // ShaderStage
 //-----------------------------------
 
-ShaderStage::ShaderStage(const char* shader_raw_source, const size_t shader_raw_source_size, const char* entry_point, const char* target, const char* opt_filename)
+ShaderStage::ShaderStage(RHIDevice* rhi_device, const char* shader_raw_source, const size_t shader_raw_source_size, const char* entry_point, const char* target, const char* opt_filename)
 	:m_byte_code(nullptr)
 {
-	compile_shader_source_to_blob(opt_filename, shader_raw_source, shader_raw_source_size, entry_point, target);
+	compile_shader_source_to_blob(rhi_device, opt_filename, shader_raw_source, shader_raw_source_size, entry_point, target);
 	//print_constants();
 	//cache_shader_resources();
 }
@@ -76,49 +77,36 @@ ShaderStage::~ShaderStage()
 	DX_SAFE_RELEASE(m_byte_code);
 }
 
-void ShaderStage::compile_shader_source_to_blob(const char* opt_filename, 
+// the shader cache compiles on a miss, with the same flags this used to pass D3DCompile itself
+void ShaderStage::compile_shader_source_to_blob(RHIDevice* rhi_device,
+											    const char* opt_filename, 
 											    const void* source_code, 
 											    const size_t source_code_size, 
 											    const char* entry_point, 
 											    const char* target)
 {
-   DWORD compile_flags = 0U;
-   #if defined(DEBUG_SHADERS)
-      compile_flags |= D3DCOMPILE_DEBUG;
-      compile_flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
-      compile_flags |= D3DCOMPILE_WARNINGS_ARE_ERRORS;
-   #else 
-      //compile_flags |= D3DCOMPILE_SKIP_VALIDATION;
-      compile_flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
-   #endif
-
-   ID3DBlob *errors = nullptr;
-
    PROFILE_LOG_SCOPE("Compiling shaders");
 
-   HRESULT hr = ::D3DCompile( source_code, 
-      source_code_size,                   
-      opt_filename,                       
-      nullptr,                            
-      D3D_COMPILE_STANDARD_FILE_INCLUDE,  
-      entry_point,                         
-      target,                             
-      compile_flags,                      
-      0,                                  
-      &m_byte_code,                       
-      &errors );                          
-
-   if (FAILED(hr) || (errors != nullptr)) {
-      if (errors != nullptr) {
-         char *error_string = (char*) errors->GetBufferPointer();
-         DebuggerPrintf( "Failed to compile [%s].  Compiler gave the following output;\n%s", 
-            opt_filename, 
-            error_string );
-         DX_SAFE_RELEASE(errors);
-      }
-   } 
+   shader_compile_request_t request;
+   init_shader_compile_desc(&request.desc, (const char*)source_code, source_code_size, entry_point, target, opt_filename);
+   rhi_device->m_shader_cache->compile(&request);
+
+   if (!request.errors.empty()) {
+      DebuggerPrintf( "Failed to compile [%s].  Compiler gave the following output;\n%s", 
+         opt_filename, 
+         request.errors.c_str() );
+   }
 
+   m_byte_code = request.byte_code;
    ASSERT_OR_DIE(m_byte_code != nullptr, "Shader byte code compilation failed.\n");
+
+   // text without a file has no dependency of its own, but can still include files
+   for (const shader_dependency_t& dependency : request.key.dependencies) {
+      m_dependencies.push_back(dependency.filename);
+   }
+   if (!request.key.dependencies.empty() && (nullptr != opt_filename) && (request.key.dependencies[0].filename == normalize_shader_path(opt_filename))) {
+      m_filename = request.key.dependencies[0].filename;
+   }
 }
 
 void ShaderStage::print_constants()
@@ -218,6 +206,17 @@ void ShaderStage::cache_shader_resources()
 	DX_SAFE_RELEASE(reflector);
 }
 
+bool ShaderStage::depends_on(const std::string& filename) const
+{
+	for(const std::string& dependency : m_dependencies){
+		if(dependency == filename){
+			return true;
+		}
+	}
+
+	return false;
+}
+
 int ShaderStage::find_bind_index_for_name(const char* bind_name)
 {
 	for(const shader_resource_t& res : m_shader_resources){
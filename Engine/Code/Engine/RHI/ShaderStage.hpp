@@ -54,14 +54,20 @@ public:
 	ID3DBlob*						m_byte_code;
 	std::vector<shader_resource_t>	m_shader_resources;
 
+	// the file the stage was compiled from (empty for text) and every file it includes
+	std::string						m_filename;
+	std::vector<std::string>		m_dependencies;
+
 public:
-	ShaderStage(const char* shader_raw_source, const size_t shader_raw_source_size, const char* entry_point, const char* target, const char* opt_filename = nullptr);
+	ShaderStage(RHIDevice* rhi_device, const char* shader_raw_source, const size_t shader_raw_source_size, const char* entry_point, const char* target, const char* opt_filename = nullptr);
 	virtual ~ShaderStage();
 
 	int find_bind_index_for_name(const char* bind_name);
+	bool depends_on(const std::string& filename) const;
 
 protected:
-	void compile_shader_source_to_blob(const char* opt_filename, 
+	void compile_shader_source_to_blob(RHIDevice* rhi_device,
+									   const char* opt_filename, 
 									   const void* source_code, 
 									   const size_t source_code_size, 
 									   const char* entry_point, 
@@ -3,7 +3,7 @@
 #include "Engine/Renderer/Vertex3.hpp"
 
 VertexShaderStage::VertexShaderStage(RHIDevice* rhi_device, const char* shader_raw_source, const size_t shader_raw_source_size, const char* entry_point, const char* opt_filename)
-	:ShaderStage(shader_raw_source, shader_raw_source_size, entry_point, DX_VERTEX_SHADER_TARGET, opt_filename)
+	:ShaderStage(rhi_device, shader_raw_source, shader_raw_source_size, entry_point, DX_VERTEX_SHADER_TARGET, opt_filename)
 	,m_dx_vertex_shader(nullptr)
 	,m_dx_input_layout(nullptr)
 {
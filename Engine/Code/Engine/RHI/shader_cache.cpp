@@ -0,0 +1,441 @@
+#include "Engine/RHI/shader_cache.h"
+#include "Engine/RHI/RHIDevice.hpp"
+#include "Engine/Config/EngineConfig.hpp"
+#include "Engine/Engine.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// anything bigger in the directory is a corrupt header, real stages are tens of kilobytes
+#define MAX_SHADER_CACHE_BYTE_CODE_SIZE (64 * 1024 * 1024)
+
+u32 get_shader_compile_flags()
+{
+	u32 compile_flags = 0U;
+	#if defined(DEBUG_SHADERS)
+		compile_flags |= D3DCOMPILE_DEBUG;
+		compile_flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
+		compile_flags |= D3DCOMPILE_WARNINGS_ARE_ERRORS;
+	#else
+		//compile_flags |= D3DCOMPILE_SKIP_VALIDATION;
+		compile_flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+	#endif
+	return compile_flags;
+}
+
+void init_shader_compile_desc(shader_compile_desc_t* out_desc,
+							  const char* source,
+							  size_t source_size,
+							  const char* entry_point,
+							  const char* target,
+							  const char* opt_filename)
+{
+	out_desc->source = source;
+	out_desc->source_size = source_size;
+	out_desc->filename = opt_filename;
+	out_desc->entry_point = entry_point;
+	out_desc->target = target;
+	out_desc->compile_flags = get_shader_compile_flags();
+	out_desc->compiler_version = D3D_COMPILER_VERSION;
+	out_desc->defines.clear();
+}
+
+shader_compile_request_t::shader_compile_request_t()
+	:byte_code(nullptr)
+{
+	key.hash = 0;
+}
+
+ShaderCache::ShaderCache(const char* directory)
+	:m_directory(directory)
+	,m_directory_created(false)
+	,m_next_watch_time(0.0)
+{
+	MemZero(&m_stats);
+
+	#if defined(FINAL_BUILD)
+		m_watch_enabled = false;
+	#else
+		m_watch_enabled = true;
+	#endif
+}
+
+ShaderCache::~ShaderCache()
+{
+	clear_memory();
+}
+
+// with m_lock held, the returned byte code has a reference for the caller
+ID3DBlob* ShaderCache::find_in_memory(u64 key)
+{
+	std::map<u64, ID3DBlob*>::iterator found = m_entries.find(key);
+	if(found == m_entries.end()){
+		return nullptr;
+	}
+
+	found->second->AddRef();
+	return found->second;
+}
+
+// with m_lock held
+void ShaderCache::add_entry(u64 key, ID3DBlob* byte_code)
+{
+	if(m_entries.find(key) != m_entries.end()){
+		return;
+	}
+
+	byte_code->AddRef();
+	m_entries[key] = byte_code;
+}
+
+std::string ShaderCache::get_cache_filename(u64 key) const
+{
+	return Stringf("%s%016llx%s", m_directory.c_str(), (unsigned long long)key, SHADER_CACHE_FILE_EXTENSION);
+}
+
+ID3DBlob* ShaderCache::load_from_directory(u64 key)
+{
+	std::string filename = get_cache_filename(key);
+	FILE* file = fopen(filename.c_str(), "rb");
+	if(nullptr == file){
+		return nullptr;
+	}
+
+	shader_cache_file_header_t header;
+	bool is_valid = (fread(&header, sizeof(header), 1, file) == 1)
+		&& (header.magic == SHADER_CACHE_FILE_MAGIC)
+		&& (header.version == SHADER_CACHE_FILE_VERSION)
+		&& (header.key == key)
+		&& (header.byte_code_size > 0)
+		&& (header.byte_code_size <= MAX_SHADER_CACHE_BYTE_CODE_SIZE);
+
+	ID3DBlob* byte_code = nullptr;
+	if(is_valid){
+		is_valid = SUCCEEDED(D3DCreateBlob(header.byte_code_size, &byte_code))
+			&& (fread(byte_code->GetBufferPointer(), 1, header.byte_code_size, file) == header.byte_code_size)
+			&& (hash_shader_bytes(byte_code->GetBufferPointer(), header.byte_code_size) == header.byte_code_hash);
+	}
+	fclose(file);
+
+	if(!is_valid){
+		log_warningf("Shader cache file [%s] is corrupt or out of date, compiling instead\n", filename.c_str());
+		DX_SAFE_RELEASE(byte_code);
+	}
+	return byte_code;
+}
+
+// written next to the final name and moved over it, so a crash can't leave half a file behind
+void ShaderCache::save_to_directory(u64 key, ID3DBlob* byte_code)
+{
+	if(!m_directory_created){
+		create_directory(m_directory.c_str());
+		m_directory_created = true;
+	}
+
+	shader_cache_file_header_t header;
+	MemZero(&header);
+	header.magic = SHADER_CACHE_FILE_MAGIC;
+	header.version = SHADER_CACHE_FILE_VERSION;
+	header.key = key;
+	header.byte_code_size = (u32)byte_code->GetBufferSize();
+	header.byte_code_hash = hash_shader_bytes(byte_code->GetBufferPointer(), byte_code->GetBufferSize());
+
+	std::string filename = get_cache_filename(key);
+	std::string temp_filename = filename + ".tmp";
+
+	FILE* file = fopen(temp_filename.c_str(), "wb");
+	if(nullptr == file){
+		log_warningf("Failed to write shader cache file [%s]\n", filename.c_str());
+		return;
+	}
+
+	bool written = (fwrite(&header, sizeof(header), 1, file) == 1)
+		&& (fwrite(byte_code->GetBufferPointer(), 1, header.byte_code_size, file) == header.byte_code_size);
+	fclose(file);
+
+	remove(filename.c_str());
+	if(!written || (rename(temp_filename.c_str(), filename.c_str()) != 0)){
+		log_warningf("Failed to write shader cache file [%s]\n", filename.c_str());
+		remove(temp_filename.c_str());
+	}
+}
+
+// with m_lock held. A file already watched keeps the hash it had, if it changed
+// since, the stages made before still need to hear about it
+void ShaderCache::watch_dependencies(const shader_cache_key_t& key)
+{
+	for(const shader_dependency_t& dependency : key.dependencies){
+		// no write time yet, so the first check rereads it once and can't miss an edit made since it was hashed
+		shader_watched_file_t watched;
+		watched.content_hash = dependency.found ? dependency.content_hash : 0;
+		watched.write_time = 0;
+		m_watched_files.insert(std::make_pair(dependency.filename, watched));
+	}
+}
+
+bool ShaderCache::find(shader_compile_request_t* request)
+{
+	DX_SAFE_RELEASE(request->byte_code);
+	request->errors.clear();
+
+	make_shader_cache_key(request->desc, read_shader_file, nullptr, &request->key);
+	u64 key = request->key.hash;
+
+	SCOPE_LOCK(&m_lock);
+	m_stats.requests++;
+	watch_dependencies(request->key);
+
+	request->byte_code = find_in_memory(key);
+	if(nullptr != request->byte_code){
+		m_stats.memory_hits++;
+		return true;
+	}
+
+	request->byte_code = load_from_directory(key);
+	if(nullptr != request->byte_code){
+		m_stats.disk_hits++;
+		add_entry(key, request->byte_code);
+		return true;
+	}
+
+	return false;
+}
+
+void ShaderCache::compile_job(shader_compile_request_t* request, double* out_seconds)
+{
+	double start_time = get_current_time_seconds();
+
+	const shader_compile_desc_t& desc = request->desc;
+
+	std::vector<D3D_SHADER_MACRO> macros;
+	for(const shader_define_t& define : desc.defines){
+		D3D_SHADER_MACRO macro;
+		macro.Name = define.name.c_str();
+		macro.Definition = define.value.c_str();
+		macros.push_back(macro);
+	}
+	D3D_SHADER_MACRO terminator = { nullptr, nullptr };
+	macros.push_back(terminator);
+
+	ID3DBlob* errors = nullptr;
+	HRESULT hr = ::D3DCompile(desc.source,
+		desc.source_size,
+		desc.filename,
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		desc.entry_point,
+		desc.target,
+		desc.compile_flags,
+		0,
+		&request->byte_code,
+		&errors);
+
+	// warnings come back the same way errors do
+	if(nullptr != errors){
+		request->errors = (const char*)errors->GetBufferPointer();
+		DX_SAFE_RELEASE(errors);
+	}
+
+	if(FAILED(hr)){
+		DX_SAFE_RELEASE(request->byte_code);
+	}
+
+	*out_seconds = get_current_time_seconds() - start_time;
+}
+
+void ShaderCache::finish_compile(shader_compile_request_t* request, double seconds)
+{
+	SCOPE_LOCK(&m_lock);
+	m_stats.compile_seconds += seconds;
+
+	if(nullptr == request->byte_code){
+		m_stats.failures++;
+		return;
+	}
+
+	m_stats.compiles++;
+	add_entry(request->key.hash, request->byte_code);
+	save_to_directory(request->key.hash, request->byte_code);
+}
+
+bool ShaderCache::compile(shader_compile_request_t* request)
+{
+	return compile_batch(request, 1);
+}
+
+bool ShaderCache::compile_batch(shader_compile_request_t* requests, uint count)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	std::vector<uint> misses;
+	for(uint request_idx = 0; request_idx < count; ++request_idx){
+		if(!find(&requests[request_idx])){
+			misses.push_back(request_idx);
+		}
+	}
+
+	std::vector<double> seconds(misses.size(), 0.0);
+
+	// a lone miss isn't worth a job
+	if(misses.size() == 1){
+		compile_job(&requests[misses[0]], &seconds[0]);
+	}else if(misses.size() > 1){
+		std::vector<Job*> jobs;
+		for(uint miss_idx = 0; miss_idx < misses.size(); ++miss_idx){
+			Job* job = job_create(JOB_TYPE_GENERIC, compile_job, &requests[misses[miss_idx]], &seconds[miss_idx]);
+			job_dispatch(job);
+			jobs.push_back(job);
+		}
+
+		for(Job* job : jobs){
+			job_wait_and_release(job);
+		}
+	}
+
+	bool all_compiled = true;
+	for(uint miss_idx = 0; miss_idx < misses.size(); ++miss_idx){
+		shader_compile_request_t* request = &requests[misses[miss_idx]];
+		finish_compile(request, seconds[miss_idx]);
+		all_compiled = all_compiled && (nullptr != request->byte_code);
+	}
+	return all_compiled;
+}
+
+void ShaderCache::find_changed_files(std::vector<std::string>* out_filenames)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	SCOPE_LOCK(&m_lock);
+
+	std::string text;
+	std::map<std::string, shader_watched_file_t>::iterator it;
+	for(it = m_watched_files.begin(); it != m_watched_files.end(); ++it){
+		shader_watched_file_t& watched = it->second;
+
+		// only a file that's been written since is read again, a save without edits still hashes the same
+		u64 write_time = get_file_write_time(it->first.c_str());
+		if(write_time == watched.write_time){
+			continue;
+		}
+		watched.write_time = write_time;
+
+		u64 content_hash = read_shader_file(it->first, &text, nullptr) ? hash_shader_bytes(text.c_str(), text.size()) : 0;
+		if(content_hash != watched.content_hash){
+			watched.content_hash = content_hash;
+			out_filenames->push_back(it->first);
+		}
+	}
+}
+
+bool ShaderCache::is_watch_due()
+{
+	if(!m_watch_enabled){
+		return false;
+	}
+
+	double now = get_current_time_seconds();
+	if(now < m_next_watch_time){
+		return false;
+	}
+
+	m_next_watch_time = now + DEFAULT_SHADER_WATCH_INTERVAL_SECONDS;
+	return true;
+}
+
+void ShaderCache::set_watch_enabled(bool enabled) { m_watch_enabled = enabled; }
+bool ShaderCache::is_watch_enabled() const { return m_watch_enabled; }
+
+void ShaderCache::clear_memory()
+{
+	SCOPE_LOCK(&m_lock);
+
+	std::map<u64, ID3DBlob*>::iterator it;
+	for(it = m_entries.begin(); it != m_entries.end(); ++it){
+		DX_SAFE_RELEASE(it->second);
+	}
+	m_entries.clear();
+}
+
+void ShaderCache::clear_directory()
+{
+	clear_memory();
+
+	SCOPE_LOCK(&m_lock);
+	std::vector<std::string> files = find_files_in_directory(m_directory.c_str(), "*" SHADER_CACHE_FILE_EXTENSION);
+	for(const std::string& file : files){
+		remove((m_directory + file).c_str());
+	}
+}
+
+shader_cache_stats_t ShaderCache::get_stats()
+{
+	SCOPE_LOCK(&m_lock);
+
+	shader_cache_stats_t stats = m_stats;
+	stats.entries = (uint)m_entries.size();
+	stats.watched_files = (uint)m_watched_files.size();
+	return stats;
+}
+
+COMMAND(shader_cache_stats, "Prints how many shader stages came from memory, the cache directory or the compiler")
+{
+	UNUSED(args);
+
+	shader_cache_stats_t stats = g_theRenderer->m_device->m_shader_cache->get_stats();
+
+	console_info("----Shader cache----");
+	console_info("entries:        %u (%u files watched)", stats.entries, stats.watched_files);
+	console_info("requests:       %u (%u from memory, %u from disk)", stats.requests, stats.memory_hits, stats.disk_hits);
+	console_info("compiles:       %u in %.1f ms (%u failed)", stats.compiles, stats.compile_seconds * 1000.0, stats.failures);
+}
+
+COMMAND(shader_cache_clear, "Forgets every cached shader stage in memory and on disk, the next load of each compiles")
+{
+	UNUSED(args);
+
+	g_theRenderer->m_device->m_shader_cache->clear_directory();
+	console_success("Shader cache cleared");
+}
+
+COMMAND(shader_watch, "[bool:enabled] Turns rebuilding shaders when their files change on or off, toggles without an argument")
+{
+	ShaderCache* cache = g_theRenderer->m_device->m_shader_cache;
+	bool enabled = args.is_at_end() ? !cache->is_watch_enabled() : args.next_bool_arg();
+	cache->set_watch_enabled(enabled);
+	console_info("Shader watch %s", enabled ? "on" : "off");
+}
+
+COMMAND(shader_dependencies, "[string:filename] Prints the cache key of a shader file's fragment stage and every file it was made from")
+{
+	std::string filename = args.next_string_arg();
+
+	std::string text;
+	if(!read_shader_file(filename, &text, nullptr)){
+		console_error("Failed to read [%s]", filename.c_str());
+		return;
+	}
+
+	shader_compile_desc_t desc;
+	init_shader_compile_desc(&desc, text.c_str(), strlen(text.c_str()), DEFAULT_FRAGMENT_SHADER_ENTRY_POINT, DX_FRAGMENT_SHADER_TARGET, filename.c_str());
+
+	shader_cache_key_t key;
+	make_shader_cache_key(desc, read_shader_file, nullptr, &key);
+
+	console_info("key: %016llx", (unsigned long long)key.hash);
+	for(const shader_dependency_t& dependency : key.dependencies){
+		if(dependency.found){
+			console_info("  %016llx %s", (unsigned long long)dependency.content_hash, dependency.filename.c_str());
+		}else{
+			console_error("  missing          %s", dependency.filename.c_str());
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/RHI/DX11.hpp"
+#include "Engine/RHI/shader_cache_key.h"
+#include "Engine/Thread/critical_section.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#define DEFAULT_SHADER_CACHE_DIRECTORY "Data/ShaderCache/"
+#define SHADER_CACHE_FILE_EXTENSION ".cso"
+
+// "SHDC"
+#define SHADER_CACHE_FILE_MAGIC (0x43444853U)
+#define SHADER_CACHE_FILE_VERSION (1)
+
+// how often the files cached byte code was made from are checked for changes
+#define DEFAULT_SHADER_WATCH_INTERVAL_SECONDS (1.0)
+
+struct shader_cache_file_header_t
+{
+	u32 magic;
+	u32 version;
+	u64 key;
+	u64 byte_code_hash;
+	u32 byte_code_size;
+	u32 _padding;
+};
+
+struct shader_watched_file_t
+{
+	// hash of the contents as of the last key or reread, 0 when it couldn't be read
+	u64 content_hash;
+
+	// last write time seen at the last reread, 0 before the first or while the file is missing
+	u64 write_time;
+};
+
+struct shader_compile_request_t
+{
+	shader_compile_desc_t desc;
+
+	// filled in by compile, a reference the caller releases. Null when compiling failed
+	ID3DBlob* byte_code;
+	std::string errors;
+	shader_cache_key_t key;
+
+	shader_compile_request_t();
+};
+
+struct shader_cache_stats_t
+{
+	uint requests;
+	uint memory_hits;
+	uint disk_hits;
+	uint compiles;
+	uint failures;
+	uint entries;
+	uint watched_files;
+	double compile_seconds;
+};
+
+// flags the engine compiles with, DEBUG_SHADERS turns optimization off and debug info on
+u32 get_shader_compile_flags();
+
+// a desc for one stage with the engine's flags and the linked compiler's version
+void init_shader_compile_desc(shader_compile_desc_t* out_desc,
+							  const char* source,
+							  size_t source_size,
+							  const char* entry_point,
+							  const char* target,
+							  const char* opt_filename = nullptr);
+
+// Byte code for shader stages, looked up by a key made from the source and
+// everything it includes (see shader_cache_key.h).
+//
+// A request is answered from memory first, then from a file in the cache
+// directory named by its key, and only compiled when neither has it. What's
+// compiled is written to the directory so the next launch doesn't compile it
+// again. Nothing is ever invalidated by hand, a changed source or include
+// changes the key and the stale entry just stops being asked for.
+//
+// Every file a key was made from is remembered with the hash its contents had.
+// find_changed_files checks their write times and only rereads and rehashes the
+// ones that were written, so stages can be rebuilt when one is edited.
+class ShaderCache
+{
+public:
+	ShaderCache(const char* directory = DEFAULT_SHADER_CACHE_DIRECTORY);
+	~ShaderCache();
+
+	// true when request->byte_code was found or compiled
+	bool compile(shader_compile_request_t* request);
+
+	// Hits are answered on the calling thread, every miss is compiled on its own
+	// job and they're waited on together. True when every request got byte code
+	bool compile_batch(shader_compile_request_t* requests, uint count);
+
+	// the files whose contents differ from when they were last looked at. Each
+	// change is reported once
+	void find_changed_files(std::vector<std::string>* out_filenames);
+
+	// true once every interval, while watching is on
+	bool is_watch_due();
+	void set_watch_enabled(bool enabled);
+	bool is_watch_enabled() const;
+
+	// releases the byte code held in memory, the directory is left alone
+	void clear_memory();
+
+	// deletes every file in the directory as well
+	void clear_directory();
+
+	shader_cache_stats_t get_stats();
+
+private:
+	ID3DBlob* find_in_memory(u64 key);
+	ID3DBlob* load_from_directory(u64 key);
+	void save_to_directory(u64 key, ID3DBlob* byte_code);
+	void add_entry(u64 key, ID3DBlob* byte_code);
+	void watch_dependencies(const shader_cache_key_t& key);
+	std::string get_cache_filename(u64 key) const;
+
+	// lookup without compiling, on the calling thread
+	bool find(shader_compile_request_t* request);
+	void finish_compile(shader_compile_request_t* request, double seconds);
+
+	static void compile_job(shader_compile_request_t* request, double* out_seconds);
+
+private:
+	CriticalSection m_lock;
+	std::string m_directory;
+	bool m_directory_created;
+
+	// each holds a reference, handed out with another
+	std::map<u64, ID3DBlob*> m_entries;
+
+	std::map<std::string, shader_watched_file_t> m_watched_files;
+
+	bool m_watch_enabled;
+	double m_next_watch_time;
+
+	shader_cache_stats_t m_stats;
+};
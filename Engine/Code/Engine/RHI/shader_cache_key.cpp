@@ -0,0 +1,326 @@
+#include "Engine/RHI/shader_cache_key.h"
+
+#include <set>
+#include <stdio.h>
+#include <string.h>
+
+#define SHADER_HASH_PRIME (1099511628211ULL)
+
+shader_compile_desc_t::shader_compile_desc_t()
+	:source(nullptr)
+	,source_size(0)
+	,filename(nullptr)
+	,entry_point(nullptr)
+	,target(nullptr)
+	,compile_flags(0)
+	,compiler_version(0)
+{
+}
+
+// fnv-1a a word at a time like the mesh and texture files, but 64 bits wide since
+// a collision here hands a stage somebody else's byte code
+u64 hash_shader_bytes(const void* data, size_t size, u64 seed)
+{
+	const byte* bytes = (const byte*)data;
+	u64 hash = seed;
+
+	size_t word_count = size / sizeof(u64);
+	for(size_t word_idx = 0; word_idx < word_count; ++word_idx){
+		u64 word;
+		memcpy(&word, bytes + (word_idx * sizeof(u64)), sizeof(u64));
+		hash = (hash ^ word) * SHADER_HASH_PRIME;
+	}
+
+	for(size_t byte_idx = word_count * sizeof(u64); byte_idx < size; ++byte_idx){
+		hash = (hash ^ bytes[byte_idx]) * SHADER_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+static u64 hash_shader_value(u64 hash, u64 value)
+{
+	return hash_shader_bytes(&value, sizeof(value), hash);
+}
+
+// length first, so "ab" + "c" and "a" + "bc" don't hash the same. Null isn't ""
+static u64 hash_shader_string(u64 hash, const char* str, size_t length)
+{
+	if(nullptr == str){
+		return hash_shader_value(hash, ~0ULL);
+	}
+
+	hash = hash_shader_value(hash, (u64)length);
+	return hash_shader_bytes(str, length, hash);
+}
+
+static u64 hash_shader_string(u64 hash, const char* str)
+{
+	return hash_shader_string(hash, str, (nullptr != str) ? strlen(str) : 0);
+}
+
+static u64 hash_shader_string(u64 hash, const std::string& str)
+{
+	return hash_shader_string(hash, str.c_str(), str.size());
+}
+
+std::string normalize_shader_path(const std::string& filename)
+{
+	std::vector<std::string> parts;
+	std::string part;
+	for(size_t idx = 0; idx <= filename.size(); ++idx){
+		char c = (idx < filename.size()) ? filename[idx] : '/';
+		if((c != '/') && (c != '\\')){
+			part += c;
+			continue;
+		}
+
+		if(part == ".."){
+			if(!parts.empty() && (parts.back() != "..")){
+				parts.pop_back();
+			}else{
+				parts.push_back(part);
+			}
+		}else if(!part.empty() && (part != ".")){
+			parts.push_back(part);
+		}
+		part.clear();
+	}
+
+	std::string normalized;
+	if(!filename.empty() && ((filename[0] == '/') || (filename[0] == '\\'))){
+		normalized = "/";
+	}
+
+	for(size_t part_idx = 0; part_idx < parts.size(); ++part_idx){
+		if(part_idx > 0){
+			normalized += '/';
+		}
+		normalized += parts[part_idx];
+	}
+	return normalized;
+}
+
+void find_shader_includes(const char* source, size_t size, std::vector<std::string>* out_includes)
+{
+	const char* c = source;
+	const char* end = source + size;
+
+	// only whitespace and comments so far on this line, where a directive can start
+	bool at_line_start = true;
+
+	while(c < end){
+		if((c[0] == '/') && ((c + 1) < end) && (c[1] == '/')){
+			while((c < end) && (*c != '\n')){
+				++c;
+			}
+			continue;
+		}
+
+		if((c[0] == '/') && ((c + 1) < end) && (c[1] == '*')){
+			c += 2;
+			while(((c + 1) < end) && !((c[0] == '*') && (c[1] == '/'))){
+				++c;
+			}
+			c = ((c + 2) < end) ? (c + 2) : end;
+			continue;
+		}
+
+		if(*c == '\n'){
+			at_line_start = true;
+			++c;
+			continue;
+		}
+
+		if((*c == ' ') || (*c == '\t') || (*c == '\r')){
+			++c;
+			continue;
+		}
+
+		if((*c == '#') && at_line_start){
+			++c;
+			while((c < end) && ((*c == ' ') || (*c == '\t'))){
+				++c;
+			}
+
+			if(((size_t)(end - c) >= 7) && (strncmp(c, "include", 7) == 0)){
+				c += 7;
+				while((c < end) && ((*c == ' ') || (*c == '\t'))){
+					++c;
+				}
+
+				char close = 0;
+				if(c < end){
+					close = (*c == '"') ? '"' : ((*c == '<') ? '>' : 0);
+				}
+
+				if(0 != close){
+					++c;
+					const char* name_start = c;
+					while((c < end) && (*c != close) && (*c != '\n')){
+						++c;
+					}
+					if((c < end) && (*c == close)){
+						out_includes->push_back(std::string(name_start, c));
+						++c;
+					}
+				}
+			}
+
+			at_line_start = false;
+			continue;
+		}
+
+		at_line_start = false;
+		++c;
+	}
+}
+
+bool resolve_shader_include(const std::string& including_filename,
+							const std::string& include,
+							shader_read_file_cb read_cb,
+							void* user_data,
+							std::string* out_filename,
+							std::string* out_text)
+{
+	std::string directory;
+	std::string including = normalize_shader_path(including_filename);
+	size_t slash = including.find_last_of('/');
+	if(slash != std::string::npos){
+		directory = including.substr(0, slash + 1);
+	}
+
+	if(!directory.empty()){
+		std::string beside = normalize_shader_path(directory + include);
+		if(read_cb(beside, out_text, user_data)){
+			*out_filename = beside;
+			return true;
+		}
+	}
+
+	*out_filename = normalize_shader_path(include);
+	if(read_cb(*out_filename, out_text, user_data)){
+		return true;
+	}
+
+	out_text->clear();
+	return false;
+}
+
+static void add_shader_include_dependencies(const std::string& including_filename,
+											const std::string& text,
+											uint depth,
+											shader_read_file_cb read_cb,
+											void* user_data,
+											std::set<std::string>* visited,
+											shader_cache_key_t* out_key)
+{
+	if(depth >= MAX_SHADER_INCLUDE_DEPTH){
+		return;
+	}
+
+	std::vector<std::string> includes;
+	find_shader_includes(text.c_str(), text.size(), &includes);
+
+	for(const std::string& include : includes){
+		shader_dependency_t dependency;
+		std::string include_text;
+		dependency.found = resolve_shader_include(including_filename, include, read_cb, user_data, &dependency.filename, &include_text);
+		dependency.content_hash = dependency.found ? hash_shader_bytes(include_text.c_str(), include_text.size()) : 0;
+
+		// a header pulled in from several places is hashed once, where it's first reached
+		if(!visited->insert(dependency.filename).second){
+			continue;
+		}
+		out_key->dependencies.push_back(dependency);
+
+		if(dependency.found){
+			add_shader_include_dependencies(dependency.filename, include_text, depth + 1, read_cb, user_data, visited, out_key);
+		}
+	}
+}
+
+void make_shader_cache_key(const shader_compile_desc_t& desc, shader_read_file_cb read_cb, void* user_data, shader_cache_key_t* out_key)
+{
+	out_key->dependencies.clear();
+
+	u64 hash = hash_shader_value(SHADER_HASH_SEED, SHADER_CACHE_KEY_VERSION);
+	hash = hash_shader_value(hash, desc.compiler_version);
+	hash = hash_shader_value(hash, desc.compile_flags);
+	hash = hash_shader_string(hash, desc.target);
+	hash = hash_shader_string(hash, desc.entry_point);
+
+	// debug info and error messages carry the name
+	hash = hash_shader_string(hash, desc.filename);
+
+	hash = hash_shader_value(hash, desc.defines.size());
+	for(const shader_define_t& define : desc.defines){
+		hash = hash_shader_string(hash, define.name);
+		hash = hash_shader_string(hash, define.value);
+	}
+
+	hash = hash_shader_string(hash, desc.source, desc.source_size);
+
+	// the stage's own file is watched but not hashed, the key already has the text it was given
+	std::string root_filename;
+	if(nullptr != desc.filename){
+		root_filename = normalize_shader_path(desc.filename);
+
+		std::string file_text;
+		if(read_cb(root_filename, &file_text, user_data)){
+			shader_dependency_t root;
+			root.filename = root_filename;
+			root.content_hash = hash_shader_bytes(file_text.c_str(), file_text.size());
+			root.found = true;
+			out_key->dependencies.push_back(root);
+		}
+	}
+	size_t first_include = out_key->dependencies.size();
+
+	std::set<std::string> visited;
+	visited.insert(root_filename);
+
+	std::string source(desc.source, desc.source_size);
+	add_shader_include_dependencies(root_filename, source, 0, read_cb, user_data, &visited, out_key);
+
+	for(size_t dep_idx = first_include; dep_idx < out_key->dependencies.size(); ++dep_idx){
+		const shader_dependency_t& dependency = out_key->dependencies[dep_idx];
+		hash = hash_shader_string(hash, dependency.filename);
+		hash = hash_shader_value(hash, dependency.found ? 1 : 0);
+		hash = hash_shader_value(hash, dependency.content_hash);
+	}
+
+	out_key->hash = hash;
+}
+
+// no user data, and nothing from Core so the keys build anywhere
+bool read_shader_file(const std::string& filename, std::string* out_text, void*)
+{
+	// text compiled without a file is sometimes named with the text itself
+	if(filename.empty() || (filename.find('\n') != std::string::npos)){
+		return false;
+	}
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if(nullptr == file){
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if(size < 0){
+		fclose(file);
+		return false;
+	}
+
+	out_text->resize((size_t)size);
+	size_t read = (size > 0) ? fread(&(*out_text)[0], 1, (size_t)size, file) : 0;
+	fclose(file);
+
+	if(read != (size_t)size){
+		out_text->clear();
+		return false;
+	}
+	return true;
+}
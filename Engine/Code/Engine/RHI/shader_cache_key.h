@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+
+#include <string>
+#include <vector>
+
+// bump when what goes into the key changes, every entry cached before then misses
+#define SHADER_CACHE_KEY_VERSION (1)
+
+// fnv-1a's 64 bit offset basis
+#define SHADER_HASH_SEED (14695981039346656037ULL)
+
+// deeper than any real include chain, stops a header that includes itself
+#define MAX_SHADER_INCLUDE_DEPTH (32)
+
+// Nothing in here touches the compiler or the os, files are read through a
+// callback so keys can be made (and checked) anywhere.
+typedef bool(*shader_read_file_cb)(const std::string& filename, std::string* out_text, void* user_data);
+
+struct shader_define_t
+{
+	std::string name;
+	std::string value;
+};
+
+// everything that changes the byte code the compiler hands back
+struct shader_compile_desc_t
+{
+	const char* source;
+	size_t source_size;
+
+	// may be null for text that didn't come from a file
+	const char* filename;
+	const char* entry_point;
+	const char* target;
+	u32 compile_flags;
+	u32 compiler_version;
+	std::vector<shader_define_t> defines;
+
+	shader_compile_desc_t();
+};
+
+// a file the byte code depends on, named as the include was resolved. Includes
+// that weren't found are kept too, creating one has to change the key
+struct shader_dependency_t
+{
+	std::string filename;
+	u64 content_hash;
+	bool found;
+};
+
+struct shader_cache_key_t
+{
+	u64 hash;
+
+	// the stage's own file first when it was read from one, then every include in
+	// the order they're first reached
+	std::vector<shader_dependency_t> dependencies;
+};
+
+u64 hash_shader_bytes(const void* data, size_t size, u64 seed = SHADER_HASH_SEED);
+
+// forward slashes, with "." and "dir/.." folded away
+std::string normalize_shader_path(const std::string& filename);
+
+// the names from every #include "name" and #include <name>, in order. Commented
+// out includes are skipped, ones inside #if blocks aren't (they're followed
+// whether or not the compiler would)
+void find_shader_includes(const char* source, size_t size, std::vector<std::string>* out_includes);
+
+// the way D3D_COMPILE_STANDARD_FILE_INCLUDE looks: next to the including file
+// first, then from the working directory
+bool resolve_shader_include(const std::string& including_filename,
+							const std::string& include,
+							shader_read_file_cb read_cb,
+							void* user_data,
+							std::string* out_filename,
+							std::string* out_text);
+
+// Hashes the source, the contents of every include it reaches however deep,
+// the defines, entry point, target, flags and compiler version. Equal keys
+// compile to the same byte code, so the key stands in for preprocessing.
+void make_shader_cache_key(const shader_compile_desc_t& desc, shader_read_file_cb read_cb, void* user_data, shader_cache_key_t* out_key);
+
+// stdio, the read_cb everything outside of checks hands make_shader_cache_key
+bool read_shader_file(const std::string& filename, std::string* out_text, void* user_data);
@@ -0,0 +1,415 @@
+#include "Engine/RHI/texture_cache.h"
+#include "Engine/RHI/RHIDevice.hpp"
+#include "Engine/RHI/RHITexture2D.hpp"
+#include "Engine/Renderer/texture_file.h"
+#include "Engine/Engine.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/Image.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
+#include "Engine/Thread/thread.h"
+#include "Engine/Profile/profiler.h"
+
+#include <algorithm>
+#include <iterator>
+#include <ctype.h>
+
+// the same file asked for as "Data/Images/A.png" and "data\images\a.png" is one entry
+static std::string make_texture_cache_key(const std::string& filename)
+{
+	std::string key = filename;
+	for(char& c : key){
+		c = (c == '\\') ? '/' : (char)tolower((unsigned char)c);
+	}
+	return key;
+}
+
+// a cooked texture next to the image wins, it has mips and maps instead of decoding
+static void decode_texture_cache_entry(texture_cache_entry_t* entry)
+{
+	entry->texture_file = new TextureFile();
+	if(entry->texture_file->open(make_texture_file_name(entry->filename).c_str(), false)){
+		return;
+	}
+	SAFE_DELETE(entry->texture_file);
+
+	entry->image = new Image(entry->filename, IMAGE_LOAD_MODE_FORCE_ALPHA);
+}
+
+static size_t upload_texture_cache_entry(texture_cache_entry_t* entry, bool* out_did_load)
+{
+	size_t byte_size = 0;
+	bool did_load = false;
+	if(nullptr != entry->texture_file){
+		did_load = entry->texture->load_from_texture_file(*entry->texture_file);
+		byte_size = (size_t)entry->texture_file->get_data_size();
+	}else if((nullptr != entry->image) && entry->image->IsValid()){
+		did_load = entry->texture->LoadFromImage(*entry->image);
+		byte_size = (size_t)entry->image->GetWidth() * entry->image->GetHeight() * 4;
+	}
+
+	if(!did_load){
+		log_warningf("Image[%s] load failed!", entry->filename.c_str());
+		entry->texture->LoadFromColor(Rgba::PINK);
+		byte_size = sizeof(Rgba);
+	}
+
+	SAFE_DELETE(entry->texture_file);
+	SAFE_DELETE(entry->image);
+
+	*out_did_load = did_load;
+	return byte_size;
+}
+
+TextureCache::TextureCache(RHIDevice* device, size_t budget_bytes)
+	:m_device(device)
+	,m_budget_bytes(budget_bytes)
+{
+	MemZero(&m_stats);
+}
+
+TextureCache::~TextureCache()
+{
+	clear();
+}
+
+// with m_lock held. The request's reference is taken here, so the entry can't be evicted once the lock drops
+texture_cache_entry_t* TextureCache::find_or_add_entry(const std::string& filename, bool* out_is_new)
+{
+	m_stats.requests++;
+
+	std::string key = make_texture_cache_key(filename);
+	std::map<std::string, texture_cache_entry_t*>::iterator found = m_entries.find(key);
+	if(found != m_entries.end()){
+		texture_cache_entry_t* entry = found->second;
+		m_stats.hits++;
+		if(entry->state == TEXTURE_LOAD_STATE_PENDING){
+			m_stats.in_flight_hits++;
+		}
+
+		entry->ref_count++;
+		remove_from_lru(entry);
+		*out_is_new = false;
+		return entry;
+	}
+
+	texture_cache_entry_t* entry = new texture_cache_entry_t();
+	entry->filename = filename;
+	entry->texture = new RHITexture2D(m_device);
+	entry->state = TEXTURE_LOAD_STATE_PENDING;
+	entry->ref_count = 1;
+	entry->byte_size = 0;
+	entry->queued_cb_count = 0;
+	entry->texture_file = nullptr;
+	entry->image = nullptr;
+	entry->is_in_lru = false;
+
+	m_entries[key] = entry;
+	m_entries_by_texture[entry->texture] = entry;
+	m_stats.pending++;
+
+	*out_is_new = true;
+	return entry;
+}
+
+void TextureCache::load_entry_job(TextureCache* cache, texture_cache_entry_t* entry)
+{
+	decode_texture_cache_entry(entry);
+
+	SCOPE_LOCK(&cache->m_lock);
+	cache->m_stats.decodes++;
+	cache->m_finished_loads.push_back(entry);
+}
+
+RHITexture2D* TextureCache::load_async(const std::string& filename, texture_load_cb cb)
+{
+	texture_cache_entry_t* entry = nullptr;
+	bool is_new = false;
+	bool is_loaded = false;
+	{
+		SCOPE_LOCK(&m_lock);
+		entry = find_or_add_entry(filename, &is_new);
+		is_loaded = (entry->state != TEXTURE_LOAD_STATE_PENDING);
+		if(!is_loaded && (nullptr != cb)){
+			entry->waiting_cbs.push_back(cb);
+		}
+	}
+
+	if(is_new){
+		job_run(JOB_TYPE_GENERIC, load_entry_job, this, entry);
+	}else if(is_loaded && (nullptr != cb)){
+		cb(entry->texture);
+	}
+
+	return entry->texture;
+}
+
+RHITexture2D* TextureCache::load(const std::string& filename)
+{
+	texture_cache_entry_t* entry = nullptr;
+	bool is_new = false;
+	{
+		SCOPE_LOCK(&m_lock);
+		entry = find_or_add_entry(filename, &is_new);
+	}
+
+	if(is_new){
+		decode_texture_cache_entry(entry);
+
+		SCOPE_LOCK(&m_lock);
+		m_stats.decodes++;
+	}else if(!take_finished_load(entry)){
+		return entry->texture;
+	}
+
+	// only this entry, the rest of the finished loads stay queued for update()
+	bool did_load = false;
+	size_t byte_size = upload_texture_cache_entry(entry, &did_load);
+	{
+		SCOPE_LOCK(&m_lock);
+		finish_entry(entry, byte_size, did_load);
+		evict_over_budget();
+	}
+
+	return entry->texture;
+}
+
+// Waits out an async load of the entry. True if its decode was taken off the
+// finished list and the caller has to upload it, false once it's already uploaded.
+bool TextureCache::take_finished_load(texture_cache_entry_t* entry)
+{
+	for(;;){
+		{
+			SCOPE_LOCK(&m_lock);
+			if(entry->state != TEXTURE_LOAD_STATE_PENDING){
+				return false;
+			}
+
+			std::vector<texture_cache_entry_t*>::iterator found = std::find(m_finished_loads.begin(), m_finished_loads.end(), entry);
+			if(found != m_finished_loads.end()){
+				m_finished_loads.erase(found);
+				return true;
+			}
+		}
+
+		// still decoding, or an update on another thread is uploading it
+		thread_yield();
+	}
+}
+
+// with m_lock held. Callbacks go on a list update() empties, they never run from inside load()
+void TextureCache::finish_entry(texture_cache_entry_t* entry, size_t byte_size, bool did_load)
+{
+	entry->byte_size = byte_size;
+	entry->state = did_load ? TEXTURE_LOAD_STATE_LOADED : TEXTURE_LOAD_STATE_FAILED;
+	m_stats.loaded_bytes += entry->byte_size;
+	m_stats.pending--;
+
+	for(texture_load_cb cb : entry->waiting_cbs){
+		m_ready_callbacks.push_back(std::make_pair(cb, entry));
+	}
+	entry->queued_cb_count += (uint)entry->waiting_cbs.size();
+	entry->waiting_cbs.clear();
+
+	if((entry->ref_count == 0) && (entry->queued_cb_count == 0)){
+		add_to_lru(entry);
+	}
+}
+
+bool TextureCache::acquire(RHITexture2D* texture)
+{
+	SCOPE_LOCK(&m_lock);
+
+	std::map<RHITexture2D*, texture_cache_entry_t*>::iterator found = m_entries_by_texture.find(texture);
+	if(found == m_entries_by_texture.end()){
+		return false;
+	}
+
+	texture_cache_entry_t* entry = found->second;
+	entry->ref_count++;
+	remove_from_lru(entry);
+	return true;
+}
+
+bool TextureCache::release(RHITexture2D* texture)
+{
+	SCOPE_LOCK(&m_lock);
+
+	std::map<RHITexture2D*, texture_cache_entry_t*>::iterator found = m_entries_by_texture.find(texture);
+	if(found == m_entries_by_texture.end()){
+		return false;
+	}
+
+	texture_cache_entry_t* entry = found->second;
+	ASSERT_OR_DIE(entry->ref_count > 0, "Released a cached texture more times than it was loaded\n");
+	entry->ref_count--;
+
+	// one still loading goes on the list once it's uploaded, one with callbacks queued once update() has called them
+	if((entry->ref_count == 0) && (entry->state != TEXTURE_LOAD_STATE_PENDING) && (entry->queued_cb_count == 0)){
+		add_to_lru(entry);
+		evict_over_budget();
+	}
+	return true;
+}
+
+uint TextureCache::update()
+{
+	std::vector<texture_cache_entry_t*> finished_loads;
+	std::vector<std::pair<texture_load_cb, texture_cache_entry_t*>> callbacks;
+	{
+		SCOPE_LOCK(&m_lock);
+		finished_loads.swap(m_finished_loads);
+		if(finished_loads.empty()){
+			callbacks.swap(m_ready_callbacks);
+		}
+	}
+
+	if(!finished_loads.empty()){
+		PROFILE_SCOPE_FUNCTION();
+
+		// the upload itself doesn't need the lock, nothing else touches an entry's decoded data
+		std::vector<size_t> byte_sizes;
+		std::vector<bool> did_loads;
+		byte_sizes.reserve(finished_loads.size());
+		did_loads.reserve(finished_loads.size());
+		for(texture_cache_entry_t* entry : finished_loads){
+			bool did_load = false;
+			byte_sizes.push_back(upload_texture_cache_entry(entry, &did_load));
+			did_loads.push_back(did_load);
+		}
+
+		SCOPE_LOCK(&m_lock);
+		for(uint load_idx = 0; load_idx < (uint)finished_loads.size(); ++load_idx){
+			finish_entry(finished_loads[load_idx], byte_sizes[load_idx], did_loads[load_idx]);
+		}
+		callbacks.swap(m_ready_callbacks);
+	}
+
+	// callbacks run after the whole batch is in, outside the lock so they can load more
+	for(const std::pair<texture_load_cb, texture_cache_entry_t*>& callback : callbacks){
+		callback.first(callback.second->texture);
+	}
+
+	// entries held off the lru for their callbacks can go on it now
+	if(!finished_loads.empty() || !callbacks.empty()){
+		SCOPE_LOCK(&m_lock);
+		for(const std::pair<texture_load_cb, texture_cache_entry_t*>& callback : callbacks){
+			texture_cache_entry_t* entry = callback.second;
+			entry->queued_cb_count--;
+			if((entry->ref_count == 0) && (entry->queued_cb_count == 0)){
+				add_to_lru(entry);
+			}
+		}
+		evict_over_budget();
+	}
+
+	return (uint)finished_loads.size();
+}
+
+void TextureCache::set_budget(size_t budget_bytes)
+{
+	SCOPE_LOCK(&m_lock);
+	m_budget_bytes = budget_bytes;
+	evict_over_budget();
+}
+
+texture_cache_stats_t TextureCache::get_stats()
+{
+	SCOPE_LOCK(&m_lock);
+	texture_cache_stats_t stats = m_stats;
+	stats.entries = (uint)m_entries.size();
+	return stats;
+}
+
+void TextureCache::clear()
+{
+	// jobs still decoding point at their entries
+	for(;;){
+		update();
+		{
+			SCOPE_LOCK(&m_lock);
+			if(m_stats.pending == 0){
+				break;
+			}
+		}
+		thread_yield();
+	}
+
+	SCOPE_LOCK(&m_lock);
+	std::map<std::string, texture_cache_entry_t*>::iterator it;
+	for(it = m_entries.begin(); it != m_entries.end(); ++it){
+		SAFE_DELETE(it->second->texture);
+		SAFE_DELETE(it->second);
+	}
+	m_entries.clear();
+	m_entries_by_texture.clear();
+	m_lru.clear();
+	m_stats.loaded_bytes = 0;
+	m_stats.unreferenced_bytes = 0;
+}
+
+void TextureCache::add_to_lru(texture_cache_entry_t* entry)
+{
+	if(entry->is_in_lru){
+		return;
+	}
+
+	m_lru.push_back(entry);
+	entry->lru_it = std::prev(m_lru.end());
+	entry->is_in_lru = true;
+	m_stats.unreferenced_bytes += entry->byte_size;
+}
+
+void TextureCache::remove_from_lru(texture_cache_entry_t* entry)
+{
+	if(!entry->is_in_lru){
+		return;
+	}
+
+	m_lru.erase(entry->lru_it);
+	entry->is_in_lru = false;
+	m_stats.unreferenced_bytes -= entry->byte_size;
+}
+
+// with m_lock held, oldest release first
+void TextureCache::evict_over_budget()
+{
+	while((m_stats.unreferenced_bytes > m_budget_bytes) && !m_lru.empty()){
+		texture_cache_entry_t* entry = m_lru.front();
+		remove_from_lru(entry);
+
+		m_entries.erase(make_texture_cache_key(entry->filename));
+		m_entries_by_texture.erase(entry->texture);
+		m_stats.loaded_bytes -= entry->byte_size;
+		m_stats.evictions++;
+
+		SAFE_DELETE(entry->texture);
+		SAFE_DELETE(entry);
+	}
+}
+
+//-----------------------------------------------------
+// Commands
+COMMAND(texture_cache_stats, "Prints what the texture cache holds and how many loads it saved")
+{
+	UNUSED(args);
+
+	texture_cache_stats_t stats = g_theRenderer->m_device->m_texture_cache->get_stats();
+	uint files_loaded = stats.entries + stats.evictions - stats.pending;
+
+	console_info("----Texture cache----");
+	console_info("entries:        %u (%u loading)", stats.entries, stats.pending);
+	console_info("requests:       %u (%u hits, %u on loads in flight)", stats.requests, stats.hits, stats.in_flight_hits);
+	console_info("decodes:        %u for %u files", stats.decodes, files_loaded);
+	console_info("evictions:      %u", stats.evictions);
+	console_info("loaded:         %.2f MB (%.2f MB unreferenced)", (double)stats.loaded_bytes / (1024.0 * 1024.0), (double)stats.unreferenced_bytes / (1024.0 * 1024.0));
+}
+
+COMMAND(texture_cache_budget, "[uint:megabytes] Sets how much unreferenced texture memory is kept before the oldest is evicted")
+{
+	uint megabytes = args.next_uint_arg();
+	g_theRenderer->m_device->m_texture_cache->set_budget((size_t)megabytes * 1024 * 1024);
+	console_info("Texture cache budget set to %u MB", megabytes);
+}
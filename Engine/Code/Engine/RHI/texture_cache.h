@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Thread/critical_section.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+class RHIDevice;
+class RHITexture2D;
+class TextureFile;
+class Image;
+
+// same as RHIDevice.hpp, which only forward declares the cache
+typedef void(*texture_load_cb)(RHITexture2D* loaded_tex);
+
+// bytes of textures nobody holds a reference to that are kept around in case they're asked for again
+#define DEFAULT_TEXTURE_CACHE_BUDGET_BYTES (256 * 1024 * 1024)
+
+enum TextureLoadState : unsigned int
+{
+	TEXTURE_LOAD_STATE_PENDING,
+	TEXTURE_LOAD_STATE_LOADED,
+	TEXTURE_LOAD_STATE_FAILED,
+};
+
+struct texture_cache_entry_t
+{
+	std::string filename;
+	RHITexture2D* texture;
+	TextureLoadState state;
+	uint ref_count;
+	size_t byte_size;
+
+	// callbacks of every request made while the load was in flight
+	std::vector<texture_load_cb> waiting_cbs;
+
+	// of those, the ones queued for update() that haven't been called yet. The entry stays off
+	// the lru until they have, so nothing can evict the texture out from under them
+	uint queued_cb_count;
+
+	// filled by the load job, uploaded and freed by the next update or a load() waiting on it
+	TextureFile* texture_file;
+	Image* image;
+
+	// on the lru list while nothing references it
+	bool is_in_lru;
+	std::list<texture_cache_entry_t*>::iterator lru_it;
+};
+
+struct texture_cache_stats_t
+{
+	uint requests;
+	uint hits;
+
+	// requests that found the file already loading and waited on it
+	uint in_flight_hits;
+	uint decodes;
+	uint evictions;
+	uint pending;
+	uint entries;
+	size_t loaded_bytes;
+	size_t unreferenced_bytes;
+};
+
+// Textures loaded from files, one entry per file however many times it's asked for.
+//
+// Requests take the lock just long enough to find or add an entry. A miss starts
+// one job that decodes (or maps the cooked file) off the main thread; requests
+// for a file that's still loading add their callback to its entry instead of
+// starting another. Finished decodes queue up and update() uploads the whole
+// batch, then calls every waiting callback, on the thread that owns the device.
+//
+// Every request takes a reference. Once release() drops an entry to none it
+// goes on an lru list, and the oldest unreferenced entries are deleted whenever
+// they add up to more than the budget.
+class TextureCache
+{
+public:
+	TextureCache(RHIDevice* device, size_t budget_bytes = DEFAULT_TEXTURE_CACHE_BUDGET_BYTES);
+	~TextureCache();
+
+	// the returned texture is empty until its load is uploaded, cb is called once it has been
+	RHITexture2D* load_async(const std::string& filename, texture_load_cb cb = nullptr);
+
+	// The texture is loaded when this returns. Loads on the calling thread if nothing has asked
+	// for the file yet, otherwise waits for the load in flight and uploads it. Callbacks waiting
+	// on the file are still left for update().
+	RHITexture2D* load(const std::string& filename);
+
+	// another reference to a texture this cache handed out, false for any other texture
+	bool acquire(RHITexture2D* texture);
+	bool release(RHITexture2D* texture);
+
+	// uploads every finished decode and calls every callback whose texture is in, including
+	// ones load() uploaded. Returns how many were uploaded
+	uint update();
+
+	void set_budget(size_t budget_bytes);
+	texture_cache_stats_t get_stats();
+
+	// waits out anything in flight, then deletes every texture referenced or not
+	void clear();
+
+private:
+	texture_cache_entry_t* find_or_add_entry(const std::string& filename, bool* out_is_new);
+	void add_to_lru(texture_cache_entry_t* entry);
+	void remove_from_lru(texture_cache_entry_t* entry);
+	void evict_over_budget();
+
+	bool take_finished_load(texture_cache_entry_t* entry);
+	void finish_entry(texture_cache_entry_t* entry, size_t byte_size, bool did_load);
+
+	static void load_entry_job(TextureCache* cache, texture_cache_entry_t* entry);
+
+private:
+	RHIDevice* m_device;
+	CriticalSection m_lock;
+
+	// keyed by the lower case path with forward slashes
+	std::map<std::string, texture_cache_entry_t*> m_entries;
+	std::map<RHITexture2D*, texture_cache_entry_t*> m_entries_by_texture;
+	std::vector<texture_cache_entry_t*> m_finished_loads;
+	std::vector<std::pair<texture_load_cb, texture_cache_entry_t*>> m_ready_callbacks;
+	std::list<texture_cache_entry_t*> m_lru;
+
+	size_t m_budget_bytes;
+	texture_cache_stats_t m_stats;
+};
@@ -1,5 +1,6 @@
 #include "Engine/Renderer/CubeMap.hpp"
 #include "Engine/Renderer/camera.h"
+#include "Engine/Renderer/texture_file.h"
 #include "Engine/RHI/DX11.hpp"
 #include "Engine/RHI/RHIDevice.hpp"
 #include "Engine/RHI/RHITexture2D.hpp"
@@ -9,6 +10,7 @@
 #include "Engine/Core/Common.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
 #include "Engine/Engine.hpp"
 
 #define WIN32_LEAN_AND_MEAN
@@ -331,6 +333,73 @@ bool CubeMap::save_to_seperate_images(const char* filename)
 	return true;
 }
 
+bool CubeMap::load_from_texture_file(RHIDevice* device, const char* filename)
+{
+	TextureFile texture_file;
+	if(!texture_file.open(filename)){
+		return false;
+	}
+
+	if(!texture_file.is_cube_map()){
+		log_warningf("Texture file [%s] isn't a cube map\n", filename);
+		return false;
+	}
+
+	uint mip_count = texture_file.get_mip_count();
+	m_resolution = texture_file.get_width();
+	m_format = get_texture_file_image_format(texture_file.get_format());
+	m_uses_mips = (mip_count > 1);
+
+	D3D11_TEXTURE2D_DESC texDesc;
+	MemZero(&texDesc);
+	texDesc.Width = m_resolution;
+	texDesc.Height = m_resolution;
+	texDesc.MipLevels = mip_count;
+	texDesc.ArraySize = NUM_CUBE_FACES;
+	texDesc.Format = DXGetImageFormat(m_format);
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags = 0;
+	texDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	// the file is laid out face by face, the same order as the subresources
+	D3D11_SUBRESOURCE_DATA data[NUM_CUBE_FACES * MAX_TEXTURE_FILE_MIPS];
+	memset(data, 0, sizeof(data));
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		for(uint mip = 0; mip < mip_count; ++mip){
+			D3D11_SUBRESOURCE_DATA& subresource = data[D3D11CalcSubresource(mip, face, mip_count)];
+			subresource.pSysMem = texture_file.get_mip_data(mip, face);
+			subresource.SysMemPitch = texture_file.get_mip(mip, face).row_pitch;
+			subresource.SysMemSlicePitch = (UINT)texture_file.get_mip(mip, face).size;
+		}
+	}
+
+	HRESULT hr = device->m_dxDevice->CreateTexture2D(&texDesc, data, &m_texture);
+	if(FAILED(hr)){
+		log_warningf("Failed to create cube map from [%s]\n", filename);
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	MemZero(&srvDesc);
+	srvDesc.Format = texDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = mip_count;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+
+	hr = device->m_dxDevice->CreateShaderResourceView(m_texture, &srvDesc, &m_srv);
+	if(FAILED(hr)){
+		log_warningf("Failed to create shader resource view for cube map [%s]\n", filename);
+		DX_SAFE_RELEASE(m_texture);
+		return false;
+	}
+
+	finished_loading();
+	return true;
+}
+
 void CubeMap::render_setup_face(uint face, const Vector3& view_center, uint mip_level)
 {
 	switch(face){
@@ -79,6 +79,9 @@ public:
 	bool load_from_seperate_images_async(RHIDevice* device, CubeMapImagePaths cubeMapImages);
 	bool save_to_seperate_images(const char* filename);
 
+	// a cube map cooked to a texture file with all its mips, immutable with only an srv
+	bool load_from_texture_file(RHIDevice* device, const char* filename);
+
 	void render_setup_face(uint face, const Vector3& view_center = Vector3::ZERO, uint mip_level = 0);
 	void render_setup_pos_x(const Vector3& view_center = Vector3::ZERO, uint mip_level = 0);
 	void render_setup_neg_x(const Vector3& view_center = Vector3::ZERO, uint mip_level = 0);
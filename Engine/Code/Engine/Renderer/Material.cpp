@@ -184,13 +184,22 @@ Material::Material(const Material& mat_to_copy)
 	,m_specular_reflectance(mat_to_copy.m_specular_reflectance)
 	,m_diffuse_reflectance(mat_to_copy.m_diffuse_reflectance)
 	,m_height_map_scale(mat_to_copy.m_height_map_scale)
+	,m_cached_textures(mat_to_copy.m_cached_textures)
 {
 	memcpy(&m_textures[0], &mat_to_copy.m_textures[0], sizeof(RHITexture2D*) * MAX_NUM_TEXTURES);
 	memcpy(&m_constant_buffers[0], &mat_to_copy.m_constant_buffers[0], sizeof(ConstantBuffer*) * MAX_NUM_CONSTANT_BUFFERS);
+
+	for(RHITexture2D* texture : m_cached_textures){
+		g_theRenderer->m_device->acquire_rhitexture2d(texture);
+	}
 }
 
 Material::~Material()
 {
+	for(RHITexture2D* texture : m_cached_textures){
+		g_theRenderer->m_device->release_rhitexture2d(texture);
+	}
+
     for(int i = 0; i < MAX_NUM_CONSTANT_BUFFERS; i++){
         SAFE_DELETE(m_constant_buffers[i]);
     }
@@ -284,7 +293,9 @@ RHITexture2D* Material::create_texture_from_xml(const XMLElement& texture_xml)
 	}
 	else{
 		std::string texture_filename = xml::parse_xml_attribute(texture_xml, "src", texture_filename);
-		return g_theRenderer->m_device->load_rhitexture2d_async(texture_filename);
+		RHITexture2D* texture = g_theRenderer->m_device->load_rhitexture2d_async(texture_filename);
+		m_cached_textures.push_back(texture);
+		return texture;
 	}
 }
 
@@ -5,6 +5,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #define MAX_NUM_TEXTURES D3D11_COMMONSHADER_INPUT_RESOURCE_REGISTER_COUNT
 #define MAX_NUM_CONSTANT_BUFFERS D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT
@@ -81,6 +82,9 @@ protected:
 	RHITexture2D*		m_textures[MAX_NUM_TEXTURES];
 	ConstantBuffer*		m_constant_buffers[MAX_NUM_CONSTANT_BUFFERS];
 
+	// loaded through the device's texture cache, each copy of the material holds a reference to them
+	std::vector<RHITexture2D*> m_cached_textures;
+
 	bool				m_is_metal;
 	float				m_smoothness;
 	Vector3				m_specular_reflectance;
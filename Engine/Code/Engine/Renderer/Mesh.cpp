@@ -7,17 +7,26 @@
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Core/FileBinaryStream.hpp"
 #include "Engine/Core/job.h"
+#include "Engine/Renderer/mesh_file.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
 #include "Engine/Tools/fbx.hpp"
 
 Mesh::Mesh()
-	:m_vbo(nullptr)
+	:m_local_bounds(Vector3::ZERO, Vector3::ZERO)
+	,m_vbo(nullptr)
 	,m_ibo(nullptr)
+	,m_mesh_file(nullptr)
 {
 }
 
 Mesh::Mesh(const std::vector<Vertex3>& vertexes,
 		   const std::vector<unsigned int> indexes,
 		   const std::vector<draw_instruction_t>& draw_instructions)
+	:m_local_bounds(Vector3::ZERO, Vector3::ZERO)
+	,m_vbo(nullptr)
+	,m_ibo(nullptr)
+	,m_mesh_file(nullptr)
 {
 	set_vertexes(vertexes);
 	set_indexes(indexes);
@@ -28,11 +37,15 @@ Mesh::~Mesh()
 {
 	SAFE_DELETE(m_vbo);
 	SAFE_DELETE(m_ibo);
+	SAFE_DELETE(m_mesh_file);
 }
 
 void Mesh::set_vertexes(const std::vector<Vertex3>& vertexes)
 {
+	release_mesh_file();
+
 	m_vertexes = vertexes;
+	calc_local_bounds();
 
 	if(!m_vbo){
 		if(vertexes.size() == 0){
@@ -53,6 +66,8 @@ void Mesh::set_indexes(const std::vector<unsigned int> indexes)
 		return;
 	}
 
+	release_mesh_file();
+
 	m_indexes = indexes;
 
 	if(!m_ibo){
@@ -73,7 +88,78 @@ void Mesh::set_draw_instructions(const std::vector<draw_instruction_t>& draw_ins
 	m_draw_instructions = draw_instructions;
 }
 
+void Mesh::set_lods(const std::vector<mesh_lod_t>& lods, const std::vector<draw_instruction_t>& lod_draw_instructions)
+{
+	m_lods = lods;
+	m_lod_draw_instructions = lod_draw_instructions;
+}
+
+uint Mesh::get_lod_count() const
+{
+	return (uint)m_lods.size() + 1;
+}
+
+const draw_instruction_t* Mesh::get_lod_draw_instructions(uint lod, uint* out_count) const
+{
+	lod = Min(lod, (uint)m_lods.size());
+	if(lod == 0){
+		*out_count = (uint)m_draw_instructions.size();
+		return m_draw_instructions.data();
+	}
+
+	const mesh_lod_t& mesh_lod = m_lods[lod - 1];
+	*out_count = mesh_lod.draw_instruction_count;
+	return m_lod_draw_instructions.data() + mesh_lod.first_draw_instruction;
+}
+
+void Mesh::calc_local_bounds()
+{
+	m_local_bounds = calc_vertex_bounds(get_vertex_data(), get_vertex_count());
+}
+
+const Vertex3* Mesh::get_vertex_data() const
+{
+	return m_mesh_file ? m_mesh_file->m_vertexes : m_vertexes.data();
+}
+
+uint Mesh::get_vertex_count() const
+{
+	return m_mesh_file ? m_mesh_file->m_vertex_count : (uint)m_vertexes.size();
+}
+
+const unsigned int* Mesh::get_index_data() const
+{
+	return m_mesh_file ? m_mesh_file->m_indexes : m_indexes.data();
+}
+
+uint Mesh::get_index_count() const
+{
+	return m_mesh_file ? m_mesh_file->m_index_count : (uint)m_indexes.size();
+}
+
+void Mesh::release_mesh_file()
+{
+	if(!m_mesh_file){
+		return;
+	}
+
+	m_vertexes.assign(m_mesh_file->m_vertexes, m_mesh_file->m_vertexes + m_mesh_file->m_vertex_count);
+	m_indexes.assign(m_mesh_file->m_indexes, m_mesh_file->m_indexes + m_mesh_file->m_index_count);
+	SAFE_DELETE(m_mesh_file);
+}
+
 bool Mesh::load_from_file(const char* filename)
+{
+	// convert_mesh and generate_mesh_lods write the mapped file next to the .mesh
+	std::string mesh_file_name = make_mesh_file_name(filename);
+	if(load_from_mesh_file(mesh_file_name.c_str())){
+		return true;
+	}
+
+	return load_from_stream_file(filename);
+}
+
+bool Mesh::load_from_stream_file(const char* filename)
 {
 	FileBinaryStream fbs;
 
@@ -88,6 +174,49 @@ bool Mesh::load_from_file(const char* filename)
 	return true;
 }
 
+bool Mesh::load_from_mesh_file(const char* filename, bool verify_checksum)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	MeshFile* mesh_file = new MeshFile();
+	if(!mesh_file->open(filename, verify_checksum)){
+		delete mesh_file;
+		return false;
+	}
+
+	SAFE_DELETE(m_mesh_file);
+	m_vertexes.clear();
+	m_indexes.clear();
+	m_mesh_file = mesh_file;
+
+	// buffers are filled straight from the mapping
+	uint vertex_count = m_mesh_file->m_vertex_count;
+	if(!m_vbo){
+		m_vbo = g_theRenderer->m_device->CreateVertexBuffer(vertex_count > 0 ? m_mesh_file->m_vertexes : nullptr, Max(vertex_count, 1U), BUFFERUSAGE_DYNAMIC);
+	}
+	else{
+		m_vbo->Update(g_theRenderer->m_deviceContext, m_mesh_file->m_vertexes, vertex_count);
+	}
+
+	uint index_count = m_mesh_file->m_index_count;
+	if(index_count > 0){
+		if(!m_ibo){
+			m_ibo = g_theRenderer->m_device->CreateIndexBuffer(m_mesh_file->m_indexes, index_count, BUFFERUSAGE_DYNAMIC);
+		}
+		else{
+			m_ibo->Update(g_theRenderer->m_deviceContext, m_mesh_file->m_indexes, index_count);
+		}
+	}
+
+	// draw instructions are tiny and get edited, so they're the one thing copied
+	m_draw_instructions.assign(m_mesh_file->m_draw_instructions, m_mesh_file->m_draw_instructions + m_mesh_file->m_draw_instruction_count);
+	m_lods.assign(m_mesh_file->m_lods, m_mesh_file->m_lods + m_mesh_file->m_lod_count);
+	m_lod_draw_instructions.assign(m_mesh_file->m_lod_draw_instructions, m_mesh_file->m_lod_draw_instructions + m_mesh_file->m_lod_draw_instruction_count);
+	m_local_bounds = m_mesh_file->get_local_bounds();
+
+	return true;
+}
+
 void mesh_load_async(Mesh* mesh, const char* filename)
 {
 	mesh->load_from_file(filename);
@@ -116,14 +245,18 @@ void Mesh::write(BinaryStream& stream)
 {
 	stream.m_stream_order = LITTLE_ENDIAN;
 
-	ASSERT_OR_DIE(stream.write(m_vertexes.size()), "Failed to write vertexes size");
-	for(const Vertex3& vertex : m_vertexes){
-		ASSERT_OR_DIE(stream.write(vertex), "Failed to write vertex");
+	const Vertex3* vertexes = get_vertex_data();
+	size_t num_vertexes = get_vertex_count();
+	ASSERT_OR_DIE(stream.write(num_vertexes), "Failed to write vertexes size");
+	for(size_t vert_index = 0; vert_index < num_vertexes; ++vert_index){
+		ASSERT_OR_DIE(stream.write(vertexes[vert_index]), "Failed to write vertex");
 	}
 
-	ASSERT_OR_DIE(stream.write(m_indexes.size()), "Failed to write indexes size");
-	for(const unsigned int index : m_indexes){
-		ASSERT_OR_DIE(stream.write(index), "Failed to write index");
+	const unsigned int* indexes = get_index_data();
+	size_t num_indexes = get_index_count();
+	ASSERT_OR_DIE(stream.write(num_indexes), "Failed to write indexes size");
+	for(size_t index = 0; index < num_indexes; ++index){
+		ASSERT_OR_DIE(stream.write(indexes[index]), "Failed to write index");
 	}
 
 	ASSERT_OR_DIE(stream.write(m_draw_instructions.size()), "Failed to write draw instructions size");
@@ -133,6 +266,36 @@ void Mesh::write(BinaryStream& stream)
 }
 
 void Mesh::read(BinaryStream& stream)
+{
+	// replacing everything, nothing in the mapping is worth keeping and the old format has no lods
+	SAFE_DELETE(m_mesh_file);
+	m_lods.clear();
+	m_lod_draw_instructions.clear();
+
+	read_mesh_data(stream, &m_vertexes, &m_indexes, &m_draw_instructions);
+
+	set_vertexes(m_vertexes);
+	set_indexes(m_indexes);
+	set_draw_instructions(m_draw_instructions);
+}
+
+AABB3 calc_vertex_bounds(const Vertex3* vertexes, uint vertex_count)
+{
+	if(vertex_count == 0){
+		return AABB3(Vector3::ZERO, Vector3::ZERO);
+	}
+
+	AABB3 bounds(vertexes[0].m_position, vertexes[0].m_position);
+	for(uint vert_index = 1; vert_index < vertex_count; ++vert_index){
+		bounds.StretchToIncludePoint(vertexes[vert_index].m_position);
+	}
+	return bounds;
+}
+
+void read_mesh_data(BinaryStream& stream,
+					std::vector<Vertex3>* out_vertexes,
+					std::vector<unsigned int>* out_indexes,
+					std::vector<draw_instruction_t>* out_draw_instructions)
 {
 	stream.m_stream_order = LITTLE_ENDIAN;
 
@@ -141,12 +304,12 @@ void Mesh::read(BinaryStream& stream)
 		size_t num_vertexes;
 		ASSERT_OR_DIE(stream.read(&num_vertexes, sizeof(num_vertexes)), "Failed to write num vertexes");
 
-		m_vertexes.resize(num_vertexes);
+		out_vertexes->resize(num_vertexes);
 
 		for(unsigned int index = 0; index < num_vertexes; ++index){
 			Vertex3 vert;
 			ASSERT_OR_DIE(stream.read(vert), "Failed to read vertex");
-			m_vertexes[index] = vert;
+			(*out_vertexes)[index] = vert;
 		}
 	}
 
@@ -155,12 +318,12 @@ void Mesh::read(BinaryStream& stream)
 		size_t num_indexes;
 		ASSERT_OR_DIE(stream.read(&num_indexes, sizeof(num_indexes)), "Failed to read num indexes");
 
-		m_indexes.resize(num_indexes);
+		out_indexes->resize(num_indexes);
 
 		for(unsigned int index = 0; index < num_indexes; ++index){
 			unsigned int vert_index;
 			ASSERT_OR_DIE(stream.read(vert_index), "Failed to read to index");
-			m_indexes[index] = vert_index;
+			(*out_indexes)[index] = vert_index;
 		}
 	}
 
@@ -169,16 +332,12 @@ void Mesh::read(BinaryStream& stream)
 		size_t num_draw_instructions;
 		ASSERT_OR_DIE(stream.read(&num_draw_instructions, sizeof(num_draw_instructions)), "Failed to read num draw instructions");
 
-		m_draw_instructions.resize(num_draw_instructions);
+		out_draw_instructions->resize(num_draw_instructions);
 
 		for(unsigned int draw_instr_index = 0; draw_instr_index < num_draw_instructions; ++draw_instr_index){
 			draw_instruction_t draw_instruction;
 			ASSERT_OR_DIE(stream.read(draw_instruction), "Failed to read draw instruction");
-			m_draw_instructions[draw_instr_index] = draw_instruction;
+			(*out_draw_instructions)[draw_instr_index] = draw_instruction;
 		}
 	}
-
-	set_vertexes(m_vertexes);
-	set_indexes(m_indexes);
-	set_draw_instructions(m_draw_instructions);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Engine/RHI/RHITypes.hpp"
 #include "Engine/Renderer/Vertex3.hpp"
 #include "Engine/Core/BinaryStream.hpp"
+#include "Engine/Math/AABB3.hpp"
 #include <vector>
 
 struct draw_instruction_t
@@ -14,8 +15,21 @@ struct draw_instruction_t
 	uint mat_id;
 };
 
+// a simplified level of the mesh, its draws index the same vertex buffer as the base
+struct mesh_lod_t
+{
+	// into Mesh::m_lod_draw_instructions
+	uint first_draw_instruction;
+	uint draw_instruction_count;
+
+	// simplification error relative to the mesh's bounding radius
+	float error;
+	uint triangle_count;
+};
+
 class VertexBuffer;
 class IndexBuffer;
+class MeshFile;
 
 class Mesh
 {
@@ -24,9 +38,20 @@ public:
 	std::vector<unsigned int> m_indexes;
 	std::vector<draw_instruction_t> m_draw_instructions;
 
+	// levels past the base, coarsest last. m_draw_instructions is always level 0
+	std::vector<mesh_lod_t> m_lods;
+	std::vector<draw_instruction_t> m_lod_draw_instructions;
+
+	// object space bounds of every vertex position, kept in sync by set_vertexes
+	AABB3 m_local_bounds;
+
 	VertexBuffer* m_vbo;
 	IndexBuffer* m_ibo;
 
+	// set when loaded from a mapped mesh file, the vertexes and indexes then live
+	// in the mapping and m_vertexes / m_indexes stay empty until the mesh is edited
+	MeshFile* m_mesh_file;
+
 public:
 	Mesh();
 	Mesh(const std::vector<Vertex3>& vertexes, 
@@ -37,11 +62,37 @@ public:
 	void set_vertexes(const std::vector<Vertex3>& vertexes);
 	void set_indexes(const std::vector<unsigned int> indexes);
 	void set_draw_instructions(const std::vector<draw_instruction_t>& draw_instructions);
+	void set_lods(const std::vector<mesh_lod_t>& lods, const std::vector<draw_instruction_t>& lod_draw_instructions);
+	void calc_local_bounds();
 
+	// including the base level, lod is clamped to the coarsest level there is
+	uint get_lod_count() const;
+	const draw_instruction_t* get_lod_draw_instructions(uint lod, uint* out_count) const;
+
+	// either the mapped arrays or the vectors, use these instead of m_vertexes / m_indexes when reading
+	const Vertex3* get_vertex_data() const;
+	uint get_vertex_count() const;
+	const unsigned int* get_index_data() const;
+	uint get_index_count() const;
+
+	// copies mapped data into the vectors and unmaps the file
+	void release_mesh_file();
+
+	// the mapped mesh file next to filename if there is one, otherwise filename in the old per field format
 	bool load_from_file(const char* filename);
+	bool load_from_stream_file(const char* filename);
+	bool load_from_mesh_file(const char* filename, bool verify_checksum = false);
 	bool load_from_file_async(const char* filename);
 	bool load_from_fbx(const char* fbx_filename, float scale = 1.0f);
 
 	void write(BinaryStream& stream);
 	void read(BinaryStream& stream);
-};
\ No newline at end of file
+};
+
+AABB3 calc_vertex_bounds(const Vertex3* vertexes, uint vertex_count);
+
+// the old per field format written by Mesh::write
+void read_mesh_data(BinaryStream& stream,
+					std::vector<Vertex3>* out_vertexes,
+					std::vector<unsigned int>* out_indexes,
+					std::vector<draw_instruction_t>* out_draw_instructions);
\ No newline at end of file
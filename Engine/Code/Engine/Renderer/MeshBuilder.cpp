@@ -7,86 +7,12 @@
 #include "Engine/Core/ErrorWarningAssert.hpp"
 #include "Engine/Profile/Profiler.h"
 #include "Engine/Core/bit.h"
-#include "ThirdParty/mikkt/mikktspace.h"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Renderer/mikkt_tangents.h"
 
 #include <vector>
 
-// ------------------------------------------------------
-// mikkt interface functions
-// ------------------------------------------------------
-
-// Returns the number of faces (triangles/quads) on the mesh to be processed.
-int mikkt_get_num_faces(const SMikkTSpaceContext* context)
-{
-	MeshBuilder* mb = (MeshBuilder*)context->m_pUserData;
-	return (int)mb->m_vertexes.size() / 3;
-}
-
-// Returns the number of vertices on face number iFace
-// iFace is a number in the range {0, 1, ..., getNumFaces()-1}
-int mikkt_get_num_vertices_of_face(const SMikkTSpaceContext* context, const int face_index)
-{
-	UNUSED(face_index);
-	UNUSED(context);
-	return 3;
-}
-
-// returns the position/normal/texcoord of the referenced face of vertex number iVert.
-// iVert is in the range {0,1,2} for triangles and {0,1,2,3} for quads.
-void mikkt_get_position(const SMikkTSpaceContext * context, float fvPosOut[], const int face_index, const int vert_index)
-{
-	MeshBuilder* mb = (MeshBuilder*)context->m_pUserData;
-	Vertex3 vert = mb->m_vertexes.at((face_index * 3) + vert_index);
-
-	fvPosOut[0] = vert.m_position.x;
-	fvPosOut[1] = vert.m_position.y;
-	fvPosOut[2] = vert.m_position.z;
-}
-
-void mikkt_get_normal(const SMikkTSpaceContext* context, float fvNormOut[], const int face_index, const int vert_index)
-{
-	MeshBuilder* mb = (MeshBuilder*)context->m_pUserData;
-	Vertex3 vert = mb->m_vertexes.at((face_index * 3) + vert_index);
-
-	fvNormOut[0] = vert.m_normal.x;
-	fvNormOut[1] = vert.m_normal.y;
-	fvNormOut[2] = vert.m_normal.z;
-}
-
-void mikkt_get_uv(const SMikkTSpaceContext * context, float fvTexcOut[], const int face_index, const int vert_index)
-{
-	MeshBuilder* mb = (MeshBuilder*)context->m_pUserData;
-	Vertex3 vert = mb->m_vertexes.at((face_index * 3) + vert_index);
-
-	fvTexcOut[0] = vert.m_texCoords.x;
-	fvTexcOut[1] = vert.m_texCoords.y;
-}
-
-// either (or both) of the two setTSpace callbacks can be set.
-// The call-back m_setTSpaceBasic() is sufficient for basic normal mapping.
-
-// This function is used to return the tangent and fSign to the application.
-// fvTangent is a unit length vector.
-// For normal maps it is sufficient to use the following simplified version of the bitangent which is generated at pixel/vertex level.
-// bitangent = fSign * cross(vN, tangent);
-// Note that the results are returned unindexed. It is possible to generate a new index list
-// But averaging/overwriting tangent spaces by using an already existing index list WILL produce INCRORRECT results.
-// DO NOT! use an already existing index list.
-void mikkt_set_tangent_space_basic(const SMikkTSpaceContext * context, const float fvTangent[], const float fSign, const int face_index, const int vert_index)
-{
-	MeshBuilder* mb = (MeshBuilder*)context->m_pUserData;
-	Vertex3& vert = mb->m_vertexes.at((face_index * 3) + vert_index);
-
-	Vector3 tangent;
-	tangent.x = fvTangent[0];
-	tangent.y = fvTangent[1];
-	tangent.z = fvTangent[2];
-
-	vert.m_tangent = tangent;
-	vert.m_bitangent = fSign * CrossProduct(vert.m_tangent, vert.m_normal);
-}
-
-
 MeshBuilder::MeshBuilder()
 	:m_start_index(0)
 	,m_current_index(0)
@@ -146,11 +72,21 @@ void MeshBuilder::set_bitangents_loaded(bool loaded)
 	FLIP_BIT(m_load_flags, BITANGENTS_LOADED);
 }
 
+void MeshBuilder::set_bones_loaded(bool loaded)
+{
+	if(IS_BIT_SET(m_load_flags, BONES_LOADED) == loaded){
+		return;
+	}
+
+	FLIP_BIT(m_load_flags, BONES_LOADED);
+}
+
 bool MeshBuilder::are_colors_loaded(){ return IS_BIT_SET(m_load_flags, COLORS_LOADED); }
 bool MeshBuilder::are_uvs_loaded(){ return IS_BIT_SET(m_load_flags, UVS_LOADED); }
 bool MeshBuilder::are_normals_loaded(){ return IS_BIT_SET(m_load_flags, NORMALS_LOADED); }
 bool MeshBuilder::are_tangents_loaded(){ return IS_BIT_SET(m_load_flags, TANGENTS_LOADED); }
 bool MeshBuilder::are_bitangents_loaded(){ return IS_BIT_SET(m_load_flags, BITANGENTS_LOADED); }
+bool MeshBuilder::are_bones_loaded(){ return IS_BIT_SET(m_load_flags, BONES_LOADED); }
 
 void MeshBuilder::begin(PrimitiveType type, bool use_index_buffer)
 {
@@ -187,6 +123,8 @@ void MeshBuilder::clear()
 	m_vertexes.clear();
 	m_indexes.clear();
 	m_draw_instructions.clear();
+	m_lods.clear();
+	m_lod_draw_instructions.clear();
 
 	m_current_draw_instruction.primitive_type = PRIMITIVE_NONE;
 	m_current_draw_instruction.count = 0;
@@ -194,16 +132,17 @@ void MeshBuilder::clear()
 	m_current_draw_instruction.mat_id = 0;
 }
 
-void MeshBuilder::set_color(const Rgba& color){ m_vertex_stamp.m_color = color; };
+// setting an attribute marks it loaded, so the vertex layout only carries what was actually set
+void MeshBuilder::set_color(const Rgba& color){ m_vertex_stamp.m_color = color; SET_BIT(m_load_flags, COLORS_LOADED); };
 
-void MeshBuilder::set_uv(const float u, const float v){ m_vertex_stamp.m_texCoords = Vector2(u, v); }
-void MeshBuilder::set_uv(const Vector2& uv){ m_vertex_stamp.m_texCoords = uv; }
+void MeshBuilder::set_uv(const float u, const float v){ m_vertex_stamp.m_texCoords = Vector2(u, v); SET_BIT(m_load_flags, UVS_LOADED); }
+void MeshBuilder::set_uv(const Vector2& uv){ m_vertex_stamp.m_texCoords = uv; SET_BIT(m_load_flags, UVS_LOADED); }
 
-void MeshBuilder::set_normal(const Vector3& normal){ m_vertex_stamp.m_normal = normal; }
-void MeshBuilder::set_tangent(const Vector3& tangent){ m_vertex_stamp.m_tangent = tangent; }
-void MeshBuilder::set_bitangent(const Vector3& bitangent){ m_vertex_stamp.m_bitangent = bitangent; }
-void MeshBuilder::set_bone_weights(const Vector4& bone_weights){ m_vertex_stamp.m_bone_weights = bone_weights; }
-void MeshBuilder::set_bone_indices(const UIntVector4& bone_indices){ m_vertex_stamp.m_bone_indices = bone_indices; }
+void MeshBuilder::set_normal(const Vector3& normal){ m_vertex_stamp.m_normal = normal; SET_BIT(m_load_flags, NORMALS_LOADED); }
+void MeshBuilder::set_tangent(const Vector3& tangent){ m_vertex_stamp.m_tangent = tangent; SET_BIT(m_load_flags, TANGENTS_LOADED); }
+void MeshBuilder::set_bitangent(const Vector3& bitangent){ m_vertex_stamp.m_bitangent = bitangent; SET_BIT(m_load_flags, BITANGENTS_LOADED); }
+void MeshBuilder::set_bone_weights(const Vector4& bone_weights){ m_vertex_stamp.m_bone_weights = bone_weights; SET_BIT(m_load_flags, BONES_LOADED); }
+void MeshBuilder::set_bone_indices(const UIntVector4& bone_indices){ m_vertex_stamp.m_bone_indices = bone_indices; SET_BIT(m_load_flags, BONES_LOADED); }
 void MeshBuilder::set_material_id(uint mat_id){ m_current_draw_instruction.mat_id = mat_id; }
 
 size_t MeshBuilder::add_vertex(const Vector2& position)
@@ -280,6 +219,8 @@ void MeshBuilder::end()
 
 void MeshBuilder::generate_mikkt_tangents(bool force_generate)
 {
+	PROFILE_SCOPE_FUNCTION();
+
 	if(!are_normals_loaded() || !are_uvs_loaded()){
 		return;
 	}
@@ -288,25 +229,70 @@ void MeshBuilder::generate_mikkt_tangents(bool force_generate)
 		return;
 	}
 
-	SMikkTSpaceInterface mikkt_interface;
-	mikkt_interface.m_getNormal = mikkt_get_normal;
-	mikkt_interface.m_getNumFaces = mikkt_get_num_faces;
-	mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
-	mikkt_interface.m_getPosition = mikkt_get_position;
-	mikkt_interface.m_getTexCoord = mikkt_get_uv;
-	mikkt_interface.m_setTSpaceBasic = mikkt_set_tangent_space_basic;
-	mikkt_interface.m_setTSpace = nullptr;
+	if(m_current_draw_instruction.primitive_type != PRIMITIVE_NONE){
+		push_current_draw_instruction();
+	}
+
+	for(const draw_instruction_t& draw : m_draw_instructions){
+		if(!is_triangle_list(draw.primitive_type) || (draw.count % 3) != 0){
+			log_warningf("Mesh builder has draws that aren't triangle lists, no tangents generated\n");
+			return;
+		}
+	}
 
-	SMikkTSpaceContext mikkt_context;
-	mikkt_context.m_pInterface = &mikkt_interface;
-	mikkt_context.m_pUserData = (void*)this;
+	// mikkt needs one vertex per corner, so indexed draws are expanded first
+	std::vector<Vertex3> corners;
+	std::vector<uint> draw_indexes;
+	for(draw_instruction_t& draw : m_draw_instructions){
+		gather_draw_indexes(m_indexes, draw, &draw_indexes);
 
-	genTangSpaceDefault(&mikkt_context);
+		draw.start_index = (uint)corners.size();
+		draw.uses_index_buffer = true;
+		for(uint index : draw_indexes){
+			corners.push_back(m_vertexes[index]);
+		}
+	}
+
+	generate_mikkt_tangents_parallel(corners.data(), (uint)corners.size());
+
+	// corner i is index i, welding turns the expanded list back into an index buffer
+	weld_vertexes_parallel(corners.data(), (uint)corners.size(), &m_vertexes, &m_indexes);
+	m_lods.clear();
+	m_lod_draw_instructions.clear();
 
 	set_tangents_loaded(true);
 	set_bitangents_loaded(true);
 }
 
+bool MeshBuilder::optimize(mesh_optimize_stats_t* out_stats, uint cache_size)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(m_current_draw_instruction.primitive_type != PRIMITIVE_NONE){
+		push_current_draw_instruction();
+	}
+
+	// the optimized index buffer only has the base draws in it
+	if(!optimize_mesh(&m_vertexes, &m_indexes, &m_draw_instructions, cache_size, out_stats)){
+		return false;
+	}
+
+	m_lods.clear();
+	m_lod_draw_instructions.clear();
+	return true;
+}
+
+uint MeshBuilder::generate_lods(uint lod_count, float reduction, float max_error)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(m_current_draw_instruction.primitive_type != PRIMITIVE_NONE){
+		push_current_draw_instruction();
+	}
+
+	return generate_mesh_lods(m_vertexes.data(), (uint)m_vertexes.size(), &m_indexes, m_draw_instructions, &m_lods, &m_lod_draw_instructions, lod_count, reduction, max_error);
+}
+
 void MeshBuilder::copy_to_mesh(Mesh* mesh)
 {
     PROFILE_SCOPE_FUNCTION();
@@ -317,6 +303,32 @@ void MeshBuilder::copy_to_mesh(Mesh* mesh)
 	mesh->set_vertexes(m_vertexes);
 	mesh->set_indexes(m_indexes);
 	mesh->set_draw_instructions(m_draw_instructions);
+	mesh->set_lods(m_lods, m_lod_draw_instructions);
+}
+
+VertexLayout MeshBuilder::get_vertex_layout(bool quantize)
+{
+	uint max_bone_index = 0;
+	if(are_bones_loaded()){
+		for(const Vertex3& vertex : m_vertexes){
+			for(uint influence = 0; influence < 4; ++influence){
+				if(vertex.m_bone_weights.values[influence] > 0.0f){
+					max_bone_index = Max(max_bone_index, vertex.m_bone_indices.values[influence]);
+				}
+			}
+		}
+	}
+
+	return make_vertex_layout(m_load_flags, max_bone_index, quantize);
+}
+
+void MeshBuilder::pack_vertexes(const VertexLayout& layout, std::vector<byte>* out_data)
+{
+	PROFILE_SCOPE_FUNCTION();
+	out_data->resize(m_vertexes.size() * layout.m_stride);
+	if(!m_vertexes.empty()){
+		encode_vertexes(layout, m_vertexes.data(), (uint)m_vertexes.size(), out_data->data());
+	}
 }
 
 bool MeshBuilder::write(BinaryStream& stream)
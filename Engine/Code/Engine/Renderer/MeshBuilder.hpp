@@ -5,12 +5,16 @@
 #include "Engine/Math/AABB2.hpp"
 #include "Engine/Renderer/Mesh.hpp"
 #include "Engine/Core/BinaryStream.hpp"
+#include "Engine/Renderer/vertex_layout.h"
+#include "Engine/Renderer/mesh_optimizer.h"
+#include "Engine/Renderer/mesh_simplifier.h"
 
 #define COLORS_LOADED		0b00000001
 #define UVS_LOADED			0b00000010
 #define NORMALS_LOADED		0b00000100
 #define TANGENTS_LOADED		0b00001000
 #define BITANGENTS_LOADED	0b00010000
+#define BONES_LOADED		0b00100000
 
 class Vertex3;
 class RHIDevice;
@@ -22,6 +26,10 @@ public:
 	std::vector<unsigned int> m_indexes;
 	std::vector<draw_instruction_t> m_draw_instructions;
 
+	// filled by generate_lods, their indexes live at the end of m_indexes
+	std::vector<mesh_lod_t> m_lods;
+	std::vector<draw_instruction_t> m_lod_draw_instructions;
+
 	unsigned char m_load_flags;
 
 public:
@@ -33,12 +41,14 @@ public:
 	void set_normals_loaded(bool loaded);
 	void set_tangents_loaded(bool loaded);
 	void set_bitangents_loaded(bool loaded);
+	void set_bones_loaded(bool loaded);
 
 	bool are_colors_loaded();
 	bool are_uvs_loaded();
 	bool are_normals_loaded();
 	bool are_tangents_loaded();
 	bool are_bitangents_loaded();
+	bool are_bones_loaded();
 
 	void begin(PrimitiveType type, bool use_index_buffer = true);
 	void clear();
@@ -66,9 +76,24 @@ public:
 
 	void end();
 
+	// per corner mikkt tangents on the job threads, then welded back into an index buffer.
+	// every draw must be a triangle list and comes out indexed
 	void generate_mikkt_tangents(bool force_generate);
 
+	// bake time: welds identical vertexes and reorders every triangle list draw for the
+	// post transform cache, overdraw and vertex fetch. call once building is done.
+	// false (and nothing changed) if any draw isn't a triangle list
+	bool optimize(mesh_optimize_stats_t* out_stats = nullptr, uint cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+	// bake time, after optimize (which drops any lods). returns the number of levels made past the base
+	uint generate_lods(uint lod_count = DEFAULT_MESH_LOD_COUNT, float reduction = DEFAULT_MESH_LOD_REDUCTION, float max_error = DEFAULT_MESH_LOD_MAX_ERROR);
+
 	void copy_to_mesh(Mesh* mesh);
+
+	// only the loaded attributes, quantized packs them down to the compact encodings
+	VertexLayout get_vertex_layout(bool quantize);
+	void pack_vertexes(const VertexLayout& layout, std::vector<byte>* out_data);
+
 	bool write(BinaryStream& stream);
 	bool read(BinaryStream& stream);
 
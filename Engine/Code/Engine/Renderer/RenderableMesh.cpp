@@ -9,6 +9,8 @@ RenderableMesh::RenderableMesh()
 	:Renderable()
 	,m_mesh(nullptr)
 	,m_wireframe_mode_enabled(false)
+	,m_lod(0)
+	,m_world_bounds_valid(false)
 {
 	m_materials.resize(MAX_NUM_MATERIALS);
 	set_tesselation_factors(1, 2, 20.0f, 200.0f);
@@ -18,6 +20,8 @@ RenderableMesh::RenderableMesh(Mesh* mesh, const Material* material)
 	:Renderable()
 	,m_mesh(mesh)
 	,m_wireframe_mode_enabled(false)
+	,m_lod(0)
+	,m_world_bounds_valid(false)
 {
 	m_materials.resize(MAX_NUM_MATERIALS);
 	m_materials[0] = material;
@@ -32,6 +36,8 @@ RenderableMesh::~RenderableMesh()
 void RenderableMesh::set_mesh(Mesh* mesh)
 {
 	m_mesh = mesh;
+	m_lod = 0;
+	invalidate_world_bounds();
 }
 
 void RenderableMesh::set_material(const Material* material)
@@ -99,6 +105,62 @@ void RenderableMesh::set_tesselation_factors(uint min_tess_factor, uint max_tess
 	m_tess_factors.max_lod_distance = max_lod_distance;
 }
 
+uint RenderableMesh::select_lod(const Vector3& camera_position, float projection_scale, float max_pixel_error)
+{
+	m_lod = 0;
+	if(nullptr == m_mesh || m_mesh->m_lods.empty()){
+		return m_lod;
+	}
+
+	// the world box's radius over the local one's is at least the largest scale, so errors come out conservative
+	const AABB3& world_bounds = get_world_bounds();
+	float radius = world_bounds.CalcHalfExtents().CalcLength();
+	float distance = CalcDistance(world_bounds.CalcCenter(), camera_position) - radius;
+	if(distance <= 0.0f){
+		return m_lod;
+	}
+
+	float pixels_per_error = radius * projection_scale / distance;
+	for(uint lod = (uint)m_mesh->m_lods.size(); lod > 0; --lod){
+		if(m_mesh->m_lods[lod - 1].error * pixels_per_error <= max_pixel_error){
+			m_lod = lod;
+			break;
+		}
+	}
+
+	return m_lod;
+}
+
+const AABB3& RenderableMesh::get_world_bounds()
+{
+	if(nullptr == m_mesh){
+		m_world_bounds = AABB3(m_transform.calc_world_position(), m_transform.calc_world_position());
+		return m_world_bounds;
+	}
+
+	// transforms are edited directly through m_local, so compare against what we built with last time
+	Matrix4 world = m_transform.calc_world_matrix();
+	const AABB3& local_bounds = m_mesh->m_local_bounds;
+
+	bool is_stale = !m_world_bounds_valid
+		|| (memcmp(world.data, m_cached_world_matrix.data, sizeof(world.data)) != 0)
+		|| (memcmp(&local_bounds, &m_cached_local_bounds, sizeof(AABB3)) != 0);
+
+	if(is_stale){
+		m_cached_world_matrix = world;
+		m_cached_local_bounds = local_bounds;
+		m_world_bounds = local_bounds.GetTransformed(world);
+		m_world_bounds_valid = true;
+	}
+
+	return m_world_bounds;
+}
+
+void RenderableMesh::invalidate_world_bounds()
+{
+	m_world_bounds_valid = false;
+}
+
 void RenderableMesh::draw()
 {
 	g_theRenderer->draw_renderable_mesh(this);
@@ -4,6 +4,7 @@
 #include "Engine/RHI/RHITypes.hpp"
 #include "Engine/Renderer/SkeletalTransformHierarchy.hpp"
 #include "Engine/Renderer/transform.h"
+#include "Engine/Math/AABB3.hpp"
 
 #define MAX_NUM_MATERIALS 5
 
@@ -28,6 +29,16 @@ class RenderableMesh : public Renderable
 		bool m_wireframe_mode_enabled;
 		tesselation_factors_t m_tess_factors;
 
+		// level of m_mesh to draw, picked per frame by select_lod
+		uint m_lod;
+
+	private:
+		// world bounds are only rebuilt when the world matrix or the mesh bounds change
+		AABB3 m_world_bounds;
+		AABB3 m_cached_local_bounds;
+		Matrix4 m_cached_world_matrix;
+		bool m_world_bounds_valid;
+
     public:
     	RenderableMesh();
     	RenderableMesh(Mesh* mesh, const Material* material);
@@ -48,5 +59,12 @@ class RenderableMesh : public Renderable
 		void set_wireframe_enabled(bool enabled);
 		void set_tesselation_factors(uint min_tess_factor, uint max_tess_factor, float min_lod_distance, float max_lod_distance);
 
+		// coarsest level whose simplification error projects to at most max_pixel_error pixels.
+		// projection_scale is pixels per world unit at a distance of one, viewport height / (2 tan(fov / 2))
+		uint select_lod(const Vector3& camera_position, float projection_scale, float max_pixel_error);
+
+		const AABB3& get_world_bounds();
+		void invalidate_world_bounds();
+
     	virtual void draw() override;
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Engine/RHI/DX11.hpp"
 #include "Engine/RHI/Shader.hpp"
 #include "Engine/RHI/ShaderProgram.hpp"
+#include "Engine/RHI/shader_cache.h"
 #include "Engine/RHI/VertexBuffer.hpp"
 #include "Engine/RHI/IndexBuffer.hpp"
 #include "Engine/RHI/RasterState.hpp"
@@ -26,6 +27,8 @@
 #include "Engine/Renderer/SpotLight.h"
 #include "Engine/Renderer/camera.h"
 #include "Engine/Renderer/skybox.h"
+#include "Engine/Renderer/texture_file.h"
+#include "Engine/Renderer/ibl_baker.h"
 
 #include "Engine/Renderer/Mesh.hpp"
 #include "Engine/Renderer/Meshes.hpp"
@@ -201,8 +204,12 @@ void SimpleRenderer::Setup(unsigned int width, unsigned int height)
 	//#TODO: Don't hardcode these paths, breaks seperation between engine/game
 	m_ssaa_shader = new ShaderProgram(m_device, "Data/HLSL/mvp.vert", nullptr, "Data/HLSL/ssaa.frag");
 
+	// bake_dfg writes the lut as a texture file, the raw dump is the fallback
 	m_dfg_texture = new RHITexture2D(g_theRenderer->m_device);
-	m_dfg_texture->load_from_binary_file("Data/Images/dfg.r16g16b16a16.texture", 128, 128, IMAGE_FORMAT_R16G16B16A16);
+	TextureFile dfg_file;
+	if(!dfg_file.open(DEFAULT_DFG_LUT_FILE) || !m_dfg_texture->load_from_texture_file(dfg_file)){
+		m_dfg_texture->load_from_binary_file("Data/Images/dfg.r16g16b16a16.texture", 128, 128, IMAGE_FORMAT_R16G16B16A16);
+	}
 
 	m_fxaa_shader = new Shader("Data/Shaders/fxaa.shader");
 	create_aa_render_targets();
@@ -276,6 +283,9 @@ void SimpleRenderer::Update(float deltaSeconds)
 {
     PROFILE_SCOPE_FUNCTION();
 
+	m_device->update_texture_loads();
+	update_shader_watch();
+
 	m_timeBufferData.gameTime += deltaSeconds;
 	m_timeBufferData.systemTime += deltaSeconds;
 	m_timeBufferData.gameFrameTime = deltaSeconds;
@@ -288,6 +298,20 @@ void SimpleRenderer::Update(float deltaSeconds)
     m_current_scene->update(deltaSeconds);
 }
 
+void SimpleRenderer::update_shader_watch()
+{
+	ShaderCache* shader_cache = m_device->m_shader_cache;
+	if(!shader_cache->is_watch_due()){
+		return;
+	}
+
+	std::vector<std::string> changed_filenames;
+	shader_cache->find_changed_files(&changed_filenames);
+	if(!changed_filenames.empty()){
+		Shader::reload_changed(changed_filenames);
+	}
+}
+
 void SimpleRenderer::Destroy() 
 {
 	Material::shutdown();
@@ -1021,9 +1045,12 @@ void SimpleRenderer::draw_with_meshbuilder(MeshBuilder& mb)
 	draw_mesh(m_global_mesh);
 }
 
-void SimpleRenderer::draw_mesh(Mesh* mesh)
+void SimpleRenderer::draw_mesh(Mesh* mesh, uint lod)
 {
-	for(const draw_instruction_t& t : mesh->m_draw_instructions){
+	uint draw_count = 0;
+	const draw_instruction_t* draws = mesh->get_lod_draw_instructions(lod, &draw_count);
+	for(uint draw_idx = 0; draw_idx < draw_count; ++draw_idx){
+		const draw_instruction_t& t = draws[draw_idx];
 		if(t.uses_index_buffer){
 			DrawVBOIndexed(t.primitive_type, mesh->m_vbo, mesh->m_ibo, t.count, t.start_index);
 		}
@@ -1047,8 +1074,11 @@ void SimpleRenderer::draw_renderable_mesh(RenderableMesh* rm)
 
 	set_tesselation_factors(rm->m_tess_factors);
 
-	// loop through draw instructions and draw
-	for(const draw_instruction_t& t : rm->m_mesh->m_draw_instructions){
+	// loop through the selected level's draw instructions and draw
+	uint draw_count = 0;
+	const draw_instruction_t* draws = rm->m_mesh->get_lod_draw_instructions(rm->m_lod, &draw_count);
+	for(uint draw_idx = 0; draw_idx < draw_count; ++draw_idx){
+		const draw_instruction_t& t = draws[draw_idx];
 
 		// setup material
 		const Material* mat = rm->m_materials[t.mat_id];
@@ -396,7 +396,7 @@ public:
 	void DrawVBOIndexed(PrimitiveType topology, VertexBuffer* vbo, IndexBuffer* ibo, const unsigned int indexCount, const unsigned int startIndex = 0);
 
 	void draw_with_meshbuilder(MeshBuilder& mb);
-	void draw_mesh(Mesh* mesh);
+	void draw_mesh(Mesh* mesh, uint lod = 0);
     void draw_renderable_mesh(RenderableMesh* rm);
 
 	void Present();
@@ -490,4 +490,7 @@ public:
 
 private:
 	void RecreateDefaultDepthBuffer();
+
+	// reloads shaders whose files changed, once the shader cache's watch interval is up
+	void update_shader_watch();
 };
\ No newline at end of file
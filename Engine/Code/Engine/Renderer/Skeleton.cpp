@@ -1,6 +1,7 @@
 #include "Engine/Renderer/Skeleton.hpp"	
 #include "Engine/Renderer/SkeletonInstance.hpp"	
 #include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/log.h"
 #include "Engine/Engine.hpp"
 
 Skeleton::Skeleton()
@@ -143,5 +144,22 @@ bool Skeleton::read(BinaryStream& stream)
 		}
 	}
 
+	// evaluate_skinning_transforms walks joints in order and needs every parent done before its children,
+	// which add_joint always gives but a file doesn't have to
+	const std::vector<unsigned int>& parent_indexes = m_transform_hierarchy.m_parent_indexes;
+	if(parent_indexes.size() != m_transform_hierarchy.m_transforms.size()){
+		log_warningf("Skeleton has %u parent indexes for %u joints\n", (unsigned int)parent_indexes.size(), (unsigned int)m_transform_hierarchy.m_transforms.size());
+		m_transform_hierarchy.clear();
+		return false;
+	}
+
+	for(unsigned int index = 0; index < (unsigned int)parent_indexes.size(); ++index){
+		if((parent_indexes[index] != INVALID_TRANSFORM_INDEX) && (parent_indexes[index] >= index)){
+			log_warningf("Skeleton joint %u has parent %u, parents have to come first\n", index, parent_indexes[index]);
+			m_transform_hierarchy.clear();
+			return false;
+		}
+	}
+
 	return true;
 }
\ No newline at end of file
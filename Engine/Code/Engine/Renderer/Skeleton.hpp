@@ -49,5 +49,7 @@ public:
 	void draw() const;
 
 	bool write(BinaryStream& stream);
+
+	// false, leaving the skeleton empty, if any joint comes before its parent
 	bool read(BinaryStream& stream);
 };
\ No newline at end of file
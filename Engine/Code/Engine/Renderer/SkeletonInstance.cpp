@@ -1,13 +1,24 @@
 #include "Engine/Renderer/SkeletonInstance.hpp"
 #include "Engine/Renderer/Skeleton.hpp"
+#include "Engine/Renderer/animation_system.h"
+#include "Engine/RHI/ConstantBuffer.hpp"
+#include "Engine/Core/Common.hpp"
 #include "Engine/Engine.hpp"
 
 SkeletonInstance::SkeletonInstance(Skeleton* skeleton)
 	:m_skeleton(skeleton)
 	,m_structured_buffer(nullptr)
+	,m_skinning_range_cb(nullptr)
+	,m_skinning_offset(INVALID_SKINNING_OFFSET)
 {
 }
 
+SkeletonInstance::~SkeletonInstance()
+{
+	SAFE_DELETE(m_structured_buffer);
+	SAFE_DELETE(m_skinning_range_cb);
+}
+
 // Excercise:  How do we evaluate a global transform for this joint if the pose only contains 
 // local transforms?
 // Hint:  You will need "get_joint_parent" below.
@@ -34,25 +45,69 @@ unsigned int SkeletonInstance::get_joint_parent_index(unsigned int joint_index)
 	return m_skeleton->get_joint_parent_index(joint_index);
 }
 
-void SkeletonInstance::apply_motion(const Motion* motion, const float time)
+void SkeletonInstance::evaluate_skinning_transforms(const Motion* motion, 
+												   const float time, 
+												   const Matrix4* inverse_bind_pose, 
+												   Matrix4* out_global_transforms, 
+												   Matrix4* out_skinning_transforms)
 {
 	motion->evaluate(&m_current_pose, time);
 
+	// joints are always added after their parent, so walking in order lets each
+	// joint reuse its parent's global transform instead of re-walking the chain
+	unsigned int joint_count = m_skeleton->get_joint_count();
+	for(unsigned int i = 0; i < joint_count; ++i){
+		out_global_transforms[i] = m_current_pose.m_local_transforms[i];
+
+		if(m_skeleton->joint_has_parent(i)){
+			unsigned int parent_index = m_skeleton->get_joint_parent_index(i);
+			out_global_transforms[i] *= out_global_transforms[parent_index];
+		}
+
+		out_skinning_transforms[i] = inverse_bind_pose[i] * out_global_transforms[i];
+	}
+}
+
+void SkeletonInstance::apply_motion(const Motion* motion, const float time)
+{
+	unsigned int joint_count = m_skeleton->get_joint_count();
+
+	std::vector<Matrix4> inverse_bind_pose;
+	std::vector<Matrix4> global_transforms;
 	std::vector<Matrix4> skinning_transforms;
-	skinning_transforms.resize(m_skeleton->m_transform_hierarchy.m_transforms.size());
+	inverse_bind_pose.resize(joint_count);
+	global_transforms.resize(joint_count);
+	skinning_transforms.resize(joint_count);
 
-	for(unsigned int i = 0; i < (unsigned int)skinning_transforms.size(); ++i){
-		const Matrix4& bind_pose_joint = m_skeleton->m_transform_hierarchy.get_transform(i);
-		const Matrix4& current_pose_joint = get_joint_global_transform(i);
-		skinning_transforms[i] = bind_pose_joint.get_inverse() * current_pose_joint;
+	for(unsigned int i = 0; i < joint_count; ++i){
+		inverse_bind_pose[i] = m_skeleton->m_transform_hierarchy.get_transform(i).get_inverse();
 	}
 
+	evaluate_skinning_transforms(motion, time, inverse_bind_pose.data(), global_transforms.data(), skinning_transforms.data());
+
 	if(!m_structured_buffer){
 		m_structured_buffer = new StructuredBuffer(g_theRenderer->m_device, skinning_transforms.data(), sizeof(Matrix4), (unsigned int)skinning_transforms.size());
 	}
 	else{
 		g_theRenderer->UpdateStructuredBuffer(m_structured_buffer, skinning_transforms.data());
 	}
+
+	if(!m_skinning_range_cb){
+		skinning_range_t range;
+		MemZero(&range);
+		m_skinning_range_cb = new ConstantBuffer(g_theRenderer->m_device, &range, sizeof(range));
+	}
+}
+
+void SkeletonInstance::bind_skinning() const
+{
+	if(!m_structured_buffer){
+		return;
+	}
+
+	// skinning.vert always adds SKIN_MATRIX_OFFSET, so b7 has to be ours even with a palette of our own
+	g_theRenderer->SetConstantBuffer(SKINNING_BUFFER_INDEX, m_skinning_range_cb);
+	g_theRenderer->SetStructuredBuffer(SKINNING_MATRICES_TEXTURE_INDEX, m_structured_buffer);
 }
 
 void SkeletonInstance::draw() const
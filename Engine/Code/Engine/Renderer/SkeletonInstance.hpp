@@ -5,16 +5,26 @@
 #include "Engine/Renderer/Motion.hpp"
 #include "Engine/RHI/StructuredBuffer.hpp"
 
+#define INVALID_SKINNING_OFFSET ((unsigned int)-1)
+
+class ConstantBuffer;
+
 class SkeletonInstance
 {
 public:
 	Skeleton* m_skeleton; // skeleton we're applying poses to.  Used for heirachy information.
 	Pose m_current_pose;  // my current skeletons pose.
 
+	// apply_motion's own palette, and a SkinningBuffer that always says offset 0 into it
 	StructuredBuffer* m_structured_buffer;
+	ConstantBuffer* m_skinning_range_cb;
+
+	// where this instance's skinning matrices live in the AnimationSystem pool
+	unsigned int m_skinning_offset;
 
 public:
 	SkeletonInstance(Skeleton* skeleton);
+	~SkeletonInstance();
 
 	// Excercise:  How do we evaluate a global transform for this joint if the pose only contains 
 	// local transforms?
@@ -23,7 +33,19 @@ public:
 	Matrix4 get_joint_local_transform(unsigned int joint_index) const;
 	unsigned int get_joint_parent_index(unsigned int joint_index) const;
 
+	// Evaluates the motion into m_current_pose and writes one skinning matrix per joint.
+	// Touches no renderer state so it is safe to run on a job thread.
+	// out_global_transforms is scratch space, both out arrays must hold get_joint_count() matrices
+	void evaluate_skinning_transforms(const Motion* motion, 
+									  const float time, 
+									  const Matrix4* inverse_bind_pose, 
+									  Matrix4* out_global_transforms, 
+									  Matrix4* out_skinning_transforms);
+
 	void apply_motion(const Motion* motion, const float time);
 
+	// binds what apply_motion uploaded for skinning.vert, call before drawing the skinned mesh
+	void bind_skinning() const;
+
 	void draw() const;
-};
\ No newline at end of file
+};
@@ -0,0 +1,372 @@
+#include "Engine/Renderer/animation_system.h"
+#include "Engine/Renderer/Skeleton.hpp"
+#include "Engine/Renderer/SkeletonInstance.hpp"
+#include "Engine/Renderer/Motion.hpp"
+#include "Engine/RHI/StructuredBuffer.hpp"
+#include "Engine/RHI/ConstantBuffer.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+#include "Engine/Engine.hpp"
+
+static void animation_evaluate_batch_job(AnimationSystem* system, uint start_entry, uint end_entry)
+{
+	system->evaluate_range(start_entry, end_entry);
+}
+
+AnimationSystem::AnimationSystem(uint instances_per_job)
+	:m_instances_per_job(Max(1U, instances_per_job))
+	,m_layout_dirty(false)
+	,m_skinning_buffer(nullptr)
+	,m_skinning_range_cb(nullptr)
+	,m_skinning_buffer_capacity(0)
+{
+}
+
+AnimationSystem::~AnimationSystem()
+{
+	clear();
+	SAFE_DELETE(m_skinning_buffer);
+	SAFE_DELETE(m_skinning_range_cb);
+}
+
+void AnimationSystem::add_instance(SkeletonInstance* instance, const Motion* motion)
+{
+	if(nullptr == instance || nullptr != find_entry(instance)){
+		return;
+	}
+
+	animation_entry_t entry;
+	entry.instance = instance;
+	entry.motion = motion;
+	entry.time = 0.0f;
+	entry.inverse_bind_pose = find_or_create_inverse_bind_pose(instance->m_skeleton);
+	entry.joint_count = instance->m_skeleton->get_joint_count();
+
+	m_entries.push_back(entry);
+	m_layout_dirty = true;
+}
+
+void AnimationSystem::remove_instance(SkeletonInstance* instance)
+{
+	for(size_t entry_idx = 0; entry_idx < m_entries.size(); ++entry_idx){
+		if(m_entries[entry_idx].instance == instance){
+			instance->m_skinning_offset = INVALID_SKINNING_OFFSET;
+			m_entries.erase(m_entries.begin() + entry_idx);
+			m_layout_dirty = true;
+			return;
+		}
+	}
+}
+
+void AnimationSystem::clear()
+{
+	for(animation_entry_t& entry : m_entries){
+		entry.instance->m_skinning_offset = INVALID_SKINNING_OFFSET;
+	}
+
+	m_entries.clear();
+	m_inverse_bind_poses.clear();
+	m_skinning_pool.clear();
+	m_global_pool.clear();
+	m_layout_dirty = false;
+}
+
+void AnimationSystem::set_motion(SkeletonInstance* instance, const Motion* motion)
+{
+	animation_entry_t* entry = find_entry(instance);
+	if(nullptr != entry){
+		entry->motion = motion;
+	}
+}
+
+void AnimationSystem::set_time(SkeletonInstance* instance, float time)
+{
+	animation_entry_t* entry = find_entry(instance);
+	if(nullptr != entry){
+		entry->time = time;
+	}
+}
+
+void AnimationSystem::set_time_all(float time)
+{
+	for(animation_entry_t& entry : m_entries){
+		entry.time = time;
+	}
+}
+
+void AnimationSystem::evaluate()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(m_layout_dirty){
+		rebuild_layout();
+	}
+
+	uint num_entries = (uint)m_entries.size();
+	if(num_entries == 0){
+		return;
+	}
+
+	// not worth the job overhead for a single batch
+	if(num_entries <= m_instances_per_job){
+		evaluate_range(0, num_entries);
+		return;
+	}
+
+	std::vector<Job*> jobs;
+	jobs.reserve((num_entries / m_instances_per_job) + 1);
+
+	for(uint start_entry = 0; start_entry < num_entries; start_entry += m_instances_per_job){
+		uint end_entry = Min(start_entry + m_instances_per_job, num_entries);
+
+		Job* job = job_create(JOB_TYPE_GENERIC, animation_evaluate_batch_job, this, start_entry, end_entry);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+void AnimationSystem::evaluate_range(uint start_entry, uint end_entry)
+{
+	for(uint entry_idx = start_entry; entry_idx < end_entry; ++entry_idx){
+		animation_entry_t& entry = m_entries[entry_idx];
+		if(nullptr == entry.motion){
+			continue;
+		}
+
+		SkeletonInstance* instance = entry.instance;
+		uint offset = instance->m_skinning_offset;
+
+		instance->evaluate_skinning_transforms(entry.motion,
+											   entry.time,
+											   entry.inverse_bind_pose,
+											   &m_global_pool[offset],
+											   &m_skinning_pool[offset]);
+	}
+}
+
+void AnimationSystem::upload()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint num_matrices = get_skinning_matrix_count();
+	if(num_matrices == 0){
+		return;
+	}
+
+	if(nullptr == m_skinning_range_cb){
+		skinning_range_t range;
+		MemZero(&range);
+		m_skinning_range_cb = new ConstantBuffer(g_theRenderer->m_device, &range, sizeof(range));
+	}
+
+	// layout only changes when instances are added or removed, every other frame is one map/discard
+	if(nullptr == m_skinning_buffer || num_matrices != m_skinning_buffer_capacity){
+		SAFE_DELETE(m_skinning_buffer);
+		m_skinning_buffer_capacity = num_matrices;
+		m_skinning_buffer = new StructuredBuffer(g_theRenderer->m_device, m_skinning_pool.data(), sizeof(Matrix4), m_skinning_buffer_capacity);
+		return;
+	}
+
+	g_theRenderer->UpdateStructuredBuffer(m_skinning_buffer, m_skinning_pool.data());
+}
+
+void AnimationSystem::bind_instance(const SkeletonInstance* instance)
+{
+	// not one of ours, it's skinned through apply_motion
+	if(instance->m_skinning_offset == INVALID_SKINNING_OFFSET){
+		instance->bind_skinning();
+		return;
+	}
+
+	if(nullptr == m_skinning_buffer || nullptr == m_skinning_range_cb){
+		return;
+	}
+
+	skinning_range_t range;
+	MemZero(&range);
+	range.offset = instance->m_skinning_offset;
+	m_skinning_range_cb->Update(g_theRenderer->m_deviceContext, &range);
+
+	g_theRenderer->SetConstantBuffer(SKINNING_BUFFER_INDEX, m_skinning_range_cb);
+	g_theRenderer->SetStructuredBuffer(SKINNING_MATRICES_TEXTURE_INDEX, m_skinning_buffer);
+}
+
+const Matrix4* AnimationSystem::get_skinning_matrices(const SkeletonInstance* instance) const
+{
+	if(m_layout_dirty || instance->m_skinning_offset == INVALID_SKINNING_OFFSET){
+		return nullptr;
+	}
+
+	return &m_skinning_pool[instance->m_skinning_offset];
+}
+
+uint AnimationSystem::get_instance_count() const
+{
+	return (uint)m_entries.size();
+}
+
+uint AnimationSystem::get_skinning_matrix_count() const
+{
+	return (uint)m_skinning_pool.size();
+}
+
+animation_entry_t* AnimationSystem::find_entry(const SkeletonInstance* instance)
+{
+	for(animation_entry_t& entry : m_entries){
+		if(entry.instance == instance){
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+const Matrix4* AnimationSystem::find_or_create_inverse_bind_pose(const Skeleton* skeleton)
+{
+	auto found = m_inverse_bind_poses.find(skeleton);
+	if(found != m_inverse_bind_poses.end()){
+		return found->second.data();
+	}
+
+	std::vector<Matrix4>& inverse_bind_pose = m_inverse_bind_poses[skeleton];
+
+	uint joint_count = skeleton->get_joint_count();
+	inverse_bind_pose.resize(joint_count);
+	for(uint joint_idx = 0; joint_idx < joint_count; ++joint_idx){
+		inverse_bind_pose[joint_idx] = skeleton->m_transform_hierarchy.get_transform(joint_idx).get_inverse();
+	}
+
+	return inverse_bind_pose.data();
+}
+
+void AnimationSystem::rebuild_layout()
+{
+	uint total_joints = 0;
+	for(animation_entry_t& entry : m_entries){
+		entry.instance->m_skinning_offset = total_joints;
+		total_joints += entry.joint_count;
+	}
+
+	m_skinning_pool.resize(total_joints, Matrix4::IDENTITY);
+	m_global_pool.resize(total_joints, Matrix4::IDENTITY);
+	m_layout_dirty = false;
+}
+
+//-----------------------------------------------------
+// Check
+
+static float calc_max_matrix_error(const Matrix4& a, const Matrix4& b)
+{
+	float max_error = 0.0f;
+	for(uint element = 0; element < 16; ++element){
+		max_error = Max(max_error, fabsf(a.data[element] - b.data[element]));
+	}
+	return max_error;
+}
+
+// Random chain-ish skeleton, each joint parented to one of the joints before it
+static void make_random_animation_test_data(Skeleton* out_skeleton, Motion* out_motion, uint joint_count)
+{
+	for(uint joint_idx = 0; joint_idx < joint_count; ++joint_idx){
+		std::string name = Stringf("joint%u", joint_idx);
+		std::string parent_name = (joint_idx == 0) ? "" : Stringf("joint%u", (uint)GetRandomIntLessThan((int)joint_idx));
+
+		Matrix4 transform = Matrix4::make_rotation_y_degrees(GetRandomFloatInRange(0.0f, 360.0f));
+		transform *= Matrix4::make_translation(GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(0.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f));
+		out_skeleton->add_joint(name.c_str(), (joint_idx == 0) ? nullptr : parent_name.c_str(), transform);
+	}
+
+	out_motion->set_framerate(10.0f);
+	out_motion->set_duration_seconds(2.0f);
+	out_motion->resize_poses(joint_count);
+	for(uint frame_idx = 0; frame_idx < out_motion->get_frame_count(); ++frame_idx){
+		Pose* pose = out_motion->get_pose(frame_idx);
+		for(Matrix4& local : pose->m_local_transforms){
+			local = Matrix4::make_rotation_x_degrees(GetRandomFloatInRange(-45.0f, 45.0f));
+			local *= Matrix4::make_rotation_z_degrees(GetRandomFloatInRange(-45.0f, 45.0f));
+			local *= Matrix4::make_translation(0.0f, GetRandomFloatInRange(0.1f, 1.0f), 0.0f);
+		}
+	}
+}
+
+COMMAND(animation_system_check, "[uint:instance_count, uint:joint_count] Evaluates instances through the AnimationSystem jobs and checks them against walking every joint's chain alone")
+{
+	uint instance_count = 256;
+	uint joint_count = 48;
+
+	if(!args.is_at_end()){
+		instance_count = Max(1U, args.next_uint_arg());
+	}
+
+	if(!args.is_at_end()){
+		joint_count = Max(1U, args.next_uint_arg());
+	}
+
+	Skeleton skeleton;
+	Motion motion;
+	make_random_animation_test_data(&skeleton, &motion, joint_count);
+
+	std::vector<SkeletonInstance*> instances;
+	std::vector<float> times;
+	AnimationSystem system;
+	for(uint instance_idx = 0; instance_idx < instance_count; ++instance_idx){
+		SkeletonInstance* instance = skeleton.create_instance();
+		float time = GetRandomFloatInRange(0.0f, motion.get_duration_seconds());
+
+		system.add_instance(instance, &motion);
+		system.set_time(instance, time);
+		instances.push_back(instance);
+		times.push_back(time);
+	}
+
+	double start = get_current_time_seconds();
+	system.evaluate();
+	double system_seconds = get_current_time_seconds() - start;
+
+	// the reference is the old per joint math, each joint walking its own chain up to the root,
+	// so it doesn't share evaluate_skinning_transforms' parent before child walk with the system
+	SkeletonInstance* reference = skeleton.create_instance();
+	std::vector<Matrix4> skinning_transforms(joint_count);
+
+	float max_error = 0.0f;
+	double reference_seconds = 0.0;
+	for(uint instance_idx = 0; instance_idx < instance_count; ++instance_idx){
+		start = get_current_time_seconds();
+		motion.evaluate(&reference->m_current_pose, times[instance_idx]);
+		for(uint joint_idx = 0; joint_idx < joint_count; ++joint_idx){
+			Matrix4 inverse_bind = skeleton.m_transform_hierarchy.get_transform(joint_idx).get_inverse();
+			skinning_transforms[joint_idx] = inverse_bind * reference->get_joint_global_transform(joint_idx);
+		}
+		reference_seconds += get_current_time_seconds() - start;
+
+		const Matrix4* pooled = system.get_skinning_matrices(instances[instance_idx]);
+		for(uint joint_idx = 0; joint_idx < joint_count; ++joint_idx){
+			max_error = Max(max_error, calc_max_matrix_error(pooled[joint_idx], skinning_transforms[joint_idx]));
+		}
+	}
+
+	console_info("----Animation System (%u instances, %u joints)----", instance_count, joint_count);
+	console_info("system:    %.3f ms", system_seconds * 1000.0);
+	console_info("chain walk: %.3f ms", reference_seconds * 1000.0);
+
+	if(max_error > 0.0001f){
+		console_error("AnimationSystem skinning does not match the chain walk (max err %f)", max_error);
+	}else{
+		console_info("AnimationSystem skinning matches the chain walk (max err %f)", max_error);
+	}
+
+	system.clear();
+	for(SkeletonInstance* instance : instances){
+		SAFE_DELETE(instance);
+	}
+	SAFE_DELETE(reference);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Math/Matrix4.hpp"
+
+#include <vector>
+#include <map>
+
+class Skeleton;
+class SkeletonInstance;
+class Motion;
+class StructuredBuffer;
+class ConstantBuffer;
+
+#define SKINNING_BUFFER_INDEX (7)
+#define SKINNING_MATRICES_TEXTURE_INDEX (5)
+#define DEFAULT_ANIMATION_INSTANCES_PER_JOB (16)
+
+struct animation_entry_t
+{
+	SkeletonInstance* instance;
+	const Motion* motion;
+	float time;
+
+	const Matrix4* inverse_bind_pose;
+	uint joint_count;
+};
+
+struct skinning_range_t
+{
+	uint offset;
+	uint _padding[3];
+};
+
+// Collects every animated SkeletonInstance and evaluates them together.
+// evaluate() fans the instances out across the generic job threads and writes
+// all skinning matrices into one contiguous pool, each instance owning the range
+// [m_skinning_offset, m_skinning_offset + joint_count).  upload() then pushes
+// the whole pool to the gpu as a single structured buffer update.
+//
+// evaluate() and evaluate_range() never touch the renderer, so the animation
+// stage can run without a device.
+class AnimationSystem
+{
+public:
+	std::vector<animation_entry_t> m_entries;
+
+	// flat matrix arrays, both indexed by the same skinning offset
+	std::vector<Matrix4> m_skinning_pool;
+	std::vector<Matrix4> m_global_pool;
+
+	std::map<const Skeleton*, std::vector<Matrix4>> m_inverse_bind_poses;
+
+	uint m_instances_per_job;
+	bool m_layout_dirty;
+
+	StructuredBuffer* m_skinning_buffer;
+	ConstantBuffer* m_skinning_range_cb;
+	uint m_skinning_buffer_capacity;
+
+public:
+	AnimationSystem(uint instances_per_job = DEFAULT_ANIMATION_INSTANCES_PER_JOB);
+	~AnimationSystem();
+
+	void add_instance(SkeletonInstance* instance, const Motion* motion = nullptr);
+	void remove_instance(SkeletonInstance* instance);
+	void clear();
+
+	void set_motion(SkeletonInstance* instance, const Motion* motion);
+	void set_time(SkeletonInstance* instance, float time);
+	void set_time_all(float time);
+
+	void evaluate();
+	void evaluate_range(uint start_entry, uint end_entry);
+
+	void upload();
+	void bind_instance(const SkeletonInstance* instance);
+
+	const Matrix4* get_skinning_matrices(const SkeletonInstance* instance) const;
+	uint get_instance_count() const;
+	uint get_skinning_matrix_count() const;
+
+private:
+	animation_entry_t* find_entry(const SkeletonInstance* instance);
+	const Matrix4* find_or_create_inverse_bind_pose(const Skeleton* skeleton);
+	void rebuild_layout();
+};
@@ -88,6 +88,11 @@ Matrix4 Camera::get_projection()
     return RHIInstance::GetInstance().CreatePerspectiveProjection(m_nz, m_fz, m_fov, m_aspect);
 }
 
+Frustum Camera::get_frustum()
+{
+    return Frustum(get_view() * get_projection());
+}
+
 Vector3 Camera::get_world_position()
 {
     return m_transform.calc_world_position();
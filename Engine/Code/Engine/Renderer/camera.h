@@ -2,6 +2,7 @@
 
 #include "Engine/Renderer/transform.h"
 #include "Engine/Math/Matrix4.hpp"
+#include "Engine/Math/Frustum.hpp"
 
 class Camera
 {
@@ -24,6 +25,7 @@ class Camera
         void update(float ds);
         Matrix4 get_view();
         Matrix4 get_projection();
+        Frustum get_frustum();
         Vector3 get_world_position();
 
 		void look_at(const Vector3& world_pos, const Vector3& up = Vector3::Y_AXIS);
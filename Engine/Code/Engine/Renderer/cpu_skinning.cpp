@@ -0,0 +1,340 @@
+#include "Engine/Renderer/cpu_skinning.h"
+#include "Engine/Renderer/Mesh.hpp"
+#include "Engine/Renderer/Skeleton.hpp"
+#include "Engine/Renderer/SkeletonInstance.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <xmmintrin.h>
+
+//-----------------------------------------------------
+// Internal helpers
+
+// the palette is re-laid out as 4 columns per joint so a vertex is
+// out = x * c0 + y * c1 + z * c2 + c3 after blending the 4 influences
+#define FLOATS_PER_PALETTE_ENTRY (16)
+
+static void build_column_palette(std::vector<float>* out_palette, const Matrix4* skinning_matrices, uint matrix_count)
+{
+	// one extra zeroed entry at the end so out of range bone indices contribute nothing
+	out_palette->assign((matrix_count + 1) * FLOATS_PER_PALETTE_ENTRY, 0.0f);
+
+	float* dst = out_palette->data();
+	for(uint matrix_idx = 0; matrix_idx < matrix_count; ++matrix_idx){
+		const float* src = skinning_matrices[matrix_idx].data;
+		for(uint column = 0; column < 4; ++column){
+			for(uint row = 0; row < 4; ++row){
+				dst[(column * 4) + row] = src[(row * 4) + column];
+			}
+		}
+		dst += FLOATS_PER_PALETTE_ENTRY;
+	}
+}
+
+static inline void store_vector3(Vector3* out, __m128 v)
+{
+	float values[4];
+	_mm_storeu_ps(values, v);
+	out->x = values[0];
+	out->y = values[1];
+	out->z = values[2];
+}
+
+static inline __m128 normalize_vector3(__m128 v)
+{
+	__m128 sq = _mm_mul_ps(v, v);
+	__m128 len_sq = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+	len_sq = _mm_shuffle_ps(len_sq, len_sq, _MM_SHUFFLE(0, 0, 0, 0));
+
+	// leave degenerate vectors alone instead of producing NaNs
+	__m128 is_valid = _mm_cmpgt_ps(len_sq, _mm_setzero_ps());
+	__m128 normalized = _mm_div_ps(v, _mm_sqrt_ps(len_sq));
+	return _mm_or_ps(_mm_and_ps(is_valid, normalized), _mm_andnot_ps(is_valid, v));
+}
+
+static inline __m128 transform_direction(__m128 c0, __m128 c1, __m128 c2, const Vector3& dir)
+{
+	__m128 result = _mm_mul_ps(_mm_set1_ps(dir.x), c0);
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(dir.y), c1));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(dir.z), c2));
+	return normalize_vector3(result);
+}
+
+static void skin_range_sse(const Vertex3* in_vertexes, Vertex3* out_vertexes, uint vertex_count, const float* palette, uint matrix_count)
+{
+	const float* zero_entry = palette + (matrix_count * FLOATS_PER_PALETTE_ENTRY);
+
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& in = in_vertexes[vert_idx];
+		Vertex3& out = out_vertexes[vert_idx];
+
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+
+		for(uint influence = 0; influence < 4; ++influence){
+			uint bone_index = in.m_bone_indices.values[influence];
+			const float* entry = (bone_index < matrix_count) ? palette + (bone_index * FLOATS_PER_PALETTE_ENTRY) : zero_entry;
+
+			__m128 weight = _mm_set1_ps(in.m_bone_weights.values[influence]);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(weight, _mm_loadu_ps(entry + 0)));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(weight, _mm_loadu_ps(entry + 4)));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(weight, _mm_loadu_ps(entry + 8)));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(weight, _mm_loadu_ps(entry + 12)));
+		}
+
+		out = in;
+
+		__m128 position = _mm_mul_ps(_mm_set1_ps(in.m_position.x), c0);
+		position = _mm_add_ps(position, _mm_mul_ps(_mm_set1_ps(in.m_position.y), c1));
+		position = _mm_add_ps(position, _mm_mul_ps(_mm_set1_ps(in.m_position.z), c2));
+		position = _mm_add_ps(position, c3);
+
+		store_vector3(&out.m_position, position);
+		store_vector3(&out.m_normal, transform_direction(c0, c1, c2, in.m_normal));
+		store_vector3(&out.m_tangent, transform_direction(c0, c1, c2, in.m_tangent));
+		store_vector3(&out.m_bitangent, transform_direction(c0, c1, c2, in.m_bitangent));
+	}
+}
+
+static Vector3 skin_direction_scalar(const float* m, const Vector3& dir)
+{
+	Vector3 result;
+	result.x = (m[0] * dir.x) + (m[1] * dir.y) + (m[2] * dir.z);
+	result.y = (m[4] * dir.x) + (m[5] * dir.y) + (m[6] * dir.z);
+	result.z = (m[8] * dir.x) + (m[9] * dir.y) + (m[10] * dir.z);
+
+	float length = result.CalcLength();
+	if(length > 0.0f){
+		result *= (1.0f / length);
+	}
+
+	return result;
+}
+
+struct cpu_skinning_job_data_t
+{
+	const Vertex3* in_vertexes;
+	Vertex3* out_vertexes;
+	const float* palette;
+	uint matrix_count;
+};
+
+static void cpu_skinning_range_job(const cpu_skinning_job_data_t* data, uint start_vertex, uint end_vertex)
+{
+	skin_range_sse(data->in_vertexes + start_vertex, data->out_vertexes + start_vertex, end_vertex - start_vertex, data->palette, data->matrix_count);
+}
+
+//-----------------------------------------------------
+// Public API
+
+void cpu_skin_vertexes_scalar(const Vertex3* in_vertexes, Vertex3* out_vertexes, uint vertex_count, const Matrix4* skinning_matrices, uint matrix_count)
+{
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& in = in_vertexes[vert_idx];
+		Vertex3& out = out_vertexes[vert_idx];
+
+		float blended[16] = { 0.0f };
+		for(uint influence = 0; influence < 4; ++influence){
+			uint bone_index = in.m_bone_indices.values[influence];
+			if(bone_index >= matrix_count){
+				continue;
+			}
+
+			float weight = in.m_bone_weights.values[influence];
+			const float* m = skinning_matrices[bone_index].data;
+			for(uint i = 0; i < 16; ++i){
+				blended[i] += weight * m[i];
+			}
+		}
+
+		out = in;
+
+		const Vector3& p = in.m_position;
+		out.m_position.x = (blended[0] * p.x) + (blended[1] * p.y) + (blended[2] * p.z) + blended[3];
+		out.m_position.y = (blended[4] * p.x) + (blended[5] * p.y) + (blended[6] * p.z) + blended[7];
+		out.m_position.z = (blended[8] * p.x) + (blended[9] * p.y) + (blended[10] * p.z) + blended[11];
+
+		out.m_normal = skin_direction_scalar(blended, in.m_normal);
+		out.m_tangent = skin_direction_scalar(blended, in.m_tangent);
+		out.m_bitangent = skin_direction_scalar(blended, in.m_bitangent);
+	}
+}
+
+void cpu_skin_vertexes(const Vertex3* in_vertexes, Vertex3* out_vertexes, uint vertex_count, const Matrix4* skinning_matrices, uint matrix_count)
+{
+	std::vector<float> palette;
+	build_column_palette(&palette, skinning_matrices, matrix_count);
+	skin_range_sse(in_vertexes, out_vertexes, vertex_count, palette.data(), matrix_count);
+}
+
+void cpu_skin_vertexes_parallel(const Vertex3* in_vertexes,
+								Vertex3* out_vertexes,
+								uint vertex_count,
+								const Matrix4* skinning_matrices,
+								uint matrix_count,
+								uint vertexes_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	vertexes_per_job = Max(1U, vertexes_per_job);
+
+	std::vector<float> palette;
+	build_column_palette(&palette, skinning_matrices, matrix_count);
+
+	if(vertex_count <= vertexes_per_job){
+		skin_range_sse(in_vertexes, out_vertexes, vertex_count, palette.data(), matrix_count);
+		return;
+	}
+
+	cpu_skinning_job_data_t data;
+	data.in_vertexes = in_vertexes;
+	data.out_vertexes = out_vertexes;
+	data.palette = palette.data();
+	data.matrix_count = matrix_count;
+
+	std::vector<Job*> jobs;
+	jobs.reserve((vertex_count / vertexes_per_job) + 1);
+
+	for(uint start_vertex = 0; start_vertex < vertex_count; start_vertex += vertexes_per_job){
+		uint end_vertex = Min(start_vertex + vertexes_per_job, vertex_count);
+
+		Job* job = job_create(JOB_TYPE_GENERIC, cpu_skinning_range_job, (const cpu_skinning_job_data_t*)&data, start_vertex, end_vertex);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+void cpu_calc_skinning_matrices(const SkeletonInstance* instance, std::vector<Matrix4>* out_skinning_matrices)
+{
+	const Skeleton* skeleton = instance->m_skeleton;
+	uint joint_count = skeleton->get_joint_count();
+
+	std::vector<Matrix4> global_transforms;
+	global_transforms.resize(joint_count);
+	out_skinning_matrices->resize(joint_count);
+
+	// parents always come before their children in the hierarchy
+	for(uint joint_idx = 0; joint_idx < joint_count; ++joint_idx){
+		global_transforms[joint_idx] = instance->get_joint_local_transform(joint_idx);
+		if(skeleton->joint_has_parent(joint_idx)){
+			global_transforms[joint_idx] *= global_transforms[skeleton->get_joint_parent_index(joint_idx)];
+		}
+
+		Matrix4 inverse_bind = skeleton->m_transform_hierarchy.get_transform(joint_idx).get_inverse();
+		(*out_skinning_matrices)[joint_idx] = inverse_bind * global_transforms[joint_idx];
+	}
+}
+
+void cpu_skin_mesh(const Mesh* mesh, const SkeletonInstance* instance, std::vector<Vertex3>* out_vertexes)
+{
+	std::vector<Matrix4> skinning_matrices;
+	cpu_calc_skinning_matrices(instance, &skinning_matrices);
+
+	out_vertexes->resize(mesh->get_vertex_count());
+	if(out_vertexes->empty()){
+		return;
+	}
+
+	cpu_skin_vertexes_parallel(mesh->get_vertex_data(),
+							   out_vertexes->data(),
+							   mesh->get_vertex_count(),
+							   skinning_matrices.data(),
+							   (uint)skinning_matrices.size());
+}
+
+//-----------------------------------------------------
+// Benchmark
+
+static void make_random_skinning_test_data(std::vector<Vertex3>* out_vertexes, std::vector<Matrix4>* out_matrices, uint vertex_count, uint matrix_count)
+{
+	out_matrices->resize(matrix_count);
+	for(Matrix4& m : *out_matrices){
+		m = Matrix4::make_rotation_x_degrees(GetRandomFloatInRange(0.0f, 360.0f));
+		m *= Matrix4::make_rotation_y_degrees(GetRandomFloatInRange(0.0f, 360.0f));
+		m *= Matrix4::make_translation(GetRandomFloatInRange(-10.0f, 10.0f), GetRandomFloatInRange(-10.0f, 10.0f), GetRandomFloatInRange(-10.0f, 10.0f));
+	}
+
+	out_vertexes->resize(vertex_count);
+	for(Vertex3& v : *out_vertexes){
+		v.m_position = Vector3(GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f));
+		v.m_normal = Vector3::Y_AXIS;
+		v.m_tangent = Vector3::X_AXIS;
+		v.m_bitangent = Vector3::Z_AXIS;
+
+		Vector4 weights(GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne());
+		float total = weights.x + weights.y + weights.z + weights.w;
+		v.m_bone_weights = Vector4(weights.x / total, weights.y / total, weights.z / total, weights.w / total);
+
+		for(uint influence = 0; influence < 4; ++influence){
+			v.m_bone_indices.values[influence] = (uint)GetRandomIntLessThan((int)matrix_count);
+		}
+	}
+}
+
+static float calc_max_skinning_error(const std::vector<Vertex3>& a, const std::vector<Vertex3>& b)
+{
+	float max_error = 0.0f;
+	for(size_t vert_idx = 0; vert_idx < a.size(); ++vert_idx){
+		max_error = Max(max_error, (a[vert_idx].m_position - b[vert_idx].m_position).CalcLength());
+		max_error = Max(max_error, (a[vert_idx].m_normal - b[vert_idx].m_normal).CalcLength());
+		max_error = Max(max_error, (a[vert_idx].m_tangent - b[vert_idx].m_tangent).CalcLength());
+		max_error = Max(max_error, (a[vert_idx].m_bitangent - b[vert_idx].m_bitangent).CalcLength());
+	}
+	return max_error;
+}
+
+COMMAND(cpu_skinning_benchmark, "[uint:vertex_count, uint:joint_count] Compares scalar, SSE and job cpu skinning in vertexes per second")
+{
+	uint vertex_count = 1000000;
+	uint matrix_count = 64;
+
+	if(!args.is_at_end()){
+		vertex_count = Max(1U, args.next_uint_arg());
+	}
+
+	if(!args.is_at_end()){
+		matrix_count = Max(1U, args.next_uint_arg());
+	}
+
+	std::vector<Vertex3> in_vertexes;
+	std::vector<Matrix4> matrices;
+	make_random_skinning_test_data(&in_vertexes, &matrices, vertex_count, matrix_count);
+
+	std::vector<Vertex3> scalar_out(vertex_count);
+	std::vector<Vertex3> sse_out(vertex_count);
+	std::vector<Vertex3> parallel_out(vertex_count);
+
+	double start = get_current_time_seconds();
+	cpu_skin_vertexes_scalar(in_vertexes.data(), scalar_out.data(), vertex_count, matrices.data(), matrix_count);
+	double scalar_seconds = get_current_time_seconds() - start;
+
+	start = get_current_time_seconds();
+	cpu_skin_vertexes(in_vertexes.data(), sse_out.data(), vertex_count, matrices.data(), matrix_count);
+	double sse_seconds = get_current_time_seconds() - start;
+
+	start = get_current_time_seconds();
+	cpu_skin_vertexes_parallel(in_vertexes.data(), parallel_out.data(), vertex_count, matrices.data(), matrix_count);
+	double parallel_seconds = get_current_time_seconds() - start;
+
+	console_info("----CPU Skinning (%u vertexes, %u joints)----", vertex_count, matrix_count);
+	console_info("scalar:   %.2f Mverts/s", ((double)vertex_count / scalar_seconds) / 1000000.0);
+	console_info("sse:      %.2f Mverts/s", ((double)vertex_count / sse_seconds) / 1000000.0);
+	console_info("parallel: %.2f Mverts/s", ((double)vertex_count / parallel_seconds) / 1000000.0);
+
+	float sse_error = calc_max_skinning_error(scalar_out, sse_out);
+	float parallel_error = calc_max_skinning_error(scalar_out, parallel_out);
+	if(sse_error > 0.001f || parallel_error > 0.001f){
+		console_error("SIMD skinning does not match scalar reference: sse err %f, parallel err %f", sse_error, parallel_error);
+	}else{
+		console_info("SIMD results match scalar reference (max err %f)", Max(sse_error, parallel_error));
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/Vertex3.hpp"
+#include "Engine/Math/Matrix4.hpp"
+
+#include <vector>
+
+class Mesh;
+class SkeletonInstance;
+
+#define DEFAULT_CPU_SKINNING_VERTEXES_PER_JOB (4096)
+
+// CPU mirror of Data/HLSL/skinning.vert.  Each vertex is transformed by the weighted
+// sum of the 4 skinning matrices named by m_bone_indices.  Positions get the full
+// transform, normal/tangent/bitangent only the rotation and are renormalized.
+// Every other attribute is copied through untouched.
+//
+// in and out may not alias.  skinning_matrices is the same palette the gpu gets,
+// ie. inverse bind pose * current global pose per joint.
+
+// reference implementation, one vertex at a time
+void cpu_skin_vertexes_scalar(const Vertex3* in_vertexes, Vertex3* out_vertexes, uint vertex_count, const Matrix4* skinning_matrices, uint matrix_count);
+
+// SSE implementation, same results as the scalar path within float rounding
+void cpu_skin_vertexes(const Vertex3* in_vertexes, Vertex3* out_vertexes, uint vertex_count, const Matrix4* skinning_matrices, uint matrix_count);
+
+// splits the vertexes into ranges and runs cpu_skin_vertexes on the generic job threads, blocks until done
+void cpu_skin_vertexes_parallel(const Vertex3* in_vertexes,
+								Vertex3* out_vertexes,
+								uint vertex_count,
+								const Matrix4* skinning_matrices,
+								uint matrix_count,
+								uint vertexes_per_job = DEFAULT_CPU_SKINNING_VERTEXES_PER_JOB);
+
+// builds the skinning palette from the instance's current pose
+void cpu_calc_skinning_matrices(const SkeletonInstance* instance, std::vector<Matrix4>* out_skinning_matrices);
+
+// skins a mesh's vertexes with the instance's current pose
+void cpu_skin_mesh(const Mesh* mesh, const SkeletonInstance* instance, std::vector<Vertex3>* out_vertexes);
@@ -0,0 +1,150 @@
+#include "Engine/Renderer/frustum_culler.h"
+#include "Engine/Renderer/RenderableMesh.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <xmmintrin.h>
+#include <math.h>
+
+#define CULL_LANE_COUNT (4)
+
+void cull_stats_reset(cull_stats_t* stats)
+{
+	MemZero(stats);
+}
+
+void cull_stats_record(cull_stats_t* stats, uint num_tested, uint num_visible)
+{
+	if(nullptr == stats){
+		return;
+	}
+
+	stats->num_views++;
+	stats->num_tested += num_tested;
+	stats->num_visible += num_visible;
+	stats->num_culled += num_tested - num_visible;
+}
+
+void FrustumCuller::gather(const std::vector<RenderableMesh*>& renderables)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	m_renderables.clear();
+	for(RenderableMesh* rm : renderables){
+		if(nullptr != rm){
+			m_renderables.push_back(rm);
+		}
+	}
+
+	// pad out to a full lane so the SSE loop never needs a scalar tail
+	uint count = get_count();
+	uint padded_count = (count + (CULL_LANE_COUNT - 1)) & ~(CULL_LANE_COUNT - 1);
+
+	m_center_x.assign(padded_count, 0.0f);
+	m_center_y.assign(padded_count, 0.0f);
+	m_center_z.assign(padded_count, 0.0f);
+	m_extent_x.assign(padded_count, 0.0f);
+	m_extent_y.assign(padded_count, 0.0f);
+	m_extent_z.assign(padded_count, 0.0f);
+
+	for(uint idx = 0; idx < count; ++idx){
+		const AABB3& bounds = m_renderables[idx]->get_world_bounds();
+		Vector3 center = bounds.CalcCenter();
+		Vector3 extents = bounds.CalcHalfExtents();
+
+		m_center_x[idx] = center.x;
+		m_center_y[idx] = center.y;
+		m_center_z[idx] = center.z;
+		m_extent_x[idx] = extents.x;
+		m_extent_y[idx] = extents.y;
+		m_extent_z[idx] = extents.z;
+	}
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<RenderableMesh*>* out_visible, cull_stats_t* stats) const
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_visible->clear();
+
+	uint count = get_count();
+	uint padded_count = (uint)m_center_x.size();
+
+	// splat every plane up front, they're reused for every group of 4 boxes
+	__m128 plane_nx[NUM_FRUSTUM_PLANES];
+	__m128 plane_ny[NUM_FRUSTUM_PLANES];
+	__m128 plane_nz[NUM_FRUSTUM_PLANES];
+	__m128 plane_abs_nx[NUM_FRUSTUM_PLANES];
+	__m128 plane_abs_ny[NUM_FRUSTUM_PLANES];
+	__m128 plane_abs_nz[NUM_FRUSTUM_PLANES];
+	__m128 plane_offset[NUM_FRUSTUM_PLANES];
+
+	for(uint plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+		const Plane3& plane = frustum.m_planes[plane_idx];
+		plane_nx[plane_idx] = _mm_set1_ps(plane.m_normal.x);
+		plane_ny[plane_idx] = _mm_set1_ps(plane.m_normal.y);
+		plane_nz[plane_idx] = _mm_set1_ps(plane.m_normal.z);
+		plane_abs_nx[plane_idx] = _mm_set1_ps(fabsf(plane.m_normal.x));
+		plane_abs_ny[plane_idx] = _mm_set1_ps(fabsf(plane.m_normal.y));
+		plane_abs_nz[plane_idx] = _mm_set1_ps(fabsf(plane.m_normal.z));
+		plane_offset[plane_idx] = _mm_set1_ps(plane.m_offset);
+	}
+
+	__m128 zero = _mm_setzero_ps();
+
+	for(uint base = 0; base < padded_count; base += CULL_LANE_COUNT){
+		__m128 cx = _mm_loadu_ps(&m_center_x[base]);
+		__m128 cy = _mm_loadu_ps(&m_center_y[base]);
+		__m128 cz = _mm_loadu_ps(&m_center_z[base]);
+		__m128 ex = _mm_loadu_ps(&m_extent_x[base]);
+		__m128 ey = _mm_loadu_ps(&m_extent_y[base]);
+		__m128 ez = _mm_loadu_ps(&m_extent_z[base]);
+
+		__m128 outside = zero;
+		for(uint plane_idx = 0; plane_idx < NUM_FRUSTUM_PLANES; ++plane_idx){
+			__m128 dist = _mm_mul_ps(cx, plane_nx[plane_idx]);
+			dist = _mm_add_ps(dist, _mm_mul_ps(cy, plane_ny[plane_idx]));
+			dist = _mm_add_ps(dist, _mm_mul_ps(cz, plane_nz[plane_idx]));
+			dist = _mm_sub_ps(dist, plane_offset[plane_idx]);
+
+			__m128 radius = _mm_mul_ps(ex, plane_abs_nx[plane_idx]);
+			radius = _mm_add_ps(radius, _mm_mul_ps(ey, plane_abs_ny[plane_idx]));
+			radius = _mm_add_ps(radius, _mm_mul_ps(ez, plane_abs_nz[plane_idx]));
+
+			// fully behind this plane
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		int visible_mask = ~_mm_movemask_ps(outside) & 0xF;
+		for(uint lane = 0; lane < CULL_LANE_COUNT; ++lane){
+			uint idx = base + lane;
+			if((visible_mask & (1 << lane)) && (idx < count)){
+				out_visible->push_back(m_renderables[idx]);
+			}
+		}
+	}
+
+	cull_stats_record(stats, count, (uint)out_visible->size());
+}
+
+void FrustumCuller::cull_scalar(const Frustum& frustum, std::vector<RenderableMesh*>* out_visible, cull_stats_t* stats) const
+{
+	out_visible->clear();
+
+	uint count = get_count();
+	for(uint idx = 0; idx < count; ++idx){
+		Vector3 center(m_center_x[idx], m_center_y[idx], m_center_z[idx]);
+		Vector3 extents(m_extent_x[idx], m_extent_y[idx], m_extent_z[idx]);
+
+		if(frustum.is_aabb3_visible(AABB3(center - extents, center + extents))){
+			out_visible->push_back(m_renderables[idx]);
+		}
+	}
+
+	cull_stats_record(stats, count, (uint)out_visible->size());
+}
+
+uint FrustumCuller::get_count() const
+{
+	return (uint)m_renderables.size();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Math/Frustum.hpp"
+
+#include <vector>
+
+class RenderableMesh;
+
+struct cull_stats_t
+{
+	uint num_views;
+	uint num_tested;
+	uint num_visible;
+	uint num_culled;
+};
+
+void cull_stats_reset(cull_stats_t* stats);
+void cull_stats_record(cull_stats_t* stats, uint num_tested, uint num_visible);
+
+// Holds the world bounds of a set of renderables as SoA center/extent arrays
+// so a frustum can be tested against 4 boxes at a time.
+//
+// gather() once per frame (it refreshes any world bounds whose transform moved),
+// then cull() once per view.
+class FrustumCuller
+{
+public:
+	std::vector<RenderableMesh*> m_renderables;
+
+	std::vector<float> m_center_x;
+	std::vector<float> m_center_y;
+	std::vector<float> m_center_z;
+	std::vector<float> m_extent_x;
+	std::vector<float> m_extent_y;
+	std::vector<float> m_extent_z;
+
+public:
+	void gather(const std::vector<RenderableMesh*>& renderables);
+	void cull(const Frustum& frustum, std::vector<RenderableMesh*>* out_visible, cull_stats_t* stats = nullptr) const;
+
+	// same test one box at a time, kept as the reference for the SSE path
+	void cull_scalar(const Frustum& frustum, std::vector<RenderableMesh*>* out_visible, cull_stats_t* stats = nullptr) const;
+
+	uint get_count() const;
+};
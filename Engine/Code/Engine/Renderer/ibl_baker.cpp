@@ -0,0 +1,915 @@
+#include "Engine/Renderer/ibl_baker.h"
+#include "Engine/Renderer/texture_file.h"
+#include "Engine/Core/hdr_image.h"
+#include "Engine/Core/half_float.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+// the environment mip spherical harmonics are projected from, anything bigger only adds time
+#define SH9_PROJECTION_MAX_SIZE (64)
+
+static const char* s_cube_face_names[NUM_CUBE_FACES] = { "posx", "negx", "posy", "negy", "posz", "negz" };
+static const char* s_face_image_extensions[] = { ".exr", ".hdr", ".png", ".jpg" };
+
+//-----------------------------------------------------
+// float_cube_t
+float_cube_t::float_cube_t()
+	:size(0)
+	,mip_count(0)
+{
+}
+
+void float_cube_t::allocate(uint new_size, uint new_mip_count)
+{
+	size = new_size;
+	mip_count = new_mip_count;
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		mips[face].resize(mip_count);
+		for(uint mip = 0; mip < mip_count; ++mip){
+			uint mip_size = Max(1U, size >> mip);
+			mips[face][mip].allocate(mip_size, mip_size);
+		}
+	}
+}
+
+float_image_t& float_cube_t::get_face(uint face, uint mip)
+{
+	return mips[face][mip];
+}
+
+const float_image_t& float_cube_t::get_face(uint face, uint mip) const
+{
+	return mips[face][mip];
+}
+
+ibl_bake_options_t::ibl_bake_options_t()
+	:specular_size(DEFAULT_IBL_SPECULAR_SIZE)
+	,specular_samples(DEFAULT_IBL_SPECULAR_SAMPLES)
+	,irradiance_size(DEFAULT_IBL_IRRADIANCE_SIZE)
+	,rows_per_job(DEFAULT_IBL_ROWS_PER_JOB)
+{
+}
+
+//-----------------------------------------------------
+// Jobs, rows are numbered down all six faces so small faces still split up
+template<typename OP>
+static void run_ibl_rows(void(*rows_cb)(const OP*, uint, uint), const OP* op, uint row_count, uint rows_per_job)
+{
+	if((rows_per_job == 0) || (row_count <= rows_per_job)){
+		rows_cb(op, 0, row_count);
+		return;
+	}
+
+	std::vector<Job*> jobs;
+	jobs.reserve((row_count + rows_per_job - 1) / rows_per_job);
+	for(uint first_row = 0; first_row < row_count; first_row += rows_per_job){
+		uint end_row = Min(first_row + rows_per_job, row_count);
+		Job* job = job_create(JOB_TYPE_GENERIC, rows_cb, op, first_row, end_row);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+//-----------------------------------------------------
+// Cube directions, d3d's layout: u right and v down across each face
+static void get_cube_direction(uint face, float u, float v, float* out_dir)
+{
+	switch(face){
+		case CUBE_FACE_POS_X:	out_dir[0] = 1.0f;	out_dir[1] = -v;	out_dir[2] = -u;	break;
+		case CUBE_FACE_NEG_X:	out_dir[0] = -1.0f;	out_dir[1] = -v;	out_dir[2] = u;		break;
+		case CUBE_FACE_POS_Y:	out_dir[0] = u;		out_dir[1] = 1.0f;	out_dir[2] = v;		break;
+		case CUBE_FACE_NEG_Y:	out_dir[0] = u;		out_dir[1] = -1.0f;	out_dir[2] = -v;	break;
+		case CUBE_FACE_POS_Z:	out_dir[0] = u;		out_dir[1] = -v;	out_dir[2] = 1.0f;	break;
+		default:				out_dir[0] = -u;	out_dir[1] = -v;	out_dir[2] = -1.0f;	break;
+	}
+}
+
+void get_cube_texel_direction(uint face, uint x, uint y, uint size, float* out_dir)
+{
+	float u = ((((float)x + 0.5f) / (float)size) * 2.0f) - 1.0f;
+	float v = ((((float)y + 0.5f) / (float)size) * 2.0f) - 1.0f;
+	get_cube_direction(face, u, v, out_dir);
+}
+
+static void normalize3(float* v)
+{
+	float inv_length = 1.0f / sqrtf((v[0] * v[0]) + (v[1] * v[1]) + (v[2] * v[2]));
+	v[0] *= inv_length;
+	v[1] *= inv_length;
+	v[2] *= inv_length;
+}
+
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// four directions to the face each points at and where on it, s and t in [0, 1]
+static void project_cube_directions_sse(__m128 x, __m128 y, __m128 z, __m128i* out_face, __m128* out_s, __m128* out_t)
+{
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128 abs_x = _mm_andnot_ps(sign_mask, x);
+	__m128 abs_y = _mm_andnot_ps(sign_mask, y);
+	__m128 abs_z = _mm_andnot_ps(sign_mask, z);
+	__m128 sign_x = _mm_and_ps(sign_mask, x);
+	__m128 sign_y = _mm_and_ps(sign_mask, y);
+	__m128 sign_z = _mm_and_ps(sign_mask, z);
+
+	__m128 is_x = _mm_and_ps(_mm_cmpge_ps(abs_x, abs_y), _mm_cmpge_ps(abs_x, abs_z));
+	__m128 is_y = _mm_andnot_ps(is_x, _mm_cmpge_ps(abs_y, abs_z));
+	__m128 is_x_or_y = _mm_or_ps(is_x, is_y);
+
+	// x major: s = -z * sign(x), t = -y
+	// y major: s = x, t = z * sign(y)
+	// z major: s = x * sign(z), t = -y
+	__m128 neg_y = _mm_xor_ps(y, sign_mask);
+	__m128 neg_z = _mm_xor_ps(z, sign_mask);
+	__m128 sc = select_ps(is_x, _mm_xor_ps(neg_z, sign_x), select_ps(is_y, x, _mm_xor_ps(x, sign_z)));
+	__m128 tc = select_ps(is_y, _mm_xor_ps(z, sign_y), neg_y);
+	__m128 major = select_ps(is_x, abs_x, select_ps(is_y, abs_y, abs_z));
+	__m128 major_sign = select_ps(is_x, sign_x, select_ps(is_y, sign_y, sign_z));
+
+	// +x, +y, +z are 0, 2 and 4, the negative face is one more
+	__m128i face = _mm_andnot_si128(_mm_castps_si128(is_x_or_y), _mm_set1_epi32(CUBE_FACE_POS_Z));
+	face = _mm_or_si128(face, _mm_and_si128(_mm_castps_si128(is_y), _mm_set1_epi32(CUBE_FACE_POS_Y)));
+	face = _mm_add_epi32(face, _mm_srli_epi32(_mm_castps_si128(major_sign), 31));
+
+	__m128 scale = _mm_div_ps(half, major);
+	*out_face = face;
+	*out_s = _mm_add_ps(_mm_mul_ps(sc, scale), half);
+	*out_t = _mm_add_ps(_mm_mul_ps(tc, scale), half);
+}
+
+// bilinear with the edges clamped, s and t in [0, 1] across the face
+static void sample_face_bilinear(const float_image_t& face, float s, float t, float* out_rgb)
+{
+	float fx = Clamp((s * (float)face.width) - 0.5f, 0.0f, (float)(face.width - 1));
+	float fy = Clamp((t * (float)face.height) - 0.5f, 0.0f, (float)(face.height - 1));
+	uint x0 = (uint)fx;
+	uint y0 = (uint)fy;
+	uint x1 = Min(x0 + 1, face.width - 1);
+	uint y1 = Min(y0 + 1, face.height - 1);
+	float tx = fx - (float)x0;
+	float ty = fy - (float)y0;
+
+	const float* row0 = &face.texels[(size_t)y0 * face.width * 4];
+	const float* row1 = &face.texels[(size_t)y1 * face.width * 4];
+	for(uint channel = 0; channel < 3; ++channel){
+		float top = row0[x0 * 4 + channel] + ((row0[x1 * 4 + channel] - row0[x0 * 4 + channel]) * tx);
+		float bottom = row1[x0 * 4 + channel] + ((row1[x1 * 4 + channel] - row1[x0 * 4 + channel]) * tx);
+		out_rgb[channel] = top + ((bottom - top) * ty);
+	}
+}
+
+//-----------------------------------------------------
+// Panorama to cube
+struct cube_from_equirect_t
+{
+	const float_image_t* pano;
+	float_cube_t* cube;
+	uint samples_per_axis;
+};
+
+// wraps around in u, clamps at the poles
+static void sample_pano_bilinear(const float_image_t& pano, float u, float v, float* out_rgb)
+{
+	float fx = (u * (float)pano.width) - 0.5f;
+	float fy = Clamp((v * (float)pano.height) - 0.5f, 0.0f, (float)(pano.height - 1));
+	float floor_x = floorf(fx);
+	int x0 = (int)floor_x % (int)pano.width;
+	x0 = (x0 < 0) ? x0 + (int)pano.width : x0;
+	uint x1 = ((uint)x0 + 1) % pano.width;
+	uint y0 = (uint)fy;
+	uint y1 = Min(y0 + 1, pano.height - 1);
+	float tx = fx - floor_x;
+	float ty = fy - (float)y0;
+
+	const float* row0 = &pano.texels[(size_t)y0 * pano.width * 4];
+	const float* row1 = &pano.texels[(size_t)y1 * pano.width * 4];
+	for(uint channel = 0; channel < 3; ++channel){
+		float top = row0[x0 * 4 + channel] + ((row0[x1 * 4 + channel] - row0[x0 * 4 + channel]) * tx);
+		float bottom = row1[x0 * 4 + channel] + ((row1[x1 * 4 + channel] - row1[x0 * 4 + channel]) * tx);
+		out_rgb[channel] = top + ((bottom - top) * ty);
+	}
+}
+
+static void cube_from_equirect_rows(const cube_from_equirect_t* op, uint first_row, uint end_row)
+{
+	uint size = op->cube->size;
+	uint samples = op->samples_per_axis;
+	float inv_sample_count = 1.0f / (float)(samples * samples);
+
+	for(uint row = first_row; row < end_row; ++row){
+		uint face = row / size;
+		uint y = row % size;
+		float* out = &op->cube->get_face(face, 0).texels[(size_t)y * size * 4];
+
+		for(uint x = 0; x < size; ++x){
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for(uint sample_y = 0; sample_y < samples; ++sample_y){
+				for(uint sample_x = 0; sample_x < samples; ++sample_x){
+					float u = ((((float)x + (((float)sample_x + 0.5f) / (float)samples)) / (float)size) * 2.0f) - 1.0f;
+					float v = ((((float)y + (((float)sample_y + 0.5f) / (float)samples)) / (float)size) * 2.0f) - 1.0f;
+					float dir[3];
+					get_cube_direction(face, u, v, dir);
+					normalize3(dir);
+
+					// longitude from +x towards +z, latitude from +y down
+					float pano_u = atan2f(dir[2], dir[0]) / TWO_M_PI;
+					pano_u = (pano_u < 0.0f) ? pano_u + 1.0f : pano_u;
+					float pano_v = acosf(Clamp(dir[1], -1.0f, 1.0f)) / M_PI;
+
+					float rgb[3];
+					sample_pano_bilinear(*op->pano, pano_u, pano_v, rgb);
+					sum[0] += rgb[0];
+					sum[1] += rgb[1];
+					sum[2] += rgb[2];
+				}
+			}
+
+			out[x * 4 + 0] = sum[0] * inv_sample_count;
+			out[x * 4 + 1] = sum[1] * inv_sample_count;
+			out[x * 4 + 2] = sum[2] * inv_sample_count;
+			out[x * 4 + 3] = 1.0f;
+		}
+	}
+}
+
+bool cube_from_equirect(const float_image_t& pano, uint size, float_cube_t* out_cube, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if((pano.width == 0) || (pano.height == 0) || (size == 0)){
+		return false;
+	}
+
+	out_cube->allocate(size, 1);
+
+	// four faces go around the equator
+	cube_from_equirect_t op;
+	op.pano = &pano;
+	op.cube = out_cube;
+	op.samples_per_axis = Clamp((pano.width + (4 * size) - 1) / (4 * size), 1U, 4U);
+	run_ibl_rows(cube_from_equirect_rows, (const cube_from_equirect_t*)&op, NUM_CUBE_FACES * size, rows_per_job);
+	return true;
+}
+
+bool cube_from_face_images(const std::string& directory, uint size, float_cube_t* out_cube)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_cube->allocate(size, 1);
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		float_image_t image;
+		bool did_load = false;
+		for(const char* extension : s_face_image_extensions){
+			std::vector<std::string> found = find_files_in_directory(directory.c_str(), Stringf("%s%s", s_cube_face_names[face], extension).c_str());
+			if(!found.empty()){
+				did_load = load_float_image(Stringf("%s/%s", directory.c_str(), found[0].c_str()).c_str(), &image);
+				break;
+			}
+		}
+
+		if(!did_load){
+			log_warningf("No %s face image in [%s]\n", s_cube_face_names[face], directory.c_str());
+			return false;
+		}
+		if(image.width != image.height){
+			log_warningf("The %s face in [%s] is %ux%u, faces need to be square\n", s_cube_face_names[face], directory.c_str(), image.width, image.height);
+			return false;
+		}
+
+		if(image.width == size){
+			out_cube->get_face(face, 0) = image;
+		}else{
+			image_resize(image, size, size, IMAGE_RESIZE_FILTER_MITCHELL, &out_cube->get_face(face, 0));
+		}
+	}
+	return true;
+}
+
+void generate_cube_mips(float_cube_t* cube)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint mip_count = calc_full_mip_count(cube->size, cube->size);
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		cube->mips[face].resize(mip_count);
+		for(uint mip = 1; mip < mip_count; ++mip){
+			uint mip_size = Max(1U, cube->size >> mip);
+			image_resize(cube->get_face(face, mip - 1), mip_size, mip_size, IMAGE_RESIZE_FILTER_BOX, &cube->get_face(face, mip));
+		}
+	}
+	cube->mip_count = mip_count;
+}
+
+//-----------------------------------------------------
+// Specular
+//
+// With the view along the normal every sample's light direction, weight and
+// pdf only depend on where it is around the normal, so each mip builds one
+// table in tangent space and every texel just rotates it into place.
+struct specular_sample_table_t
+{
+	// structure of arrays, padded to a multiple of four with zero weight samples
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> weight;
+	std::vector<float> env_mip;
+	float inv_total_weight;
+};
+
+static float radical_inverse(u32 bits)
+{
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555U) << 1) | ((bits & 0xAAAAAAAAU) >> 1);
+	bits = ((bits & 0x33333333U) << 2) | ((bits & 0xCCCCCCCCU) >> 2);
+	bits = ((bits & 0x0F0F0F0FU) << 4) | ((bits & 0xF0F0F0F0U) >> 4);
+	bits = ((bits & 0x00FF00FFU) << 8) | ((bits & 0xFF00FF00U) >> 8);
+	return (float)bits * 2.3283064365386963e-10f;
+}
+
+// the same points the shaders use
+static void hammersley(uint idx, uint count, float* out_x, float* out_y)
+{
+	*out_x = (float)idx / (float)count;
+	*out_y = radical_inverse(idx);
+}
+
+static void build_specular_sample_table(float roughness, uint sample_count, const float_cube_t& env, specular_sample_table_t* out_table)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+
+	// solid angle of one texel of the top environment mip
+	float texel_solid_angle = (4.0f * M_PI) / (6.0f * (float)env.size * (float)env.size);
+	float max_env_mip = (float)(env.mip_count - 1);
+
+	float total_weight = 0.0f;
+	for(uint sample_idx = 0; sample_idx < sample_count; ++sample_idx){
+		float xi_x;
+		float xi_y;
+		hammersley(sample_idx, sample_count, &xi_x, &xi_y);
+
+		float phi = xi_x * TWO_M_PI;
+		float cos_theta_h = sqrtf((1.0f - xi_y) / (1.0f + ((alpha2 - 1.0f) * xi_y)));
+		float sin_theta_h = sqrtf(1.0f - Min(1.0f, cos_theta_h * cos_theta_h));
+		float h[3] = { sin_theta_h * cosf(phi), sin_theta_h * sinf(phi), cos_theta_h };
+
+		// reflect the view (the normal) about h
+		float n_dot_l = (2.0f * cos_theta_h * cos_theta_h) - 1.0f;
+		if(n_dot_l <= 0.0f){
+			continue;
+		}
+
+		// v = n, so n_dot_h and l_dot_h cancel out of the pdf
+		float d_denom = (((cos_theta_h * alpha2) - cos_theta_h) * cos_theta_h) + 1.0f;
+		float d = alpha2 / (M_PI * d_denom * d_denom);
+		float pdf = d * 0.25f;
+		float sample_solid_angle = 1.0f / ((float)sample_count * pdf);
+
+		out_table->x.push_back(2.0f * cos_theta_h * h[0]);
+		out_table->y.push_back(2.0f * cos_theta_h * h[1]);
+		out_table->z.push_back(n_dot_l);
+		out_table->weight.push_back(n_dot_l);
+		out_table->env_mip.push_back(Clamp(0.5f * log2f(sample_solid_angle / texel_solid_angle), 0.0f, max_env_mip));
+		total_weight += n_dot_l;
+	}
+
+	while((out_table->x.size() % 4) != 0){
+		out_table->x.push_back(0.0f);
+		out_table->y.push_back(0.0f);
+		out_table->z.push_back(1.0f);
+		out_table->weight.push_back(0.0f);
+		out_table->env_mip.push_back(0.0f);
+	}
+
+	out_table->inv_total_weight = (total_weight > 0.0f) ? (1.0f / total_weight) : 0.0f;
+}
+
+struct prefilter_specular_t
+{
+	const float_cube_t* env;
+	const specular_sample_table_t* table;
+	float_cube_t* out_cube;
+	uint mip;
+};
+
+static void prefilter_specular_rows(const prefilter_specular_t* op, uint first_row, uint end_row)
+{
+	const specular_sample_table_t& table = *op->table;
+	const float_cube_t& env = *op->env;
+	uint size = op->out_cube->get_face(0, op->mip).width;
+	uint sample_count = (uint)table.x.size();
+
+	for(uint row = first_row; row < end_row; ++row){
+		uint face = row / size;
+		uint y = row % size;
+		float* out = &op->out_cube->get_face(face, op->mip).texels[(size_t)y * size * 4];
+
+		for(uint x = 0; x < size; ++x){
+			float n[3];
+			get_cube_texel_direction(face, x, y, size, n);
+			normalize3(n);
+
+			// same tangent frame as importance_sample_ggx
+			float up[3] = { 0.0f, 0.0f, 1.0f };
+			if(fabsf(n[2]) >= 0.999f){
+				up[0] = 1.0f;
+				up[2] = 0.0f;
+			}
+			float tx[3] = { (up[1] * n[2]) - (up[2] * n[1]), (up[2] * n[0]) - (up[0] * n[2]), (up[0] * n[1]) - (up[1] * n[0]) };
+			normalize3(tx);
+			float ty[3] = { (n[1] * tx[2]) - (n[2] * tx[1]), (n[2] * tx[0]) - (n[0] * tx[2]), (n[0] * tx[1]) - (n[1] * tx[0]) };
+
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for(uint sample_idx = 0; sample_idx < sample_count; sample_idx += 4){
+				__m128 lx = _mm_loadu_ps(&table.x[sample_idx]);
+				__m128 ly = _mm_loadu_ps(&table.y[sample_idx]);
+				__m128 lz = _mm_loadu_ps(&table.z[sample_idx]);
+
+				__m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[0])), _mm_mul_ps(ly, _mm_set1_ps(ty[0]))), _mm_mul_ps(lz, _mm_set1_ps(n[0])));
+				__m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[1])), _mm_mul_ps(ly, _mm_set1_ps(ty[1]))), _mm_mul_ps(lz, _mm_set1_ps(n[1])));
+				__m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[2])), _mm_mul_ps(ly, _mm_set1_ps(ty[2]))), _mm_mul_ps(lz, _mm_set1_ps(n[2])));
+
+				__m128i faces;
+				__m128 s;
+				__m128 t;
+				project_cube_directions_sse(wx, wy, wz, &faces, &s, &t);
+
+				u32 lane_faces[4];
+				float lane_s[4];
+				float lane_t[4];
+				_mm_storeu_si128((__m128i*)lane_faces, faces);
+				_mm_storeu_ps(lane_s, s);
+				_mm_storeu_ps(lane_t, t);
+
+				// the fetches themselves are a gather, one lane at a time
+				for(uint lane = 0; lane < 4; ++lane){
+					float weight = table.weight[sample_idx + lane];
+					if(weight == 0.0f){
+						continue;
+					}
+
+					float env_mip = table.env_mip[sample_idx + lane];
+					uint mip0 = (uint)env_mip;
+					uint mip1 = Min(mip0 + 1, env.mip_count - 1);
+					float mip_t = env_mip - (float)mip0;
+
+					float rgb0[3];
+					float rgb1[3];
+					sample_face_bilinear(env.get_face(lane_faces[lane], mip0), lane_s[lane], lane_t[lane], rgb0);
+					sample_face_bilinear(env.get_face(lane_faces[lane], mip1), lane_s[lane], lane_t[lane], rgb1);
+					for(uint channel = 0; channel < 3; ++channel){
+						sum[channel] += (rgb0[channel] + ((rgb1[channel] - rgb0[channel]) * mip_t)) * weight;
+					}
+				}
+			}
+
+			out[x * 4 + 0] = sum[0] * table.inv_total_weight;
+			out[x * 4 + 1] = sum[1] * table.inv_total_weight;
+			out[x * 4 + 2] = sum[2] * table.inv_total_weight;
+			out[x * 4 + 3] = 1.0f;
+		}
+	}
+}
+
+void prefilter_specular_cube(const float_cube_t& env, uint sample_count, float_cube_t* out_cube, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint mip_count = calc_full_mip_count(env.size, env.size);
+	out_cube->allocate(env.size, mip_count);
+
+	// mirror like, nothing to filter
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		out_cube->get_face(face, 0) = env.get_face(face, 0);
+	}
+
+	for(uint mip = 1; mip < mip_count; ++mip){
+		specular_sample_table_t table;
+		build_specular_sample_table((float)mip / (float)mip_count, sample_count, env, &table);
+
+		prefilter_specular_t op;
+		op.env = &env;
+		op.table = &table;
+		op.out_cube = out_cube;
+		op.mip = mip;
+		run_ibl_rows(prefilter_specular_rows, (const prefilter_specular_t*)&op, NUM_CUBE_FACES * Max(1U, env.size >> mip), rows_per_job);
+	}
+}
+
+//-----------------------------------------------------
+// Irradiance
+static void eval_sh9_basis(const float* dir, float* out_basis)
+{
+	float x = dir[0];
+	float y = dir[1];
+	float z = dir[2];
+
+	out_basis[0] = 0.282095f;
+	out_basis[1] = 0.488603f * y;
+	out_basis[2] = 0.488603f * z;
+	out_basis[3] = 0.488603f * x;
+	out_basis[4] = 1.092548f * x * y;
+	out_basis[5] = 1.092548f * y * z;
+	out_basis[6] = 0.315392f * ((3.0f * z * z) - 1.0f);
+	out_basis[7] = 1.092548f * x * z;
+	out_basis[8] = 0.546274f * ((x * x) - (y * y));
+}
+
+void project_cube_to_sh9(const float_cube_t& env, ibl_sh9_t* out_sh)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint mip = 0;
+	while(((env.size >> mip) > SH9_PROJECTION_MAX_SIZE) && ((mip + 1) < env.mip_count)){
+		mip++;
+	}
+
+	uint size = env.get_face(0, mip).width;
+	double sums[9][3];
+	MemZero(&sums);
+	double total_solid_angle = 0.0;
+
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		const float_image_t& image = env.get_face(face, mip);
+		for(uint y = 0; y < size; ++y){
+			for(uint x = 0; x < size; ++x){
+				float dir[3];
+				get_cube_texel_direction(face, x, y, size, dir);
+
+				// a texel's solid angle falls off towards the face's corners
+				float length2 = (dir[0] * dir[0]) + (dir[1] * dir[1]) + (dir[2] * dir[2]);
+				float solid_angle = (4.0f / ((float)size * (float)size)) / (length2 * sqrtf(length2));
+				normalize3(dir);
+
+				float basis[9];
+				eval_sh9_basis(dir, basis);
+				const float* texel = &image.texels[((size_t)y * size + x) * 4];
+				for(uint coeff = 0; coeff < 9; ++coeff){
+					for(uint channel = 0; channel < 3; ++channel){
+						sums[coeff][channel] += (double)(texel[channel] * basis[coeff] * solid_angle);
+					}
+				}
+				total_solid_angle += solid_angle;
+			}
+		}
+	}
+
+	// the texel solid angles are an approximation, make them add up to the sphere
+	double normalize = (4.0 * M_PI) / total_solid_angle;
+	for(uint coeff = 0; coeff < 9; ++coeff){
+		for(uint channel = 0; channel < 3; ++channel){
+			out_sh->rgb[coeff][channel] = (float)(sums[coeff][channel] * normalize);
+		}
+	}
+}
+
+void render_irradiance_cube(const ibl_sh9_t& sh, uint size, float_cube_t* out_cube)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	// cosine lobe per band (pi, 2pi/3, pi/4), then / pi
+	static const float band_scale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+	out_cube->allocate(size, 1);
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		float* texels = out_cube->get_face(face, 0).texels.data();
+		for(uint y = 0; y < size; ++y){
+			for(uint x = 0; x < size; ++x){
+				float dir[3];
+				get_cube_texel_direction(face, x, y, size, dir);
+				normalize3(dir);
+
+				float basis[9];
+				eval_sh9_basis(dir, basis);
+				float* out = &texels[((size_t)y * size + x) * 4];
+				for(uint channel = 0; channel < 3; ++channel){
+					float value = 0.0f;
+					for(uint coeff = 0; coeff < 9; ++coeff){
+						value += sh.rgb[coeff][channel] * basis[coeff] * band_scale[coeff];
+					}
+					out[channel] = Max(value, 0.0f);
+				}
+				out[3] = 1.0f;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------
+// DFG
+//
+// Every texel in a row has the same roughness, so the sample directions are
+// shared and four n_dot_v texels go through each sample together.
+struct dfg_sample_t
+{
+	// ggx half vector, y doesn't matter with the view in the xz plane
+	float h_x;
+	float h_z;
+
+	// cosine distributed light for the diffuse term
+	float l_x;
+	float l_y;
+	float l_z;
+};
+
+struct bake_dfg_t
+{
+	uint size;
+	uint sample_count;
+	float_image_t* lut;
+};
+
+static __m128 pow5_ps(__m128 value)
+{
+	__m128 value2 = _mm_mul_ps(value, value);
+	return _mm_mul_ps(_mm_mul_ps(value2, value2), value);
+}
+
+static __m128 saturate_ps(__m128 value)
+{
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+static void build_dfg_samples(float roughness, uint sample_count, std::vector<dfg_sample_t>* out_samples)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+
+	out_samples->resize(sample_count);
+	for(uint sample_idx = 0; sample_idx < sample_count; ++sample_idx){
+		float xi_x;
+		float xi_y;
+		hammersley(sample_idx, sample_count, &xi_x, &xi_y);
+
+		// importance_sample_ggx around +z, whose tangent frame puts the sample's sin(phi) on x
+		float phi = xi_x * TWO_M_PI;
+		float cos_theta_h = sqrtf((1.0f - xi_y) / (1.0f + ((alpha2 - 1.0f) * xi_y)));
+		float sin_theta_h = sqrtf(1.0f - Min(1.0f, cos_theta_h * cos_theta_h));
+
+		dfg_sample_t& sample = (*out_samples)[sample_idx];
+		sample.h_x = sin_theta_h * sinf(phi);
+		sample.h_z = cos_theta_h;
+
+		// importance_sample_cos_dir with the point shifted half way round
+		float cos_x = xi_x + 0.5f;
+		float cos_y = xi_y + 0.5f;
+		cos_x -= floorf(cos_x);
+		cos_y -= floorf(cos_y);
+		float r = sqrtf(cos_x);
+		float cos_phi = cos_y * TWO_M_PI;
+		float light[3] = { r * cosf(cos_phi), r * sinf(cos_phi), sqrtf(Max(0.0f, 1.0f - cos_x)) };
+		normalize3(light);
+		sample.l_x = light[0];
+		sample.l_y = light[1];
+		sample.l_z = light[2];
+	}
+}
+
+static void bake_dfg_rows(const bake_dfg_t* op, uint first_row, uint end_row)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 inv_sample_count = _mm_set1_ps(1.0f / (float)op->sample_count);
+
+	std::vector<dfg_sample_t> samples;
+	uint size = op->size;
+	for(uint y = first_row; y < end_row; ++y){
+		float roughness = ((float)y + 0.5f) / (float)size;
+		float alpha = roughness * roughness;
+		build_dfg_samples(roughness, op->sample_count, &samples);
+
+		__m128 alpha2 = _mm_set1_ps(alpha * alpha);
+		__m128 alpha_v = _mm_set1_ps(alpha);
+		__m128 energy_bias = _mm_set1_ps(0.5f * alpha);
+		__m128 energy_factor = _mm_set1_ps(1.0f + (((1.0f / 1.51f) - 1.0f) * alpha));
+
+		float* out = &op->lut->texels[(size_t)y * size * 4];
+		for(uint x = 0; x < size; x += 4){
+			__m128 n_dot_v = _mm_div_ps(_mm_add_ps(_mm_setr_ps((float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)size));
+			__m128 v_x = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(n_dot_v, n_dot_v)));
+			__m128 v_z = n_dot_v;
+
+			// (-n_dot_v * a2 + n_dot_v) * n_dot_v + a2 doesn't change per sample
+			__m128 lambda_v_root = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(n_dot_v, _mm_mul_ps(n_dot_v, alpha2)), n_dot_v), alpha2));
+			__m128 view_scatter_curve = pow5_ps(_mm_sub_ps(one, n_dot_v));
+
+			__m128 sum_x = zero;
+			__m128 sum_y = zero;
+			__m128 sum_z = zero;
+			for(const dfg_sample_t& sample : samples){
+				__m128 h_x = _mm_set1_ps(sample.h_x);
+				__m128 h_z = _mm_set1_ps(sample.h_z);
+
+				// specular
+				__m128 v_dot_h_raw = _mm_add_ps(_mm_mul_ps(v_x, h_x), _mm_mul_ps(v_z, h_z));
+				__m128 n_dot_l = saturate_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, v_dot_h_raw), h_z), v_z));
+				__m128 n_dot_h = saturate_ps(h_z);
+				__m128 v_dot_h = saturate_ps(v_dot_h_raw);
+
+				__m128 lambda_v = _mm_mul_ps(n_dot_l, lambda_v_root);
+				__m128 lambda_l = _mm_mul_ps(n_dot_v, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(n_dot_l, _mm_mul_ps(n_dot_l, alpha2)), n_dot_l), alpha2)));
+				__m128 g = _mm_div_ps(_mm_set1_ps(0.5f), _mm_add_ps(lambda_v, lambda_l));
+				__m128 g_vis = _mm_mul_ps(g, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), n_dot_l), v_dot_h), n_dot_h));
+				__m128 fc = pow5_ps(_mm_sub_ps(one, v_dot_h));
+
+				__m128 is_lit = _mm_cmpgt_ps(n_dot_l, zero);
+				sum_x = _mm_add_ps(sum_x, _mm_and_ps(is_lit, _mm_mul_ps(_mm_sub_ps(one, fc), g_vis)));
+				sum_y = _mm_add_ps(sum_y, _mm_and_ps(is_lit, _mm_mul_ps(fc, g_vis)));
+
+				// diffuse, the light is the same for every lane but the half vector isn't
+				if(sample.l_z > 0.0f){
+					__m128 l_x = _mm_set1_ps(sample.l_x);
+					__m128 l_y = _mm_set1_ps(sample.l_y);
+					__m128 l_z = _mm_set1_ps(sample.l_z);
+					__m128 half_x = _mm_add_ps(v_x, l_x);
+					__m128 half_z = _mm_add_ps(v_z, l_z);
+					__m128 half_length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(half_x, half_x), _mm_mul_ps(l_y, l_y)), _mm_mul_ps(half_z, half_z));
+					__m128 l_dot_half = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l_x, half_x), _mm_mul_ps(l_y, l_y)), _mm_mul_ps(l_z, half_z));
+					__m128 l_dot_h = saturate_ps(_mm_div_ps(l_dot_half, _mm_sqrt_ps(half_length2)));
+
+					__m128 fd90 = _mm_add_ps(energy_bias, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(two, l_dot_h), l_dot_h), alpha_v));
+					__m128 fd90_minus_one = _mm_sub_ps(fd90, one);
+					__m128 light_scatter = _mm_add_ps(one, _mm_mul_ps(fd90_minus_one, _mm_set1_ps(powf(1.0f - Min(sample.l_z, 1.0f), 5.0f))));
+					__m128 view_scatter = _mm_add_ps(one, _mm_mul_ps(fd90_minus_one, view_scatter_curve));
+					sum_z = _mm_add_ps(sum_z, _mm_mul_ps(_mm_mul_ps(light_scatter, view_scatter), energy_factor));
+				}
+			}
+
+			float lanes_x[4];
+			float lanes_y[4];
+			float lanes_z[4];
+			_mm_storeu_ps(lanes_x, _mm_mul_ps(sum_x, inv_sample_count));
+			_mm_storeu_ps(lanes_y, _mm_mul_ps(sum_y, inv_sample_count));
+			_mm_storeu_ps(lanes_z, _mm_mul_ps(sum_z, inv_sample_count));
+			for(uint lane = 0; (lane < 4) && ((x + lane) < size); ++lane){
+				float* texel = &out[(x + lane) * 4];
+				texel[0] = lanes_x[lane];
+				texel[1] = lanes_y[lane];
+				texel[2] = lanes_z[lane];
+				texel[3] = 1.0f;
+			}
+		}
+	}
+}
+
+void bake_dfg_lut(uint size, uint sample_count, float_image_t* out_lut, uint rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_lut->allocate(size, size);
+
+	bake_dfg_t op;
+	op.size = size;
+	op.sample_count = sample_count;
+	op.lut = out_lut;
+	run_ibl_rows(bake_dfg_rows, (const bake_dfg_t*)&op, size, rows_per_job);
+}
+
+//-----------------------------------------------------
+// Writing
+bool write_float_cube_texture_file(const char* filename, const float_cube_t& cube)
+{
+	std::vector<std::vector<u16>> halves(NUM_CUBE_FACES * cube.mip_count);
+	std::vector<const byte*> face_mip_data(NUM_CUBE_FACES * cube.mip_count);
+	for(uint face = 0; face < NUM_CUBE_FACES; ++face){
+		for(uint mip = 0; mip < cube.mip_count; ++mip){
+			const float_image_t& image = cube.get_face(face, mip);
+			std::vector<u16>& face_halves = halves[face * cube.mip_count + mip];
+			face_halves.resize(image.texels.size());
+			floats_to_halves(image.texels.data(), image.texels.size(), face_halves.data());
+			face_mip_data[face * cube.mip_count + mip] = (const byte*)face_halves.data();
+		}
+	}
+
+	return write_cube_texture_file(filename, TEXTURE_FILE_FORMAT_RGBA16F, 0, cube.size, cube.mip_count, face_mip_data.data());
+}
+
+bool write_float_texture_file(const char* filename, const float_image_t& image)
+{
+	std::vector<u16> halves(image.texels.size());
+	floats_to_halves(image.texels.data(), image.texels.size(), halves.data());
+
+	const byte* mip_data = (const byte*)halves.data();
+	return write_texture_file(filename, TEXTURE_FILE_FORMAT_RGBA16F, 0, image.width, image.height, 1, &mip_data);
+}
+
+//-----------------------------------------------------
+// Whole bake
+static bool is_directory_path(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	size_t dot = path.find_last_of('.');
+	return (dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash));
+}
+
+bool bake_ibl(const std::string& source, const std::string& out_directory, const ibl_bake_options_t& options)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	double start = get_current_time_seconds();
+
+	float_cube_t env;
+	if(is_directory_path(source)){
+		if(!cube_from_face_images(source, options.specular_size, &env)){
+			return false;
+		}
+	}else{
+		float_image_t pano;
+		if(!load_float_image(source.c_str(), &pano) || !cube_from_equirect(pano, options.specular_size, &env, options.rows_per_job)){
+			return false;
+		}
+	}
+	generate_cube_mips(&env);
+	double env_seconds = get_current_time_seconds() - start;
+
+	start = get_current_time_seconds();
+	float_cube_t specular;
+	prefilter_specular_cube(env, options.specular_samples, &specular, options.rows_per_job);
+	double specular_seconds = get_current_time_seconds() - start;
+
+	start = get_current_time_seconds();
+	ibl_sh9_t sh;
+	float_cube_t irradiance;
+	project_cube_to_sh9(env, &sh);
+	render_irradiance_cube(sh, options.irradiance_size, &irradiance);
+	double irradiance_seconds = get_current_time_seconds() - start;
+
+	create_directory(out_directory.c_str());
+	std::string specular_filename = Stringf("%s/%s", out_directory.c_str(), IBL_SPECULAR_FILE_NAME);
+	std::string irradiance_filename = Stringf("%s/%s", out_directory.c_str(), IBL_IRRADIANCE_FILE_NAME);
+	if(!write_float_cube_texture_file(specular_filename.c_str(), specular) || !write_float_cube_texture_file(irradiance_filename.c_str(), irradiance)){
+		log_warningf("Failed to write the baked lighting to [%s]\n", out_directory.c_str());
+		return false;
+	}
+
+	log_printf("Baked [%s]: environment %.1f ms, specular %.1f ms (%ux%u, %u mips, %u samples), irradiance %.1f ms\n",
+		source.c_str(), env_seconds * 1000.0, specular_seconds * 1000.0,
+		specular.size, specular.size, specular.mip_count, options.specular_samples, irradiance_seconds * 1000.0);
+	return true;
+}
+
+//-----------------------------------------------------
+// Commands
+COMMAND(bake_ibl, "[string:source string:out_directory uint:specular_size] Bakes the specular and diffuse lighting of a panorama (.hdr, .exr, .png..) or a directory of face images. Defaults to the sanfran cube map, written next to its source")
+{
+	std::string source = args.is_at_end() ? "Data/Images/cubemap/sanfran" : args.next_string_arg();
+
+	// a panorama gets a directory of its own name next to it
+	std::string out_directory = source;
+	if(!is_directory_path(source)){
+		out_directory = source.substr(0, source.find_last_of('.'));
+	}
+	if(!args.is_at_end()){
+		out_directory = args.next_string_arg();
+	}
+
+	ibl_bake_options_t options;
+	if(!args.is_at_end()){
+		options.specular_size = args.next_uint_arg();
+	}
+
+	double start = get_current_time_seconds();
+	if(bake_ibl(source, out_directory, options)){
+		console_success("Baked [%s] to [%s] in %.2f s", source.c_str(), out_directory.c_str(), get_current_time_seconds() - start);
+	}else{
+		console_error("Failed to bake [%s]", source.c_str());
+	}
+}
+
+COMMAND(bake_dfg, "[string:filename uint:size] Bakes the split sum dfg lut the shaders sample with (n_dot_v, roughness)")
+{
+	std::string filename = args.is_at_end() ? DEFAULT_DFG_LUT_FILE : args.next_string_arg();
+	uint size = args.is_at_end() ? DEFAULT_DFG_LUT_SIZE : args.next_uint_arg();
+
+	double start = get_current_time_seconds();
+	float_image_t lut;
+	bake_dfg_lut(size, DEFAULT_DFG_LUT_SAMPLES, &lut);
+	double bake_seconds = get_current_time_seconds() - start;
+
+	if(write_float_texture_file(filename.c_str(), lut)){
+		console_success("Baked a %ux%u dfg lut to [%s] in %.1f ms", size, size, filename.c_str(), bake_seconds * 1000.0);
+	}else{
+		console_error("Failed to write [%s]", filename.c_str());
+	}
+}
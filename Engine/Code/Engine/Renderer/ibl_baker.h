@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Core/image_ops.h"
+#include "Engine/Renderer/CubeMap.hpp"
+
+#include <string>
+#include <vector>
+
+// texel rows one bake job works on, counted down all six faces
+#define DEFAULT_IBL_ROWS_PER_JOB (8)
+
+#define DEFAULT_IBL_SPECULAR_SIZE (512)
+#define DEFAULT_IBL_SPECULAR_SAMPLES (256)
+#define DEFAULT_IBL_IRRADIANCE_SIZE (32)
+
+// the shaders look the lut up with (n_dot_v, roughness)
+#define DEFAULT_DFG_LUT_SIZE (128)
+#define DEFAULT_DFG_LUT_SAMPLES (1024)
+
+// what bake_ibl writes into an environment's directory, and where startup looks for them
+#define IBL_SPECULAR_FILE_NAME "ibl_specular.ctex"
+#define IBL_IRRADIANCE_FILE_NAME "ibl_diffuse.ctex"
+#define DEFAULT_DFG_LUT_FILE "Data/Images/dfg.ctex"
+
+// RGBA float faces in d3d order, each with its own mip chain
+struct float_cube_t
+{
+	uint size;
+	uint mip_count;
+	std::vector<float_image_t> mips[NUM_CUBE_FACES];
+
+	float_cube_t();
+	void allocate(uint size, uint mip_count);
+
+	float_image_t& get_face(uint face, uint mip);
+	const float_image_t& get_face(uint face, uint mip) const;
+};
+
+// order 2 spherical harmonics of rgb radiance, l = 0, 1, 1, 1, 2, 2, 2, 2, 2
+struct ibl_sh9_t
+{
+	float rgb[9][3];
+};
+
+struct ibl_bake_options_t
+{
+	uint specular_size;
+	uint specular_samples;
+	uint irradiance_size;
+	uint rows_per_job;
+
+	ibl_bake_options_t();
+};
+
+// the unnormalized direction through the centre of a face texel
+void get_cube_texel_direction(uint face, uint x, uint y, uint size, float* out_dir);
+
+// latitude/longitude panorama to a cube, laid out the way write_pano_to_cubemap did it
+// on the gpu. Faces much smaller than the panorama take a few samples a texel
+bool cube_from_equirect(const float_image_t& pano, uint size, float_cube_t* out_cube, uint rows_per_job = DEFAULT_IBL_ROWS_PER_JOB);
+
+// posx, negx, posy, negy, posz and negz from a directory, as .exr, .hdr, .png or .jpg
+// (the first one found). Resized to size when they aren't already
+bool cube_from_face_images(const std::string& directory, uint size, float_cube_t* out_cube);
+
+// box filtered down to 1x1, whatever mips the cube had are replaced
+void generate_cube_mips(float_cube_t* cube);
+
+// GGX prefiltered radiance with the view along the normal. Mip m is for roughness
+// m / mip_count, which is how the shaders pick the mip, and mip 0 is a copy of
+// the environment. Samples read lower environment mips the smaller their pdf,
+// so env needs its full chain (filtered importance sampling)
+void prefilter_specular_cube(const float_cube_t& env, uint sample_count, float_cube_t* out_cube, uint rows_per_job = DEFAULT_IBL_ROWS_PER_JOB);
+
+// projected from a small mip, every texel weighted by the solid angle it covers
+void project_cube_to_sh9(const float_cube_t& env, ibl_sh9_t* out_sh);
+
+// radiance convolved with the cosine lobe and divided by pi, what the shaders
+// multiply by albedo. Ringing below zero is clamped
+void render_irradiance_cube(const ibl_sh9_t& sh, uint size, float_cube_t* out_cube);
+
+// x and y the scale and bias on f0 for the specular, z the diffuse energy, the same
+// integral dfg.frag ran
+void bake_dfg_lut(uint size, uint sample_count, float_image_t* out_lut, uint rows_per_job = DEFAULT_IBL_ROWS_PER_JOB);
+
+// as RGBA16F texture files
+bool write_float_cube_texture_file(const char* filename, const float_cube_t& cube);
+bool write_float_texture_file(const char* filename, const float_image_t& image);
+
+// source is a panorama (.hdr, .exr or any 8 bit image) or a directory of face images.
+// Writes IBL_SPECULAR_FILE_NAME and IBL_IRRADIANCE_FILE_NAME to out_directory
+bool bake_ibl(const std::string& source, const std::string& out_directory, const ibl_bake_options_t& options);
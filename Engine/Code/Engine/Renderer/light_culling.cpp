@@ -0,0 +1,575 @@
+#include "Engine/Renderer/light_culling.h"
+#include "Engine/Renderer/camera.h"
+#include "Engine/Renderer/SimpleRenderer.hpp"
+#include "Engine/RHI/StructuredBuffer.hpp"
+#include "Engine/RHI/ConstantBuffer.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+#include "Engine/Engine.hpp"
+
+#include <math.h>
+#include <string.h>
+
+static float calc_aabb3_bounding_radius(const AABB3& bounds)
+{
+	return bounds.CalcHalfExtents().CalcLength();
+}
+
+light_bounds_t calc_point_light_bounds(const PointLight* pl)
+{
+	light_bounds_t bounds;
+	bounds.center = pl->m_position;
+	bounds.radius = pl->m_far_cutoff;
+	return bounds;
+}
+
+// wide cones are bounded by the sphere through the end cap, narrow ones by the
+// sphere through the apex and the cap's rim
+light_bounds_t calc_spot_light_bounds(const SpotLight* sl)
+{
+	float range = sl->m_far_cutoff;
+	float cos_angle = CosDegrees(sl->m_outer_angle);
+	float sin_angle = SinDegrees(sl->m_outer_angle);
+
+	light_bounds_t bounds;
+	if(cos_angle < 0.70710678f){
+		bounds.center = sl->m_position + (sl->m_direction * (cos_angle * range));
+		bounds.radius = sin_angle * range;
+	}else{
+		float half_height = range / (2.0f * cos_angle);
+		bounds.center = sl->m_position + (sl->m_direction * half_height);
+		bounds.radius = half_height;
+	}
+
+	return bounds;
+}
+
+// cone vs the box's bounding sphere
+bool does_spot_light_touch_aabb3(const SpotLight* sl, const AABB3& bounds)
+{
+	Vector3 center = bounds.CalcCenter();
+	float radius = calc_aabb3_bounding_radius(bounds);
+
+	Vector3 to_center = center - sl->m_position;
+	float length_squared = to_center.CalcLengthSquared();
+	float along_axis = DotProduct(to_center, sl->m_direction);
+	float off_axis = sqrtf(Max(0.0f, length_squared - (along_axis * along_axis)));
+
+	float closest_to_cone = (CosDegrees(sl->m_outer_angle) * off_axis) - (SinDegrees(sl->m_outer_angle) * along_axis);
+	if(closest_to_cone > radius){
+		return false;
+	}
+
+	if(along_axis > radius + sl->m_far_cutoff){
+		return false;
+	}
+
+	return along_axis >= -radius;
+}
+
+light_cluster_view_t make_light_cluster_view(Camera* camera)
+{
+	light_cluster_view_t view;
+	view.view = camera->get_view();
+	view.near_z = camera->m_nz;
+	view.far_z = camera->m_fz;
+	view.fov_degrees = camera->m_fov;
+	view.aspect = camera->m_aspect;
+	return view;
+}
+
+template<typename T>
+static void upload_growing_structured_buffer(StructuredBuffer** buffer, std::vector<T>* data)
+{
+	// never shrinks and only grows in powers of 2, most frames are a single map/discard
+	uint count = Max(1U, (uint)data->size());
+	if(nullptr == *buffer || count > (*buffer)->m_obj_count){
+		uint capacity = 1;
+		while(capacity < count){
+			capacity *= 2;
+		}
+
+		SAFE_DELETE(*buffer);
+		data->resize(capacity);
+		*buffer = new StructuredBuffer(g_theRenderer->m_device, data->data(), sizeof(T), capacity);
+		return;
+	}
+
+	data->resize((*buffer)->m_obj_count);
+	g_theRenderer->UpdateStructuredBuffer(*buffer, data->data());
+}
+
+static void light_cluster_slices_job(LightClusterGrid* grid, bool is_fill_pass, uint first_slice, uint end_slice)
+{
+	if(is_fill_pass){
+		grid->fill_slices(first_slice, end_slice);
+	}else{
+		grid->count_slices(first_slice, end_slice);
+	}
+}
+
+LightClusterGrid::LightClusterGrid(uint count_x, uint count_y, uint count_z, uint slices_per_job)
+	:m_count_x(Max(1U, count_x))
+	,m_count_y(Max(1U, count_y))
+	,m_count_z(Max(1U, count_z))
+	,m_slices_per_job(Max(1U, slices_per_job))
+	,m_scale_x(1.0f)
+	,m_scale_y(1.0f)
+	,m_num_point_lights(0)
+	,m_light_index_count(0)
+	,m_constants_cb(nullptr)
+	,m_clusters_buffer(nullptr)
+	,m_light_indexes_buffer(nullptr)
+	,m_point_lights_buffer(nullptr)
+	,m_spot_lights_buffer(nullptr)
+{
+	MemZero(&m_constants);
+	m_clusters.resize(get_cluster_count());
+}
+
+LightClusterGrid::~LightClusterGrid()
+{
+	SAFE_DELETE(m_constants_cb);
+	SAFE_DELETE(m_clusters_buffer);
+	SAFE_DELETE(m_light_indexes_buffer);
+	SAFE_DELETE(m_point_lights_buffer);
+	SAFE_DELETE(m_spot_lights_buffer);
+}
+
+void LightClusterGrid::build(const light_cluster_view_t& view,
+							 const light_bounds_t* point_bounds, uint num_point_lights,
+							 const light_bounds_t* spot_bounds, uint num_spot_lights,
+							 bool use_jobs)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	begin_build(view, point_bounds, num_point_lights, spot_bounds, num_spot_lights);
+
+	run_slices(false, use_jobs);
+
+	uint offset = 0;
+	for(light_cluster_t& cluster : m_clusters){
+		cluster.offset = offset;
+		offset += cluster.point_count + cluster.spot_count;
+	}
+	m_light_index_count = offset;
+	m_light_indexes.resize(m_light_index_count);
+
+	run_slices(true, use_jobs);
+}
+
+void LightClusterGrid::build(const light_cluster_view_t& view, const std::vector<PointLight*>& point_lights, const std::vector<SpotLight*>& spot_lights)
+{
+	std::vector<light_bounds_t> point_bounds;
+	std::vector<light_bounds_t> spot_bounds;
+	point_bounds.reserve(point_lights.size());
+	spot_bounds.reserve(spot_lights.size());
+
+	m_point_light_data.clear();
+	m_spot_light_data.clear();
+
+	for(const PointLight* pl : point_lights){
+		point_bounds.push_back(calc_point_light_bounds(pl));
+		m_point_light_data.push_back(pl->to_gpu_data());
+	}
+
+	for(const SpotLight* sl : spot_lights){
+		spot_bounds.push_back(calc_spot_light_bounds(sl));
+		m_spot_light_data.push_back(sl->to_gpu_data());
+	}
+
+	build(view, point_bounds.data(), (uint)point_bounds.size(), spot_bounds.data(), (uint)spot_bounds.size());
+}
+
+void LightClusterGrid::begin_build(const light_cluster_view_t& view, const light_bounds_t* point_bounds, uint num_point_lights, const light_bounds_t* spot_bounds, uint num_spot_lights)
+{
+	m_view = view;
+
+	float inv_tan = 1.0f / TanDegrees(view.fov_degrees * 0.5f);
+	m_scale_x = inv_tan / view.aspect;
+	m_scale_y = inv_tan;
+
+	float log_depth_ratio = logf(view.far_z / view.near_z);
+	m_constants.count_x = m_count_x;
+	m_constants.count_y = m_count_y;
+	m_constants.count_z = m_count_z;
+	m_constants.near_z = view.near_z;
+	m_constants.far_z = view.far_z;
+	m_constants.log_scale = (float)m_count_z / log_depth_ratio;
+	m_constants.log_bias = ((float)m_count_z * logf(view.near_z)) / log_depth_ratio;
+
+	// point lights first so each cluster's fill writes its points before its spots
+	m_lights.clear();
+	m_lights.reserve(num_point_lights + num_spot_lights);
+
+	for(uint pass = 0; pass < 2; ++pass){
+		const light_bounds_t* bounds = (pass == 0) ? point_bounds : spot_bounds;
+		uint count = (pass == 0) ? num_point_lights : num_spot_lights;
+
+		for(uint light_idx = 0; light_idx < count; ++light_idx){
+			cluster_light_t light;
+			light.view_center = view.view.apply_transformation(bounds[light_idx].center);
+			light.radius = bounds[light_idx].radius;
+			light.index = light_idx;
+
+			float min_z = light.view_center.z - light.radius;
+			float max_z = light.view_center.z + light.radius;
+			if(max_z < view.near_z || min_z > view.far_z){
+				continue;
+			}
+
+			light.first_slice = calc_slice(Max(min_z, view.near_z));
+			light.last_slice = calc_slice(Min(max_z, view.far_z));
+			m_lights.push_back(light);
+		}
+
+		if(pass == 0){
+			m_num_point_lights = (uint)m_lights.size();
+		}
+	}
+
+	m_clusters.resize(get_cluster_count());
+}
+
+void LightClusterGrid::run_slices(bool is_fill_pass, bool use_jobs)
+{
+	// not worth the job overhead for a single batch
+	if(!use_jobs || m_count_z <= m_slices_per_job){
+		light_cluster_slices_job(this, is_fill_pass, 0, m_count_z);
+		return;
+	}
+
+	std::vector<Job*> jobs;
+	jobs.reserve((m_count_z / m_slices_per_job) + 1);
+
+	for(uint first_slice = 0; first_slice < m_count_z; first_slice += m_slices_per_job){
+		uint end_slice = Min(first_slice + m_slices_per_job, m_count_z);
+
+		Job* job = job_create(JOB_TYPE_GENERIC, light_cluster_slices_job, this, is_fill_pass, first_slice, end_slice);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+void LightClusterGrid::count_slices(uint first_slice, uint end_slice)
+{
+	uint clusters_per_slice = m_count_x * m_count_y;
+	for(uint cluster_idx = first_slice * clusters_per_slice; cluster_idx < end_slice * clusters_per_slice; ++cluster_idx){
+		MemZero(&m_clusters[cluster_idx]);
+	}
+
+	for(uint light_idx = 0; light_idx < (uint)m_lights.size(); ++light_idx){
+		const cluster_light_t& light = m_lights[light_idx];
+		bool is_spot = light_idx >= m_num_point_lights;
+
+		uint light_first_slice = Max(first_slice, light.first_slice);
+		uint light_end_slice = Min(end_slice, light.last_slice + 1);
+		for(uint slice = light_first_slice; slice < light_end_slice; ++slice){
+			uint min_x, max_x, min_y, max_y;
+			if(!calc_tile_range(light, slice, &min_x, &max_x, &min_y, &max_y)){
+				continue;
+			}
+
+			for(uint y = min_y; y <= max_y; ++y){
+				for(uint x = min_x; x <= max_x; ++x){
+					light_cluster_t& cluster = m_clusters[get_cluster_index(x, y, slice)];
+					if(is_spot){
+						cluster.spot_count++;
+					}else{
+						cluster.point_count++;
+					}
+				}
+			}
+		}
+	}
+}
+
+// same walk as count_slices, the counts are rebuilt as write cursors
+void LightClusterGrid::fill_slices(uint first_slice, uint end_slice)
+{
+	uint clusters_per_slice = m_count_x * m_count_y;
+	for(uint cluster_idx = first_slice * clusters_per_slice; cluster_idx < end_slice * clusters_per_slice; ++cluster_idx){
+		m_clusters[cluster_idx].point_count = 0;
+		m_clusters[cluster_idx].spot_count = 0;
+	}
+
+	for(uint light_idx = 0; light_idx < (uint)m_lights.size(); ++light_idx){
+		const cluster_light_t& light = m_lights[light_idx];
+		bool is_spot = light_idx >= m_num_point_lights;
+
+		uint light_first_slice = Max(first_slice, light.first_slice);
+		uint light_end_slice = Min(end_slice, light.last_slice + 1);
+		for(uint slice = light_first_slice; slice < light_end_slice; ++slice){
+			uint min_x, max_x, min_y, max_y;
+			if(!calc_tile_range(light, slice, &min_x, &max_x, &min_y, &max_y)){
+				continue;
+			}
+
+			for(uint y = min_y; y <= max_y; ++y){
+				for(uint x = min_x; x <= max_x; ++x){
+					light_cluster_t& cluster = m_clusters[get_cluster_index(x, y, slice)];
+					m_light_indexes[cluster.offset + cluster.point_count + cluster.spot_count] = light.index;
+					if(is_spot){
+						cluster.spot_count++;
+					}else{
+						cluster.point_count++;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Screen tiles covered by the part of the light's sphere inside one slice.  Uses
+// the corners of the sphere's view space box clipped to the slice, x/z and y/z
+// are monotonic in both so the corners give the extremes.
+bool LightClusterGrid::calc_tile_range(const cluster_light_t& light, uint slice, uint* out_min_x, uint* out_max_x, uint* out_min_y, uint* out_max_y) const
+{
+	float near_z = Max(calc_slice_near(slice), light.view_center.z - light.radius);
+	float far_z = Min(calc_slice_near(slice + 1), light.view_center.z + light.radius);
+	if(near_z > far_z){
+		return false;
+	}
+
+	float xs[2] = { light.view_center.x - light.radius, light.view_center.x + light.radius };
+	float ys[2] = { light.view_center.y - light.radius, light.view_center.y + light.radius };
+	float zs[2] = { near_z, far_z };
+
+	float min_ndc_x = 1e30f;
+	float max_ndc_x = -1e30f;
+	float min_ndc_y = 1e30f;
+	float max_ndc_y = -1e30f;
+	for(uint z_idx = 0; z_idx < 2; ++z_idx){
+		float inv_z = 1.0f / zs[z_idx];
+		for(uint idx = 0; idx < 2; ++idx){
+			float ndc_x = xs[idx] * m_scale_x * inv_z;
+			float ndc_y = ys[idx] * m_scale_y * inv_z;
+			min_ndc_x = Min(min_ndc_x, ndc_x);
+			max_ndc_x = Max(max_ndc_x, ndc_x);
+			min_ndc_y = Min(min_ndc_y, ndc_y);
+			max_ndc_y = Max(max_ndc_y, ndc_y);
+		}
+	}
+
+	if(max_ndc_x < -1.0f || min_ndc_x > 1.0f || max_ndc_y < -1.0f || min_ndc_y > 1.0f){
+		return false;
+	}
+
+	// tiles run left to right and top to bottom, like SV_Position
+	float tile_scale_x = 0.5f * (float)m_count_x;
+	float tile_scale_y = 0.5f * (float)m_count_y;
+	*out_min_x = (uint)Clamp((int)floorf((min_ndc_x + 1.0f) * tile_scale_x), 0, (int)m_count_x - 1);
+	*out_max_x = (uint)Clamp((int)floorf((max_ndc_x + 1.0f) * tile_scale_x), 0, (int)m_count_x - 1);
+	*out_min_y = (uint)Clamp((int)floorf((1.0f - max_ndc_y) * tile_scale_y), 0, (int)m_count_y - 1);
+	*out_max_y = (uint)Clamp((int)floorf((1.0f - min_ndc_y) * tile_scale_y), 0, (int)m_count_y - 1);
+	return true;
+}
+
+void LightClusterGrid::upload(uint screen_width, uint screen_height)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	m_constants.screen_size = Vector2((float)screen_width, (float)screen_height);
+	if(nullptr == m_constants_cb){
+		m_constants_cb = new ConstantBuffer(g_theRenderer->m_device, &m_constants, sizeof(m_constants));
+	}else{
+		m_constants_cb->Update(g_theRenderer->m_deviceContext, &m_constants);
+	}
+
+	// the grid size is fixed, so this one never has to grow
+	if(nullptr == m_clusters_buffer){
+		m_clusters_buffer = new StructuredBuffer(g_theRenderer->m_device, m_clusters.data(), sizeof(light_cluster_t), (uint)m_clusters.size());
+	}else{
+		g_theRenderer->UpdateStructuredBuffer(m_clusters_buffer, m_clusters.data());
+	}
+
+	upload_growing_structured_buffer(&m_light_indexes_buffer, &m_light_indexes);
+	upload_growing_structured_buffer(&m_point_lights_buffer, &m_point_light_data);
+	upload_growing_structured_buffer(&m_spot_lights_buffer, &m_spot_light_data);
+}
+
+void LightClusterGrid::bind()
+{
+	if(nullptr == m_constants_cb){
+		return;
+	}
+
+	g_theRenderer->SetConstantBuffer(LIGHT_CLUSTER_BUFFER_INDEX, m_constants_cb);
+	g_theRenderer->SetStructuredBuffer(LIGHT_CLUSTERS_TEXTURE_INDEX, m_clusters_buffer);
+	g_theRenderer->SetStructuredBuffer(LIGHT_INDEXES_TEXTURE_INDEX, m_light_indexes_buffer);
+	g_theRenderer->SetStructuredBuffer(CLUSTERED_POINT_LIGHTS_TEXTURE_INDEX, m_point_lights_buffer);
+	g_theRenderer->SetStructuredBuffer(CLUSTERED_SPOT_LIGHTS_TEXTURE_INDEX, m_spot_lights_buffer);
+}
+
+uint LightClusterGrid::get_cluster_count() const
+{
+	return m_count_x * m_count_y * m_count_z;
+}
+
+uint LightClusterGrid::get_cluster_index(uint x, uint y, uint z) const
+{
+	return (((z * m_count_y) + y) * m_count_x) + x;
+}
+
+uint LightClusterGrid::calc_slice(float view_z) const
+{
+	int slice = (int)floorf((logf(view_z) * m_constants.log_scale) - m_constants.log_bias);
+	return (uint)Clamp(slice, 0, (int)m_count_z - 1);
+}
+
+float LightClusterGrid::calc_slice_near(uint slice) const
+{
+	if(slice == 0){
+		return m_view.near_z;
+	}
+
+	if(slice >= m_count_z){
+		return m_view.far_z;
+	}
+
+	return m_view.near_z * powf(m_view.far_z / m_view.near_z, (float)slice / (float)m_count_z);
+}
+
+bool LightClusterGrid::find_cluster(const Vector3& view_position, uint* out_cluster_index) const
+{
+	if(view_position.z < m_view.near_z || view_position.z > m_view.far_z){
+		return false;
+	}
+
+	float ndc_x = (view_position.x * m_scale_x) / view_position.z;
+	float ndc_y = (view_position.y * m_scale_y) / view_position.z;
+	if(ndc_x < -1.0f || ndc_x > 1.0f || ndc_y < -1.0f || ndc_y > 1.0f){
+		return false;
+	}
+
+	uint x = (uint)Clamp((int)floorf((ndc_x + 1.0f) * 0.5f * (float)m_count_x), 0, (int)m_count_x - 1);
+	uint y = (uint)Clamp((int)floorf((1.0f - ndc_y) * 0.5f * (float)m_count_y), 0, (int)m_count_y - 1);
+	*out_cluster_index = get_cluster_index(x, y, calc_slice(view_position.z));
+	return true;
+}
+
+//------------------------------------------------------------------------
+// benchmark / brute force comparison on random lights
+
+static bool does_cluster_contain_light(const LightClusterGrid& grid, const light_cluster_t& cluster, uint light_index, bool is_spot)
+{
+	uint begin = cluster.offset + (is_spot ? cluster.point_count : 0);
+	uint end = begin + (is_spot ? cluster.spot_count : cluster.point_count);
+	for(uint idx = begin; idx < end; ++idx){
+		if(grid.m_light_indexes[idx] == light_index){
+			return true;
+		}
+	}
+	return false;
+}
+
+COMMAND(light_cluster_benchmark, "[uint:light_count] Bins random point and spot lights into the cluster grid and checks the result")
+{
+	uint light_count = 4096;
+	if(!args.is_at_end()){
+		light_count = Max(1U, args.next_uint_arg());
+	}
+
+	light_cluster_view_t view;
+	view.view = Matrix4::IDENTITY;
+	view.near_z = 0.1f;
+	view.far_z = 500.0f;
+	view.fov_degrees = 70.0f;
+	view.aspect = 16.0f / 9.0f;
+
+	// scatter lights through the view volume, half point half spot
+	uint num_point_lights = (light_count + 1) / 2;
+	uint num_spot_lights = light_count - num_point_lights;
+	std::vector<light_bounds_t> point_bounds(num_point_lights);
+	std::vector<light_bounds_t> spot_bounds(num_spot_lights);
+
+	float half_width = TanDegrees(view.fov_degrees * 0.5f) * view.aspect;
+	float half_height = TanDegrees(view.fov_degrees * 0.5f);
+	for(uint light_idx = 0; light_idx < light_count; ++light_idx){
+		float z = GetRandomFloatInRange(1.0f, view.far_z);
+		light_bounds_t bounds;
+		bounds.center = Vector3(GetRandomFloatInRange(-half_width, half_width) * z, GetRandomFloatInRange(-half_height, half_height) * z, z);
+		bounds.radius = GetRandomFloatInRange(1.0f, 15.0f);
+
+		if(light_idx < num_point_lights){
+			point_bounds[light_idx] = bounds;
+		}else{
+			spot_bounds[light_idx - num_point_lights] = bounds;
+		}
+	}
+
+	LightClusterGrid serial_grid;
+	double start = get_current_time_seconds();
+	serial_grid.build(view, point_bounds.data(), num_point_lights, spot_bounds.data(), num_spot_lights, false);
+	double serial_seconds = get_current_time_seconds() - start;
+
+	LightClusterGrid grid;
+	start = get_current_time_seconds();
+	grid.build(view, point_bounds.data(), num_point_lights, spot_bounds.data(), num_spot_lights, true);
+	double parallel_seconds = get_current_time_seconds() - start;
+
+	uint max_lights = 0;
+	uint empty_clusters = 0;
+	for(const light_cluster_t& cluster : grid.m_clusters){
+		uint lights = cluster.point_count + cluster.spot_count;
+		max_lights = Max(max_lights, lights);
+		if(lights == 0){
+			empty_clusters++;
+		}
+	}
+
+	bool jobs_match = (serial_grid.m_light_index_count == grid.m_light_index_count)
+		&& (memcmp(serial_grid.m_clusters.data(), grid.m_clusters.data(), grid.m_clusters.size() * sizeof(light_cluster_t)) == 0)
+		&& (memcmp(serial_grid.m_light_indexes.data(), grid.m_light_indexes.data(), grid.m_light_index_count * sizeof(uint)) == 0);
+
+	// any light whose sphere holds a point has to be in that point's cluster
+	const uint num_samples = 2000;
+	uint missing = 0;
+	for(uint sample_idx = 0; sample_idx < num_samples; ++sample_idx){
+		float z = GetRandomFloatInRange(view.near_z, view.far_z);
+		Vector3 point(GetRandomFloatInRange(-half_width, half_width) * z, GetRandomFloatInRange(-half_height, half_height) * z, z);
+
+		uint cluster_index;
+		if(!grid.find_cluster(point, &cluster_index)){
+			continue;
+		}
+
+		const light_cluster_t& cluster = grid.m_clusters[cluster_index];
+		for(uint light_idx = 0; light_idx < light_count; ++light_idx){
+			bool is_spot = light_idx >= num_point_lights;
+			const light_bounds_t& bounds = is_spot ? spot_bounds[light_idx - num_point_lights] : point_bounds[light_idx];
+			if((point - bounds.center).CalcLengthSquared() > bounds.radius * bounds.radius){
+				continue;
+			}
+
+			uint index = is_spot ? light_idx - num_point_lights : light_idx;
+			if(!does_cluster_contain_light(grid, cluster, index, is_spot)){
+				missing++;
+			}
+		}
+	}
+
+	uint cluster_count = grid.get_cluster_count();
+	console_info("----Light Clusters (%u lights, %ux%ux%u grid)----", light_count, grid.m_count_x, grid.m_count_y, grid.m_count_z);
+	console_info("build serial:   %.3f ms", serial_seconds * 1000.0);
+	console_info("build parallel: %.3f ms", parallel_seconds * 1000.0);
+	console_info("light indexes:  %u (%.1f avg, %u max per cluster, %u of %u empty)", grid.m_light_index_count, (float)grid.m_light_index_count / (float)cluster_count, max_lights, empty_clusters, cluster_count);
+
+	if(!jobs_match){
+		console_error("Parallel build does not match serial build");
+	}
+
+	if(missing > 0){
+		console_error("%u lights missing from clusters they touch", missing);
+	}else{
+		console_info("All lights found in the clusters of %u sample points", num_samples);
+	}
+}
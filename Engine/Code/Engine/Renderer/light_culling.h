@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Math/Vector2.hpp"
+#include "Engine/Math/Vector3.hpp"
+#include "Engine/Math/Matrix4.hpp"
+#include "Engine/Math/AABB3.hpp"
+#include "Engine/Renderer/PointLight.h"
+#include "Engine/Renderer/SpotLight.h"
+
+#include <vector>
+
+class Camera;
+class ConstantBuffer;
+class StructuredBuffer;
+
+#define LIGHT_CLUSTER_BUFFER_INDEX (8)
+#define LIGHT_CLUSTERS_TEXTURE_INDEX (11)
+#define LIGHT_INDEXES_TEXTURE_INDEX (12)
+#define CLUSTERED_POINT_LIGHTS_TEXTURE_INDEX (13)
+#define CLUSTERED_SPOT_LIGHTS_TEXTURE_INDEX (14)
+
+#define DEFAULT_LIGHT_CLUSTER_COUNT_X (16)
+#define DEFAULT_LIGHT_CLUSTER_COUNT_Y (9)
+#define DEFAULT_LIGHT_CLUSTER_COUNT_Z (24)
+#define DEFAULT_LIGHT_CLUSTER_SLICES_PER_JOB (2)
+
+// world space sphere around everything a light can reach
+struct light_bounds_t
+{
+	Vector3 center;
+	float radius;
+};
+
+light_bounds_t calc_point_light_bounds(const PointLight* pl);
+
+// tightest sphere around the spot's cone, not just its range
+light_bounds_t calc_spot_light_bounds(const SpotLight* sl);
+
+bool does_spot_light_touch_aabb3(const SpotLight* sl, const AABB3& bounds);
+
+// must match light_cluster_t in Data/HLSL/Lighting/light_clusters.h
+// lights for a cluster are m_light_indexes[offset, offset + point_count) into the point lights,
+// followed by spot_count indexes into the spot lights
+struct light_cluster_t
+{
+	uint offset;
+	uint point_count;
+	uint spot_count;
+	uint _padding;
+};
+
+// must match light_cluster_cb in Data/HLSL/Lighting/light_clusters.h
+struct light_cluster_constants_t
+{
+	uint count_x;
+	uint count_y;
+	uint count_z;
+	uint _padding0;
+
+	// slice = log(view_z) * log_scale - log_bias
+	float near_z;
+	float far_z;
+	float log_scale;
+	float log_bias;
+
+	Vector2 screen_size;
+	float _padding1[2];
+};
+
+// everything the grid needs from the camera, kept separate so it can be built without a renderer
+struct light_cluster_view_t
+{
+	Matrix4 view;
+	float near_z;
+	float far_z;
+	float fov_degrees;
+	float aspect;
+};
+
+light_cluster_view_t make_light_cluster_view(Camera* camera);
+
+struct cluster_light_t
+{
+	Vector3 view_center;
+	float radius;
+	uint first_slice;
+	uint last_slice;
+	uint index;
+};
+
+// Froxel grid over the camera frustum: count_x * count_y screen tiles, each
+// split into count_z slices that grow exponentially with depth.  Every frame
+// the lights' bounding spheres are binned into the cells they touch, on the
+// cpu, and the grid plus one flat index list are uploaded as structured
+// buffers so a fragment only loops over the lights in its own cell.
+//
+// Binning runs in two passes over ranges of slices (count, then fill) so the
+// slice ranges can go out to the job threads without any locking.
+class LightClusterGrid
+{
+public:
+	uint m_count_x;
+	uint m_count_y;
+	uint m_count_z;
+	uint m_slices_per_job;
+
+	light_cluster_view_t m_view;
+	light_cluster_constants_t m_constants;
+	float m_scale_x;
+	float m_scale_y;
+
+	std::vector<cluster_light_t> m_lights;
+	uint m_num_point_lights;
+
+	std::vector<light_cluster_t> m_clusters;
+	std::vector<uint> m_light_indexes;
+	uint m_light_index_count;
+
+	std::vector<point_light_gpu_data_t> m_point_light_data;
+	std::vector<spot_light_gpu_data_t> m_spot_light_data;
+
+	ConstantBuffer* m_constants_cb;
+	StructuredBuffer* m_clusters_buffer;
+	StructuredBuffer* m_light_indexes_buffer;
+	StructuredBuffer* m_point_lights_buffer;
+	StructuredBuffer* m_spot_lights_buffer;
+
+public:
+	LightClusterGrid(uint count_x = DEFAULT_LIGHT_CLUSTER_COUNT_X,
+					 uint count_y = DEFAULT_LIGHT_CLUSTER_COUNT_Y,
+					 uint count_z = DEFAULT_LIGHT_CLUSTER_COUNT_Z,
+					 uint slices_per_job = DEFAULT_LIGHT_CLUSTER_SLICES_PER_JOB);
+	~LightClusterGrid();
+
+	// headless, point lights get indexes [0, num_point_lights), spot lights [0, num_spot_lights)
+	void build(const light_cluster_view_t& view,
+			   const light_bounds_t* point_bounds, uint num_point_lights,
+			   const light_bounds_t* spot_bounds, uint num_spot_lights,
+			   bool use_jobs = true);
+
+	void build(const light_cluster_view_t& view, const std::vector<PointLight*>& point_lights, const std::vector<SpotLight*>& spot_lights);
+
+	void upload(uint screen_width, uint screen_height);
+	void bind();
+
+	uint get_cluster_count() const;
+	uint get_cluster_index(uint x, uint y, uint z) const;
+	uint calc_slice(float view_z) const;
+	float calc_slice_near(uint slice) const;
+
+	// finds the cell holding a view space point, false if it's outside the frustum
+	bool find_cluster(const Vector3& view_position, uint* out_cluster_index) const;
+
+public:
+	// used by the build jobs
+	void count_slices(uint first_slice, uint end_slice);
+	void fill_slices(uint first_slice, uint end_slice);
+
+private:
+	void begin_build(const light_cluster_view_t& view, const light_bounds_t* point_bounds, uint num_point_lights, const light_bounds_t* spot_bounds, uint num_spot_lights);
+	void run_slices(bool is_fill_pass, bool use_jobs);
+	bool calc_tile_range(const cluster_light_t& light, uint slice, uint* out_min_x, uint* out_max_x, uint* out_min_y, uint* out_max_y) const;
+};
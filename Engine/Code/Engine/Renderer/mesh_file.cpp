@@ -0,0 +1,447 @@
+#include "Engine/Renderer/mesh_file.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/FileBinaryStream.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static size_t align_mesh_file_offset(size_t offset)
+{
+	return (offset + (MESH_FILE_ALIGNMENT - 1)) & ~((size_t)MESH_FILE_ALIGNMENT - 1);
+}
+
+// fnv-1a a word at a time, the payload is always padded to the alignment so the byte tail is rare
+u32 calc_mesh_file_checksum(const void* data, size_t size)
+{
+	const byte* bytes = (const byte*)data;
+	u32 hash = 2166136261U;
+
+	size_t num_words = size / sizeof(u32);
+	for(size_t word_idx = 0; word_idx < num_words; ++word_idx){
+		u32 word;
+		memcpy(&word, bytes + word_idx * sizeof(u32), sizeof(u32));
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	for(size_t byte_idx = num_words * sizeof(u32); byte_idx < size; ++byte_idx){
+		hash = (hash ^ bytes[byte_idx]) * 16777619U;
+	}
+
+	return hash;
+}
+
+// indexed draws have to stay inside the index buffer, the rest inside the vertex buffer
+static bool mesh_file_draws_in_range(const draw_instruction_t* draws, uint draw_count, uint index_count, uint vertex_count)
+{
+	for(uint draw_idx = 0; draw_idx < draw_count; ++draw_idx){
+		const draw_instruction_t& draw = draws[draw_idx];
+		uint element_count = draw.uses_index_buffer ? index_count : vertex_count;
+		if((u64)draw.start_index + draw.count > (u64)element_count){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------
+// MeshFile
+MeshFile::MeshFile()
+	:m_header(nullptr)
+	,m_vertexes(nullptr)
+	,m_vertex_count(0)
+	,m_indexes(nullptr)
+	,m_index_count(0)
+	,m_draw_instructions(nullptr)
+	,m_draw_instruction_count(0)
+	,m_lods(nullptr)
+	,m_lod_count(0)
+	,m_lod_draw_instructions(nullptr)
+	,m_lod_draw_instruction_count(0)
+{
+}
+
+MeshFile::~MeshFile()
+{
+	close();
+}
+
+bool MeshFile::open(const char* filename, bool verify_checksum)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	close();
+
+	if(!m_mapped_file.open_for_read(filename)){
+		return false;
+	}
+
+	const byte* data = m_mapped_file.get_data();
+	size_t size = m_mapped_file.get_size();
+
+	const mesh_file_header_t* header = (const mesh_file_header_t*)data;
+	if(size < sizeof(mesh_file_header_t) || header->magic != MESH_FILE_MAGIC){
+		close();
+		return false;
+	}
+
+	if(header->version != MESH_FILE_VERSION){
+		log_warningf("Mesh file [%s] is version %u, expected %u\n", filename, header->version, MESH_FILE_VERSION);
+		close();
+		return false;
+	}
+
+	size_t table_end = sizeof(mesh_file_header_t) + (size_t)header->chunk_count * sizeof(mesh_file_chunk_t);
+	if(header->file_size != (u64)size || table_end > size){
+		log_warningf("Mesh file [%s] is truncated\n", filename);
+		close();
+		return false;
+	}
+
+	if(verify_checksum){
+		u32 checksum = calc_mesh_file_checksum(data + sizeof(mesh_file_header_t), size - sizeof(mesh_file_header_t));
+		if(checksum != header->checksum){
+			log_warningf("Mesh file [%s] failed its checksum\n", filename);
+			close();
+			return false;
+		}
+	}
+
+	m_header = header;
+
+	const mesh_file_chunk_t* vertex_chunk = find_chunk(MESH_FILE_CHUNK_VERTEXES, sizeof(Vertex3), filename);
+	const mesh_file_chunk_t* index_chunk = find_chunk(MESH_FILE_CHUNK_INDEXES, sizeof(uint), filename);
+	const mesh_file_chunk_t* draw_chunk = find_chunk(MESH_FILE_CHUNK_DRAW_INSTRUCTIONS, sizeof(draw_instruction_t), filename);
+	if(vertex_chunk == nullptr || index_chunk == nullptr || draw_chunk == nullptr){
+		close();
+		return false;
+	}
+
+	m_vertexes = (const Vertex3*)(data + vertex_chunk->offset);
+	m_vertex_count = vertex_chunk->element_count;
+
+	m_indexes = (const uint*)(data + index_chunk->offset);
+	m_index_count = index_chunk->element_count;
+
+	m_draw_instructions = (const draw_instruction_t*)(data + draw_chunk->offset);
+	m_draw_instruction_count = draw_chunk->element_count;
+
+	if(!mesh_file_draws_in_range(m_draw_instructions, m_draw_instruction_count, m_index_count, m_vertex_count)){
+		log_warningf("Mesh file [%s] has a draw past the end of its buffers\n", filename);
+		close();
+		return false;
+	}
+
+	const mesh_file_chunk_t* lod_chunk = find_chunk(MESH_FILE_CHUNK_LODS, sizeof(mesh_lod_t), filename, false);
+	const mesh_file_chunk_t* lod_draw_chunk = find_chunk(MESH_FILE_CHUNK_LOD_DRAW_INSTRUCTIONS, sizeof(draw_instruction_t), filename, false);
+	if(lod_chunk != nullptr && lod_draw_chunk != nullptr){
+		m_lods = (const mesh_lod_t*)(data + lod_chunk->offset);
+		m_lod_count = lod_chunk->element_count;
+		m_lod_draw_instructions = (const draw_instruction_t*)(data + lod_draw_chunk->offset);
+		m_lod_draw_instruction_count = lod_draw_chunk->element_count;
+
+		// a bad lod shouldn't cost the whole mesh, it just draws at full detail
+		bool lod_draws_in_range = mesh_file_draws_in_range(m_lod_draw_instructions, m_lod_draw_instruction_count, m_index_count, m_vertex_count);
+		for(uint lod_idx = 0; lod_idx < m_lod_count; ++lod_idx){
+			const mesh_lod_t& lod = m_lods[lod_idx];
+			if(!lod_draws_in_range || (u64)lod.first_draw_instruction + lod.draw_instruction_count > (u64)m_lod_draw_instruction_count){
+				log_warningf("Mesh file [%s] has a bad lod %u, ignoring its lods\n", filename, lod_idx);
+				m_lods = nullptr;
+				m_lod_count = 0;
+				m_lod_draw_instructions = nullptr;
+				m_lod_draw_instruction_count = 0;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+void MeshFile::close()
+{
+	m_mapped_file.close();
+	m_header = nullptr;
+
+	m_vertexes = nullptr;
+	m_vertex_count = 0;
+	m_indexes = nullptr;
+	m_index_count = 0;
+	m_draw_instructions = nullptr;
+	m_draw_instruction_count = 0;
+	m_lods = nullptr;
+	m_lod_count = 0;
+	m_lod_draw_instructions = nullptr;
+	m_lod_draw_instruction_count = 0;
+}
+
+bool MeshFile::is_open() const
+{
+	return m_header != nullptr;
+}
+
+AABB3 MeshFile::get_local_bounds() const
+{
+	return AABB3(Vector3(m_header->bounds_mins[0], m_header->bounds_mins[1], m_header->bounds_mins[2]),
+				 Vector3(m_header->bounds_maxs[0], m_header->bounds_maxs[1], m_header->bounds_maxs[2]));
+}
+
+const mesh_file_chunk_t* MeshFile::find_chunk(MeshFileChunkId id, size_t element_size, const char* filename, bool is_required) const
+{
+	const mesh_file_chunk_t* chunks = (const mesh_file_chunk_t*)(m_mapped_file.get_data() + sizeof(mesh_file_header_t));
+	size_t size = m_mapped_file.get_size();
+
+	for(uint chunk_idx = 0; chunk_idx < m_header->chunk_count; ++chunk_idx){
+		const mesh_file_chunk_t& chunk = chunks[chunk_idx];
+		if(chunk.id != (u32)id){
+			continue;
+		}
+
+		bool is_valid = (chunk.element_size == element_size)
+			&& (chunk.size == (u64)chunk.element_size * chunk.element_count)
+			&& ((chunk.offset % MESH_FILE_ALIGNMENT) == 0)
+			&& (chunk.offset + chunk.size <= (u64)size);
+		if(!is_valid){
+			log_warningf("Mesh file [%s] has a bad chunk %u\n", filename, chunk.id);
+			return nullptr;
+		}
+
+		return &chunk;
+	}
+
+	if(is_required){
+		log_warningf("Mesh file [%s] is missing chunk %u\n", filename, (uint)id);
+	}
+	return nullptr;
+}
+
+//-----------------------------------------------------
+// Writing
+bool write_mesh_file(const char* filename,
+					 const Vertex3* vertexes, uint vertex_count,
+					 const uint* indexes, uint index_count,
+					 const draw_instruction_t* draw_instructions, uint draw_instruction_count,
+					 const AABB3& local_bounds,
+					 const mesh_lod_t* lods, uint lod_count,
+					 const draw_instruction_t* lod_draw_instructions, uint lod_draw_instruction_count)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	const void* blobs[NUM_MESH_FILE_CHUNKS] = { vertexes, indexes, draw_instructions, lods, lod_draw_instructions };
+	const u32 element_sizes[NUM_MESH_FILE_CHUNKS] = { sizeof(Vertex3), sizeof(uint), sizeof(draw_instruction_t), sizeof(mesh_lod_t), sizeof(draw_instruction_t) };
+	const u32 element_counts[NUM_MESH_FILE_CHUNKS] = { vertex_count, index_count, draw_instruction_count, lod_count, lod_draw_instruction_count };
+
+	mesh_file_chunk_t chunks[NUM_MESH_FILE_CHUNKS];
+	MemZeroArray(chunks, NUM_MESH_FILE_CHUNKS);
+
+	size_t offset = align_mesh_file_offset(sizeof(mesh_file_header_t) + sizeof(chunks));
+	for(uint chunk_idx = 0; chunk_idx < NUM_MESH_FILE_CHUNKS; ++chunk_idx){
+		chunks[chunk_idx].id = chunk_idx;
+		chunks[chunk_idx].element_size = element_sizes[chunk_idx];
+		chunks[chunk_idx].element_count = element_counts[chunk_idx];
+		chunks[chunk_idx].offset = offset;
+		chunks[chunk_idx].size = (u64)element_sizes[chunk_idx] * element_counts[chunk_idx];
+		offset = align_mesh_file_offset(offset + (size_t)chunks[chunk_idx].size);
+	}
+
+	// zero filled, so padding between blobs is deterministic and checksums match across writes
+	std::vector<byte> file_data(offset, 0);
+	memcpy(file_data.data() + sizeof(mesh_file_header_t), chunks, sizeof(chunks));
+	for(uint chunk_idx = 0; chunk_idx < NUM_MESH_FILE_CHUNKS; ++chunk_idx){
+		if(chunks[chunk_idx].size > 0){
+			memcpy(file_data.data() + chunks[chunk_idx].offset, blobs[chunk_idx], (size_t)chunks[chunk_idx].size);
+		}
+	}
+
+	mesh_file_header_t header;
+	MemZero(&header);
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.chunk_count = NUM_MESH_FILE_CHUNKS;
+	header.file_size = (u64)file_data.size();
+	header.bounds_mins[0] = local_bounds.mins.x;
+	header.bounds_mins[1] = local_bounds.mins.y;
+	header.bounds_mins[2] = local_bounds.mins.z;
+	header.bounds_maxs[0] = local_bounds.maxs.x;
+	header.bounds_maxs[1] = local_bounds.maxs.y;
+	header.bounds_maxs[2] = local_bounds.maxs.z;
+	header.checksum = calc_mesh_file_checksum(file_data.data() + sizeof(mesh_file_header_t), file_data.size() - sizeof(mesh_file_header_t));
+	memcpy(file_data.data(), &header, sizeof(header));
+
+	FILE* file = nullptr;
+	fopen_s(&file, filename, "wb");
+	if(file == nullptr){
+		log_warningf("Failed to open [%s] to write a mesh file\n", filename);
+		return false;
+	}
+
+	size_t written = fwrite(file_data.data(), 1, file_data.size(), file);
+	fclose(file);
+
+	return written == file_data.size();
+}
+
+bool write_mesh_file(const char* filename, const Mesh* mesh)
+{
+	return write_mesh_file(filename,
+						   mesh->get_vertex_data(), mesh->get_vertex_count(),
+						   mesh->get_index_data(), mesh->get_index_count(),
+						   mesh->m_draw_instructions.data(), (uint)mesh->m_draw_instructions.size(),
+						   mesh->m_local_bounds,
+						   mesh->m_lods.data(), (uint)mesh->m_lods.size(),
+						   mesh->m_lod_draw_instructions.data(), (uint)mesh->m_lod_draw_instructions.size());
+}
+
+bool convert_mesh_to_mesh_file(const char* mesh_filename, const char* out_filename)
+{
+	std::vector<Vertex3> vertexes;
+	std::vector<uint> indexes;
+	std::vector<draw_instruction_t> draw_instructions;
+
+	FileBinaryStream fbs;
+	if(!fbs.open_for_read(mesh_filename)){
+		return false;
+	}
+	read_mesh_data(fbs, &vertexes, &indexes, &draw_instructions);
+	fbs.close();
+
+	AABB3 bounds = calc_vertex_bounds(vertexes.data(), (uint)vertexes.size());
+	bool did_write = write_mesh_file(out_filename,
+									 vertexes.data(), (uint)vertexes.size(),
+									 indexes.data(), (uint)indexes.size(),
+									 draw_instructions.data(), (uint)draw_instructions.size(),
+									 bounds);
+	if(!did_write){
+		return false;
+	}
+
+	// runtime loads skip the checksum, so this is where a bad write gets caught
+	MeshFile written;
+	return written.open(out_filename, true);
+}
+
+std::string make_mesh_file_name(const std::string& mesh_filename)
+{
+	size_t dot = mesh_filename.find_last_of('.');
+	if(dot == std::string::npos){
+		return mesh_filename + MESH_FILE_EXTENSION;
+	}
+	return mesh_filename.substr(0, dot) + MESH_FILE_EXTENSION;
+}
+
+//-----------------------------------------------------
+// Commands
+COMMAND(convert_mesh, "[string:mesh_filename string:out_filename] Converts a .mesh to the mapped mesh format, out defaults to the same name with " MESH_FILE_EXTENSION)
+{
+	std::string mesh_filename = args.next_string_arg();
+	std::string out_filename = args.is_at_end() ? make_mesh_file_name(mesh_filename) : args.next_string_arg();
+
+	if(convert_mesh_to_mesh_file(mesh_filename.c_str(), out_filename.c_str())){
+		console_success("Converted [%s] to [%s]", mesh_filename.c_str(), out_filename.c_str());
+	}else{
+		console_error("Failed to convert [%s]", mesh_filename.c_str());
+	}
+}
+
+COMMAND(convert_meshes, "[string:directory] Converts every .mesh in a directory (default Data/Meshes) to the mapped mesh format")
+{
+	std::string directory = args.is_at_end() ? "Data/Meshes" : args.next_string_arg();
+
+	std::vector<std::string> filenames = find_files_in_directory(directory.c_str(), "*.mesh");
+	uint num_converted = 0;
+	for(const std::string& filename : filenames){
+		std::string mesh_filename = directory + "/" + filename;
+		std::string out_filename = make_mesh_file_name(mesh_filename);
+		if(convert_mesh_to_mesh_file(mesh_filename.c_str(), out_filename.c_str())){
+			num_converted++;
+		}else{
+			console_error("Failed to convert [%s]", mesh_filename.c_str());
+		}
+	}
+
+	console_info("Converted %u of %u meshes in [%s]", num_converted, (uint)filenames.size(), directory.c_str());
+}
+
+COMMAND(mesh_load_benchmark, "[string:mesh_filename uint:iterations] Compares loading a .mesh through FileBinaryStream against its mapped mesh file")
+{
+	std::string mesh_filename = args.is_at_end() ? "Data/Meshes/teapot.mesh" : args.next_string_arg();
+	uint iterations = 20;
+	if(!args.is_at_end()){
+		iterations = Max(1U, args.next_uint_arg());
+	}
+
+	std::string mesh_file_name = make_mesh_file_name(mesh_filename);
+	if(!convert_mesh_to_mesh_file(mesh_filename.c_str(), mesh_file_name.c_str())){
+		console_error("Failed to convert [%s]", mesh_filename.c_str());
+		return;
+	}
+
+	// old path, per field reads into vectors
+	std::vector<Vertex3> vertexes;
+	std::vector<uint> indexes;
+	std::vector<draw_instruction_t> draw_instructions;
+	double start = get_current_time_seconds();
+	for(uint iteration = 0; iteration < iterations; ++iteration){
+		FileBinaryStream fbs;
+		fbs.open_for_read(mesh_filename.c_str());
+		read_mesh_data(fbs, &vertexes, &indexes, &draw_instructions);
+		fbs.close();
+	}
+	double stream_seconds = (get_current_time_seconds() - start) / (double)iterations;
+
+	// mapped, just the header and chunk table
+	MeshFile mesh_file;
+	start = get_current_time_seconds();
+	for(uint iteration = 0; iteration < iterations; ++iteration){
+		mesh_file.open(mesh_file_name.c_str(), false);
+	}
+	double mapped_seconds = (get_current_time_seconds() - start) / (double)iterations;
+
+	// mapped and checksummed, which pages in the whole file
+	start = get_current_time_seconds();
+	for(uint iteration = 0; iteration < iterations; ++iteration){
+		mesh_file.open(mesh_file_name.c_str(), true);
+	}
+	double verified_seconds = (get_current_time_seconds() - start) / (double)iterations;
+
+	if(!mesh_file.is_open()){
+		console_error("Failed to open [%s]", mesh_file_name.c_str());
+		return;
+	}
+
+	bool data_matches = (mesh_file.m_vertex_count == (uint)vertexes.size())
+		&& (mesh_file.m_index_count == (uint)indexes.size())
+		&& (mesh_file.m_draw_instruction_count == (uint)draw_instructions.size())
+		&& (memcmp(mesh_file.m_vertexes, vertexes.data(), vertexes.size() * sizeof(Vertex3)) == 0)
+		&& (memcmp(mesh_file.m_indexes, indexes.data(), indexes.size() * sizeof(uint)) == 0);
+
+	// full loads including vertex and index buffer creation
+	Mesh stream_mesh;
+	start = get_current_time_seconds();
+	stream_mesh.load_from_stream_file(mesh_filename.c_str());
+	double stream_mesh_seconds = get_current_time_seconds() - start;
+
+	Mesh mapped_mesh;
+	start = get_current_time_seconds();
+	mapped_mesh.load_from_mesh_file(mesh_file_name.c_str(), true);
+	double mapped_mesh_seconds = get_current_time_seconds() - start;
+
+	console_info("----Mesh load [%s] (%u vertexes, %u indexes, %u iterations)----", mesh_filename.c_str(), (uint)vertexes.size(), (uint)indexes.size(), iterations);
+	console_info("FileBinaryStream:     %.3f ms", stream_seconds * 1000.0);
+	console_info("mapped:               %.3f ms", mapped_seconds * 1000.0);
+	console_info("mapped + checksum:    %.3f ms", verified_seconds * 1000.0);
+	console_info("Mesh, stream:         %.3f ms", stream_mesh_seconds * 1000.0);
+	console_info("Mesh, mapped:         %.3f ms", mapped_mesh_seconds * 1000.0);
+
+	if(data_matches){
+		console_info("Mapped data matches the FileBinaryStream data");
+	}else{
+		console_error("Mapped data does not match the FileBinaryStream data");
+	}
+}
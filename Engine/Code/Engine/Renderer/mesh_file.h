@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Core/mapped_file.h"
+#include "Engine/Renderer/Vertex3.hpp"
+#include "Engine/Renderer/Mesh.hpp"
+#include "Engine/Math/AABB3.hpp"
+
+#include <string>
+
+#define MESH_FILE_MAGIC (0x4853454D) // "MESH" read as a little endian u32
+#define MESH_FILE_VERSION (1)
+
+// every blob starts on a cache line so the mapped arrays can be used in place
+#define MESH_FILE_ALIGNMENT (64)
+
+#define MESH_FILE_EXTENSION ".cmesh"
+
+enum MeshFileChunkId : u32
+{
+	MESH_FILE_CHUNK_VERTEXES,
+	MESH_FILE_CHUNK_INDEXES,
+	MESH_FILE_CHUNK_DRAW_INSTRUCTIONS,
+
+	// optional, files written before lods just don't have them
+	MESH_FILE_CHUNK_LODS,
+	MESH_FILE_CHUNK_LOD_DRAW_INSTRUCTIONS,
+	NUM_MESH_FILE_CHUNKS
+};
+
+struct mesh_file_header_t
+{
+	u32 magic;
+	u32 version;
+	u32 chunk_count;
+
+	// calc_mesh_file_checksum of every byte after the header
+	u32 checksum;
+	u64 file_size;
+
+	float bounds_mins[3];
+	float bounds_maxs[3];
+	u32 _padding[4];
+};
+
+struct mesh_file_chunk_t
+{
+	u32 id;
+	u32 element_size;
+	u32 element_count;
+	u32 _padding;
+
+	// from the start of the file, always a multiple of MESH_FILE_ALIGNMENT
+	u64 offset;
+	u64 size;
+};
+
+u32 calc_mesh_file_checksum(const void* data, size_t size);
+
+// Chunked mesh file, laid out as
+//   mesh_file_header_t
+//   mesh_file_chunk_t[chunk_count]
+//   one aligned blob per chunk, zero padded up to MESH_FILE_ALIGNMENT
+//
+// The file is mapped rather than read, and m_vertexes / m_indexes point
+// straight into the mapping, so opening costs a header check no matter how
+// big the mesh is.  Blobs are raw arrays of the engine's own structs in the
+// native (little endian) layout; element_size is stored per chunk and has to
+// match, so a struct change can't be silently misread, bump MESH_FILE_VERSION
+// whenever one happens.
+class MeshFile
+{
+public:
+	MappedFile m_mapped_file;
+	const mesh_file_header_t* m_header;
+
+	const Vertex3* m_vertexes;
+	uint m_vertex_count;
+
+	const uint* m_indexes;
+	uint m_index_count;
+
+	const draw_instruction_t* m_draw_instructions;
+	uint m_draw_instruction_count;
+
+	const mesh_lod_t* m_lods;
+	uint m_lod_count;
+
+	const draw_instruction_t* m_lod_draw_instructions;
+	uint m_lod_draw_instruction_count;
+
+public:
+	MeshFile();
+	~MeshFile();
+
+	// false without a warning if the file isn't a mesh file at all, so callers can fall back to the old format.
+	// verifying the checksum touches every page of the file
+	bool open(const char* filename, bool verify_checksum = true);
+	void close();
+	bool is_open() const;
+
+	AABB3 get_local_bounds() const;
+
+private:
+	const mesh_file_chunk_t* find_chunk(MeshFileChunkId id, size_t element_size, const char* filename, bool is_required = true) const;
+};
+
+bool write_mesh_file(const char* filename,
+					 const Vertex3* vertexes, uint vertex_count,
+					 const uint* indexes, uint index_count,
+					 const draw_instruction_t* draw_instructions, uint draw_instruction_count,
+					 const AABB3& local_bounds,
+					 const mesh_lod_t* lods = nullptr, uint lod_count = 0,
+					 const draw_instruction_t* lod_draw_instructions = nullptr, uint lod_draw_instruction_count = 0);
+
+bool write_mesh_file(const char* filename, const Mesh* mesh);
+
+// same name with MESH_FILE_EXTENSION in place of its extension
+std::string make_mesh_file_name(const std::string& mesh_filename);
+
+// reads a .mesh written by Mesh::write and writes it back out as a mesh file, no renderer needed.
+// the old format stores counts as size_t so it has to be converted by a build of the same bitness that wrote it
+bool convert_mesh_to_mesh_file(const char* mesh_filename, const char* out_filename);
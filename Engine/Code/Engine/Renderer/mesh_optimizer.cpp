@@ -0,0 +1,609 @@
+#include "Engine/Renderer/mesh_optimizer.h"
+#include "Engine/Renderer/MeshBuilder.hpp"
+#include "Engine/Core/FileBinaryStream.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/job.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <algorithm>
+#include <string.h>
+
+#define INVALID_MESH_INDEX ((uint)-1)
+
+//-----------------------------------------------------
+// Cache simulation
+float calc_acmr(const uint* indexes, uint index_count, uint vertex_count, uint cache_size)
+{
+	uint triangle_count = index_count / 3;
+	if(triangle_count == 0){
+		return 0.0f;
+	}
+
+	// fifo through timestamps, a vertex is cached if it went in within the last cache_size misses
+	std::vector<uint> cache_time(vertex_count, 0);
+	uint time = cache_size + 1;
+	uint misses = 0;
+
+	for(uint idx = 0; idx < index_count; ++idx){
+		uint vertex = indexes[idx];
+		if(time - cache_time[vertex] > cache_size){
+			cache_time[vertex] = time++;
+			misses++;
+		}
+	}
+
+	return (float)misses / (float)triangle_count;
+}
+
+//-----------------------------------------------------
+// Welding
+static u32 hash_vertex(const Vertex3& vertex)
+{
+	u32 words[sizeof(Vertex3) / sizeof(u32)];
+	memcpy(words, &vertex, sizeof(words));
+
+	u32 hash = 2166136261U;
+	for(u32 word : words){
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	// fnv is weak in the low bits and the table is masked by them
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6dU;
+	hash ^= hash >> 12;
+	return hash;
+}
+
+uint weld_vertexes(const Vertex3* vertexes, uint vertex_count, std::vector<Vertex3>* out_vertexes, std::vector<uint>* out_remap)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_vertexes->clear();
+	out_vertexes->reserve(vertex_count);
+	out_remap->resize(vertex_count);
+
+	// open addressing, at most half full
+	uint table_size = 1;
+	while(table_size < vertex_count * 2){
+		table_size <<= 1;
+	}
+	std::vector<uint> table(table_size, INVALID_MESH_INDEX);
+	uint mask = table_size - 1;
+
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& vertex = vertexes[vert_idx];
+		uint slot = hash_vertex(vertex) & mask;
+
+		while(true){
+			uint existing = table[slot];
+			if(existing == INVALID_MESH_INDEX){
+				table[slot] = (uint)out_vertexes->size();
+				(*out_remap)[vert_idx] = (uint)out_vertexes->size();
+				out_vertexes->push_back(vertex);
+				break;
+			}
+
+			if(memcmp(&(*out_vertexes)[existing], &vertex, sizeof(Vertex3)) == 0){
+				(*out_remap)[vert_idx] = existing;
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	return (uint)out_vertexes->size();
+}
+
+static void weld_hash_range_job(const Vertex3* vertexes, u32* hashes, uint start_vertex, uint end_vertex)
+{
+	for(uint vert_idx = start_vertex; vert_idx < end_vertex; ++vert_idx){
+		hashes[vert_idx] = hash_vertex(vertexes[vert_idx]);
+	}
+}
+
+// bucket_vertexes are ascending, so the first of every identical run is the lowest index
+static void weld_bucket_job(const Vertex3* vertexes, const u32* hashes, const uint* bucket_vertexes, uint bucket_count, uint* canonical)
+{
+	uint table_size = 1;
+	while(table_size < bucket_count * 2){
+		table_size <<= 1;
+	}
+	std::vector<uint> table(table_size, INVALID_MESH_INDEX);
+	uint mask = table_size - 1;
+
+	for(uint bucket_idx = 0; bucket_idx < bucket_count; ++bucket_idx){
+		uint vert_idx = bucket_vertexes[bucket_idx];
+		uint slot = hashes[vert_idx] & mask;
+
+		while(true){
+			uint existing = table[slot];
+			if(existing == INVALID_MESH_INDEX){
+				table[slot] = vert_idx;
+				canonical[vert_idx] = vert_idx;
+				break;
+			}
+
+			if(memcmp(&vertexes[existing], &vertexes[vert_idx], sizeof(Vertex3)) == 0){
+				canonical[vert_idx] = existing;
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+uint weld_vertexes_parallel(const Vertex3* vertexes, uint vertex_count, std::vector<Vertex3>* out_vertexes, std::vector<uint>* out_remap, uint vertexes_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	vertexes_per_job = Max(1U, vertexes_per_job);
+	if(vertex_count <= vertexes_per_job){
+		return weld_vertexes(vertexes, vertex_count, out_vertexes, out_remap);
+	}
+
+	std::vector<Job*> jobs;
+	std::vector<u32> hashes(vertex_count);
+	for(uint start_vertex = 0; start_vertex < vertex_count; start_vertex += vertexes_per_job){
+		uint end_vertex = Min(start_vertex + vertexes_per_job, vertex_count);
+
+		Job* job = job_create(JOB_TYPE_GENERIC, weld_hash_range_job, vertexes, hashes.data(), start_vertex, end_vertex);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+	jobs.clear();
+
+	// identical vertexes hash the same, so buckets by the top hash bits never share a duplicate.
+	// the bucket tables are masked by the low bits, which stay independent of the bucket
+	uint bucket_bits = 0;
+	while((1U << bucket_bits) * vertexes_per_job < vertex_count){
+		bucket_bits++;
+	}
+	uint num_buckets = 1U << bucket_bits;
+
+	std::vector<uint> bucket_offsets(num_buckets + 1, 0);
+	for(u32 hash : hashes){
+		bucket_offsets[(hash >> (32 - bucket_bits)) + 1]++;
+	}
+	for(uint bucket = 0; bucket < num_buckets; ++bucket){
+		bucket_offsets[bucket + 1] += bucket_offsets[bucket];
+	}
+
+	std::vector<uint> bucket_vertexes(vertex_count);
+	std::vector<uint> cursor(bucket_offsets.begin(), bucket_offsets.end() - 1);
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		bucket_vertexes[cursor[hashes[vert_idx] >> (32 - bucket_bits)]++] = vert_idx;
+	}
+
+	std::vector<uint> canonical(vertex_count);
+	for(uint bucket = 0; bucket < num_buckets; ++bucket){
+		uint bucket_count = bucket_offsets[bucket + 1] - bucket_offsets[bucket];
+		if(bucket_count == 0){
+			continue;
+		}
+
+		Job* job = job_create(JOB_TYPE_GENERIC, weld_bucket_job, vertexes, (const u32*)hashes.data(), (const uint*)bucket_vertexes.data() + bucket_offsets[bucket], bucket_count, canonical.data());
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+
+	// numbering in vertex order keeps the output identical to the serial weld
+	out_vertexes->clear();
+	out_vertexes->reserve(vertex_count);
+	out_remap->resize(vertex_count);
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		uint first = canonical[vert_idx];
+		if(first == vert_idx){
+			(*out_remap)[vert_idx] = (uint)out_vertexes->size();
+			out_vertexes->push_back(vertexes[vert_idx]);
+		}else{
+			(*out_remap)[vert_idx] = (*out_remap)[first];
+		}
+	}
+
+	return (uint)out_vertexes->size();
+}
+
+//-----------------------------------------------------
+// Tipsify
+static uint skip_dead_end(const std::vector<uint>& live_count, std::vector<uint>* dead_end, uint* cursor, uint vertex_count)
+{
+	// most recently used vertexes first, they're the likeliest to still be cached
+	while(!dead_end->empty()){
+		uint vertex = dead_end->back();
+		dead_end->pop_back();
+		if(live_count[vertex] > 0){
+			return vertex;
+		}
+	}
+
+	for(; *cursor < vertex_count; ++(*cursor)){
+		if(live_count[*cursor] > 0){
+			return *cursor;
+		}
+	}
+
+	return INVALID_MESH_INDEX;
+}
+
+void optimize_vertex_cache(const uint* indexes, uint index_count, uint vertex_count, uint cache_size, uint* out_indexes, std::vector<uint>* out_cluster_starts)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_cluster_starts->clear();
+
+	uint triangle_count = index_count / 3;
+	if(triangle_count == 0){
+		return;
+	}
+
+	// vertex -> triangle adjacency, packed
+	std::vector<uint> live_count(vertex_count, 0);
+	for(uint idx = 0; idx < triangle_count * 3; ++idx){
+		live_count[indexes[idx]]++;
+	}
+
+	std::vector<uint> adjacency_offsets(vertex_count + 1, 0);
+	for(uint vertex = 0; vertex < vertex_count; ++vertex){
+		adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + live_count[vertex];
+	}
+
+	std::vector<uint> adjacency(triangle_count * 3);
+	std::vector<uint> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for(uint tri = 0; tri < triangle_count; ++tri){
+		for(uint corner = 0; corner < 3; ++corner){
+			adjacency[fill[indexes[tri * 3 + corner]]++] = tri;
+		}
+	}
+
+	std::vector<uint> cache_time(vertex_count, 0);
+	std::vector<u8> is_emitted(triangle_count, 0);
+	std::vector<uint> dead_end;
+	std::vector<uint> candidates;
+	dead_end.reserve(triangle_count * 3);
+
+	uint time = cache_size + 1;
+	uint cursor = 0;
+	uint out_count = 0;
+
+	uint fan_vertex = indexes[0];
+	bool is_new_cluster = true;
+	while(fan_vertex != INVALID_MESH_INDEX){
+		if(is_new_cluster){
+			out_cluster_starts->push_back(out_count / 3);
+		}
+
+		// emit every remaining triangle around the fan vertex
+		candidates.clear();
+		for(uint adj = adjacency_offsets[fan_vertex]; adj < adjacency_offsets[fan_vertex + 1]; ++adj){
+			uint tri = adjacency[adj];
+			if(is_emitted[tri]){
+				continue;
+			}
+
+			for(uint corner = 0; corner < 3; ++corner){
+				uint vertex = indexes[tri * 3 + corner];
+				out_indexes[out_count++] = vertex;
+				dead_end.push_back(vertex);
+				candidates.push_back(vertex);
+				live_count[vertex]--;
+
+				if(time - cache_time[vertex] > cache_size){
+					cache_time[vertex] = time++;
+				}
+			}
+
+			is_emitted[tri] = 1;
+		}
+
+		// next fan is the oldest candidate that will still be cached after its own triangles go out
+		uint best_vertex = INVALID_MESH_INDEX;
+		int best_priority = -1;
+		for(uint vertex : candidates){
+			if(live_count[vertex] == 0){
+				continue;
+			}
+
+			int priority = 0;
+			if(time - cache_time[vertex] + 2 * live_count[vertex] <= cache_size){
+				priority = (int)(time - cache_time[vertex]);
+			}
+
+			if(priority > best_priority){
+				best_priority = priority;
+				best_vertex = vertex;
+			}
+		}
+
+		is_new_cluster = (best_vertex == INVALID_MESH_INDEX);
+		if(is_new_cluster){
+			best_vertex = skip_dead_end(live_count, &dead_end, &cursor, vertex_count);
+		}
+
+		fan_vertex = best_vertex;
+	}
+}
+
+//-----------------------------------------------------
+// Overdraw
+struct overdraw_cluster_t
+{
+	uint first_triangle;
+	uint triangle_count;
+	float sort_key;
+};
+
+uint optimize_overdraw(const Vertex3* vertexes, uint* indexes, uint index_count, uint vertex_count,
+					   const std::vector<uint>& cluster_starts,
+					   uint cache_size,
+					   float acmr_threshold)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint triangle_count = index_count / 3;
+	if(triangle_count == 0){
+		return 0;
+	}
+
+	// soft boundaries: a hard boundary only closes a cluster once the cluster's
+	// own acmr, starting from a cold cache, is good enough that splitting there
+	// won't cost much vertex reuse
+	std::vector<overdraw_cluster_t> clusters;
+	{
+		std::vector<uint> cache_time(vertex_count, 0);
+		uint time = cache_size + 1;
+		uint misses = 0;
+		uint cluster_start = 0;
+		uint next_boundary = 0;
+
+		for(uint tri = 0; tri < triangle_count; ++tri){
+			for(uint corner = 0; corner < 3; ++corner){
+				uint vertex = indexes[tri * 3 + corner];
+				if(time - cache_time[vertex] > cache_size){
+					cache_time[vertex] = time++;
+					misses++;
+				}
+			}
+
+			while(next_boundary < cluster_starts.size() && cluster_starts[next_boundary] <= tri){
+				next_boundary++;
+			}
+
+			bool is_last = (tri + 1 == triangle_count);
+			bool is_boundary = (next_boundary < cluster_starts.size()) && (cluster_starts[next_boundary] == tri + 1);
+			if(is_last || (is_boundary && (float)misses / (float)(tri + 1 - cluster_start) <= acmr_threshold)){
+				overdraw_cluster_t cluster;
+				cluster.first_triangle = cluster_start;
+				cluster.triangle_count = tri + 1 - cluster_start;
+				cluster.sort_key = 0.0f;
+				clusters.push_back(cluster);
+
+				cluster_start = tri + 1;
+				misses = 0;
+
+				// flush, the next cluster may draw after anything
+				time += cache_size + 1;
+			}
+		}
+	}
+
+	if(clusters.size() <= 1){
+		return (uint)clusters.size();
+	}
+
+	// area weighted centroid and normal per cluster, and for the whole set
+	std::vector<Vector3> centroids(clusters.size());
+	std::vector<Vector3> normals(clusters.size());
+	Vector3 mesh_center_sum = Vector3::ZERO;
+	float mesh_area_sum = 0.0f;
+
+	for(uint cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx){
+		const overdraw_cluster_t& cluster = clusters[cluster_idx];
+
+		Vector3 center_sum = Vector3::ZERO;
+		Vector3 normal_sum = Vector3::ZERO;
+		float area_sum = 0.0f;
+		for(uint tri = cluster.first_triangle; tri < cluster.first_triangle + cluster.triangle_count; ++tri){
+			const Vector3& a = vertexes[indexes[tri * 3 + 0]].m_position;
+			const Vector3& b = vertexes[indexes[tri * 3 + 1]].m_position;
+			const Vector3& c = vertexes[indexes[tri * 3 + 2]].m_position;
+
+			// front faces are counter clockwise in a left handed space, so this points out of the surface
+			Vector3 normal = CrossProduct(c - a, b - a);
+			float area = normal.CalcLength();
+
+			center_sum += ((a + b + c) * (1.0f / 3.0f)) * area;
+			normal_sum += normal;
+			area_sum += area;
+		}
+
+		centroids[cluster_idx] = (area_sum > 0.0f) ? center_sum * (1.0f / area_sum) : vertexes[indexes[cluster.first_triangle * 3]].m_position;
+		normals[cluster_idx] = normal_sum;
+		mesh_center_sum += center_sum;
+		mesh_area_sum += area_sum;
+	}
+
+	Vector3 mesh_center = (mesh_area_sum > 0.0f) ? mesh_center_sum * (1.0f / mesh_area_sum) : Vector3::ZERO;
+	for(uint cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx){
+		Vector3 normal = normals[cluster_idx];
+		if(normal.CalcLengthSquared() > 0.0f){
+			normal.Normalize();
+		}
+		clusters[cluster_idx].sort_key = DotProduct(centroids[cluster_idx] - mesh_center, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const overdraw_cluster_t& a, const overdraw_cluster_t& b){
+		return a.sort_key > b.sort_key;
+	});
+
+	std::vector<uint> sorted_indexes;
+	sorted_indexes.reserve(triangle_count * 3);
+	for(const overdraw_cluster_t& cluster : clusters){
+		sorted_indexes.insert(sorted_indexes.end(), indexes + cluster.first_triangle * 3, indexes + (cluster.first_triangle + cluster.triangle_count) * 3);
+	}
+	memcpy(indexes, sorted_indexes.data(), sorted_indexes.size() * sizeof(uint));
+
+	return (uint)clusters.size();
+}
+
+//-----------------------------------------------------
+// Vertex fetch
+uint optimize_vertex_fetch(std::vector<Vertex3>* vertexes, uint* indexes, uint index_count)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	std::vector<uint> remap(vertexes->size(), INVALID_MESH_INDEX);
+	std::vector<Vertex3> fetch_ordered;
+	fetch_ordered.reserve(vertexes->size());
+
+	for(uint idx = 0; idx < index_count; ++idx){
+		uint vertex = indexes[idx];
+		if(remap[vertex] == INVALID_MESH_INDEX){
+			remap[vertex] = (uint)fetch_ordered.size();
+			fetch_ordered.push_back((*vertexes)[vertex]);
+		}
+		indexes[idx] = remap[vertex];
+	}
+
+	vertexes->swap(fetch_ordered);
+	return (uint)vertexes->size();
+}
+
+//-----------------------------------------------------
+// Whole mesh
+bool is_triangle_list(PrimitiveType type)
+{
+	return (type == PRIMITIVE_TRIANGLES) || (type == PRIMITIVE_TRIANGLES_TESSELATED);
+}
+
+void gather_draw_indexes(const std::vector<uint>& indexes, const draw_instruction_t& draw, std::vector<uint>* out_indexes)
+{
+	out_indexes->resize(draw.count);
+	for(uint idx = 0; idx < draw.count; ++idx){
+		(*out_indexes)[idx] = draw.uses_index_buffer ? indexes[draw.start_index + idx] : draw.start_index + idx;
+	}
+}
+
+bool optimize_mesh(std::vector<Vertex3>* vertexes,
+				   std::vector<uint>* indexes,
+				   std::vector<draw_instruction_t>* draw_instructions,
+				   uint cache_size,
+				   mesh_optimize_stats_t* out_stats)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	for(const draw_instruction_t& draw : *draw_instructions){
+		if(!is_triangle_list(draw.primitive_type) || (draw.count % 3) != 0){
+			return false;
+		}
+	}
+
+	uint vertex_count = (uint)vertexes->size();
+
+	// every draw's triangles in one list, and the acmr of the stream as it is now
+	std::vector<uint> source_indexes;
+	std::vector<uint> draw_indexes;
+	for(const draw_instruction_t& draw : *draw_instructions){
+		gather_draw_indexes(*indexes, draw, &draw_indexes);
+		source_indexes.insert(source_indexes.end(), draw_indexes.begin(), draw_indexes.end());
+	}
+	float acmr_before = calc_acmr(source_indexes.data(), (uint)source_indexes.size(), vertex_count, cache_size);
+
+	std::vector<Vertex3> welded;
+	std::vector<uint> remap;
+	uint welded_count = weld_vertexes(vertexes->data(), vertex_count, &welded, &remap);
+	for(uint& index : source_indexes){
+		index = remap[index];
+	}
+
+	// draws stay separate (materials), each one is ordered on its own
+	std::vector<uint> optimized_indexes(source_indexes.size());
+	std::vector<uint> cluster_starts;
+	uint cluster_count = 0;
+	uint offset = 0;
+	for(draw_instruction_t& draw : *draw_instructions){
+		optimize_vertex_cache(source_indexes.data() + offset, draw.count, welded_count, cache_size, optimized_indexes.data() + offset, &cluster_starts);
+		cluster_count += optimize_overdraw(welded.data(), optimized_indexes.data() + offset, draw.count, welded_count, cluster_starts, cache_size);
+
+		draw.start_index = offset;
+		draw.uses_index_buffer = true;
+		offset += draw.count;
+	}
+
+	optimize_vertex_fetch(&welded, optimized_indexes.data(), (uint)optimized_indexes.size());
+
+	if(out_stats != nullptr){
+		out_stats->vertex_count_before = vertex_count;
+		out_stats->vertex_count_after = (uint)welded.size();
+		out_stats->triangle_count = (uint)optimized_indexes.size() / 3;
+		out_stats->cluster_count = cluster_count;
+		out_stats->acmr_before = acmr_before;
+		out_stats->acmr_after = calc_acmr(optimized_indexes.data(), (uint)optimized_indexes.size(), (uint)welded.size(), cache_size);
+	}
+
+	vertexes->swap(welded);
+	indexes->swap(optimized_indexes);
+	return true;
+}
+
+//-----------------------------------------------------
+// Commands
+COMMAND(optimize_meshes, "[string:directory string:out_directory] Welds and reorders every .mesh in a directory (default Data/Meshes), writing in place unless an out directory is given")
+{
+	std::string directory = args.is_at_end() ? "Data/Meshes" : args.next_string_arg();
+	std::string out_directory = args.is_at_end() ? directory : args.next_string_arg();
+
+	std::vector<std::string> filenames = find_files_in_directory(directory.c_str(), "*.mesh");
+	uint num_optimized = 0;
+	for(const std::string& filename : filenames){
+		std::string mesh_filename = directory + "/" + filename;
+
+		MeshBuilder mb;
+		FileBinaryStream in_stream;
+		if(!in_stream.open_for_read(mesh_filename.c_str())){
+			console_error("Failed to open [%s]", mesh_filename.c_str());
+			continue;
+		}
+		read_mesh_data(in_stream, &mb.m_vertexes, &mb.m_indexes, &mb.m_draw_instructions);
+		in_stream.close();
+
+		mesh_optimize_stats_t stats;
+		double start = get_current_time_seconds();
+		bool optimized = mb.optimize(&stats);
+		double seconds = get_current_time_seconds() - start;
+
+		if(!optimized){
+			console_warning("Skipped [%s], it has draws that aren't triangle lists", mesh_filename.c_str());
+			continue;
+		}
+
+		std::string out_filename = out_directory + "/" + filename;
+		FileBinaryStream out_stream;
+		if(!out_stream.open_for_write(out_filename.c_str())){
+			console_error("Failed to write [%s]", out_filename.c_str());
+			continue;
+		}
+		mb.write(out_stream);
+		out_stream.close();
+		num_optimized++;
+
+		console_info("%s: %u -> %u vertexes, %u tris, %u clusters, acmr %.3f -> %.3f (%.1f ms)",
+					 filename.c_str(),
+					 stats.vertex_count_before, stats.vertex_count_after,
+					 stats.triangle_count, stats.cluster_count,
+					 stats.acmr_before, stats.acmr_after,
+					 seconds * 1000.0);
+	}
+
+	console_info("Optimized %u of %u meshes from [%s] into [%s]", num_optimized, (uint)filenames.size(), directory.c_str(), out_directory.c_str());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/Vertex3.hpp"
+#include "Engine/Renderer/Mesh.hpp"
+
+#include <vector>
+
+#define DEFAULT_VERTEX_CACHE_SIZE (16)
+#define DEFAULT_WELD_VERTEXES_PER_JOB (16384)
+
+// a cluster only becomes its own overdraw cluster once its own acmr gets under this
+#define DEFAULT_OVERDRAW_ACMR_THRESHOLD (0.75f)
+
+struct mesh_optimize_stats_t
+{
+	uint vertex_count_before;
+	uint vertex_count_after;
+	uint triangle_count;
+	uint cluster_count;
+
+	// average cache miss ratio, post transform cache misses per triangle (0.5 is ideal, 3 is no reuse at all)
+	float acmr_before;
+	float acmr_after;
+};
+
+bool is_triangle_list(PrimitiveType type);
+
+// the triangle list a draw instruction draws, as indexes into the vertex array
+void gather_draw_indexes(const std::vector<uint>& indexes, const draw_instruction_t& draw, std::vector<uint>* out_indexes);
+
+// fifo cache simulation over a triangle list
+float calc_acmr(const uint* indexes, uint index_count, uint vertex_count, uint cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+// merges bit identical vertexes, out_remap maps every old vertex to its welded one
+uint weld_vertexes(const Vertex3* vertexes, uint vertex_count, std::vector<Vertex3>* out_vertexes, std::vector<uint>* out_remap);
+
+// same output as weld_vertexes (vertexes stay in first use order). hashing and the
+// duplicate search run on the generic job threads, split by hash into independent buckets
+uint weld_vertexes_parallel(const Vertex3* vertexes, uint vertex_count, std::vector<Vertex3>* out_vertexes, std::vector<uint>* out_remap,
+							uint vertexes_per_job = DEFAULT_WELD_VERTEXES_PER_JOB);
+
+// Tipsify (Sander et al. 2007): fans around the most recently used vertex
+// that will still be in the cache, and when it runs out of those, restarts
+// from a dead end.  Those restarts are where out_cluster_starts (triangle
+// offsets into out_indexes) begin a new cluster.
+void optimize_vertex_cache(const uint* indexes, uint index_count, uint vertex_count, uint cache_size, uint* out_indexes, std::vector<uint>* out_cluster_starts);
+
+// Merges clusters until each one is cache efficient on its own, then sorts
+// them so the ones facing out from the mesh center draw first. Those are the
+// most likely to occlude the rest, so later clusters fail depth and cost less.
+// Returns the number of clusters after merging
+uint optimize_overdraw(const Vertex3* vertexes, uint* indexes, uint index_count, uint vertex_count,
+					   const std::vector<uint>& cluster_starts,
+					   uint cache_size = DEFAULT_VERTEX_CACHE_SIZE,
+					   float acmr_threshold = DEFAULT_OVERDRAW_ACMR_THRESHOLD);
+
+// reorders vertexes into first use order so vertex fetch walks memory forward,
+// drops vertexes nothing references. returns the new vertex count
+uint optimize_vertex_fetch(std::vector<Vertex3>* vertexes, uint* indexes, uint index_count);
+
+// weld, then per draw instruction cache and overdraw ordering, then fetch remapping.
+// every draw instruction must be a triangle list, the mesh is left alone and false
+// returned otherwise. all draw instructions come out indexed
+bool optimize_mesh(std::vector<Vertex3>* vertexes,
+				   std::vector<uint>* indexes,
+				   std::vector<draw_instruction_t>* draw_instructions,
+				   uint cache_size = DEFAULT_VERTEX_CACHE_SIZE,
+				   mesh_optimize_stats_t* out_stats = nullptr);
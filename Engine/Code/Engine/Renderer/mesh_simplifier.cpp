@@ -0,0 +1,746 @@
+#include "Engine/Renderer/mesh_simplifier.h"
+#include "Engine/Renderer/mesh_optimizer.h"
+#include "Engine/Renderer/mesh_file.h"
+#include "Engine/Core/FileBinaryStream.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define INVALID_SIMPLIFY_INDEX ((uint)-1)
+
+// open edges are held in place this much harder than the surface around them
+#define BORDER_QUADRIC_WEIGHT (10.0f)
+
+//-----------------------------------------------------
+// Quadrics
+struct quadric_t
+{
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+
+	// total area (or border length squared) that went in, errors are averaged over it
+	float w;
+};
+
+static void quadric_add_plane(quadric_t* q, const Vector3& normal, float distance, float weight)
+{
+	q->a00 += normal.x * normal.x * weight;
+	q->a11 += normal.y * normal.y * weight;
+	q->a22 += normal.z * normal.z * weight;
+	q->a10 += normal.y * normal.x * weight;
+	q->a20 += normal.z * normal.x * weight;
+	q->a21 += normal.z * normal.y * weight;
+	q->b0 += normal.x * distance * weight;
+	q->b1 += normal.y * distance * weight;
+	q->b2 += normal.z * distance * weight;
+	q->c += distance * distance * weight;
+	q->w += weight;
+}
+
+static void quadric_add(quadric_t* q, const quadric_t& other)
+{
+	q->a00 += other.a00;
+	q->a11 += other.a11;
+	q->a22 += other.a22;
+	q->a10 += other.a10;
+	q->a20 += other.a20;
+	q->a21 += other.a21;
+	q->b0 += other.b0;
+	q->b1 += other.b1;
+	q->b2 += other.b2;
+	q->c += other.c;
+	q->w += other.w;
+}
+
+// mean squared distance from p to every plane that went into q
+static float quadric_error(const quadric_t& q, const Vector3& p)
+{
+	float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z + q.b0;
+	float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z + q.b1;
+	float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z + q.b2;
+
+	float error = rx * p.x + ry * p.y + rz * p.z + q.b0 * p.x + q.b1 * p.y + q.b2 * p.z + q.c;
+	if(q.w <= 0.0f){
+		return 0.0f;
+	}
+
+	return Max(error, 0.0f) / q.w;
+}
+
+//-----------------------------------------------------
+// Topology
+static u32 hash_position(const Vector3& position)
+{
+	u32 words[3];
+	memcpy(words, &position, sizeof(words));
+
+	u32 hash = 2166136261U;
+	for(u32 word : words){
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6dU;
+	hash ^= hash >> 12;
+	return hash;
+}
+
+// the first vertex with each position stands in for all of them (its wedges)
+static void build_position_ids(const Vertex3* vertexes, uint vertex_count, std::vector<uint>* out_position_ids)
+{
+	out_position_ids->resize(vertex_count);
+
+	uint table_size = 1;
+	while(table_size < vertex_count * 2){
+		table_size <<= 1;
+	}
+	std::vector<uint> table(table_size, INVALID_SIMPLIFY_INDEX);
+	uint mask = table_size - 1;
+
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vector3& position = vertexes[vert_idx].m_position;
+		uint slot = hash_position(position) & mask;
+
+		while(true){
+			uint existing = table[slot];
+			if(existing == INVALID_SIMPLIFY_INDEX){
+				table[slot] = vert_idx;
+				(*out_position_ids)[vert_idx] = vert_idx;
+				break;
+			}
+
+			if(memcmp(&vertexes[existing].m_position, &position, sizeof(Vector3)) == 0){
+				(*out_position_ids)[vert_idx] = existing;
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+struct simplify_edge_t
+{
+	uint from;
+	uint to;
+	uint group;
+};
+
+static bool operator<(const simplify_edge_t& a, const simplify_edge_t& b)
+{
+	if(a.from != b.from){
+		return a.from < b.from;
+	}
+	if(a.to != b.to){
+		return a.to < b.to;
+	}
+	return a.group < b.group;
+}
+
+static u64 make_edge_key(uint from, uint to)
+{
+	return ((u64)from << 32) | (u64)to;
+}
+
+// half edges between positions that have no twin in the same group, sorted by make_edge_key
+static void find_border_edges(const std::vector<uint>& indexes, const std::vector<uint>& groups, const std::vector<uint>& position_ids, std::vector<u64>* out_border_edges)
+{
+	uint triangle_count = (uint)indexes.size() / 3;
+
+	std::vector<simplify_edge_t> edges(triangle_count * 3);
+	for(uint tri_idx = 0; tri_idx < triangle_count; ++tri_idx){
+		for(uint corner = 0; corner < 3; ++corner){
+			simplify_edge_t& edge = edges[tri_idx * 3 + corner];
+			edge.from = position_ids[indexes[tri_idx * 3 + corner]];
+			edge.to = position_ids[indexes[tri_idx * 3 + (corner + 1) % 3]];
+			edge.group = groups[tri_idx];
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	out_border_edges->clear();
+	for(const simplify_edge_t& edge : edges){
+		simplify_edge_t twin = { edge.to, edge.from, edge.group };
+		if(!std::binary_search(edges.begin(), edges.end(), twin)){
+			out_border_edges->push_back(make_edge_key(edge.from, edge.to));
+		}
+	}
+	std::sort(out_border_edges->begin(), out_border_edges->end());
+}
+
+static bool is_border_edge(const std::vector<u64>& border_edges, uint a, uint b)
+{
+	return std::binary_search(border_edges.begin(), border_edges.end(), make_edge_key(a, b))
+		|| std::binary_search(border_edges.begin(), border_edges.end(), make_edge_key(b, a));
+}
+
+// triangles touching each position, compressed rows
+static void build_position_adjacency(const std::vector<uint>& indexes, const std::vector<uint>& position_ids, uint vertex_count,
+									 std::vector<uint>* out_offsets, std::vector<uint>* out_triangles)
+{
+	uint triangle_count = (uint)indexes.size() / 3;
+
+	out_offsets->assign(vertex_count + 1, 0);
+	for(uint index : indexes){
+		(*out_offsets)[position_ids[index] + 1]++;
+	}
+	for(uint position = 0; position < vertex_count; ++position){
+		(*out_offsets)[position + 1] += (*out_offsets)[position];
+	}
+
+	out_triangles->resize(indexes.size());
+	std::vector<uint> cursor(out_offsets->begin(), out_offsets->end() - 1);
+	for(uint tri_idx = 0; tri_idx < triangle_count; ++tri_idx){
+		for(uint corner = 0; corner < 3; ++corner){
+			uint position = position_ids[indexes[tri_idx * 3 + corner]];
+			(*out_triangles)[cursor[position]++] = tri_idx;
+		}
+	}
+}
+
+// drops triangles that lost an edge to a collapse (or came in degenerate)
+static void compact_triangles(std::vector<uint>* indexes, std::vector<uint>* groups, const std::vector<uint>& vertex_remap, const std::vector<uint>& position_ids)
+{
+	uint triangle_count = (uint)indexes->size() / 3;
+	uint write_idx = 0;
+
+	for(uint tri_idx = 0; tri_idx < triangle_count; ++tri_idx){
+		uint a = vertex_remap[(*indexes)[tri_idx * 3 + 0]];
+		uint b = vertex_remap[(*indexes)[tri_idx * 3 + 1]];
+		uint c = vertex_remap[(*indexes)[tri_idx * 3 + 2]];
+
+		uint pa = position_ids[a];
+		uint pb = position_ids[b];
+		uint pc = position_ids[c];
+		if(pa == pb || pb == pc || pc == pa){
+			continue;
+		}
+
+		(*indexes)[write_idx * 3 + 0] = a;
+		(*indexes)[write_idx * 3 + 1] = b;
+		(*indexes)[write_idx * 3 + 2] = c;
+		(*groups)[write_idx] = (*groups)[tri_idx];
+		write_idx++;
+	}
+
+	indexes->resize(write_idx * 3);
+	groups->resize(write_idx);
+}
+
+//-----------------------------------------------------
+// Simplification
+struct simplify_context_t
+{
+	std::vector<Vector3> positions;
+	std::vector<uint> position_ids;
+	std::vector<quadric_t> quadrics;
+
+	// per pass
+	std::vector<uint> adjacency_offsets;
+	std::vector<uint> adjacency;
+	std::vector<u64> border_edges;
+	std::vector<u8> is_border;
+	std::vector<uint> wedge_head;
+	std::vector<uint> wedge_next;
+	std::vector<uint> wedge_count;
+};
+
+static void fill_quadrics(simplify_context_t* context, const std::vector<uint>& indexes, uint vertex_count)
+{
+	context->quadrics.resize(vertex_count);
+	memset(context->quadrics.data(), 0, vertex_count * sizeof(quadric_t));
+
+	uint triangle_count = (uint)indexes.size() / 3;
+	for(uint tri_idx = 0; tri_idx < triangle_count; ++tri_idx){
+		uint ids[3];
+		for(uint corner = 0; corner < 3; ++corner){
+			ids[corner] = context->position_ids[indexes[tri_idx * 3 + corner]];
+		}
+
+		const Vector3& p0 = context->positions[ids[0]];
+		const Vector3& p1 = context->positions[ids[1]];
+		const Vector3& p2 = context->positions[ids[2]];
+
+		Vector3 normal = CrossProduct(p1 - p0, p2 - p0);
+		float double_area = normal.CalcLength();
+		if(double_area <= 0.0f){
+			continue;
+		}
+		normal = normal * (1.0f / double_area);
+
+		for(uint corner = 0; corner < 3; ++corner){
+			quadric_add_plane(&context->quadrics[ids[corner]], normal, -DotProduct(normal, p0), double_area * 0.5f);
+		}
+
+		// open edges get a plane through the edge, perpendicular to the face, so they can only slide along themselves
+		for(uint corner = 0; corner < 3; ++corner){
+			uint from = ids[corner];
+			uint to = ids[(corner + 1) % 3];
+			if(!std::binary_search(context->border_edges.begin(), context->border_edges.end(), make_edge_key(from, to))){
+				continue;
+			}
+
+			Vector3 edge = context->positions[to] - context->positions[from];
+			Vector3 edge_normal = CrossProduct(edge, normal);
+			float edge_normal_length = edge_normal.CalcLength();
+			if(edge_normal_length <= 0.0f){
+				continue;
+			}
+			edge_normal = edge_normal * (1.0f / edge_normal_length);
+
+			float weight = edge.CalcLengthSquared() * BORDER_QUADRIC_WEIGHT;
+			float distance = -DotProduct(edge_normal, context->positions[from]);
+			quadric_add_plane(&context->quadrics[from], edge_normal, distance, weight);
+			quadric_add_plane(&context->quadrics[to], edge_normal, distance, weight);
+		}
+	}
+}
+
+static void build_wedges(simplify_context_t* context, const std::vector<uint>& indexes, uint vertex_count)
+{
+	context->wedge_head.assign(vertex_count, INVALID_SIMPLIFY_INDEX);
+	context->wedge_next.assign(vertex_count, INVALID_SIMPLIFY_INDEX);
+	context->wedge_count.assign(vertex_count, 0);
+
+	// only referenced vertexes, anything a collapse orphaned has no triangles to map through
+	std::vector<u8> is_referenced(vertex_count, 0);
+	for(uint index : indexes){
+		if(is_referenced[index]){
+			continue;
+		}
+		is_referenced[index] = 1;
+
+		uint position = context->position_ids[index];
+		context->wedge_next[index] = context->wedge_head[position];
+		context->wedge_head[position] = index;
+		context->wedge_count[position]++;
+	}
+}
+
+// would moving src onto dst turn any remaining triangle around src over (or flat)
+static bool does_collapse_flip(const simplify_context_t& context, const std::vector<uint>& indexes, uint src, uint dst)
+{
+	for(uint adj_idx = context.adjacency_offsets[src]; adj_idx < context.adjacency_offsets[src + 1]; ++adj_idx){
+		uint tri_idx = context.adjacency[adj_idx];
+
+		uint ids[3];
+		for(uint corner = 0; corner < 3; ++corner){
+			ids[corner] = context.position_ids[indexes[tri_idx * 3 + corner]];
+		}
+		if(ids[0] == dst || ids[1] == dst || ids[2] == dst){
+			continue;
+		}
+
+		Vector3 before[3];
+		Vector3 after[3];
+		for(uint corner = 0; corner < 3; ++corner){
+			before[corner] = context.positions[ids[corner]];
+			after[corner] = (ids[corner] == src) ? context.positions[dst] : before[corner];
+		}
+
+		Vector3 normal_before = CrossProduct(before[1] - before[0], before[2] - before[0]);
+		Vector3 normal_after = CrossProduct(after[1] - after[0], after[2] - after[0]);
+
+		float limit = 0.25f * sqrtf(normal_before.CalcLengthSquared() * normal_after.CalcLengthSquared());
+		if(DotProduct(normal_before, normal_after) <= limit){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// every wedge of src moves to the wedge of dst it shares a triangle with, and on a
+// seam no two may land on the same one or the seam would be smeared shut
+static bool map_collapse_wedges(const simplify_context_t& context, const std::vector<uint>& indexes, uint src, uint dst,
+								std::vector<uint>* out_from, std::vector<uint>* out_to)
+{
+	out_from->clear();
+	out_to->clear();
+
+	for(uint wedge = context.wedge_head[src]; wedge != INVALID_SIMPLIFY_INDEX; wedge = context.wedge_next[wedge]){
+		uint target = INVALID_SIMPLIFY_INDEX;
+
+		for(uint adj_idx = context.adjacency_offsets[src]; adj_idx < context.adjacency_offsets[src + 1] && target == INVALID_SIMPLIFY_INDEX; ++adj_idx){
+			uint tri_idx = context.adjacency[adj_idx];
+			for(uint corner = 0; corner < 3; ++corner){
+				if(indexes[tri_idx * 3 + corner] != wedge){
+					continue;
+				}
+
+				uint next = indexes[tri_idx * 3 + (corner + 1) % 3];
+				uint prev = indexes[tri_idx * 3 + (corner + 2) % 3];
+				if(context.position_ids[next] == dst){
+					target = next;
+				}else if(context.position_ids[prev] == dst){
+					target = prev;
+				}
+				break;
+			}
+		}
+
+		if(target == INVALID_SIMPLIFY_INDEX){
+			return false;
+		}
+
+		if(context.wedge_count[src] > 1 && std::find(out_to->begin(), out_to->end(), target) != out_to->end()){
+			return false;
+		}
+
+		out_from->push_back(wedge);
+		out_to->push_back(target);
+	}
+
+	return !out_from->empty();
+}
+
+float simplify_mesh(const Vertex3* vertexes, uint vertex_count,
+					const uint* indexes, uint index_count,
+					const uint* triangle_groups,
+					uint target_index_count, float target_error,
+					std::vector<uint>* out_indexes,
+					std::vector<uint>* out_triangle_groups)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint triangle_count = index_count / 3;
+	out_indexes->assign(indexes, indexes + triangle_count * 3);
+
+	std::vector<uint> groups;
+	if(triangle_groups != nullptr){
+		groups.assign(triangle_groups, triangle_groups + triangle_count);
+	}else{
+		groups.assign(triangle_count, 0);
+	}
+
+	simplify_context_t context;
+
+	// scaled into the unit sphere around the mesh so every error comes out relative to its radius
+	AABB3 bounds = calc_vertex_bounds(vertexes, vertex_count);
+	Vector3 center = bounds.CalcCenter();
+	float radius = bounds.CalcHalfExtents().CalcLength();
+	float inv_radius = (radius > 0.0f) ? (1.0f / radius) : 0.0f;
+
+	context.positions.resize(vertex_count);
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		context.positions[vert_idx] = (vertexes[vert_idx].m_position - center) * inv_radius;
+	}
+	build_position_ids(vertexes, vertex_count, &context.position_ids);
+
+	std::vector<uint> vertex_remap(vertex_count);
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		vertex_remap[vert_idx] = vert_idx;
+	}
+	compact_triangles(out_indexes, &groups, vertex_remap, context.position_ids);
+
+	find_border_edges(*out_indexes, groups, context.position_ids, &context.border_edges);
+	fill_quadrics(&context, *out_indexes, vertex_count);
+
+	float error_limit = target_error * target_error;
+	float max_collapse_error = 0.0f;
+	target_index_count -= target_index_count % 3;
+
+	std::vector<float> collapse_cost(vertex_count);
+	std::vector<uint> collapse_dst(vertex_count);
+	std::vector<uint> candidates;
+	std::vector<u8> is_locked(vertex_count);
+	std::vector<uint> wedges_from;
+	std::vector<uint> wedges_to;
+
+	// passes of independent collapses, cheapest first, until the target or the error limit
+	while(out_indexes->size() > target_index_count){
+		const std::vector<uint>& current = *out_indexes;
+		uint current_triangle_count = (uint)current.size() / 3;
+
+		find_border_edges(current, groups, context.position_ids, &context.border_edges);
+		context.is_border.assign(vertex_count, 0);
+		for(u64 edge : context.border_edges){
+			context.is_border[(uint)(edge >> 32)] = 1;
+			context.is_border[(uint)(edge & 0xFFFFFFFF)] = 1;
+		}
+
+		build_position_adjacency(current, context.position_ids, vertex_count, &context.adjacency_offsets, &context.adjacency);
+		build_wedges(&context, current, vertex_count);
+
+		// cheapest collapse out of every position
+		std::fill(collapse_cost.begin(), collapse_cost.end(), FLT_MAX);
+		std::fill(collapse_dst.begin(), collapse_dst.end(), INVALID_SIMPLIFY_INDEX);
+		for(uint tri_idx = 0; tri_idx < current_triangle_count; ++tri_idx){
+			for(uint corner = 0; corner < 6; ++corner){
+				uint a = context.position_ids[current[tri_idx * 3 + (corner % 3)]];
+				uint b = context.position_ids[current[tri_idx * 3 + (corner + 1) % 3]];
+				uint src = (corner < 3) ? a : b;
+				uint dst = (corner < 3) ? b : a;
+
+				if(context.is_border[src] && !is_border_edge(context.border_edges, src, dst)){
+					continue;
+				}
+				if(context.wedge_count[src] > 1 && context.wedge_count[src] != context.wedge_count[dst]){
+					continue;
+				}
+
+				float cost = quadric_error(context.quadrics[src], context.positions[dst]);
+				if(cost < collapse_cost[src]){
+					collapse_cost[src] = cost;
+					collapse_dst[src] = dst;
+				}
+			}
+		}
+
+		candidates.clear();
+		for(uint position = 0; position < vertex_count; ++position){
+			if(collapse_dst[position] != INVALID_SIMPLIFY_INDEX){
+				candidates.push_back(position);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [&](uint a, uint b){ return collapse_cost[a] < collapse_cost[b]; });
+
+		// everything around a collapse is locked for the rest of the pass, so the
+		// flip checks and wedge maps below only ever see geometry as it is now
+		std::fill(is_locked.begin(), is_locked.end(), (u8)0);
+		uint triangles_to_remove = ((uint)current.size() - target_index_count) / 3;
+		uint triangles_removed = 0;
+		uint collapse_count = 0;
+
+		for(uint src : candidates){
+			float cost = collapse_cost[src];
+			if(cost > error_limit){
+				break;
+			}
+
+			uint dst = collapse_dst[src];
+			if(is_locked[src] || is_locked[dst]){
+				continue;
+			}
+			if(does_collapse_flip(context, current, src, dst)){
+				continue;
+			}
+			if(!map_collapse_wedges(context, current, src, dst, &wedges_from, &wedges_to)){
+				continue;
+			}
+
+			for(uint wedge_idx = 0; wedge_idx < (uint)wedges_from.size(); ++wedge_idx){
+				vertex_remap[wedges_from[wedge_idx]] = wedges_to[wedge_idx];
+			}
+			quadric_add(&context.quadrics[dst], context.quadrics[src]);
+
+			for(uint adj_idx = context.adjacency_offsets[src]; adj_idx < context.adjacency_offsets[src + 1]; ++adj_idx){
+				uint tri_idx = context.adjacency[adj_idx];
+				bool has_dst = false;
+				for(uint corner = 0; corner < 3; ++corner){
+					uint position = context.position_ids[current[tri_idx * 3 + corner]];
+					is_locked[position] = 1;
+					has_dst = has_dst || (position == dst);
+				}
+				triangles_removed += has_dst ? 1 : 0;
+			}
+
+			max_collapse_error = Max(max_collapse_error, cost);
+			collapse_count++;
+
+			if(triangles_removed >= triangles_to_remove){
+				break;
+			}
+		}
+
+		if(collapse_count == 0){
+			break;
+		}
+
+		compact_triangles(out_indexes, &groups, vertex_remap, context.position_ids);
+	}
+
+	if(out_triangle_groups != nullptr){
+		out_triangle_groups->swap(groups);
+	}
+
+	return sqrtf(max_collapse_error);
+}
+
+//-----------------------------------------------------
+// LOD chains
+uint generate_mesh_lods(const Vertex3* vertexes, uint vertex_count,
+						std::vector<uint>* indexes,
+						const std::vector<draw_instruction_t>& draw_instructions,
+						std::vector<mesh_lod_t>* out_lods,
+						std::vector<draw_instruction_t>* out_lod_draw_instructions,
+						uint lod_count,
+						float reduction,
+						float max_error)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	out_lods->clear();
+	out_lod_draw_instructions->clear();
+
+	for(const draw_instruction_t& draw : draw_instructions){
+		if(!is_triangle_list(draw.primitive_type) || (draw.count % 3) != 0){
+			return 0;
+		}
+	}
+
+	// every draw in one list, each triangle tagged with the draw it came from
+	std::vector<uint> base_indexes;
+	std::vector<uint> base_groups;
+	std::vector<uint> draw_indexes;
+	for(uint draw_idx = 0; draw_idx < (uint)draw_instructions.size(); ++draw_idx){
+		gather_draw_indexes(*indexes, draw_instructions[draw_idx], &draw_indexes);
+		base_indexes.insert(base_indexes.end(), draw_indexes.begin(), draw_indexes.end());
+		base_groups.insert(base_groups.end(), draw_indexes.size() / 3, draw_idx);
+	}
+
+	uint base_triangle_count = (uint)base_indexes.size() / 3;
+	uint previous_index_count = (uint)base_indexes.size();
+	float fraction = 1.0f;
+
+	std::vector<uint> lod_indexes;
+	std::vector<uint> lod_groups;
+	std::vector<uint> ordered_indexes;
+	std::vector<uint> cluster_starts;
+
+	for(uint level = 1; level < lod_count; ++level){
+		fraction *= reduction;
+		uint target_index_count = (uint)((float)base_triangle_count * fraction) * 3;
+
+		float error = simplify_mesh(vertexes, vertex_count,
+									base_indexes.data(), (uint)base_indexes.size(),
+									base_groups.data(),
+									target_index_count, max_error,
+									&lod_indexes, &lod_groups);
+
+		// max_error stopped it short of doing anything worth a level
+		if(lod_indexes.empty() || (lod_indexes.size() * 10 > (size_t)previous_index_count * 9)){
+			break;
+		}
+		previous_index_count = (uint)lod_indexes.size();
+
+		mesh_lod_t lod;
+		lod.first_draw_instruction = (uint)out_lod_draw_instructions->size();
+		lod.draw_instruction_count = 0;
+		lod.error = error;
+		lod.triangle_count = (uint)lod_indexes.size() / 3;
+
+		for(uint draw_idx = 0; draw_idx < (uint)draw_instructions.size(); ++draw_idx){
+			draw_indexes.clear();
+			for(uint tri_idx = 0; tri_idx < (uint)lod_groups.size(); ++tri_idx){
+				if(lod_groups[tri_idx] == draw_idx){
+					draw_indexes.insert(draw_indexes.end(), lod_indexes.begin() + tri_idx * 3, lod_indexes.begin() + tri_idx * 3 + 3);
+				}
+			}
+			if(draw_indexes.empty()){
+				continue;
+			}
+
+			ordered_indexes.resize(draw_indexes.size());
+			optimize_vertex_cache(draw_indexes.data(), (uint)draw_indexes.size(), vertex_count, DEFAULT_VERTEX_CACHE_SIZE, ordered_indexes.data(), &cluster_starts);
+
+			draw_instruction_t draw = draw_instructions[draw_idx];
+			draw.start_index = (uint)indexes->size();
+			draw.count = (uint)ordered_indexes.size();
+			draw.uses_index_buffer = true;
+			indexes->insert(indexes->end(), ordered_indexes.begin(), ordered_indexes.end());
+
+			out_lod_draw_instructions->push_back(draw);
+			lod.draw_instruction_count++;
+		}
+
+		out_lods->push_back(lod);
+	}
+
+	return (uint)out_lods->size();
+}
+
+//-----------------------------------------------------
+// Commands
+COMMAND(generate_mesh_lods, "[string:directory uint:lod_count float:max_error] Builds a LOD chain for every .mesh in a directory (default Data/Meshes) and writes it out as a " MESH_FILE_EXTENSION)
+{
+	std::string directory = args.is_at_end() ? "Data/Meshes" : args.next_string_arg();
+	uint lod_count = DEFAULT_MESH_LOD_COUNT;
+	if(!args.is_at_end()){
+		lod_count = Max(2U, args.next_uint_arg());
+	}
+	float max_error = DEFAULT_MESH_LOD_MAX_ERROR;
+	if(!args.is_at_end()){
+		max_error = args.next_float_arg();
+	}
+
+	std::vector<std::string> filenames = find_files_in_directory(directory.c_str(), "*.mesh");
+	uint num_written = 0;
+	for(const std::string& filename : filenames){
+		std::string mesh_filename = directory + "/" + filename;
+
+		std::vector<Vertex3> vertexes;
+		std::vector<uint> indexes;
+		std::vector<draw_instruction_t> draw_instructions;
+		FileBinaryStream fbs;
+		if(!fbs.open_for_read(mesh_filename.c_str())){
+			console_error("Failed to open [%s]", mesh_filename.c_str());
+			continue;
+		}
+		read_mesh_data(fbs, &vertexes, &indexes, &draw_instructions);
+		fbs.close();
+
+		// the fbx exports are unindexed, every corner its own vertex, and nothing collapses until they're welded
+		if(!optimize_mesh(&vertexes, &indexes, &draw_instructions)){
+			console_error("%s: only triangle lists can have lods", filename.c_str());
+			continue;
+		}
+
+		uint base_triangle_count = 0;
+		for(const draw_instruction_t& draw : draw_instructions){
+			base_triangle_count += draw.count / 3;
+		}
+
+		std::vector<mesh_lod_t> lods;
+		std::vector<draw_instruction_t> lod_draw_instructions;
+		double start = get_current_time_seconds();
+		uint levels = generate_mesh_lods(vertexes.data(), (uint)vertexes.size(), &indexes, draw_instructions, &lods, &lod_draw_instructions, lod_count, DEFAULT_MESH_LOD_REDUCTION, max_error);
+		double seconds = get_current_time_seconds() - start;
+
+		// every level only references vertexes that were already there
+		bool is_valid = true;
+		for(uint index : indexes){
+			is_valid = is_valid && (index < (uint)vertexes.size());
+		}
+		if(!is_valid){
+			console_error("%s: a level indexes past the vertex buffer", filename.c_str());
+			continue;
+		}
+
+		console_info("%s: %u tris, %u levels in %.1f ms", filename.c_str(), base_triangle_count, levels, seconds * 1000.0);
+		for(uint level = 0; level < levels; ++level){
+			const mesh_lod_t& lod = lods[level];
+			console_info("  lod %u: %u tris (%.1f%%), error %.5f, %u draws",
+						 level + 1,
+						 lod.triangle_count,
+						 (base_triangle_count > 0) ? (100.0f * (float)lod.triangle_count / (float)base_triangle_count) : 0.0f,
+						 lod.error,
+						 lod.draw_instruction_count);
+		}
+
+		std::string out_filename = make_mesh_file_name(mesh_filename);
+		bool did_write = write_mesh_file(out_filename.c_str(),
+										 vertexes.data(), (uint)vertexes.size(),
+										 indexes.data(), (uint)indexes.size(),
+										 draw_instructions.data(), (uint)draw_instructions.size(),
+										 calc_vertex_bounds(vertexes.data(), (uint)vertexes.size()),
+										 lods.data(), (uint)lods.size(),
+										 lod_draw_instructions.data(), (uint)lod_draw_instructions.size());
+		if(!did_write){
+			console_error("Failed to write [%s]", out_filename.c_str());
+			continue;
+		}
+		num_written++;
+	}
+
+	console_info("Wrote LOD chains for %u of %u meshes in [%s]", num_written, (uint)filenames.size(), directory.c_str());
+}
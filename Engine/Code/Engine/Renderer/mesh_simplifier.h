@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/Vertex3.hpp"
+#include "Engine/Renderer/Mesh.hpp"
+
+#include <vector>
+
+// levels including the base mesh
+#define DEFAULT_MESH_LOD_COUNT (4)
+
+// each level aims for this fraction of the base mesh's triangles times the previous level's fraction
+#define DEFAULT_MESH_LOD_REDUCTION (0.5f)
+
+// relative to the mesh's bounding radius, a level that would need more than this isn't made
+#define DEFAULT_MESH_LOD_MAX_ERROR (0.05f)
+
+// Quadric error metric edge collapse (Garland & Heckbert 1997) over an index buffer.
+// A collapse snaps one vertex onto a neighbour, nothing is moved or created, so
+// every level indexes the same vertex buffer as the base mesh.
+//
+// Vertexes sharing a position (uv / normal seams) collapse as one and only along
+// the seam. Open edges, and edges between triangles of different groups (draws,
+// so materials), only collapse along themselves.
+//
+// triangle_groups has one entry per triangle and may be null; out_triangle_groups
+// gets the groups of the triangles that survived, in the same order.
+// Stops at target_index_count, or once the next collapse would cost more than
+// target_error. Returns the error reached, both relative to the mesh's bounding radius
+float simplify_mesh(const Vertex3* vertexes, uint vertex_count,
+					const uint* indexes, uint index_count,
+					const uint* triangle_groups,
+					uint target_index_count, float target_error,
+					std::vector<uint>* out_indexes,
+					std::vector<uint>* out_triangle_groups = nullptr);
+
+// Every level is simplified from the base triangles, not the previous level, so
+// errors don't stack. Level indexes are cache ordered and appended to indexes;
+// out_lod_draw_instructions gets one draw per base draw that still has triangles.
+// Levels stop early once the error passes max_error or the reduction stalls.
+// All draws must be triangle lists. Returns the number of levels made, not counting the base
+uint generate_mesh_lods(const Vertex3* vertexes, uint vertex_count,
+						std::vector<uint>* indexes,
+						const std::vector<draw_instruction_t>& draw_instructions,
+						std::vector<mesh_lod_t>* out_lods,
+						std::vector<draw_instruction_t>* out_lod_draw_instructions,
+						uint lod_count = DEFAULT_MESH_LOD_COUNT,
+						float reduction = DEFAULT_MESH_LOD_REDUCTION,
+						float max_error = DEFAULT_MESH_LOD_MAX_ERROR);
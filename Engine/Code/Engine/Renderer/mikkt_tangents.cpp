@@ -0,0 +1,390 @@
+#include "Engine/Renderer/mikkt_tangents.h"
+#include "Engine/Renderer/mesh_optimizer.h"
+#include "Engine/Core/FileBinaryStream.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/job.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+#include "ThirdParty/mikkt/mikktspace.h"
+
+#include <string.h>
+#include <vector>
+
+#define INVALID_MIKKT_INDEX ((uint)-1)
+
+// ------------------------------------------------------
+// mikkt interface functions
+// ------------------------------------------------------
+struct mikkt_user_data_t
+{
+	Vertex3* vertexes;
+
+	// faces this run sees, in order. null for every face
+	const uint* faces;
+	uint face_count;
+};
+
+static Vertex3& get_mikkt_vertex(const SMikkTSpaceContext* context, const int face_index, const int vert_index)
+{
+	mikkt_user_data_t* data = (mikkt_user_data_t*)context->m_pUserData;
+	uint face = (data->faces != nullptr) ? data->faces[face_index] : (uint)face_index;
+	return data->vertexes[(face * 3) + vert_index];
+}
+
+// Returns the number of faces (triangles/quads) on the mesh to be processed.
+static int mikkt_get_num_faces(const SMikkTSpaceContext* context)
+{
+	mikkt_user_data_t* data = (mikkt_user_data_t*)context->m_pUserData;
+	return (int)data->face_count;
+}
+
+// Returns the number of vertices on face number iFace
+// iFace is a number in the range {0, 1, ..., getNumFaces()-1}
+static int mikkt_get_num_vertices_of_face(const SMikkTSpaceContext* context, const int face_index)
+{
+	UNUSED(face_index);
+	UNUSED(context);
+	return 3;
+}
+
+// returns the position/normal/texcoord of the referenced face of vertex number iVert.
+// iVert is in the range {0,1,2} for triangles and {0,1,2,3} for quads.
+static void mikkt_get_position(const SMikkTSpaceContext * context, float fvPosOut[], const int face_index, const int vert_index)
+{
+	const Vertex3& vert = get_mikkt_vertex(context, face_index, vert_index);
+
+	fvPosOut[0] = vert.m_position.x;
+	fvPosOut[1] = vert.m_position.y;
+	fvPosOut[2] = vert.m_position.z;
+}
+
+static void mikkt_get_normal(const SMikkTSpaceContext* context, float fvNormOut[], const int face_index, const int vert_index)
+{
+	const Vertex3& vert = get_mikkt_vertex(context, face_index, vert_index);
+
+	fvNormOut[0] = vert.m_normal.x;
+	fvNormOut[1] = vert.m_normal.y;
+	fvNormOut[2] = vert.m_normal.z;
+}
+
+static void mikkt_get_uv(const SMikkTSpaceContext * context, float fvTexcOut[], const int face_index, const int vert_index)
+{
+	const Vertex3& vert = get_mikkt_vertex(context, face_index, vert_index);
+
+	fvTexcOut[0] = vert.m_texCoords.x;
+	fvTexcOut[1] = vert.m_texCoords.y;
+}
+
+// either (or both) of the two setTSpace callbacks can be set.
+// The call-back m_setTSpaceBasic() is sufficient for basic normal mapping.
+
+// This function is used to return the tangent and fSign to the application.
+// fvTangent is a unit length vector.
+// For normal maps it is sufficient to use the following simplified version of the bitangent which is generated at pixel/vertex level.
+// bitangent = fSign * cross(vN, tangent);
+// Note that the results are returned unindexed. It is possible to generate a new index list
+// But averaging/overwriting tangent spaces by using an already existing index list WILL produce INCRORRECT results.
+// DO NOT! use an already existing index list.
+static void mikkt_set_tangent_space_basic(const SMikkTSpaceContext * context, const float fvTangent[], const float fSign, const int face_index, const int vert_index)
+{
+	Vertex3& vert = get_mikkt_vertex(context, face_index, vert_index);
+
+	Vector3 tangent;
+	tangent.x = fvTangent[0];
+	tangent.y = fvTangent[1];
+	tangent.z = fvTangent[2];
+
+	vert.m_tangent = tangent;
+	vert.m_bitangent = fSign * CrossProduct(vert.m_tangent, vert.m_normal);
+}
+
+static void run_mikkt(Vertex3* vertexes, const uint* faces, uint face_count)
+{
+	SMikkTSpaceInterface mikkt_interface;
+	mikkt_interface.m_getNormal = mikkt_get_normal;
+	mikkt_interface.m_getNumFaces = mikkt_get_num_faces;
+	mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
+	mikkt_interface.m_getPosition = mikkt_get_position;
+	mikkt_interface.m_getTexCoord = mikkt_get_uv;
+	mikkt_interface.m_setTSpaceBasic = mikkt_set_tangent_space_basic;
+	mikkt_interface.m_setTSpace = nullptr;
+
+	mikkt_user_data_t data;
+	data.vertexes = vertexes;
+	data.faces = faces;
+	data.face_count = face_count;
+
+	SMikkTSpaceContext mikkt_context;
+	mikkt_context.m_pInterface = &mikkt_interface;
+	mikkt_context.m_pUserData = (void*)&data;
+
+	genTangSpaceDefault(&mikkt_context);
+}
+
+void generate_mikkt_tangents(Vertex3* vertexes, uint vertex_count)
+{
+	PROFILE_SCOPE_FUNCTION();
+	run_mikkt(vertexes, nullptr, vertex_count / 3);
+}
+
+//-----------------------------------------------------
+// Islands
+
+// what mikkt compares corners by, with -0 folded into +0 since mikkt compares with ==
+struct mikkt_corner_key_t
+{
+	float values[8];
+};
+
+static void make_corner_key(const Vertex3& vertex, mikkt_corner_key_t* out_key)
+{
+	out_key->values[0] = vertex.m_position.x + 0.0f;
+	out_key->values[1] = vertex.m_position.y + 0.0f;
+	out_key->values[2] = vertex.m_position.z + 0.0f;
+	out_key->values[3] = vertex.m_normal.x + 0.0f;
+	out_key->values[4] = vertex.m_normal.y + 0.0f;
+	out_key->values[5] = vertex.m_normal.z + 0.0f;
+	out_key->values[6] = vertex.m_texCoords.x + 0.0f;
+	out_key->values[7] = vertex.m_texCoords.y + 0.0f;
+}
+
+static u32 hash_corner_key(const mikkt_corner_key_t& key)
+{
+	u32 words[8];
+	memcpy(words, key.values, sizeof(words));
+
+	u32 hash = 2166136261U;
+	for(u32 word : words){
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6dU;
+	hash ^= hash >> 12;
+	return hash;
+}
+
+static uint find_island_root(std::vector<uint>* parents, uint node)
+{
+	while((*parents)[node] != node){
+		(*parents)[node] = (*parents)[(*parents)[node]];
+		node = (*parents)[node];
+	}
+	return node;
+}
+
+// the lower root wins, so roots (and the island order built from them) don't depend on union order
+static void join_islands(std::vector<uint>* parents, uint a, uint b)
+{
+	a = find_island_root(parents, a);
+	b = find_island_root(parents, b);
+	if(a < b){
+		(*parents)[b] = a;
+	}else if(b < a){
+		(*parents)[a] = b;
+	}
+}
+
+// per face, the lowest face index of the island it's in
+static void find_mikkt_islands(const Vertex3* vertexes, uint face_count, std::vector<uint>* out_face_islands)
+{
+	uint corner_count = face_count * 3;
+
+	uint table_size = 1;
+	while(table_size < corner_count * 2){
+		table_size <<= 1;
+	}
+	std::vector<uint> table(table_size, INVALID_MIKKT_INDEX);
+	std::vector<mikkt_corner_key_t> keys(corner_count);
+	uint mask = table_size - 1;
+
+	// union over faces, a corner joins its face to the first face that had the same corner
+	std::vector<uint> parents(face_count);
+	for(uint face = 0; face < face_count; ++face){
+		parents[face] = face;
+	}
+
+	for(uint corner = 0; corner < corner_count; ++corner){
+		make_corner_key(vertexes[corner], &keys[corner]);
+		uint slot = hash_corner_key(keys[corner]) & mask;
+
+		while(true){
+			uint existing = table[slot];
+			if(existing == INVALID_MIKKT_INDEX){
+				table[slot] = corner;
+				break;
+			}
+
+			if(memcmp(&keys[existing], &keys[corner], sizeof(mikkt_corner_key_t)) == 0){
+				join_islands(&parents, existing / 3, corner / 3);
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	out_face_islands->resize(face_count);
+	for(uint face = 0; face < face_count; ++face){
+		(*out_face_islands)[face] = find_island_root(&parents, face);
+	}
+}
+
+//-----------------------------------------------------
+// Parallel
+static void mikkt_faces_job(Vertex3* vertexes, const uint* faces, uint face_count)
+{
+	run_mikkt(vertexes, faces, face_count);
+}
+
+void generate_mikkt_tangents_parallel(Vertex3* vertexes, uint vertex_count, uint triangles_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	triangles_per_job = Max(1U, triangles_per_job);
+	uint face_count = vertex_count / 3;
+	if(face_count <= triangles_per_job){
+		run_mikkt(vertexes, nullptr, face_count);
+		return;
+	}
+
+	std::vector<uint> face_islands;
+	find_mikkt_islands(vertexes, face_count, &face_islands);
+
+	std::vector<uint> island_sizes(face_count, 0);
+	for(uint island : face_islands){
+		island_sizes[island]++;
+	}
+
+	// islands in order of their first face, closing a job once it's big enough
+	std::vector<uint> island_jobs(face_count, INVALID_MIKKT_INDEX);
+	std::vector<uint> job_sizes;
+	uint open_job_size = triangles_per_job;
+	for(uint face = 0; face < face_count; ++face){
+		if(face_islands[face] != face){
+			continue;
+		}
+
+		if(open_job_size >= triangles_per_job){
+			job_sizes.push_back(0);
+			open_job_size = 0;
+		}
+
+		island_jobs[face] = (uint)job_sizes.size() - 1;
+		job_sizes.back() += island_sizes[face];
+		open_job_size += island_sizes[face];
+	}
+
+	if(job_sizes.size() == 1){
+		run_mikkt(vertexes, nullptr, face_count);
+		return;
+	}
+
+	// one face list per job, faces keep their relative order so mikkt's averaging order does too
+	std::vector<uint> job_offsets(job_sizes.size() + 1, 0);
+	for(uint job_idx = 0; job_idx < (uint)job_sizes.size(); ++job_idx){
+		job_offsets[job_idx + 1] = job_offsets[job_idx] + job_sizes[job_idx];
+	}
+
+	std::vector<uint> job_faces(face_count);
+	std::vector<uint> cursor(job_offsets.begin(), job_offsets.end() - 1);
+	for(uint face = 0; face < face_count; ++face){
+		job_faces[cursor[island_jobs[face_islands[face]]]++] = face;
+	}
+
+	std::vector<Job*> jobs;
+	jobs.reserve(job_sizes.size());
+	for(uint job_idx = 0; job_idx < (uint)job_sizes.size(); ++job_idx){
+		Job* job = job_create(JOB_TYPE_GENERIC, mikkt_faces_job, vertexes, (const uint*)job_faces.data() + job_offsets[job_idx], job_sizes[job_idx]);
+		job_dispatch(job);
+		jobs.push_back(job);
+	}
+
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+//-----------------------------------------------------
+// Benchmark
+COMMAND(mikkt_benchmark, "[string:mesh_filename uint:triangles_per_job] Times serial against job mikkt tangents and welding on a .mesh, and checks they match")
+{
+	std::string mesh_filename = args.is_at_end() ? "Data/Meshes/ue4_shaderball.mesh" : args.next_string_arg();
+	uint triangles_per_job = DEFAULT_MIKKT_TRIANGLES_PER_JOB;
+	if(!args.is_at_end()){
+		triangles_per_job = Max(1U, args.next_uint_arg());
+	}
+
+	std::vector<Vertex3> vertexes;
+	std::vector<uint> indexes;
+	std::vector<draw_instruction_t> draw_instructions;
+	FileBinaryStream fbs;
+	if(!fbs.open_for_read(mesh_filename.c_str())){
+		console_error("Failed to open [%s]", mesh_filename.c_str());
+		return;
+	}
+	read_mesh_data(fbs, &vertexes, &indexes, &draw_instructions);
+	fbs.close();
+
+	// mikkt wants the triangles the way an importer hands them over, one vertex per corner
+	std::vector<Vertex3> source;
+	std::vector<uint> draw_indexes;
+	for(const draw_instruction_t& draw : draw_instructions){
+		if(!is_triangle_list(draw.primitive_type)){
+			continue;
+		}
+
+		gather_draw_indexes(indexes, draw, &draw_indexes);
+		for(uint index : draw_indexes){
+			source.push_back(vertexes[index]);
+		}
+	}
+	uint corner_count = (uint)source.size();
+
+	std::vector<Vertex3> serial = source;
+	double start = get_current_time_seconds();
+	generate_mikkt_tangents(serial.data(), corner_count);
+	double serial_seconds = get_current_time_seconds() - start;
+
+	std::vector<Vertex3> parallel = source;
+	start = get_current_time_seconds();
+	generate_mikkt_tangents_parallel(parallel.data(), corner_count, triangles_per_job);
+	double parallel_seconds = get_current_time_seconds() - start;
+
+	std::vector<Vertex3> serial_welded;
+	std::vector<uint> serial_remap;
+	start = get_current_time_seconds();
+	weld_vertexes(serial.data(), corner_count, &serial_welded, &serial_remap);
+	double serial_weld_seconds = get_current_time_seconds() - start;
+
+	std::vector<Vertex3> parallel_welded;
+	std::vector<uint> parallel_remap;
+	start = get_current_time_seconds();
+	weld_vertexes_parallel(parallel.data(), corner_count, &parallel_welded, &parallel_remap);
+	double parallel_weld_seconds = get_current_time_seconds() - start;
+
+	uint tangent_mismatches = 0;
+	for(uint corner = 0; corner < corner_count; ++corner){
+		if(memcmp(&serial[corner], &parallel[corner], sizeof(Vertex3)) != 0){
+			tangent_mismatches++;
+		}
+	}
+
+	bool welds_match = (serial_welded.size() == parallel_welded.size())
+		&& (serial_remap == parallel_remap)
+		&& (memcmp(serial_welded.data(), parallel_welded.data(), serial_welded.size() * sizeof(Vertex3)) == 0);
+
+	console_info("----Mikkt tangents [%s] (%u triangles, %u per job)----", mesh_filename.c_str(), corner_count / 3, triangles_per_job);
+	console_info("tangents, serial:   %.2f ms", serial_seconds * 1000.0);
+	console_info("tangents, jobs:     %.2f ms (%.2fx)", parallel_seconds * 1000.0, serial_seconds / Max(parallel_seconds, 1e-9));
+	console_info("weld, serial:       %.2f ms", serial_weld_seconds * 1000.0);
+	console_info("weld, jobs:         %.2f ms (%.2fx)", parallel_weld_seconds * 1000.0, serial_weld_seconds / Max(parallel_weld_seconds, 1e-9));
+	console_info("welded %u corners into %u vertexes", corner_count, (uint)parallel_welded.size());
+
+	if(tangent_mismatches == 0 && welds_match){
+		console_success("Job results match the serial path");
+	}else{
+		console_error("%u corners differ from the serial tangents, welds %s", tangent_mismatches, welds_match ? "match" : "differ");
+	}
+}
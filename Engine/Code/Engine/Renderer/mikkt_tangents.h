@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/Vertex3.hpp"
+
+#define DEFAULT_MIKKT_TRIANGLES_PER_JOB (8192)
+
+// MikkTSpace tangents over an un-indexed triangle list, every 3 vertexes are a face.
+// Fills m_tangent and m_bitangent (sign * cross(tangent, normal)).  Has to be
+// un-indexed, mikkt finds shared vertexes itself and averaging through an existing
+// index list gives wrong tangents.
+void generate_mikkt_tangents(Vertex3* vertexes, uint vertex_count);
+
+// Bit identical to generate_mikkt_tangents.  Mikkt only ever averages across faces
+// whose corners have the exact same position, normal and uv, so faces are split into
+// the islands those corners connect and whole islands are packed into jobs of about
+// triangles_per_job, keeping their original face order.  The packing doesn't depend
+// on the thread count, and one big smooth island still ends up in a single job.
+void generate_mikkt_tangents_parallel(Vertex3* vertexes, uint vertex_count, uint triangles_per_job = DEFAULT_MIKKT_TRIANGLES_PER_JOB);
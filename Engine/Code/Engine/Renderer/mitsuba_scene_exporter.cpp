@@ -120,8 +120,8 @@ bool MitsubaSceneExporter::export_mesh_to_obj(RenderableMesh* rm, unsigned int i
 	// need to write out vertexes
 	// v x y z
 
-	for(unsigned int i = 0; i < rm->m_mesh->m_vertexes.size(); ++i){
-		Vertex3 vert = rm->m_mesh->m_vertexes[i];
+	for(unsigned int i = 0; i < rm->m_mesh->get_vertex_count(); ++i){
+		Vertex3 vert = rm->m_mesh->get_vertex_data()[i];
 		vert.m_position.x *= -1.0f;
 		char vout[64];
 		sprintf_s(vout, 64, "v %f %f %f\n", vert.m_position.x, vert.m_position.y, vert.m_position.z);
@@ -131,8 +131,8 @@ bool MitsubaSceneExporter::export_mesh_to_obj(RenderableMesh* rm, unsigned int i
 	// need to write out texture coords
 	// vt u v
 
-	for(unsigned int i = 0; i < rm->m_mesh->m_vertexes.size(); ++i){
-		Vertex3 vert = rm->m_mesh->m_vertexes[i];
+	for(unsigned int i = 0; i < rm->m_mesh->get_vertex_count(); ++i){
+		Vertex3 vert = rm->m_mesh->get_vertex_data()[i];
 		char vout[64];
 		sprintf_s(vout, 64, "vt %f %f\n", vert.m_texCoords.x, vert.m_texCoords.y);
 		fwrite(vout, 1, strlen(vout), obj_file);
@@ -141,8 +141,8 @@ bool MitsubaSceneExporter::export_mesh_to_obj(RenderableMesh* rm, unsigned int i
 	// need to write out vertex normals
 	// vn x y z
 
-	for(unsigned int i = 0; i < rm->m_mesh->m_vertexes.size(); ++i){
-		Vertex3 vert = rm->m_mesh->m_vertexes[i];
+	for(unsigned int i = 0; i < rm->m_mesh->get_vertex_count(); ++i){
+		Vertex3 vert = rm->m_mesh->get_vertex_data()[i];
 		vert.m_normal.x *= -1.0f;
 		char vout[64];
 		sprintf_s(vout, 64, "vn %f %f %f\n", vert.m_normal.x, vert.m_normal.y, vert.m_normal.z);
@@ -152,14 +152,14 @@ bool MitsubaSceneExporter::export_mesh_to_obj(RenderableMesh* rm, unsigned int i
 	// need to define faces
 	// f v/vt/vn v/vt/vn v/vt/vn
 
-	uint num_indexes = (uint)rm->m_mesh->m_indexes.size();
+	uint num_indexes = rm->m_mesh->get_index_count();
 
 	if(num_indexes > 0){
 		// use indexes to build faces
 		for(unsigned int i = 0; i < num_indexes; i++){
-			unsigned int v1 = rm->m_mesh->m_indexes[i++] + 1;
-			unsigned int v2 = rm->m_mesh->m_indexes[i++] + 1;
-			unsigned int v3 = rm->m_mesh->m_indexes[i] + 1;
+			unsigned int v1 = rm->m_mesh->get_index_data()[i++] + 1;
+			unsigned int v2 = rm->m_mesh->get_index_data()[i++] + 1;
+			unsigned int v3 = rm->m_mesh->get_index_data()[i] + 1;
 
 			char vout[64];
 			sprintf_s(vout, 64, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", v1, v1, v1, v2, v2, v2, v3, v3, v3);
@@ -167,7 +167,7 @@ bool MitsubaSceneExporter::export_mesh_to_obj(RenderableMesh* rm, unsigned int i
 		}
 	} else{
 		// assume the vertexes are in good order
-		for(unsigned int i = 0; i < rm->m_mesh->m_vertexes.size(); i++){
+		for(unsigned int i = 0; i < rm->m_mesh->get_vertex_count(); i++){
 			unsigned int v1 = i + 1;
 			i++;
 
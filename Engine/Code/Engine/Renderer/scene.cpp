@@ -13,10 +13,16 @@
 #include "Engine/Renderer/DirectionalLight.h"
 #include "Engine/Renderer/SpotLight.h"
 #include "Engine/Renderer/skybox.h"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
 
 #include "Engine/RHI/RHIInstance.hpp"
+#include "Engine/RHI/RHIOutput.hpp"
 #include "Engine/RHI/RHITexture2D.hpp"
 
+#include <string.h>
+
 Scene::Scene()
 	:m_camera(nullptr)
 	,m_skybox(nullptr)
@@ -25,7 +31,12 @@ Scene::Scene()
 	,m_wireframe_mode_enabled(false)
 	,m_ibl_cb(nullptr)
 	,m_pl_depth_cb(nullptr)
+	,m_lods_enabled(true)
+	,m_lod_max_pixel_error(1.0f)
+	,m_culling_enabled(true)
 {
+	cull_stats_reset(&m_cull_stats);
+	cull_stats_reset(&m_last_frame_cull_stats);
 	init_constant_buffers();
     m_camera = new Camera();
     m_camera->m_transform.set_world_position(Vector3(0.0f, 0.0f, -5.0f));
@@ -80,6 +91,12 @@ void Scene::render_skybox()
 
 void Scene::prerender()
 {
+	m_last_frame_cull_stats = m_cull_stats;
+	cull_stats_reset(&m_cull_stats);
+	update_bvh();
+	build_light_receivers();
+	select_mesh_lods();
+
 	setup_shadow_maps();
 	setup_punctual_lights();
 	setup_ibl();
@@ -103,16 +120,27 @@ void Scene::render()
 	render_debug();
 }
 
+// the light / cube face setup has just set its view and projection on the renderer
+static Frustum calc_current_view_frustum()
+{
+	return Frustum(g_theRenderer->m_matrixBufferData.view * g_theRenderer->m_matrixBufferData.projection);
+}
+
 void Scene::render_scene_geometry()
 {
-    for(unsigned int rmidx = 0; rmidx < m_renderable_meshes.size(); ++rmidx){
-        RenderableMesh* rm = m_renderable_meshes[rmidx];
+	draw_scene_geometry(cull_renderable_meshes(calc_current_view_frustum()));
+}
+
+void Scene::draw_scene_geometry(const std::vector<RenderableMesh*>& meshes)
+{
+    for(unsigned int rmidx = 0; rmidx < meshes.size(); ++rmidx){
+        RenderableMesh* rm = meshes[rmidx];
         if(nullptr == rm){
             continue;
         }
 
 		g_theRenderer->SetModel(rm->m_transform.calc_world_matrix());
-		g_theRenderer->draw_mesh(rm->m_mesh);
+		g_theRenderer->draw_mesh(rm->m_mesh, rm->m_lod);
     }
 }
 
@@ -236,6 +264,133 @@ void Scene::toggle_wireframe_mode()
 	enable_wireframe_mode(!m_wireframe_mode_enabled);
 }
 
+void Scene::set_culling_enabled(bool enabled)
+{
+	m_culling_enabled = enabled;
+}
+
+void Scene::toggle_culling()
+{
+	set_culling_enabled(!m_culling_enabled);
+}
+
+void Scene::set_lods_enabled(bool enabled)
+{
+	m_lods_enabled = enabled;
+}
+
+void Scene::toggle_lods()
+{
+	set_lods_enabled(!m_lods_enabled);
+}
+
+void Scene::select_mesh_lods()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(!m_lods_enabled){
+		for(RenderableMesh* rm : m_renderable_meshes){
+			rm->m_lod = 0;
+		}
+		return;
+	}
+
+	float viewport_height = (float)g_theRenderer->m_output->GetHeight();
+	float projection_scale = viewport_height / (2.0f * TanDegrees(m_camera->m_fov * 0.5f));
+	Vector3 camera_position = m_camera->get_world_position();
+
+	for(RenderableMesh* rm : m_renderable_meshes){
+		rm->select_lod(camera_position, projection_scale, m_lod_max_pixel_error);
+	}
+}
+
+const std::vector<RenderableMesh*>& Scene::cull_renderable_meshes(const Frustum& frustum)
+{
+	if(!m_culling_enabled){
+		return m_renderable_meshes;
+	}
+
+	m_bvh.query_frustum(frustum, &m_query_items);
+
+	m_visible_meshes.clear();
+	for(uint item : m_query_items){
+		if(nullptr != m_bvh_meshes[item]){
+			m_visible_meshes.push_back(m_bvh_meshes[item]);
+		}
+	}
+
+	cull_stats_record(&m_cull_stats, (uint)m_bvh_meshes.size(), (uint)m_visible_meshes.size());
+	return m_visible_meshes;
+}
+
+void Scene::update_bvh()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(m_bvh_meshes != m_renderable_meshes){
+		rebuild_bvh();
+		return;
+	}
+
+	// world bounds are cached per mesh, so only the ones that actually moved walk up the tree
+	uint num_moved = 0;
+	for(uint item = 0; item < (uint)m_bvh_meshes.size(); ++item){
+		RenderableMesh* rm = m_bvh_meshes[item];
+		if(nullptr == rm){
+			continue;
+		}
+
+		const AABB3& bounds = rm->get_world_bounds();
+		if(memcmp(&bounds, &m_bvh.m_item_bounds[item], sizeof(AABB3)) != 0){
+			m_bvh.refit_item(item, bounds);
+			num_moved++;
+		}
+	}
+
+	if(num_moved > 0 && m_bvh.needs_rebuild()){
+		rebuild_bvh();
+	}
+}
+
+void Scene::rebuild_bvh()
+{
+	m_bvh_meshes = m_renderable_meshes;
+
+	std::vector<AABB3> bounds(m_bvh_meshes.size(), AABB3(Vector3::ZERO, Vector3::ZERO));
+	for(size_t item = 0; item < m_bvh_meshes.size(); ++item){
+		if(nullptr != m_bvh_meshes[item]){
+			bounds[item] = m_bvh_meshes[item]->get_world_bounds();
+		}
+	}
+
+	m_bvh.build_parallel(bounds.data(), (uint)bounds.size());
+}
+
+void Scene::query_renderable_meshes_in_sphere(const Vector3& center, float radius, std::vector<RenderableMesh*>* out_meshes)
+{
+	m_bvh.query_sphere(center, radius, &m_query_items);
+
+	out_meshes->clear();
+	for(uint item : m_query_items){
+		if(nullptr != m_bvh_meshes[item]){
+			out_meshes->push_back(m_bvh_meshes[item]);
+		}
+	}
+}
+
+RenderableMesh* Scene::raycast_renderable_meshes(const Vector3& start, const Vector3& direction, float max_distance, bvh_ray_hit_t* out_hit)
+{
+	bvh_ray_hit_t hit;
+	if(!m_bvh.raycast(start, direction, max_distance, &hit)){
+		return nullptr;
+	}
+
+	if(nullptr != out_hit){
+		*out_hit = hit;
+	}
+	return m_bvh_meshes[hit.item];
+}
+
 void Scene::setup_shadow_maps()
 {
 	compute_directional_light_shadows();
@@ -274,8 +429,19 @@ void Scene::compute_spot_light_shadows()
 			continue;
 		}
 
+		if(m_culling_enabled && m_spot_light_receivers[sl_idx].empty()){
+			continue;
+		}
+
 		sl->setup_depth_write(); // set the light view, light projection, bind the light dsv
-		render_scene_geometry();
+		if(m_culling_enabled){
+			// the receivers are already cone tested, so every one of them gets drawn
+			uint num_receivers = (uint)m_spot_light_receivers[sl_idx].size();
+			cull_stats_record(&m_cull_stats, num_receivers, num_receivers);
+			draw_scene_geometry(m_spot_light_receivers[sl_idx]);
+		}else{
+			draw_scene_geometry(m_renderable_meshes);
+		}
 	}
 }
 
@@ -292,6 +458,14 @@ void Scene::compute_point_light_shadows()
 			continue;
 		}
 
+		// nothing outside the light's far cutoff can land in its depth cube
+		if(m_culling_enabled){
+			if(m_point_light_receivers[pl_idx].empty()){
+				continue;
+			}
+			m_culler.gather(m_point_light_receivers[pl_idx]);
+		}
+
 		for(uint face = 0; face < NUM_CUBE_FACES; ++face){
 			pl->setup_depth_write(face);
 
@@ -299,24 +473,67 @@ void Scene::compute_point_light_shadows()
 			m_pl_depth_info.far_plane = pl->m_far_cutoff;
 			m_pl_depth_cb->Update(g_theRenderer->m_deviceContext, &m_pl_depth_info);
 
-			render_scene_geometry();
+			if(m_culling_enabled){
+				m_culler.cull(calc_current_view_frustum(), &m_visible_meshes);
+				// each face only tests the receivers gathered above
+				cull_stats_record(&m_cull_stats, (uint)m_point_light_receivers[pl_idx].size(), (uint)m_visible_meshes.size());
+				draw_scene_geometry(m_visible_meshes);
+			}else{
+				draw_scene_geometry(m_renderable_meshes);
+			}
 		}
 	}
 }
 
 void Scene::setup_punctual_lights()
 {
-    for(unsigned int plidx = 0; plidx < m_point_lights.size(); plidx++){
+	// the fixed light slots are still used by the non clustered shaders
+    for(unsigned int plidx = 0; plidx < m_point_lights.size() && plidx < MAX_POINT_LIGHTS; plidx++){
         g_theRenderer->SetPointLight(plidx, m_point_lights[plidx]);
     }
 
-    for(unsigned int slidx = 0; slidx < m_spot_lights.size(); slidx++){
+    for(unsigned int slidx = 0; slidx < m_spot_lights.size() && slidx < MAX_SPOT_LIGHTS; slidx++){
         g_theRenderer->SetSpotLight(slidx, m_spot_lights[slidx]);
     }
 
     for(unsigned int dlidx = 0; dlidx < m_directional_lights.size(); dlidx++){
         g_theRenderer->SetDirectionalLight(dlidx, m_directional_lights[dlidx]);
     }
+
+	m_light_grid.build(make_light_cluster_view(m_camera), m_point_lights, m_spot_lights);
+	m_light_grid.upload(g_theRenderer->m_ssaa_render_target->GetWidth(), g_theRenderer->m_ssaa_render_target->GetHeight());
+	m_light_grid.bind();
+}
+
+void Scene::build_light_receivers()
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if(!m_culling_enabled){
+		return;
+	}
+
+	m_point_light_receivers.resize(m_point_lights.size());
+	for(size_t pl_idx = 0; pl_idx < m_point_lights.size(); ++pl_idx){
+		PointLight* pl = m_point_lights[pl_idx];
+		query_renderable_meshes_in_sphere(pl->m_position, pl->m_far_cutoff, &m_point_light_receivers[pl_idx]);
+	}
+
+	// the bvh narrows it down to the cone's bounding sphere, then each mesh is tested against the cone
+	m_spot_light_receivers.resize(m_spot_lights.size());
+	for(size_t sl_idx = 0; sl_idx < m_spot_lights.size(); ++sl_idx){
+		SpotLight* sl = m_spot_lights[sl_idx];
+		light_bounds_t bounds = calc_spot_light_bounds(sl);
+		query_renderable_meshes_in_sphere(bounds.center, bounds.radius, &m_light_meshes);
+
+		std::vector<RenderableMesh*>& receivers = m_spot_light_receivers[sl_idx];
+		receivers.clear();
+		for(RenderableMesh* rm : m_light_meshes){
+			if(does_spot_light_touch_aabb3(sl, rm->get_world_bounds())){
+				receivers.push_back(rm);
+			}
+		}
+	}
 }
 
 void Scene::setup_ibl()
@@ -338,9 +555,11 @@ void Scene::render_renderable_meshes()
 	g_theRenderer->set_camera(m_camera);
 	g_theRenderer->EnableDepth(true, true);
 
+	const std::vector<RenderableMesh*>& meshes = cull_renderable_meshes(m_camera->get_frustum());
+
     //draw each renderable mesh
-    for(unsigned int rmidx = 0; rmidx < m_renderable_meshes.size(); ++rmidx){
-        RenderableMesh* rm = m_renderable_meshes[rmidx];
+    for(unsigned int rmidx = 0; rmidx < meshes.size(); ++rmidx){
+        RenderableMesh* rm = meshes[rmidx];
         if(nullptr == rm){
             continue;
         }
@@ -382,4 +601,32 @@ void Scene::render_debug()
         g_theRenderer->DebugDrawCross3d(sl->m_position, Rgba::YELLOW, 0.5f);
 		g_theRenderer->DebugDrawLine3d(sl->m_position, sl->m_direction, 2.5f, 1.0f, Rgba::PINK, Rgba::PINK);
     }
-}
\ No newline at end of file
+}
+
+COMMAND(toggle_culling, "Toggles frustum culling of the current scene")
+{
+	Scene* scene = g_theRenderer->get_current_scene();
+	if(nullptr == scene){
+		console_warning("No scene set");
+		return;
+	}
+
+	scene->toggle_culling();
+	console_info("Frustum culling %s", scene->m_culling_enabled ? "enabled" : "disabled");
+}
+
+COMMAND(cull_stats, "Prints last frame's frustum culling stats for the current scene")
+{
+	Scene* scene = g_theRenderer->get_current_scene();
+	if(nullptr == scene){
+		console_warning("No scene set");
+		return;
+	}
+
+	const cull_stats_t& stats = scene->m_last_frame_cull_stats;
+	console_info("----Cull Stats (%s)----", scene->m_culling_enabled ? "enabled" : "disabled");
+	console_info("views:   %u", stats.num_views);
+	console_info("tested:  %u", stats.num_tested);
+	console_info("visible: %u", stats.num_visible);
+	console_info("culled:  %u", stats.num_culled);
+}
@@ -3,6 +3,9 @@
 #include "Engine/Math/Vector3.hpp"
 #include "Engine/Core/Rgba.hpp"
 #include "Engine/Renderer/Material.hpp"
+#include "Engine/Renderer/frustum_culler.h"
+#include "Engine/Math/BVH.hpp"
+#include "Engine/Renderer/light_culling.h"
 
 class RenderableMesh;
 class RHITexture2D;
@@ -50,6 +53,29 @@ class Scene
         bool m_debug_mode;
 		bool m_wireframe_mode_enabled;
 
+		// refit (or rebuilt) once in prerender, then every view and light queries it
+		BVH m_bvh;
+		std::vector<RenderableMesh*> m_bvh_meshes;
+		std::vector<uint> m_query_items;
+
+		// meshes each light can reach, shadow passes only draw these
+		std::vector<std::vector<RenderableMesh*>> m_point_light_receivers;
+		std::vector<std::vector<RenderableMesh*>> m_spot_light_receivers;
+		std::vector<RenderableMesh*> m_light_meshes;
+
+		// point light receivers are culled again per cube face
+		FrustumCuller m_culler;
+		std::vector<RenderableMesh*> m_visible_meshes;
+
+		// meshes with lods draw the coarsest level that stays within this many pixels of the base
+		bool m_lods_enabled;
+		float m_lod_max_pixel_error;
+
+		LightClusterGrid m_light_grid;
+		bool m_culling_enabled;
+		cull_stats_t m_cull_stats;
+		cull_stats_t m_last_frame_cull_stats;
+
     public:
         Scene();
         ~Scene();
@@ -60,6 +86,7 @@ class Scene
 		void prerender();
         void render();
 		void render_scene_geometry();
+		void draw_scene_geometry(const std::vector<RenderableMesh*>& meshes);
 
         bool export_mit(const char* filename);
 
@@ -92,6 +119,22 @@ class Scene
 		void render_renderable_meshes();
 		void render_debug();
 
+		void set_culling_enabled(bool enabled);
+		void toggle_culling();
+		const std::vector<RenderableMesh*>& cull_renderable_meshes(const Frustum& frustum);
+
+		// picked once from the main camera, shadow passes draw the same levels
+		void set_lods_enabled(bool enabled);
+		void toggle_lods();
+		void select_mesh_lods();
+
+		// spatial queries, valid after prerender has updated the bvh for this frame
+		void update_bvh();
+		void rebuild_bvh();
+		void build_light_receivers();
+		void query_renderable_meshes_in_sphere(const Vector3& center, float radius, std::vector<RenderableMesh*>* out_meshes);
+		RenderableMesh* raycast_renderable_meshes(const Vector3& start, const Vector3& direction, float max_distance, bvh_ray_hit_t* out_hit = nullptr);
+
 		void compute_directional_light_shadows();
 		void compute_spot_light_shadows();
 		void compute_point_light_shadows();
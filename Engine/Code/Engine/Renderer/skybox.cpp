@@ -30,10 +30,12 @@ SkyBox::~SkyBox()
 	delete m_diffuse_integrated_target;
 	delete m_diffuse_depth_target;
 
-	for(uint i = 0; i < m_spec_integrated_target->get_num_mip_levels(); i++){
-		delete m_spec_depth_targets[i];
+	if(nullptr != m_spec_depth_targets){
+		for(uint i = 0; i < m_spec_integrated_target->get_num_mip_levels(); i++){
+			delete m_spec_depth_targets[i];
+		}
+		delete[] m_spec_depth_targets;
 	}
-	delete[] m_spec_depth_targets;
 
 	delete m_spec_integrated_target;
 }
@@ -44,6 +46,23 @@ bool SkyBox::load_from_face_images(RHIDevice* device, CubeMapImagePaths cubeMapI
 	return true;
 }
 
+bool SkyBox::load_baked_lighting(RHIDevice* device, const char* spec_filename, const char* diffuse_filename)
+{
+	CubeMap* spec = new CubeMap();
+	CubeMap* diffuse = new CubeMap();
+	if(!spec->load_from_texture_file(device, spec_filename) || !diffuse->load_from_texture_file(device, diffuse_filename)){
+		SAFE_DELETE(spec);
+		SAFE_DELETE(diffuse);
+		return false;
+	}
+
+	SAFE_DELETE(m_spec_integrated_target);
+	SAFE_DELETE(m_diffuse_integrated_target);
+	m_spec_integrated_target = spec;
+	m_diffuse_integrated_target = diffuse;
+	return true;
+}
+
 void SkyBox::bake_lighting(uint diffuse_res, uint spec_res)
 {
 	integrate_diffuse(diffuse_res);
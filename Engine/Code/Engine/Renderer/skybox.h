@@ -32,6 +32,9 @@ class SkyBox
 
 	bool load_from_face_images(RHIDevice* device, CubeMapImagePaths cubeMapImages);
 
+	// cubes bake_ibl wrote offline, in place of bake_lighting
+	bool load_baked_lighting(RHIDevice* device, const char* spec_filename, const char* diffuse_filename);
+
 	void bake_lighting(uint diffuse_res, uint spec_res);
 	void integrate_diffuse(uint diffuse_res);
 	void integrate_spec(uint spec_res);
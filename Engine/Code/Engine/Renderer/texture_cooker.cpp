@@ -0,0 +1,1369 @@
+#include "Engine/Renderer/texture_cooker.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/image_ops.h"
+#include "Engine/Core/job.h"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+#include "ThirdParty/stb/stb_image.h"
+
+#include <emmintrin.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <ctype.h>
+
+// refits of the endpoints to the indexes they picked, each only kept if it lowers the error
+#define BC1_REFINE_ITERATIONS (2)
+#define BC7_REFINE_ITERATIONS (2)
+
+texture_cook_options_t::texture_cook_options_t()
+	:kind(TEXTURE_COOK_KIND_COLOR)
+	,format(NUM_TEXTURE_FILE_FORMATS)
+	,generate_mips(true)
+	,block_rows_per_job(DEFAULT_TEXTURE_COOK_BLOCK_ROWS_PER_JOB)
+{
+}
+
+static std::string to_lower_case(const std::string& text)
+{
+	std::string lower = text;
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](char c){ return (char)tolower((unsigned char)c); });
+	return lower;
+}
+
+template<size_t TAG_COUNT>
+static bool contains_any(const std::string& text, const char* const (&tags)[TAG_COUNT])
+{
+	for(size_t tag_idx = 0; tag_idx < TAG_COUNT; ++tag_idx){
+		if(text.find(tags[tag_idx]) != std::string::npos){
+			return true;
+		}
+	}
+	return false;
+}
+
+TextureCookKind guess_texture_cook_kind(const std::string& filename)
+{
+	size_t slash = filename.find_last_of("/\\");
+	std::string name = to_lower_case((slash == std::string::npos) ? filename : filename.substr(slash + 1));
+
+	static const char* NORMAL_MAP_TAGS[] = { "normal", "_nrm", "_nor.", "_n." };
+	static const char* MASK_TAGS[] = { "rough", "smooth", "gloss", "metal", "_ao", "occlusion", "height", "bump", "disp", "_s.", "_m.", "_r." };
+	static const char* LINEAR_TAGS[] = { "spec" };
+
+	if(contains_any(name, NORMAL_MAP_TAGS)){
+		return TEXTURE_COOK_KIND_NORMAL_MAP;
+	}
+	if(contains_any(name, MASK_TAGS)){
+		return TEXTURE_COOK_KIND_MASK;
+	}
+	if(contains_any(name, LINEAR_TAGS)){
+		return TEXTURE_COOK_KIND_LINEAR;
+	}
+	return TEXTURE_COOK_KIND_COLOR;
+}
+
+TextureFileFormat get_default_texture_file_format(TextureCookKind kind)
+{
+	switch(kind){
+		case TEXTURE_COOK_KIND_MASK:		return TEXTURE_FILE_FORMAT_BC4;
+		case TEXTURE_COOK_KIND_NORMAL_MAP:	return TEXTURE_FILE_FORMAT_BC5;
+		default:							return TEXTURE_FILE_FORMAT_BC7;
+	}
+}
+
+const char* get_texture_cook_kind_name(TextureCookKind kind)
+{
+	switch(kind){
+		case TEXTURE_COOK_KIND_COLOR:		return "color";
+		case TEXTURE_COOK_KIND_LINEAR:		return "linear";
+		case TEXTURE_COOK_KIND_MASK:		return "mask";
+		case TEXTURE_COOK_KIND_NORMAL_MAP:	return "normal";
+		default:							return "unknown";
+	}
+}
+
+//-----------------------------------------------------
+// Helpers
+static byte unorm_to_byte(float value)
+{
+	return (byte)((Clamp(value, 0.0f, 1.0f) * 255.0f) + 0.5f);
+}
+
+//-----------------------------------------------------
+// Mips
+static void texels_to_float(const byte* rgba, size_t texel_count, TextureCookKind kind, float* out_texels)
+{
+	for(size_t texel_idx = 0; texel_idx < texel_count; ++texel_idx){
+		const byte* texel = rgba + (texel_idx * 4);
+		float* out_texel = out_texels + (texel_idx * 4);
+
+		for(uint channel = 0; channel < 3; ++channel){
+			switch(kind){
+				case TEXTURE_COOK_KIND_COLOR:		out_texel[channel] = decode_srgb_byte(texel[channel]); break;
+				case TEXTURE_COOK_KIND_NORMAL_MAP:	out_texel[channel] = ((float)texel[channel] * (2.0f / 255.0f)) - 1.0f; break;
+				default:							out_texel[channel] = (float)texel[channel] / 255.0f; break;
+			}
+		}
+		out_texel[3] = (float)texel[3] / 255.0f;
+	}
+}
+
+// normals are only renormalized on the way out, the mip below is filtered from the
+// unnormalized average so every mip is a true box filter of the top one
+static void quantize_texel(const float* texel, TextureCookKind kind, byte* out_texel)
+{
+	switch(kind){
+		case TEXTURE_COOK_KIND_COLOR:{
+			for(uint channel = 0; channel < 3; ++channel){
+				out_texel[channel] = encode_srgb_byte(texel[channel]);
+			}
+		} break;
+
+		case TEXTURE_COOK_KIND_NORMAL_MAP:{
+			float length = sqrtf((texel[0] * texel[0]) + (texel[1] * texel[1]) + (texel[2] * texel[2]));
+			float normal[3] = { 0.0f, 0.0f, 1.0f };
+			if(length > 1e-6f){
+				normal[0] = texel[0] / length;
+				normal[1] = texel[1] / length;
+				normal[2] = texel[2] / length;
+			}
+			for(uint channel = 0; channel < 3; ++channel){
+				out_texel[channel] = unorm_to_byte((normal[channel] * 0.5f) + 0.5f);
+			}
+		} break;
+
+		default:{
+			for(uint channel = 0; channel < 3; ++channel){
+				out_texel[channel] = unorm_to_byte(texel[channel]);
+			}
+		} break;
+	}
+	out_texel[3] = unorm_to_byte(texel[3]);
+}
+
+// The source texels one mip texel covers and how much of each, exact in integer
+// units of 1 / (src_size * dst_size).  Halving never covers more than 3 source texels
+struct mip_filter_taps_t
+{
+	uint first;
+	uint count;
+	float weights[3];
+};
+
+static void build_mip_filter_taps(uint src_size, uint dst_size, std::vector<mip_filter_taps_t>* out_taps)
+{
+	out_taps->resize(dst_size);
+	for(uint dst_idx = 0; dst_idx < dst_size; ++dst_idx){
+		u64 start = (u64)dst_idx * src_size;
+		u64 end = start + src_size;
+
+		mip_filter_taps_t& taps = (*out_taps)[dst_idx];
+		taps.first = (uint)(start / dst_size);
+		taps.count = 0;
+		for(uint src_idx = taps.first; ((u64)src_idx * dst_size < end) && (taps.count < 3); ++src_idx){
+			u64 src_start = (u64)src_idx * dst_size;
+			u64 overlap = Min(end, src_start + dst_size) - Max(start, src_start);
+			taps.weights[taps.count++] = (float)overlap / (float)src_size;
+		}
+	}
+}
+
+struct mip_downsample_t
+{
+	const float* src;
+	uint src_width;
+	float* dst;
+	uint dst_width;
+	byte* out_texels;
+	TextureCookKind kind;
+	const mip_filter_taps_t* x_taps;
+	const mip_filter_taps_t* y_taps;
+};
+
+static void downsample_mip_rows(const mip_downsample_t* downsample, uint first_row, uint end_row)
+{
+	for(uint y = first_row; y < end_row; ++y){
+		const mip_filter_taps_t& y_taps = downsample->y_taps[y];
+
+		for(uint x = 0; x < downsample->dst_width; ++x){
+			const mip_filter_taps_t& x_taps = downsample->x_taps[x];
+
+			// a texel's four channels go through the lanes together
+			__m128 sum = _mm_setzero_ps();
+			for(uint y_tap = 0; y_tap < y_taps.count; ++y_tap){
+				const float* src_row = downsample->src + ((size_t)(y_taps.first + y_tap) * downsample->src_width * 4);
+
+				__m128 row_sum = _mm_setzero_ps();
+				for(uint x_tap = 0; x_tap < x_taps.count; ++x_tap){
+					__m128 texel = _mm_loadu_ps(src_row + ((size_t)(x_taps.first + x_tap) * 4));
+					row_sum = _mm_add_ps(row_sum, _mm_mul_ps(texel, _mm_set1_ps(x_taps.weights[x_tap])));
+				}
+				sum = _mm_add_ps(sum, _mm_mul_ps(row_sum, _mm_set1_ps(y_taps.weights[y_tap])));
+			}
+
+			size_t texel_idx = ((size_t)y * downsample->dst_width) + x;
+			float* dst_texel = downsample->dst + (texel_idx * 4);
+			_mm_storeu_ps(dst_texel, sum);
+			quantize_texel(dst_texel, downsample->kind, downsample->out_texels + (texel_idx * 4));
+		}
+	}
+}
+
+void generate_mip_chain(const byte* rgba, uint width, uint height, TextureCookKind kind, std::vector<texture_mip_t>* out_mips)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	uint mip_count = calc_full_mip_count(width, height);
+	out_mips->clear();
+	out_mips->resize(mip_count);
+
+	size_t texel_count = (size_t)width * height;
+	texture_mip_t& top_mip = (*out_mips)[0];
+	top_mip.width = width;
+	top_mip.height = height;
+	top_mip.texels.assign(rgba, rgba + (texel_count * 4));
+
+	std::vector<float> src_texels(texel_count * 4);
+	std::vector<float> dst_texels;
+	texels_to_float(rgba, texel_count, kind, src_texels.data());
+
+	std::vector<mip_filter_taps_t> x_taps;
+	std::vector<mip_filter_taps_t> y_taps;
+	std::vector<Job*> jobs;
+	for(uint mip_idx = 1; mip_idx < mip_count; ++mip_idx){
+		const texture_mip_t& src_mip = (*out_mips)[mip_idx - 1];
+		texture_mip_t& mip = (*out_mips)[mip_idx];
+		mip.width = Max(1U, width >> mip_idx);
+		mip.height = Max(1U, height >> mip_idx);
+		mip.texels.resize((size_t)mip.width * mip.height * 4);
+		dst_texels.resize((size_t)mip.width * mip.height * 4);
+
+		build_mip_filter_taps(src_mip.width, mip.width, &x_taps);
+		build_mip_filter_taps(src_mip.height, mip.height, &y_taps);
+
+		mip_downsample_t downsample;
+		downsample.src = src_texels.data();
+		downsample.src_width = src_mip.width;
+		downsample.dst = dst_texels.data();
+		downsample.dst_width = mip.width;
+		downsample.out_texels = mip.texels.data();
+		downsample.kind = kind;
+		downsample.x_taps = x_taps.data();
+		downsample.y_taps = y_taps.data();
+
+		// the small end of the chain isn't worth a job
+		if(mip.height <= DEFAULT_TEXTURE_COOK_MIP_ROWS_PER_JOB){
+			downsample_mip_rows(&downsample, 0, mip.height);
+		}else{
+			jobs.clear();
+			for(uint first_row = 0; first_row < mip.height; first_row += DEFAULT_TEXTURE_COOK_MIP_ROWS_PER_JOB){
+				uint end_row = Min(first_row + DEFAULT_TEXTURE_COOK_MIP_ROWS_PER_JOB, mip.height);
+				Job* job = job_create(JOB_TYPE_GENERIC, downsample_mip_rows, (const mip_downsample_t*)&downsample, first_row, end_row);
+				job_dispatch(job);
+				jobs.push_back(job);
+			}
+			for(Job* job : jobs){
+				job_wait_and_release(job);
+			}
+		}
+
+		src_texels.swap(dst_texels);
+	}
+}
+
+//-----------------------------------------------------
+// Block helpers
+static float horizontal_sum(__m128 value)
+{
+	__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(value, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	sums = _mm_add_ss(sums, shuffled);
+	return _mm_cvtss_f32(sums);
+}
+
+static void load_float_block(const byte* rgba_block, float texels[16][4])
+{
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		for(uint channel = 0; channel < 4; ++channel){
+			texels[texel_idx][channel] = (float)rgba_block[(texel_idx * 4) + channel];
+		}
+	}
+}
+
+// mean and covariance of the first channel_count channels
+static void calc_block_covariance(const float texels[16][4], uint channel_count, float* out_mean, float out_covariance[4][4])
+{
+	__m128 sum = _mm_setzero_ps();
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		sum = _mm_add_ps(sum, _mm_loadu_ps(texels[texel_idx]));
+	}
+	__m128 mean = _mm_mul_ps(sum, _mm_set1_ps(1.0f / 16.0f));
+
+	__m128 products[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		__m128 offset = _mm_sub_ps(_mm_loadu_ps(texels[texel_idx]), mean);
+		float offsets[4];
+		_mm_storeu_ps(offsets, offset);
+		for(uint row = 0; row < channel_count; ++row){
+			products[row] = _mm_add_ps(products[row], _mm_mul_ps(offset, _mm_set1_ps(offsets[row])));
+		}
+	}
+
+	float means[4];
+	_mm_storeu_ps(means, mean);
+	for(uint row = 0; row < channel_count; ++row){
+		out_mean[row] = means[row];
+
+		float row_products[4];
+		_mm_storeu_ps(row_products, products[row]);
+		for(uint column = 0; column < channel_count; ++column){
+			out_covariance[row][column] = row_products[column];
+		}
+	}
+}
+
+// power iteration, a handful of steps is plenty for 16 texels.  false for a flat block
+static bool calc_principal_axis(const float covariance[4][4], uint channel_count, float* out_axis)
+{
+	// start from the row with the most variance so blocks that vary along one channel are done at once
+	uint start_row = 0;
+	for(uint row = 1; row < channel_count; ++row){
+		if(covariance[row][row] > covariance[start_row][start_row]){
+			start_row = row;
+		}
+	}
+	if(covariance[start_row][start_row] < 1e-4f){
+		return false;
+	}
+
+	float axis[4];
+	for(uint channel = 0; channel < channel_count; ++channel){
+		axis[channel] = covariance[start_row][channel];
+	}
+
+	for(uint iteration = 0; iteration < 8; ++iteration){
+		float next[4];
+		float largest = 0.0f;
+		for(uint row = 0; row < channel_count; ++row){
+			next[row] = 0.0f;
+			for(uint column = 0; column < channel_count; ++column){
+				next[row] += covariance[row][column] * axis[column];
+			}
+			largest = Max(largest, fabsf(next[row]));
+		}
+		if(largest < 1e-8f){
+			return false;
+		}
+		for(uint channel = 0; channel < channel_count; ++channel){
+			axis[channel] = next[channel] / largest;
+		}
+	}
+
+	float length_squared = 0.0f;
+	for(uint channel = 0; channel < channel_count; ++channel){
+		length_squared += axis[channel] * axis[channel];
+	}
+	float inv_length = 1.0f / sqrtf(length_squared);
+	for(uint channel = 0; channel < channel_count; ++channel){
+		out_axis[channel] = axis[channel] * inv_length;
+	}
+	return true;
+}
+
+// ends of the principal axis through the block, clipped to its texels' extent along it
+static void calc_axis_endpoints(const float texels[16][4], uint channel_count, float* out_end0, float* out_end1)
+{
+	float mean[4];
+	float covariance[4][4];
+	calc_block_covariance(texels, channel_count, mean, covariance);
+
+	float axis[4];
+	if(!calc_principal_axis(covariance, channel_count, axis)){
+		for(uint channel = 0; channel < channel_count; ++channel){
+			out_end0[channel] = mean[channel];
+			out_end1[channel] = mean[channel];
+		}
+		return;
+	}
+
+	float min_projection = FLT_MAX;
+	float max_projection = -FLT_MAX;
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		float projection = 0.0f;
+		for(uint channel = 0; channel < channel_count; ++channel){
+			projection += (texels[texel_idx][channel] - mean[channel]) * axis[channel];
+		}
+		min_projection = Min(min_projection, projection);
+		max_projection = Max(max_projection, projection);
+	}
+
+	for(uint channel = 0; channel < channel_count; ++channel){
+		out_end0[channel] = Clamp(mean[channel] + (axis[channel] * max_projection), 0.0f, 255.0f);
+		out_end1[channel] = Clamp(mean[channel] + (axis[channel] * min_projection), 0.0f, 255.0f);
+	}
+}
+
+// Least squares endpoints for fixed indexes, index_weights is how much of end0 each
+// index takes.  false when every texel picked the same weight and there's nothing to solve
+static bool fit_endpoints(const float texels[16][4], uint channel_count, const uint* indexes, const float* index_weights, float* out_end0, float* out_end1)
+{
+	float aa = 0.0f;
+	float ab = 0.0f;
+	float bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		float a = index_weights[indexes[texel_idx]];
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for(uint channel = 0; channel < channel_count; ++channel){
+			ax[channel] += a * texels[texel_idx][channel];
+			bx[channel] += b * texels[texel_idx][channel];
+		}
+	}
+
+	float determinant = (aa * bb) - (ab * ab);
+	if(fabsf(determinant) < 1e-6f){
+		return false;
+	}
+
+	float inv_determinant = 1.0f / determinant;
+	for(uint channel = 0; channel < channel_count; ++channel){
+		out_end0[channel] = Clamp(((bb * ax[channel]) - (ab * bx[channel])) * inv_determinant, 0.0f, 255.0f);
+		out_end1[channel] = Clamp(((aa * bx[channel]) - (ab * ax[channel])) * inv_determinant, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+class block_bit_writer_t
+{
+public:
+	byte* m_block;
+	uint m_bit;
+
+	block_bit_writer_t(byte* block, uint block_size)
+		:m_block(block)
+		,m_bit(0)
+	{
+		memset(m_block, 0, block_size);
+	}
+
+	void write(u32 value, uint bit_count)
+	{
+		for(uint bit_idx = 0; bit_idx < bit_count; ++bit_idx, ++m_bit){
+			if((value >> bit_idx) & 1){
+				m_block[m_bit >> 3] |= (byte)(1 << (m_bit & 7));
+			}
+		}
+	}
+};
+
+class block_bit_reader_t
+{
+public:
+	const byte* m_block;
+	uint m_bit;
+
+	block_bit_reader_t(const byte* block)
+		:m_block(block)
+		,m_bit(0)
+	{
+	}
+
+	u32 read(uint bit_count)
+	{
+		u32 value = 0;
+		for(uint bit_idx = 0; bit_idx < bit_count; ++bit_idx, ++m_bit){
+			value |= (u32)((m_block[m_bit >> 3] >> (m_bit & 7)) & 1) << bit_idx;
+		}
+		return value;
+	}
+};
+
+//-----------------------------------------------------
+// BC1
+static const float BC1_INDEX_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+static u16 pack_565(const float* color)
+{
+	u32 r = (u32)((Clamp(color[0], 0.0f, 255.0f) * (31.0f / 255.0f)) + 0.5f);
+	u32 g = (u32)((Clamp(color[1], 0.0f, 255.0f) * (63.0f / 255.0f)) + 0.5f);
+	u32 b = (u32)((Clamp(color[2], 0.0f, 255.0f) * (31.0f / 255.0f)) + 0.5f);
+	return (u16)((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(u16 color, int* out_color)
+{
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	out_color[0] = (r << 3) | (r >> 2);
+	out_color[1] = (g << 2) | (g >> 4);
+	out_color[2] = (b << 3) | (b >> 2);
+}
+
+// texels are split into rows of 4 so each channel of a row sits in one register
+struct bc1_block_t
+{
+	__m128 r[4];
+	__m128 g[4];
+	__m128 b[4];
+};
+
+static void load_bc1_block(const float texels[16][4], bc1_block_t* out_block)
+{
+	for(uint row = 0; row < 4; ++row){
+		const float* texel = texels[row * 4];
+		out_block->r[row] = _mm_setr_ps(texel[0], texel[4], texel[8], texel[12]);
+		out_block->g[row] = _mm_setr_ps(texel[1], texel[5], texel[9], texel[13]);
+		out_block->b[row] = _mm_setr_ps(texel[2], texel[6], texel[10], texel[14]);
+	}
+}
+
+// nearest of the 4 colours per texel, returns the summed squared error
+static float select_bc1_indexes(const bc1_block_t& block, u16 color0, u16 color1, uint* out_indexes)
+{
+	int end0[3];
+	int end1[3];
+	unpack_565(color0, end0);
+	unpack_565(color1, end1);
+
+	float palette[4][3];
+	for(uint channel = 0; channel < 3; ++channel){
+		palette[0][channel] = (float)end0[channel];
+		palette[1][channel] = (float)end1[channel];
+		palette[2][channel] = (float)((2 * end0[channel]) + end1[channel]) / 3.0f;
+		palette[3][channel] = (float)(end0[channel] + (2 * end1[channel])) / 3.0f;
+	}
+
+	float total_error = 0.0f;
+	for(uint row = 0; row < 4; ++row){
+		__m128 best_error = _mm_set1_ps(FLT_MAX);
+		__m128 best_index = _mm_setzero_ps();
+
+		for(uint entry = 0; entry < 4; ++entry){
+			__m128 dr = _mm_sub_ps(block.r[row], _mm_set1_ps(palette[entry][0]));
+			__m128 dg = _mm_sub_ps(block.g[row], _mm_set1_ps(palette[entry][1]));
+			__m128 db = _mm_sub_ps(block.b[row], _mm_set1_ps(palette[entry][2]));
+			__m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+			__m128 is_better = _mm_cmplt_ps(error, best_error);
+			best_error = _mm_min_ps(error, best_error);
+			best_index = _mm_or_ps(_mm_and_ps(is_better, _mm_set1_ps((float)entry)), _mm_andnot_ps(is_better, best_index));
+		}
+
+		__m128i indexes = _mm_cvttps_epi32(best_index);
+		int row_indexes[4];
+		_mm_storeu_si128((__m128i*)row_indexes, indexes);
+		for(uint column = 0; column < 4; ++column){
+			out_indexes[(row * 4) + column] = (uint)row_indexes[column];
+		}
+		total_error += horizontal_sum(best_error);
+	}
+
+	return total_error;
+}
+
+static void write_bc1_block(u16 color0, u16 color1, uint* indexes, byte* out_block)
+{
+	// color0 > color1 picks the 4 colour mode. swapping the ends swaps indexes 0/1 and 2/3
+	if(color0 < color1){
+		std::swap(color0, color1);
+		for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+			indexes[texel_idx] ^= 1;
+		}
+	}else if(color0 == color1){
+		// 3 colour mode, but only index 0 is safe and every entry is that colour anyway
+		for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+			indexes[texel_idx] = 0;
+		}
+	}
+
+	u32 index_bits = 0;
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		index_bits |= indexes[texel_idx] << (texel_idx * 2);
+	}
+
+	out_block[0] = (byte)(color0 & 0xFF);
+	out_block[1] = (byte)(color0 >> 8);
+	out_block[2] = (byte)(color1 & 0xFF);
+	out_block[3] = (byte)(color1 >> 8);
+	memcpy(out_block + 4, &index_bits, sizeof(index_bits));
+}
+
+// principal axis endpoints, then refit to what the texels picked while it keeps helping
+static void encode_bc1_color(const byte* rgba_block, byte* out_block)
+{
+	float texels[16][4];
+	load_float_block(rgba_block, texels);
+
+	bc1_block_t block;
+	load_bc1_block(texels, &block);
+
+	float end0[4];
+	float end1[4];
+	calc_axis_endpoints(texels, 3, end0, end1);
+
+	u16 best_color0 = pack_565(end0);
+	u16 best_color1 = pack_565(end1);
+	uint best_indexes[16];
+	float best_error = select_bc1_indexes(block, best_color0, best_color1, best_indexes);
+
+	uint indexes[16];
+	memcpy(indexes, best_indexes, sizeof(indexes));
+	for(uint iteration = 0; iteration < BC1_REFINE_ITERATIONS; ++iteration){
+		if((best_error == 0.0f) || !fit_endpoints(texels, 3, indexes, BC1_INDEX_WEIGHTS, end0, end1)){
+			break;
+		}
+
+		u16 color0 = pack_565(end0);
+		u16 color1 = pack_565(end1);
+		float error = select_bc1_indexes(block, color0, color1, indexes);
+		if(error >= best_error){
+			break;
+		}
+
+		best_error = error;
+		best_color0 = color0;
+		best_color1 = color1;
+		memcpy(best_indexes, indexes, sizeof(indexes));
+	}
+
+	write_bc1_block(best_color0, best_color1, best_indexes, out_block);
+}
+
+static void decode_bc1_color(const byte* block, bool is_always_four_colors, byte* out_rgba_block)
+{
+	u16 color0 = (u16)(block[0] | (block[1] << 8));
+	u16 color1 = (u16)(block[2] | (block[3] << 8));
+	u32 index_bits;
+	memcpy(&index_bits, block + 4, sizeof(index_bits));
+
+	int palette[4][4];
+	unpack_565(color0, palette[0]);
+	unpack_565(color1, palette[1]);
+	palette[0][3] = 255;
+	palette[1][3] = 255;
+	palette[2][3] = 255;
+	palette[3][3] = 255;
+
+	if(is_always_four_colors || (color0 > color1)){
+		for(uint channel = 0; channel < 3; ++channel){
+			palette[2][channel] = ((2 * palette[0][channel]) + palette[1][channel]) / 3;
+			palette[3][channel] = (palette[0][channel] + (2 * palette[1][channel])) / 3;
+		}
+	}else{
+		for(uint channel = 0; channel < 3; ++channel){
+			palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+			palette[3][channel] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		uint index = (index_bits >> (texel_idx * 2)) & 3;
+		for(uint channel = 0; channel < 4; ++channel){
+			out_rgba_block[(texel_idx * 4) + channel] = (byte)palette[index][channel];
+		}
+	}
+}
+
+//-----------------------------------------------------
+// BC4
+// min and max as the ends in the 8 value mode.  The values are evenly spread, so
+// the nearest one is the texel's position between the ends rounded to 7ths
+static void encode_bc4_channel(const byte* rgba_block, uint channel, byte* out_block)
+{
+	__m128 values[4];
+	for(uint row = 0; row < 4; ++row){
+		const byte* texel = rgba_block + (row * 16) + channel;
+		values[row] = _mm_setr_ps((float)texel[0], (float)texel[4], (float)texel[8], (float)texel[12]);
+	}
+
+	__m128 min_values = _mm_min_ps(_mm_min_ps(values[0], values[1]), _mm_min_ps(values[2], values[3]));
+	__m128 max_values = _mm_max_ps(_mm_max_ps(values[0], values[1]), _mm_max_ps(values[2], values[3]));
+	min_values = _mm_min_ps(min_values, _mm_shuffle_ps(min_values, min_values, _MM_SHUFFLE(1, 0, 3, 2)));
+	min_values = _mm_min_ps(min_values, _mm_shuffle_ps(min_values, min_values, _MM_SHUFFLE(2, 3, 0, 1)));
+	max_values = _mm_max_ps(max_values, _mm_shuffle_ps(max_values, max_values, _MM_SHUFFLE(1, 0, 3, 2)));
+	max_values = _mm_max_ps(max_values, _mm_shuffle_ps(max_values, max_values, _MM_SHUFFLE(2, 3, 0, 1)));
+	float min_value = _mm_cvtss_f32(min_values);
+	float max_value = _mm_cvtss_f32(max_values);
+
+	memset(out_block, 0, 8);
+	out_block[0] = (byte)max_value;
+	out_block[1] = (byte)min_value;
+	if(max_value == min_value){
+		return;
+	}
+
+	__m128 scale = _mm_set1_ps(7.0f / (max_value - min_value));
+	u64 index_bits = 0;
+	for(uint row = 0; row < 4; ++row){
+		__m128 steps = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(values[row], min_values), scale), _mm_set1_ps(0.5f));
+		int positions[4];
+		_mm_storeu_si128((__m128i*)positions, _mm_cvttps_epi32(steps));
+
+		for(uint column = 0; column < 4; ++column){
+			// 7 is the max end (index 0), 0 the min end (index 1), the rest count down from the max
+			int position = positions[column];
+			u64 index = (position == 7) ? 0 : ((position == 0) ? 1 : (u64)(8 - position));
+			index_bits |= index << (((row * 4) + column) * 3);
+		}
+	}
+
+	for(uint byte_idx = 0; byte_idx < 6; ++byte_idx){
+		out_block[2 + byte_idx] = (byte)(index_bits >> (byte_idx * 8));
+	}
+}
+
+static void decode_bc4_channel(const byte* block, uint channel, byte* out_rgba_block)
+{
+	int end0 = block[0];
+	int end1 = block[1];
+
+	int palette[8];
+	palette[0] = end0;
+	palette[1] = end1;
+	if(end0 > end1){
+		for(int entry = 2; entry < 8; ++entry){
+			palette[entry] = (((8 - entry) * end0) + ((entry - 1) * end1)) / 7;
+		}
+	}else{
+		for(int entry = 2; entry < 6; ++entry){
+			palette[entry] = (((6 - entry) * end0) + ((entry - 1) * end1)) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	u64 index_bits = 0;
+	for(uint byte_idx = 0; byte_idx < 6; ++byte_idx){
+		index_bits |= (u64)block[2 + byte_idx] << (byte_idx * 8);
+	}
+
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		uint index = (uint)(index_bits >> (texel_idx * 3)) & 7;
+		out_rgba_block[(texel_idx * 4) + channel] = (byte)palette[index];
+	}
+}
+
+//-----------------------------------------------------
+// BC7, mode 6 only
+static const int BC7_INDEX_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct bc7_endpoint_t
+{
+	u32 values[4];
+	u32 p_bit;
+};
+
+// 7 bits a channel plus a low bit shared by all four, both p bits are tried
+static void quantize_bc7_endpoint(const float* color, bc7_endpoint_t* out_endpoint)
+{
+	float best_error = FLT_MAX;
+	for(u32 p_bit = 0; p_bit < 2; ++p_bit){
+		bc7_endpoint_t endpoint;
+		endpoint.p_bit = p_bit;
+
+		float error = 0.0f;
+		for(uint channel = 0; channel < 4; ++channel){
+			int value = (int)floorf(((color[channel] - (float)p_bit) * 0.5f) + 0.5f);
+			endpoint.values[channel] = (u32)Clamp(value, 0, 127);
+			float delta = (float)((endpoint.values[channel] << 1) | p_bit) - color[channel];
+			error += delta * delta;
+		}
+
+		if(error < best_error){
+			best_error = error;
+			*out_endpoint = endpoint;
+		}
+	}
+}
+
+static void calc_bc7_palette(const bc7_endpoint_t& endpoint0, const bc7_endpoint_t& endpoint1, int palette[16][4])
+{
+	for(uint channel = 0; channel < 4; ++channel){
+		int end0 = (int)((endpoint0.values[channel] << 1) | endpoint0.p_bit);
+		int end1 = (int)((endpoint1.values[channel] << 1) | endpoint1.p_bit);
+		for(uint entry = 0; entry < 16; ++entry){
+			palette[entry][channel] = (((64 - BC7_INDEX_WEIGHTS[entry]) * end0) + (BC7_INDEX_WEIGHTS[entry] * end1) + 32) >> 6;
+		}
+	}
+}
+
+// The palette lies along the line between the ends, so a texel's projection onto it
+// lands next to its nearest entry and only that entry's neighbours need checking
+static float select_bc7_indexes(const float texels[16][4], const bc7_endpoint_t& endpoint0, const bc7_endpoint_t& endpoint1, uint* out_indexes)
+{
+	int palette[16][4];
+	calc_bc7_palette(endpoint0, endpoint1, palette);
+
+	__m128 entries[16];
+	for(uint entry = 0; entry < 16; ++entry){
+		entries[entry] = _mm_setr_ps((float)palette[entry][0], (float)palette[entry][1], (float)palette[entry][2], (float)palette[entry][3]);
+	}
+
+	__m128 direction = _mm_sub_ps(entries[15], entries[0]);
+	float length_squared = horizontal_sum(_mm_mul_ps(direction, direction));
+	float step_scale = (length_squared > 0.0f) ? (15.0f / length_squared) : 0.0f;
+
+	float total_error = 0.0f;
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		__m128 texel = _mm_loadu_ps(texels[texel_idx]);
+		float projection = horizontal_sum(_mm_mul_ps(_mm_sub_ps(texel, entries[0]), direction)) * step_scale;
+		int guess = Clamp((int)(projection + 0.5f), 0, 15);
+
+		float best_error = FLT_MAX;
+		uint best_entry = 0;
+		for(int entry = Max(0, guess - 1); entry <= Min(15, guess + 1); ++entry){
+			__m128 delta = _mm_sub_ps(texel, entries[entry]);
+			float error = horizontal_sum(_mm_mul_ps(delta, delta));
+			if(error < best_error){
+				best_error = error;
+				best_entry = (uint)entry;
+			}
+		}
+
+		out_indexes[texel_idx] = best_entry;
+		total_error += best_error;
+	}
+
+	return total_error;
+}
+
+static void write_bc7_mode6_block(bc7_endpoint_t endpoint0, bc7_endpoint_t endpoint1, uint* indexes, byte* out_block)
+{
+	// the first texel's index is stored with its top bit implied 0, flip the ends if it's set
+	if(indexes[0] & 8){
+		std::swap(endpoint0, endpoint1);
+		for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+			indexes[texel_idx] = 15 - indexes[texel_idx];
+		}
+	}
+
+	block_bit_writer_t writer(out_block, 16);
+	writer.write(1 << 6, 7);
+	for(uint channel = 0; channel < 4; ++channel){
+		writer.write(endpoint0.values[channel], 7);
+		writer.write(endpoint1.values[channel], 7);
+	}
+	writer.write(endpoint0.p_bit, 1);
+	writer.write(endpoint1.p_bit, 1);
+
+	writer.write(indexes[0], 3);
+	for(uint texel_idx = 1; texel_idx < 16; ++texel_idx){
+		writer.write(indexes[texel_idx], 4);
+	}
+}
+
+static bool decode_bc7_mode6_block(const byte* block, byte* out_rgba_block)
+{
+	if((block[0] & 0x7F) != (1 << 6)){
+		memset(out_rgba_block, 0, 64);
+		return false;
+	}
+
+	block_bit_reader_t reader(block);
+	reader.read(7);
+
+	bc7_endpoint_t endpoint0;
+	bc7_endpoint_t endpoint1;
+	for(uint channel = 0; channel < 4; ++channel){
+		endpoint0.values[channel] = reader.read(7);
+		endpoint1.values[channel] = reader.read(7);
+	}
+	endpoint0.p_bit = reader.read(1);
+	endpoint1.p_bit = reader.read(1);
+
+	int palette[16][4];
+	calc_bc7_palette(endpoint0, endpoint1, palette);
+
+	for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+		uint index = reader.read((texel_idx == 0) ? 3 : 4);
+		for(uint channel = 0; channel < 4; ++channel){
+			out_rgba_block[(texel_idx * 4) + channel] = (byte)palette[index][channel];
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+// Block encoding
+void encode_bc1_block(const byte* rgba_block, byte* out_block)
+{
+	encode_bc1_color(rgba_block, out_block);
+}
+
+void encode_bc3_block(const byte* rgba_block, byte* out_block)
+{
+	encode_bc4_channel(rgba_block, 3, out_block);
+	encode_bc1_color(rgba_block, out_block + 8);
+}
+
+void encode_bc4_block(const byte* rgba_block, byte* out_block)
+{
+	encode_bc4_channel(rgba_block, 0, out_block);
+}
+
+void encode_bc5_block(const byte* rgba_block, byte* out_block)
+{
+	encode_bc4_channel(rgba_block, 0, out_block);
+	encode_bc4_channel(rgba_block, 1, out_block + 8);
+}
+
+void encode_bc7_block(const byte* rgba_block, byte* out_block)
+{
+	float texels[16][4];
+	load_float_block(rgba_block, texels);
+
+	float end0[4];
+	float end1[4];
+	calc_axis_endpoints(texels, 4, end0, end1);
+
+	float index_weights[16];
+	for(uint entry = 0; entry < 16; ++entry){
+		index_weights[entry] = (float)(64 - BC7_INDEX_WEIGHTS[entry]) / 64.0f;
+	}
+
+	bc7_endpoint_t best_endpoint0;
+	bc7_endpoint_t best_endpoint1;
+	quantize_bc7_endpoint(end0, &best_endpoint0);
+	quantize_bc7_endpoint(end1, &best_endpoint1);
+	uint best_indexes[16];
+	float best_error = select_bc7_indexes(texels, best_endpoint0, best_endpoint1, best_indexes);
+
+	uint indexes[16];
+	memcpy(indexes, best_indexes, sizeof(indexes));
+	for(uint iteration = 0; iteration < BC7_REFINE_ITERATIONS; ++iteration){
+		if((best_error == 0.0f) || !fit_endpoints(texels, 4, indexes, index_weights, end0, end1)){
+			break;
+		}
+
+		bc7_endpoint_t endpoint0;
+		bc7_endpoint_t endpoint1;
+		quantize_bc7_endpoint(end0, &endpoint0);
+		quantize_bc7_endpoint(end1, &endpoint1);
+		float error = select_bc7_indexes(texels, endpoint0, endpoint1, indexes);
+		if(error >= best_error){
+			break;
+		}
+
+		best_error = error;
+		best_endpoint0 = endpoint0;
+		best_endpoint1 = endpoint1;
+		memcpy(best_indexes, indexes, sizeof(indexes));
+	}
+
+	write_bc7_mode6_block(best_endpoint0, best_endpoint1, best_indexes, out_block);
+}
+
+static void encode_texture_block(TextureFileFormat format, const byte* rgba_block, byte* out_block)
+{
+	switch(format){
+		case TEXTURE_FILE_FORMAT_BC1:	encode_bc1_block(rgba_block, out_block); break;
+		case TEXTURE_FILE_FORMAT_BC3:	encode_bc3_block(rgba_block, out_block); break;
+		case TEXTURE_FILE_FORMAT_BC4:	encode_bc4_block(rgba_block, out_block); break;
+		case TEXTURE_FILE_FORMAT_BC5:	encode_bc5_block(rgba_block, out_block); break;
+		case TEXTURE_FILE_FORMAT_BC7:	encode_bc7_block(rgba_block, out_block); break;
+		default:						break;
+	}
+}
+
+bool decode_texture_block(TextureFileFormat format, const byte* block, byte* out_rgba_block)
+{
+	switch(format){
+		case TEXTURE_FILE_FORMAT_BC1:{
+			decode_bc1_color(block, false, out_rgba_block);
+		} break;
+
+		case TEXTURE_FILE_FORMAT_BC3:{
+			decode_bc1_color(block + 8, true, out_rgba_block);
+			decode_bc4_channel(block, 3, out_rgba_block);
+		} break;
+
+		case TEXTURE_FILE_FORMAT_BC4:
+		case TEXTURE_FILE_FORMAT_BC5:{
+			for(uint texel_idx = 0; texel_idx < 16; ++texel_idx){
+				byte* texel = out_rgba_block + (texel_idx * 4);
+				texel[1] = 0;
+				texel[2] = 0;
+				texel[3] = 255;
+			}
+			decode_bc4_channel(block, 0, out_rgba_block);
+			if(format == TEXTURE_FILE_FORMAT_BC5){
+				decode_bc4_channel(block + 8, 1, out_rgba_block);
+			}
+		} break;
+
+		case TEXTURE_FILE_FORMAT_BC7:{
+			return decode_bc7_mode6_block(block, out_rgba_block);
+		}
+
+		default:{
+			memcpy(out_rgba_block, block, 64);
+		} break;
+	}
+	return true;
+}
+
+//-----------------------------------------------------
+// Mip compression
+// blocks hanging off the edge of a small mip repeat its last row and column
+static void extract_texture_block(const texture_mip_t& mip, uint block_x, uint block_y, byte* out_rgba_block)
+{
+	uint x = block_x * 4;
+	uint y = block_y * 4;
+	if((x + 4 <= mip.width) && (y + 4 <= mip.height)){
+		for(uint row = 0; row < 4; ++row){
+			memcpy(out_rgba_block + (row * 16), mip.texels.data() + ((((size_t)(y + row) * mip.width) + x) * 4), 16);
+		}
+		return;
+	}
+
+	for(uint row = 0; row < 4; ++row){
+		uint src_y = Min(y + row, mip.height - 1);
+		for(uint column = 0; column < 4; ++column){
+			uint src_x = Min(x + column, mip.width - 1);
+			memcpy(out_rgba_block + (((row * 4) + column) * 4), mip.texels.data() + ((((size_t)src_y * mip.width) + src_x) * 4), 4);
+		}
+	}
+}
+
+static void compress_block_rows(const texture_mip_t* mip, TextureFileFormat format, byte* out_data, uint first_block_row, uint end_block_row)
+{
+	uint block_size = get_texture_file_format_size(format);
+	uint row_pitch = calc_texture_file_row_pitch(format, mip->width);
+	uint blocks_wide = row_pitch / block_size;
+
+	byte rgba_block[64];
+	for(uint block_y = first_block_row; block_y < end_block_row; ++block_y){
+		byte* out_row = out_data + ((size_t)block_y * row_pitch);
+		for(uint block_x = 0; block_x < blocks_wide; ++block_x){
+			extract_texture_block(*mip, block_x, block_y, rgba_block);
+			encode_texture_block(format, rgba_block, out_row + (block_x * block_size));
+		}
+	}
+}
+
+// adds the mip's jobs to jobs without waiting on them, so a whole chain can be in flight at once
+static void dispatch_compress_jobs(const texture_mip_t& mip, TextureFileFormat format, std::vector<byte>* out_data, uint block_rows_per_job, std::vector<Job*>* jobs)
+{
+	uint row_count = calc_texture_file_row_count(format, mip.height);
+	out_data->resize((size_t)calc_texture_file_row_pitch(format, mip.width) * row_count);
+
+	if(!is_block_compressed(format)){
+		memcpy(out_data->data(), mip.texels.data(), out_data->size());
+		return;
+	}
+
+	block_rows_per_job = Max(1U, block_rows_per_job);
+	for(uint first_row = 0; first_row < row_count;){
+		uint end_row = ((row_count - first_row) > block_rows_per_job) ? (first_row + block_rows_per_job) : row_count;
+		Job* job = job_create(JOB_TYPE_GENERIC, compress_block_rows, &mip, format, out_data->data(), first_row, end_row);
+		job_dispatch(job);
+		jobs->push_back(job);
+		first_row = end_row;
+	}
+}
+
+void compress_texture_mip(const texture_mip_t& mip, TextureFileFormat format, std::vector<byte>* out_data, uint block_rows_per_job)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	std::vector<Job*> jobs;
+	dispatch_compress_jobs(mip, format, out_data, block_rows_per_job, &jobs);
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+}
+
+void decompress_texture_mip(const byte* data, TextureFileFormat format, uint width, uint height, std::vector<byte>* out_rgba)
+{
+	out_rgba->resize((size_t)width * height * 4);
+	if(!is_block_compressed(format)){
+		memcpy(out_rgba->data(), data, out_rgba->size());
+		return;
+	}
+
+	uint block_size = get_texture_file_format_size(format);
+	uint row_pitch = calc_texture_file_row_pitch(format, width);
+	uint blocks_wide = row_pitch / block_size;
+	uint blocks_high = calc_texture_file_row_count(format, height);
+
+	byte rgba_block[64];
+	for(uint block_y = 0; block_y < blocks_high; ++block_y){
+		for(uint block_x = 0; block_x < blocks_wide; ++block_x){
+			decode_texture_block(format, data + ((size_t)block_y * row_pitch) + (block_x * block_size), rgba_block);
+
+			for(uint row = 0; row < 4; ++row){
+				uint y = (block_y * 4) + row;
+				for(uint column = 0; column < 4; ++column){
+					uint x = (block_x * 4) + column;
+					if((x < width) && (y < height)){
+						memcpy(out_rgba->data() + ((((size_t)y * width) + x) * 4), rgba_block + (((row * 4) + column) * 4), 4);
+					}
+				}
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------
+// Cooking
+bool cook_texture(const byte* rgba, uint width, uint height, const texture_cook_options_t& options, cooked_texture_t* out_texture)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	if((width == 0) || (height == 0)){
+		return false;
+	}
+
+	TextureFileFormat format = (options.format < NUM_TEXTURE_FILE_FORMATS) ? options.format : get_default_texture_file_format(options.kind);
+	if(format == TEXTURE_FILE_FORMAT_RGBA16F){
+		log_warningf("Textures are cooked from 8 bit images, rgba16f is only written by the ibl baker. Cooking as rgba8\n");
+		format = TEXTURE_FILE_FORMAT_RGBA8;
+	}
+	if(is_block_compressed(format) && (((width % 4) != 0) || ((height % 4) != 0))){
+		log_warningf("Texture is %ux%u, %s needs a multiple of 4 so it's cooked as rgba8\n", width, height, get_texture_file_format_name(format));
+		format = TEXTURE_FILE_FORMAT_RGBA8;
+	}
+
+	std::vector<texture_mip_t> mips;
+	if(options.generate_mips){
+		generate_mip_chain(rgba, width, height, options.kind, &mips);
+	}else{
+		mips.resize(1);
+		mips[0].width = width;
+		mips[0].height = height;
+		mips[0].texels.assign(rgba, rgba + ((size_t)width * height * 4));
+	}
+
+	out_texture->format = format;
+	out_texture->flags = 0;
+	if(options.kind == TEXTURE_COOK_KIND_COLOR){
+		out_texture->flags |= TEXTURE_FILE_FLAG_SRGB;
+	}else if(options.kind == TEXTURE_COOK_KIND_NORMAL_MAP){
+		out_texture->flags |= TEXTURE_FILE_FLAG_NORMAL_MAP;
+	}
+	out_texture->width = width;
+	out_texture->height = height;
+	out_texture->mips.clear();
+	out_texture->mips.resize(mips.size());
+
+	std::vector<Job*> jobs;
+	for(uint mip_idx = 0; mip_idx < (uint)mips.size(); ++mip_idx){
+		dispatch_compress_jobs(mips[mip_idx], format, &out_texture->mips[mip_idx], options.block_rows_per_job, &jobs);
+	}
+	for(Job* job : jobs){
+		job_wait_and_release(job);
+	}
+
+	return true;
+}
+
+bool cook_texture_file(const char* image_filename, const char* out_filename, const texture_cook_options_t& options)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	// straight through stb rather than Image, which dies on a bad file
+	int width = 0;
+	int height = 0;
+	int channel_count = 0;
+	byte* rgba = stbi_load(image_filename, &width, &height, &channel_count, 4);
+	if(rgba == nullptr){
+		log_warningf("Failed to load image [%s] to cook\n", image_filename);
+		return false;
+	}
+
+	cooked_texture_t texture;
+	bool did_cook = cook_texture(rgba, (uint)width, (uint)height, options, &texture);
+	stbi_image_free(rgba);
+	if(!did_cook){
+		return false;
+	}
+
+	std::vector<const byte*> mip_data;
+	for(const std::vector<byte>& mip : texture.mips){
+		mip_data.push_back(mip.data());
+	}
+	return write_texture_file(out_filename, texture.format, texture.flags, texture.width, texture.height, (uint)mip_data.size(), mip_data.data());
+}
+
+//-----------------------------------------------------
+// Commands
+static bool parse_texture_cook_kind(const std::string& name, TextureCookKind* out_kind)
+{
+	for(uint kind = 0; kind < NUM_TEXTURE_COOK_KINDS; ++kind){
+		if(name == get_texture_cook_kind_name((TextureCookKind)kind)){
+			*out_kind = (TextureCookKind)kind;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_texture_file_format(const std::string& name, TextureFileFormat* out_format)
+{
+	for(uint format = 0; format < NUM_TEXTURE_FILE_FORMATS; ++format){
+		if(name == get_texture_file_format_name((TextureFileFormat)format)){
+			*out_format = (TextureFileFormat)format;
+			return true;
+		}
+	}
+	return false;
+}
+
+// over the channels the format keeps
+static double calc_texture_psnr(const byte* expected, const byte* actual, size_t texel_count, TextureFileFormat format)
+{
+	uint channel_count = 4;
+	switch(format){
+		case TEXTURE_FILE_FORMAT_BC1:	channel_count = 3; break;
+		case TEXTURE_FILE_FORMAT_BC4:	channel_count = 1; break;
+		case TEXTURE_FILE_FORMAT_BC5:	channel_count = 2; break;
+		default:						break;
+	}
+
+	double error = 0.0;
+	for(size_t texel_idx = 0; texel_idx < texel_count; ++texel_idx){
+		for(uint channel = 0; channel < channel_count; ++channel){
+			double delta = (double)expected[(texel_idx * 4) + channel] - (double)actual[(texel_idx * 4) + channel];
+			error += delta * delta;
+		}
+	}
+
+	double mean_error = error / (double)(texel_count * channel_count);
+	if(mean_error <= 0.0){
+		return 99.0;
+	}
+	return 10.0 * log10((255.0 * 255.0) / mean_error);
+}
+
+static void find_images_to_cook(const std::string& directory, std::vector<std::string>* out_filenames)
+{
+	static const char* IMAGE_PATTERNS[] = { "*.png", "*.tga", "*.jpg" };
+	for(const char* pattern : IMAGE_PATTERNS){
+		std::vector<std::string> filenames = find_files_in_directory(directory.c_str(), pattern);
+		for(const std::string& filename : filenames){
+			out_filenames->push_back(directory + "/" + filename);
+		}
+	}
+
+	std::vector<std::string> subdirectories = find_directories_in_directory(directory.c_str());
+	for(const std::string& subdirectory : subdirectories){
+		find_images_to_cook(directory + "/" + subdirectory, out_filenames);
+	}
+}
+
+COMMAND(cook_texture, "[string:image_filename string:kind string:format] Cooks an image to a texture file next to it. kind is color, linear, mask or normal, format rgba8, bc1, bc3, bc4, bc5 or bc7, both guessed when not given")
+{
+	std::string image_filename = args.next_string_arg();
+
+	texture_cook_options_t options;
+	options.kind = guess_texture_cook_kind(image_filename);
+	if(!args.is_at_end() && !parse_texture_cook_kind(args.next_string_arg(), &options.kind)){
+		console_error("Unknown texture kind, expected color, linear, mask or normal");
+		return;
+	}
+	if(!args.is_at_end() && !parse_texture_file_format(args.next_string_arg(), &options.format)){
+		console_error("Unknown texture format, expected rgba8, bc1, bc3, bc4, bc5 or bc7");
+		return;
+	}
+
+	std::string out_filename = make_texture_file_name(image_filename);
+	double start = get_current_time_seconds();
+	if(cook_texture_file(image_filename.c_str(), out_filename.c_str(), options)){
+		console_success("Cooked [%s] as %s to [%s] in %.1f ms", image_filename.c_str(), get_texture_cook_kind_name(options.kind), out_filename.c_str(), (get_current_time_seconds() - start) * 1000.0);
+	}else{
+		console_error("Failed to cook [%s]", image_filename.c_str());
+	}
+}
+
+COMMAND(cook_textures, "[string:directory] Cooks every png, tga and jpg under a directory (default Data/Images), kinds and formats guessed from the file names")
+{
+	std::string directory = args.is_at_end() ? "Data/Images" : args.next_string_arg();
+
+	std::vector<std::string> filenames;
+	find_images_to_cook(directory, &filenames);
+
+	uint num_cooked = 0;
+	double start = get_current_time_seconds();
+	for(const std::string& filename : filenames){
+		texture_cook_options_t options;
+		options.kind = guess_texture_cook_kind(filename);
+		if(cook_texture_file(filename.c_str(), make_texture_file_name(filename).c_str(), options)){
+			num_cooked++;
+		}else{
+			console_error("Failed to cook [%s]", filename.c_str());
+		}
+	}
+
+	console_info("Cooked %u of %u images under [%s] in %.2f s", num_cooked, (uint)filenames.size(), directory.c_str(), get_current_time_seconds() - start);
+}
+
+COMMAND(texture_cook_benchmark, "[string:image_filename] Times mip generation and every block format on one job against the whole job system, with the PSNR each gets")
+{
+	std::string image_filename = args.is_at_end() ? "Data/Images/rusted_iron/rustediron_basecolor_fast.png" : args.next_string_arg();
+
+	int width = 0;
+	int height = 0;
+	int channel_count = 0;
+	byte* rgba = stbi_load(image_filename.c_str(), &width, &height, &channel_count, 4);
+	if(rgba == nullptr){
+		console_error("Failed to load [%s]", image_filename.c_str());
+		return;
+	}
+	if(((width % 4) != 0) || ((height % 4) != 0)){
+		console_error("[%s] is %ix%i, it needs to be a multiple of 4", image_filename.c_str(), width, height);
+		stbi_image_free(rgba);
+		return;
+	}
+
+	TextureCookKind kind = guess_texture_cook_kind(image_filename);
+	double megapixels = ((double)width * (double)height) / 1000000.0;
+
+	std::vector<texture_mip_t> mips;
+	double start = get_current_time_seconds();
+	generate_mip_chain(rgba, (uint)width, (uint)height, kind, &mips);
+	double mip_seconds = get_current_time_seconds() - start;
+	stbi_image_free(rgba);
+
+	console_info("----Texture cook [%s] (%ix%i, %s)----", image_filename.c_str(), width, height, get_texture_cook_kind_name(kind));
+	console_info("mip chain:  %u mips in %.1f ms", (uint)mips.size(), mip_seconds * 1000.0);
+
+	const texture_mip_t& top_mip = mips[0];
+	std::vector<byte> serial_data;
+	std::vector<byte> job_data;
+	std::vector<byte> decoded;
+	for(uint format = TEXTURE_FILE_FORMAT_BC1; format <= TEXTURE_FILE_FORMAT_BC7; ++format){
+		TextureFileFormat block_format = (TextureFileFormat)format;
+
+		start = get_current_time_seconds();
+		compress_texture_mip(top_mip, block_format, &serial_data, 0xFFFFFFFF);
+		double serial_seconds = get_current_time_seconds() - start;
+
+		start = get_current_time_seconds();
+		compress_texture_mip(top_mip, block_format, &job_data, DEFAULT_TEXTURE_COOK_BLOCK_ROWS_PER_JOB);
+		double job_seconds = get_current_time_seconds() - start;
+
+		decompress_texture_mip(job_data.data(), block_format, top_mip.width, top_mip.height, &decoded);
+		double psnr = calc_texture_psnr(top_mip.texels.data(), decoded.data(), (size_t)top_mip.width * top_mip.height, block_format);
+		bool matches = (serial_data == job_data);
+
+		console_info("%s:  one job %.1f ms (%.1f MP/s), jobs %.1f ms (%.1f MP/s), %.2f dB%s",
+			get_texture_file_format_name(block_format),
+			serial_seconds * 1000.0, megapixels / serial_seconds,
+			job_seconds * 1000.0, megapixels / job_seconds,
+			psnr, matches ? "" : ", JOB OUTPUT DIFFERS");
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/texture_file.h"
+
+#include <string>
+#include <vector>
+
+// block rows (4 texel rows) one compression job encodes
+#define DEFAULT_TEXTURE_COOK_BLOCK_ROWS_PER_JOB (16)
+
+// texel rows of a mip one downsample job writes
+#define DEFAULT_TEXTURE_COOK_MIP_ROWS_PER_JOB (64)
+
+// How a texture's texels are treated while filtering and which format it
+// defaults to.  Guessed from the file name when not given.
+enum TextureCookKind
+{
+	// sRGB colour, mips are filtered in linear light. BC7
+	TEXTURE_COOK_KIND_COLOR,
+
+	// data filtered as is. BC7
+	TEXTURE_COOK_KIND_LINEAR,
+
+	// single channel data shaders read from .x (roughness, metalness, ao, height..). BC4
+	TEXTURE_COOK_KIND_MASK,
+
+	// tangent space normals, filtered as vectors and renormalized per mip. BC5
+	TEXTURE_COOK_KIND_NORMAL_MAP,
+	NUM_TEXTURE_COOK_KINDS
+};
+
+struct texture_cook_options_t
+{
+	TextureCookKind kind;
+
+	// NUM_TEXTURE_FILE_FORMATS picks the kind's default
+	TextureFileFormat format;
+	bool generate_mips;
+	uint block_rows_per_job;
+
+	texture_cook_options_t();
+};
+
+// tightly packed RGBA8 texels of one mip
+struct texture_mip_t
+{
+	uint width;
+	uint height;
+	std::vector<byte> texels;
+};
+
+struct cooked_texture_t
+{
+	TextureFileFormat format;
+	u32 flags;
+	uint width;
+	uint height;
+
+	// laid out at calc_texture_file_row_pitch
+	std::vector<std::vector<byte>> mips;
+};
+
+TextureCookKind guess_texture_cook_kind(const std::string& filename);
+TextureFileFormat get_default_texture_file_format(TextureCookKind kind);
+const char* get_texture_cook_kind_name(TextureCookKind kind);
+
+// Full chain down to 1x1 from RGBA8 texels, out_mips[0] is a copy of the source.
+// Every mip is filtered from a float copy of the one above it, never from the
+// rounded RGBA8, so rounding doesn't build up down the chain.  Odd sizes are
+// box filtered over the 3 source texels each output texel covers
+void generate_mip_chain(const byte* rgba, uint width, uint height, TextureCookKind kind, std::vector<texture_mip_t>* out_mips);
+
+// One 4x4 block of RGBA8 texels (64 bytes, row major) to one compressed block.
+// BC1 always uses the 4 colour mode, alpha is dropped.
+// BC4 takes the red channel, BC5 red and green.
+// BC7 only writes mode 6, one subset with 7.7.7.7 + p bit endpoints and 4 bit indexes
+void encode_bc1_block(const byte* rgba_block, byte* out_block);
+void encode_bc3_block(const byte* rgba_block, byte* out_block);
+void encode_bc4_block(const byte* rgba_block, byte* out_block);
+void encode_bc5_block(const byte* rgba_block, byte* out_block);
+void encode_bc7_block(const byte* rgba_block, byte* out_block);
+
+// back to RGBA8, channels a format doesn't store come out as 0 (alpha 255).
+// BC7 only knows mode 6, any other mode decodes as black and returns false
+bool decode_texture_block(TextureFileFormat format, const byte* block, byte* out_rgba_block);
+
+// one mip into format, rows of blocks spread over jobs
+void compress_texture_mip(const texture_mip_t& mip, TextureFileFormat format, std::vector<byte>* out_data, uint block_rows_per_job = DEFAULT_TEXTURE_COOK_BLOCK_ROWS_PER_JOB);
+void decompress_texture_mip(const byte* data, TextureFileFormat format, uint width, uint height, std::vector<byte>* out_rgba);
+
+// block compressed formats need the top mip to be a whole number of blocks, anything else is cooked as RGBA8
+bool cook_texture(const byte* rgba, uint width, uint height, const texture_cook_options_t& options, cooked_texture_t* out_texture);
+bool cook_texture_file(const char* image_filename, const char* out_filename, const texture_cook_options_t& options);
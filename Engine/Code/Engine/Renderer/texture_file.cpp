@@ -0,0 +1,350 @@
+#include "Engine/Renderer/texture_file.h"
+#include "Engine/Core/Common.hpp"
+#include "Engine/Core/log.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static size_t align_texture_file_offset(size_t offset)
+{
+	return (offset + (TEXTURE_FILE_ALIGNMENT - 1)) & ~((size_t)TEXTURE_FILE_ALIGNMENT - 1);
+}
+
+const char* get_texture_file_format_name(TextureFileFormat format)
+{
+	switch(format){
+		case TEXTURE_FILE_FORMAT_RGBA8:	return "rgba8";
+		case TEXTURE_FILE_FORMAT_BC1:	return "bc1";
+		case TEXTURE_FILE_FORMAT_BC3:	return "bc3";
+		case TEXTURE_FILE_FORMAT_BC4:	return "bc4";
+		case TEXTURE_FILE_FORMAT_BC5:	return "bc5";
+		case TEXTURE_FILE_FORMAT_BC7:	return "bc7";
+		case TEXTURE_FILE_FORMAT_RGBA16F:	return "rgba16f";
+		default:						return "unknown";
+	}
+}
+
+bool is_block_compressed(TextureFileFormat format)
+{
+	return (format >= TEXTURE_FILE_FORMAT_BC1) && (format <= TEXTURE_FILE_FORMAT_BC7);
+}
+
+uint get_texture_file_format_size(TextureFileFormat format)
+{
+	switch(format){
+		case TEXTURE_FILE_FORMAT_RGBA8:	return 4;
+		case TEXTURE_FILE_FORMAT_BC1:	return 8;
+		case TEXTURE_FILE_FORMAT_BC4:	return 8;
+		case TEXTURE_FILE_FORMAT_BC3:	return 16;
+		case TEXTURE_FILE_FORMAT_BC5:	return 16;
+		case TEXTURE_FILE_FORMAT_BC7:	return 16;
+		case TEXTURE_FILE_FORMAT_RGBA16F:	return 8;
+		default:						return 0;
+	}
+}
+
+uint calc_texture_file_row_pitch(TextureFileFormat format, uint width)
+{
+	if(is_block_compressed(format)){
+		return Max(1U, (width + 3) / 4) * get_texture_file_format_size(format);
+	}
+	return width * get_texture_file_format_size(format);
+}
+
+uint calc_texture_file_row_count(TextureFileFormat format, uint height)
+{
+	if(is_block_compressed(format)){
+		return Max(1U, (height + 3) / 4);
+	}
+	return height;
+}
+
+uint calc_full_mip_count(uint width, uint height)
+{
+	uint mip_count = 1;
+	uint size = Max(width, height);
+	while(size > 1){
+		size /= 2;
+		mip_count++;
+	}
+	return mip_count;
+}
+
+// fnv-1a a word at a time, same as the mesh file
+u32 calc_texture_file_checksum(const void* data, size_t size)
+{
+	const byte* bytes = (const byte*)data;
+	u32 hash = 2166136261U;
+
+	size_t num_words = size / sizeof(u32);
+	for(size_t word_idx = 0; word_idx < num_words; ++word_idx){
+		u32 word;
+		memcpy(&word, bytes + word_idx * sizeof(u32), sizeof(u32));
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	for(size_t byte_idx = num_words * sizeof(u32); byte_idx < size; ++byte_idx){
+		hash = (hash ^ bytes[byte_idx]) * 16777619U;
+	}
+
+	return hash;
+}
+
+//-----------------------------------------------------
+// TextureFile
+TextureFile::TextureFile()
+	:m_header(nullptr)
+	,m_mips(nullptr)
+	,m_face_count(0)
+{
+}
+
+TextureFile::~TextureFile()
+{
+	close();
+}
+
+bool TextureFile::open(const char* filename, bool verify_checksum)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	close();
+
+	if(!m_mapped_file.open_for_read(filename)){
+		return false;
+	}
+
+	const byte* data = m_mapped_file.get_data();
+	size_t size = m_mapped_file.get_size();
+
+	const texture_file_header_t* header = (const texture_file_header_t*)data;
+	if(size < sizeof(texture_file_header_t) || header->magic != TEXTURE_FILE_MAGIC){
+		close();
+		return false;
+	}
+
+	if((header->version < TEXTURE_FILE_MIN_VERSION) || (header->version > TEXTURE_FILE_VERSION)){
+		log_warningf("Texture file [%s] is version %u, expected %u to %u\n", filename, header->version, TEXTURE_FILE_MIN_VERSION, TEXTURE_FILE_VERSION);
+		close();
+		return false;
+	}
+
+	uint face_count = (header->version < 2) ? 1 : header->face_count;
+	bool is_header_valid = (header->format < NUM_TEXTURE_FILE_FORMATS)
+		&& (header->width > 0) && (header->height > 0)
+		&& (header->mip_count > 0) && (header->mip_count <= MAX_TEXTURE_FILE_MIPS)
+		&& (header->mip_count <= calc_full_mip_count(header->width, header->height))
+		&& ((face_count == 1) || ((face_count == MAX_TEXTURE_FILE_FACES) && (header->width == header->height)));
+	if(!is_header_valid){
+		log_warningf("Texture file [%s] has a bad header\n", filename);
+		close();
+		return false;
+	}
+
+	size_t table_end = sizeof(texture_file_header_t) + (size_t)face_count * header->mip_count * sizeof(texture_file_mip_t);
+	if(header->file_size != (u64)size || table_end > size){
+		log_warningf("Texture file [%s] is truncated\n", filename);
+		close();
+		return false;
+	}
+
+	if(verify_checksum){
+		u32 checksum = calc_texture_file_checksum(data + sizeof(texture_file_header_t), size - sizeof(texture_file_header_t));
+		if(checksum != header->checksum){
+			log_warningf("Texture file [%s] failed its checksum\n", filename);
+			close();
+			return false;
+		}
+	}
+
+	// the mips get handed to the driver as is, so they have to be exactly what it expects
+	TextureFileFormat format = (TextureFileFormat)header->format;
+	const texture_file_mip_t* mips = (const texture_file_mip_t*)(data + sizeof(texture_file_header_t));
+	for(uint mip_table_idx = 0; mip_table_idx < face_count * header->mip_count; ++mip_table_idx){
+		const texture_file_mip_t& mip = mips[mip_table_idx];
+		uint mip_idx = mip_table_idx % header->mip_count;
+		uint mip_width = Max(1U, header->width >> mip_idx);
+		uint mip_height = Max(1U, header->height >> mip_idx);
+
+		bool is_valid = (mip.width == mip_width) && (mip.height == mip_height)
+			&& (mip.row_pitch == calc_texture_file_row_pitch(format, mip_width))
+			&& (mip.row_count == calc_texture_file_row_count(format, mip_height))
+			&& (mip.size == (u64)mip.row_pitch * mip.row_count)
+			&& ((mip.offset % TEXTURE_FILE_ALIGNMENT) == 0)
+			&& (mip.offset + mip.size <= (u64)size);
+		if(!is_valid){
+			log_warningf("Texture file [%s] has a bad mip %u on face %u\n", filename, mip_idx, mip_table_idx / header->mip_count);
+			close();
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_mips = mips;
+	m_face_count = face_count;
+	return true;
+}
+
+void TextureFile::close()
+{
+	m_mapped_file.close();
+	m_header = nullptr;
+	m_mips = nullptr;
+	m_face_count = 0;
+}
+
+bool TextureFile::is_open() const
+{
+	return m_header != nullptr;
+}
+
+TextureFileFormat TextureFile::get_format() const
+{
+	return (TextureFileFormat)m_header->format;
+}
+
+uint TextureFile::get_width() const
+{
+	return m_header->width;
+}
+
+uint TextureFile::get_height() const
+{
+	return m_header->height;
+}
+
+uint TextureFile::get_mip_count() const
+{
+	return m_header->mip_count;
+}
+
+uint TextureFile::get_face_count() const
+{
+	return m_face_count;
+}
+
+bool TextureFile::is_cube_map() const
+{
+	return m_face_count == MAX_TEXTURE_FILE_FACES;
+}
+
+bool TextureFile::is_srgb() const
+{
+	return (m_header->flags & TEXTURE_FILE_FLAG_SRGB) != 0;
+}
+
+bool TextureFile::is_normal_map() const
+{
+	return (m_header->flags & TEXTURE_FILE_FLAG_NORMAL_MAP) != 0;
+}
+
+const texture_file_mip_t& TextureFile::get_mip(uint mip, uint face) const
+{
+	return m_mips[face * m_header->mip_count + mip];
+}
+
+const byte* TextureFile::get_mip_data(uint mip, uint face) const
+{
+	return m_mapped_file.get_data() + get_mip(mip, face).offset;
+}
+
+u64 TextureFile::get_data_size() const
+{
+	u64 size = 0;
+	for(uint mip_table_idx = 0; mip_table_idx < m_face_count * m_header->mip_count; ++mip_table_idx){
+		size += m_mips[mip_table_idx].size;
+	}
+	return size;
+}
+
+//-----------------------------------------------------
+// Writing
+static bool write_texture_file_faces(const char* filename,
+									TextureFileFormat format, u32 flags,
+									uint width, uint height,
+									uint face_count, uint mip_count, const byte* const* face_mip_data)
+{
+	if((mip_count == 0) || (mip_count > MAX_TEXTURE_FILE_MIPS) || (mip_count > calc_full_mip_count(width, height))){
+		log_warningf("Can't write texture file [%s] with %u mips\n", filename, mip_count);
+		return false;
+	}
+
+	uint mip_table_count = face_count * mip_count;
+	std::vector<texture_file_mip_t> mips(mip_table_count);
+
+	size_t offset = align_texture_file_offset(sizeof(texture_file_header_t) + mip_table_count * sizeof(texture_file_mip_t));
+	for(uint mip_table_idx = 0; mip_table_idx < mip_table_count; ++mip_table_idx){
+		uint mip_idx = mip_table_idx % mip_count;
+		texture_file_mip_t& mip = mips[mip_table_idx];
+		mip.width = Max(1U, width >> mip_idx);
+		mip.height = Max(1U, height >> mip_idx);
+		mip.row_pitch = calc_texture_file_row_pitch(format, mip.width);
+		mip.row_count = calc_texture_file_row_count(format, mip.height);
+		mip.offset = offset;
+		mip.size = (u64)mip.row_pitch * mip.row_count;
+		offset = align_texture_file_offset(offset + (size_t)mip.size);
+	}
+
+	// zero filled, so padding between mips is deterministic and checksums match across writes
+	std::vector<byte> file_data(offset, 0);
+	memcpy(file_data.data() + sizeof(texture_file_header_t), mips.data(), mip_table_count * sizeof(texture_file_mip_t));
+	for(uint mip_table_idx = 0; mip_table_idx < mip_table_count; ++mip_table_idx){
+		memcpy(file_data.data() + mips[mip_table_idx].offset, face_mip_data[mip_table_idx], (size_t)mips[mip_table_idx].size);
+	}
+
+	texture_file_header_t header;
+	MemZero(&header);
+	header.magic = TEXTURE_FILE_MAGIC;
+	header.version = TEXTURE_FILE_VERSION;
+	header.format = format;
+	header.flags = flags;
+	header.width = width;
+	header.height = height;
+	header.mip_count = mip_count;
+	header.face_count = face_count;
+	header.file_size = (u64)file_data.size();
+	header.checksum = calc_texture_file_checksum(file_data.data() + sizeof(texture_file_header_t), file_data.size() - sizeof(texture_file_header_t));
+	memcpy(file_data.data(), &header, sizeof(header));
+
+	FILE* file = nullptr;
+	fopen_s(&file, filename, "wb");
+	if(file == nullptr){
+		log_warningf("Failed to open [%s] to write a texture file\n", filename);
+		return false;
+	}
+
+	size_t written = fwrite(file_data.data(), 1, file_data.size(), file);
+	fclose(file);
+
+	return written == file_data.size();
+}
+
+bool write_texture_file(const char* filename,
+						TextureFileFormat format, u32 flags,
+						uint width, uint height,
+						uint mip_count, const byte* const* mip_data)
+{
+	PROFILE_SCOPE_FUNCTION();
+	return write_texture_file_faces(filename, format, flags, width, height, 1, mip_count, mip_data);
+}
+
+bool write_cube_texture_file(const char* filename,
+							 TextureFileFormat format, u32 flags,
+							 uint size,
+							 uint mip_count, const byte* const* face_mip_data)
+{
+	PROFILE_SCOPE_FUNCTION();
+	return write_texture_file_faces(filename, format, flags, size, size, MAX_TEXTURE_FILE_FACES, mip_count, face_mip_data);
+}
+
+std::string make_texture_file_name(const std::string& image_filename)
+{
+	size_t dot = image_filename.find_last_of('.');
+	if(dot == std::string::npos){
+		return image_filename + TEXTURE_FILE_EXTENSION;
+	}
+	return image_filename.substr(0, dot) + TEXTURE_FILE_EXTENSION;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Core/mapped_file.h"
+
+#include <string>
+
+#define TEXTURE_FILE_MAGIC (0x58455443) // "CTEX" read as a little endian u32
+#define TEXTURE_FILE_VERSION (2)
+
+// version 1 files have no face count, they load as one face
+#define TEXTURE_FILE_MIN_VERSION (1)
+
+// every mip starts on a cache line, same as the mesh file
+#define TEXTURE_FILE_ALIGNMENT (64)
+
+#define TEXTURE_FILE_EXTENSION ".ctex"
+
+// a 64k x 64k texture has 17
+#define MAX_TEXTURE_FILE_MIPS (17)
+
+// a cube map, faces in d3d order (+x, -x, +y, -y, +z, -z)
+#define MAX_TEXTURE_FILE_FACES (6)
+
+// stored in the file, only ever append
+enum TextureFileFormat : u32
+{
+	TEXTURE_FILE_FORMAT_RGBA8,
+	TEXTURE_FILE_FORMAT_BC1,
+	TEXTURE_FILE_FORMAT_BC3,
+	TEXTURE_FILE_FORMAT_BC4,
+	TEXTURE_FILE_FORMAT_BC5,
+	TEXTURE_FILE_FORMAT_BC7,
+
+	// half float, for hdr data like the baked lighting
+	TEXTURE_FILE_FORMAT_RGBA16F,
+	NUM_TEXTURE_FILE_FORMATS
+};
+
+enum TextureFileFlags : u32
+{
+	// texels are sRGB encoded, mips were filtered in linear light
+	TEXTURE_FILE_FLAG_SRGB			= (1 << 0),
+
+	// texels are tangent space normals, BC4/BC5 ones only store x and y
+	TEXTURE_FILE_FLAG_NORMAL_MAP	= (1 << 1),
+};
+
+struct texture_file_header_t
+{
+	u32 magic;
+	u32 version;
+	u32 format;
+	u32 flags;
+
+	u32 width;
+	u32 height;
+	u32 mip_count;
+
+	// calc_texture_file_checksum of every byte after the header
+	u32 checksum;
+	u64 file_size;
+
+	// 1, or 6 for a cube map. 0 in version 1 files
+	u32 face_count;
+	u32 _padding[5];
+};
+
+struct texture_file_mip_t
+{
+	u32 width;
+	u32 height;
+
+	// bytes per row of texels, or of 4x4 blocks for the block compressed formats
+	u32 row_pitch;
+	u32 row_count;
+
+	// from the start of the file, always a multiple of TEXTURE_FILE_ALIGNMENT
+	u64 offset;
+	u64 size;
+};
+
+const char* get_texture_file_format_name(TextureFileFormat format);
+bool is_block_compressed(TextureFileFormat format);
+
+// bytes per 4x4 block, or per texel for RGBA8 and RGBA16F
+uint get_texture_file_format_size(TextureFileFormat format);
+uint calc_texture_file_row_pitch(TextureFileFormat format, uint width);
+uint calc_texture_file_row_count(TextureFileFormat format, uint height);
+
+// mips down to 1x1
+uint calc_full_mip_count(uint width, uint height);
+
+u32 calc_texture_file_checksum(const void* data, size_t size);
+
+// Cooked texture, laid out as
+//   texture_file_header_t
+//   texture_file_mip_t[face_count * mip_count]
+//   one aligned blob per mip, largest first, zero padded up to TEXTURE_FILE_ALIGNMENT
+//
+// A cube map stores every mip of its first face, then every mip of the next,
+// which is the order d3d numbers the subresources of a texture array in.
+//
+// Mips are stored with exactly the row pitch D3D wants for initial data, so a
+// loader points its subresources straight into the mapping and nothing is
+// decoded or copied on the way to the driver.
+class TextureFile
+{
+public:
+	MappedFile m_mapped_file;
+	const texture_file_header_t* m_header;
+	const texture_file_mip_t* m_mips;
+
+public:
+	TextureFile();
+	~TextureFile();
+
+	// false without a warning if the file doesn't exist or isn't a texture file, so callers can fall back to the source image.
+	// verifying the checksum touches every page of the file
+	bool open(const char* filename, bool verify_checksum = true);
+	void close();
+	bool is_open() const;
+
+	TextureFileFormat get_format() const;
+	uint get_width() const;
+	uint get_height() const;
+	uint get_mip_count() const;
+	uint get_face_count() const;
+	bool is_cube_map() const;
+	bool is_srgb() const;
+	bool is_normal_map() const;
+
+	const texture_file_mip_t& get_mip(uint mip, uint face = 0) const;
+	const byte* get_mip_data(uint mip, uint face = 0) const;
+
+	// every mip of every face
+	u64 get_data_size() const;
+
+private:
+	uint m_face_count;
+};
+
+// mip_data has one pointer per mip, each tightly packed at calc_texture_file_row_pitch
+bool write_texture_file(const char* filename,
+						TextureFileFormat format, u32 flags,
+						uint width, uint height,
+						uint mip_count, const byte* const* mip_data);
+
+// face_mip_data has mip_count pointers for each of the six faces, every mip of +x first
+bool write_cube_texture_file(const char* filename,
+							 TextureFileFormat format, u32 flags,
+							 uint size,
+							 uint mip_count, const byte* const* face_mip_data);
+
+// same name with TEXTURE_FILE_EXTENSION in place of its extension
+std::string make_texture_file_name(const std::string& image_filename);
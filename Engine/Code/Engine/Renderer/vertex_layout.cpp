@@ -0,0 +1,802 @@
+#include "Engine/Renderer/vertex_layout.h"
+#include "Engine/Renderer/MeshBuilder.hpp"
+#include "Engine/Renderer/Mesh.hpp"
+#include "Engine/Core/FileBinaryStream.hpp"
+#include "Engine/Core/Console.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Core/directory.h"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/bit.h"
+#include "Engine/Core/half_float.h"
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Profile/profiler.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+#define OCT_SNORM16_SCALE (32767.0f)
+
+//-----------------------------------------------------
+// Formats
+uint get_vertex_format_size(VertexFormat format)
+{
+	switch(format){
+		case VERTEX_FORMAT_FLOAT2:				return 8;
+		case VERTEX_FORMAT_FLOAT3:				return 12;
+		case VERTEX_FORMAT_FLOAT4:				return 16;
+		case VERTEX_FORMAT_HALF2:				return 4;
+		case VERTEX_FORMAT_UNORM8X4:			return 4;
+		case VERTEX_FORMAT_OCT_SNORM16X2:		return 4;
+		case VERTEX_FORMAT_OCT_SIGN_SNORM16X4:	return 8;
+		case VERTEX_FORMAT_UINT8X4:				return 4;
+		case VERTEX_FORMAT_UINT16X4:			return 8;
+		case VERTEX_FORMAT_UINT32X4:			return 16;
+		default:								return 0;
+	}
+}
+
+const char* get_vertex_format_name(VertexFormat format)
+{
+	switch(format){
+		case VERTEX_FORMAT_FLOAT2:				return "float2";
+		case VERTEX_FORMAT_FLOAT3:				return "float3";
+		case VERTEX_FORMAT_FLOAT4:				return "float4";
+		case VERTEX_FORMAT_HALF2:				return "half2";
+		case VERTEX_FORMAT_UNORM8X4:			return "unorm8x4";
+		case VERTEX_FORMAT_OCT_SNORM16X2:		return "oct16";
+		case VERTEX_FORMAT_OCT_SIGN_SNORM16X4:	return "oct16+sign";
+		case VERTEX_FORMAT_UINT8X4:				return "uint8x4";
+		case VERTEX_FORMAT_UINT16X4:			return "uint16x4";
+		case VERTEX_FORMAT_UINT32X4:			return "uint32x4";
+		default:								return "unknown";
+	}
+}
+
+const char* get_vertex_attribute_name(VertexAttribute attribute)
+{
+	switch(attribute){
+		case VERTEX_ATTRIBUTE_POSITION:		return "position";
+		case VERTEX_ATTRIBUTE_COLOR:		return "color";
+		case VERTEX_ATTRIBUTE_UV:			return "uv";
+		case VERTEX_ATTRIBUTE_NORMAL:		return "normal";
+		case VERTEX_ATTRIBUTE_TANGENT:		return "tangent";
+		case VERTEX_ATTRIBUTE_BITANGENT:	return "bitangent";
+		case VERTEX_ATTRIBUTE_BONE_WEIGHTS:	return "bone_weights";
+		case VERTEX_ATTRIBUTE_BONE_INDICES:	return "bone_indices";
+		default:							return "unknown";
+	}
+}
+
+static size_t get_attribute_member_offset(VertexAttribute attribute)
+{
+	switch(attribute){
+		case VERTEX_ATTRIBUTE_POSITION:		return offsetof(Vertex3, m_position);
+		case VERTEX_ATTRIBUTE_COLOR:		return offsetof(Vertex3, m_color);
+		case VERTEX_ATTRIBUTE_UV:			return offsetof(Vertex3, m_texCoords);
+		case VERTEX_ATTRIBUTE_NORMAL:		return offsetof(Vertex3, m_normal);
+		case VERTEX_ATTRIBUTE_TANGENT:		return offsetof(Vertex3, m_tangent);
+		case VERTEX_ATTRIBUTE_BITANGENT:	return offsetof(Vertex3, m_bitangent);
+		case VERTEX_ATTRIBUTE_BONE_WEIGHTS:	return offsetof(Vertex3, m_bone_weights);
+		case VERTEX_ATTRIBUTE_BONE_INDICES:	return offsetof(Vertex3, m_bone_indices);
+		default:							return 0;
+	}
+}
+
+static const Vector3& get_attribute_vector3(const Vertex3& vertex, VertexAttribute attribute)
+{
+	switch(attribute){
+		case VERTEX_ATTRIBUTE_TANGENT:		return vertex.m_tangent;
+		case VERTEX_ATTRIBUTE_BITANGENT:	return vertex.m_bitangent;
+		case VERTEX_ATTRIBUTE_POSITION:		return vertex.m_position;
+		default:							return vertex.m_normal;
+	}
+}
+
+//-----------------------------------------------------
+// VertexLayout
+VertexLayout::VertexLayout()
+	:m_stride(0)
+{
+}
+
+void VertexLayout::add_element(VertexAttribute attribute, VertexFormat format)
+{
+	vertex_element_t element;
+	element.attribute = attribute;
+	element.format = format;
+	element.offset = (u16)m_stride;
+
+	m_elements.push_back(element);
+	m_stride += get_vertex_format_size(format);
+}
+
+const vertex_element_t* VertexLayout::find_element(VertexAttribute attribute) const
+{
+	for(const vertex_element_t& element : m_elements){
+		if(element.attribute == attribute){
+			return &element;
+		}
+	}
+	return nullptr;
+}
+
+bool VertexLayout::has_attribute(VertexAttribute attribute) const
+{
+	return find_element(attribute) != nullptr;
+}
+
+std::string VertexLayout::to_string() const
+{
+	std::string result;
+	for(const vertex_element_t& element : m_elements){
+		if(!result.empty()){
+			result += " ";
+		}
+		result += Stringf("%s:%s", get_vertex_attribute_name(element.attribute), get_vertex_format_name(element.format));
+	}
+	return result;
+}
+
+VertexLayout make_full_vertex_layout()
+{
+	VertexLayout layout;
+	layout.add_element(VERTEX_ATTRIBUTE_POSITION, VERTEX_FORMAT_FLOAT3);
+	layout.add_element(VERTEX_ATTRIBUTE_COLOR, VERTEX_FORMAT_UNORM8X4);
+	layout.add_element(VERTEX_ATTRIBUTE_UV, VERTEX_FORMAT_FLOAT2);
+	layout.add_element(VERTEX_ATTRIBUTE_NORMAL, VERTEX_FORMAT_FLOAT3);
+	layout.add_element(VERTEX_ATTRIBUTE_TANGENT, VERTEX_FORMAT_FLOAT3);
+	layout.add_element(VERTEX_ATTRIBUTE_BITANGENT, VERTEX_FORMAT_FLOAT3);
+	layout.add_element(VERTEX_ATTRIBUTE_BONE_WEIGHTS, VERTEX_FORMAT_FLOAT4);
+	layout.add_element(VERTEX_ATTRIBUTE_BONE_INDICES, VERTEX_FORMAT_UINT32X4);
+	return layout;
+}
+
+VertexLayout make_vertex_layout(u8 load_flags, uint max_bone_index, bool quantize)
+{
+	bool has_normals = IS_BIT_SET(load_flags, NORMALS_LOADED);
+	bool has_tangents = IS_BIT_SET(load_flags, TANGENTS_LOADED);
+	bool has_bitangents = IS_BIT_SET(load_flags, BITANGENTS_LOADED);
+
+	VertexLayout layout;
+	layout.add_element(VERTEX_ATTRIBUTE_POSITION, VERTEX_FORMAT_FLOAT3);
+
+	if(IS_BIT_SET(load_flags, COLORS_LOADED)){
+		layout.add_element(VERTEX_ATTRIBUTE_COLOR, VERTEX_FORMAT_UNORM8X4);
+	}
+
+	if(IS_BIT_SET(load_flags, UVS_LOADED)){
+		layout.add_element(VERTEX_ATTRIBUTE_UV, quantize ? VERTEX_FORMAT_HALF2 : VERTEX_FORMAT_FLOAT2);
+	}
+
+	// normal has to come before the tangent, decoding the bitangent sign needs it
+	if(has_normals){
+		layout.add_element(VERTEX_ATTRIBUTE_NORMAL, quantize ? VERTEX_FORMAT_OCT_SNORM16X2 : VERTEX_FORMAT_FLOAT3);
+	}
+
+	if(!quantize){
+		if(has_tangents){
+			layout.add_element(VERTEX_ATTRIBUTE_TANGENT, VERTEX_FORMAT_FLOAT3);
+		}
+		if(has_bitangents){
+			layout.add_element(VERTEX_ATTRIBUTE_BITANGENT, VERTEX_FORMAT_FLOAT3);
+		}
+	}else if(has_tangents && has_normals){
+		// the bitangent collapses to a sign
+		layout.add_element(VERTEX_ATTRIBUTE_TANGENT, VERTEX_FORMAT_OCT_SIGN_SNORM16X4);
+	}else{
+		if(has_tangents){
+			layout.add_element(VERTEX_ATTRIBUTE_TANGENT, VERTEX_FORMAT_OCT_SNORM16X2);
+		}
+		if(has_bitangents){
+			layout.add_element(VERTEX_ATTRIBUTE_BITANGENT, VERTEX_FORMAT_OCT_SNORM16X2);
+		}
+	}
+
+	if(IS_BIT_SET(load_flags, BONES_LOADED)){
+		if(quantize){
+			layout.add_element(VERTEX_ATTRIBUTE_BONE_WEIGHTS, VERTEX_FORMAT_UNORM8X4);
+
+			VertexFormat index_format = VERTEX_FORMAT_UINT32X4;
+			if(max_bone_index <= 0xff){
+				index_format = VERTEX_FORMAT_UINT8X4;
+			}else if(max_bone_index <= 0xffff){
+				index_format = VERTEX_FORMAT_UINT16X4;
+			}
+			layout.add_element(VERTEX_ATTRIBUTE_BONE_INDICES, index_format);
+		}else{
+			layout.add_element(VERTEX_ATTRIBUTE_BONE_WEIGHTS, VERTEX_FORMAT_FLOAT4);
+			layout.add_element(VERTEX_ATTRIBUTE_BONE_INDICES, VERTEX_FORMAT_UINT32X4);
+		}
+	}
+
+	return layout;
+}
+
+u8 calc_vertex_load_flags(const Vertex3* vertexes, uint vertex_count, uint* out_max_bone_index)
+{
+	u8 load_flags = 0;
+	uint max_bone_index = 0;
+
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& vertex = vertexes[vert_idx];
+
+		if(!(vertex.m_color == Rgba::WHITE)){
+			SET_BIT(load_flags, COLORS_LOADED);
+		}
+		if(vertex.m_texCoords != Vector2::ZERO){
+			SET_BIT(load_flags, UVS_LOADED);
+		}
+		if(vertex.m_normal != -Vector3::Z_AXIS){
+			SET_BIT(load_flags, NORMALS_LOADED);
+		}
+		if(vertex.m_tangent != Vector3::X_AXIS){
+			SET_BIT(load_flags, TANGENTS_LOADED);
+		}
+		if(vertex.m_bitangent != Vector3::Y_AXIS){
+			SET_BIT(load_flags, BITANGENTS_LOADED);
+		}
+
+		for(uint influence = 0; influence < 4; ++influence){
+			if(vertex.m_bone_weights.values[influence] > 0.0f){
+				SET_BIT(load_flags, BONES_LOADED);
+				max_bone_index = Max(max_bone_index, vertex.m_bone_indices.values[influence]);
+			}
+		}
+	}
+
+	if(out_max_bone_index != nullptr){
+		*out_max_bone_index = max_bone_index;
+	}
+	return load_flags;
+}
+
+//-----------------------------------------------------
+// Octahedral
+static int quantize_snorm16(float value)
+{
+	return (int)lrintf(Clamp(value, -1.0f, 1.0f) * OCT_SNORM16_SCALE);
+}
+
+static void oct_encode(const Vector3& v, int* out_x, int* out_y)
+{
+	float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	float inv = 1.0f / Max(l1, 1e-20f);
+	float px = v.x * inv;
+	float py = v.y * inv;
+
+	if(v.z < 0.0f){
+		float fold_x = (1.0f - fabsf(py)) * (px >= 0.0f ? 1.0f : -1.0f);
+		float fold_y = (1.0f - fabsf(px)) * (py >= 0.0f ? 1.0f : -1.0f);
+		px = fold_x;
+		py = fold_y;
+	}
+
+	*out_x = quantize_snorm16(px);
+	*out_y = quantize_snorm16(py);
+}
+
+static Vector3 oct_decode(i16 ox, i16 oy)
+{
+	float x = Max((float)ox / OCT_SNORM16_SCALE, -1.0f);
+	float y = Max((float)oy / OCT_SNORM16_SCALE, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	float t = Max(-z, 0.0f);
+	x += (x >= 0.0f) ? -t : t;
+	y += (y >= 0.0f) ? -t : t;
+
+	Vector3 result(x, y, z);
+	result.Normalize();
+	return result;
+}
+
+// four vectors at once, returns the quantized x and y in each lane
+static void oct_encode_sse(__m128 x, __m128 y, __m128 z, __m128i* out_x, __m128i* out_y)
+{
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 neg_one = _mm_set1_ps(-1.0f);
+	const __m128 scale = _mm_set1_ps(OCT_SNORM16_SCALE);
+
+	__m128 abs_x = _mm_andnot_ps(sign_mask, x);
+	__m128 abs_y = _mm_andnot_ps(sign_mask, y);
+	__m128 abs_z = _mm_andnot_ps(sign_mask, z);
+	__m128 l1 = _mm_max_ps(_mm_add_ps(_mm_add_ps(abs_x, abs_y), abs_z), _mm_set1_ps(1e-20f));
+	__m128 inv = _mm_div_ps(one, l1);
+
+	__m128 px = _mm_mul_ps(x, inv);
+	__m128 py = _mm_mul_ps(y, inv);
+
+	// lower hemisphere folds over the diagonals, -0 counts as positive like the scalar path
+	__m128 x_positive = _mm_cmpge_ps(px, _mm_setzero_ps());
+	__m128 y_positive = _mm_cmpge_ps(py, _mm_setzero_ps());
+	__m128 sign_x = _mm_or_ps(_mm_and_ps(x_positive, one), _mm_andnot_ps(x_positive, neg_one));
+	__m128 sign_y = _mm_or_ps(_mm_and_ps(y_positive, one), _mm_andnot_ps(y_positive, neg_one));
+	__m128 fold_x = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, py)), sign_x);
+	__m128 fold_y = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, px)), sign_y);
+
+	__m128 is_lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+	px = _mm_or_ps(_mm_and_ps(is_lower, fold_x), _mm_andnot_ps(is_lower, px));
+	py = _mm_or_ps(_mm_and_ps(is_lower, fold_y), _mm_andnot_ps(is_lower, py));
+
+	*out_x = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(px, neg_one), one), scale));
+	*out_y = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(py, neg_one), one), scale));
+}
+
+// +1 when the bitangent agrees with cross(tangent, normal)
+static float calc_bitangent_sign(const Vertex3& vertex)
+{
+	return (DotProduct(CrossProduct(vertex.m_tangent, vertex.m_normal), vertex.m_bitangent) < 0.0f) ? -1.0f : 1.0f;
+}
+
+//-----------------------------------------------------
+// Encoding
+static void encode_copy(const Vertex3* vertexes, uint vertex_count, size_t member_offset, uint size, byte* out, uint stride)
+{
+	const byte* src = (const byte*)vertexes + member_offset;
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		memcpy(out + (size_t)vert_idx * stride, src + (size_t)vert_idx * sizeof(Vertex3), size);
+	}
+}
+
+static void encode_half2(const Vertex3* vertexes, uint vertex_count, byte* out, uint stride, bool use_simd)
+{
+	uint vert_idx = 0;
+
+	if(use_simd){
+		for(; vert_idx + 2 <= vertex_count; vert_idx += 2){
+			const Vector2& uv0 = vertexes[vert_idx].m_texCoords;
+			const Vector2& uv1 = vertexes[vert_idx + 1].m_texCoords;
+
+			__m128i halves = float_to_half_sse(_mm_setr_ps(uv0.x, uv0.y, uv1.x, uv1.y));
+			__m128i packed = pack_u16_lanes(halves, halves);
+
+			u32 pairs[4];
+			_mm_storeu_si128((__m128i*)pairs, packed);
+			memcpy(out + (size_t)vert_idx * stride, &pairs[0], sizeof(u32));
+			memcpy(out + (size_t)(vert_idx + 1) * stride, &pairs[1], sizeof(u32));
+		}
+	}
+
+	for(; vert_idx < vertex_count; ++vert_idx){
+		const Vector2& uv = vertexes[vert_idx].m_texCoords;
+		u16 halves[2] = { float_to_half(uv.x), float_to_half(uv.y) };
+		memcpy(out + (size_t)vert_idx * stride, halves, sizeof(halves));
+	}
+}
+
+static void write_oct(byte* dst, int x, int y, bool with_sign, float sign)
+{
+	i16 packed[4] = { (i16)x, (i16)y, 0, (i16)(sign < 0.0f ? -32767 : 32767) };
+	memcpy(dst, packed, with_sign ? 4 * sizeof(i16) : 2 * sizeof(i16));
+}
+
+static void encode_oct(const Vertex3* vertexes, uint vertex_count, VertexAttribute attribute, bool with_sign, byte* out, uint stride, bool use_simd)
+{
+	uint vert_idx = 0;
+
+	if(use_simd){
+		for(; vert_idx + 4 <= vertex_count; vert_idx += 4){
+			// vertexes are 92 byte structs, so gather into soa lanes first
+			float x[4], y[4], z[4], sign[4];
+			for(uint lane = 0; lane < 4; ++lane){
+				const Vector3& v = get_attribute_vector3(vertexes[vert_idx + lane], attribute);
+				x[lane] = v.x;
+				y[lane] = v.y;
+				z[lane] = v.z;
+			}
+
+			if(with_sign){
+				float nx[4], ny[4], nz[4], bx[4], by[4], bz[4];
+				for(uint lane = 0; lane < 4; ++lane){
+					const Vertex3& vertex = vertexes[vert_idx + lane];
+					nx[lane] = vertex.m_normal.x;
+					ny[lane] = vertex.m_normal.y;
+					nz[lane] = vertex.m_normal.z;
+					bx[lane] = vertex.m_bitangent.x;
+					by[lane] = vertex.m_bitangent.y;
+					bz[lane] = vertex.m_bitangent.z;
+				}
+
+				__m128 tx = _mm_loadu_ps(x), ty = _mm_loadu_ps(y), tz = _mm_loadu_ps(z);
+				__m128 n_x = _mm_loadu_ps(nx), n_y = _mm_loadu_ps(ny), n_z = _mm_loadu_ps(nz);
+
+				// dot(cross(t, n), b)
+				__m128 cx = _mm_sub_ps(_mm_mul_ps(ty, n_z), _mm_mul_ps(tz, n_y));
+				__m128 cy = _mm_sub_ps(_mm_mul_ps(tz, n_x), _mm_mul_ps(tx, n_z));
+				__m128 cz = _mm_sub_ps(_mm_mul_ps(tx, n_y), _mm_mul_ps(ty, n_x));
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_loadu_ps(bx)), _mm_mul_ps(cy, _mm_loadu_ps(by))), _mm_mul_ps(cz, _mm_loadu_ps(bz)));
+				__m128 is_negative = _mm_cmplt_ps(d, _mm_setzero_ps());
+				_mm_storeu_ps(sign, _mm_or_ps(_mm_and_ps(is_negative, _mm_set1_ps(-1.0f)), _mm_andnot_ps(is_negative, _mm_set1_ps(1.0f))));
+			}
+
+			__m128i qx, qy;
+			oct_encode_sse(_mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z), &qx, &qy);
+
+			int ox[4], oy[4];
+			_mm_storeu_si128((__m128i*)ox, qx);
+			_mm_storeu_si128((__m128i*)oy, qy);
+			for(uint lane = 0; lane < 4; ++lane){
+				write_oct(out + (size_t)(vert_idx + lane) * stride, ox[lane], oy[lane], with_sign, with_sign ? sign[lane] : 1.0f);
+			}
+		}
+	}
+
+	for(; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& vertex = vertexes[vert_idx];
+		int ox, oy;
+		oct_encode(get_attribute_vector3(vertex, attribute), &ox, &oy);
+		write_oct(out + (size_t)vert_idx * stride, ox, oy, with_sign, with_sign ? calc_bitangent_sign(vertex) : 1.0f);
+	}
+}
+
+// rounding can leave the bytes summing to 254 or 256, the error goes to the biggest weight
+static void fix_unorm8_weight_sum(const Vector4& weights, u8* bytes)
+{
+	if(weights.x + weights.y + weights.z + weights.w <= 0.0f){
+		return;
+	}
+
+	int total = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+	uint largest = 0;
+	for(uint influence = 1; influence < 4; ++influence){
+		if(bytes[influence] > bytes[largest]){
+			largest = influence;
+		}
+	}
+
+	bytes[largest] = (u8)Clamp((int)bytes[largest] + (255 - total), 0, 255);
+}
+
+static void encode_weights_unorm8(const Vertex3* vertexes, uint vertex_count, byte* out, uint stride, bool use_simd)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vector4& weights = vertexes[vert_idx].m_bone_weights;
+
+		u8 bytes[4];
+		if(use_simd){
+			__m128 w = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(weights.values), zero), one);
+			__m128i q = _mm_cvtps_epi32(_mm_mul_ps(w, scale));
+			q = _mm_packs_epi32(q, q);
+			q = _mm_packus_epi16(q, q);
+			int packed = _mm_cvtsi128_si32(q);
+			memcpy(bytes, &packed, sizeof(bytes));
+		}else{
+			for(uint influence = 0; influence < 4; ++influence){
+				bytes[influence] = (u8)lrintf(Clamp(weights.values[influence], 0.0f, 1.0f) * 255.0f);
+			}
+		}
+
+		fix_unorm8_weight_sum(weights, bytes);
+		memcpy(out + (size_t)vert_idx * stride, bytes, sizeof(bytes));
+	}
+}
+
+static void encode_bone_indices(const Vertex3* vertexes, uint vertex_count, VertexFormat format, byte* out, uint stride, bool use_simd)
+{
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const UIntVector4& indices = vertexes[vert_idx].m_bone_indices;
+		byte* dst = out + (size_t)vert_idx * stride;
+
+		if(format == VERTEX_FORMAT_UINT8X4){
+			u8 packed[4];
+			if(use_simd){
+				__m128i q = _mm_loadu_si128((const __m128i*)indices.values);
+				q = _mm_packs_epi32(q, q);
+				q = _mm_packus_epi16(q, q);
+				int bytes = _mm_cvtsi128_si32(q);
+				memcpy(packed, &bytes, sizeof(packed));
+			}else{
+				for(uint influence = 0; influence < 4; ++influence){
+					packed[influence] = (u8)Min(indices.values[influence], 0xffU);
+				}
+			}
+			memcpy(dst, packed, sizeof(packed));
+		}else{
+			u16 packed[4];
+			if(use_simd){
+				// no unsigned 32 -> 16 pack in sse2, bias into signed range and back
+				__m128i q = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)indices.values), _mm_set1_epi32(0x8000));
+				q = _mm_xor_si128(_mm_packs_epi32(q, q), _mm_set1_epi16((short)0x8000));
+				_mm_storel_epi64((__m128i*)packed, q);
+			}else{
+				for(uint influence = 0; influence < 4; ++influence){
+					packed[influence] = (u16)Min(indices.values[influence], 0xffffU);
+				}
+			}
+			memcpy(dst, packed, sizeof(packed));
+		}
+	}
+}
+
+void encode_vertexes(const VertexLayout& layout, const Vertex3* vertexes, uint vertex_count, void* out, bool use_simd)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	byte* out_bytes = (byte*)out;
+	for(const vertex_element_t& element : layout.m_elements){
+		byte* dst = out_bytes + element.offset;
+
+		switch(element.format){
+			case VERTEX_FORMAT_HALF2:
+				encode_half2(vertexes, vertex_count, dst, layout.m_stride, use_simd);
+				break;
+
+			case VERTEX_FORMAT_OCT_SNORM16X2:
+				encode_oct(vertexes, vertex_count, element.attribute, false, dst, layout.m_stride, use_simd);
+				break;
+
+			case VERTEX_FORMAT_OCT_SIGN_SNORM16X4:
+				encode_oct(vertexes, vertex_count, element.attribute, true, dst, layout.m_stride, use_simd);
+				break;
+
+			case VERTEX_FORMAT_UNORM8X4:
+				if(element.attribute == VERTEX_ATTRIBUTE_BONE_WEIGHTS){
+					encode_weights_unorm8(vertexes, vertex_count, dst, layout.m_stride, use_simd);
+				}else{
+					encode_copy(vertexes, vertex_count, get_attribute_member_offset(element.attribute), 4, dst, layout.m_stride);
+				}
+				break;
+
+			case VERTEX_FORMAT_UINT8X4:
+			case VERTEX_FORMAT_UINT16X4:
+				encode_bone_indices(vertexes, vertex_count, element.format, dst, layout.m_stride, use_simd);
+				break;
+
+			default:
+				// float and full width formats are the Vertex3 members as is
+				encode_copy(vertexes, vertex_count, get_attribute_member_offset(element.attribute), get_vertex_format_size(element.format), dst, layout.m_stride);
+				break;
+		}
+	}
+}
+
+//-----------------------------------------------------
+// Decoding, only used by tools and checks, the gpu does this at draw time
+void decode_vertexes(const VertexLayout& layout, const void* data, uint vertex_count, Vertex3* out_vertexes)
+{
+	PROFILE_SCOPE_FUNCTION();
+
+	const byte* bytes = (const byte*)data;
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		Vertex3& vertex = out_vertexes[vert_idx];
+		const byte* src_vertex = bytes + (size_t)vert_idx * layout.m_stride;
+
+		for(const vertex_element_t& element : layout.m_elements){
+			const byte* src = src_vertex + element.offset;
+
+			switch(element.format){
+				case VERTEX_FORMAT_HALF2:{
+					u16 halves[2];
+					memcpy(halves, src, sizeof(halves));
+					vertex.m_texCoords = Vector2(half_to_float(halves[0]), half_to_float(halves[1]));
+					break;
+				}
+
+				case VERTEX_FORMAT_OCT_SNORM16X2:
+				case VERTEX_FORMAT_OCT_SIGN_SNORM16X4:{
+					i16 packed[4];
+					memcpy(packed, src, get_vertex_format_size(element.format));
+
+					Vector3 v = oct_decode(packed[0], packed[1]);
+					if(element.attribute == VERTEX_ATTRIBUTE_TANGENT){
+						vertex.m_tangent = v;
+					}else if(element.attribute == VERTEX_ATTRIBUTE_BITANGENT){
+						vertex.m_bitangent = v;
+					}else{
+						vertex.m_normal = v;
+					}
+
+					if(element.format == VERTEX_FORMAT_OCT_SIGN_SNORM16X4){
+						float sign = (packed[3] < 0) ? -1.0f : 1.0f;
+						vertex.m_bitangent = sign * CrossProduct(vertex.m_tangent, vertex.m_normal);
+					}
+					break;
+				}
+
+				case VERTEX_FORMAT_UNORM8X4:
+					if(element.attribute == VERTEX_ATTRIBUTE_BONE_WEIGHTS){
+						vertex.m_bone_weights = Vector4(src[0] / 255.0f, src[1] / 255.0f, src[2] / 255.0f, src[3] / 255.0f);
+					}else{
+						memcpy(&vertex.m_color, src, sizeof(Rgba));
+					}
+					break;
+
+				case VERTEX_FORMAT_UINT8X4:
+					vertex.m_bone_indices = UIntVector4(src[0], src[1], src[2], src[3]);
+					break;
+
+				case VERTEX_FORMAT_UINT16X4:{
+					u16 packed[4];
+					memcpy(packed, src, sizeof(packed));
+					vertex.m_bone_indices = UIntVector4(packed[0], packed[1], packed[2], packed[3]);
+					break;
+				}
+
+				default:
+					memcpy((byte*)&vertex + get_attribute_member_offset(element.attribute), src, get_vertex_format_size(element.format));
+					break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------
+// Size report
+vertex_size_report_t make_vertex_size_report(const VertexLayout& layout, uint vertex_count, uint index_count)
+{
+	vertex_size_report_t report;
+	report.vertex_count = vertex_count;
+	report.index_count = index_count;
+	report.full_stride = sizeof(Vertex3);
+	report.packed_stride = layout.m_stride;
+	report.full_index_size = sizeof(uint);
+	report.packed_index_size = (vertex_count <= 0x10000) ? sizeof(u16) : sizeof(uint);
+	return report;
+}
+
+static double to_kb(u64 bytes)
+{
+	return (double)bytes / 1024.0;
+}
+
+void print_vertex_size_report(const char* name, const VertexLayout& layout, const vertex_size_report_t& report)
+{
+	u64 full_vertex_bytes = (u64)report.vertex_count * report.full_stride;
+	u64 packed_vertex_bytes = (u64)report.vertex_count * report.packed_stride;
+	u64 full_index_bytes = (u64)report.index_count * report.full_index_size;
+	u64 packed_index_bytes = (u64)report.index_count * report.packed_index_size;
+
+	// without an index buffer every vertex is fetched once per draw
+	uint fetch_count = (report.index_count > 0) ? report.index_count : report.vertex_count;
+	u64 full_fetch_worst = (u64)fetch_count * report.full_stride;
+	u64 packed_fetch_worst = (u64)fetch_count * report.packed_stride;
+
+	u64 full_total = full_vertex_bytes + full_index_bytes;
+	u64 packed_total = packed_vertex_bytes + packed_index_bytes;
+
+	console_info("----%s (%u vertexes, %u indexes)----", name, report.vertex_count, report.index_count);
+	console_info("layout:   %s", layout.to_string().c_str());
+	console_info("stride:   %u -> %u bytes", report.full_stride, report.packed_stride);
+	console_info("vertexes: %.1f -> %.1f KB", to_kb(full_vertex_bytes), to_kb(packed_vertex_bytes));
+	console_info("indexes:  %.1f -> %.1f KB", to_kb(full_index_bytes), to_kb(packed_index_bytes));
+	console_info("total:    %.1f -> %.1f KB (%.1f%%)", to_kb(full_total), to_kb(packed_total), (full_total > 0) ? (100.0 * (double)packed_total / (double)full_total) : 100.0);
+	console_info("fetch per draw: best %.1f -> %.1f KB, worst %.1f -> %.1f KB", to_kb(full_vertex_bytes), to_kb(packed_vertex_bytes), to_kb(full_fetch_worst), to_kb(packed_fetch_worst));
+}
+
+//-----------------------------------------------------
+// Commands
+static void report_mesh_file_sizes(const std::string& mesh_filename)
+{
+	std::vector<Vertex3> vertexes;
+	std::vector<uint> indexes;
+	std::vector<draw_instruction_t> draw_instructions;
+
+	FileBinaryStream fbs;
+	if(!fbs.open_for_read(mesh_filename.c_str())){
+		console_error("Failed to open [%s]", mesh_filename.c_str());
+		return;
+	}
+	read_mesh_data(fbs, &vertexes, &indexes, &draw_instructions);
+	fbs.close();
+
+	uint max_bone_index;
+	u8 load_flags = calc_vertex_load_flags(vertexes.data(), (uint)vertexes.size(), &max_bone_index);
+	VertexLayout layout = make_vertex_layout(load_flags, max_bone_index, true);
+
+	vertex_size_report_t report = make_vertex_size_report(layout, (uint)vertexes.size(), (uint)indexes.size());
+	print_vertex_size_report(mesh_filename.c_str(), layout, report);
+}
+
+COMMAND(vertex_size_report, "[string:mesh_filename] Prints the quantized layout and size savings for a .mesh, or every .mesh in Data/Meshes")
+{
+	if(!args.is_at_end()){
+		report_mesh_file_sizes(args.next_string_arg());
+		return;
+	}
+
+	std::vector<std::string> filenames = find_files_in_directory("Data/Meshes", "*.mesh");
+	for(const std::string& filename : filenames){
+		report_mesh_file_sizes("Data/Meshes/" + filename);
+	}
+}
+
+static Vector3 make_random_unit_vector()
+{
+	Vector3 v(GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f), GetRandomFloatInRange(-1.0f, 1.0f));
+	if(v.CalcLengthSquared() < 0.0001f){
+		return Vector3::X_AXIS;
+	}
+	v.Normalize();
+	return v;
+}
+
+static float calc_angle_error_degrees(const Vector3& a, const Vector3& b)
+{
+	float cos_angle = Clamp(DotProduct(a, b), -1.0f, 1.0f);
+	return ConvertRadiansToDegrees(acosf(cos_angle));
+}
+
+COMMAND(vertex_pack_benchmark, "[uint:vertex_count] Packs random skinned vertexes to the quantized layout with SSE and scalar code and checks the round trip")
+{
+	uint vertex_count = 1000000;
+	if(!args.is_at_end()){
+		vertex_count = Max(1U, args.next_uint_arg());
+	}
+
+	std::vector<Vertex3> vertexes(vertex_count);
+	for(Vertex3& vertex : vertexes){
+		vertex.m_position = Vector3(GetRandomFloatInRange(-10.0f, 10.0f), GetRandomFloatInRange(-10.0f, 10.0f), GetRandomFloatInRange(-10.0f, 10.0f));
+		vertex.m_color = Rgba((unsigned char)(GetRandomFloatZeroToOne() * 255.0f), 128, 64, 255);
+		vertex.m_texCoords = Vector2(GetRandomFloatInRange(-2.0f, 2.0f), GetRandomFloatInRange(-2.0f, 2.0f));
+		vertex.m_normal = make_random_unit_vector();
+
+		Vector3 tangent = CrossProduct(vertex.m_normal, make_random_unit_vector());
+		vertex.m_tangent = (tangent.CalcLengthSquared() > 0.0001f) ? tangent.Normalized() : Vector3::X_AXIS;
+		vertex.m_bitangent = ((GetRandomFloatZeroToOne() < 0.5f) ? -1.0f : 1.0f) * CrossProduct(vertex.m_tangent, vertex.m_normal);
+
+		Vector4 weights(GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne(), GetRandomFloatZeroToOne());
+		float weight_sum = weights.x + weights.y + weights.z + weights.w;
+		vertex.m_bone_weights = Vector4(weights.x / weight_sum, weights.y / weight_sum, weights.z / weight_sum, weights.w / weight_sum);
+		vertex.m_bone_indices = UIntVector4((uint)(GetRandomFloatZeroToOne() * 199.0f), (uint)(GetRandomFloatZeroToOne() * 199.0f), (uint)(GetRandomFloatZeroToOne() * 199.0f), (uint)(GetRandomFloatZeroToOne() * 199.0f));
+	}
+
+	u8 load_flags = COLORS_LOADED | UVS_LOADED | NORMALS_LOADED | TANGENTS_LOADED | BITANGENTS_LOADED | BONES_LOADED;
+	VertexLayout layout = make_vertex_layout(load_flags, 199, true);
+
+	std::vector<byte> scalar_packed((size_t)vertex_count * layout.m_stride);
+	std::vector<byte> simd_packed((size_t)vertex_count * layout.m_stride);
+
+	double start = get_current_time_seconds();
+	encode_vertexes(layout, vertexes.data(), vertex_count, scalar_packed.data(), false);
+	double scalar_seconds = get_current_time_seconds() - start;
+
+	start = get_current_time_seconds();
+	encode_vertexes(layout, vertexes.data(), vertex_count, simd_packed.data(), true);
+	double simd_seconds = get_current_time_seconds() - start;
+
+	std::vector<Vertex3> decoded(vertexes);
+	decode_vertexes(layout, simd_packed.data(), vertex_count, decoded.data());
+
+	float max_normal_error = 0.0f;
+	float max_tangent_error = 0.0f;
+	float max_bitangent_error = 0.0f;
+	float max_uv_error = 0.0f;
+	float max_weight_error = 0.0f;
+	uint index_mismatches = 0;
+	for(uint vert_idx = 0; vert_idx < vertex_count; ++vert_idx){
+		const Vertex3& original = vertexes[vert_idx];
+		const Vertex3& result = decoded[vert_idx];
+
+		max_normal_error = Max(max_normal_error, calc_angle_error_degrees(original.m_normal, result.m_normal));
+		max_tangent_error = Max(max_tangent_error, calc_angle_error_degrees(original.m_tangent, result.m_tangent));
+		max_bitangent_error = Max(max_bitangent_error, calc_angle_error_degrees(original.m_bitangent.Normalized(), result.m_bitangent.Normalized()));
+		max_uv_error = Max(max_uv_error, Max(fabsf(original.m_texCoords.x - result.m_texCoords.x), fabsf(original.m_texCoords.y - result.m_texCoords.y)));
+		for(uint influence = 0; influence < 4; ++influence){
+			max_weight_error = Max(max_weight_error, fabsf(original.m_bone_weights.values[influence] - result.m_bone_weights.values[influence]));
+		}
+		if(!(original.m_bone_indices == result.m_bone_indices)){
+			index_mismatches++;
+		}
+	}
+
+	console_info("----Vertex packing (%u vertexes)----", vertex_count);
+	console_info("layout:  %s", layout.to_string().c_str());
+	console_info("stride:  %u -> %u bytes", (uint)sizeof(Vertex3), layout.m_stride);
+	console_info("scalar:  %.2f Mverts/s", ((double)vertex_count / scalar_seconds) / 1000000.0);
+	console_info("sse:     %.2f Mverts/s", ((double)vertex_count / simd_seconds) / 1000000.0);
+	console_info("max error: normal %.4f deg, tangent %.4f deg, bitangent %.4f deg, uv %f, weight %f", max_normal_error, max_tangent_error, max_bitangent_error, max_uv_error, max_weight_error);
+
+	if(memcmp(scalar_packed.data(), simd_packed.data(), simd_packed.size()) != 0){
+		console_error("SSE packing does not match the scalar packing");
+	}else if(index_mismatches > 0){
+		console_error("%u vertexes lost their bone indices", index_mismatches);
+	}else{
+		console_info("SSE packing matches scalar, bone indices round trip exactly");
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Engine/Core/types.h"
+#include "Engine/Renderer/Vertex3.hpp"
+
+#include <string>
+#include <vector>
+
+enum VertexAttribute : u8
+{
+	VERTEX_ATTRIBUTE_POSITION,
+	VERTEX_ATTRIBUTE_COLOR,
+	VERTEX_ATTRIBUTE_UV,
+	VERTEX_ATTRIBUTE_NORMAL,
+	VERTEX_ATTRIBUTE_TANGENT,
+	VERTEX_ATTRIBUTE_BITANGENT,
+	VERTEX_ATTRIBUTE_BONE_WEIGHTS,
+	VERTEX_ATTRIBUTE_BONE_INDICES,
+	NUM_VERTEX_ATTRIBUTES
+};
+
+enum VertexFormat : u8
+{
+	VERTEX_FORMAT_FLOAT2,
+	VERTEX_FORMAT_FLOAT3,
+	VERTEX_FORMAT_FLOAT4,
+	VERTEX_FORMAT_HALF2,
+	VERTEX_FORMAT_UNORM8X4,
+
+	// octahedral unit vector, two snorm16s
+	VERTEX_FORMAT_OCT_SNORM16X2,
+
+	// octahedral tangent in xy, z unused, w is the bitangent sign (+-1 snorm)
+	// so bitangent = w * cross(tangent, normal)
+	VERTEX_FORMAT_OCT_SIGN_SNORM16X4,
+
+	VERTEX_FORMAT_UINT8X4,
+	VERTEX_FORMAT_UINT16X4,
+	VERTEX_FORMAT_UINT32X4,
+	NUM_VERTEX_FORMATS
+};
+
+uint get_vertex_format_size(VertexFormat format);
+const char* get_vertex_format_name(VertexFormat format);
+const char* get_vertex_attribute_name(VertexAttribute attribute);
+
+struct vertex_element_t
+{
+	VertexAttribute attribute;
+	VertexFormat format;
+	u16 offset;
+};
+
+// Describes one interleaved vertex stream: which Vertex3 attributes it holds,
+// how each one is encoded and where it sits in the vertex.
+class VertexLayout
+{
+public:
+	std::vector<vertex_element_t> m_elements;
+	uint m_stride;
+
+public:
+	VertexLayout();
+
+	void add_element(VertexAttribute attribute, VertexFormat format);
+	const vertex_element_t* find_element(VertexAttribute attribute) const;
+	bool has_attribute(VertexAttribute attribute) const;
+
+	std::string to_string() const;
+};
+
+// the uncompressed layout of Vertex3 itself
+VertexLayout make_full_vertex_layout();
+
+// only the attributes in load_flags (the MeshBuilder *_LOADED bits), positions are always in.
+// bone indexes pick 8 or 16 bits from max_bone_index when quantized
+VertexLayout make_vertex_layout(u8 load_flags, uint max_bone_index, bool quantize);
+
+// load flags for vertexes that didn't come through a MeshBuilder, an attribute
+// counts as loaded when any vertex differs from the builder's default stamp
+u8 calc_vertex_load_flags(const Vertex3* vertexes, uint vertex_count, uint* out_max_bone_index = nullptr);
+
+// out must hold vertex_count * layout.m_stride bytes
+void encode_vertexes(const VertexLayout& layout, const Vertex3* vertexes, uint vertex_count, void* out, bool use_simd = true);
+
+// attributes not in the layout are left alone
+void decode_vertexes(const VertexLayout& layout, const void* data, uint vertex_count, Vertex3* out_vertexes);
+
+struct vertex_size_report_t
+{
+	uint vertex_count;
+	uint index_count;
+	uint full_stride;
+	uint packed_stride;
+	uint full_index_size;
+	uint packed_index_size;
+};
+
+// packed indexes are 16 bits whenever every vertex is reachable with them
+vertex_size_report_t make_vertex_size_report(const VertexLayout& layout, uint vertex_count, uint index_count);
+
+// memory plus vertex fetch per draw, best case (every vertex fetched once) and worst (once per index)
+void print_vertex_size_report(const char* name, const VertexLayout& layout, const vertex_size_report_t& report);
@@ -3,6 +3,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <stdint.h>
+#include <intrin.h>
 
 __forceinline
 unsigned int atomic_add(unsigned int volatile *ptr, unsigned int const value)
@@ -32,4 +33,22 @@ template <typename T>
 __forceinline T* compare_and_set_ptr(T *volatile *ptr, T *comparand, T *value)
 {
     return (T*)::InterlockedCompareExchangePointerNoFence((PVOID volatile*)ptr, (PVOID)value, (PVOID)comparand);
+}
+
+// Aligned 32 bit loads and stores are atomic on x86/x64 and the cpu won't move
+// loads past loads or stores past stores, so all these have to stop is the
+// compiler reordering around them.
+__forceinline
+unsigned int atomic_load_acquire(unsigned int const volatile *ptr)
+{
+    unsigned int value = *ptr;
+    _ReadWriteBarrier();
+    return value;
+}
+
+__forceinline
+void atomic_store_release(unsigned int volatile *ptr, unsigned int const value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Engine/Thread/atomic.h"
+
+// keeps the two ends of a queue from sharing a cache line
+#define CACHE_LINE_SIZE 64
+
+// Fixed size ring for handing things from exactly one producing thread to exactly
+// one consuming thread without a lock. Each end only ever writes its own counter,
+// the other side reads it to see how far it may go. CAPACITY has to be a power
+// of two, push fails when it's full rather than growing.
+template <typename T, unsigned int CAPACITY>
+class SPSCQueue
+{
+    static_assert((CAPACITY > 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "SPSCQueue capacity must be a power of two");
+
+public:
+    SPSCQueue();
+
+    // producer only
+    bool push(const T& v);
+
+    // consumer only
+    bool pop(T* out);
+
+    // a snapshot, the other end can move while it is being looked at
+    unsigned int size() const;
+    bool empty() const;
+
+private:
+    // padded rather than aligned, heap allocations don't honour the alignment
+    unsigned int volatile m_head;   // next to pop, written by the consumer
+    char m_head_padding[CACHE_LINE_SIZE - sizeof(unsigned int)];
+
+    unsigned int volatile m_tail;   // next to push, written by the producer
+    char m_tail_padding[CACHE_LINE_SIZE - sizeof(unsigned int)];
+
+    T m_items[CAPACITY];
+};
+
+template <typename T, unsigned int CAPACITY>
+SPSCQueue<T, CAPACITY>::SPSCQueue()
+    : m_head(0)
+    , m_tail(0)
+{
+}
+
+template <typename T, unsigned int CAPACITY>
+bool SPSCQueue<T, CAPACITY>::push(const T& v)
+{
+    unsigned int tail = m_tail;
+    unsigned int head = atomic_load_acquire(&m_head);
+    if((tail - head) == CAPACITY){
+        return false;
+    }
+
+    m_items[tail & (CAPACITY - 1)] = v;
+    atomic_store_release(&m_tail, tail + 1);
+    return true;
+}
+
+template <typename T, unsigned int CAPACITY>
+bool SPSCQueue<T, CAPACITY>::pop(T* out)
+{
+    unsigned int head = m_head;
+    unsigned int tail = atomic_load_acquire(&m_tail);
+    if(head == tail){
+        return false;
+    }
+
+    *out = m_items[head & (CAPACITY - 1)];
+    atomic_store_release(&m_head, head + 1);
+    return true;
+}
+
+template <typename T, unsigned int CAPACITY>
+unsigned int SPSCQueue<T, CAPACITY>::size() const
+{
+    return atomic_load_acquire(&m_tail) - atomic_load_acquire(&m_head);
+}
+
+template <typename T, unsigned int CAPACITY>
+bool SPSCQueue<T, CAPACITY>::empty() const
+{
+    return (0 == size());
+}
\ No newline at end of file
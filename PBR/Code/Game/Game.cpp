@@ -17,6 +17,7 @@
 #include "Engine/Renderer/PointLight.h"
 #include "Engine/Renderer/SpotLight.h"
 #include "Engine/Renderer/skybox.h"
+#include "Engine/Renderer/ibl_baker.h"
 
 #include "Engine/RHI/RHIOutput.hpp"
 #include "Engine/RHI/RHIDevice.hpp"
@@ -366,6 +367,24 @@ void Game::render_test_ui() const
 }
 
 void Game::load_skybox(const std::string& env_name)
+{
+	SkyBox* sb = new SkyBox();
+
+	// prefer the lighting bake_ibl wrote offline, the gpu bake is the fallback
+	std::string spec_file = Stringf("Data/Images/cubemap/%s/%s", env_name.c_str(), IBL_SPECULAR_FILE_NAME);
+	std::string diffuse_file = Stringf("Data/Images/cubemap/%s/%s", env_name.c_str(), IBL_IRRADIANCE_FILE_NAME);
+	if(!sb->load_baked_lighting(g_theRenderer->m_device, spec_file.c_str(), diffuse_file.c_str())){
+		load_skybox_faces(sb, env_name);
+	}
+
+	g_theRenderer->get_current_scene()->set_skybox(sb);
+	g_theRenderer->get_current_scene()->set_skybox_enabled(true);
+
+	SAFE_DELETE(m_skybox);
+	m_skybox = sb;
+}
+
+void Game::load_skybox_faces(SkyBox* sb, const std::string& env_name)
 {
 	CubeMapImagePaths im;
 
@@ -388,15 +407,8 @@ void Game::load_skybox(const std::string& env_name)
 	im.posY	 = pos_y.c_str();
 
 	// load environment map
-	SkyBox* sb = new SkyBox();
 	sb->load_from_face_images(g_theRenderer->m_device, im);
 	sb->bake_lighting(512, 1024);
-
-	g_theRenderer->get_current_scene()->set_skybox(sb);
-	g_theRenderer->get_current_scene()->set_skybox_enabled(true);
-
-	SAFE_DELETE(m_skybox);
-	m_skybox = sb;
 }
 
 COMMAND(export_cubemap, "Exports cubemap to six seperate images")
@@ -62,4 +62,5 @@ class Game
 		void render_test_ui() const;
 
 		void load_skybox(const std::string& env_name);
+		void load_skybox_faces(SkyBox* sb, const std::string& env_name);
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "Data/HLSL/Util/random.h"
 #include "Data/HLSL/Util/cb_common.h"
 #include "Data/HLSL/brdf/brdf.h"
+#include "Data/HLSL/Lighting/light_clusters.h"
 
 // -------------------------------------------------------------
 // Textures
@@ -125,9 +126,9 @@ float3 get_normal(vertex_to_fragment_t data)
 
 		float3x3 tbn = float3x3(tangent, bitangent, normal);
 
-		float3 texture_normal = t_normal.Sample(s_linear, data.texCoord).xyz;
-		texture_normal *= float3(2.0f, 2.0f, 2.0f);
-		texture_normal -= float3(1.0f, 1.0f, 1.0f);
+		// z is rebuilt from x and y, cooked BC5 normal maps only store those two
+		float2 texture_xy = (t_normal.Sample(s_linear, data.texCoord).xy * 2.0f) - 1.0f;
+		float3 texture_normal = float3(texture_xy, sqrt(saturate(1.0f - dot(texture_xy, texture_xy))));
 
 		texture_normal.y *= -1.0f;
 
@@ -457,9 +458,12 @@ float4 FragmentFunction(vertex_to_fragment_t data) : SV_Target0
     float3 final_diff_energy = 0.0f;
     float3 final_spec_energy = 0.0f;
 
+    // only the point and spot lights binned into this fragment's cluster
+    light_cluster_t cluster = get_light_cluster(data.position.xy, data.worldPosition.xyz);
+
     // for each point light calc energy
-    for(uint i = 0; i < MAX_POINT_LIGHTS; i++){
-        point_light_t pl = POINT_LIGHTS[i];
+    for(uint i = 0; i < cluster.point_count; i++){
+        point_light_t pl = t_point_lights[t_light_indexes[cluster.offset + i]];
 
         if(pl.color.w <= 0.001f){
             continue;
@@ -561,8 +565,8 @@ float4 FragmentFunction(vertex_to_fragment_t data) : SV_Target0
     }
 
     // for each spot light
-    for(uint k = 0; k < MAX_SPOT_LIGHTS; k++){
-        spot_light_t sl = SPOT_LIGHTS[k];
+    for(uint k = 0; k < cluster.spot_count; k++){
+        spot_light_t sl = t_spot_lights[t_light_indexes[cluster.offset + cluster.point_count + k]];
 
         if(sl.color.w <= 0.001f){
             continue;
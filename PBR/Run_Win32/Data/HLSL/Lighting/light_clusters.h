@@ -0,0 +1,45 @@
+// -------------------------------------------------------------
+// Clustered lighting, built on the cpu by LightClusterGrid
+// -------------------------------------------------------------
+struct light_cluster_t
+{
+	uint offset;
+	uint point_count;
+	uint spot_count;
+	uint _padding;
+};
+
+cbuffer light_cluster_cb : register(b8)
+{
+	uint CLUSTER_COUNT_X;
+	uint CLUSTER_COUNT_Y;
+	uint CLUSTER_COUNT_Z;
+	uint _cluster_padding0;
+
+	float CLUSTER_NEAR_Z;
+	float CLUSTER_FAR_Z;
+	float CLUSTER_LOG_SCALE;
+	float CLUSTER_LOG_BIAS;
+
+	float2 CLUSTER_SCREEN_SIZE;
+	float2 _cluster_padding1;
+};
+
+StructuredBuffer<light_cluster_t> t_light_clusters : register(t11);
+StructuredBuffer<uint> t_light_indexes : register(t12);
+StructuredBuffer<point_light_t> t_point_lights : register(t13);
+StructuredBuffer<spot_light_t> t_spot_lights : register(t14);
+
+// screen_pos is SV_Position, world_pos is the fragment's world position
+light_cluster_t get_light_cluster(float2 screen_pos, float3 world_pos)
+{
+	float view_z = mul(float4(world_pos, 1.0f), VIEW).z;
+
+	uint2 tile = (uint2)((screen_pos / CLUSTER_SCREEN_SIZE) * float2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y));
+	tile = min(tile, uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+
+	int slice = (int)floor(log(max(view_z, CLUSTER_NEAR_Z)) * CLUSTER_LOG_SCALE - CLUSTER_LOG_BIAS);
+	uint z = (uint)clamp(slice, 0, (int)CLUSTER_COUNT_Z - 1);
+
+	return t_light_clusters[((z * CLUSTER_COUNT_Y) + tile.y) * CLUSTER_COUNT_X + tile.x];
+}
@@ -8,9 +8,10 @@
 
 float3 texture_normal_to_surface_normal(float3 texture_normal)
 {
-    float3 tbn_normal = (texture_normal * float3(2.0, 2.0, 1.0)) - float3(1.0, 1.0, 0.0);
-    tbn_normal = normalize(tbn_normal);
-    return tbn_normal;
+    // z is rebuilt from x and y, cooked BC5 normal maps only store those two
+    float2 tbn_xy = (texture_normal.xy * 2.0) - 1.0;
+    float3 tbn_normal = float3(tbn_xy, sqrt(saturate(1.0 - dot(tbn_xy, tbn_xy))));
+    return normalize(tbn_normal);
 }
 
 float4 surface_normal_to_color(float3 surface_normal)
@@ -57,12 +57,14 @@ float4 integrate_diffuse_cube(float3 world_normal)
         float n_dot_l;
         float pdf;
 
+        // the cosine is already in the pdf, (L * n_dot_l / pdf) / PI is just L
         importance_sample_cos_dir(random_sample, world_normal, light, n_dot_l, pdf);
         if(n_dot_l > 0.0f){
-            accum += t_environment.Sample(s_linear, light).rgb * n_dot_l;
+            accum += t_environment.Sample(s_linear, light).rgb;
         }
     }
 
+    // irradiance / PI, same as the cpu bake
     return float4(accum / (float) num_samples, 1.0f);
 }
 
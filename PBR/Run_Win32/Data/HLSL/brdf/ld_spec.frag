@@ -53,8 +53,11 @@ struct vertex_to_fragment_t
 // IBL
 // -------------------------------------------------------------
 
-float3 integrate_spec_ld(float3 normal, float linear_roughness)
+// roughness is squared once, in importance_sample_ggx and for the ndf
+float3 integrate_spec_ld(float3 normal, float roughness)
 {
+    float alpha = roughness * roughness;
+
     float3 view = normal;
     float3 accum = 0.0f;
     float weight = 0.0f;
@@ -62,7 +65,7 @@ float3 integrate_spec_ld(float3 normal, float linear_roughness)
     const uint sample_count = 1024;
     for(uint i = 0; i < sample_count; ++i){
         float2 Xi = get_2d_sample(i, sample_count);
-        float3 half_vec = importance_sample_ggx(Xi, linear_roughness, normal);
+        float3 half_vec = importance_sample_ggx(Xi, roughness, normal);
 
 		float3 light = normalize(2.0f * dot(view, half_vec) * half_vec - view);
         float n_dot_l = dot(normal, light);
@@ -70,7 +73,7 @@ float3 integrate_spec_ld(float3 normal, float linear_roughness)
             float n_dot_h = saturate(dot(normal, half_vec));
             float l_dot_h = saturate(dot(light, half_vec));
 
-            float pdf = (D_calc_ggx(n_dot_h, linear_roughness) / PI) * n_dot_h / (4 * l_dot_h);
+            float pdf = (D_calc_ggx(n_dot_h, alpha) / PI) * n_dot_h / (4 * l_dot_h);
             //float pdf = D_calc_ggx(n_dot_h, linear_roughness) * PI / 4.0f;
 
             float omega_s = 1.0f / (sample_count * pdf);
@@ -94,8 +97,7 @@ float4 FragmentFunction(vertex_to_fragment_t data) : SV_Target0
 {
     float3 world_normal = normalize(data.worldPosition.xyz);
 
-    float linear_roughness = (float) CURRENT_MIP_LEVEL / (float) TOTAL_MIP_LEVELS;
-    linear_roughness *= linear_roughness;
+    float roughness = (float) CURRENT_MIP_LEVEL / (float) TOTAL_MIP_LEVELS;
 
     // first mip level is the exact same as the input cubemap
     // this allows us to do mirror-like specular reflections
@@ -103,5 +105,5 @@ float4 FragmentFunction(vertex_to_fragment_t data) : SV_Target0
         return t_environment.SampleLevel(s_linear, world_normal, 0.0f);
     }
 
-    return float4(integrate_spec_ld(world_normal, linear_roughness), 1.0f);
+    return float4(integrate_spec_ld(world_normal, roughness), 1.0f);
 }
\ No newline at end of file
@@ -7,6 +7,12 @@ cbuffer MatrixBuffer : register(b0)
 	float4x4 PROJECTION;
 };
 
+cbuffer SkinningBuffer : register(b7)
+{
+	uint SKIN_MATRIX_OFFSET;
+	uint3 _skin_padding;
+};
+
 struct vertex_in_t
 {
 	float3 position : POSITION;
@@ -36,10 +42,10 @@ vertex_to_fragment_t VertexFunction(vertex_in_t vertex)
 	vertex_to_fragment_t out_data = (vertex_to_fragment_t)0;
 
     //skinning
-    float4x4 s0 = tSkinMatrices[vertex.bone_indices.x];
-    float4x4 s1 = tSkinMatrices[vertex.bone_indices.y];
-    float4x4 s2 = tSkinMatrices[vertex.bone_indices.z];
-    float4x4 s3 = tSkinMatrices[vertex.bone_indices.w];
+    float4x4 s0 = tSkinMatrices[SKIN_MATRIX_OFFSET + vertex.bone_indices.x];
+    float4x4 s1 = tSkinMatrices[SKIN_MATRIX_OFFSET + vertex.bone_indices.y];
+    float4x4 s2 = tSkinMatrices[SKIN_MATRIX_OFFSET + vertex.bone_indices.z];
+    float4x4 s3 = tSkinMatrices[SKIN_MATRIX_OFFSET + vertex.bone_indices.w];
 
     float4x4 skin = (vertex.bone_weights.x * s0) +
                     (vertex.bone_weights.y * s1) +